@@ -2,8 +2,13 @@
 #define MBEDTLS_SSL_TLS_C
 #define MBEDTLS_SSL_PROTO_TLS1_3
 #define MBEDTLS_SSL_TLS1_3_KEY_EXCHANGE_MODE_EPHEMERAL_ENABLED
+// resumption with session tickets, see src/tls_session_cache.c
+#define MBEDTLS_SSL_TLS1_3_KEY_EXCHANGE_MODE_PSK_EPHEMERAL_ENABLED
+#define MBEDTLS_SSL_SESSION_TICKETS
+#define MBEDTLS_SSL_TICKET_C // tickets of TLS stand-in server in test/tls_session_bench.c
 #define MBEDTLS_SSL_KEEP_PEER_CERTIFICATE
 #define MBEDTLS_SSL_CLI_C
+#define MBEDTLS_SSL_SRV_C // TLS stand-in server in test/reactor_bench.c
 #define MBEDTLS_KEY_EXCHANGE_WITH_CERT_ENABLED
 
 /* X25519 for ECDHE */
@@ -41,10 +46,12 @@
 /* TLS extras */
 #define MBEDTLS_X509_USE_C
 #define MBEDTLS_X509_CRT_PARSE_C
+#define MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK // roots are parsed when chain needs them, see src/ca_store.c
 #define MBEDTLS_PEM_PARSE_C
 #define MBEDTLS_ENTROPY_C
 #define MBEDTLS_CTR_DRBG_C
 #define MBEDTLS_SSL_SERVER_NAME_INDICATION
+#define MBEDTLS_SSL_ALPN
 
 /* PSA crypto (required for TLS 1.3) */
 #define MBEDTLS_PSA_CRYPTO_C
@@ -44,7 +44,11 @@ if [ ! -d "$WOLFSSL_DIR-install" ]; then
     --disable-examples              \
     --disable-oldnames              \
     --enable-aesni-with-avx         \
-    --enable-intelasm 
+    --enable-intelasm               \
+    --enable-alpn                   \
+    --enable-sni                    \
+    --enable-session-ticket         \
+    --enable-opensslextra
 
   StartTimer
   make install -j8
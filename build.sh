@@ -402,6 +402,7 @@ cflags="$cflags -DIS_PLATFORM_LINUX=$IsPlatformLinux"
 cflags="$cflags -DIS_PLATFORM_WINDOWS=$IsPlatformWindows"
 
 cflags="$cflags -DIS_BUILD_DEBUG=$IsBuildDebug"
+cflags="$cflags -DIS_TLS_BACKEND_WOLFSSL=$WITH_WOLFSSL"
 if [ $IsBuildDebug -eq 1 ]; then
   cflags="$cflags -g -O0"
   cflags="$cflags -Wno-unused-but-set-variable"
@@ -462,12 +463,12 @@ if [ $IsBuildEnabled -eq 1 ]; then
     . "$ProjectRoot/3rdparty/build.sh"
     LIB_M='-lm'
 
+    # same program for both, see src/tls_backend.h
     src="$ProjectRoot/src/main.c"
     output="$OutputDir/$OUTPUT_NAME"
     inc="-I$ProjectRoot/include $INC_MBEDTLS"
     lib="$LIB_MBEDTLS"
-    if [ $WITH_WOLFSSL -eq  1 ]; then 
-      src="$ProjectRoot/src/main_wolfssl.c"
+    if [ $WITH_WOLFSSL -eq 1 ]; then
       inc="-I$ProjectRoot/include $INC_WOLFSSL"
       lib="$LIB_WOLFSSL $LIB_M"
     fi
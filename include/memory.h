@@ -86,6 +86,13 @@ MemoryCopy(void *dest, void *src, u64 length)
   __builtin_memcpy(dest, src, length);
 }
 
+// dest and src can overlap
+static void
+MemoryMove(void *dest, void *src, u64 length)
+{
+  __builtin_memmove(dest, src, length);
+}
+
 static void
 MemoryClear(void *dest, u64 length)
 {
@@ -0,0 +1,248 @@
+#pragma once
+
+/*
+ * Percent-Encoding
+ * https://www.rfc-editor.org/rfc/rfc3986#section-2.1
+ *
+ * Every octet except unreserved characters (A-Z a-z 0-9 - . _ ~) is written
+ * as '%' followed by two uppercase hex digits. In form mode
+ * (application/x-www-form-urlencoded) space is written as '+' instead.
+ *
+ * Text is mostly unreserved characters, so 32 octets are checked at once and
+ * runs of unreserved characters are copied in bulk. Octets that need work are
+ * handled one by one.
+ */
+
+#include "assert.h"
+#include "memory.h"
+#include "string_builder.h"
+#include "text.h"
+#include "type.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+enum percent_encoding {
+  // space is %20
+  PERCENT_ENCODING_URL,
+  // space is +
+  PERCENT_ENCODING_FORM,
+};
+
+static inline b8
+IsPercentUnreserved(u8 character)
+{
+  return (character >= 'A' && character <= 'Z') || (character >= 'a' && character <= 'z') ||
+         (character >= '0' && character <= '9') || character == '-' || character == '.' || character == '_' ||
+         character == '~';
+}
+
+#if defined(__AVX2__)
+/*
+ * @return bit mask, bit is set when octet is unreserved
+ */
+static inline u32
+PercentUnreservedMask(__m256i octets)
+{
+  // unsigned range check, min/max keep octets above 0x7f out
+#define IS_IN_RANGE(x, low, high)                                                                                      \
+  _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(x, _mm256_set1_epi8(low)), x),                                    \
+                   _mm256_cmpeq_epi8(_mm256_min_epu8(x, _mm256_set1_epi8(high)), x))
+
+  // lowering case by setting 0x20 bit maps A-Z to a-z
+  __m256i lowered = _mm256_or_si256(octets, _mm256_set1_epi8(0x20));
+  __m256i isLetter = IS_IN_RANGE(lowered, 'a', 'z');
+  __m256i isDigit = IS_IN_RANGE(octets, '0', '9');
+  // - and . are next to each other
+  __m256i isMark = _mm256_or_si256(IS_IN_RANGE(octets, '-', '.'),
+                                   _mm256_or_si256(_mm256_cmpeq_epi8(octets, _mm256_set1_epi8('_')),
+                                                   _mm256_cmpeq_epi8(octets, _mm256_set1_epi8('~'))));
+#undef IS_IN_RANGE
+
+  __m256i isUnreserved = _mm256_or_si256(isLetter, _mm256_or_si256(isDigit, isMark));
+  return (u32)_mm256_movemask_epi8(isUnreserved);
+}
+#endif
+
+/*
+ * @return length of string after encoding
+ */
+static u64
+PercentEncodedLength(struct string *string, enum percent_encoding mode)
+{
+  u64 length = string->length;
+  u64 index = 0;
+
+#if defined(__AVX2__)
+  for (; index + 32 <= string->length; index += 32) {
+    __m256i octets = _mm256_loadu_si256((__m256i *)(string->value + index));
+    u32 reservedMask = ~PercentUnreservedMask(octets);
+    if (mode == PERCENT_ENCODING_FORM)
+      reservedMask &= ~(u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(octets, _mm256_set1_epi8(' ')));
+    // every reserved octet takes 2 more
+    length += 2 * (u64)__builtin_popcount(reservedMask);
+  }
+#endif
+
+  for (; index < string->length; index++) {
+    u8 character = string->value[index];
+    if (!IsPercentUnreserved(character) && !(mode == PERCENT_ENCODING_FORM && character == ' '))
+      length += 2;
+  }
+
+  return length;
+}
+
+/*
+ * Encodes string into buffer.
+ * @return encoded string
+ *         null if buffer is not big enough, see PercentEncodedLength()
+ */
+static struct string
+PercentEncode(struct string *string, struct string *buffer, enum percent_encoding mode)
+{
+  comptime u8 HEX_DIGITS[16] = "0123456789ABCDEF";
+
+  u8 *output = buffer->value;
+  u8 *outputEnd = buffer->value + buffer->length;
+  u64 index = 0;
+  while (index < string->length) {
+    u64 blockEnd = string->length;
+#if defined(__AVX2__)
+    if (index + 32 <= string->length && (u64)(outputEnd - output) >= 32) {
+      __m256i octets = _mm256_loadu_si256((__m256i *)(string->value + index));
+      u32 unreservedMask = PercentUnreservedMask(octets);
+      // whole block is stored, only run of unreserved octets is kept
+      _mm256_storeu_si256((__m256i *)output, octets);
+      if (unreservedMask == U32_MAX) {
+        output += 32;
+        index += 32;
+        continue;
+      }
+
+      u32 runLength = (u32)__builtin_ctz(~unreservedMask);
+      output += runLength;
+      // rest of block is done one by one
+      blockEnd = index + 32;
+      index += runLength;
+    }
+#endif
+
+    for (; index < blockEnd; index++) {
+      u8 character = string->value[index];
+      if (IsPercentUnreserved(character)) {
+        if (output == outputEnd)
+          return StringNull();
+        *output++ = character;
+      } else if (mode == PERCENT_ENCODING_FORM && character == ' ') {
+        if (output == outputEnd)
+          return StringNull();
+        *output++ = '+';
+      } else {
+        if (outputEnd - output < 3)
+          return StringNull();
+        output[0] = '%';
+        output[1] = HEX_DIGITS[character >> 4];
+        output[2] = HEX_DIGITS[character & 0xf];
+        output += 3;
+      }
+    }
+  }
+
+  return StringFromBuffer(buffer->value, (u64)(output - buffer->value));
+}
+
+static inline s32
+PercentHexValue(u8 character)
+{
+  if (character >= '0' && character <= '9')
+    return character - '0';
+  character |= 0x20;
+  if (character >= 'a' && character <= 'f')
+    return character - 'a' + 10;
+  return -1;
+}
+
+/*
+ * Decodes string into buffer. Decoded string is never longer, so buffer can
+ * be string itself.
+ * @return decoded string
+ *         null if buffer is not big enough or % is not followed by two hex
+ *         digits
+ */
+static struct string
+PercentDecode(struct string *string, struct string *buffer, enum percent_encoding mode)
+{
+  u8 *output = buffer->value;
+  u8 *outputEnd = buffer->value + buffer->length;
+  u64 index = 0;
+  while (index < string->length) {
+    u64 blockEnd = string->length;
+#if defined(__AVX2__)
+    if (index + 32 <= string->length && (u64)(outputEnd - output) >= 32) {
+      __m256i octets = _mm256_loadu_si256((__m256i *)(string->value + index));
+      __m256i isEscape = _mm256_cmpeq_epi8(octets, _mm256_set1_epi8('%'));
+      if (mode == PERCENT_ENCODING_FORM)
+        isEscape = _mm256_or_si256(isEscape, _mm256_cmpeq_epi8(octets, _mm256_set1_epi8('+')));
+      u32 escapeMask = (u32)_mm256_movemask_epi8(isEscape);
+      if (escapeMask == 0) {
+        _mm256_storeu_si256((__m256i *)output, octets);
+        output += 32;
+        index += 32;
+        continue;
+      }
+
+      // when decoding in place, storing whole block would overwrite octets
+      // that are not read yet
+      u32 runLength = (u32)__builtin_ctz(escapeMask);
+      MemoryMove(output, string->value + index, runLength);
+      output += runLength;
+      // rest of block is done one by one
+      blockEnd = index + 32;
+      index += runLength;
+    }
+#endif
+
+    while (index < blockEnd) {
+      if (output == outputEnd)
+        return StringNull();
+
+      u8 character = string->value[index];
+      if (character == '%') {
+        if (index + 2 >= string->length)
+          return StringNull();
+        s32 high = PercentHexValue(string->value[index + 1]);
+        s32 low = PercentHexValue(string->value[index + 2]);
+        if (high < 0 || low < 0)
+          return StringNull();
+        *output++ = (u8)(high << 4 | low);
+        index += 3;
+      } else if (mode == PERCENT_ENCODING_FORM && character == '+') {
+        *output++ = ' ';
+        index++;
+      } else {
+        *output++ = character;
+        index++;
+      }
+    }
+  }
+
+  return StringFromBuffer(buffer->value, (u64)(output - buffer->value));
+}
+
+/*
+ * @return false if encoded string does not fit, nothing is appended
+ */
+static b8
+StringBuilderAppendPercentEncoded(string_builder *stringBuilder, struct string *src, enum percent_encoding mode)
+{
+  struct string *outBuffer = stringBuilder->outBuffer;
+  struct string remaining =
+      StringFromBuffer(outBuffer->value + stringBuilder->length, outBuffer->length - stringBuilder->length);
+  struct string encoded = PercentEncode(src, &remaining, mode);
+  if (IsStringNull(&encoded))
+    return 0;
+  stringBuilder->length += encoded.length;
+  return 1;
+}
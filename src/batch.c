@@ -0,0 +1,140 @@
+#pragma once
+
+/*
+ * Reader of batch of video ids
+ *
+ * Ids come one on every line from file or standard input, which can be
+ * larger than memory or still being written, so it is read in pieces into
+ * fixed buffer. Lines are handed out as soon as they are complete; what is
+ * left of last line is moved to start of buffer before next piece is read.
+ * Empty lines and lines starting with # are skipped, line that does not fit
+ * in buffer is reported and dropped.
+ *
+ * @code
+ *   BatchReaderInit(&reader, buffer)
+ *   while (1) {
+ *     result = BatchReaderNext(&reader, &line)
+ *     if (result == BATCH_READER_MORE) {
+ *       space = BatchReaderSpace(&reader)
+ *       BatchReaderAppend(&reader, read(space.value, space.length))
+ *     } else if (result == BATCH_READER_END)
+ *       break
+ *     else if (result == BATCH_READER_LINE)
+ *       use line, it is valid until BatchReaderSpace()
+ *   }
+ * @endcode
+ */
+
+#include "memory.h"
+#include "text.h"
+#include "type.h"
+
+struct batch_reader {
+  struct string buffer;
+  // bytes read but not handed out, from start
+  u64 start;
+  u64 length;
+  // of last line handed out, starts from 1
+  u32 lineNumber;
+  // no more is read, last line does not need newline
+  b8 isEnded;
+  // line longer than buffer is dropped until its newline
+  b8 isSkipping;
+};
+
+enum batch_reader_result {
+  // line is given
+  BATCH_READER_LINE,
+  // buffer has no complete line, read more
+  BATCH_READER_MORE,
+  // every line is given
+  BATCH_READER_END,
+  // line is longer than buffer, it is dropped
+  BATCH_READER_TOO_LONG,
+};
+
+internalfn void
+BatchReaderInit(struct batch_reader *reader, struct string *buffer)
+{
+  debug_assert(buffer->length != 0);
+  *reader = (struct batch_reader){
+      .buffer = *buffer,
+  };
+}
+
+/*
+ * Moves bytes not handed out to start of buffer.
+ * @return space after them, lines given before are no longer valid
+ */
+internalfn struct string
+BatchReaderSpace(struct batch_reader *reader)
+{
+  if (reader->start != 0) {
+    MemoryMove(reader->buffer.value, reader->buffer.value + reader->start, reader->length);
+    reader->start = 0;
+  }
+  return StringFromBuffer(reader->buffer.value + reader->length, reader->buffer.length - reader->length);
+}
+
+/*
+ * @param length bytes written in space, 0 when there is no more
+ */
+internalfn void
+BatchReaderAppend(struct batch_reader *reader, u64 length)
+{
+  debug_assert(reader->start + reader->length + length <= reader->buffer.length);
+  if (length == 0)
+    reader->isEnded = 1;
+  reader->length += length;
+}
+
+/*
+ * @param line stripped of whitespace, points into buffer
+ */
+internalfn enum batch_reader_result
+BatchReaderNext(struct batch_reader *reader, struct string *line)
+{
+  while (1) {
+    u8 *data = reader->buffer.value + reader->start;
+    u64 lineLength = 0;
+    while (lineLength < reader->length && data[lineLength] != '\n')
+      lineLength++;
+
+    b8 isNewlineFound = lineLength < reader->length;
+    if (!isNewlineFound && !reader->isEnded) {
+      if (reader->length < reader->buffer.length)
+        return BATCH_READER_MORE;
+
+      // full buffer without newline
+      reader->start = 0;
+      reader->length = 0;
+      if (reader->isSkipping)
+        return BATCH_READER_MORE;
+      reader->isSkipping = 1;
+      reader->lineNumber++;
+      return BATCH_READER_TOO_LONG;
+    }
+
+    if (!isNewlineFound && reader->length == 0)
+      return BATCH_READER_END;
+
+    u64 consumed = lineLength + isNewlineFound;
+    reader->start += consumed;
+    reader->length -= consumed;
+
+    // rest of line that is already reported
+    if (reader->isSkipping) {
+      reader->isSkipping = 0;
+      continue;
+    }
+
+    reader->lineNumber++;
+    struct string text = StringFromBuffer(data, lineLength);
+    text = StringStripWhitespace(&text);
+    if (text.length == 0 || text.value[0] == '#')
+      continue;
+
+    *line = text;
+    return BATCH_READER_LINE;
+  }
+}
@@ -0,0 +1,410 @@
+#pragma once
+
+/*
+ * Trusted certificates indexed by subject
+ *
+ * System bundle has every root in PEM, ~150 of them in ~200 KB, and parsing
+ * all of them costs more than handshake that checks chain against one. Store
+ * is built from bundle once: certificates are decoded to DER and indexed by
+ * hash of their subject name. It is written to file that later runs map and
+ * use as is, until size or modification time of bundle changes. Certificate
+ * is parsed only when chain of server names it as issuer:
+ *
+ * @code
+ *   // file is missing or bundle changed
+ *   buffer.length = CaStoreLengthMax(bundle.length)
+ *   content = CaStoreBuild(&buffer, &bundle, bundleSize, bundleModifiedAt)
+ *
+ *   CaStoreOpen(&store, &content, bundleSize, bundleModifiedAt)
+ *   for (index = CaStoreFind(&store, &issuer); index != -1; index = CaStoreNext(&store, index, &issuer))
+ *     der = CaStoreCertificate(&store, index)
+ * @endcode
+ *
+ * File format, integers are little endian:
+ *
+ *   "ICAS" u32 version
+ *   u64 bundleSize, u64 bundleModifiedAt
+ *   u32 certificateCount
+ *   certificateCount times, ordered by subjectHash:
+ *     u64 subjectHash     see CaStoreHash()
+ *     u32 offset          from start of file
+ *     u32 length
+ *     u32 subjectOffset   from start of certificate
+ *     u32 subjectLength
+ *   certificates in DER
+ */
+
+#include "memory.h"
+#include "string_cursor.h"
+#include "text.h"
+#include "type.h"
+
+enum {
+  CA_STORE_VERSION = 1,
+  CA_STORE_HEADER_LENGTH = 4 + 4 + 8 + 8 + 4,
+  CA_STORE_ENTRY_LENGTH = 8 + 4 + 4 + 4 + 4,
+};
+
+struct ca_store {
+  u8 *octets;
+  u64 length;
+  u32 certificateCount;
+};
+
+internalfn u64
+CaStoreReadInteger(u8 *octets, u32 length)
+{
+  u64 value = 0;
+  for (u32 index = length; index > 0; index--)
+    value = (value << 8) | octets[index - 1];
+  return value;
+}
+
+internalfn void
+CaStoreWriteInteger(u8 *octets, u32 length, u64 value)
+{
+  for (u32 index = 0; index < length; index++) {
+    octets[index] = (u8)value;
+    value >>= 8;
+  }
+}
+
+/*
+ * FNV-1a
+ * @param name DER of Name with its tag and length, see mbedtls_x509_crt.subject_raw
+ */
+internalfn u64
+CaStoreHash(struct string *name)
+{
+  u64 hash = 0xcbf29ce484222325;
+  for (u64 index = 0; index < name->length; index++) {
+    hash ^= name->value[index];
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
+
+/*
+ * Takes DER element at start of data.
+ * @param tag expected tag
+ * @param content element without its tag and length
+ * @return element with its tag and length, null when data does not start with one
+ */
+internalfn struct string
+CaStoreDerElement(struct string *data, u8 tag, struct string *content)
+{
+  if (data->length < 2 || data->value[0] != tag)
+    return StringNull();
+
+  u64 headerLength = 2;
+  u64 contentLength = data->value[1];
+  if (contentLength & 0x80) {
+    // long form, indefinite length is not DER
+    u64 lengthLength = contentLength & 0x7f;
+    if (lengthLength == 0 || lengthLength > 4 || data->length < 2 + lengthLength)
+      return StringNull();
+
+    contentLength = 0;
+    for (u64 index = 0; index < lengthLength; index++)
+      contentLength = (contentLength << 8) | data->value[2 + index];
+    headerLength += lengthLength;
+  }
+
+  if (data->length - headerLength < contentLength)
+    return StringNull();
+
+  *content = StringFromBuffer(data->value + headerLength, contentLength);
+  return StringFromBuffer(data->value, headerLength + contentLength);
+}
+
+/*
+ * Finds names in certificate, see RFC 5280 4.1. Basic Certificate Fields.
+ * @param issuer, subject DER of Name with its tag and length
+ * @return false when der is not a certificate
+ */
+internalfn b8
+CaStoreCertificateNames(struct string *der, struct string *issuer, struct string *subject)
+{
+  comptime u8 DER_SEQUENCE = 0x30;
+  comptime u8 DER_INTEGER = 0x02;
+  comptime u8 DER_VERSION = 0xa0; // [0] EXPLICIT
+
+  struct string certificateContent;
+  struct string certificate = CaStoreDerElement(der, DER_SEQUENCE, &certificateContent);
+  if (IsStringNull(&certificate) || certificate.length != der->length)
+    return 0;
+
+  struct string rest;
+  struct string tbsCertificate = CaStoreDerElement(&certificateContent, DER_SEQUENCE, &rest);
+  if (IsStringNull(&tbsCertificate))
+    return 0;
+
+  struct string content;
+  struct string element = CaStoreDerElement(&rest, DER_VERSION, &content);
+  if (!IsStringNull(&element))
+    rest = StringSlice(&rest, element.length, rest.length);
+
+  u8 tags[] = {
+      DER_INTEGER,  // serialNumber
+      DER_SEQUENCE, // signature
+      DER_SEQUENCE, // issuer
+      DER_SEQUENCE, // validity
+      DER_SEQUENCE, // subject
+  };
+  struct string elements[ARRAY_COUNT(tags)];
+  for (u32 index = 0; index < ARRAY_COUNT(tags); index++) {
+    elements[index] = CaStoreDerElement(&rest, tags[index], &content);
+    if (IsStringNull(&elements[index]))
+      return 0;
+    rest = StringSlice(&rest, elements[index].length, rest.length);
+  }
+
+  *issuer = elements[2];
+  *subject = elements[4];
+  return 1;
+}
+
+/*
+ * Decodes base64 in PEM, line breaks in it are skipped.
+ * @return length of decoded, 0 when text is not base64
+ */
+internalfn u64
+CaStoreDecodeBase64(u8 *output, struct string *text)
+{
+  u64 length = 0;
+  u32 bits = 0;
+  u32 bitCount = 0;
+  for (u64 index = 0; index < text->length; index++) {
+    u8 character = text->value[index];
+    u32 value;
+    if (character >= 'A' && character <= 'Z')
+      value = (u32)(character - 'A');
+    else if (character >= 'a' && character <= 'z')
+      value = (u32)(character - 'a') + 26;
+    else if (character >= '0' && character <= '9')
+      value = (u32)(character - '0') + 52;
+    else if (character == '+')
+      value = 62;
+    else if (character == '/')
+      value = 63;
+    else if (character == '\n' || character == '\r' || character == ' ' || character == '\t')
+      continue;
+    else if (character == '=')
+      break;
+    else
+      return 0;
+
+    bits = (bits << 6) | value;
+    bitCount += 6;
+    if (bitCount >= 8) {
+      bitCount -= 8;
+      output[length] = (u8)(bits >> bitCount);
+      length++;
+    }
+  }
+  return length;
+}
+
+/*
+ * Each certificate has at least its 28 character BEGIN line in bundle,
+ * more than its index entry, and base64 is longer than what it encodes.
+ * @return length that store of bundle fits in
+ */
+internalfn u64
+CaStoreLengthMax(u64 bundleLength)
+{
+  return CA_STORE_HEADER_LENGTH + bundleLength + bundleLength;
+}
+
+/*
+ * Builds store from certificates in PEM bundle. Anything that is not a
+ * certificate is skipped.
+ * @param buffer at least CaStoreLengthMax() long
+ * @param bundleSize, bundleModifiedAt what CaStoreOpen() compares against
+ * @return store in buffer, null when it does not fit or bundle has no certificates
+ */
+internalfn struct string
+CaStoreBuild(struct string *buffer, struct string *bundle, u64 bundleSize, u64 bundleModifiedAt)
+{
+  struct string beginMarker = StringFromLiteral("-----BEGIN CERTIFICATE-----");
+  struct string endMarker = StringFromLiteral("-----END CERTIFICATE-----");
+
+  u64 certificateMax = 0;
+  {
+    struct string_cursor cursor = StringCursorFromString(bundle);
+    while (StringCursorAdvanceAfter(&cursor, &beginMarker))
+      certificateMax++;
+  }
+
+  // offsets are u32
+  if (certificateMax == 0 || bundle->length > U32_MAX / 4 || buffer->length < CaStoreLengthMax(bundle->length))
+    return StringNull();
+
+  u8 *octets = buffer->value;
+  u32 certificateCount = 0;
+  u64 position = CA_STORE_HEADER_LENGTH + certificateMax * CA_STORE_ENTRY_LENGTH;
+  struct string_cursor cursor = StringCursorFromString(bundle);
+  while (StringCursorAdvanceAfter(&cursor, &beginMarker)) {
+    struct string base64 = StringCursorConsumeUntil(&cursor, &endMarker);
+    if (IsStringNull(&base64))
+      break;
+
+    struct string der = StringFromBuffer(octets + position, CaStoreDecodeBase64(octets + position, &base64));
+    struct string issuer;
+    struct string subject;
+    if (!CaStoreCertificateNames(&der, &issuer, &subject))
+      continue;
+
+    u8 *entry = octets + CA_STORE_HEADER_LENGTH + certificateCount * CA_STORE_ENTRY_LENGTH;
+    CaStoreWriteInteger(entry, 8, CaStoreHash(&subject));
+    CaStoreWriteInteger(entry + 8, 4, position);
+    CaStoreWriteInteger(entry + 12, 4, der.length);
+    CaStoreWriteInteger(entry + 16, 4, (u64)(subject.value - der.value));
+    CaStoreWriteInteger(entry + 20, 4, subject.length);
+    certificateCount++;
+    position += der.length;
+  }
+
+  if (certificateCount == 0)
+    return StringNull();
+
+  // insertion sort by hash, keeps order of bundle for same subject
+  u8 *entries = octets + CA_STORE_HEADER_LENGTH;
+  for (u32 sortedCount = 1; sortedCount < certificateCount; sortedCount++) {
+    u8 entry[CA_STORE_ENTRY_LENGTH];
+    MemoryCopy(entry, entries + sortedCount * CA_STORE_ENTRY_LENGTH, CA_STORE_ENTRY_LENGTH);
+    u64 hash = CaStoreReadInteger(entry, 8);
+
+    u32 index = sortedCount;
+    while (index > 0 && CaStoreReadInteger(entries + (index - 1) * CA_STORE_ENTRY_LENGTH, 8) > hash)
+      index--;
+    MemoryMove(entries + (index + 1) * CA_STORE_ENTRY_LENGTH, entries + index * CA_STORE_ENTRY_LENGTH,
+               (sortedCount - index) * CA_STORE_ENTRY_LENGTH);
+    MemoryCopy(entries + index * CA_STORE_ENTRY_LENGTH, entry, CA_STORE_ENTRY_LENGTH);
+  }
+
+  octets[0] = 'I';
+  octets[1] = 'C';
+  octets[2] = 'A';
+  octets[3] = 'S';
+  CaStoreWriteInteger(octets + 4, 4, CA_STORE_VERSION);
+  CaStoreWriteInteger(octets + 8, 8, bundleSize);
+  CaStoreWriteInteger(octets + 16, 8, bundleModifiedAt);
+  CaStoreWriteInteger(octets + 24, 4, certificateCount);
+  return StringFromBuffer(octets, position);
+}
+
+/*
+ * Checks store before it is used. Certificates are left as they are, they
+ * are checked when they are parsed.
+ * @param content must stay around while store is used
+ * @return false when content is not store of bundle with given size and modification time
+ */
+internalfn b8
+CaStoreOpen(struct ca_store *store, struct string *content, u64 bundleSize, u64 bundleModifiedAt)
+{
+  u8 *octets = content->value;
+  if (content->length < CA_STORE_HEADER_LENGTH || octets[0] != 'I' || octets[1] != 'C' || octets[2] != 'A' ||
+      octets[3] != 'S' || CaStoreReadInteger(octets + 4, 4) != CA_STORE_VERSION ||
+      CaStoreReadInteger(octets + 8, 8) != bundleSize || CaStoreReadInteger(octets + 16, 8) != bundleModifiedAt)
+    return 0;
+
+  u64 certificateCount = CaStoreReadInteger(octets + 24, 4);
+  if ((content->length - CA_STORE_HEADER_LENGTH) / CA_STORE_ENTRY_LENGTH < certificateCount)
+    return 0;
+
+  u64 previousHash = 0;
+  for (u64 index = 0; index < certificateCount; index++) {
+    u8 *entry = octets + CA_STORE_HEADER_LENGTH + index * CA_STORE_ENTRY_LENGTH;
+    u64 hash = CaStoreReadInteger(entry, 8);
+    u64 offset = CaStoreReadInteger(entry + 8, 4);
+    u64 length = CaStoreReadInteger(entry + 12, 4);
+    u64 subjectOffset = CaStoreReadInteger(entry + 16, 4);
+    u64 subjectLength = CaStoreReadInteger(entry + 20, 4);
+    if (hash < previousHash || offset > content->length || content->length - offset < length ||
+        subjectOffset > length || length - subjectOffset < subjectLength)
+      return 0;
+    previousHash = hash;
+  }
+
+  *store = (struct ca_store){
+      .octets = octets,
+      .length = content->length,
+      .certificateCount = (u32)certificateCount,
+  };
+  return 1;
+}
+
+internalfn struct string
+CaStoreCertificate(struct ca_store *store, u32 index)
+{
+  debug_assert(index < store->certificateCount);
+  u8 *entry = store->octets + CA_STORE_HEADER_LENGTH + index * CA_STORE_ENTRY_LENGTH;
+  u64 offset = CaStoreReadInteger(entry + 8, 4);
+  u64 length = CaStoreReadInteger(entry + 12, 4);
+  return StringFromBuffer(store->octets + offset, length);
+}
+
+internalfn struct string
+CaStoreSubject(struct ca_store *store, u32 index)
+{
+  debug_assert(index < store->certificateCount);
+  u8 *entry = store->octets + CA_STORE_HEADER_LENGTH + index * CA_STORE_ENTRY_LENGTH;
+  u64 offset = CaStoreReadInteger(entry + 8, 4);
+  u64 subjectOffset = CaStoreReadInteger(entry + 16, 4);
+  u64 subjectLength = CaStoreReadInteger(entry + 20, 4);
+  return StringFromBuffer(store->octets + offset + subjectOffset, subjectLength);
+}
+
+/*
+ * @return index of first certificate from startIndex on with subject, -1 when there is none
+ */
+internalfn s32
+CaStoreScan(struct ca_store *store, u32 startIndex, u64 hash, struct string *subject)
+{
+  for (u32 index = startIndex; index < store->certificateCount; index++) {
+    u8 *entry = store->octets + CA_STORE_HEADER_LENGTH + index * CA_STORE_ENTRY_LENGTH;
+    if (CaStoreReadInteger(entry, 8) != hash)
+      break;
+
+    struct string entrySubject = CaStoreSubject(store, index);
+    if (IsStringEqual(&entrySubject, subject))
+      return (s32)index;
+  }
+  return -1;
+}
+
+/*
+ * Same subject can have many certificates, e.g. renewed root, see CaStoreNext().
+ * @param subject DER of Name with its tag and length, see mbedtls_x509_crt.issuer_raw
+ * @return index of first certificate with subject, -1 when there is none
+ */
+internalfn s32
+CaStoreFind(struct ca_store *store, struct string *subject)
+{
+  u64 hash = CaStoreHash(subject);
+
+  // first entry with hash
+  u32 low = 0;
+  u32 high = store->certificateCount;
+  while (low < high) {
+    u32 middle = low + (high - low) / 2;
+    u8 *entry = store->octets + CA_STORE_HEADER_LENGTH + middle * CA_STORE_ENTRY_LENGTH;
+    if (CaStoreReadInteger(entry, 8) < hash)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+
+  return CaStoreScan(store, low, hash, subject);
+}
+
+/*
+ * @return index of next certificate with subject, -1 when there is none
+ */
+internalfn s32
+CaStoreNext(struct ca_store *store, s32 index, struct string *subject)
+{
+  debug_assert(index >= 0 && (u32)index < store->certificateCount);
+  return CaStoreScan(store, (u32)index + 1, CaStoreHash(subject), subject);
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+/*
+ * Concurrency limit
+ *
+ * How many requests an instance gets in flight at once. Instances are run by
+ * volunteers on small servers, sending them more than they can take only
+ * makes every response slower, or gets requests refused with
+ * "429 Too Many Requests".
+ *
+ * Limit is additive increase, multiplicative decrease (AIMD):
+ *  - every response that comes as fast as instance answers when idle raises
+ *    limit by 1/limit, so by one after limit many responses
+ *  - response that is much slower than that means requests are queueing on
+ *    server, limit is lowered by 10%
+ *  - refused request halves limit
+ * Decrease happens at most once per latency, responses of requests sent
+ * before it are of old limit. Limit settles on highest rate that instance
+ * answers without slowing down or refusing.
+ *
+ * @code
+ *   ConcurrencyLimitInit(&limit, 128)
+ *   while (inFlight < ConcurrencyLimitGet(&limit))
+ *     send()
+ *   if (status == 429)
+ *     ConcurrencyLimitThrottle(&limit, NowInNanoseconds())
+ *   else
+ *     ConcurrencyLimitRecord(&limit, timeToFirstByte, NowInNanoseconds())
+ * @endcode
+ */
+
+#include "assert.h"
+#include "type.h"
+
+// fixed point, limit grows by fractions of a request
+comptime u32 CONCURRENCY_LIMIT_ONE = 256;
+
+struct concurrency_limit {
+  // in 1/CONCURRENCY_LIMIT_ONE requests
+  u32 limit;
+  u32 limitMax;
+  // in nanoseconds, 0 before first response
+  // latency of instance when idle, drops at once, rises slowly so that
+  // instance that got slower for good is not limited forever
+  u64 latencyMin;
+  // moving average of recent responses
+  u64 latency;
+  u64 decreasedAt;
+};
+
+/*
+ * @param limitMax in requests, limit starts at it
+ */
+internalfn void
+ConcurrencyLimitInit(struct concurrency_limit *limit, u32 limitMax)
+{
+  debug_assert(limitMax != 0);
+  *limit = (struct concurrency_limit){
+      .limit = limitMax * CONCURRENCY_LIMIT_ONE,
+      .limitMax = limitMax * CONCURRENCY_LIMIT_ONE,
+  };
+}
+
+/*
+ * @return requests allowed in flight, at least one
+ */
+internalfn u32
+ConcurrencyLimitGet(struct concurrency_limit *limit)
+{
+  u32 requests = limit->limit / CONCURRENCY_LIMIT_ONE;
+  return requests != 0 ? requests : 1;
+}
+
+internalfn void
+ConcurrencyLimitDecrease(struct concurrency_limit *limit, u32 numerator, u32 denominator, u64 now)
+{
+  // responses to requests sent before last decrease are still arriving
+  if (limit->decreasedAt != 0 && now - limit->decreasedAt < limit->latency)
+    return;
+
+  limit->limit = (u32)((u64)limit->limit * numerator / denominator);
+  if (limit->limit < CONCURRENCY_LIMIT_ONE)
+    limit->limit = CONCURRENCY_LIMIT_ONE;
+  limit->decreasedAt = now;
+}
+
+/*
+ * Call when response comes.
+ * @param latency in nanoseconds, e.g. time to first byte
+ * @param now see NowInNanoseconds()
+ */
+internalfn void
+ConcurrencyLimitRecord(struct concurrency_limit *limit, u64 latency, u64 now)
+{
+  if (limit->latencyMin == 0 || latency < limit->latencyMin)
+    limit->latencyMin = latency;
+  else
+    limit->latencyMin += (latency - limit->latencyMin) / 256;
+
+  if (limit->latency == 0)
+    limit->latency = latency;
+  else if (latency > limit->latency)
+    limit->latency += (latency - limit->latency) / 8;
+  else
+    limit->latency -= (limit->latency - latency) / 8;
+
+  // requests are queueing on server
+  if (limit->latency > 2 * limit->latencyMin) {
+    ConcurrencyLimitDecrease(limit, 9, 10, now);
+    return;
+  }
+
+  limit->limit += CONCURRENCY_LIMIT_ONE * CONCURRENCY_LIMIT_ONE / limit->limit;
+  if (limit->limit > limit->limitMax)
+    limit->limit = limit->limitMax;
+}
+
+/*
+ * Call when instance refuses request because it has too many, or fails
+ * under load, e.g. with "429 Too Many Requests" or "503 Service Unavailable".
+ * @param now see NowInNanoseconds()
+ */
+internalfn void
+ConcurrencyLimitThrottle(struct concurrency_limit *limit, u64 now)
+{
+  ConcurrencyLimitDecrease(limit, 1, 2, now);
+}
@@ -0,0 +1,494 @@
+#pragma once
+
+/*
+ * Pool of TLS connections, keyed by host and port
+ *
+ * Connections are kept open after their requests are answered and handed out
+ * again, so TCP connect and TLS handshake are paid once for many requests.
+ * Idle connection is checked before it is handed out, one that server closed
+ * meanwhile is dropped. Connections of a host are capped, and idle ones are
+ * closed after idle timeout, so server does not have to.
+ *
+ * Every completion of transport goes through ConnectionPoolComplete(), which
+ * takes care of idle connections and gives back data of ones in use.
+ *
+ * With session cache, new connections resume TLS session of an earlier one
+ * to same host, and sessions that server gives tickets for are stored.
+ *
+ * New connections race addresses of host, see TlsConnectionConnectAny(). The
+ * one that connected last is tried first.
+ *
+ * Plain host, http://, is another host than same hostname and port over TLS.
+ * Its connections skip TLS, see tls_connection.isPlain.
+ *
+ * Times connection started connecting, connected and finished handshake are
+ * kept, requests that waited for it tell connect and TLS apart with them.
+ *
+ * @code
+ *   ConnectionPoolInit(&pool, arena, &transport, &sslConfig, &options)
+ *   pooled = ConnectionPoolAcquire(&pool, &hostname, &port, isPlain, addresses, addressCount, request)
+ *   // pooled->tls is connecting, or already open when it is reused
+ *   while (...) {
+ *     timeout = ConnectionPoolTimeout(&pool, NowInNanoseconds())
+ *     PlatformTransportWait(&transport, completions, ..., timeout)
+ *     request = ConnectionPoolComplete(&pool, &completion)
+ *     if (request) move request forward, ConnectionPoolHandshake() while handshaking
+ *     ConnectionPoolEvict(&pool, NowInNanoseconds())
+ *   }
+ *   ConnectionPoolRelease(&pool, pooled, isKeepAlive, NowInNanoseconds())
+ * @endcode
+ */
+
+#include "memory.h"
+#include "platform.h"
+#include "platform_transport.h"
+#include "text.h"
+#include "tls_connection.c"
+#include "tls_session_cache.c"
+#include "type.h"
+
+enum {
+  // see RFC 1035 2.3.4. Size limits
+  CONNECTION_POOL_HOSTNAME_MAX = 255,
+  CONNECTION_POOL_PORT_MAX = 5,
+  CONNECTION_POOL_ADDRESS_MAX = 16,
+};
+
+struct connection_pool_host;
+
+struct pooled_connection {
+  // tls.socket.data is pooled connection
+  struct tls_connection tls;
+  b8 isTlsInitialized;
+
+  // 0 when connection is free
+  struct connection_pool_host *host;
+  // given back by ConnectionPoolComplete() while connection is in use
+  void *data;
+
+  // in nanoseconds, see NowInNanoseconds(), when connection was made, for
+  // timing requests that waited for it. 0 until it gets there.
+  u64 connectingAt;
+  u64 connectedAt;
+  // handshake is done, see ConnectionPoolHandshake()
+  u64 openedAt;
+
+  b8 isIdle;
+  // in nanoseconds, see NowInNanoseconds()
+  u64 idleSince;
+  // idle list of host when idle, free list of pool when free
+  struct pooled_connection *next;
+};
+
+struct connection_pool_host {
+  // zero terminated
+  u8 hostnameBuffer[CONNECTION_POOL_HOSTNAME_MAX + 1];
+  struct string hostname;
+  u8 portBuffer[CONNECTION_POOL_PORT_MAX + 1];
+  struct string port;
+  // http://, connections do not do TLS
+  b8 isPlain;
+  // in order they are tried
+  struct platform_address addresses[CONNECTION_POOL_ADDRESS_MAX];
+  u32 addressCount;
+  // one that connected last, new connections try it first
+  u32 addressPreferred;
+
+  // idle and in use
+  u32 connectionCount;
+  // most recently released first, it is most likely alive
+  struct pooled_connection *idle;
+};
+
+struct connection_pool_options {
+  // connections of every host
+  u32 connectionMax;
+  u32 hostMax;
+  u32 hostConnectionMax;
+  u32 idleTimeoutInMilliseconds;
+  // can be 0
+  struct tls_session_cache *sessionCache;
+};
+
+struct connection_pool {
+  struct platform_transport *transport;
+  struct tls_backend_config *tlsConfig;
+
+  struct pooled_connection *connections;
+  u32 connectionMax;
+  struct pooled_connection *free;
+
+  struct connection_pool_host *hosts;
+  u32 hostCount;
+  u32 hostMax;
+
+  u32 hostConnectionMax;
+  u64 idleTimeout;
+
+  struct tls_session_cache *sessionCache;
+};
+
+internalfn void
+ConnectionPoolInit(struct connection_pool *pool, memory_arena *arena, struct platform_transport *transport,
+                   struct tls_backend_config *tlsConfig, struct connection_pool_options *options)
+{
+  debug_assert(options->connectionMax > 0 && options->hostMax > 0 && options->hostConnectionMax > 0);
+
+  *pool = (struct connection_pool){
+      .transport = transport,
+      .tlsConfig = tlsConfig,
+      .connectionMax = options->connectionMax,
+      .hostMax = options->hostMax,
+      .hostConnectionMax = options->hostConnectionMax,
+      .idleTimeout = (u64)options->idleTimeoutInMilliseconds * 1000000 /* 1e6 */,
+      .sessionCache = options->sessionCache,
+  };
+
+  pool->connections = MemoryArenaPush(arena, sizeof(*pool->connections) * pool->connectionMax);
+  for (u32 connectionIndex = pool->connectionMax; connectionIndex > 0; connectionIndex--) {
+    struct pooled_connection *pooled = pool->connections + connectionIndex - 1;
+    *pooled = (struct pooled_connection){.next = pool->free};
+    pool->free = pooled;
+  }
+
+  pool->hosts = MemoryArenaPush(arena, sizeof(*pool->hosts) * pool->hostMax);
+}
+
+/*
+ * Whether idle connection can be handed out. Receive and send completions of
+ * idle connection end it, so only socket has to be asked when they did not.
+ */
+internalfn b8
+ConnectionPoolIsAlive(struct pooled_connection *pooled)
+{
+  struct tls_connection *tls = &pooled->tls;
+  return tls->state == TLS_CONNECTION_STATE_OPEN && !tls->isReceiveEnded && tls->receivedCount == 0 &&
+         tls->sendResult == 0 && PlatformSocketIsAlive(tls->socket.fd);
+}
+
+/*
+ * Stores session of connection once server gives a ticket for it.
+ */
+internalfn void
+ConnectionPoolStoreSession(struct connection_pool *pool, struct pooled_connection *pooled)
+{
+  struct tls_connection *tls = &pooled->tls;
+  if (!pool->sessionCache || !tls->isSessionTicketReceived)
+    return;
+
+  TlsSessionCacheStore(pool->sessionCache, &pooled->host->hostname, &pooled->host->port, &tls->backend,
+                       PlatformUnixTime());
+  tls->isSessionTicketReceived = 0;
+}
+
+/*
+ * Closes connection and puts it to free list. It must not be on idle list.
+ */
+internalfn void
+ConnectionPoolDiscard(struct connection_pool *pool, struct pooled_connection *pooled)
+{
+  debug_assert(pooled->host && !pooled->isIdle);
+
+  ConnectionPoolStoreSession(pool, pooled);
+  if (pooled->isTlsInitialized)
+    TlsConnectionClose(&pooled->tls);
+  pooled->host->connectionCount--;
+  pooled->host = 0;
+  pooled->data = 0;
+  pooled->next = pool->free;
+  pool->free = pooled;
+}
+
+internalfn void
+ConnectionPoolRemoveIdle(struct pooled_connection *pooled)
+{
+  struct pooled_connection **link = &pooled->host->idle;
+  while (*link != pooled)
+    link = &(*link)->next;
+  *link = pooled->next;
+  pooled->next = 0;
+  pooled->isIdle = 0;
+}
+
+/*
+ * Frees a connection for another host by closing the longest idle one.
+ * @return false when every connection is in use
+ */
+internalfn b8
+ConnectionPoolEvictOldest(struct connection_pool *pool)
+{
+  struct pooled_connection *oldest = 0;
+  for (u32 connectionIndex = 0; connectionIndex < pool->connectionMax; connectionIndex++) {
+    struct pooled_connection *pooled = pool->connections + connectionIndex;
+    if (pooled->isIdle && (!oldest || pooled->idleSince < oldest->idleSince))
+      oldest = pooled;
+  }
+
+  if (!oldest)
+    return 0;
+
+  ConnectionPoolRemoveIdle(oldest);
+  ConnectionPoolDiscard(pool, oldest);
+  return 1;
+}
+
+internalfn struct connection_pool_host *
+ConnectionPoolHost(struct connection_pool *pool, struct string *hostname, struct string *port, b8 isPlain,
+                   struct platform_address *addresses, u32 addressCount)
+{
+  for (u32 hostIndex = 0; hostIndex < pool->hostCount; hostIndex++) {
+    struct connection_pool_host *host = pool->hosts + hostIndex;
+    if (IsStringEqual(&host->hostname, hostname) && IsStringEqual(&host->port, port) && host->isPlain == isPlain)
+      return host;
+  }
+
+  if (hostname->length > CONNECTION_POOL_HOSTNAME_MAX || port->length > CONNECTION_POOL_PORT_MAX ||
+      addressCount == 0)
+    return 0;
+
+  struct connection_pool_host *host = 0;
+  if (pool->hostCount < pool->hostMax) {
+    host = pool->hosts + pool->hostCount;
+    pool->hostCount++;
+  } else {
+    // take place of host that has no connections left
+    for (u32 hostIndex = 0; hostIndex < pool->hostCount; hostIndex++) {
+      if (pool->hosts[hostIndex].connectionCount == 0) {
+        host = pool->hosts + hostIndex;
+        break;
+      }
+    }
+    if (!host)
+      return 0;
+  }
+
+  MemoryCopy(host->hostnameBuffer, hostname->value, hostname->length);
+  host->hostnameBuffer[hostname->length] = 0;
+  host->hostname = StringFromBuffer(host->hostnameBuffer, hostname->length);
+  MemoryCopy(host->portBuffer, port->value, port->length);
+  host->portBuffer[port->length] = 0;
+  host->port = StringFromBuffer(host->portBuffer, port->length);
+  host->isPlain = isPlain;
+  // connecting sockets point to them, so they stay in place
+  if (addressCount > CONNECTION_POOL_ADDRESS_MAX)
+    addressCount = CONNECTION_POOL_ADDRESS_MAX;
+  MemoryCopy(host->addresses, addresses, sizeof(*addresses) * addressCount);
+  host->addressCount = addressCount;
+  host->addressPreferred = 0;
+  host->connectionCount = 0;
+  host->idle = 0;
+  return host;
+}
+
+/*
+ * Hands out idle connection to host, or starts a new one when none of idle
+ * ones is alive.
+ * @param hostname server certificate is checked for it
+ * @param isPlain connections go over plain TCP, for http:// servers
+ * @param addresses used when connecting, in order they are tried, pool keeps a
+ *        copy
+ * @param data given back by ConnectionPoolComplete()
+ * @return connection, tls is open when it is reused, connecting when it is new
+ *         and failed when connecting failed, see tls.error
+ *         0 when host has as many connections as it can have, or every
+ *         connection of pool is in use
+ */
+internalfn struct pooled_connection *
+ConnectionPoolAcquire(struct connection_pool *pool, struct string *hostname, struct string *port, b8 isPlain,
+                      struct platform_address *addresses, u32 addressCount, void *data)
+{
+  struct connection_pool_host *host = ConnectionPoolHost(pool, hostname, port, isPlain, addresses, addressCount);
+  if (!host)
+    return 0;
+
+  while (host->idle) {
+    struct pooled_connection *pooled = host->idle;
+    ConnectionPoolRemoveIdle(pooled);
+    if (ConnectionPoolIsAlive(pooled)) {
+      pooled->data = data;
+      return pooled;
+    }
+    ConnectionPoolDiscard(pool, pooled);
+  }
+
+  if (host->connectionCount == pool->hostConnectionMax)
+    return 0;
+  if (!pool->free && !ConnectionPoolEvictOldest(pool))
+    return 0;
+
+  struct pooled_connection *pooled = pool->free;
+  pool->free = pooled->next;
+  pooled->next = 0;
+  pooled->host = host;
+  pooled->data = data;
+  host->connectionCount++;
+
+  // set up once, TLS library forgets connection when it is closed
+  if (!pooled->isTlsInitialized) {
+    if (!TlsConnectionInit(&pooled->tls, pool->tlsConfig, pool->transport, pooled))
+      return pooled;
+    pooled->isTlsInitialized = 1;
+  }
+
+  if (pooled->tls.state == TLS_CONNECTION_STATE_CLOSED) {
+    // connection may have been one of another host
+    pooled->tls.isPlain = host->isPlain;
+    if (pool->sessionCache && !host->isPlain)
+      TlsSessionCacheResume(pool->sessionCache, &host->hostname, &host->port, &pooled->tls.backend,
+                            PlatformUnixTime());
+    pooled->connectingAt = NowInNanoseconds();
+    pooled->connectedAt = 0;
+    pooled->openedAt = 0;
+    TlsConnectionConnectAny(&pooled->tls, host->addresses, host->addressCount, host->addressPreferred, &host->hostname,
+                            pooled->connectingAt);
+  }
+  return pooled;
+}
+
+/*
+ * Gives connection back.
+ * @param isReusable false when server closes connection after response, or
+ *        response is not read to the end
+ * @param now see NowInNanoseconds()
+ */
+internalfn void
+ConnectionPoolRelease(struct connection_pool *pool, struct pooled_connection *pooled, b8 isReusable, u64 now)
+{
+  debug_assert(pooled->host && !pooled->isIdle);
+
+  ConnectionPoolStoreSession(pool, pooled);
+  struct tls_connection *tls = &pooled->tls;
+  if (!isReusable || tls->state != TLS_CONNECTION_STATE_OPEN || tls->isReceiveEnded || tls->receivedCount != 0 ||
+      tls->sendResult != 0) {
+    ConnectionPoolDiscard(pool, pooled);
+    return;
+  }
+
+  pooled->data = 0;
+  pooled->isIdle = 1;
+  pooled->idleSince = now;
+  pooled->next = pooled->host->idle;
+  pooled->host->idle = pooled;
+}
+
+/*
+ * Takes completion of any pooled connection. Idle connection that is closed by
+ * server, or receives something, is closed.
+ * @return data of connection when it is in use, 0 otherwise
+ */
+internalfn void *
+ConnectionPoolComplete(struct connection_pool *pool, struct platform_completion *completion)
+{
+  struct pooled_connection *pooled = completion->data;
+  enum tls_connection_state state = pooled->tls.state;
+  TlsConnectionComplete(&pooled->tls, completion);
+  u64 now = NowInNanoseconds();
+  TlsConnectionAttempt(&pooled->tls, now);
+  struct connection_pool_host *host = pooled->host;
+  if (state == TLS_CONNECTION_STATE_CONNECTING && (pooled->tls.state == TLS_CONNECTION_STATE_HANDSHAKING ||
+                                                   pooled->tls.state == TLS_CONNECTION_STATE_OPEN)) {
+    pooled->connectedAt = now;
+    // plain connection has no handshake
+    if (pooled->tls.state == TLS_CONNECTION_STATE_OPEN)
+      pooled->openedAt = now;
+    if (host)
+      host->addressPreferred = (u32)(pooled->tls.socket.address - host->addresses);
+  }
+  if (!pooled->isIdle)
+    return pooled->data;
+
+  struct tls_connection *tls = &pooled->tls;
+  if (tls->state != TLS_CONNECTION_STATE_OPEN || tls->isReceiveEnded || tls->receivedCount != 0 ||
+      tls->sendResult != 0) {
+    ConnectionPoolRemoveIdle(pooled);
+    ConnectionPoolDiscard(pool, pooled);
+  }
+  return 0;
+}
+
+/*
+ * Moves handshake of connection forward, see TlsConnectionHandshake(), and
+ * keeps time it is done.
+ * @param now see NowInNanoseconds()
+ * @return state of connection
+ */
+internalfn enum tls_connection_state
+ConnectionPoolHandshake(struct pooled_connection *pooled, u64 now)
+{
+  if (pooled->tls.state != TLS_CONNECTION_STATE_HANDSHAKING)
+    return pooled->tls.state;
+
+  if (TlsConnectionHandshake(&pooled->tls) == TLS_CONNECTION_STATE_OPEN)
+    pooled->openedAt = now;
+  return pooled->tls.state;
+}
+
+/*
+ * @param now see NowInNanoseconds()
+ * @return milliseconds until next idle connection times out or next connection
+ *         attempt is due, -1 when there is none, see PlatformTransportWait()
+ */
+internalfn s32
+ConnectionPoolTimeout(struct connection_pool *pool, u64 now)
+{
+  u64 timeout = (u64)-1;
+  for (u32 connectionIndex = 0; connectionIndex < pool->connectionMax; connectionIndex++) {
+    struct pooled_connection *pooled = pool->connections + connectionIndex;
+    if (pooled->host && pooled->isTlsInitialized) {
+      u64 remaining = TlsConnectionAttemptTimeout(&pooled->tls, now);
+      if (remaining < timeout)
+        timeout = remaining;
+    }
+    if (!pooled->isIdle)
+      continue;
+
+    u64 idleDuration = now - pooled->idleSince;
+    u64 remaining = idleDuration < pool->idleTimeout ? pool->idleTimeout - idleDuration : 0;
+    if (remaining < timeout)
+      timeout = remaining;
+  }
+
+  if (timeout == (u64)-1)
+    return -1;
+  // rounded up, so it has passed when wait returns
+  u64 timeoutInMilliseconds = (timeout + 999999) / 1000000 /* 1e6 */;
+  return timeoutInMilliseconds > 0x7fffffff ? 0x7fffffff : (s32)timeoutInMilliseconds;
+}
+
+/*
+ * Closes connections that are idle for longer than idle timeout, and starts
+ * connection attempts that are due.
+ * @param now see NowInNanoseconds()
+ */
+internalfn void
+ConnectionPoolEvict(struct connection_pool *pool, u64 now)
+{
+  for (u32 connectionIndex = 0; connectionIndex < pool->connectionMax; connectionIndex++) {
+    struct pooled_connection *pooled = pool->connections + connectionIndex;
+    if (pooled->host && pooled->isTlsInitialized)
+      TlsConnectionAttempt(&pooled->tls, now);
+    if (pooled->isIdle && now - pooled->idleSince >= pool->idleTimeout) {
+      ConnectionPoolRemoveIdle(pooled);
+      ConnectionPoolDiscard(pool, pooled);
+    }
+  }
+}
+
+/*
+ * Closes every connection, none of them can be in use.
+ */
+internalfn void
+ConnectionPoolClose(struct connection_pool *pool)
+{
+  for (u32 connectionIndex = 0; connectionIndex < pool->connectionMax; connectionIndex++) {
+    struct pooled_connection *pooled = pool->connections + connectionIndex;
+    if (pooled->isIdle)
+      ConnectionPoolRemoveIdle(pooled);
+    if (pooled->host)
+      ConnectionPoolDiscard(pool, pooled);
+    if (pooled->isTlsInitialized) {
+      TlsConnectionRelease(&pooled->tls);
+      pooled->isTlsInitialized = 0;
+    }
+  }
+}
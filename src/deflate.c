@@ -0,0 +1,557 @@
+#pragma once
+
+/*
+ * DEFLATE and gzip compression
+ * https://www.rfc-editor.org/rfc/rfc1951
+ * https://www.rfc-editor.org/rfc/rfc1952
+ *
+ * Input is turned into literal octets and back references (length, distance)
+ * to text seen in last 32 KiB. Matches are found through hash chains: every
+ * position is linked to previous position whose next 3 octets hash same.
+ * Matching is lazy, a match is dropped for a literal when next position has a
+ * longer one.
+ *
+ * Symbols are written with fixed Huffman codes. Dynamic codes compress a
+ * little better but need every block to be counted and coded twice, request
+ * bodies are sent once so that is not worth it. Block that does not compress
+ * is stored as is.
+ *
+ * @code
+ *   encoder = MakeDeflateEncoder(arena);
+ *   buffer = MakeString(arena, GzipBound(input.length));
+ *   compressed = GzipCompress(encoder, &input, buffer);
+ * @endcode
+ */
+
+#include "assert.h"
+#include "memory.h"
+#include "text.h"
+#include "type.h"
+
+enum {
+  DEFLATE_WINDOW_SIZE = 1 << 15,
+  DEFLATE_WINDOW_MASK = DEFLATE_WINDOW_SIZE - 1,
+  // furthest back reference, one less than window so a position never links
+  // to itself through a reused chain slot
+  DEFLATE_DISTANCE_MAX = DEFLATE_WINDOW_SIZE - 1,
+  DEFLATE_MATCH_MIN = 3,
+  DEFLATE_MATCH_MAX = 258,
+  DEFLATE_HASH_BITS = 15,
+  DEFLATE_HASH_SIZE = 1 << DEFLATE_HASH_BITS,
+  // symbols of a block are collected before block is written
+  DEFLATE_BLOCK_SYMBOL_MAX = 1 << 14,
+  DEFLATE_STORED_LENGTH_MAX = 65535,
+  DEFLATE_END_OF_BLOCK = 256,
+  GZIP_HEADER_LENGTH = 10,
+  GZIP_TRAILER_LENGTH = 8,
+};
+
+struct deflate_symbol {
+  // literal octet, or match length when distance is not 0
+  u16 literalOrLength;
+  u16 distance;
+};
+
+struct deflate_encoder {
+  // position + 1 of newest octets with same hash, 0 when there is none
+  u32 *head;
+  // position + 1 of previous octets with same hash, indexed by position in
+  // window
+  u32 *previous;
+  u32 symbolCount;
+  struct deflate_symbol *symbols;
+
+  // searching stops after this many chain links
+  u32 chainMax;
+  // match this long is not improved by looking at next position
+  u32 lazyMax;
+  // when match is already this long, only a quarter of chain is searched
+  u32 goodLength;
+  // match this long stops search
+  u32 niceLength;
+
+  // fixed Huffman codes, bit reversed as they are written least significant
+  // bit first
+  u16 literalCodes[288];
+  u8 literalCodeLengths[288];
+  u8 distanceCodes[30];
+};
+
+struct deflate_bit_writer {
+  u8 *output;
+  u64 bits;
+  u32 bitCount;
+};
+
+comptime u16 DEFLATE_LENGTH_BASE[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                        31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+comptime u8 DEFLATE_LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                        2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+comptime u16 DEFLATE_DISTANCE_BASE[30] = {1,    2,    3,    4,    5,    7,    9,    13,    17,    25,
+                                          33,   49,   65,   97,   129,  193,  257,  385,   513,   769,
+                                          1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+comptime u8 DEFLATE_DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                          6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+internalfn u32
+DeflateReverseBits(u32 code, u32 length)
+{
+  u32 reversed = 0;
+  for (u32 index = 0; index < length; index++) {
+    reversed = (reversed << 1) | (code & 1);
+    code >>= 1;
+  }
+  return reversed;
+}
+
+internalfn struct deflate_encoder *
+MakeDeflateEncoder(memory_arena *arena)
+{
+  struct deflate_encoder *encoder = MemoryArenaPush(arena, sizeof(*encoder));
+  encoder->head = MemoryArenaPush(arena, sizeof(*encoder->head) * DEFLATE_HASH_SIZE);
+  encoder->previous = MemoryArenaPush(arena, sizeof(*encoder->previous) * DEFLATE_WINDOW_SIZE);
+  encoder->symbols = MemoryArenaPush(arena, sizeof(*encoder->symbols) * DEFLATE_BLOCK_SYMBOL_MAX);
+  encoder->symbolCount = 0;
+
+  // same as zlib level 6
+  encoder->chainMax = 128;
+  encoder->lazyMax = 16;
+  encoder->goodLength = 8;
+  encoder->niceLength = 128;
+
+  // https://www.rfc-editor.org/rfc/rfc1951#section-3.2.6
+  for (u32 symbol = 0; symbol < 288; symbol++) {
+    u32 code;
+    u32 length;
+    if (symbol < 144) {
+      code = 0x30 + symbol;
+      length = 8;
+    } else if (symbol < 256) {
+      code = 0x190 + (symbol - 144);
+      length = 9;
+    } else if (symbol < 280) {
+      code = symbol - 256;
+      length = 7;
+    } else {
+      code = 0xc0 + (symbol - 280);
+      length = 8;
+    }
+    encoder->literalCodes[symbol] = (u16)DeflateReverseBits(code, length);
+    encoder->literalCodeLengths[symbol] = (u8)length;
+  }
+  for (u32 symbol = 0; symbol < 30; symbol++)
+    encoder->distanceCodes[symbol] = (u8)DeflateReverseBits(symbol, 5);
+
+  return encoder;
+}
+
+/*
+ * @return maximum length of deflate stream for input
+ */
+internalfn u64
+DeflateBound(u64 inputLength)
+{
+  // block is only written with Huffman codes when it is not bigger than
+  // stored, stored costs 5 octets every 64 KiB and 1 octet for alignment every
+  // block, a block has at least 16384 octets unless it is last
+  return inputLength + inputLength / 2048 + 16;
+}
+
+/*
+ * @return maximum length of gzip member for input
+ */
+internalfn u64
+GzipBound(u64 inputLength)
+{
+  return GZIP_HEADER_LENGTH + DeflateBound(inputLength) + GZIP_TRAILER_LENGTH;
+}
+
+internalfn u32
+DeflateLengthSymbol(u32 length)
+{
+  // 3..10 have no extra bits, then every 4 symbols extra bits grow by 1
+  u32 value = length - DEFLATE_MATCH_MIN;
+  if (length == DEFLATE_MATCH_MAX)
+    return 28;
+  if (value < 8)
+    return value;
+  u32 log2 = 31 - (u32)__builtin_clz(value);
+  return 4 * (log2 - 1) + ((value >> (log2 - 2)) & 3);
+}
+
+internalfn u32
+DeflateDistanceSymbol(u32 distance)
+{
+  // 1..4 have no extra bits, then every 2 symbols extra bits grow by 1
+  u32 value = distance - 1;
+  if (value < 4)
+    return value;
+  u32 log2 = 31 - (u32)__builtin_clz(value);
+  return 2 * log2 + ((value >> (log2 - 1)) & 1);
+}
+
+internalfn inline void
+DeflateWriteBits(struct deflate_bit_writer *writer, u32 value, u32 length)
+{
+  debug_assert(length <= 32 && writer->bitCount < 32);
+  writer->bits |= (u64)value << writer->bitCount;
+  writer->bitCount += length;
+  if (writer->bitCount >= 32) {
+    u32 word = (u32)writer->bits;
+    writer->output[0] = (u8)(word);
+    writer->output[1] = (u8)(word >> 8);
+    writer->output[2] = (u8)(word >> 16);
+    writer->output[3] = (u8)(word >> 24);
+    writer->output += 4;
+    writer->bits >>= 32;
+    writer->bitCount -= 32;
+  }
+}
+
+/*
+ * Pads to octet boundary and writes pending bits.
+ */
+internalfn void
+DeflateAlign(struct deflate_bit_writer *writer)
+{
+  while (writer->bitCount > 0) {
+    *writer->output++ = (u8)writer->bits;
+    writer->bits >>= 8;
+    writer->bitCount = writer->bitCount > 8 ? writer->bitCount - 8 : 0;
+  }
+  writer->bits = 0;
+}
+
+/*
+ * Writes collected symbols that cover input as one or more blocks.
+ */
+internalfn void
+DeflateWriteBlock(struct deflate_encoder *encoder, struct deflate_bit_writer *writer, struct string *input,
+                  b8 isFinal)
+{
+  // cost of fixed codes in bits
+  u64 fixedBits = 3 + 7 /* end of block */;
+  for (u32 symbolIndex = 0; symbolIndex < encoder->symbolCount; symbolIndex++) {
+    struct deflate_symbol *symbol = encoder->symbols + symbolIndex;
+    if (symbol->distance == 0) {
+      fixedBits += encoder->literalCodeLengths[symbol->literalOrLength];
+    } else {
+      u32 lengthSymbol = DeflateLengthSymbol(symbol->literalOrLength);
+      u32 distanceSymbol = DeflateDistanceSymbol(symbol->distance);
+      fixedBits += (u32)encoder->literalCodeLengths[257 + lengthSymbol] + DEFLATE_LENGTH_EXTRA[lengthSymbol] + 5 +
+                   DEFLATE_DISTANCE_EXTRA[distanceSymbol];
+    }
+  }
+  u64 storedChunkCount = (input->length + DEFLATE_STORED_LENGTH_MAX - 1) / DEFLATE_STORED_LENGTH_MAX;
+  if (storedChunkCount == 0)
+    storedChunkCount = 1;
+  u64 storedBits = (input->length + storedChunkCount * 5) * 8;
+
+  if (storedBits < fixedBits) {
+    // https://www.rfc-editor.org/rfc/rfc1951#section-3.2.4
+    u64 position = 0;
+    for (u64 chunkIndex = 0; chunkIndex < storedChunkCount; chunkIndex++) {
+      u64 length = input->length - position;
+      if (length > DEFLATE_STORED_LENGTH_MAX)
+        length = DEFLATE_STORED_LENGTH_MAX;
+      b8 isLast = isFinal && chunkIndex + 1 == storedChunkCount;
+      DeflateWriteBits(writer, isLast ? 1 : 0, 3);
+      DeflateAlign(writer);
+      writer->output[0] = (u8)length;
+      writer->output[1] = (u8)(length >> 8);
+      writer->output[2] = (u8)~length;
+      writer->output[3] = (u8)(~length >> 8);
+      MemoryCopy(writer->output + 4, input->value + position, length);
+      writer->output += 4 + length;
+      position += length;
+    }
+  } else {
+    // https://www.rfc-editor.org/rfc/rfc1951#section-3.2.6
+    DeflateWriteBits(writer, (isFinal ? 1 : 0) | (1 << 1), 3);
+    for (u32 symbolIndex = 0; symbolIndex < encoder->symbolCount; symbolIndex++) {
+      struct deflate_symbol *symbol = encoder->symbols + symbolIndex;
+      if (symbol->distance == 0) {
+        u32 literal = symbol->literalOrLength;
+        DeflateWriteBits(writer, encoder->literalCodes[literal], encoder->literalCodeLengths[literal]);
+        continue;
+      }
+
+      u32 length = symbol->literalOrLength;
+      u32 lengthSymbol = DeflateLengthSymbol(length);
+      u32 lengthCode = 257 + lengthSymbol;
+      DeflateWriteBits(writer, encoder->literalCodes[lengthCode], encoder->literalCodeLengths[lengthCode]);
+      DeflateWriteBits(writer, length - DEFLATE_LENGTH_BASE[lengthSymbol], DEFLATE_LENGTH_EXTRA[lengthSymbol]);
+
+      u32 distance = symbol->distance;
+      u32 distanceSymbol = DeflateDistanceSymbol(distance);
+      DeflateWriteBits(writer, encoder->distanceCodes[distanceSymbol], 5);
+      DeflateWriteBits(writer, distance - DEFLATE_DISTANCE_BASE[distanceSymbol],
+                       DEFLATE_DISTANCE_EXTRA[distanceSymbol]);
+    }
+    DeflateWriteBits(writer, encoder->literalCodes[DEFLATE_END_OF_BLOCK],
+                     encoder->literalCodeLengths[DEFLATE_END_OF_BLOCK]);
+  }
+
+  encoder->symbolCount = 0;
+}
+
+internalfn inline u32
+DeflateHash(u8 *octets)
+{
+  u32 value = (u32)octets[0] | (u32)octets[1] << 8 | (u32)octets[2] << 16;
+  return (value * 2654435761u) >> (32 - DEFLATE_HASH_BITS);
+}
+
+/*
+ * Links position to chain of its hash.
+ * @return position + 1 of previous octets with same hash, 0 if there is none
+ */
+internalfn inline u32
+DeflateInsert(struct deflate_encoder *encoder, struct string *input, u64 position)
+{
+  u32 hash = DeflateHash(input->value + position);
+  u32 candidate = encoder->head[hash];
+  encoder->previous[position & DEFLATE_WINDOW_MASK] = candidate;
+  encoder->head[hash] = (u32)position + 1;
+  return candidate;
+}
+
+/*
+ * Walks chain for longest match at position.
+ * @return length of match if it is longer than minimum and previousLength,
+ *         0 otherwise
+ */
+internalfn u32
+DeflateLongestMatch(struct deflate_encoder *encoder, struct string *input, u64 position, u32 candidate,
+                    u32 previousLength, u32 *distance)
+{
+  u32 chainLength = encoder->chainMax;
+  if (previousLength >= encoder->goodLength)
+    chainLength >>= 2;
+
+  u64 remaining = input->length - position;
+  u32 lengthMax = remaining < DEFLATE_MATCH_MAX ? (u32)remaining : DEFLATE_MATCH_MAX;
+  u32 niceLength = encoder->niceLength < lengthMax ? encoder->niceLength : lengthMax;
+  u32 bestLength = previousLength > DEFLATE_MATCH_MIN - 1 ? previousLength : DEFLATE_MATCH_MIN - 1;
+  if (bestLength >= lengthMax)
+    return 0;
+
+  u64 limit = position > DEFLATE_DISTANCE_MAX ? position - DEFLATE_DISTANCE_MAX : 0;
+  u8 *current = input->value + position;
+  u32 bestDistance = 0;
+  while (candidate != 0 && chainLength-- > 0) {
+    u64 candidatePosition = candidate - 1;
+    if (candidatePosition < limit)
+      break;
+
+    u8 *match = input->value + candidatePosition;
+    // octet after best length must match to be longer
+    if (match[bestLength] == current[bestLength] && match[0] == current[0]) {
+      u32 length = 0;
+      while (length + 8 <= lengthMax) {
+        u64 left;
+        u64 right;
+        MemoryCopy(&left, current + length, sizeof(left));
+        MemoryCopy(&right, match + length, sizeof(right));
+        u64 difference = left ^ right;
+        if (difference != 0) {
+          length += (u32)__builtin_ctzll(difference) / 8;
+          goto compared;
+        }
+        length += 8;
+      }
+      while (length < lengthMax && current[length] == match[length])
+        length++;
+    compared:
+
+      if (length > bestLength) {
+        bestLength = length;
+        bestDistance = (u32)(position - candidatePosition);
+        if (length >= niceLength)
+          break;
+      }
+    }
+
+    u32 next = encoder->previous[candidatePosition & DEFLATE_WINDOW_MASK];
+    // chain always goes back, a newer position means slot was reused
+    if (next >= candidate)
+      break;
+    candidate = next;
+  }
+
+  if (bestDistance == 0)
+    return 0;
+  // short match far back costs more than 3 literals
+  if (bestLength == DEFLATE_MATCH_MIN && bestDistance > 4096)
+    return 0;
+
+  *distance = bestDistance;
+  return bestLength;
+}
+
+internalfn inline void
+DeflatePushSymbol(struct deflate_encoder *encoder, struct deflate_bit_writer *writer, struct string *input,
+                  u64 *blockStart, u64 blockEnd, u32 literalOrLength, u32 distance)
+{
+  struct deflate_symbol *symbol = encoder->symbols + encoder->symbolCount++;
+  symbol->literalOrLength = (u16)literalOrLength;
+  symbol->distance = (u16)distance;
+
+  if (encoder->symbolCount == DEFLATE_BLOCK_SYMBOL_MAX) {
+    struct string block = StringFromBuffer(input->value + *blockStart, blockEnd - *blockStart);
+    DeflateWriteBlock(encoder, writer, &block, 0);
+    *blockStart = blockEnd;
+  }
+}
+
+/*
+ * Compresses input as raw deflate stream into buffer.
+ * @return compressed
+ *         null if buffer is smaller than DeflateBound()
+ */
+internalfn struct string
+DeflateCompress(struct deflate_encoder *encoder, struct string *input, struct string *buffer)
+{
+  if (buffer->length < DeflateBound(input->length) || input->length >= U32_MAX)
+    return StringNull();
+
+  MemoryClear(encoder->head, sizeof(*encoder->head) * DEFLATE_HASH_SIZE);
+  encoder->symbolCount = 0;
+
+  struct deflate_bit_writer writer = {.output = buffer->value};
+  u64 blockStart = 0;
+
+  u64 position = 0;
+  u32 previousLength = 0;
+  u32 previousDistance = 0;
+  // octet before position is not written yet, it may start a match
+  b8 isLiteralPending = 0;
+  while (position < input->length) {
+    u32 length = 0;
+    u32 distance = 0;
+    if (position + DEFLATE_MATCH_MIN <= input->length) {
+      u32 candidate = DeflateInsert(encoder, input, position);
+      if (candidate != 0 && previousLength < encoder->lazyMax)
+        length = DeflateLongestMatch(encoder, input, position, candidate, previousLength, &distance);
+    }
+
+    if (previousLength >= DEFLATE_MATCH_MIN && length <= previousLength) {
+      // match that starts at previous position is better
+      u64 matchEnd = position - 1 + previousLength;
+      DeflatePushSymbol(encoder, &writer, input, &blockStart, matchEnd, previousLength, previousDistance);
+      for (position++; position < matchEnd; position++) {
+        if (position + DEFLATE_MATCH_MIN <= input->length)
+          DeflateInsert(encoder, input, position);
+      }
+      isLiteralPending = 0;
+      previousLength = 0;
+      continue;
+    }
+
+    if (isLiteralPending)
+      DeflatePushSymbol(encoder, &writer, input, &blockStart, position, input->value[position - 1], 0);
+    isLiteralPending = 1;
+    previousLength = length;
+    previousDistance = distance;
+    position++;
+  }
+  if (isLiteralPending)
+    DeflatePushSymbol(encoder, &writer, input, &blockStart, position, input->value[position - 1], 0);
+
+  struct string block = StringFromBuffer(input->value + blockStart, input->length - blockStart);
+  DeflateWriteBlock(encoder, &writer, &block, 1);
+  DeflateAlign(&writer);
+
+  u64 length = (u64)(writer.output - buffer->value);
+  debug_assert(length <= DeflateBound(input->length));
+  return StringFromBuffer(buffer->value, length);
+}
+
+/*
+ * CRC-32 used by gzip, reflected polynomial 0xedb88320
+ * https://www.rfc-editor.org/rfc/rfc1952#section-8
+ */
+internalfn u32
+Crc32(u32 crc, struct string *input)
+{
+  comptime u32 CRC32_TABLE[256] = {
+      0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f, 0xe963a535, 0x9e6495a3,
+      0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988, 0x09b64c2b, 0x7eb17cbd, 0xe7b82d07, 0x90bf1d91,
+      0x1db71064, 0x6ab020f2, 0xf3b97148, 0x84be41de, 0x1adad47d, 0x6ddde4eb, 0xf4d4b551, 0x83d385c7,
+      0x136c9856, 0x646ba8c0, 0xfd62f97a, 0x8a65c9ec, 0x14015c4f, 0x63066cd9, 0xfa0f3d63, 0x8d080df5,
+      0x3b6e20c8, 0x4c69105e, 0xd56041e4, 0xa2677172, 0x3c03e4d1, 0x4b04d447, 0xd20d85fd, 0xa50ab56b,
+      0x35b5a8fa, 0x42b2986c, 0xdbbbc9d6, 0xacbcf940, 0x32d86ce3, 0x45df5c75, 0xdcd60dcf, 0xabd13d59,
+      0x26d930ac, 0x51de003a, 0xc8d75180, 0xbfd06116, 0x21b4f4b5, 0x56b3c423, 0xcfba9599, 0xb8bda50f,
+      0x2802b89e, 0x5f058808, 0xc60cd9b2, 0xb10be924, 0x2f6f7c87, 0x58684c11, 0xc1611dab, 0xb6662d3d,
+      0x76dc4190, 0x01db7106, 0x98d220bc, 0xefd5102a, 0x71b18589, 0x06b6b51f, 0x9fbfe4a5, 0xe8b8d433,
+      0x7807c9a2, 0x0f00f934, 0x9609a88e, 0xe10e9818, 0x7f6a0dbb, 0x086d3d2d, 0x91646c97, 0xe6635c01,
+      0x6b6b51f4, 0x1c6c6162, 0x856530d8, 0xf262004e, 0x6c0695ed, 0x1b01a57b, 0x8208f4c1, 0xf50fc457,
+      0x65b0d9c6, 0x12b7e950, 0x8bbeb8ea, 0xfcb9887c, 0x62dd1ddf, 0x15da2d49, 0x8cd37cf3, 0xfbd44c65,
+      0x4db26158, 0x3ab551ce, 0xa3bc0074, 0xd4bb30e2, 0x4adfa541, 0x3dd895d7, 0xa4d1c46d, 0xd3d6f4fb,
+      0x4369e96a, 0x346ed9fc, 0xad678846, 0xda60b8d0, 0x44042d73, 0x33031de5, 0xaa0a4c5f, 0xdd0d7cc9,
+      0x5005713c, 0x270241aa, 0xbe0b1010, 0xc90c2086, 0x5768b525, 0x206f85b3, 0xb966d409, 0xce61e49f,
+      0x5edef90e, 0x29d9c998, 0xb0d09822, 0xc7d7a8b4, 0x59b33d17, 0x2eb40d81, 0xb7bd5c3b, 0xc0ba6cad,
+      0xedb88320, 0x9abfb3b6, 0x03b6e20c, 0x74b1d29a, 0xead54739, 0x9dd277af, 0x04db2615, 0x73dc1683,
+      0xe3630b12, 0x94643b84, 0x0d6d6a3e, 0x7a6a5aa8, 0xe40ecf0b, 0x9309ff9d, 0x0a00ae27, 0x7d079eb1,
+      0xf00f9344, 0x8708a3d2, 0x1e01f268, 0x6906c2fe, 0xf762575d, 0x806567cb, 0x196c3671, 0x6e6b06e7,
+      0xfed41b76, 0x89d32be0, 0x10da7a5a, 0x67dd4acc, 0xf9b9df6f, 0x8ebeeff9, 0x17b7be43, 0x60b08ed5,
+      0xd6d6a3e8, 0xa1d1937e, 0x38d8c2c4, 0x4fdff252, 0xd1bb67f1, 0xa6bc5767, 0x3fb506dd, 0x48b2364b,
+      0xd80d2bda, 0xaf0a1b4c, 0x36034af6, 0x41047a60, 0xdf60efc3, 0xa867df55, 0x316e8eef, 0x4669be79,
+      0xcb61b38c, 0xbc66831a, 0x256fd2a0, 0x5268e236, 0xcc0c7795, 0xbb0b4703, 0x220216b9, 0x5505262f,
+      0xc5ba3bbe, 0xb2bd0b28, 0x2bb45a92, 0x5cb36a04, 0xc2d7ffa7, 0xb5d0cf31, 0x2cd99e8b, 0x5bdeae1d,
+      0x9b64c2b0, 0xec63f226, 0x756aa39c, 0x026d930a, 0x9c0906a9, 0xeb0e363f, 0x72076785, 0x05005713,
+      0x95bf4a82, 0xe2b87a14, 0x7bb12bae, 0x0cb61b38, 0x92d28e9b, 0xe5d5be0d, 0x7cdcefb7, 0x0bdbdf21,
+      0x86d3d2d4, 0xf1d4e242, 0x68ddb3f8, 0x1fda836e, 0x81be16cd, 0xf6b9265b, 0x6fb077e1, 0x18b74777,
+      0x88085ae6, 0xff0f6a70, 0x66063bca, 0x11010b5c, 0x8f659eff, 0xf862ae69, 0x616bffd3, 0x166ccf45,
+      0xa00ae278, 0xd70dd2ee, 0x4e048354, 0x3903b3c2, 0xa7672661, 0xd06016f7, 0x4969474d, 0x3e6e77db,
+      0xaed16a4a, 0xd9d65adc, 0x40df0b66, 0x37d83bf0, 0xa9bcae53, 0xdebb9ec5, 0x47b2cf7f, 0x30b5ffe9,
+      0xbdbdf21c, 0xcabac28a, 0x53b39330, 0x24b4a3a6, 0xbad03605, 0xcdd70693, 0x54de5729, 0x23d967bf,
+      0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94, 0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
+  };
+
+  crc = ~crc;
+  for (u64 index = 0; index < input->length; index++)
+    crc = CRC32_TABLE[(crc ^ input->value[index]) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+/*
+ * Compresses input as gzip member into buffer.
+ * @return compressed
+ *         null if buffer is smaller than GzipBound()
+ */
+internalfn struct string
+GzipCompress(struct deflate_encoder *encoder, struct string *input, struct string *buffer)
+{
+  if (buffer->length < GzipBound(input->length))
+    return StringNull();
+
+  // https://www.rfc-editor.org/rfc/rfc1952#section-2.3
+  u8 *header = buffer->value;
+  header[0] = 0x1f; // ID1
+  header[1] = 0x8b; // ID2
+  header[2] = 8;    // CM, deflate
+  header[3] = 0;    // FLG
+  header[4] = 0;    // MTIME, not available
+  header[5] = 0;
+  header[6] = 0;
+  header[7] = 0;
+  header[8] = 0;    // XFL
+  header[9] = 255;  // OS, unknown
+
+  struct string deflateBuffer = StringFromBuffer(buffer->value + GZIP_HEADER_LENGTH,
+                                                 buffer->length - GZIP_HEADER_LENGTH - GZIP_TRAILER_LENGTH);
+  struct string compressed = DeflateCompress(encoder, input, &deflateBuffer);
+  if (IsStringNull(&compressed))
+    return StringNull();
+
+  u8 *trailer = compressed.value + compressed.length;
+  u32 crc = Crc32(0, input);
+  u32 inputSize = (u32)input->length;
+  for (u32 index = 0; index < 4; index++) {
+    trailer[index] = (u8)(crc >> (8 * index));
+    trailer[4 + index] = (u8)(inputSize >> (8 * index));
+  }
+
+  return StringFromBuffer(buffer->value, GZIP_HEADER_LENGTH + compressed.length + GZIP_TRAILER_LENGTH);
+}
@@ -0,0 +1,765 @@
+#pragma once
+
+/*
+ * DNS resolution that does not block, and cache of its answers
+ *
+ * System resolver blocks, and does not tell how long its answers are valid.
+ * Resolver here asks name server of system itself: AAAA and A queries go out
+ * at once over UDP, and answer lives as long as lowest TTL of its records.
+ * Caller does something else while queries are in flight. Answers are kept in
+ * cache that moves between runs through a file that caller locks, like
+ * src/tls_session_cache.c, so most runs do not ask at all:
+ *
+ * @code
+ *   DnsCacheInit(&cache, arena)
+ *   DnsCacheParse(&cache, &content, PlatformUnixTime())
+ *   entry = DnsCacheFind(&cache, &hostname, PlatformUnixTime())
+ *   if (entry) {
+ *     addressCount = DnsCacheEntryAddresses(entry, port, addresses)
+ *   } else {
+ *     DnsResolverStart(&resolver, &nameServer, &hostname, port, random, NowInNanoseconds())
+ *     // do something else meanwhile
+ *     while (DnsResolverUpdate(&resolver, NowInNanoseconds()) == DNS_RESOLVER_STATE_RESOLVING)
+ *       PlatformSocketWait(resolver.socket, PLATFORM_EVENT_READ, DnsResolverTimeout(&resolver, NowInNanoseconds()))
+ *     DnsCacheStore(&cache, &hostname, resolver.addresses, resolver.addressCount, resolver.ttl, PlatformUnixTime())
+ *   }
+ *   DnsAddressInterleave(addresses, addressCount)
+ * @endcode
+ *
+ * Cache file format, integers are little endian:
+ *
+ *   "IDNS" u32 version, u32 entryCount
+ *   entryCount times:
+ *     u64 expiresAt       seconds since 1970-01-01 UTC
+ *     u8 hostnameLength, u8 addressCount
+ *     hostname
+ *     addressCount times:
+ *       u8 length         4 for IPv4, 16 for IPv6
+ *       address           in network order
+ */
+
+#include "memory.h"
+#include "platform_network.h"
+#include "text.h"
+#include "type.h"
+
+enum {
+  // see RFC 1035 2.3.4. Size limits
+  DNS_HOSTNAME_MAX = 255,
+  DNS_LABEL_MAX = 63,
+  DNS_MESSAGE_MAX = 512,
+  DNS_HEADER_LENGTH = 12,
+
+  DNS_TYPE_A = 1,
+  DNS_TYPE_CNAME = 5,
+  DNS_TYPE_AAAA = 28,
+  DNS_CLASS_IN = 1,
+
+  // of each family, answers of big sites have a handful
+  DNS_ADDRESS_MAX = 8,
+
+  DNS_CACHE_ENTRY_MAX = 16,
+  // answers are cached no longer than this, whatever their TTL is
+  DNS_CACHE_TTL_MAX = 24 * 60 * 60,
+  DNS_CACHE_VERSION = 1,
+  DNS_CACHE_HEADER_LENGTH = 4 + 4 + 4,
+  DNS_CACHE_ENTRY_HEADER_LENGTH = 8 + 1 + 1,
+  DNS_CACHE_FILE_MAX =
+      DNS_CACHE_HEADER_LENGTH +
+      DNS_CACHE_ENTRY_MAX * (DNS_CACHE_ENTRY_HEADER_LENGTH + DNS_HOSTNAME_MAX + 2 * DNS_ADDRESS_MAX * (1 + 16)),
+};
+
+enum dns_response_result {
+  // addresses can be empty, name has no record of type
+  DNS_RESPONSE_OK,
+  // name does not exist
+  DNS_RESPONSE_NAME_ERROR,
+  // server failed, refused or truncated answer
+  DNS_RESPONSE_SERVER_ERROR,
+  // not an answer to query
+  DNS_RESPONSE_INVALID,
+};
+
+internalfn u32
+DnsReadInteger(u8 *octets, u32 length)
+{
+  // network order
+  u32 value = 0;
+  for (u32 index = 0; index < length; index++)
+    value = (value << 8) | octets[index];
+  return value;
+}
+
+internalfn void
+DnsWriteU16(u8 *octets, u16 value)
+{
+  octets[0] = (u8)(value >> 8);
+  octets[1] = (u8)value;
+}
+
+/*
+ * Builds query that asks name server to recurse.
+ * @param buffer at least DNS_MESSAGE_MAX long
+ * @param type DNS_TYPE_A or DNS_TYPE_AAAA
+ * @return length of query, 0 when hostname is not a domain name
+ */
+internalfn u64
+DnsQueryBuild(u8 *buffer, u16 id, struct string *hostname, u16 type)
+{
+  struct string name = *hostname;
+  // fully qualified
+  if (name.length > 0 && name.value[name.length - 1] == '.')
+    name.length--;
+  // labels with their lengths and root label
+  if (name.length == 0 || name.length + 2 > DNS_HOSTNAME_MAX)
+    return 0;
+
+  MemoryClear(buffer, DNS_HEADER_LENGTH);
+  DnsWriteU16(buffer + 0, id);
+  // recursion desired
+  DnsWriteU16(buffer + 2, 0x0100);
+  // question count
+  DnsWriteU16(buffer + 4, 1);
+
+  u64 position = DNS_HEADER_LENGTH;
+  u64 labelStart = 0;
+  for (u64 index = 0; index <= name.length; index++) {
+    if (index < name.length && name.value[index] != '.')
+      continue;
+
+    u64 labelLength = index - labelStart;
+    if (labelLength == 0 || labelLength > DNS_LABEL_MAX)
+      return 0;
+    buffer[position] = (u8)labelLength;
+    MemoryCopy(buffer + position + 1, name.value + labelStart, labelLength);
+    position += 1 + labelLength;
+    labelStart = index + 1;
+  }
+  buffer[position] = 0;
+  position++;
+
+  DnsWriteU16(buffer + position, type);
+  DnsWriteU16(buffer + position + 2, DNS_CLASS_IN);
+  return position + 4;
+}
+
+/*
+ * @return position after name, 0 when name does not fit in message
+ */
+internalfn u64
+DnsSkipName(struct string *message, u64 position)
+{
+  while (position < message->length) {
+    u8 length = message->value[position];
+    if (length == 0)
+      return position + 1;
+
+    // compressed, rest of name is somewhere else, RFC 1035 4.1.4. Message compression
+    if ((length & 0xc0) == 0xc0)
+      return position + 2 <= message->length ? position + 2 : 0;
+    if (length & 0xc0)
+      return 0;
+
+    position += 1 + length;
+  }
+  return 0;
+}
+
+/*
+ * Takes addresses from answer to query. Records of other types, e.g. CNAME
+ * that leads to name with addresses, are skipped.
+ * @param port of every address
+ * @param addressCount in: number of addresses that fit, out: number of addresses filled
+ * @param ttl seconds, lowest of records in answer
+ */
+internalfn enum dns_response_result
+DnsResponseParse(struct string *response, u16 id, u16 type, u16 port, struct platform_address *addresses,
+                 u32 *addressCount, u32 *ttl)
+{
+  u32 addressMax = *addressCount;
+  *addressCount = 0;
+  *ttl = 0;
+
+  u8 *octets = response->value;
+  if (response->length < DNS_HEADER_LENGTH || DnsReadInteger(octets, 2) != id)
+    return DNS_RESPONSE_INVALID;
+
+  u32 flags = DnsReadInteger(octets + 2, 2);
+  u32 questionCount = DnsReadInteger(octets + 4, 2);
+  u32 answerCount = DnsReadInteger(octets + 6, 2);
+  // response to standard query
+  if (!(flags & 0x8000) || (flags & 0x7800) || questionCount != 1)
+    return DNS_RESPONSE_INVALID;
+
+  u64 position = DnsSkipName(response, DNS_HEADER_LENGTH);
+  if (position == 0 || response->length - position < 4 || DnsReadInteger(octets + position, 2) != type ||
+      DnsReadInteger(octets + position + 2, 2) != DNS_CLASS_IN)
+    return DNS_RESPONSE_INVALID;
+  position += 4;
+
+  u32 responseCode = flags & 0x000f;
+  if (responseCode == 3)
+    return DNS_RESPONSE_NAME_ERROR;
+  // truncated answer does not fit in UDP, it is asked from system resolver
+  if (responseCode != 0 || (flags & 0x0200))
+    return DNS_RESPONSE_SERVER_ERROR;
+
+  u32 addressLength = type == DNS_TYPE_AAAA ? 16 : 4;
+  u32 lowestTtl = (u32)-1;
+  for (u32 answerIndex = 0; answerIndex < answerCount; answerIndex++) {
+    position = DnsSkipName(response, position);
+    if (position == 0 || response->length - position < 10) {
+      *addressCount = 0;
+      return DNS_RESPONSE_INVALID;
+    }
+
+    u32 recordType = DnsReadInteger(octets + position, 2);
+    u32 recordClass = DnsReadInteger(octets + position + 2, 2);
+    u32 recordTtl = DnsReadInteger(octets + position + 4, 4);
+    u32 dataLength = DnsReadInteger(octets + position + 8, 2);
+    position += 10;
+    if (response->length - position < dataLength) {
+      *addressCount = 0;
+      return DNS_RESPONSE_INVALID;
+    }
+
+    if (recordClass == DNS_CLASS_IN && (recordType == type || recordType == DNS_TYPE_CNAME)) {
+      // RFC 2181 8. Time to Live, most significant bit set is zero
+      if (recordTtl & 0x80000000)
+        recordTtl = 0;
+      if (recordTtl < lowestTtl)
+        lowestTtl = recordTtl;
+    }
+
+    if (recordClass == DNS_CLASS_IN && recordType == type && dataLength == addressLength &&
+        *addressCount < addressMax) {
+      struct string address = StringFromBuffer(octets + position, dataLength);
+      if (PlatformAddressFromOctets(addresses + *addressCount, &address, port))
+        *addressCount += 1;
+    }
+    position += dataLength;
+  }
+
+  *ttl = lowestTtl == (u32)-1 ? 0 : lowestTtl;
+  return DNS_RESPONSE_OK;
+}
+
+/*
+ * Orders addresses for connecting, see RFC 8305 4. Sorting Addresses.
+ * Families alternate starting with IPv6, order within family is kept.
+ */
+internalfn void
+DnsAddressInterleave(struct platform_address *addresses, u32 addressCount)
+{
+  struct platform_address ipv6[2 * DNS_ADDRESS_MAX];
+  struct platform_address ipv4[2 * DNS_ADDRESS_MAX];
+  u32 ipv6Count = 0;
+  u32 ipv4Count = 0;
+  debug_assert(addressCount <= ARRAY_COUNT(ipv6));
+
+  for (u32 addressIndex = 0; addressIndex < addressCount; addressIndex++) {
+    struct platform_address *address = addresses + addressIndex;
+    if (PlatformAddressOctets(address).length == 16) {
+      ipv6[ipv6Count] = *address;
+      ipv6Count++;
+    } else {
+      ipv4[ipv4Count] = *address;
+      ipv4Count++;
+    }
+  }
+
+  u32 ipv6Index = 0;
+  u32 ipv4Index = 0;
+  for (u32 addressIndex = 0; addressIndex < addressCount; addressIndex++) {
+    b8 isIpv6 = ipv4Index == ipv4Count || (ipv6Index < ipv6Count && ipv6Index <= ipv4Index);
+    if (isIpv6) {
+      addresses[addressIndex] = ipv6[ipv6Index];
+      ipv6Index++;
+    } else {
+      addresses[addressIndex] = ipv4[ipv4Index];
+      ipv4Index++;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// cache
+////////////////////////////////////////////////////////////////////////////////
+
+struct dns_cache_entry {
+  // seconds since 1970-01-01 UTC
+  u64 expiresAt;
+  u8 hostnameLength;
+  u8 addressCount;
+  u8 hostname[DNS_HOSTNAME_MAX];
+  // 4 or 16
+  u8 addressLengths[2 * DNS_ADDRESS_MAX];
+  u8 addresses[2 * DNS_ADDRESS_MAX][16];
+};
+
+struct dns_cache {
+  struct dns_cache_entry *entries;
+  u32 entryCount;
+  // something is stored since file is read, so it has to be written back
+  b8 isChanged;
+};
+
+internalfn void
+DnsCacheInit(struct dns_cache *cache, memory_arena *arena)
+{
+  *cache = (struct dns_cache){
+      .entries = MemoryArenaPush(arena, sizeof(*cache->entries) * DNS_CACHE_ENTRY_MAX),
+  };
+}
+
+internalfn struct dns_cache_entry *
+DnsCacheFindAny(struct dns_cache *cache, struct string *hostname)
+{
+  for (u32 entryIndex = 0; entryIndex < cache->entryCount; entryIndex++) {
+    struct dns_cache_entry *entry = cache->entries + entryIndex;
+    struct string entryHostname = StringFromBuffer(entry->hostname, entry->hostnameLength);
+    if (IsStringEqualIgnoreCase(&entryHostname, hostname))
+      return entry;
+  }
+  return 0;
+}
+
+/*
+ * @param now seconds since 1970-01-01 UTC, see PlatformUnixTime()
+ * @return answer for hostname that is not expired, 0 when there is none
+ */
+internalfn struct dns_cache_entry *
+DnsCacheFind(struct dns_cache *cache, struct string *hostname, u64 now)
+{
+  struct dns_cache_entry *entry = DnsCacheFindAny(cache, hostname);
+  if (!entry || entry->expiresAt <= now)
+    return 0;
+  return entry;
+}
+
+/*
+ * @param addresses at least 2 * DNS_ADDRESS_MAX long
+ * @return number of addresses filled
+ */
+internalfn u32
+DnsCacheEntryAddresses(struct dns_cache_entry *entry, u16 port, struct platform_address *addresses)
+{
+  u32 addressCount = 0;
+  for (u32 addressIndex = 0; addressIndex < entry->addressCount; addressIndex++) {
+    struct string octets = StringFromBuffer(entry->addresses[addressIndex], entry->addressLengths[addressIndex]);
+    if (PlatformAddressFromOctets(addresses + addressCount, &octets, port))
+      addressCount++;
+  }
+  return addressCount;
+}
+
+/*
+ * Stores answer unless one for same hostname expires later. When cache is
+ * full, answer that expires first makes place.
+ * @return pointer to stored entry, 0 when answer is not stored
+ */
+internalfn struct dns_cache_entry *
+DnsCacheInsert(struct dns_cache *cache, struct string *hostname, u64 expiresAt)
+{
+  if (hostname->length == 0 || hostname->length > DNS_HOSTNAME_MAX)
+    return 0;
+
+  struct dns_cache_entry *entry = DnsCacheFindAny(cache, hostname);
+  if (entry) {
+    if (entry->expiresAt >= expiresAt)
+      return 0;
+  } else if (cache->entryCount < DNS_CACHE_ENTRY_MAX) {
+    entry = cache->entries + cache->entryCount;
+    cache->entryCount++;
+  } else {
+    entry = cache->entries + 0;
+    for (u32 entryIndex = 1; entryIndex < cache->entryCount; entryIndex++) {
+      if (cache->entries[entryIndex].expiresAt < entry->expiresAt)
+        entry = cache->entries + entryIndex;
+    }
+    if (entry->expiresAt >= expiresAt)
+      return 0;
+  }
+
+  entry->expiresAt = expiresAt;
+  entry->hostnameLength = (u8)hostname->length;
+  MemoryCopy(entry->hostname, hostname->value, hostname->length);
+  entry->addressCount = 0;
+  return entry;
+}
+
+/*
+ * Keeps answer of resolver for its TTL.
+ * @param ttl seconds, answer is not kept when it is 0
+ * @param now seconds since 1970-01-01 UTC, see PlatformUnixTime()
+ * @return false when answer is not stored
+ */
+internalfn b8
+DnsCacheStore(struct dns_cache *cache, struct string *hostname, struct platform_address *addresses, u32 addressCount,
+              u32 ttl, u64 now)
+{
+  if (ttl == 0 || addressCount == 0)
+    return 0;
+  if (ttl > DNS_CACHE_TTL_MAX)
+    ttl = DNS_CACHE_TTL_MAX;
+
+  struct dns_cache_entry *entry = DnsCacheInsert(cache, hostname, now + ttl);
+  if (!entry)
+    return 0;
+
+  for (u32 addressIndex = 0; addressIndex < addressCount && addressIndex < ARRAY_COUNT(entry->addresses);
+       addressIndex++) {
+    struct string octets = PlatformAddressOctets(addresses + addressIndex);
+    entry->addressLengths[addressIndex] = (u8)octets.length;
+    MemoryCopy(entry->addresses[addressIndex], octets.value, octets.length);
+    entry->addressCount++;
+  }
+
+  cache->isChanged = 1;
+  return 1;
+}
+
+internalfn u64
+DnsCacheReadInteger(u8 *octets, u32 length)
+{
+  u64 value = 0;
+  for (u32 index = length; index > 0; index--)
+    value = (value << 8) | octets[index - 1];
+  return value;
+}
+
+internalfn void
+DnsCacheWriteInteger(u8 *octets, u32 length, u64 value)
+{
+  for (u32 index = 0; index < length; index++) {
+    octets[index] = (u8)value;
+    value >>= 8;
+  }
+}
+
+/*
+ * Takes answers from file content. Answers that are expired, or expire before
+ * ones already in cache, are left out.
+ * @param now seconds since 1970-01-01 UTC, see PlatformUnixTime()
+ * @return false when content is not a DNS cache, empty content is
+ */
+internalfn b8
+DnsCacheParse(struct dns_cache *cache, struct string *content, u64 now)
+{
+  if (content->length == 0)
+    return 1;
+
+  u8 *octets = content->value;
+  if (content->length < DNS_CACHE_HEADER_LENGTH || octets[0] != 'I' || octets[1] != 'D' || octets[2] != 'N' ||
+      octets[3] != 'S' || DnsCacheReadInteger(octets + 4, 4) != DNS_CACHE_VERSION)
+    return 0;
+
+  u64 entryCount = DnsCacheReadInteger(octets + 8, 4);
+  u64 position = DNS_CACHE_HEADER_LENGTH;
+  for (u64 entryIndex = 0; entryIndex < entryCount; entryIndex++) {
+    if (content->length - position < DNS_CACHE_ENTRY_HEADER_LENGTH)
+      return 0;
+    u64 expiresAt = DnsCacheReadInteger(octets + position, 8);
+    u64 hostnameLength = octets[position + 8];
+    u64 addressCount = octets[position + 9];
+    position += DNS_CACHE_ENTRY_HEADER_LENGTH;
+
+    if (content->length - position < hostnameLength || addressCount > 2 * DNS_ADDRESS_MAX)
+      return 0;
+    struct string hostname = StringFromBuffer(octets + position, hostnameLength);
+    position += hostnameLength;
+
+    struct platform_address addresses[2 * DNS_ADDRESS_MAX];
+    u32 parsedCount = 0;
+    for (u64 addressIndex = 0; addressIndex < addressCount; addressIndex++) {
+      if (content->length - position < 1 || content->length - position - 1 < octets[position])
+        return 0;
+      struct string address = StringFromBuffer(octets + position + 1, octets[position]);
+      position += 1 + address.length;
+      if (PlatformAddressFromOctets(addresses + parsedCount, &address, 0))
+        parsedCount++;
+    }
+
+    if (expiresAt <= now || parsedCount == 0)
+      continue;
+
+    struct dns_cache_entry *entry = DnsCacheInsert(cache, &hostname, expiresAt);
+    if (!entry)
+      continue;
+    for (u32 addressIndex = 0; addressIndex < parsedCount; addressIndex++) {
+      struct string address = PlatformAddressOctets(addresses + addressIndex);
+      entry->addressLengths[addressIndex] = (u8)address.length;
+      MemoryCopy(entry->addresses[addressIndex], address.value, address.length);
+    }
+    entry->addressCount = (u8)parsedCount;
+  }
+
+  return 1;
+}
+
+/*
+ * @param buffer at least DNS_CACHE_FILE_MAX long
+ * @param now seconds since 1970-01-01 UTC, expired answers are left out
+ * @return file content in buffer
+ */
+internalfn struct string
+DnsCacheSerialize(struct dns_cache *cache, struct string *buffer, u64 now)
+{
+  debug_assert(buffer->length >= DNS_CACHE_FILE_MAX);
+
+  u8 *octets = buffer->value;
+  octets[0] = 'I';
+  octets[1] = 'D';
+  octets[2] = 'N';
+  octets[3] = 'S';
+  DnsCacheWriteInteger(octets + 4, 4, DNS_CACHE_VERSION);
+
+  u32 entryCount = 0;
+  u64 position = DNS_CACHE_HEADER_LENGTH;
+  for (u32 entryIndex = 0; entryIndex < cache->entryCount; entryIndex++) {
+    struct dns_cache_entry *entry = cache->entries + entryIndex;
+    if (entry->expiresAt <= now)
+      continue;
+
+    DnsCacheWriteInteger(octets + position, 8, entry->expiresAt);
+    octets[position + 8] = entry->hostnameLength;
+    octets[position + 9] = entry->addressCount;
+    position += DNS_CACHE_ENTRY_HEADER_LENGTH;
+    MemoryCopy(octets + position, entry->hostname, entry->hostnameLength);
+    position += entry->hostnameLength;
+    for (u32 addressIndex = 0; addressIndex < entry->addressCount; addressIndex++) {
+      u8 length = entry->addressLengths[addressIndex];
+      octets[position] = length;
+      MemoryCopy(octets + position + 1, entry->addresses[addressIndex], length);
+      position += 1 + length;
+    }
+    entryCount++;
+  }
+
+  DnsCacheWriteInteger(octets + 8, 4, entryCount);
+  return StringFromBuffer(octets, position);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// resolver
+////////////////////////////////////////////////////////////////////////////////
+
+enum dns_resolver_state {
+  DNS_RESOLVER_STATE_RESOLVING,
+  // addresses are filled
+  DNS_RESOLVER_STATE_DONE,
+  // name server does not know hostname or does not answer
+  DNS_RESOLVER_STATE_FAILED,
+};
+
+enum {
+  // every query is sent this many times at most
+  DNS_RESOLVER_ATTEMPT_MAX = 3,
+};
+
+// for first attempt, doubles after every attempt
+comptime u64 DNS_RESOLVER_TIMEOUT = 1000 * 1000000ULL /* 1e6 */;
+// after one family is answered, other is waited for this long, see RFC 8305
+// 3. Hostname Resolution Query Handling
+comptime u64 DNS_RESOLVER_RESOLUTION_DELAY = 50 * 1000000ULL /* 1e6 */;
+
+struct dns_resolver_query {
+  u16 type;
+  u16 id;
+  b8 isAnswered;
+};
+
+struct dns_resolver {
+  enum dns_resolver_state state;
+  s32 socket;
+
+  u8 hostnameBuffer[DNS_HOSTNAME_MAX];
+  struct string hostname;
+  u16 port;
+
+  // AAAA and A
+  struct dns_resolver_query queries[2];
+  u32 attemptCount;
+  // in nanoseconds, see NowInNanoseconds()
+  u64 sentAt;
+  // when first address arrived, 0 before
+  u64 answeredAt;
+
+  struct platform_address addresses[2 * DNS_ADDRESS_MAX];
+  u32 addressCount;
+  // seconds, answer is valid this long, see DnsCacheStore()
+  u32 ttl;
+};
+
+/*
+ * @return false when name server cannot be reached, e.g. ICMP port unreachable
+ *         of earlier query is reported
+ */
+internalfn b8
+DnsResolverSend(struct dns_resolver *resolver)
+{
+  u8 message[DNS_MESSAGE_MAX];
+  for (u32 queryIndex = 0; queryIndex < ARRAY_COUNT(resolver->queries); queryIndex++) {
+    struct dns_resolver_query *query = resolver->queries + queryIndex;
+    if (query->isAnswered)
+      continue;
+
+    u64 length = DnsQueryBuild(message, query->id, &resolver->hostname, query->type);
+    // datagram is lost when socket buffer is full, next attempt sends it again
+    if (PlatformSocketWrite(resolver->socket, message, length) == PLATFORM_SOCKET_ERROR)
+      return 0;
+  }
+  return 1;
+}
+
+internalfn enum dns_resolver_state
+DnsResolverFinish(struct dns_resolver *resolver)
+{
+  PlatformSocketClose(resolver->socket);
+  resolver->socket = -1;
+  resolver->state = resolver->addressCount != 0 ? DNS_RESOLVER_STATE_DONE : DNS_RESOLVER_STATE_FAILED;
+  return resolver->state;
+}
+
+/*
+ * Sends queries for IPv6 and IPv4 addresses of hostname.
+ * @param nameServer see PlatformAddressNameServer()
+ * @param port of resolved addresses
+ * @param random query ids are taken from it, so off-path attacker cannot guess them
+ * @param now see NowInNanoseconds()
+ * @return DNS_RESOLVER_STATE_FAILED when queries cannot be sent
+ */
+internalfn enum dns_resolver_state
+DnsResolverStart(struct dns_resolver *resolver, struct platform_address *nameServer, struct string *hostname, u16 port,
+                 u32 random, u64 now)
+{
+  *resolver = (struct dns_resolver){
+      .state = DNS_RESOLVER_STATE_FAILED,
+      .socket = -1,
+      .port = port,
+      .queries =
+          {
+              {.type = DNS_TYPE_AAAA, .id = (u16)random},
+              {.type = DNS_TYPE_A, .id = (u16)(random >> 16)},
+          },
+      .attemptCount = 1,
+      .sentAt = now,
+  };
+
+  u8 message[DNS_MESSAGE_MAX];
+  if (hostname->length > DNS_HOSTNAME_MAX || DnsQueryBuild(message, 0, hostname, DNS_TYPE_A) == 0)
+    return resolver->state;
+  MemoryCopy(resolver->hostnameBuffer, hostname->value, hostname->length);
+  resolver->hostname = StringFromBuffer(resolver->hostnameBuffer, hostname->length);
+
+  resolver->socket = PlatformSocketOpenDatagram(nameServer);
+  if (resolver->socket == -1)
+    return resolver->state;
+
+  resolver->state = DNS_RESOLVER_STATE_RESOLVING;
+  if (!DnsResolverSend(resolver))
+    return DnsResolverFinish(resolver);
+  return resolver->state;
+}
+
+/*
+ * Takes answers that arrived, sends queries again when they time out.
+ * @param now see NowInNanoseconds()
+ * @return state of resolver, socket is closed once it is not resolving
+ */
+internalfn enum dns_resolver_state
+DnsResolverUpdate(struct dns_resolver *resolver, u64 now)
+{
+  if (resolver->state != DNS_RESOLVER_STATE_RESOLVING)
+    return resolver->state;
+
+  u8 message[DNS_MESSAGE_MAX];
+  while (1) {
+    s64 bytesRead = PlatformSocketRead(resolver->socket, message, sizeof(message));
+    if (bytesRead == PLATFORM_SOCKET_WOULD_BLOCK)
+      break;
+    // e.g. nothing listens on name server, ICMP port unreachable
+    if (bytesRead < 0)
+      return DnsResolverFinish(resolver);
+
+    struct string response = StringFromBuffer(message, (u64)bytesRead);
+    for (u32 queryIndex = 0; queryIndex < ARRAY_COUNT(resolver->queries); queryIndex++) {
+      struct dns_resolver_query *query = resolver->queries + queryIndex;
+      if (query->isAnswered)
+        continue;
+
+      u32 addressCount = DNS_ADDRESS_MAX;
+      u32 ttl;
+      enum dns_response_result result = DnsResponseParse(&response, query->id, query->type, resolver->port,
+                                                         resolver->addresses + resolver->addressCount,
+                                                         &addressCount, &ttl);
+      if (result == DNS_RESPONSE_INVALID)
+        continue;
+
+      query->isAnswered = 1;
+      if (result == DNS_RESPONSE_OK && addressCount != 0) {
+        if (resolver->addressCount == 0 || ttl < resolver->ttl)
+          resolver->ttl = ttl;
+        resolver->addressCount += addressCount;
+        if (resolver->answeredAt == 0)
+          resolver->answeredAt = now;
+      }
+      break;
+    }
+  }
+
+  b8 isEveryAnswered = 1;
+  for (u32 queryIndex = 0; queryIndex < ARRAY_COUNT(resolver->queries); queryIndex++)
+    isEveryAnswered = isEveryAnswered && resolver->queries[queryIndex].isAnswered;
+  if (isEveryAnswered)
+    return DnsResolverFinish(resolver);
+
+  if (resolver->addressCount != 0 && now - resolver->answeredAt >= DNS_RESOLVER_RESOLUTION_DELAY)
+    return DnsResolverFinish(resolver);
+
+  u64 timeout = DNS_RESOLVER_TIMEOUT << (resolver->attemptCount - 1);
+  if (now - resolver->sentAt >= timeout) {
+    if (resolver->attemptCount == DNS_RESOLVER_ATTEMPT_MAX)
+      return DnsResolverFinish(resolver);
+
+    resolver->attemptCount++;
+    resolver->sentAt = now;
+    if (!DnsResolverSend(resolver))
+      return DnsResolverFinish(resolver);
+  }
+
+  return resolver->state;
+}
+
+/*
+ * @param now see NowInNanoseconds()
+ * @return milliseconds until DnsResolverUpdate() has something to do besides
+ *         taking answers, -1 when resolver is done
+ */
+internalfn s32
+DnsResolverTimeout(struct dns_resolver *resolver, u64 now)
+{
+  if (resolver->state != DNS_RESOLVER_STATE_RESOLVING)
+    return -1;
+
+  u64 deadline = resolver->sentAt + (DNS_RESOLVER_TIMEOUT << (resolver->attemptCount - 1));
+  if (resolver->addressCount != 0 && resolver->answeredAt + DNS_RESOLVER_RESOLUTION_DELAY < deadline)
+    deadline = resolver->answeredAt + DNS_RESOLVER_RESOLUTION_DELAY;
+
+  u64 timeout = deadline > now ? deadline - now : 0;
+  // rounded up, so it has passed when wait returns
+  return (s32)((timeout + 999999) / 1000000 /* 1e6 */);
+}
+
+/*
+ * Stops resolving, for when caller gives up before resolver does.
+ */
+internalfn void
+DnsResolverClose(struct dns_resolver *resolver)
+{
+  if (resolver->socket != -1)
+    PlatformSocketClose(resolver->socket);
+  resolver->socket = -1;
+  if (resolver->state == DNS_RESOLVER_STATE_RESOLVING)
+    resolver->state = DNS_RESOLVER_STATE_FAILED;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+/*
+ * Hedged requests
+ *
+ * Instance that stalls now and then for seconds makes slowest requests much
+ * slower than the rest. Request whose response has not started by the time
+ * most responses of its instance have, is sent again to another instance;
+ * whichever answers first is taken and the other is dropped.
+ *
+ * Delay is p95 of time to first byte of instance, so about one request in
+ * twenty would be sent twice even when instance is steady. Budget caps
+ * duplicates at a share of requests sent, so instance that gets slower for
+ * good does not double the load on the others.
+ *
+ * @code
+ *   HedgeBudgetInit(&budget, 5)
+ *   HedgeBudgetAdd(&budget, requestsSent)
+ *   delay = HedgeDelay(&histogramOfInstance)
+ *   if (delay != 0 && now - sentAt > delay && !firstByte && HedgeBudgetTake(&budget))
+ *     send same request to another instance
+ * @endcode
+ */
+
+#include "assert.h"
+#include "request_timing.c"
+#include "type.h"
+
+enum {
+  // responses of instance before its p95 is trusted
+  HEDGE_RESPONSE_MIN = 20,
+  HEDGE_PERCENTILE = 95,
+};
+
+struct hedge_budget {
+  // duplicates allowed, of every hundred requests sent
+  u32 percent;
+  u32 requestCount;
+  u32 hedgeCount;
+};
+
+internalfn void
+HedgeBudgetInit(struct hedge_budget *budget, u32 percent)
+{
+  debug_assert(percent <= 100);
+  *budget = (struct hedge_budget){
+      .percent = percent,
+  };
+}
+
+/*
+ * Call when requests are sent, duplicates are not counted.
+ */
+internalfn void
+HedgeBudgetAdd(struct hedge_budget *budget, u32 requestCount)
+{
+  budget->requestCount += requestCount;
+}
+
+/*
+ * @return true when one more duplicate fits in budget, it is counted
+ */
+internalfn b8
+HedgeBudgetTake(struct hedge_budget *budget)
+{
+  if ((u64)(budget->hedgeCount + 1) * 100 > (u64)budget->requestCount * budget->percent)
+    return 0;
+  budget->hedgeCount++;
+  return 1;
+}
+
+/*
+ * @param histogram responses of instance, see RequestTimingHistogramAdd()
+ * @return nanoseconds request waits for first byte before it is sent again,
+ *         0 when instance answered too few to tell
+ */
+internalfn u64
+HedgeDelay(struct request_timing_histogram *histogram)
+{
+  if (histogram->requestCount < HEDGE_RESPONSE_MIN)
+    return 0;
+  u64 microseconds = RequestTimingHistogramPercentile(histogram, REQUEST_TIMING_PHASE_TTFB, HEDGE_PERCENTILE);
+  return microseconds * 1000;
+}
@@ -0,0 +1,703 @@
+#pragma once
+
+/*
+ * HPACK: Header Compression for HTTP/2
+ * https://www.rfc-editor.org/rfc/rfc7541
+ *
+ * Header field is sent as index into a table or as literal name and value.
+ * Index 1 to 61 refer to static table of common fields, bigger indexes refer
+ * to dynamic table that holds fields seen before on same connection, newest
+ * first. Literal strings are optionally Huffman coded.
+ *
+ * Decoder and encoder of a connection each have their own dynamic table.
+ * Every header block must be decoded in order they are received, even if its
+ * fields are not needed, otherwise tables go out of sync.
+ *
+ * @code
+ *   HpackTableInit(&table, HPACK_TABLE_SIZE_DEFAULT);
+ *   position = 0;
+ *   while (position < block.length) {
+ *     if (!HpackDecodeField(&table, &block, &position, &scratch, &field))
+ *       error(COMPRESSION_ERROR)
+ *     if (IsStringNull(&field.name))
+ *       continue; // dynamic table size update
+ *     use(field)
+ *   }
+ * @endcode
+ */
+
+#include "http_request.c"
+#include "memory.h"
+#include "text.h"
+#include "type.h"
+
+enum {
+  // default and largest size of dynamic table
+  HPACK_TABLE_SIZE_DEFAULT = 4096,
+  // every entry costs its name and value length plus 32
+  HPACK_ENTRY_OVERHEAD = 32,
+  HPACK_TABLE_ENTRY_MAX = HPACK_TABLE_SIZE_DEFAULT / HPACK_ENTRY_OVERHEAD,
+  HPACK_STATIC_TABLE_COUNT = 61,
+};
+
+struct hpack_entry {
+  u32 offset;
+  u32 nameLength;
+  u32 valueLength;
+};
+
+struct hpack_table {
+  // sum of entry sizes
+  u32 size;
+  u32 sizeMax;
+  // oldest first
+  u32 entryCount;
+  struct hpack_entry entries[HPACK_TABLE_ENTRY_MAX];
+  // name and value of entries back to back, oldest first
+  u32 dataLength;
+  u8 data[HPACK_TABLE_SIZE_DEFAULT];
+};
+
+enum hpack_indexing {
+  // field is added to dynamic table, use for fields that repeat
+  HPACK_INDEXING_INCREMENTAL,
+  // field is not added to dynamic table, use for fields that change every time
+  HPACK_INDEXING_NONE,
+  // same as none, also intermediaries must not index it, use for secrets
+  HPACK_INDEXING_NEVER,
+};
+
+#define HPACK_STRING(literal) {.value = (u8 *)literal, .length = sizeof(literal) - 1}
+
+// https://www.rfc-editor.org/rfc/rfc7541#appendix-B "Huffman Code"
+// Huffman code of every octet, most significant bit first
+comptime u32 HPACK_HUFFMAN_CODES[256] = {
+    0x1ff8, 0x7fffd8, 0xfffffe2, 0xfffffe3, 0xfffffe4, 0xfffffe5, 0xfffffe6, 0xfffffe7,
+    0xfffffe8, 0xffffea, 0x3ffffffc, 0xfffffe9, 0xfffffea, 0x3ffffffd, 0xfffffeb, 0xfffffec,
+    0xfffffed, 0xfffffee, 0xfffffef, 0xffffff0, 0xffffff1, 0xffffff2, 0x3ffffffe, 0xffffff3,
+    0xffffff4, 0xffffff5, 0xffffff6, 0xffffff7, 0xffffff8, 0xffffff9, 0xffffffa, 0xffffffb,
+    0x14, 0x3f8, 0x3f9, 0xffa, 0x1ff9, 0x15, 0xf8, 0x7fa,
+    0x3fa, 0x3fb, 0xf9, 0x7fb, 0xfa, 0x16, 0x17, 0x18,
+    0x0, 0x1, 0x2, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,
+    0x1e, 0x1f, 0x5c, 0xfb, 0x7ffc, 0x20, 0xffb, 0x3fc,
+    0x1ffa, 0x21, 0x5d, 0x5e, 0x5f, 0x60, 0x61, 0x62,
+    0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a,
+    0x6b, 0x6c, 0x6d, 0x6e, 0x6f, 0x70, 0x71, 0x72,
+    0xfc, 0x73, 0xfd, 0x1ffb, 0x7fff0, 0x1ffc, 0x3ffc, 0x22,
+    0x7ffd, 0x3, 0x23, 0x4, 0x24, 0x5, 0x25, 0x26,
+    0x27, 0x6, 0x74, 0x75, 0x28, 0x29, 0x2a, 0x7,
+    0x2b, 0x76, 0x2c, 0x8, 0x9, 0x2d, 0x77, 0x78,
+    0x79, 0x7a, 0x7b, 0x7ffe, 0x7fc, 0x3ffd, 0x1ffd, 0xffffffc,
+    0xfffe6, 0x3fffd2, 0xfffe7, 0xfffe8, 0x3fffd3, 0x3fffd4, 0x3fffd5, 0x7fffd9,
+    0x3fffd6, 0x7fffda, 0x7fffdb, 0x7fffdc, 0x7fffdd, 0x7fffde, 0xffffeb, 0x7fffdf,
+    0xffffec, 0xffffed, 0x3fffd7, 0x7fffe0, 0xffffee, 0x7fffe1, 0x7fffe2, 0x7fffe3,
+    0x7fffe4, 0x1fffdc, 0x3fffd8, 0x7fffe5, 0x3fffd9, 0x7fffe6, 0x7fffe7, 0xffffef,
+    0x3fffda, 0x1fffdd, 0xfffe9, 0x3fffdb, 0x3fffdc, 0x7fffe8, 0x7fffe9, 0x1fffde,
+    0x7fffea, 0x3fffdd, 0x3fffde, 0xfffff0, 0x1fffdf, 0x3fffdf, 0x7fffeb, 0x7fffec,
+    0x1fffe0, 0x1fffe1, 0x3fffe0, 0x1fffe2, 0x7fffed, 0x3fffe1, 0x7fffee, 0x7fffef,
+    0xfffea, 0x3fffe2, 0x3fffe3, 0x3fffe4, 0x7ffff0, 0x3fffe5, 0x3fffe6, 0x7ffff1,
+    0x3ffffe0, 0x3ffffe1, 0xfffeb, 0x7fff1, 0x3fffe7, 0x7ffff2, 0x3fffe8, 0x1ffffec,
+    0x3ffffe2, 0x3ffffe3, 0x3ffffe4, 0x7ffffde, 0x7ffffdf, 0x3ffffe5, 0xfffff1, 0x1ffffed,
+    0x7fff2, 0x1fffe3, 0x3ffffe6, 0x7ffffe0, 0x7ffffe1, 0x3ffffe7, 0x7ffffe2, 0xfffff2,
+    0x1fffe4, 0x1fffe5, 0x3ffffe8, 0x3ffffe9, 0xffffffd, 0x7ffffe3, 0x7ffffe4, 0x7ffffe5,
+    0xfffec, 0xfffff3, 0xfffed, 0x1fffe6, 0x3fffe9, 0x1fffe7, 0x1fffe8, 0x7ffff3,
+    0x3fffea, 0x3fffeb, 0x1ffffee, 0x1ffffef, 0xfffff4, 0xfffff5, 0x3ffffea, 0x7ffff4,
+    0x3ffffeb, 0x7ffffe6, 0x3ffffec, 0x3ffffed, 0x7ffffe7, 0x7ffffe8, 0x7ffffe9, 0x7ffffea,
+    0x7ffffeb, 0xffffffe, 0x7ffffec, 0x7ffffed, 0x7ffffee, 0x7ffffef, 0x7fffff0, 0x3ffffee,
+};
+
+comptime u8 HPACK_HUFFMAN_CODE_LENGTHS[256] = {
+    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+    28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+    6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+    5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+    13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+    15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+    6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+    20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+    22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+    21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+    19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+    20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+};
+
+/*
+ * Code is canonical. Codes of same length are consecutive and ordered by
+ * symbol, so it is decoded with count of codes per length and symbols sorted
+ * by code.
+ */
+comptime u8 HPACK_HUFFMAN_LENGTH_COUNTS[31] = {
+    0, 0, 0, 0, 0, 10, 26, 32, 6, 0, 5, 3, 2, 6, 2, 3,
+    0, 0, 0, 3, 8, 13, 26, 29, 12, 4, 15, 19, 29, 0, 4,
+};
+
+comptime u16 HPACK_HUFFMAN_SYMBOLS[257] = {
+    48, 49, 50, 97, 99, 101, 105, 111, 115, 116, 32, 37, 45, 46, 47, 51,
+    52, 53, 54, 55, 56, 57, 61, 65, 95, 98, 100, 102, 103, 104, 108, 109,
+    110, 112, 114, 117, 58, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76,
+    77, 78, 79, 80, 81, 82, 83, 84, 85, 86, 87, 89, 106, 107, 113, 118,
+    119, 120, 121, 122, 38, 42, 44, 59, 88, 90, 33, 34, 40, 41, 63, 39,
+    43, 124, 35, 62, 0, 36, 64, 91, 93, 126, 94, 125, 60, 96, 123, 92,
+    195, 208, 128, 130, 131, 162, 184, 194, 224, 226, 153, 161, 167, 172, 176, 177,
+    179, 209, 216, 217, 227, 229, 230, 129, 132, 133, 134, 136, 146, 154, 156, 160,
+    163, 164, 169, 170, 173, 178, 181, 185, 186, 187, 189, 190, 196, 198, 228, 232,
+    233, 1, 135, 137, 138, 139, 140, 141, 143, 147, 149, 150, 151, 152, 155, 157,
+    158, 165, 166, 168, 174, 175, 180, 182, 183, 188, 191, 197, 231, 239, 9, 142,
+    144, 145, 148, 159, 171, 206, 215, 225, 236, 237, 199, 207, 234, 235, 192, 193,
+    200, 201, 202, 205, 210, 213, 218, 219, 238, 240, 242, 243, 255, 203, 204, 211,
+    212, 214, 221, 222, 223, 241, 244, 245, 246, 247, 248, 250, 251, 252, 253, 254,
+    2, 3, 4, 5, 6, 7, 8, 11, 12, 14, 15, 16, 17, 18, 19, 20,
+    21, 23, 24, 25, 26, 27, 28, 29, 30, 31, 127, 220, 249, 10, 13, 22,
+    256,
+};
+
+comptime struct http_header HPACK_STATIC_TABLE[HPACK_STATIC_TABLE_COUNT] = {
+    {HPACK_STRING(":authority"), HPACK_STRING("")},
+    {HPACK_STRING(":method"), HPACK_STRING("GET")},
+    {HPACK_STRING(":method"), HPACK_STRING("POST")},
+    {HPACK_STRING(":path"), HPACK_STRING("/")},
+    {HPACK_STRING(":path"), HPACK_STRING("/index.html")},
+    {HPACK_STRING(":scheme"), HPACK_STRING("http")},
+    {HPACK_STRING(":scheme"), HPACK_STRING("https")},
+    {HPACK_STRING(":status"), HPACK_STRING("200")},
+    {HPACK_STRING(":status"), HPACK_STRING("204")},
+    {HPACK_STRING(":status"), HPACK_STRING("206")},
+    {HPACK_STRING(":status"), HPACK_STRING("304")},
+    {HPACK_STRING(":status"), HPACK_STRING("400")},
+    {HPACK_STRING(":status"), HPACK_STRING("404")},
+    {HPACK_STRING(":status"), HPACK_STRING("500")},
+    {HPACK_STRING("accept-charset"), HPACK_STRING("")},
+    {HPACK_STRING("accept-encoding"), HPACK_STRING("gzip, deflate")},
+    {HPACK_STRING("accept-language"), HPACK_STRING("")},
+    {HPACK_STRING("accept-ranges"), HPACK_STRING("")},
+    {HPACK_STRING("accept"), HPACK_STRING("")},
+    {HPACK_STRING("access-control-allow-origin"), HPACK_STRING("")},
+    {HPACK_STRING("age"), HPACK_STRING("")},
+    {HPACK_STRING("allow"), HPACK_STRING("")},
+    {HPACK_STRING("authorization"), HPACK_STRING("")},
+    {HPACK_STRING("cache-control"), HPACK_STRING("")},
+    {HPACK_STRING("content-disposition"), HPACK_STRING("")},
+    {HPACK_STRING("content-encoding"), HPACK_STRING("")},
+    {HPACK_STRING("content-language"), HPACK_STRING("")},
+    {HPACK_STRING("content-length"), HPACK_STRING("")},
+    {HPACK_STRING("content-location"), HPACK_STRING("")},
+    {HPACK_STRING("content-range"), HPACK_STRING("")},
+    {HPACK_STRING("content-type"), HPACK_STRING("")},
+    {HPACK_STRING("cookie"), HPACK_STRING("")},
+    {HPACK_STRING("date"), HPACK_STRING("")},
+    {HPACK_STRING("etag"), HPACK_STRING("")},
+    {HPACK_STRING("expect"), HPACK_STRING("")},
+    {HPACK_STRING("expires"), HPACK_STRING("")},
+    {HPACK_STRING("from"), HPACK_STRING("")},
+    {HPACK_STRING("host"), HPACK_STRING("")},
+    {HPACK_STRING("if-match"), HPACK_STRING("")},
+    {HPACK_STRING("if-modified-since"), HPACK_STRING("")},
+    {HPACK_STRING("if-none-match"), HPACK_STRING("")},
+    {HPACK_STRING("if-range"), HPACK_STRING("")},
+    {HPACK_STRING("if-unmodified-since"), HPACK_STRING("")},
+    {HPACK_STRING("last-modified"), HPACK_STRING("")},
+    {HPACK_STRING("link"), HPACK_STRING("")},
+    {HPACK_STRING("location"), HPACK_STRING("")},
+    {HPACK_STRING("max-forwards"), HPACK_STRING("")},
+    {HPACK_STRING("proxy-authenticate"), HPACK_STRING("")},
+    {HPACK_STRING("proxy-authorization"), HPACK_STRING("")},
+    {HPACK_STRING("range"), HPACK_STRING("")},
+    {HPACK_STRING("referer"), HPACK_STRING("")},
+    {HPACK_STRING("refresh"), HPACK_STRING("")},
+    {HPACK_STRING("retry-after"), HPACK_STRING("")},
+    {HPACK_STRING("server"), HPACK_STRING("")},
+    {HPACK_STRING("set-cookie"), HPACK_STRING("")},
+    {HPACK_STRING("strict-transport-security"), HPACK_STRING("")},
+    {HPACK_STRING("transfer-encoding"), HPACK_STRING("")},
+    {HPACK_STRING("user-agent"), HPACK_STRING("")},
+    {HPACK_STRING("vary"), HPACK_STRING("")},
+    {HPACK_STRING("via"), HPACK_STRING("")},
+    {HPACK_STRING("www-authenticate"), HPACK_STRING("")},
+};
+
+#undef HPACK_STRING
+
+internalfn void
+HpackTableInit(struct hpack_table *table, u32 sizeMax)
+{
+  debug_assert(sizeMax <= HPACK_TABLE_SIZE_DEFAULT);
+  table->size = 0;
+  table->sizeMax = sizeMax;
+  table->entryCount = 0;
+  table->dataLength = 0;
+}
+
+// Evicts oldest entries until table size is at most size.
+internalfn void
+HpackTableEvict(struct hpack_table *table, u32 size)
+{
+  u32 evictCount = 0;
+  while (table->size > size) {
+    struct hpack_entry *entry = table->entries + evictCount;
+    table->size -= entry->nameLength + entry->valueLength + HPACK_ENTRY_OVERHEAD;
+    evictCount++;
+  }
+  if (evictCount == 0)
+    return;
+
+  u32 evictedLength = evictCount < table->entryCount ? table->entries[evictCount].offset : table->dataLength;
+  MemoryMove(table->data, table->data + evictedLength, table->dataLength - evictedLength);
+  table->dataLength -= evictedLength;
+
+  table->entryCount -= evictCount;
+  for (u32 entryIndex = 0; entryIndex < table->entryCount; entryIndex++) {
+    struct hpack_entry *entry = table->entries + entryIndex;
+    *entry = table->entries[entryIndex + evictCount];
+    entry->offset -= evictedLength;
+  }
+}
+
+internalfn void
+HpackTableSetSizeMax(struct hpack_table *table, u32 sizeMax)
+{
+  debug_assert(sizeMax <= HPACK_TABLE_SIZE_DEFAULT);
+  HpackTableEvict(table, sizeMax);
+  table->sizeMax = sizeMax;
+}
+
+/*
+ * Adds field as newest entry. Entry bigger than table empties the table.
+ * https://www.rfc-editor.org/rfc/rfc7541#section-4.4 "Entry Eviction When Adding New Entries"
+ */
+internalfn void
+HpackTableAdd(struct hpack_table *table, struct string *name, struct string *value)
+{
+  u64 entrySize = name->length + value->length + HPACK_ENTRY_OVERHEAD;
+  if (entrySize > table->sizeMax) {
+    HpackTableEvict(table, 0);
+    return;
+  }
+  HpackTableEvict(table, table->sizeMax - (u32)entrySize);
+
+  struct hpack_entry *entry = table->entries + table->entryCount;
+  entry->offset = table->dataLength;
+  entry->nameLength = (u32)name->length;
+  entry->valueLength = (u32)value->length;
+  MemoryCopy(table->data + table->dataLength, name->value, name->length);
+  MemoryCopy(table->data + table->dataLength + name->length, value->value, value->length);
+  table->dataLength += entry->nameLength + entry->valueLength;
+  table->size += (u32)entrySize;
+  table->entryCount++;
+}
+
+/*
+ * @return false if index is not in static or dynamic table
+ */
+internalfn b8
+HpackTableGet(struct hpack_table *table, u64 index, struct http_header *field)
+{
+  if (index == 0)
+    return 0;
+
+  if (index <= HPACK_STATIC_TABLE_COUNT) {
+    *field = HPACK_STATIC_TABLE[index - 1];
+    return 1;
+  }
+
+  u64 dynamicIndex = index - HPACK_STATIC_TABLE_COUNT - 1;
+  if (dynamicIndex >= table->entryCount)
+    return 0;
+
+  struct hpack_entry *entry = table->entries + table->entryCount - 1 - dynamicIndex;
+  field->name = StringFromBuffer(table->data + entry->offset, entry->nameLength);
+  field->value = StringFromBuffer(table->data + entry->offset + entry->nameLength, entry->valueLength);
+  return 1;
+}
+
+/*
+ * Static table is searched first, common request fields are found without
+ * touching dynamic table.
+ * @return index of field with same name and value, if not found index of
+ *         field with same name, if not found 0
+ */
+internalfn u32
+HpackTableFind(struct hpack_table *table, struct http_header *field, b8 *isValueMatched)
+{
+  u32 nameIndex = 0;
+  *isValueMatched = 0;
+
+  for (u32 staticIndex = 0; staticIndex < HPACK_STATIC_TABLE_COUNT; staticIndex++) {
+    struct http_header *entry = (struct http_header *)HPACK_STATIC_TABLE + staticIndex;
+    if (!IsStringEqual(&entry->name, &field->name))
+      continue;
+
+    if (IsStringEqual(&entry->value, &field->value)) {
+      *isValueMatched = 1;
+      return staticIndex + 1;
+    }
+    if (nameIndex == 0)
+      nameIndex = staticIndex + 1;
+  }
+
+  for (u32 dynamicIndex = 0; dynamicIndex < table->entryCount; dynamicIndex++) {
+    struct hpack_entry *entry = table->entries + table->entryCount - 1 - dynamicIndex;
+    struct string name = StringFromBuffer(table->data + entry->offset, entry->nameLength);
+    if (!IsStringEqual(&name, &field->name))
+      continue;
+
+    struct string value = StringFromBuffer(table->data + entry->offset + entry->nameLength, entry->valueLength);
+    if (IsStringEqual(&value, &field->value)) {
+      *isValueMatched = 1;
+      return HPACK_STATIC_TABLE_COUNT + 1 + dynamicIndex;
+    }
+    if (nameIndex == 0)
+      nameIndex = HPACK_STATIC_TABLE_COUNT + 1 + dynamicIndex;
+  }
+
+  return nameIndex;
+}
+
+/*****************************************************************
+ * Primitives
+ * https://www.rfc-editor.org/rfc/rfc7541#section-5
+ *****************************************************************/
+
+/*
+ * Decodes integer that starts in lower prefixBits of octet at position.
+ * @return false if block ends or integer does not fit 32 bits
+ */
+internalfn b8
+HpackDecodeInteger(struct string *block, u64 *position, u32 prefixBits, u64 *value)
+{
+  if (*position >= block->length)
+    return 0;
+
+  u64 prefixMax = (1u << prefixBits) - 1;
+  u64 result = block->value[*position] & prefixMax;
+  *position += 1;
+  if (result == prefixMax) {
+    u32 shift = 0;
+    while (1) {
+      if (*position >= block->length || shift > 28)
+        return 0;
+
+      u8 octet = block->value[*position];
+      *position += 1;
+      result += (u64)(octet & 0x7f) << shift;
+      shift += 7;
+      if ((octet & 0x80) == 0)
+        break;
+    }
+
+    if (result > U32_MAX)
+      return 0;
+  }
+
+  *value = result;
+  return 1;
+}
+
+/*
+ * Encodes integer into lower prefixBits of octet, upper bits are flags.
+ * @return false if buffer is full
+ */
+internalfn b8
+HpackEncodeInteger(struct string *buffer, u64 *position, u8 flags, u32 prefixBits, u64 value)
+{
+  u64 prefixMax = (1u << prefixBits) - 1;
+  if (*position >= buffer->length)
+    return 0;
+
+  if (value < prefixMax) {
+    buffer->value[*position] = (u8)(flags | value);
+    *position += 1;
+    return 1;
+  }
+
+  buffer->value[*position] = (u8)(flags | prefixMax);
+  *position += 1;
+  value -= prefixMax;
+  while (1) {
+    if (*position >= buffer->length)
+      return 0;
+
+    if (value < 0x80) {
+      buffer->value[*position] = (u8)value;
+      *position += 1;
+      return 1;
+    }
+
+    buffer->value[*position] = (u8)((value & 0x7f) | 0x80);
+    *position += 1;
+    value >>= 7;
+  }
+}
+
+internalfn u64
+HpackHuffmanEncodedLength(struct string *string)
+{
+  u64 bitCount = 0;
+  for (u64 index = 0; index < string->length; index++)
+    bitCount += HPACK_HUFFMAN_CODE_LENGTHS[string->value[index]];
+  return (bitCount + 7) / 8;
+}
+
+/*
+ * Output must have HpackHuffmanEncodedLength() bytes. Last octet is padded
+ * with most significant bits of EOS, which are all 1.
+ */
+internalfn void
+HpackHuffmanEncode(struct string *string, u8 *output)
+{
+  u64 bits = 0;
+  u32 bitCount = 0;
+  for (u64 index = 0; index < string->length; index++) {
+    u8 symbol = string->value[index];
+    bits = (bits << HPACK_HUFFMAN_CODE_LENGTHS[symbol]) | HPACK_HUFFMAN_CODES[symbol];
+    bitCount += HPACK_HUFFMAN_CODE_LENGTHS[symbol];
+    while (bitCount >= 8) {
+      bitCount -= 8;
+      *output++ = (u8)(bits >> bitCount);
+    }
+  }
+
+  if (bitCount != 0)
+    *output = (u8)((bits << (8 - bitCount)) | (0xff >> bitCount));
+}
+
+/*
+ * Decodes bit by bit using canonical code, like inflate does.
+ * @return false if string is not valid Huffman coding or buffer is full
+ */
+internalfn b8
+HpackHuffmanDecode(struct string *input, struct string *buffer, struct string *output)
+{
+  u64 outputLength = 0;
+  u32 code = 0;
+  u32 codeLength = 0;
+  // first code and index of first symbol with codeLength
+  u32 first = 0;
+  u32 symbolIndex = 0;
+
+  for (u64 inputIndex = 0; inputIndex < input->length; inputIndex++) {
+    u8 octet = input->value[inputIndex];
+    for (s32 bitIndex = 7; bitIndex >= 0; bitIndex--) {
+      code = (code << 1) | ((octet >> bitIndex) & 1);
+      codeLength++;
+
+      u32 count = HPACK_HUFFMAN_LENGTH_COUNTS[codeLength];
+      if (code - first < count) {
+        u16 symbol = HPACK_HUFFMAN_SYMBOLS[symbolIndex + code - first];
+        // A Huffman-encoded string literal containing the EOS symbol MUST be
+        // treated as a decoding error.
+        if (symbol == 256 || outputLength == buffer->length)
+          return 0;
+
+        buffer->value[outputLength] = (u8)symbol;
+        outputLength++;
+        code = 0;
+        codeLength = 0;
+        first = 0;
+        symbolIndex = 0;
+        continue;
+      }
+
+      symbolIndex += count;
+      first = (first + count) << 1;
+      if (codeLength == 30)
+        return 0;
+    }
+  }
+
+  // Padding strictly longer than 7 bits MUST be treated as a decoding error.
+  // Padding not corresponding to the most significant bits of the code for
+  // the EOS symbol MUST be treated as a decoding error.
+  if (codeLength > 7 || code != (1u << codeLength) - 1)
+    return 0;
+
+  *output = StringFromBuffer(buffer->value, outputLength);
+  return 1;
+}
+
+/*
+ * Decodes string literal at position. Huffman coded strings are written to
+ * scratch after scratchUsed, others point into block.
+ * https://www.rfc-editor.org/rfc/rfc7541#section-5.2 "String Literal Representation"
+ */
+internalfn b8
+HpackDecodeString(struct string *block, u64 *position, struct string *scratch, u64 *scratchUsed,
+                  struct string *output)
+{
+  if (*position >= block->length)
+    return 0;
+
+  b8 isHuffman = (block->value[*position] & 0x80) != 0;
+  u64 length;
+  if (!HpackDecodeInteger(block, position, 7, &length))
+    return 0;
+  if (length > block->length - *position)
+    return 0;
+
+  struct string literal = StringFromBuffer(block->value + *position, length);
+  *position += length;
+  if (!isHuffman) {
+    *output = literal;
+    return 1;
+  }
+
+  struct string remaining = StringFromBuffer(scratch->value + *scratchUsed, scratch->length - *scratchUsed);
+  if (!HpackHuffmanDecode(&literal, &remaining, output))
+    return 0;
+  *scratchUsed += output->length;
+  return 1;
+}
+
+/*
+ * Huffman coding is used unless it is longer.
+ */
+internalfn b8
+HpackEncodeString(struct string *buffer, u64 *position, struct string *string)
+{
+  u64 huffmanLength = HpackHuffmanEncodedLength(string);
+  b8 isHuffman = huffmanLength <= string->length;
+  u64 length = isHuffman ? huffmanLength : string->length;
+
+  if (!HpackEncodeInteger(buffer, position, isHuffman ? 0x80 : 0x00, 7, length))
+    return 0;
+  if (length > buffer->length - *position)
+    return 0;
+
+  if (isHuffman)
+    HpackHuffmanEncode(string, buffer->value + *position);
+  else
+    MemoryCopy(buffer->value + *position, string->value, length);
+  *position += length;
+  return 1;
+}
+
+/*****************************************************************
+ * Header Field Representation
+ * https://www.rfc-editor.org/rfc/rfc7541#section-6
+ *****************************************************************/
+
+/*
+ * Decodes one field of header block at position. Field strings point into
+ * block, table or scratch, copy them before decoding next field.
+ * After dynamic table size update, field name is null.
+ * @return false on decoding error
+ */
+internalfn b8
+HpackDecodeField(struct hpack_table *table, struct string *block, u64 *position, struct string *scratch,
+                 struct http_header *field)
+{
+  if (*position >= block->length)
+    return 0;
+
+  u64 scratchUsed = 0;
+  u8 octet = block->value[*position];
+
+  // Indexed Header Field
+  if (octet & 0x80) {
+    u64 index;
+    if (!HpackDecodeInteger(block, position, 7, &index))
+      return 0;
+    return HpackTableGet(table, index, field);
+  }
+
+  // Dynamic Table Size Update
+  if ((octet & 0xe0) == 0x20) {
+    u64 sizeMax;
+    if (!HpackDecodeInteger(block, position, 5, &sizeMax))
+      return 0;
+    // must not exceed SETTINGS_HEADER_TABLE_SIZE, which is left as default
+    if (sizeMax > HPACK_TABLE_SIZE_DEFAULT)
+      return 0;
+
+    HpackTableSetSizeMax(table, (u32)sizeMax);
+    field->name = StringNull();
+    field->value = StringNull();
+    return 1;
+  }
+
+  // Literal Header Field with Incremental Indexing    01xxxxxx
+  // Literal Header Field without Indexing             0000xxxx
+  // Literal Header Field Never Indexed                0001xxxx
+  b8 isIndexing = (octet & 0xc0) == 0x40;
+  u32 prefixBits = isIndexing ? 6 : 4;
+  u64 nameIndex;
+  if (!HpackDecodeInteger(block, position, prefixBits, &nameIndex))
+    return 0;
+
+  if (nameIndex == 0) {
+    if (!HpackDecodeString(block, position, scratch, &scratchUsed, &field->name))
+      return 0;
+  } else {
+    struct http_header indexed;
+    if (!HpackTableGet(table, nameIndex, &indexed))
+      return 0;
+    field->name = indexed.name;
+
+    // adding to table can evict the entry that name points to
+    if (isIndexing && nameIndex > HPACK_STATIC_TABLE_COUNT) {
+      if (indexed.name.length > scratch->length)
+        return 0;
+      MemoryCopy(scratch->value, indexed.name.value, indexed.name.length);
+      field->name = StringFromBuffer(scratch->value, indexed.name.length);
+      scratchUsed += indexed.name.length;
+    }
+  }
+
+  if (!HpackDecodeString(block, position, scratch, &scratchUsed, &field->value))
+    return 0;
+
+  if (isIndexing)
+    HpackTableAdd(table, &field->name, &field->value);
+
+  return 1;
+}
+
+/*
+ * Encodes field as index when table has it, otherwise as literal.
+ * @return false if buffer is full
+ */
+internalfn b8
+HpackEncodeField(struct hpack_table *table, struct string *buffer, u64 *position, struct http_header *field,
+                 enum hpack_indexing indexing)
+{
+  b8 isValueMatched;
+  u32 index = HpackTableFind(table, field, &isValueMatched);
+  if (isValueMatched)
+    return HpackEncodeInteger(buffer, position, 0x80, 7, index);
+
+  u8 flags = 0x00;
+  u32 prefixBits = 4;
+  if (indexing == HPACK_INDEXING_INCREMENTAL) {
+    flags = 0x40;
+    prefixBits = 6;
+  } else if (indexing == HPACK_INDEXING_NEVER) {
+    flags = 0x10;
+  }
+
+  if (!HpackEncodeInteger(buffer, position, flags, prefixBits, index))
+    return 0;
+  if (index == 0 && !HpackEncodeString(buffer, position, &field->name))
+    return 0;
+  if (!HpackEncodeString(buffer, position, &field->value))
+    return 0;
+
+  if (indexing == HPACK_INDEXING_INCREMENTAL)
+    HpackTableAdd(table, &field->name, &field->value);
+
+  return 1;
+}
+
+/*
+ * Must be at start of header block.
+ */
+internalfn b8
+HpackEncodeSizeUpdate(struct hpack_table *table, struct string *buffer, u64 *position, u32 sizeMax)
+{
+  if (!HpackEncodeInteger(buffer, position, 0x20, 5, sizeMax))
+    return 0;
+  HpackTableSetSizeMax(table, sizeMax);
+  return 1;
+}
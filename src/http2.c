@@ -0,0 +1,1023 @@
+#pragma once
+
+/*
+ * HTTP/2 Client
+ * https://www.rfc-editor.org/rfc/rfc9113
+ *
+ * Every request is sent on its own stream of one connection. Responses come
+ * back as frames of many streams interleaved, so a slow response does not
+ * hold others back like in HTTP/1.1 pipelining.
+ *
+ * Connection does no I/O by itself. Frames to send are collected in output,
+ * write what Http2Flush() returns to TLS. Give bytes read from TLS to
+ * Http2Receive(), it consumes complete frames only and advances
+ * connection->position, so always pass buffer starting from
+ * connection->position.
+ *
+ * TLS must negotiate "h2" with ALPN before connection is used. Server sends
+ * its SETTINGS first thing, wait for them (connection->isPeerSettingsReceived)
+ * before sending many requests, otherwise server can refuse streams above its
+ * concurrency limit.
+ *
+ * Notes:
+ *   - Response headers and body are written to buffer given to
+ *   Http2Request(), see src/receive_buffer.c. Stream window is its
+ *   reservation, buffer grows as response arrives. Response that does not fit
+ *   in reservation is cancelled.
+ *   - Request content must stay valid until stream is closed, it is sent as
+ *   flow control allows.
+ *   - Server push is disabled.
+ *
+ * @code
+ *   connection = MakeHttp2Connection(arena, 8, 32);
+ *   Http2Start(connection);
+ *   stream = Http2Request(connection, &requestInfo, arena, responseBuffer);
+ *   while (stream->state != HTTP2_STREAM_STATE_CLOSED) {
+ *     output = Http2Flush(connection);
+ *     ssl_write(output)
+ *     filled += ssl_read(buf + filled, length - filled);
+ *     packet = StringFromBuffer(buf + connection->position, filled - connection->position);
+ *     if (!Http2Receive(connection, &packet))
+ *       error(connection->error)
+ *   }
+ *   body = Http2StreamBody(stream);
+ *   Http2StreamRelease(stream);
+ * @endcode
+ */
+
+#include "assert.h"
+#include "hpack.c"
+#include "http_request.c"
+#include "memory.h"
+#include "receive_buffer.c"
+#include "text.h"
+#include "type.h"
+
+#define HTTP2_CONNECTION_PREFACE "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"
+
+enum {
+  HTTP2_FRAME_HEADER_LENGTH = 9,
+  // SETTINGS_MAX_FRAME_SIZE is left as default, so frames received are at most this big
+  HTTP2_FRAME_SIZE_DEFAULT = 16384,
+  HTTP2_FRAME_SIZE_MAX = 16777215,
+  HTTP2_WINDOW_SIZE_DEFAULT = 65535,
+  HTTP2_WINDOW_SIZE_MAX = 2147483647,
+  // connection window is raised to this, so streams are limited by their own window
+  HTTP2_CONNECTION_WINDOW_SIZE = 16 * 1024 * 1024,
+  HTTP2_STREAM_ID_MAX = 2147483647,
+
+  // header block received in HEADERS and CONTINUATION frames
+  HTTP2_HEADER_BLOCK_MAX = 16 * 1024,
+  // Huffman coding shortens strings at most to 5/8
+  HTTP2_SCRATCH_LENGTH = 2 * HTTP2_HEADER_BLOCK_MAX,
+  HTTP2_OUTPUT_LENGTH = 64 * 1024,
+};
+
+enum http2_frame_type {
+  HTTP2_FRAME_DATA = 0x0,
+  HTTP2_FRAME_HEADERS = 0x1,
+  HTTP2_FRAME_PRIORITY = 0x2,
+  HTTP2_FRAME_RST_STREAM = 0x3,
+  HTTP2_FRAME_SETTINGS = 0x4,
+  HTTP2_FRAME_PUSH_PROMISE = 0x5,
+  HTTP2_FRAME_PING = 0x6,
+  HTTP2_FRAME_GOAWAY = 0x7,
+  HTTP2_FRAME_WINDOW_UPDATE = 0x8,
+  HTTP2_FRAME_CONTINUATION = 0x9,
+};
+
+enum http2_frame_flag {
+  HTTP2_FLAG_END_STREAM = 0x1,
+  HTTP2_FLAG_ACK = 0x1,
+  HTTP2_FLAG_END_HEADERS = 0x4,
+  HTTP2_FLAG_PADDED = 0x8,
+  HTTP2_FLAG_PRIORITY = 0x20,
+};
+
+enum http2_setting {
+  HTTP2_SETTINGS_HEADER_TABLE_SIZE = 0x1,
+  HTTP2_SETTINGS_ENABLE_PUSH = 0x2,
+  HTTP2_SETTINGS_MAX_CONCURRENT_STREAMS = 0x3,
+  HTTP2_SETTINGS_INITIAL_WINDOW_SIZE = 0x4,
+  HTTP2_SETTINGS_MAX_FRAME_SIZE = 0x5,
+  HTTP2_SETTINGS_MAX_HEADER_LIST_SIZE = 0x6,
+};
+
+// https://www.rfc-editor.org/rfc/rfc9113#section-7 "Error Codes"
+enum http2_error {
+  HTTP2_ERROR_NONE = 0x0,
+  HTTP2_ERROR_PROTOCOL = 0x1,
+  HTTP2_ERROR_INTERNAL = 0x2,
+  HTTP2_ERROR_FLOW_CONTROL = 0x3,
+  HTTP2_ERROR_SETTINGS_TIMEOUT = 0x4,
+  HTTP2_ERROR_STREAM_CLOSED = 0x5,
+  HTTP2_ERROR_FRAME_SIZE = 0x6,
+  HTTP2_ERROR_REFUSED_STREAM = 0x7,
+  HTTP2_ERROR_CANCEL = 0x8,
+  HTTP2_ERROR_COMPRESSION = 0x9,
+  HTTP2_ERROR_CONNECT = 0xa,
+  HTTP2_ERROR_ENHANCE_YOUR_CALM = 0xb,
+  HTTP2_ERROR_INADEQUATE_SECURITY = 0xc,
+  HTTP2_ERROR_HTTP_1_1_REQUIRED = 0xd,
+};
+
+enum http2_stream_state {
+  // slot is free
+  HTTP2_STREAM_STATE_IDLE,
+  // request content is being sent
+  HTTP2_STREAM_STATE_OPEN,
+  // request is sent, response is being received
+  HTTP2_STREAM_STATE_HALF_CLOSED_LOCAL,
+  // response is complete or stream is reset, see stream->error
+  HTTP2_STREAM_STATE_CLOSED,
+};
+
+struct http2_stream {
+  u32 id;
+  enum http2_stream_state state;
+  enum http2_error error;
+
+  u16 statusCode;
+  b8 isHeadersReceived;
+  // response headers except pseudo headers, strings point into buffer
+  u32 headerCount;
+  u32 headerMax;
+  struct http_header *headers;
+
+  // headers then body are written here, strings stay valid as it grows
+  struct receive_buffer *buffer;
+  u64 bodyStart;
+
+  // request content that is not sent yet
+  struct string pendingContent;
+
+  s64 sendWindow;
+  s64 receiveWindow;
+};
+
+struct http2_connection {
+  enum http2_error error;
+
+  // server sent GOAWAY, streams after lastStreamId are refused
+  b8 isGoingAway;
+  u32 lastStreamId;
+  enum http2_error goAwayError;
+
+  u32 nextStreamId;
+  u32 streamMax;
+  struct http2_stream *streams;
+
+  // settings of server, until first SETTINGS frame arrives limits are unknown
+  b8 isPeerSettingsReceived;
+  u32 peerMaxConcurrentStreams;
+  u32 peerInitialWindowSize;
+  u32 peerMaxFrameSize;
+
+  s64 sendWindow;
+  s64 receiveWindow;
+
+  struct hpack_table *decoder;
+  struct hpack_table *encoder;
+  b8 isEncoderSizeUpdatePending;
+  u32 encoderSizeMax;
+
+  // header block that spans HEADERS and CONTINUATION frames
+  u32 headerBlockStreamId;
+  u8 headerBlockFlags;
+  u64 headerBlockLength;
+  struct string headerBlock;
+  // Huffman decoded strings, encoded request header block
+  struct string scratch;
+
+  // frames waiting to be written
+  struct string output;
+  u64 outputLength;
+
+  // position in received bytes where next frame starts
+  u64 position;
+};
+
+internalfn struct http2_connection *
+MakeHttp2Connection(memory_arena *arena, u32 streamMax, u32 headerMax)
+{
+  debug_assert(streamMax != 0);
+  struct http2_connection *connection = MemoryArenaPush(arena, sizeof(*connection));
+
+  connection->streamMax = streamMax;
+  connection->streams = MemoryArenaPush(arena, sizeof(*connection->streams) * streamMax);
+  for (u32 streamIndex = 0; streamIndex < streamMax; streamIndex++) {
+    struct http2_stream *stream = connection->streams + streamIndex;
+    stream->state = HTTP2_STREAM_STATE_IDLE;
+    stream->headerMax = headerMax;
+    stream->headers = MemoryArenaPush(arena, sizeof(*stream->headers) * headerMax);
+  }
+
+  connection->decoder = MemoryArenaPush(arena, sizeof(*connection->decoder));
+  connection->encoder = MemoryArenaPush(arena, sizeof(*connection->encoder));
+  connection->headerBlock = (struct string){
+      .value = MemoryArenaPush(arena, HTTP2_HEADER_BLOCK_MAX),
+      .length = HTTP2_HEADER_BLOCK_MAX,
+  };
+  connection->scratch = (struct string){
+      .value = MemoryArenaPush(arena, HTTP2_SCRATCH_LENGTH),
+      .length = HTTP2_SCRATCH_LENGTH,
+  };
+  connection->output = (struct string){
+      .value = MemoryArenaPush(arena, HTTP2_OUTPUT_LENGTH),
+      .length = HTTP2_OUTPUT_LENGTH,
+  };
+
+  return connection;
+}
+
+internalfn u32
+Http2ReadU32(u8 *buffer)
+{
+  return (u32)buffer[0] << 24 | (u32)buffer[1] << 16 | (u32)buffer[2] << 8 | (u32)buffer[3];
+}
+
+internalfn void
+Http2WriteU32(u8 *buffer, u32 value)
+{
+  buffer[0] = (u8)(value >> 24);
+  buffer[1] = (u8)(value >> 16);
+  buffer[2] = (u8)(value >> 8);
+  buffer[3] = (u8)(value >> 0);
+}
+
+/*
+ * Appends frame header to output.
+ * @return where payload of length must be written
+ *         null if output is full
+ */
+internalfn u8 *
+Http2PushFrame(struct http2_connection *connection, u64 length, enum http2_frame_type type, u8 flags, u32 streamId)
+{
+  u64 frameLength = HTTP2_FRAME_HEADER_LENGTH + length;
+  if (frameLength > connection->output.length - connection->outputLength)
+    return 0;
+
+  u8 *frame = connection->output.value + connection->outputLength;
+  frame[0] = (u8)(length >> 16);
+  frame[1] = (u8)(length >> 8);
+  frame[2] = (u8)(length >> 0);
+  frame[3] = (u8)type;
+  frame[4] = flags;
+  Http2WriteU32(frame + 5, streamId);
+
+  connection->outputLength += frameLength;
+  return frame + HTTP2_FRAME_HEADER_LENGTH;
+}
+
+internalfn void
+Http2PushWindowUpdate(struct http2_connection *connection, u32 streamId, u32 increment)
+{
+  u8 *payload = Http2PushFrame(connection, 4, HTTP2_FRAME_WINDOW_UPDATE, 0, streamId);
+  if (payload)
+    Http2WriteU32(payload, increment);
+}
+
+internalfn b8
+IsHttp2StreamActive(struct http2_stream *stream)
+{
+  return stream->state == HTTP2_STREAM_STATE_OPEN || stream->state == HTTP2_STREAM_STATE_HALF_CLOSED_LOCAL;
+}
+
+internalfn struct http2_stream *
+Http2FindStream(struct http2_connection *connection, u32 streamId)
+{
+  for (u32 streamIndex = 0; streamIndex < connection->streamMax; streamIndex++) {
+    struct http2_stream *stream = connection->streams + streamIndex;
+    if (stream->state != HTTP2_STREAM_STATE_IDLE && stream->id == streamId)
+      return stream;
+  }
+  return 0;
+}
+
+/*
+ * Stream error, only stream is closed.
+ * https://www.rfc-editor.org/rfc/rfc9113#section-5.4.2 "Stream Error Handling"
+ */
+internalfn void
+Http2StreamReset(struct http2_connection *connection, struct http2_stream *stream, enum http2_error error)
+{
+  u8 *payload = Http2PushFrame(connection, 4, HTTP2_FRAME_RST_STREAM, 0, stream->id);
+  if (payload)
+    Http2WriteU32(payload, error);
+  stream->state = HTTP2_STREAM_STATE_CLOSED;
+  stream->error = error;
+}
+
+/*
+ * Connection error, GOAWAY is sent and every stream fails. Write output then
+ * close connection.
+ * https://www.rfc-editor.org/rfc/rfc9113#section-5.4.1 "Connection Error Handling"
+ * @return false
+ */
+internalfn b8
+Http2ConnectionFail(struct http2_connection *connection, enum http2_error error)
+{
+  connection->error = error;
+
+  u8 *payload = Http2PushFrame(connection, 8, HTTP2_FRAME_GOAWAY, 0, 0);
+  if (payload) {
+    // server cannot open streams, none is processed
+    Http2WriteU32(payload + 0, 0);
+    Http2WriteU32(payload + 4, error);
+  }
+
+  for (u32 streamIndex = 0; streamIndex < connection->streamMax; streamIndex++) {
+    struct http2_stream *stream = connection->streams + streamIndex;
+    if (!IsHttp2StreamActive(stream))
+      continue;
+    stream->state = HTTP2_STREAM_STATE_CLOSED;
+    stream->error = error;
+  }
+
+  return 0;
+}
+
+/*
+ * Sends request content of open streams as much as flow control and output
+ * allows.
+ */
+internalfn void
+Http2SendPendingData(struct http2_connection *connection)
+{
+  for (u32 streamIndex = 0; streamIndex < connection->streamMax; streamIndex++) {
+    struct http2_stream *stream = connection->streams + streamIndex;
+    while (stream->state == HTTP2_STREAM_STATE_OPEN) {
+      s64 window = connection->sendWindow < stream->sendWindow ? connection->sendWindow : stream->sendWindow;
+      u64 outputFree = connection->output.length - connection->outputLength;
+      if (window <= 0 || outputFree <= HTTP2_FRAME_HEADER_LENGTH)
+        break;
+
+      struct string *pending = &stream->pendingContent;
+      u64 length = pending->length;
+      if (length > connection->peerMaxFrameSize)
+        length = connection->peerMaxFrameSize;
+      if (length > (u64)window)
+        length = (u64)window;
+      if (length > outputFree - HTTP2_FRAME_HEADER_LENGTH)
+        length = outputFree - HTTP2_FRAME_HEADER_LENGTH;
+
+      b8 isLast = length == pending->length;
+      u8 flags = isLast ? HTTP2_FLAG_END_STREAM : 0;
+      u8 *payload = Http2PushFrame(connection, length, HTTP2_FRAME_DATA, flags, stream->id);
+      MemoryCopy(payload, pending->value, length);
+      pending->value += length;
+      pending->length -= length;
+      connection->sendWindow -= (s64)length;
+      stream->sendWindow -= (s64)length;
+
+      if (isLast)
+        stream->state = HTTP2_STREAM_STATE_HALF_CLOSED_LOCAL;
+    }
+  }
+}
+
+/*
+ * Sends connection preface and settings. Call once before anything else.
+ */
+internalfn void
+Http2Start(struct http2_connection *connection)
+{
+  connection->error = HTTP2_ERROR_NONE;
+  connection->isGoingAway = 0;
+  connection->lastStreamId = 0;
+  connection->goAwayError = HTTP2_ERROR_NONE;
+  connection->nextStreamId = 1;
+  for (u32 streamIndex = 0; streamIndex < connection->streamMax; streamIndex++)
+    connection->streams[streamIndex].state = HTTP2_STREAM_STATE_IDLE;
+
+  // unlimited until server tells otherwise
+  connection->isPeerSettingsReceived = 0;
+  connection->peerMaxConcurrentStreams = U32_MAX;
+  connection->peerInitialWindowSize = HTTP2_WINDOW_SIZE_DEFAULT;
+  connection->peerMaxFrameSize = HTTP2_FRAME_SIZE_DEFAULT;
+  connection->sendWindow = HTTP2_WINDOW_SIZE_DEFAULT;
+  connection->receiveWindow = HTTP2_CONNECTION_WINDOW_SIZE;
+
+  HpackTableInit(connection->decoder, HPACK_TABLE_SIZE_DEFAULT);
+  HpackTableInit(connection->encoder, HPACK_TABLE_SIZE_DEFAULT);
+  connection->isEncoderSizeUpdatePending = 0;
+  connection->encoderSizeMax = HPACK_TABLE_SIZE_DEFAULT;
+
+  connection->headerBlockStreamId = 0;
+  connection->outputLength = 0;
+  connection->position = 0;
+
+  struct string preface = StringFromLiteral(HTTP2_CONNECTION_PREFACE);
+  MemoryCopy(connection->output.value, preface.value, preface.length);
+  connection->outputLength = preface.length;
+
+  u8 *payload = Http2PushFrame(connection, 6, HTTP2_FRAME_SETTINGS, 0, 0);
+  payload[0] = 0;
+  payload[1] = HTTP2_SETTINGS_ENABLE_PUSH;
+  Http2WriteU32(payload + 2, 0);
+
+  Http2PushWindowUpdate(connection, 0, HTTP2_CONNECTION_WINDOW_SIZE - HTTP2_WINDOW_SIZE_DEFAULT);
+}
+
+/*
+ * @return frames to write to TLS, output is emptied
+ */
+internalfn struct string
+Http2Flush(struct http2_connection *connection)
+{
+  struct string output = StringFromBuffer(connection->output.value, connection->outputLength);
+  connection->outputLength = 0;
+  return output;
+}
+
+/*
+ * Opens stream and sends request on it. Response is written to buffer, what
+ * it holds is dropped.
+ * Path with query, content of form requests and compressed content are built
+ * in memory.
+ * @return stream
+ *         null if connection has failed or is going away, server does not
+ *         allow more concurrent streams, no stream slot is free or output is
+ *         full. Flush output and receive, then try again.
+ */
+internalfn struct http2_stream *
+Http2Request(struct http2_connection *connection, struct http_request_info *info, memory_arena *memory,
+             struct receive_buffer *buffer)
+{
+  debug_assert(buffer->reserved >= HTTP2_WINDOW_SIZE_DEFAULT);
+  if (connection->error != HTTP2_ERROR_NONE || connection->isGoingAway ||
+      connection->nextStreamId > HTTP2_STREAM_ID_MAX)
+    return 0;
+
+  struct string host;
+  struct string path;
+  if (!HttpRequestHostAndPath(info, memory, &host, &path))
+    return 0;
+
+  struct http2_stream *stream = 0;
+  u32 activeStreamCount = 0;
+  for (u32 streamIndex = 0; streamIndex < connection->streamMax; streamIndex++) {
+    struct http2_stream *candidate = connection->streams + streamIndex;
+    if (IsHttp2StreamActive(candidate))
+      activeStreamCount++;
+    else if (!stream && candidate->state == HTTP2_STREAM_STATE_IDLE)
+      stream = candidate;
+  }
+  if (!stream || activeStreamCount >= connection->peerMaxConcurrentStreams)
+    return 0;
+
+  // encoding changes encoder table, so there must be room for whole request
+  u64 headerFrameCount = (connection->scratch.length + connection->peerMaxFrameSize - 1) / connection->peerMaxFrameSize;
+  u64 outputNeeded = connection->scratch.length + headerFrameCount * HTTP2_FRAME_HEADER_LENGTH +
+                     HTTP2_FRAME_HEADER_LENGTH + 4 /* WINDOW_UPDATE */;
+  if (connection->output.length - connection->outputLength < outputNeeded)
+    return 0;
+
+  struct string content = info->content ? HttpRequestContent(info, memory) : StringNull();
+  if (info->content && IsStringNull(&content))
+    return 0;
+  if (info->content && info->contentEncoding != HTTP_ENCODING_NONE) {
+    struct string raw = content;
+    struct string *encodedBuffer = MakeString(memory, HttpRequestContentEncodedBound(info, raw.length));
+    memory_temp encoderMemory = MemoryTempBegin(memory);
+    content = HttpRequestContentEncode(info, &raw, encodedBuffer, encoderMemory.arena);
+    MemoryTempEnd(&encoderMemory);
+    if (IsStringNull(&content))
+      return 0;
+  }
+
+  /*****************************************************************
+   * Header block
+   *****************************************************************/
+  memory_temp tempMemory = MemoryTempBegin(memory);
+  struct string *block = &connection->scratch;
+  u64 blockLength = 0;
+  struct hpack_table *encoder = connection->encoder;
+  b8 ok = 1;
+
+  if (connection->isEncoderSizeUpdatePending) {
+    ok = ok && HpackEncodeSizeUpdate(encoder, block, &blockLength, connection->encoderSizeMax);
+    connection->isEncoderSizeUpdatePending = 0;
+  }
+
+  struct http_header pseudoHeaders[] = {
+      {StringFromLiteral(":method"), HttpMethodString(info->method)},
+      {StringFromLiteral(":scheme"), StringFromLiteral("https")},
+      {StringFromLiteral(":authority"), host},
+  };
+  for (u32 headerIndex = 0; headerIndex < ARRAY_COUNT(pseudoHeaders); headerIndex++)
+    ok = ok && HpackEncodeField(encoder, block, &blockLength, pseudoHeaders + headerIndex, HPACK_INDEXING_INCREMENTAL);
+
+  // path changes every request, do not fill table with it
+  struct http_header pathHeader = {StringFromLiteral(":path"), path};
+  ok = ok && HpackEncodeField(encoder, block, &blockLength, &pathHeader, HPACK_INDEXING_NONE);
+
+  for (u32 headerIndex = 0; headerIndex < info->headerCount; headerIndex++)
+    ok = ok && HpackEncodeField(encoder, block, &blockLength, info->headers + headerIndex, HPACK_INDEXING_INCREMENTAL);
+
+  if (info->range) {
+    struct http_range *range = info->range;
+    if (range->start > range->end) {
+      MemoryTempEnd(&tempMemory);
+      return 0;
+    }
+
+    string_builder *sb = MakeStringBuilder(tempMemory.arena, 64, 32);
+    StringBuilderAppendStringLiteral(sb, "bytes=");
+    StringBuilderAppendU64(sb, range->start);
+    StringBuilderAppendStringLiteral(sb, "-");
+    if (range->end != HTTP_RANGE_END)
+      StringBuilderAppendU64(sb, range->end);
+    struct http_header rangeHeader = {StringFromLiteral("range"), StringBuilderFlush(sb)};
+    ok = ok && HpackEncodeField(encoder, block, &blockLength, &rangeHeader, HPACK_INDEXING_NONE);
+  }
+
+  if (info->content) {
+    struct http_header contentTypeHeader = {StringFromLiteral("content-type"),
+                                            HttpContentTypeString(info->contentType)};
+    ok = ok && HpackEncodeField(encoder, block, &blockLength, &contentTypeHeader, HPACK_INDEXING_INCREMENTAL);
+
+    if (info->contentEncoding != HTTP_ENCODING_NONE) {
+      struct http_header contentEncodingHeader = {StringFromLiteral("content-encoding"),
+                                                  HttpEncodingString(info->contentEncoding)};
+      ok = ok && HpackEncodeField(encoder, block, &blockLength, &contentEncodingHeader, HPACK_INDEXING_INCREMENTAL);
+    }
+
+    struct string *contentLengthBuffer = MakeString(tempMemory.arena, 32);
+    struct http_header contentLengthHeader = {StringFromLiteral("content-length"),
+                                              FormatU64(contentLengthBuffer, content.length)};
+    ok = ok && HpackEncodeField(encoder, block, &blockLength, &contentLengthHeader, HPACK_INDEXING_NONE);
+  }
+
+  MemoryTempEnd(&tempMemory);
+
+  // encoder table has fields that server will never see
+  if (!ok) {
+    Http2ConnectionFail(connection, HTTP2_ERROR_INTERNAL);
+    return 0;
+  }
+
+  /*****************************************************************
+   * HEADERS and CONTINUATION frames
+   *****************************************************************/
+  u32 streamId = connection->nextStreamId;
+  connection->nextStreamId += 2;
+
+  b8 isEndStream = content.length == 0;
+  u64 blockWritten = 0;
+  do {
+    u64 fragmentLength = blockLength - blockWritten;
+    if (fragmentLength > connection->peerMaxFrameSize)
+      fragmentLength = connection->peerMaxFrameSize;
+
+    b8 isFirst = blockWritten == 0;
+    b8 isLast = blockWritten + fragmentLength == blockLength;
+    enum http2_frame_type type = isFirst ? HTTP2_FRAME_HEADERS : HTTP2_FRAME_CONTINUATION;
+    u8 flags = (u8)((isFirst && isEndStream ? HTTP2_FLAG_END_STREAM : 0) | (isLast ? HTTP2_FLAG_END_HEADERS : 0));
+
+    u8 *payload = Http2PushFrame(connection, fragmentLength, type, flags, streamId);
+    MemoryCopy(payload, block->value + blockWritten, fragmentLength);
+    blockWritten += fragmentLength;
+  } while (blockWritten < blockLength);
+
+  stream->id = streamId;
+  stream->state = isEndStream ? HTTP2_STREAM_STATE_HALF_CLOSED_LOCAL : HTTP2_STREAM_STATE_OPEN;
+  stream->error = HTTP2_ERROR_NONE;
+  stream->statusCode = 0;
+  stream->isHeadersReceived = 0;
+  stream->headerCount = 0;
+  stream->buffer = buffer;
+  buffer->length = 0;
+  stream->bodyStart = 0;
+  stream->pendingContent = content;
+  stream->sendWindow = connection->peerInitialWindowSize;
+  stream->receiveWindow = HTTP2_WINDOW_SIZE_DEFAULT;
+
+  // let server send as much as buffer can grow to, pages are committed as it arrives
+  u64 window = buffer->reserved < HTTP2_WINDOW_SIZE_MAX ? buffer->reserved : HTTP2_WINDOW_SIZE_MAX;
+  if (window > (u64)stream->receiveWindow) {
+    Http2PushWindowUpdate(connection, streamId, (u32)(window - (u64)stream->receiveWindow));
+    stream->receiveWindow = (s64)window;
+  }
+
+  Http2SendPendingData(connection);
+  return stream;
+}
+
+internalfn struct string
+Http2StreamBody(struct http2_stream *stream)
+{
+  return StringFromBuffer(stream->buffer->value + stream->bodyStart, stream->buffer->length - stream->bodyStart);
+}
+
+/*
+ * Frees slot of closed stream for another request.
+ */
+internalfn void
+Http2StreamRelease(struct http2_stream *stream)
+{
+  debug_assert(stream->state == HTTP2_STREAM_STATE_CLOSED);
+  stream->state = HTTP2_STREAM_STATE_IDLE;
+}
+
+/*
+ * Decodes header block collected from HEADERS and CONTINUATION frames. Block
+ * of stream that is already closed is still decoded to keep decoder table in
+ * sync.
+ */
+internalfn b8
+Http2ReceiveHeaderBlock(struct http2_connection *connection)
+{
+  struct http2_stream *stream = Http2FindStream(connection, connection->headerBlockStreamId);
+  if (stream && !IsHttp2StreamActive(stream))
+    stream = 0;
+  // second header block is trailers, they are ignored
+  b8 isTrailer = stream && stream->isHeadersReceived;
+  b8 isOverflow = 0;
+  u64 statusCode = 0;
+  u64 contentLength = 0;
+
+  struct string block = StringFromBuffer(connection->headerBlock.value, connection->headerBlockLength);
+  u64 position = 0;
+  while (position < block.length) {
+    struct http_header field;
+    if (!HpackDecodeField(connection->decoder, &block, &position, &connection->scratch, &field))
+      return Http2ConnectionFail(connection, HTTP2_ERROR_COMPRESSION);
+
+    if (!stream || isTrailer || IsStringNull(&field.name))
+      continue;
+
+    if (IsStringEqual(&field.name, &StringFromLiteral(":status"))) {
+      if (field.value.length != 3 || !ParseU64(&field.value, &statusCode))
+        statusCode = 0;
+      continue;
+    }
+
+    // other pseudo headers are not defined for responses
+    if (field.name.length != 0 && field.name.value[0] == ':')
+      continue;
+
+    // names are lowercase in HTTP/2
+    if (IsStringEqual(&field.name, &StringFromLiteral("content-length")) && !ParseU64(&field.value, &contentLength))
+      contentLength = 0;
+
+    if (stream->headerCount == stream->headerMax)
+      continue;
+
+    struct receive_buffer *buffer = stream->buffer;
+    u64 fieldLength = field.name.length + field.value.length;
+    if (!ReceiveBufferGrow(buffer, buffer->length + fieldLength)) {
+      isOverflow = 1;
+      continue;
+    }
+
+    struct http_header *header = stream->headers + stream->headerCount;
+    u8 *name = buffer->value + buffer->length;
+    MemoryCopy(name, field.name.value, field.name.length);
+    header->name = StringFromBuffer(name, field.name.length);
+    u8 *value = name + field.name.length;
+    MemoryCopy(value, field.value.value, field.value.length);
+    header->value = StringFromBuffer(value, field.value.length);
+    buffer->length += fieldLength;
+    stream->headerCount++;
+  }
+
+  connection->headerBlockStreamId = 0;
+  if (!stream)
+    return 1;
+
+  if (!isTrailer) {
+    if (statusCode < 100) {
+      Http2StreamReset(connection, stream, HTTP2_ERROR_PROTOCOL);
+      return 1;
+    }
+
+    // informational response, final one comes after
+    if (statusCode < 200) {
+      stream->headerCount = 0;
+      stream->buffer->length = 0;
+      return 1;
+    }
+
+    // body is given its whole capacity at once when its length is known
+    if (isOverflow || !ReceiveBufferGrow(stream->buffer, stream->buffer->length + contentLength)) {
+      Http2StreamReset(connection, stream, HTTP2_ERROR_CANCEL);
+      return 1;
+    }
+
+    stream->statusCode = (u16)statusCode;
+    stream->isHeadersReceived = 1;
+    stream->bodyStart = stream->buffer->length;
+  }
+
+  if (connection->headerBlockFlags & HTTP2_FLAG_END_STREAM)
+    stream->state = HTTP2_STREAM_STATE_CLOSED;
+
+  return 1;
+}
+
+/*
+ * Removes padding and priority fields from payload.
+ * @return false if padding is longer than payload
+ */
+internalfn b8
+Http2FramePayloadStrip(struct string *payload, u8 flags)
+{
+  u64 padLength = 0;
+  if (flags & HTTP2_FLAG_PADDED) {
+    if (payload->length < 1)
+      return 0;
+    padLength = payload->value[0];
+    payload->value += 1;
+    payload->length -= 1;
+  }
+
+  if (flags & HTTP2_FLAG_PRIORITY) {
+    // stream dependency (4) and weight (1)
+    if (payload->length < 5)
+      return 0;
+    payload->value += 5;
+    payload->length -= 5;
+  }
+
+  if (padLength > payload->length)
+    return 0;
+  payload->length -= padLength;
+  return 1;
+}
+
+internalfn b8
+Http2ReceiveFrame(struct http2_connection *connection, enum http2_frame_type type, u8 flags, u32 streamId,
+                  struct string *payload)
+{
+  // header block must not be interrupted by any other frame
+  if (connection->headerBlockStreamId != 0 &&
+      (type != HTTP2_FRAME_CONTINUATION || streamId != connection->headerBlockStreamId))
+    return Http2ConnectionFail(connection, HTTP2_ERROR_PROTOCOL);
+
+  switch (type) {
+  case HTTP2_FRAME_DATA: {
+    if (streamId == 0)
+      return Http2ConnectionFail(connection, HTTP2_ERROR_PROTOCOL);
+
+    // whole frame counts, including padding
+    u64 frameLength = payload->length;
+    if ((s64)frameLength > connection->receiveWindow)
+      return Http2ConnectionFail(connection, HTTP2_ERROR_FLOW_CONTROL);
+    connection->receiveWindow -= (s64)frameLength;
+
+    struct string data = *payload;
+    if (!Http2FramePayloadStrip(&data, flags & HTTP2_FLAG_PADDED))
+      return Http2ConnectionFail(connection, HTTP2_ERROR_PROTOCOL);
+
+    struct http2_stream *stream = Http2FindStream(connection, streamId);
+    if (!stream) {
+      // streams that client did not open are idle
+      if ((streamId & 1) == 0 || streamId >= connection->nextStreamId)
+        return Http2ConnectionFail(connection, HTTP2_ERROR_PROTOCOL);
+    } else if (IsHttp2StreamActive(stream)) {
+      if (!stream->isHeadersReceived) {
+        Http2StreamReset(connection, stream, HTTP2_ERROR_PROTOCOL);
+      } else if ((s64)frameLength > stream->receiveWindow) {
+        Http2StreamReset(connection, stream, HTTP2_ERROR_FLOW_CONTROL);
+      } else if (!ReceiveBufferAppend(stream->buffer, &data)) {
+        Http2StreamReset(connection, stream, HTTP2_ERROR_CANCEL);
+      } else {
+        stream->receiveWindow -= (s64)frameLength;
+        if (flags & HTTP2_FLAG_END_STREAM)
+          stream->state = HTTP2_STREAM_STATE_CLOSED;
+      }
+    }
+
+    // data is copied out already, give window back to server
+    if (connection->receiveWindow <= HTTP2_CONNECTION_WINDOW_SIZE / 2) {
+      Http2PushWindowUpdate(connection, 0, (u32)(HTTP2_CONNECTION_WINDOW_SIZE - connection->receiveWindow));
+      connection->receiveWindow = HTTP2_CONNECTION_WINDOW_SIZE;
+    }
+  } break;
+
+  case HTTP2_FRAME_HEADERS: {
+    // server push is disabled, only streams opened by client
+    if (streamId == 0 || (streamId & 1) == 0 || streamId >= connection->nextStreamId)
+      return Http2ConnectionFail(connection, HTTP2_ERROR_PROTOCOL);
+
+    struct string fragment = *payload;
+    if (!Http2FramePayloadStrip(&fragment, flags))
+      return Http2ConnectionFail(connection, HTTP2_ERROR_PROTOCOL);
+    if (fragment.length > connection->headerBlock.length)
+      return Http2ConnectionFail(connection, HTTP2_ERROR_INTERNAL);
+
+    MemoryCopy(connection->headerBlock.value, fragment.value, fragment.length);
+    connection->headerBlockLength = fragment.length;
+    connection->headerBlockStreamId = streamId;
+    connection->headerBlockFlags = flags;
+    if (flags & HTTP2_FLAG_END_HEADERS)
+      return Http2ReceiveHeaderBlock(connection);
+  } break;
+
+  case HTTP2_FRAME_CONTINUATION: {
+    if (connection->headerBlockStreamId == 0)
+      return Http2ConnectionFail(connection, HTTP2_ERROR_PROTOCOL);
+    if (payload->length > connection->headerBlock.length - connection->headerBlockLength)
+      return Http2ConnectionFail(connection, HTTP2_ERROR_INTERNAL);
+
+    MemoryCopy(connection->headerBlock.value + connection->headerBlockLength, payload->value, payload->length);
+    connection->headerBlockLength += payload->length;
+    if (flags & HTTP2_FLAG_END_HEADERS)
+      return Http2ReceiveHeaderBlock(connection);
+  } break;
+
+  case HTTP2_FRAME_PRIORITY: {
+    if (streamId == 0)
+      return Http2ConnectionFail(connection, HTTP2_ERROR_PROTOCOL);
+    // deprecated, ignored
+  } break;
+
+  case HTTP2_FRAME_RST_STREAM: {
+    if (streamId == 0)
+      return Http2ConnectionFail(connection, HTTP2_ERROR_PROTOCOL);
+    if (payload->length != 4)
+      return Http2ConnectionFail(connection, HTTP2_ERROR_FRAME_SIZE);
+
+    struct http2_stream *stream = Http2FindStream(connection, streamId);
+    if (stream && IsHttp2StreamActive(stream)) {
+      stream->state = HTTP2_STREAM_STATE_CLOSED;
+      stream->error = (enum http2_error)Http2ReadU32(payload->value);
+    }
+  } break;
+
+  case HTTP2_FRAME_SETTINGS: {
+    if (streamId != 0)
+      return Http2ConnectionFail(connection, HTTP2_ERROR_PROTOCOL);
+    if (flags & HTTP2_FLAG_ACK) {
+      if (payload->length != 0)
+        return Http2ConnectionFail(connection, HTTP2_ERROR_FRAME_SIZE);
+      break;
+    }
+    if (payload->length % 6 != 0)
+      return Http2ConnectionFail(connection, HTTP2_ERROR_FRAME_SIZE);
+
+    for (u64 settingIndex = 0; settingIndex < payload->length; settingIndex += 6) {
+      u8 *setting = payload->value + settingIndex;
+      u16 identifier = (u16)(setting[0] << 8 | setting[1]);
+      u32 value = Http2ReadU32(setting + 2);
+
+      switch (identifier) {
+      case HTTP2_SETTINGS_HEADER_TABLE_SIZE: {
+        u32 sizeMax = value < HPACK_TABLE_SIZE_DEFAULT ? value : HPACK_TABLE_SIZE_DEFAULT;
+        if (sizeMax != connection->encoder->sizeMax) {
+          connection->encoderSizeMax = sizeMax;
+          connection->isEncoderSizeUpdatePending = 1;
+        }
+      } break;
+
+      case HTTP2_SETTINGS_ENABLE_PUSH: {
+        if (value > 1)
+          return Http2ConnectionFail(connection, HTTP2_ERROR_PROTOCOL);
+      } break;
+
+      case HTTP2_SETTINGS_MAX_CONCURRENT_STREAMS: {
+        connection->peerMaxConcurrentStreams = value;
+      } break;
+
+      case HTTP2_SETTINGS_INITIAL_WINDOW_SIZE: {
+        if (value > HTTP2_WINDOW_SIZE_MAX)
+          return Http2ConnectionFail(connection, HTTP2_ERROR_FLOW_CONTROL);
+
+        // change applies to windows of every open stream
+        s64 delta = (s64)value - (s64)connection->peerInitialWindowSize;
+        for (u32 streamIndex = 0; streamIndex < connection->streamMax; streamIndex++) {
+          struct http2_stream *stream = connection->streams + streamIndex;
+          if (!IsHttp2StreamActive(stream))
+            continue;
+          stream->sendWindow += delta;
+          if (stream->sendWindow > HTTP2_WINDOW_SIZE_MAX)
+            return Http2ConnectionFail(connection, HTTP2_ERROR_FLOW_CONTROL);
+        }
+        connection->peerInitialWindowSize = value;
+      } break;
+
+      case HTTP2_SETTINGS_MAX_FRAME_SIZE: {
+        if (value < HTTP2_FRAME_SIZE_DEFAULT || value > HTTP2_FRAME_SIZE_MAX)
+          return Http2ConnectionFail(connection, HTTP2_ERROR_PROTOCOL);
+        connection->peerMaxFrameSize = value;
+      } break;
+
+      default: {
+        // unknown settings must be ignored
+      } break;
+      }
+    }
+
+    connection->isPeerSettingsReceived = 1;
+    Http2PushFrame(connection, 0, HTTP2_FRAME_SETTINGS, HTTP2_FLAG_ACK, 0);
+    Http2SendPendingData(connection);
+  } break;
+
+  case HTTP2_FRAME_PUSH_PROMISE: {
+    // SETTINGS_ENABLE_PUSH is 0
+    return Http2ConnectionFail(connection, HTTP2_ERROR_PROTOCOL);
+  } break;
+
+  case HTTP2_FRAME_PING: {
+    if (streamId != 0)
+      return Http2ConnectionFail(connection, HTTP2_ERROR_PROTOCOL);
+    if (payload->length != 8)
+      return Http2ConnectionFail(connection, HTTP2_ERROR_FRAME_SIZE);
+
+    if ((flags & HTTP2_FLAG_ACK) == 0) {
+      u8 *pong = Http2PushFrame(connection, 8, HTTP2_FRAME_PING, HTTP2_FLAG_ACK, 0);
+      if (pong)
+        MemoryCopy(pong, payload->value, 8);
+    }
+  } break;
+
+  case HTTP2_FRAME_GOAWAY: {
+    if (streamId != 0)
+      return Http2ConnectionFail(connection, HTTP2_ERROR_PROTOCOL);
+    if (payload->length < 8)
+      return Http2ConnectionFail(connection, HTTP2_ERROR_FRAME_SIZE);
+
+    connection->isGoingAway = 1;
+    connection->lastStreamId = Http2ReadU32(payload->value) & HTTP2_STREAM_ID_MAX;
+    connection->goAwayError = (enum http2_error)Http2ReadU32(payload->value + 4);
+
+    // streams after last one were not processed, safe to retry on new connection
+    for (u32 streamIndex = 0; streamIndex < connection->streamMax; streamIndex++) {
+      struct http2_stream *stream = connection->streams + streamIndex;
+      if (!IsHttp2StreamActive(stream) || stream->id <= connection->lastStreamId)
+        continue;
+      stream->state = HTTP2_STREAM_STATE_CLOSED;
+      stream->error = HTTP2_ERROR_REFUSED_STREAM;
+    }
+  } break;
+
+  case HTTP2_FRAME_WINDOW_UPDATE: {
+    if (payload->length != 4)
+      return Http2ConnectionFail(connection, HTTP2_ERROR_FRAME_SIZE);
+
+    u32 increment = Http2ReadU32(payload->value) & HTTP2_WINDOW_SIZE_MAX;
+    if (streamId == 0) {
+      if (increment == 0)
+        return Http2ConnectionFail(connection, HTTP2_ERROR_PROTOCOL);
+      connection->sendWindow += increment;
+      if (connection->sendWindow > HTTP2_WINDOW_SIZE_MAX)
+        return Http2ConnectionFail(connection, HTTP2_ERROR_FLOW_CONTROL);
+    } else {
+      struct http2_stream *stream = Http2FindStream(connection, streamId);
+      if (stream && IsHttp2StreamActive(stream)) {
+        stream->sendWindow += increment;
+        if (increment == 0)
+          Http2StreamReset(connection, stream, HTTP2_ERROR_PROTOCOL);
+        else if (stream->sendWindow > HTTP2_WINDOW_SIZE_MAX)
+          Http2StreamReset(connection, stream, HTTP2_ERROR_FLOW_CONTROL);
+      }
+    }
+
+    Http2SendPendingData(connection);
+  } break;
+
+  default: {
+    // unknown frame types must be ignored
+  } break;
+  }
+
+  return 1;
+}
+
+/*
+ * Processes every complete frame in input. Frames that need an answer (e.g.
+ * SETTINGS, PING) add to output, flush it after calling.
+ * @return false on connection error, see connection->error
+ */
+internalfn b8
+Http2Receive(struct http2_connection *connection, struct string *input)
+{
+  if (connection->error != HTTP2_ERROR_NONE)
+    return 0;
+
+  u64 inputPosition = 0;
+  while (input->length - inputPosition >= HTTP2_FRAME_HEADER_LENGTH) {
+    u8 *frame = input->value + inputPosition;
+    u32 length = (u32)frame[0] << 16 | (u32)frame[1] << 8 | (u32)frame[2];
+    enum http2_frame_type type = frame[3];
+    u8 flags = frame[4];
+    u32 streamId = Http2ReadU32(frame + 5) & HTTP2_STREAM_ID_MAX;
+
+    if (length > HTTP2_FRAME_SIZE_DEFAULT)
+      return Http2ConnectionFail(connection, HTTP2_ERROR_FRAME_SIZE);
+
+    u64 frameLength = HTTP2_FRAME_HEADER_LENGTH + length;
+    if (input->length - inputPosition < frameLength)
+      break; // partial
+
+    struct string payload = StringFromBuffer(frame + HTTP2_FRAME_HEADER_LENGTH, length);
+    if (!Http2ReceiveFrame(connection, type, flags, streamId, &payload))
+      return 0;
+
+    inputPosition += frameLength;
+    connection->position += frameLength;
+  }
+
+  return 1;
+}
@@ -9,14 +9,22 @@
  *   - Http headers starts at index 3
  *   - If parser has chunked encoded body and content length body, ignore
  *   content length
+ *   - Parser stops at incomplete header line or chunk size line and reports
+ *   partial. parser->position is not advanced past them, so always pass
+ *   buffer starting from parser->position.
+ *   - Content-Range is parsed into parser->contentRange. For 206 (partial
+ *   content) length of the range is used as content length when
+ *   Content-Length is missing, and must match it when present.
+ *   - Parser does not read past end of response, rest of buffer belongs to
+ *   next response. Call HttpParserNext() to parse it.
  *
  * @code
  *   buf = allocate(length)
- *   position = 0;
+ *   filled = 0;
  *   while (1) {
- *     readBytes = ssl_read(buf, length - position);
- *     packet = StringFromBuffer(buf + position, readBytes);
- *     position += readBytes;
+ *     readBytes = ssl_read(buf + filled, length - filled);
+ *     filled += readBytes;
+ *     packet = StringFromBuffer(buf + parser->position, filled - parser->position);
  *     ok = HttpParse(parser, packet);
  *     if (ok)
  *       break;
@@ -25,6 +33,30 @@
  *       exit(1)
  *   }
  * @endcode
+ *
+ * Streaming:
+ *   Every chunk adds 2 tokens, so long chunked body runs out of tokens. Parser
+ *   created with MakeHttpStreamingParser() retires chunk tokens that were
+ *   completed in previous call of HttpParse() and reuses their slots. Only
+ *   header tokens and the chunk currently in progress are kept. Read completed
+ *   chunks after every HttpParse() call, they are gone on next call.
+ *   When all slots are used in one call, parser pauses. Consume chunks and
+ *   call again with the rest of buffer.
+ *
+ * @code
+ *   parser = MakeHttpStreamingParser(arena, 16);
+ *   while (1) {
+ *     ...
+ *     do {
+ *       packet = StringFromBuffer(buf + parser->position, filled - parser->position);
+ *       ok = HttpParse(parser, packet);
+ *       for (index = parser->headerTokenCount; index < parser->tokenCount; index++)
+ *         if (token->type == HTTP_TOKEN_CHUNK_DATA && token->end != 0)
+ *           consume(token)
+ *     } while (parser->error == PAUSED);
+ *     ...
+ *   }
+ * @endcode
  */
 
 #include "assert.h"
@@ -60,6 +92,7 @@ enum http_token_type {
   HTTP_TOKEN_HEADER_ETAG,
   HTTP_TOKEN_HEADER_LOCATION,
   HTTP_TOKEN_HEADER_PROXY_AUTHENTICATE,
+  HTTP_TOKEN_HEADER_RETRY_AFTER,
 
   /* https://www.rfc-editor.org/rfc/rfc2616#section-7.1 "Entity Header Fields" */
 
@@ -106,7 +139,11 @@ enum http_parser_error {
   HTTP_PARSER_ERROR_CHUNK_SIZE_IS_INVALID,
   HTTP_PARSER_ERROR_CHUNK_DATA_MALFORMED,
   HTTP_PARSER_ERROR_CONTENT_INVALID_LENGTH,
+  HTTP_PARSER_ERROR_CONTENT_RANGE_INVALID,
+  HTTP_PARSER_ERROR_CONTENT_RANGE_LENGTH_MISMATCH,
   HTTP_PARSER_ERROR_PARTIAL,
+  // Streaming parser ran out of tokens. Consume chunks and call again with rest.
+  HTTP_PARSER_ERROR_PAUSED,
 };
 
 enum http_parser_state {
@@ -114,8 +151,38 @@ enum http_parser_state {
   HTTP_PARSER_STATE_HEADERS_PARSED = (1 << 1),
   HTTP_PARSER_STATE_HAS_CONTENT_LENGTH_BODY = (1 << 2),
   HTTP_PARSER_STATE_HAS_CHUNKED_ENCODED_BODY = (1 << 3),
+  // completed chunk tokens are retired on next HttpParse() call
+  HTTP_PARSER_STATE_STREAMING = (1 << 4),
+  HTTP_PARSER_STATE_HAS_CONTENT_RANGE = (1 << 5),
+  // server sent "Accept-Ranges: bytes"
+  HTTP_PARSER_STATE_ACCEPTS_RANGES = (1 << 6),
+  // server sent "Connection: close", it closes connection after this response
+  HTTP_PARSER_STATE_CONNECTION_CLOSE = (1 << 7),
+  // server sent "Retry-After", see parser->retryAfter
+  HTTP_PARSER_STATE_HAS_RETRY_AFTER = (1 << 8),
+  // Retry-After is a date, it is turned into seconds with Date when headers end
+  HTTP_PARSER_STATE_RETRY_AFTER_IS_DATE = (1 << 9),
+};
+
+/*
+ * https://www.rfc-editor.org/rfc/rfc9110#section-14.4 "Content-Range"
+ *   Content-Range       = range-unit SP ( range-resp / unsatisfied-range )
+ *   range-resp          = incl-range "/" ( complete-length / "*" )
+ *   incl-range          = first-pos "-" last-pos
+ *   unsatisfied-range   = "*" "/" complete-length
+ */
+struct http_content_range {
+  // first and last byte, both inclusive. HTTP_CONTENT_RANGE_UNKNOWN if range
+  // is unsatisfied (416).
+  u64 start;
+  u64 end;
+  // complete length of resource, HTTP_CONTENT_RANGE_UNKNOWN if server does
+  // not know.
+  u64 total;
 };
 
+comptime u64 HTTP_CONTENT_RANGE_UNKNOWN = (u64)-1;
+
 struct http_parser {
   u16 statusCode;
   u64 contentLength;
@@ -127,6 +194,20 @@ struct http_parser {
   u32 tokenCount;
   u32 tokenMax;
   struct http_token *tokens;
+  // status line and header tokens, chunk tokens starts from here
+  u32 headerTokenCount;
+
+  // size of chunk currently in progress
+  u64 chunkSize;
+
+  // valid if state has HTTP_PARSER_STATE_HAS_CONTENT_RANGE
+  struct http_content_range contentRange;
+
+  // seconds since 1970-01-01 UTC of "Date", 0 when server did not send it
+  u64 date;
+  // seconds to wait before next request, valid if state has
+  // HTTP_PARSER_STATE_HAS_RETRY_AFTER, e.g. with 429 or 503
+  u64 retryAfter;
 
   // last read position from buffer
   u64 position;
@@ -135,10 +216,18 @@ struct http_parser {
 internalfn void
 HttpParserInit(struct http_parser *parser, struct http_token *tokens, u32 tokenCount)
 {
+  parser->statusCode = 0;
+  parser->contentLength = 0;
   parser->state = 0;
+  parser->error = HTTP_PARSER_ERROR_NONE;
   parser->tokenCount = 0;
   parser->tokenMax = tokenCount;
   parser->tokens = tokens;
+  parser->headerTokenCount = 0;
+  parser->chunkSize = 0;
+  parser->contentRange = (struct http_content_range){};
+  parser->date = 0;
+  parser->retryAfter = 0;
   parser->position = 0;
 }
 
@@ -159,6 +248,77 @@ MakeHttpParser(memory_arena *arena, u32 tokenCount)
   return parser;
 }
 
+internalfn struct http_parser *
+MakeHttpStreamingParser(memory_arena *arena, u32 tokenCount)
+{
+  // status line (2) + chunk in progress (2) + at least 1 header
+  debug_assert(tokenCount >= 5);
+  struct http_parser *parser = MakeHttpParser(arena, tokenCount);
+  parser->state |= HTTP_PARSER_STATE_STREAMING;
+  return parser;
+}
+
+/*
+ * Prepares parser for next response on same connection, e.g. with keep-alive
+ * or pipelining. Tokens of previous response are dropped, parsing continues
+ * from parser->position.
+ */
+internalfn void
+HttpParserNext(struct http_parser *parser)
+{
+  u64 position = parser->position;
+  enum http_parser_state streaming = parser->state & HTTP_PARSER_STATE_STREAMING;
+  HttpParserInit(parser, parser->tokens, parser->tokenMax);
+  parser->state |= streaming;
+  parser->position = position;
+}
+
+/*
+ * Length of whole response once its headers are parsed and its body is
+ * limited by content length, so buffer can be sized for it before it arrives.
+ * @return bytes from start of buffer to end of body, 0 when it is not known
+ *         yet, or body is chunked or empty
+ */
+internalfn u64
+HttpParserResponseLength(struct http_parser *parser)
+{
+  if (!(parser->state & HTTP_PARSER_STATE_HAS_CONTENT_LENGTH_BODY) ||
+      (parser->state & HTTP_PARSER_STATE_HAS_CHUNKED_ENCODED_BODY) || parser->tokenCount == 0)
+    return 0;
+
+  // content token is made right after headers end
+  struct http_token *lastToken = parser->tokens + parser->tokenCount - 1;
+  if (lastToken->type != HTTP_TOKEN_CONTENT)
+    return 0;
+  return lastToken->start + parser->contentLength;
+}
+
+/*
+ * Drops chunk tokens except the one that is in progress. Partial chunk data
+ * and its chunk size are moved right after header tokens.
+ */
+internalfn void
+HttpParserRetireChunkTokens(struct http_parser *parser)
+{
+  u32 firstChunkTokenIndex = parser->headerTokenCount;
+  if (parser->tokenCount <= firstChunkTokenIndex)
+    return;
+
+  struct http_token *lastToken = parser->tokens + parser->tokenCount - 1;
+  b8 isChunkInProgress = lastToken->type == HTTP_TOKEN_CHUNK_DATA && lastToken->end == 0;
+  if (!isChunkInProgress) {
+    parser->tokenCount = firstChunkTokenIndex;
+    return;
+  }
+
+  debug_assert(parser->tokenCount - firstChunkTokenIndex >= 2);
+  struct http_token *chunkSizeToken = lastToken - 1;
+  debug_assert(chunkSizeToken->type == HTTP_TOKEN_CHUNK_SIZE);
+  parser->tokens[firstChunkTokenIndex + 0] = *chunkSizeToken;
+  parser->tokens[firstChunkTokenIndex + 1] = *lastToken;
+  parser->tokenCount = firstChunkTokenIndex + 2;
+}
+
 internalfn struct string
 HttpTokenExtractString(struct http_token *token, struct string *httpResponse)
 {
@@ -166,6 +326,153 @@ HttpTokenExtractString(struct http_token *token, struct string *httpResponse)
   return StringFromBuffer(httpResponse->value + token->start, token->end - token->start);
 }
 
+/*
+ * Parses Content-Range field value.
+ * Only "bytes" range unit is supported.
+ * @return true if value is valid
+ */
+internalfn b8
+HttpParseContentRange(struct string *value, struct http_content_range *range)
+{
+  struct string_cursor cursor = StringCursorFromString(value);
+  if (!IsStringCursorStartsWith(&cursor, &StringFromLiteral("bytes ")))
+    return 0;
+
+  struct string *dash = &StringFromLiteral("-");
+  struct string *slash = &StringFromLiteral("/");
+  struct string *asterisk = &StringFromLiteral("*");
+
+  struct string rangeText = StringCursorConsumeUntil(&cursor, slash);
+  if (IsStringNull(&rangeText))
+    return 0;
+  cursor.position += slash->length;
+  struct string totalText = StringCursorExtractRemaining(&cursor);
+
+  if (IsStringEqual(&totalText, asterisk)) {
+    range->total = HTTP_CONTENT_RANGE_UNKNOWN;
+  } else if (!ParseU64(&totalText, &range->total)) {
+    return 0;
+  }
+
+  if (IsStringEqual(&rangeText, asterisk)) {
+    // unsatisfied-range must have complete-length
+    range->start = HTTP_CONTENT_RANGE_UNKNOWN;
+    range->end = HTTP_CONTENT_RANGE_UNKNOWN;
+    return range->total != HTTP_CONTENT_RANGE_UNKNOWN;
+  }
+
+  struct string_cursor rangeCursor = StringCursorFromString(&rangeText);
+  struct string startText = StringCursorConsumeUntil(&rangeCursor, dash);
+  if (IsStringNull(&startText))
+    return 0;
+  rangeCursor.position += dash->length;
+  struct string endText = StringCursorExtractRemaining(&rangeCursor);
+
+  if (!ParseU64(&startText, &range->start) || !ParseU64(&endText, &range->end))
+    return 0;
+
+  if (range->start > range->end)
+    return 0;
+
+  if (range->total != HTTP_CONTENT_RANGE_UNKNOWN && range->end >= range->total)
+    return 0;
+
+  return 1;
+}
+
+/*
+ * https://www.rfc-editor.org/rfc/rfc9110#section-5.6.7 "Date/Time Formats"
+ *   IMF-fixdate  = day-name "," SP date1 SP time-of-day SP GMT
+ *   date1        = day SP month SP year
+ *                ; e.g., 02 Jun 1982
+ *   time-of-day  = hour ":" minute ":" second
+ * Obsolete RFC 850 and asctime formats are not accepted, senders must not
+ * generate them.
+ * @param unixTime seconds since 1970-01-01 UTC
+ * @return false if value is not IMF-fixdate
+ */
+internalfn b8
+HttpParseDate(struct string *value, u64 *unixTime)
+{
+  // Sun, 06 Nov 1994 08:49:37 GMT
+  if (value->length != 29)
+    return 0;
+
+  u8 *date = value->value;
+  if (date[3] != ',' || date[4] != ' ' || date[7] != ' ' || date[11] != ' ' || date[16] != ' ' ||
+      date[19] != ':' || date[22] != ':' || date[25] != ' ' || date[26] != 'G' || date[27] != 'M' ||
+      date[28] != 'T')
+    return 0;
+
+  struct string month = StringFromBuffer(date + 8, 3);
+  struct string months = StringFromLiteral("JanFebMarAprMayJunJulAugSepOctNovDec");
+  u32 monthIndex = 0;
+  for (; monthIndex < 12; monthIndex++) {
+    struct string name = StringFromBuffer(months.value + monthIndex * 3, 3);
+    if (IsStringEqual(&month, &name))
+      break;
+  }
+  if (monthIndex == 12)
+    return 0;
+
+  struct {
+    u32 start;
+    u32 length;
+    u64 max;
+    u64 value;
+  } fields[] = {
+      {.start = 5, .length = 2, .max = 31},    // day
+      {.start = 12, .length = 4, .max = 9999}, // year
+      {.start = 17, .length = 2, .max = 23},   // hour
+      {.start = 20, .length = 2, .max = 59},   // minute
+      {.start = 23, .length = 2, .max = 60},   // second, 60 is leap second
+  };
+  for (u32 fieldIndex = 0; fieldIndex < ARRAY_COUNT(fields); fieldIndex++) {
+    struct string text = StringFromBuffer(date + fields[fieldIndex].start, fields[fieldIndex].length);
+    if (!ParseU64(&text, &fields[fieldIndex].value) || fields[fieldIndex].value > fields[fieldIndex].max)
+      return 0;
+  }
+  u64 day = fields[0].value;
+  u64 year = fields[1].value;
+  if (day == 0 || year < 1970)
+    return 0;
+
+  // days since 1970-01-01, counting years from March so leap day is last
+  // http://howardhinnant.github.io/date_algorithms.html#days_from_civil
+  u64 month1 = monthIndex + 1;
+  if (month1 <= 2)
+    year--;
+  u64 era = year / 400;
+  u64 yearOfEra = year - era * 400;
+  u64 dayOfYear = (153 * (month1 > 2 ? month1 - 3 : month1 + 9) + 2) / 5 + day - 1;
+  u64 dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  u64 days = era * 146097 + dayOfEra - 719468;
+
+  *unixTime = days * 86400 + fields[2].value * 3600 + fields[3].value * 60 + fields[4].value;
+  return 1;
+}
+
+/*
+ * Retry-After of response whose headers HttpParse() does not see, e.g. of
+ * HTTP/2 stream.
+ * @param date value of "Date" of same response, null when there is none
+ * @param seconds to wait
+ * @return false if value cannot be understood
+ */
+internalfn b8
+HttpParseRetryAfter(struct string *value, struct string *date, u64 *seconds)
+{
+  if (value->length <= 10 && ParseU64(value, seconds))
+    return 1;
+
+  u64 retryAt;
+  u64 now;
+  if (!HttpParseDate(value, &retryAt) || !date || !HttpParseDate(date, &now))
+    return 0;
+  *seconds = retryAt > now ? retryAt - now : 0;
+  return 1;
+}
+
 internalfn b8
 HttpParse(struct http_parser *parser, struct string *httpResponse)
 {
@@ -174,6 +481,11 @@ HttpParse(struct http_parser *parser, struct string *httpResponse)
   struct string *SP = &StringFromLiteral(" ");
   struct string *CRLF = &StringFromLiteral("\r\n");
 
+  // content-length body has single token, only chunk tokens are retired
+  if ((parser->state & HTTP_PARSER_STATE_STREAMING) && (parser->state & HTTP_PARSER_STATE_HEADERS_PARSED) &&
+      (parser->state & HTTP_PARSER_STATE_HAS_CHUNKED_ENCODED_BODY))
+    HttpParserRetireChunkTokens(parser);
+
   u32 writtenTokenCount = 0;
   struct string_cursor cursor = StringCursorFromString(httpResponse);
 
@@ -198,7 +510,17 @@ HttpParse(struct http_parser *parser, struct string *httpResponse)
      *     HTTP-Version   = "HTTP" "/" 1*DIGIT "." 1*DIGIT
      */
 
+    /* Status line may be cut, e.g. next response in a pipelined stream. Field
+     * that is not terminated yet but can still become valid is partial, the
+     * status line is parsed again from start on next call.
+     */
     struct string httpVersion = StringCursorExtractUntil(&cursor, SP);
+    if (IsStringNull(&httpVersion)) {
+      struct string remaining = StringCursorExtractRemaining(&cursor);
+      if (remaining.length != 0 && IsStringStartsWith(&StringFromLiteral("HTTP/1.1"), &remaining))
+        goto statusLinePartial;
+    }
+
     if (httpVersion.length != 8) {
       parser->error = HTTP_PARSER_ERROR_HTTP_VERSION_INVALID;
       goto end;
@@ -225,6 +547,9 @@ HttpParse(struct http_parser *parser, struct string *httpResponse)
     }
 
     struct string statusCodeText = StringCursorExtractUntil(&cursor, SP);
+    if (IsStringNull(&statusCodeText) && StringCursorRemainingLength(&cursor) <= 3)
+      goto statusLinePartial;
+
     if (statusCodeText.length != 3) {
       parser->error = HTTP_PARSER_ERROR_STATUS_CODE_INVALID;
       goto end;
@@ -260,6 +585,9 @@ HttpParse(struct http_parser *parser, struct string *httpResponse)
     }
 
     struct string reasonPhrase = StringCursorExtractUntil(&cursor, CRLF);
+    if (IsStringNull(&reasonPhrase))
+      goto statusLinePartial;
+
     if (reasonPhrase.length == 0) {
       parser->error = HTTP_PARSER_ERROR_REASON_PHRASE_INVALID;
       goto end;
@@ -284,10 +612,57 @@ HttpParse(struct http_parser *parser, struct string *httpResponse)
     while (!IsStringCursorAtEnd(&cursor)) {
       if (StringCursorPeekStartsWith(&cursor, CRLF)) {
         parser->state |= HTTP_PARSER_STATE_HEADERS_PARSED;
+        parser->headerTokenCount = parser->tokenCount + writtenTokenCount;
         cursor.position += CRLF->length;
+
+        /* https://www.rfc-editor.org/rfc/rfc9110#section-10.2.3 "Retry-After"
+         *   Retry-After = HTTP-date / delay-seconds
+         * Date is relative to clock of server, so it is compared with Date of
+         * response. Date in past means no wait.
+         */
+        if (parser->state & HTTP_PARSER_STATE_RETRY_AFTER_IS_DATE) {
+          parser->state &= ~(u32)HTTP_PARSER_STATE_RETRY_AFTER_IS_DATE;
+          if (parser->date != 0) {
+            parser->retryAfter = parser->retryAfter > parser->date ? parser->retryAfter - parser->date : 0;
+            parser->state |= HTTP_PARSER_STATE_HAS_RETRY_AFTER;
+          }
+        }
+
+        /* https://www.rfc-editor.org/rfc/rfc9110#section-15.3.7 "206 Partial Content"
+         *   A server that generates a 206 response MUST generate a Content-Range
+         *   header field, describing what range of the selected representation is
+         *   enclosed.
+         * Multiple ranges are sent as multipart/byteranges without Content-Range
+         * field, they are left to Content-Length or chunked encoding.
+         */
+        if (parser->statusCode == 206 && (parser->state & HTTP_PARSER_STATE_HAS_CONTENT_RANGE) &&
+            (parser->state & HTTP_PARSER_STATE_HAS_CHUNKED_ENCODED_BODY) == 0) {
+          struct http_content_range *range = &parser->contentRange;
+          if (range->start == HTTP_CONTENT_RANGE_UNKNOWN) {
+            parser->error = HTTP_PARSER_ERROR_CONTENT_RANGE_INVALID;
+            goto end;
+          }
+
+          u64 rangeLength = range->end - range->start + 1;
+          if ((parser->state & HTTP_PARSER_STATE_HAS_CONTENT_LENGTH_BODY) == 0) {
+            parser->state |= HTTP_PARSER_STATE_HAS_CONTENT_LENGTH_BODY;
+            parser->contentLength = rangeLength;
+          } else if (parser->contentLength != rangeLength) {
+            parser->error = HTTP_PARSER_ERROR_CONTENT_RANGE_LENGTH_MISMATCH;
+            goto end;
+          }
+        }
         break;
       }
 
+      // Header line must be complete, wait for rest of it
+      struct string line = StringCursorExtractUntil(&cursor, CRLF);
+      if (IsStringNull(&line)) {
+        parser->error = HTTP_PARSER_ERROR_PARTIAL;
+        goto end;
+      }
+      struct string_cursor lineCursor = StringCursorFromString(&line);
+
       /* https://www.rfc-editor.org/rfc/rfc2616#section-4.2 "Message Headers"
        *   message-header = field-name ":" [ field-value ]
        *   field-name     = token
@@ -297,7 +672,7 @@ HttpParse(struct http_parser *parser, struct string *httpResponse)
        *                    of token, separators, and quoted-string>
        */
       struct string *colon = &StringFromLiteral(":");
-      struct string fieldName = StringCursorExtractUntil(&cursor, colon);
+      struct string fieldName = StringCursorExtractUntil(&lineCursor, colon);
       if (fieldName.length == 0) {
         parser->error = HTTP_PARSER_ERROR_HEADER_FIELD_NAME_REQUIRED;
         goto end;
@@ -332,6 +707,8 @@ HttpParse(struct http_parser *parser, struct string *httpResponse)
         tokenType = HTTP_TOKEN_HEADER_LOCATION;
       else if (IsStringEqualIgnoreCase(&fieldName, &StringFromLiteral("proxy-authenticate")))
         tokenType = HTTP_TOKEN_HEADER_PROXY_AUTHENTICATE;
+      else if (IsStringEqualIgnoreCase(&fieldName, &StringFromLiteral("retry-after")))
+        tokenType = HTTP_TOKEN_HEADER_RETRY_AFTER;
       else if (IsStringEqualIgnoreCase(&fieldName, &StringFromLiteral("allow")))
         tokenType = HTTP_TOKEN_HEADER_ALLOW;
       else if (IsStringEqualIgnoreCase(&fieldName, &StringFromLiteral("content-encoding")))
@@ -357,14 +734,15 @@ HttpParse(struct http_parser *parser, struct string *httpResponse)
 
       if (tokenType == HTTP_TOKEN_NONE) {
         // Pass unrecognized http header fields
-        StringCursorAdvanceAfter(&cursor, CRLF);
+        cursor.position += line.length + CRLF->length;
         continue;
       }
 
       // Advance after colon (":")
       cursor.position += fieldName.length + colon->length;
+      lineCursor.position += fieldName.length + colon->length;
 
-      struct string fieldValue = StringCursorExtractUntil(&cursor, CRLF);
+      struct string fieldValue = StringCursorExtractRemaining(&lineCursor);
       struct string trimmedFieldValue = StringStripWhitespace(&fieldValue);
       if (trimmedFieldValue.length == 0) {
         parser->error = HTTP_PARSER_ERROR_HEADER_FIELD_VALUE_REQUIRED;
@@ -392,6 +770,35 @@ HttpParse(struct http_parser *parser, struct string *httpResponse)
         parser->contentLength = contentLength;
       }
 
+      if (tokenType == HTTP_TOKEN_HEADER_CONTENT_RANGE) {
+        if (!HttpParseContentRange(&trimmedFieldValue, &parser->contentRange)) {
+          parser->error = HTTP_PARSER_ERROR_CONTENT_RANGE_INVALID;
+          goto end;
+        }
+        parser->state |= HTTP_PARSER_STATE_HAS_CONTENT_RANGE;
+      }
+
+      if (tokenType == HTTP_TOKEN_HEADER_CONNECTION &&
+          IsStringEqualIgnoreCase(&trimmedFieldValue, &StringFromLiteral("close"))) {
+        parser->state |= HTTP_PARSER_STATE_CONNECTION_CLOSE;
+      }
+
+      if (tokenType == HTTP_TOKEN_HEADER_ACCEPT_RANGES &&
+          IsStringEqualIgnoreCase(&trimmedFieldValue, &StringFromLiteral("bytes"))) {
+        parser->state |= HTTP_PARSER_STATE_ACCEPTS_RANGES;
+      }
+
+      // value that cannot be understood is only a hint lost, response is fine
+      if (tokenType == HTTP_TOKEN_HEADER_DATE)
+        HttpParseDate(&trimmedFieldValue, &parser->date);
+
+      if (tokenType == HTTP_TOKEN_HEADER_RETRY_AFTER) {
+        if (trimmedFieldValue.length <= 10 && ParseU64(&trimmedFieldValue, &parser->retryAfter))
+          parser->state |= HTTP_PARSER_STATE_HAS_RETRY_AFTER;
+        else if (HttpParseDate(&trimmedFieldValue, &parser->retryAfter))
+          parser->state |= HTTP_PARSER_STATE_RETRY_AFTER_IS_DATE;
+      }
+
       u32 tokenIndex = parser->tokenCount + writtenTokenCount;
       if (tokenIndex == parser->tokenMax) {
         parser->error = HTTP_PARSER_ERROR_OUT_OF_MEMORY;
@@ -411,11 +818,6 @@ HttpParse(struct http_parser *parser, struct string *httpResponse)
     }
   }
 
-  if (IsStringCursorAtEnd(&cursor)) {
-    parser->error = HTTP_PARSER_ERROR_PARTIAL;
-    goto end;
-  }
-
   /*****************************************************************
    * Parsing Message-Body
    *****************************************************************/
@@ -429,10 +831,19 @@ HttpParse(struct http_parser *parser, struct string *httpResponse)
    * responses MUST NOT include a message-body. All other responses do include
    * a message-body, although it MAY be of zero length.
    */
-  if ((parser->statusCode >= 100 && parser->statusCode <= 199) && parser->statusCode == 204 &&
-      parser->statusCode == 304 &&
-      (parser->state & (HTTP_PARSER_STATE_HAS_CHUNKED_ENCODED_BODY | HTTP_PARSER_STATE_HAS_CONTENT_LENGTH_BODY)) == 0)
+  if (parser->state & HTTP_PARSER_STATE_HEADERS_PARSED) {
+    b8 isBodyForbidden = (parser->statusCode >= 100 && parser->statusCode <= 199) || parser->statusCode == 204 ||
+                         parser->statusCode == 304;
+    b8 isBodyEmpty = (parser->state & HTTP_PARSER_STATE_HAS_CHUNKED_ENCODED_BODY) == 0 &&
+                     (parser->state & HTTP_PARSER_STATE_HAS_CONTENT_LENGTH_BODY) && parser->contentLength == 0;
+    if (isBodyForbidden || isBodyEmpty)
+      goto end;
+  }
+
+  if (IsStringCursorAtEnd(&cursor)) {
+    parser->error = HTTP_PARSER_ERROR_PARTIAL;
     goto end;
+  }
 
   /* https://www.rfc-editor.org/rfc/rfc2616#section-4.4 "Message Length"
    * ...
@@ -445,7 +856,7 @@ HttpParse(struct http_parser *parser, struct string *httpResponse)
   if (parser->state & HTTP_PARSER_STATE_HAS_CHUNKED_ENCODED_BODY) {
     struct http_token *partialToken = 0;
     {
-      struct http_token *lastToken = parser->tokens + parser->tokenCount - 1;
+      struct http_token *lastToken = parser->tokens + parser->tokenCount + writtenTokenCount - 1;
       if (lastToken->type == HTTP_TOKEN_CHUNK_DATA && lastToken->end == 0)
         partialToken = lastToken;
     }
@@ -470,71 +881,98 @@ HttpParse(struct http_parser *parser, struct string *httpResponse)
        */
 
       if (!partialToken) {
-        // Extract chunk size
-        struct string chunkSizeText = StringCursorExtractUntil(&cursor, CRLF);
-        struct string *lastChunkSizeText = &StringFromLiteral("0");
-        if (IsStringEqual(&chunkSizeText, lastChunkSizeText) &&
-            // and CRLF must be found
-            chunkSizeText.length != StringCursorRemainingLength(&cursor)) {
-          // finished
+        // Chunk size line must be complete, wait for rest of it
+        struct string chunkSizeLine = StringCursorExtractUntil(&cursor, CRLF);
+        if (IsStringNull(&chunkSizeLine)) {
+          parser->error = HTTP_PARSER_ERROR_PARTIAL;
           goto end;
         }
 
+        // Ignore chunk-extension
+        struct string_cursor chunkSizeCursor = StringCursorFromString(&chunkSizeLine);
+        struct string chunkSizeText = StringCursorExtractUntilOrRest(&chunkSizeCursor, &StringFromLiteral(";"));
+
         u64 chunkSize;
         if (!ParseHex(&chunkSizeText, &chunkSize)) {
           parser->error = HTTP_PARSER_ERROR_CHUNK_SIZE_IS_INVALID;
           goto end;
-        } else {
-          u32 tokenIndex = parser->tokenCount + writtenTokenCount;
-          if (tokenIndex == parser->tokenMax) {
-            parser->error = HTTP_PARSER_ERROR_OUT_OF_MEMORY;
-            goto end;
-          }
-          struct http_token *token = parser->tokens + tokenIndex;
-
-          token->type = HTTP_TOKEN_CHUNK_SIZE;
-          token->start = cursor.position;
-          token->end = token->start + chunkSizeText.length;
-          token->start += parser->position;
-          token->end += parser->position;
-          writtenTokenCount++;
         }
 
-        // Advance after chunk size
-        cursor.position += chunkSizeText.length + CRLF->length;
-      }
+        if (chunkSize == 0) {
+          // last-chunk, trailer and CRLF must be complete. Trailer fields are skipped.
+          struct string_cursor trailerCursor = cursor;
+          trailerCursor.position += chunkSizeLine.length + CRLF->length;
+          if (StringCursorPeekStartsWith(&trailerCursor, CRLF)) {
+            trailerCursor.position += CRLF->length;
+          } else {
+            struct string *CRLFCRLF = &StringFromLiteral("\r\n\r\n");
+            struct string trailer = StringCursorExtractUntil(&trailerCursor, CRLFCRLF);
+            if (IsStringNull(&trailer)) {
+              parser->error = HTTP_PARSER_ERROR_PARTIAL;
+              goto end;
+            }
+            trailerCursor.position += trailer.length + CRLFCRLF->length;
+          }
 
-      // Extract chunk data
-      struct string chunkData = StringCursorExtractUntilOrRest(&cursor, CRLF);
-      struct http_token *token = partialToken;
-      if (!token) {
-        // If it is not partial chunk data, create new
+          // finished
+          cursor.position = trailerCursor.position;
+          goto end;
+        }
+
+        // chunk size and chunk data tokens are written together
         u32 tokenIndex = parser->tokenCount + writtenTokenCount;
-        if (tokenIndex == parser->tokenMax) {
-          parser->error = HTTP_PARSER_ERROR_OUT_OF_MEMORY;
+        if (tokenIndex + 2 > parser->tokenMax) {
+          b8 isRetirable = (parser->state & HTTP_PARSER_STATE_STREAMING) && tokenIndex > parser->headerTokenCount;
+          parser->error = isRetirable ? HTTP_PARSER_ERROR_PAUSED : HTTP_PARSER_ERROR_OUT_OF_MEMORY;
           goto end;
         }
-        token = parser->tokens + tokenIndex;
 
-        token->type = HTTP_TOKEN_CHUNK_DATA;
+        struct http_token *token = parser->tokens + tokenIndex;
+        token->type = HTTP_TOKEN_CHUNK_SIZE;
         token->start = cursor.position;
+        token->end = token->start + chunkSizeText.length;
         token->start += parser->position;
+        token->end += parser->position;
+        writtenTokenCount++;
+
+        // Advance after chunk size
+        cursor.position += chunkSizeLine.length + CRLF->length;
 
+        token = parser->tokens + tokenIndex + 1;
+        token->type = HTTP_TOKEN_CHUNK_DATA;
+        token->start = cursor.position;
+        token->start += parser->position;
+        token->end = 0;
         writtenTokenCount++;
+
+        parser->chunkSize = chunkSize;
+        partialToken = token;
       }
-      if (chunkData.length == StringCursorRemainingLength(&cursor)) {
-        token->end = 0;
+
+      // Extract chunk data
+      struct http_token *token = partialToken;
+      u64 chunkEnd = token->start + parser->chunkSize;
+      u64 position = parser->position + cursor.position;
+      debug_assert(chunkEnd >= position);
+      struct string chunkData = StringCursorExtractSubstring(&cursor, chunkEnd - position);
+      cursor.position += chunkData.length;
+
+      // Chunk data and following CRLF must be complete
+      if (position + chunkData.length != chunkEnd || StringCursorRemainingLength(&cursor) < CRLF->length) {
         parser->error = HTTP_PARSER_ERROR_PARTIAL;
-        cursor.position += chunkData.length;
         goto end;
       }
-      partialToken = 0;
 
-      token->end = cursor.position + chunkData.length;
-      token->end += parser->position;
+      if (!StringCursorPeekStartsWith(&cursor, CRLF)) {
+        parser->error = HTTP_PARSER_ERROR_CHUNK_DATA_MALFORMED;
+        goto end;
+      }
+
+      token->end = chunkEnd;
+      partialToken = 0;
 
       // Advance after chunk data
-      cursor.position += chunkData.length + CRLF->length;
+      cursor.position += CRLF->length;
     }
   }
   // Parse content-length limited body
@@ -543,51 +981,56 @@ HttpParse(struct http_parser *parser, struct string *httpResponse)
 
     struct http_token *partialToken = 0;
     {
-      struct http_token *lastToken = parser->tokens + parser->tokenCount - 1;
+      struct http_token *lastToken = parser->tokens + parser->tokenCount + writtenTokenCount - 1;
       if (lastToken->type == HTTP_TOKEN_CONTENT && lastToken->end == 0)
         partialToken = lastToken;
     }
 
-    while (!IsStringCursorAtEnd(&cursor)) {
-      // Extract content
-      struct string content = StringCursorExtractRemaining(&cursor);
-
-      struct http_token *token = partialToken;
-      if (!token) {
-        // If it is not partial chunk data, create new
-        u32 tokenIndex = parser->tokenCount + writtenTokenCount;
-        if (tokenIndex == parser->tokenMax) {
-          parser->error = HTTP_PARSER_ERROR_OUT_OF_MEMORY;
-          goto end;
-        }
-        token = parser->tokens + tokenIndex;
-
-        token->type = HTTP_TOKEN_CONTENT;
-        token->start = cursor.position;
-        token->start += parser->position;
+    if (contentLength == 0)
+      goto end;
 
-        writtenTokenCount++;
-      }
-      u64 end = cursor.position + content.length;
-      end += parser->position;
-      if (end - token->start != contentLength) {
-        token->end = 0;
-        parser->error = HTTP_PARSER_ERROR_PARTIAL;
-        cursor.position += content.length;
+    struct http_token *token = partialToken;
+    if (!token) {
+      // If it is not partial content, create new
+      u32 tokenIndex = parser->tokenCount + writtenTokenCount;
+      if (tokenIndex == parser->tokenMax) {
+        parser->error = HTTP_PARSER_ERROR_OUT_OF_MEMORY;
         goto end;
       }
+      token = parser->tokens + tokenIndex;
 
-      partialToken = 0;
+      token->type = HTTP_TOKEN_CONTENT;
+      token->start = cursor.position;
+      token->start += parser->position;
+      token->end = 0;
+
+      writtenTokenCount++;
+    }
 
-      token->end = end;
+    // Extract content, bytes after content length belong to next response
+    u64 contentEnd = token->start + contentLength;
+    u64 position = parser->position + cursor.position;
+    debug_assert(contentEnd >= position);
+    struct string content = StringCursorExtractSubstring(&cursor, contentEnd - position);
+    cursor.position += content.length;
 
-      // Advance after content
-      cursor.position += content.length;
+    if (position + content.length != contentEnd) {
+      parser->error = HTTP_PARSER_ERROR_PARTIAL;
       goto end;
     }
+
+    token->end = contentEnd;
+    goto end;
   }
 
   parser->error = HTTP_PARSER_ERROR_PARTIAL;
+  goto end;
+
+statusLinePartial:
+  // drop tokens of incomplete status line
+  writtenTokenCount = 0;
+  cursor.position = 0;
+  parser->error = HTTP_PARSER_ERROR_PARTIAL;
 
 end:
   parser->tokenCount += writtenTokenCount;
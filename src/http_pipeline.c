@@ -0,0 +1,175 @@
+#pragma once
+
+/*
+ * HTTP/1.1 Pipelining
+ *
+ * Requests are sent back to back on one connection without waiting for
+ * responses, server answers them in same order. A batch of requests is
+ * rendered into one buffer and written at once, so it leaves in as few TLS
+ * records as possible and many requests cost one round trip.
+ *
+ * Servers answer limited number of requests on a connection, then close it.
+ * Requests that were in flight when connection closed are sent again on next
+ * connection, and pipeline depth is lowered to number of responses server gave
+ * on closed connection. When connection stays open after whole batch is
+ * answered, depth is raised by one for next batch, up to depthMax.
+ *
+ * Caller may lower limit below depth, e.g. when server is slowing down under
+ * load, limit does not change what depth learned about server.
+ *
+ * @code
+ *   HttpPipelineInit(&pipeline, videoIdCount, 16);
+ *   while (!HttpPipelineIsDone(&pipeline)) {
+ *     connect()
+ *     while (!HttpPipelineIsDone(&pipeline)) {
+ *       if (HttpPipelineInFlightCount(&pipeline) == 0)
+ *         write(HttpPipelineBatch(&pipeline, template, videoIds, buffer))
+ *       read()
+ *       while (HttpParse(parser, packet)) {
+ *         requestIndex = HttpPipelineComplete(&pipeline)
+ *         HttpParserNext(parser)
+ *       }
+ *       if (closed)
+ *         break
+ *     }
+ *     if (!HttpPipelineClose(&pipeline))
+ *       error("server closed connection without answering")
+ *   }
+ * @endcode
+ */
+
+#include "http_request.c"
+
+struct http_pipeline {
+  u32 requestCount;
+  // requests before completedCount are answered, requests between
+  // completedCount and sentCount are in flight
+  u32 completedCount;
+  u32 sentCount;
+
+  // maximum number of requests in flight
+  u32 depth;
+  u32 depthMax;
+  // maximum number of requests in flight caller allows, starts at depthMax
+  u32 limit;
+
+  // responses received on current connection
+  u32 connectionCompletedCount;
+};
+
+internalfn void
+HttpPipelineInit(struct http_pipeline *pipeline, u32 requestCount, u32 depthMax)
+{
+  debug_assert(depthMax != 0);
+  pipeline->requestCount = requestCount;
+  pipeline->completedCount = 0;
+  pipeline->sentCount = 0;
+  pipeline->depth = depthMax;
+  pipeline->depthMax = depthMax;
+  pipeline->limit = depthMax;
+  pipeline->connectionCompletedCount = 0;
+}
+
+/*
+ * Adds requests after ones pipeline has, e.g. when they come while others are
+ * in flight. Pipeline that is done has them to send.
+ */
+internalfn void
+HttpPipelineAdd(struct http_pipeline *pipeline, u32 requestCount)
+{
+  pipeline->requestCount += requestCount;
+}
+
+internalfn b8
+HttpPipelineIsDone(struct http_pipeline *pipeline)
+{
+  return pipeline->completedCount == pipeline->requestCount;
+}
+
+internalfn u32
+HttpPipelineInFlightCount(struct http_pipeline *pipeline)
+{
+  return pipeline->sentCount - pipeline->completedCount;
+}
+
+/*
+ * Renders next requests into buffer as many as pipeline depth and limit allow.
+ * values has slotCount strings for every request, request at index i uses
+ * values[i * slotCount ...].
+ * @return requests to write in one go
+ *         empty if pipeline is full or every request is sent
+ */
+internalfn struct string
+HttpPipelineBatch(struct http_pipeline *pipeline, struct http_request_template *template, struct string *values,
+                  struct string *buffer)
+{
+  // server kept connection open after answering whole batch, try deeper
+  b8 isBatchAnswered = pipeline->connectionCompletedCount != 0 && HttpPipelineInFlightCount(pipeline) == 0;
+  if (isBatchAnswered && pipeline->depth < pipeline->depthMax)
+    pipeline->depth++;
+
+  u32 inFlightMax = pipeline->depth < pipeline->limit ? pipeline->depth : pipeline->limit;
+  u32 sendMax = pipeline->completedCount + inFlightMax;
+  if (sendMax > pipeline->requestCount)
+    sendMax = pipeline->requestCount;
+
+  u64 length = 0;
+  while (pipeline->sentCount < sendMax) {
+    struct string *requestValues = values + pipeline->sentCount * template->slotCount;
+    struct string remaining = StringFromBuffer(buffer->value + length, buffer->length - length);
+    struct string request = HttpRequestTemplateRender(template, requestValues, &remaining);
+    if (IsStringNull(&request))
+      break; // buffer is full, rest goes in next batch
+
+    length += request.length;
+    pipeline->sentCount++;
+  }
+
+  return StringFromBuffer(buffer->value, length);
+}
+
+/*
+ * Call when response is parsed completely.
+ * @return index of request that response answers
+ */
+internalfn u32
+HttpPipelineComplete(struct http_pipeline *pipeline)
+{
+  debug_assert(pipeline->completedCount < pipeline->sentCount);
+  u32 requestIndex = pipeline->completedCount;
+  pipeline->completedCount++;
+  pipeline->connectionCompletedCount++;
+  return requestIndex;
+}
+
+/*
+ * Call when connection is closed, by server or after a response with
+ * "Connection: close". Requests in flight are sent again on next connection.
+ * @return false if server closed connection without answering any request
+ */
+internalfn b8
+HttpPipelineClose(struct http_pipeline *pipeline)
+{
+  u32 answeredCount = pipeline->connectionCompletedCount;
+  b8 isClosedEarly = HttpPipelineInFlightCount(pipeline) != 0;
+  if (isClosedEarly) {
+    // server limit is learned
+    pipeline->depth = answeredCount != 0 ? answeredCount : 1;
+    pipeline->sentCount = pipeline->completedCount;
+  }
+
+  pipeline->connectionCompletedCount = 0;
+  return !isClosedEarly || answeredCount != 0;
+}
+
+/*
+ * Call when connection is closed by client, e.g. after server refused a
+ * request. Requests in flight are sent again on next connection, depth is
+ * kept as server did not close it.
+ */
+internalfn void
+HttpPipelineResend(struct http_pipeline *pipeline)
+{
+  pipeline->sentCount = pipeline->completedCount;
+  pipeline->connectionCompletedCount = 0;
+}
@@ -50,11 +50,26 @@ struct http_header {
   struct string value;
 };
 
+/*
+ * Byte range of a resource, both ends are inclusive.
+ *   {.start = 0, .end = 499}               first 500 bytes
+ *   {.start = 500, .end = HTTP_RANGE_END}  from byte 500 to end
+ * https://www.rfc-editor.org/rfc/rfc9110#section-14.2 "Range"
+ */
+struct http_range {
+  u64 start;
+  u64 end;
+};
+
+comptime u64 HTTP_RANGE_END = (u64)-1;
+
 struct http_request_info {
   enum http_method method;
   enum http_version version;
   struct string host;
   struct string path;
+  // appended to path as ?name=value&..., percent-encoded
+  struct http_form_urlencoded_list *query;
   struct string url;
   struct string userAgent;
   u32 headerCount;
@@ -63,6 +78,8 @@ struct http_request_info {
   enum http_encoding acceptEncoding;
   enum http_content_type contentType;
   enum http_encoding contentEncoding;
+  // null if whole resource is requested
+  struct http_range *range;
 
   /* if contentType is:
    *   - `HTTP_CONTENT_TYPE_JSON` type must be `struct string *`
@@ -71,63 +88,267 @@ struct http_request_info {
   void *content;
 };
 
+#include "deflate.c"
+#include "percent_encoding.h"
 #include "string_builder.h"
 
+internalfn struct string
+HttpMethodString(enum http_method method)
+{
+  switch (method) {
+  case HTTP_METHOD_GET:
+    return StringFromLiteral("GET");
+  case HTTP_METHOD_HEAD:
+    return StringFromLiteral("HEAD");
+  case HTTP_METHOD_POST:
+    return StringFromLiteral("POST");
+  case HTTP_METHOD_PUT:
+    return StringFromLiteral("PUT");
+  case HTTP_METHOD_DELETE:
+    return StringFromLiteral("DELETE");
+  }
+  return StringNull();
+}
+
+internalfn struct string
+HttpContentTypeString(enum http_content_type contentType)
+{
+  switch (contentType) {
+  case HTTP_CONTENT_TYPE_JSON:
+    return StringFromLiteral("application/json");
+  case HTTP_CONTENT_TYPE_FORM_URLENCODED:
+    return StringFromLiteral("application/x-www-form-urlencoded");
+  default:
+    return StringFromLiteral("");
+  }
+}
+
+internalfn struct string
+HttpEncodingString(enum http_encoding encoding)
+{
+  switch (encoding) {
+  case HTTP_ENCODING_GZIP:
+    return StringFromLiteral("gzip");
+  case HTTP_ENCODING_BROTLI:
+    return StringFromLiteral("br");
+  case HTTP_ENCODING_ZSTD:
+    return StringFromLiteral("zstd");
+  default:
+    return StringFromLiteral("");
+  }
+}
+
 /*
- * Builds http request to a buffer
- * @return http request
- *         null if any error happened
+ * @return length of list as name=value pairs separated by &
  */
-struct string
-HttpRequestBuild(struct http_request_info *info, struct memory_arena *memory)
+internalfn u64
+HttpFormUrlencodedLength(struct http_form_urlencoded_list *list)
 {
-  struct string result = StringNull();
+  u64 length = 0;
+  for (u32 itemIndex = 0; itemIndex < list->itemCount; itemIndex++) {
+    struct http_form_urlencoded_item *item = list->items + itemIndex;
+    length += PercentEncodedLength(&item->name, PERCENT_ENCODING_FORM) + 1 /* = */ +
+              PercentEncodedLength(&item->value, PERCENT_ENCODING_FORM);
+    if (itemIndex + 1 != list->itemCount)
+      length += 1; /* & */
+  }
+  return length;
+}
 
-  if (IsStringNullOrEmpty(&info->url) && IsStringNullOrEmpty(&info->host))
-    return result;
+/*
+ * Appends list as name=value pairs separated by &. Names and values are
+ * percent-encoded, so they can have any character.
+ * @return false if list does not fit, see HttpFormUrlencodedLength()
+ */
+internalfn b8
+StringBuilderAppendHttpFormUrlencoded(struct string_builder *sb, struct http_form_urlencoded_list *list)
+{
+  if (HttpFormUrlencodedLength(list) > sb->outBuffer->length - sb->length)
+    return 0;
+
+  struct string pairSeparator = StringFromLiteral("=");
+  struct string separator = StringFromLiteral("&");
+  for (u32 itemIndex = 0; itemIndex < list->itemCount; itemIndex++) {
+    struct http_form_urlencoded_item *item = list->items + itemIndex;
+
+    if (!StringBuilderAppendPercentEncoded(sb, &item->name, PERCENT_ENCODING_FORM))
+      return 0;
+    StringBuilderAppendString(sb, &pairSeparator);
+    if (!StringBuilderAppendPercentEncoded(sb, &item->value, PERCENT_ENCODING_FORM))
+      return 0;
+    if (itemIndex + 1 != list->itemCount) {
+      StringBuilderAppendString(sb, &separator);
+    }
+  }
+  return 1;
+}
 
-  struct string SPACE = StringFromLiteral(" ");
-  struct string CRLF = StringFromLiteral("\r\n");
+/*
+ * Builds content of request from info->content into memory.
+ * @return content
+ *         null if request has no content or form could not be built
+ */
+internalfn struct string
+HttpRequestContent(struct http_request_info *info, struct memory_arena *memory)
+{
+  struct string content = StringNull();
+  if (info->contentType == HTTP_CONTENT_TYPE_FORM_URLENCODED) {
+    /*
+     * Content body contains the form data in key=value pairs, with each pair
+     * separated by an & symbol.
+     * Ref: https://developer.mozilla.org/en-US/docs/Web/HTTP/Reference/Methods/POST#url-encoded_form_submission
+     */
+
+    struct http_form_urlencoded_list *list = info->content;
+    u64 contentLength = HttpFormUrlencodedLength(list);
+    if (contentLength == 0)
+      return StringFromLiteral("");
+
+    struct string_builder *contentBuilder = MakeStringBuilder(memory, contentLength, 0);
+    if (!StringBuilderAppendHttpFormUrlencoded(contentBuilder, list))
+      return StringNull();
+    content = StringBuilderFlush(contentBuilder);
+  } else if (info->contentType == HTTP_CONTENT_TYPE_JSON) {
+    content = *(struct string *)info->content;
+  }
+
+  return content;
+}
 
-  struct string host = info->host;
-  struct string path = info->path;
-  if (IsStringNullOrEmpty(&host)) {
+/*
+ * @return length of content HttpRequestContent() builds
+ */
+internalfn u64
+HttpRequestContentLength(struct http_request_info *info)
+{
+  if (!info->content)
+    return 0;
+  if (info->contentType == HTTP_CONTENT_TYPE_FORM_URLENCODED)
+    return HttpFormUrlencodedLength(info->content);
+  if (info->contentType == HTTP_CONTENT_TYPE_JSON)
+    return ((struct string *)info->content)->length;
+  return 0;
+}
+
+/*
+ * @return maximum length of content after HttpRequestContentEncode()
+ */
+internalfn u64
+HttpRequestContentEncodedBound(struct http_request_info *info, u64 contentLength)
+{
+  if (info->contentEncoding == HTTP_ENCODING_GZIP)
+    return GzipBound(contentLength);
+  return contentLength;
+}
+
+/*
+ * Compresses content with info->contentEncoding into buffer. Encoder state is
+ * allocated from memory.
+ * @return encoded content
+ *         null if encoding is not supported or buffer is smaller than
+ *         HttpRequestContentEncodedBound()
+ */
+internalfn struct string
+HttpRequestContentEncode(struct http_request_info *info, struct string *content, struct string *buffer,
+                         struct memory_arena *memory)
+{
+  switch (info->contentEncoding) {
+  case HTTP_ENCODING_NONE: {
+    if (buffer->length < content->length)
+      return StringNull();
+    MemoryMove(buffer->value, content->value, content->length);
+    return StringFromBuffer(buffer->value, content->length);
+  } break;
+  case HTTP_ENCODING_GZIP: {
+    struct deflate_encoder *encoder = MakeDeflateEncoder(memory);
+    return GzipCompress(encoder, content, buffer);
+  } break;
+  default:
+    return StringNull();
+  }
+}
+
+/*
+ * Finds host and path of request from info->host and info->path, or from
+ * info->url when host is not given. When info->query is given, path with
+ * query is built into memory.
+ * @return false if neither is given, url is invalid or query does not fit
+ */
+internalfn b8
+HttpRequestHostAndPath(struct http_request_info *info, struct memory_arena *memory, struct string *host,
+                       struct string *path)
+{
+  if (IsStringNullOrEmpty(&info->url) && IsStringNullOrEmpty(&info->host))
+    return 0;
+
+  *host = info->host;
+  *path = info->path;
+  if (IsStringNullOrEmpty(host)) {
     struct string_cursor cursor = StringCursorFromString(&info->url);
     struct string schemeSeparator = StringFromLiteral("://");
     struct string scheme = StringCursorConsumeThrough(&cursor, &schemeSeparator);
     if (IsStringNull(&scheme))
-      return result;
+      return 0;
 
     struct string pathSeparator = StringFromLiteral("/");
-    host = StringCursorConsumeUntilOrRest(&cursor, &pathSeparator);
+    *host = StringCursorConsumeUntilOrRest(&cursor, &pathSeparator);
+
+    *path = StringCursorExtractRemaining(&cursor);
+  }
+  if (IsStringNull(path))
+    *path = StringFromLiteral("/");
+
+  if (info->query && info->query->itemCount > 0) {
+    // path from url may already have a query
+    b8 hasQuery = 0;
+    for (u64 index = 0; index < path->length; index++) {
+      if (path->value[index] == '?') {
+        hasQuery = 1;
+        break;
+      }
+    }
 
-    path = StringCursorExtractRemaining(&cursor);
+    struct string_builder *sb = MakeStringBuilder(memory, path->length + 1 + HttpFormUrlencodedLength(info->query), 0);
+    StringBuilderAppendString(sb, path);
+    if (hasQuery)
+      StringBuilderAppendStringLiteral(sb, "&");
+    else
+      StringBuilderAppendStringLiteral(sb, "?");
+    if (!StringBuilderAppendHttpFormUrlencoded(sb, info->query))
+      return 0;
+    *path = StringBuilderFlush(sb);
   }
-  if (IsStringNull(&path))
-    path = StringFromLiteral("/");
 
-  struct string_builder *sb = MakeStringBuilder(memory, 1024, 0);
+  return 1;
+}
+
+/*
+ * Builds http request to a buffer
+ * @return http request
+ *         null if any error happened
+ */
+struct string
+HttpRequestBuild(struct http_request_info *info, struct memory_arena *memory)
+{
+  struct string result = StringNull();
+
+  struct string SPACE = StringFromLiteral(" ");
+  struct string CRLF = StringFromLiteral("\r\n");
+
+  struct string host;
+  struct string path;
+  if (!HttpRequestHostAndPath(info, memory, &host, &path))
+    return result;
+
+  // request line and headers are small, path and content may not be
+  u64 contentBound = HttpRequestContentEncodedBound(info, HttpRequestContentLength(info));
+  struct string_builder *sb = MakeStringBuilder(memory, 1024 + path.length + contentBound, 0);
 
   { // Request-Line
 
     // Method
-    switch (info->method) {
-    case HTTP_METHOD_GET: {
-      StringBuilderAppendStringLiteral(sb, "GET");
-    } break;
-    case HTTP_METHOD_HEAD: {
-      StringBuilderAppendStringLiteral(sb, "HEAD");
-    } break;
-    case HTTP_METHOD_POST: {
-      StringBuilderAppendStringLiteral(sb, "POST");
-    } break;
-    case HTTP_METHOD_PUT: {
-      StringBuilderAppendStringLiteral(sb, "PUT");
-    } break;
-    case HTTP_METHOD_DELETE: {
-      StringBuilderAppendStringLiteral(sb, "DELETE");
-    } break;
-    }
+    struct string method = HttpMethodString(info->method);
+    StringBuilderAppendString(sb, &method);
 
     // Request-URI
     StringBuilderAppendString(sb, &SPACE);
@@ -147,10 +368,8 @@ HttpRequestBuild(struct http_request_info *info, struct memory_arena *memory)
       StringBuilderAppendStringLiteral(sb, "HTTP/1.1");
     } break;
     case HTTP_VERSION_20: {
+      // HTTP/2 has no textual request, it is sent as frames. See Http2Request()
       return result;
-#if 0
-      StringBuilderAppendStringLiteral(sb, "HTTP/2.0");
-#endif
     } break;
     }
   }
@@ -173,67 +392,77 @@ HttpRequestBuild(struct http_request_info *info, struct memory_arena *memory)
     StringBuilderAppendString(sb, &CRLF);
   }
 
-  if (info->content) { // entity-header
+  if (info->range) { // range:
+    struct http_range *range = info->range;
+    if (range->start > range->end)
+      return result;
+
     struct memory_temp tempMemory = MemoryTempBegin(memory);
+    struct string *numberStringBuffer = MakeString(tempMemory.arena, 32);
+
+    StringBuilderAppendStringLiteral(sb, "range:bytes=");
+    struct string startString = FormatU64(numberStringBuffer, range->start);
+    StringBuilderAppendString(sb, &startString);
+    StringBuilderAppendStringLiteral(sb, "-");
+    if (range->end != HTTP_RANGE_END) {
+      struct string endString = FormatU64(numberStringBuffer, range->end);
+      StringBuilderAppendString(sb, &endString);
+    }
+    StringBuilderAppendString(sb, &CRLF);
 
-    struct string content = StringNull();
-    if (info->contentType == HTTP_CONTENT_TYPE_FORM_URLENCODED) {
-      /*
-       * Content body contains the form data in key=value pairs, with each pair
-       * separated by an & symbol.
-       * Ref: https://developer.mozilla.org/en-US/docs/Web/HTTP/Reference/Methods/POST#url-encoded_form_submission
-       */
-
-      struct string_builder *contentBuilder = MakeStringBuilder(tempMemory.arena, 2048, 0);
-      struct http_form_urlencoded_list *list = info->content;
-
-      struct string pairSeparator = StringFromLiteral("=");
-      struct string separator = StringFromLiteral("&");
-      for (u32 itemIndex = 0; itemIndex < list->itemCount; itemIndex++) {
-        struct http_form_urlencoded_item *item = list->items + itemIndex;
-
-        StringBuilderAppendString(contentBuilder, &item->name);
-        StringBuilderAppendString(contentBuilder, &pairSeparator);
-        StringBuilderAppendString(contentBuilder, &item->value);
-        if (itemIndex + 1 != list->itemCount) {
-          StringBuilderAppendString(contentBuilder, &separator);
-        }
-      }
+    MemoryTempEnd(&tempMemory);
+  }
 
-      content = StringBuilderFlush(contentBuilder);
-    } else if (info->contentType == HTTP_CONTENT_TYPE_JSON) {
-      content = *(struct string *)info->content;
+  if (info->content) { // entity-header
+    struct memory_temp tempMemory = MemoryTempBegin(memory);
+
+    struct string content = HttpRequestContent(info, tempMemory.arena);
+    if (IsStringNull(&content)) {
+      MemoryTempEnd(&tempMemory);
+      return result;
     }
 
     // content-type:
     StringBuilderAppendStringLiteral(sb, "content-type:");
-    switch (info->contentType) {
-    case HTTP_CONTENT_TYPE_JSON: {
-      StringBuilderAppendStringLiteral(sb, "application/json");
-    } break;
-    case HTTP_CONTENT_TYPE_FORM_URLENCODED: {
-      StringBuilderAppendStringLiteral(sb, "application/x-www-form-urlencoded");
-    } break;
-    default:
-      break;
-    }
+    struct string contentType = HttpContentTypeString(info->contentType);
+    StringBuilderAppendString(sb, &contentType);
     StringBuilderAppendString(sb, &CRLF);
 
-    // TODO: content-encoding: encode content in specified compression
-    if (info->contentEncoding == HTTP_ENCODING_GZIP) {
+    // content-encoding:
+    if (info->contentEncoding != HTTP_ENCODING_NONE) {
+      StringBuilderAppendStringLiteral(sb, "content-encoding:");
+      struct string contentEncoding = HttpEncodingString(info->contentEncoding);
+      StringBuilderAppendString(sb, &contentEncoding);
+      StringBuilderAppendString(sb, &CRLF);
     }
 
     // content-length:
     StringBuilderAppendStringLiteral(sb, "content-length:");
+
+    /*
+     * Length is known after encoding, so body is encoded straight into request
+     * buffer leaving room for length, then moved next to it.
+     */
+    comptime u64 contentLengthRoom = 20 /* digits of U64_MAX */ + 4 /* CRLF CRLF */;
+    struct string *outBuffer = sb->outBuffer;
+    struct string bodyBuffer = StringFromBuffer(outBuffer->value + sb->length + contentLengthRoom,
+                                                outBuffer->length - sb->length - contentLengthRoom);
+    struct string body = HttpRequestContentEncode(info, &content, &bodyBuffer, tempMemory.arena);
+    if (IsStringNull(&body)) {
+      MemoryTempEnd(&tempMemory);
+      return result;
+    }
+
     struct string *contentLengthStringBuffer = MakeString(tempMemory.arena, 32);
-    struct string contentLengthString = FormatU64(contentLengthStringBuffer, content.length);
+    struct string contentLengthString = FormatU64(contentLengthStringBuffer, body.length);
     StringBuilderAppendString(sb, &contentLengthString);
     StringBuilderAppendString(sb, &CRLF);
 
     StringBuilderAppendString(sb, &CRLF);
 
     // entity body
-    StringBuilderAppendString(sb, &content);
+    MemoryMove(outBuffer->value + sb->length, body.value, body.length);
+    sb->length += body.length;
 
     MemoryTempEnd(&tempMemory);
   } else {
@@ -243,3 +472,166 @@ HttpRequestBuild(struct http_request_info *info, struct memory_arena *memory)
   result = StringBuilderFlush(sb);
   return result;
 }
+
+/*
+ * Request templates
+ *
+ * When only a few parts of a request change between requests (e.g. video id in
+ * path), build the request once and patch the changing parts on every send.
+ * Mark each changing part with HTTP_REQUEST_TEMPLATE_SLOT in info. Slots are
+ * only allowed in request line and headers, content length is fixed when
+ * template is made.
+ *
+ * @code
+ *   info.path = StringFromLiteral("/api/v1/videos/" HTTP_REQUEST_TEMPLATE_SLOT);
+ *   template = MakeHttpRequestTemplate(arena, &info);
+ *   ...
+ *   struct string values[] = {videoId};
+ *   request = HttpRequestTemplateRender(template, values, buffer);
+ * @endcode
+ *
+ * Slot values are copied as is, they must not contain CR or LF.
+ */
+
+// Control characters are not allowed in request line or header fields.
+#define HTTP_REQUEST_TEMPLATE_SLOT "\x1a"
+
+struct http_request_template {
+  // request without slot markers
+  struct string request;
+  u32 slotCount;
+  // position in request where value of slot is inserted, in ascending order
+  u64 *slotOffsets;
+};
+
+/*
+ * Builds request from info once and records where slots are.
+ * @return template
+ *         null if request cannot be built or slot is in content
+ */
+internalfn struct http_request_template *
+MakeHttpRequestTemplate(memory_arena *arena, struct http_request_info *info)
+{
+  struct string built = HttpRequestBuild(info, arena);
+  if (IsStringNull(&built))
+    return 0;
+
+  struct string slot = StringFromLiteral(HTTP_REQUEST_TEMPLATE_SLOT);
+  struct string headEnd = StringFromLiteral("\r\n\r\n");
+
+  u64 headLength;
+  {
+    struct string_cursor cursor = StringCursorFromString(&built);
+    headLength = StringCursorExtractUntil(&cursor, &headEnd).length;
+  }
+
+  u32 slotCount = 0;
+  for (u64 index = 0; index < built.length; index++) {
+    if (built.value[index] != slot.value[0])
+      continue;
+    if (index > headLength)
+      return 0;
+    slotCount++;
+  }
+
+  struct http_request_template *template = MemoryArenaPush(arena, sizeof(*template));
+  template->slotCount = slotCount;
+  template->slotOffsets = MemoryArenaPush(arena, sizeof(*template->slotOffsets) * slotCount);
+
+  // remove slot markers in place
+  u64 length = 0;
+  u32 slotIndex = 0;
+  for (u64 index = 0; index < built.length; index++) {
+    u8 character = built.value[index];
+    if (character == slot.value[0]) {
+      template->slotOffsets[slotIndex] = length;
+      slotIndex++;
+      continue;
+    }
+    built.value[length] = character;
+    length++;
+  }
+  template->request = StringFromBuffer(built.value, length);
+
+  return template;
+}
+
+/*
+ * @return length of request rendered with values
+ */
+internalfn u64
+HttpRequestTemplateLength(struct http_request_template *template, struct string *values)
+{
+  u64 length = template->request.length;
+  for (u32 slotIndex = 0; slotIndex < template->slotCount; slotIndex++)
+    length += values[slotIndex].length;
+  return length;
+}
+
+/*
+ * Copies request to buffer with slots filled by values.
+ * values must have one string for every slot, in order.
+ * @return request
+ *         null if buffer is not big enough
+ */
+internalfn struct string
+HttpRequestTemplateRender(struct http_request_template *template, struct string *values, struct string *buffer)
+{
+  struct string result = StringNull();
+  if (HttpRequestTemplateLength(template, values) > buffer->length)
+    return result;
+
+  u8 *output = buffer->value;
+  u64 position = 0;
+  for (u32 slotIndex = 0; slotIndex < template->slotCount; slotIndex++) {
+    u64 slotOffset = template->slotOffsets[slotIndex];
+    struct string *value = values + slotIndex;
+
+    MemoryCopy(output, template->request.value + position, slotOffset - position);
+    output += slotOffset - position;
+    MemoryCopy(output, value->value, value->length);
+    output += value->length;
+    position = slotOffset;
+  }
+  MemoryCopy(output, template->request.value + position, template->request.length - position);
+  output += template->request.length - position;
+
+  result = StringFromBuffer(buffer->value, (u64)(output - buffer->value));
+  return result;
+}
+
+/*
+ * Maximum number of parts HttpRequestTemplateRenderParts() can output.
+ */
+internalfn u32
+HttpRequestTemplatePartMax(struct http_request_template *template)
+{
+  return template->slotCount * 2 + 1;
+}
+
+/*
+ * Renders request without copying. Parts point into template and values and
+ * must be sent in order, e.g. with writev(2). Empty parts are left out.
+ * parts must have space for HttpRequestTemplatePartMax() strings.
+ * @return number of parts
+ */
+internalfn u32
+HttpRequestTemplateRenderParts(struct http_request_template *template, struct string *values, struct string *parts)
+{
+  u32 partCount = 0;
+  u64 position = 0;
+  for (u32 slotIndex = 0; slotIndex < template->slotCount; slotIndex++) {
+    u64 slotOffset = template->slotOffsets[slotIndex];
+    struct string *value = values + slotIndex;
+
+    if (slotOffset != position)
+      parts[partCount++] = StringSlice(&template->request, position, slotOffset);
+    if (value->length != 0)
+      parts[partCount++] = *value;
+    position = slotOffset;
+  }
+  if (position != template->request.length)
+    parts[partCount++] = StringSlice(&template->request, position, template->request.length);
+
+  return partCount;
+}
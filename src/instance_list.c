@@ -0,0 +1,389 @@
+#pragma once
+
+/*
+ * Invidious instances and how well they answer
+ *
+ * Public instances differ a lot in latency and often go down. Every instance
+ * has exponentially weighted moving averages of its latency and of its
+ * failures, requests go to the one that is expected to answer soonest, see
+ * InstanceScore(). Instance that fails is down for a while, longer after
+ * every failure in a row, and request fails over to next best instance.
+ *
+ * Averages come from probes, a cheap request like /api/v1/stats sent to
+ * instances that were not heard from for INSTANCE_PROBE_INTERVAL, and from
+ * requests themselves. They move between runs through a file that caller
+ * locks, like src/tls_session_cache.c:
+ *
+ * @code
+ *   InstanceListInit(&list, arena)
+ *   InstanceListAdd(&list, &hostname, &port)  // for every instance
+ *   InstanceListParse(&list, &content)
+ *   for every instance where IsInstanceProbeDue(instance, PlatformUnixTime())
+ *     probe, InstanceListRecord(&list, instance, latency, isFailed, PlatformUnixTime())
+ *
+ *   tried = 0
+ *   while ((index = InstanceListPick(&list, tried, PlatformUnixTime())) != -1) {
+ *     tried |= 1 << index
+ *     request, InstanceListRecord(&list, list.instances + index, 0, isFailed, PlatformUnixTime())
+ *     if (!isFailed) break
+ *   }
+ *   content = InstanceListSerialize(&list, &buffer)
+ * @endcode
+ *
+ * File format, integers are little endian:
+ *
+ *   "IINS" u32 version, u32 entryCount
+ *   entryCount times:
+ *     u64 updatedAt      seconds since 1970-01-01 UTC
+ *     u64 downUntil      seconds since 1970-01-01 UTC
+ *     u64 latency        nanoseconds
+ *     u32 errorRate, u32 failureCount
+ *     u16 keyLength
+ *     key                "hostname:port"
+ */
+
+#include "memory.h"
+#include "text.h"
+#include "type.h"
+
+enum {
+  // fits in bit mask of InstanceListPick()
+  INSTANCE_MAX = 16,
+  // see RFC 1035 2.3.4. Size limits
+  INSTANCE_HOSTNAME_MAX = 255,
+  INSTANCE_PORT_MAX = 5,
+
+  // new sample weighs 1 / (1 << INSTANCE_AVERAGE_SHIFT)
+  INSTANCE_AVERAGE_SHIFT = 2,
+  // errorRate of instance whose every request failed
+  INSTANCE_ERROR_RATE_ONE = 1 << 16,
+
+  // seconds
+  INSTANCE_PROBE_INTERVAL = 10 * 60,
+  // seconds, doubles after every failure in a row
+  INSTANCE_DOWN_DURATION = 30,
+  INSTANCE_DOWN_DURATION_MAX = 60 * 60,
+
+  INSTANCE_LIST_VERSION = 1,
+  INSTANCE_LIST_HEADER_LENGTH = 4 + 4 + 4,
+  INSTANCE_LIST_ENTRY_HEADER_LENGTH = 8 + 8 + 8 + 4 + 4 + 2,
+  // hostname:port
+  INSTANCE_LIST_KEY_MAX = INSTANCE_HOSTNAME_MAX + 1 + INSTANCE_PORT_MAX,
+  INSTANCE_LIST_FILE_MAX =
+      INSTANCE_LIST_HEADER_LENGTH + INSTANCE_MAX * (INSTANCE_LIST_ENTRY_HEADER_LENGTH + INSTANCE_LIST_KEY_MAX),
+};
+
+// score of instance that has never answered, see InstanceScore()
+comptime u64 INSTANCE_SCORE_UNKNOWN = (u64)-1;
+
+struct instance {
+  // zero terminated
+  u8 hostnameBuffer[INSTANCE_HOSTNAME_MAX + 1];
+  struct string hostname;
+  u8 portBuffer[INSTANCE_PORT_MAX + 1];
+  struct string port;
+
+  // average time until answer in nanoseconds, 0 when instance never answered
+  u64 latency;
+  // average share of requests that failed, INSTANCE_ERROR_RATE_ONE is all
+  u32 errorRate;
+  // failures in a row
+  u32 failureCount;
+  // seconds since 1970-01-01 UTC, when instance was last heard from
+  u64 updatedAt;
+  // seconds since 1970-01-01 UTC, instance is only picked before this when
+  // every other one is down too
+  u64 downUntil;
+};
+
+struct instance_list {
+  // in order they are added, it breaks ties
+  struct instance *instances;
+  u32 instanceCount;
+  // something is recorded, list should be written back
+  b8 isChanged;
+};
+
+internalfn void
+InstanceListInit(struct instance_list *list, memory_arena *arena)
+{
+  list->instances = MemoryArenaPush(arena, sizeof(*list->instances) * INSTANCE_MAX);
+  list->instanceCount = 0;
+  list->isChanged = 0;
+}
+
+internalfn struct instance *
+InstanceListFind(struct instance_list *list, struct string *hostname, struct string *port)
+{
+  for (u32 instanceIndex = 0; instanceIndex < list->instanceCount; instanceIndex++) {
+    struct instance *instance = list->instances + instanceIndex;
+    if (IsStringEqualIgnoreCase(&instance->hostname, hostname) && IsStringEqual(&instance->port, port))
+      return instance;
+  }
+  return 0;
+}
+
+/*
+ * Adds instance that has not been heard from. Instance that is in list
+ * already is not added again.
+ * @return instance, 0 when list is full or hostname or port is too long
+ */
+internalfn struct instance *
+InstanceListAdd(struct instance_list *list, struct string *hostname, struct string *port)
+{
+  struct instance *instance = InstanceListFind(list, hostname, port);
+  if (instance)
+    return instance;
+
+  if (list->instanceCount == INSTANCE_MAX || hostname->length == 0 || hostname->length > INSTANCE_HOSTNAME_MAX ||
+      port->length == 0 || port->length > INSTANCE_PORT_MAX)
+    return 0;
+
+  instance = list->instances + list->instanceCount;
+  list->instanceCount++;
+  *instance = (struct instance){};
+  MemoryCopy(instance->hostnameBuffer, hostname->value, hostname->length);
+  instance->hostnameBuffer[hostname->length] = 0;
+  instance->hostname = StringFromBuffer(instance->hostnameBuffer, hostname->length);
+  MemoryCopy(instance->portBuffer, port->value, port->length);
+  instance->portBuffer[port->length] = 0;
+  instance->port = StringFromBuffer(instance->portBuffer, port->length);
+  return instance;
+}
+
+/*
+ * Expected time until instance answers. Request that fails is sent again to
+ * another instance, so latency is divided by share of requests that succeed.
+ * @return lower is better, INSTANCE_SCORE_UNKNOWN when instance never answered
+ */
+internalfn u64
+InstanceScore(struct instance *instance)
+{
+  if (instance->latency == 0)
+    return INSTANCE_SCORE_UNKNOWN;
+
+  u64 successRate = INSTANCE_ERROR_RATE_ONE - instance->errorRate;
+  if (successRate == 0)
+    successRate = 1;
+  return instance->latency * INSTANCE_ERROR_RATE_ONE / successRate;
+}
+
+/*
+ * Whether instance should be probed before it is picked. Instance that is
+ * down is probed once it can be picked again.
+ * @param now seconds since 1970-01-01 UTC, see PlatformUnixTime()
+ */
+internalfn b8
+IsInstanceProbeDue(struct instance *instance, u64 now)
+{
+  if (instance->downUntil > now)
+    return 0;
+  return instance->updatedAt == 0 || instance->failureCount != 0 || instance->updatedAt > now ||
+         now - instance->updatedAt >= INSTANCE_PROBE_INTERVAL;
+}
+
+/*
+ * Takes result of probe or request.
+ * @param latency nanoseconds until answer, 0 when it is not measured
+ * @param now seconds since 1970-01-01 UTC, see PlatformUnixTime()
+ */
+internalfn void
+InstanceListRecord(struct instance_list *list, struct instance *instance, u64 latency, b8 isFailed, u64 now)
+{
+  if (isFailed) {
+    instance->errorRate += (INSTANCE_ERROR_RATE_ONE - instance->errorRate) >> INSTANCE_AVERAGE_SHIFT;
+    instance->failureCount++;
+
+    u64 downDuration = INSTANCE_DOWN_DURATION_MAX;
+    if (instance->failureCount < 32) {
+      downDuration = (u64)INSTANCE_DOWN_DURATION << (instance->failureCount - 1);
+      if (downDuration > INSTANCE_DOWN_DURATION_MAX)
+        downDuration = INSTANCE_DOWN_DURATION_MAX;
+    }
+    instance->downUntil = now + downDuration;
+  } else {
+    instance->errorRate -= instance->errorRate >> INSTANCE_AVERAGE_SHIFT;
+    instance->failureCount = 0;
+    instance->downUntil = 0;
+
+    if (latency != 0) {
+      if (instance->latency == 0)
+        instance->latency = latency;
+      else
+        instance->latency = instance->latency - (instance->latency >> INSTANCE_AVERAGE_SHIFT) +
+                            (latency >> INSTANCE_AVERAGE_SHIFT);
+    }
+  }
+
+  instance->updatedAt = now;
+  list->isChanged = 1;
+}
+
+/*
+ * Takes instance that refused requests because it has too many, e.g. with
+ * "429 Too Many Requests". It is not failing, it is left alone until it asks
+ * to, see "Retry-After".
+ * @param until seconds since 1970-01-01 UTC
+ * @param now seconds since 1970-01-01 UTC, see PlatformUnixTime()
+ */
+internalfn void
+InstanceListThrottle(struct instance_list *list, struct instance *instance, u64 until, u64 now)
+{
+  if (instance->downUntil < until)
+    instance->downUntil = until;
+  instance->updatedAt = now;
+  list->isChanged = 1;
+}
+
+/*
+ * Picks instance with lowest score among ones that are up. When every one is
+ * down, picks the one that comes back first.
+ * @param triedMask bit i is set when instance i must not be picked, e.g.
+ *        it failed request already
+ * @param now seconds since 1970-01-01 UTC, see PlatformUnixTime()
+ * @return index of instance, -1 when every instance is tried
+ */
+internalfn s32
+InstanceListPick(struct instance_list *list, u32 triedMask, u64 now)
+{
+  s32 pickedIndex = -1;
+  struct instance *picked = 0;
+  for (u32 instanceIndex = 0; instanceIndex < list->instanceCount; instanceIndex++) {
+    if (triedMask & (1u << instanceIndex))
+      continue;
+
+    struct instance *instance = list->instances + instanceIndex;
+    b8 isBetter;
+    if (!picked)
+      isBetter = 1;
+    else if ((instance->downUntil > now) != (picked->downUntil > now))
+      isBetter = instance->downUntil <= now;
+    else if (instance->downUntil > now)
+      isBetter = instance->downUntil < picked->downUntil;
+    else
+      isBetter = InstanceScore(instance) < InstanceScore(picked);
+
+    if (isBetter) {
+      picked = instance;
+      pickedIndex = (s32)instanceIndex;
+    }
+  }
+  return pickedIndex;
+}
+
+internalfn u64
+InstanceListReadInteger(u8 *octets, u32 length)
+{
+  u64 value = 0;
+  for (u32 index = length; index > 0; index--)
+    value = (value << 8) | octets[index - 1];
+  return value;
+}
+
+internalfn void
+InstanceListWriteInteger(u8 *octets, u32 length, u64 value)
+{
+  for (u32 index = 0; index < length; index++) {
+    octets[index] = (u8)value;
+    value >>= 8;
+  }
+}
+
+/*
+ * Takes averages from file content for instances in list. Ones that are
+ * older than what list has are left out, as are instances not in list.
+ * @return false when content is not an instance list, empty content is
+ */
+internalfn b8
+InstanceListParse(struct instance_list *list, struct string *content)
+{
+  if (content->length == 0)
+    return 1;
+
+  u8 *octets = content->value;
+  if (content->length < INSTANCE_LIST_HEADER_LENGTH || octets[0] != 'I' || octets[1] != 'I' || octets[2] != 'N' ||
+      octets[3] != 'S' || InstanceListReadInteger(octets + 4, 4) != INSTANCE_LIST_VERSION)
+    return 0;
+
+  u64 entryCount = InstanceListReadInteger(octets + 8, 4);
+  u64 position = INSTANCE_LIST_HEADER_LENGTH;
+  for (u64 entryIndex = 0; entryIndex < entryCount; entryIndex++) {
+    if (content->length - position < INSTANCE_LIST_ENTRY_HEADER_LENGTH)
+      return 0;
+    u8 *entry = octets + position;
+    u64 keyLength = InstanceListReadInteger(entry + 32, 2);
+    position += INSTANCE_LIST_ENTRY_HEADER_LENGTH;
+    if (content->length - position < keyLength)
+      return 0;
+    struct string key = StringFromBuffer(octets + position, keyLength);
+    position += keyLength;
+
+    // port has no colon in it, hostname can be IPv6 address
+    u64 colonIndex = keyLength;
+    while (colonIndex > 0 && key.value[colonIndex - 1] != ':')
+      colonIndex--;
+    if (colonIndex == 0)
+      continue;
+    struct string hostname = StringFromBuffer(key.value, colonIndex - 1);
+    struct string port = StringFromBuffer(key.value + colonIndex, keyLength - colonIndex);
+
+    struct instance *instance = InstanceListFind(list, &hostname, &port);
+    u64 updatedAt = InstanceListReadInteger(entry + 0, 8);
+    if (!instance || updatedAt <= instance->updatedAt)
+      continue;
+
+    instance->updatedAt = updatedAt;
+    instance->downUntil = InstanceListReadInteger(entry + 8, 8);
+    instance->latency = InstanceListReadInteger(entry + 16, 8);
+    u64 errorRate = InstanceListReadInteger(entry + 24, 4);
+    instance->errorRate = errorRate < INSTANCE_ERROR_RATE_ONE ? (u32)errorRate : INSTANCE_ERROR_RATE_ONE - 1;
+    instance->failureCount = (u32)InstanceListReadInteger(entry + 28, 4);
+  }
+
+  return 1;
+}
+
+/*
+ * @param buffer at least INSTANCE_LIST_FILE_MAX long
+ * @return file content in buffer, instances never heard from are left out
+ */
+internalfn struct string
+InstanceListSerialize(struct instance_list *list, struct string *buffer)
+{
+  debug_assert(buffer->length >= INSTANCE_LIST_FILE_MAX);
+
+  u8 *octets = buffer->value;
+  octets[0] = 'I';
+  octets[1] = 'I';
+  octets[2] = 'N';
+  octets[3] = 'S';
+  InstanceListWriteInteger(octets + 4, 4, INSTANCE_LIST_VERSION);
+
+  u32 entryCount = 0;
+  u64 position = INSTANCE_LIST_HEADER_LENGTH;
+  for (u32 instanceIndex = 0; instanceIndex < list->instanceCount; instanceIndex++) {
+    struct instance *instance = list->instances + instanceIndex;
+    if (instance->updatedAt == 0)
+      continue;
+
+    u8 *entry = octets + position;
+    InstanceListWriteInteger(entry + 0, 8, instance->updatedAt);
+    InstanceListWriteInteger(entry + 8, 8, instance->downUntil);
+    InstanceListWriteInteger(entry + 16, 8, instance->latency);
+    InstanceListWriteInteger(entry + 24, 4, instance->errorRate);
+    InstanceListWriteInteger(entry + 28, 4, instance->failureCount);
+    InstanceListWriteInteger(entry + 32, 2, instance->hostname.length + 1 + instance->port.length);
+    position += INSTANCE_LIST_ENTRY_HEADER_LENGTH;
+
+    MemoryCopy(octets + position, instance->hostname.value, instance->hostname.length);
+    position += instance->hostname.length;
+    octets[position] = ':';
+    position += 1;
+    MemoryCopy(octets + position, instance->port.value, instance->port.length);
+    position += instance->port.length;
+    entryCount++;
+  }
+
+  InstanceListWriteInteger(octets + 8, 4, entryCount);
+  return StringFromBuffer(octets, position);
+}
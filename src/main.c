@@ -1,453 +1,667 @@
-#include <netdb.h>
-#include <sys/socket.h>
-#include <sys/types.h>
-#include <unistd.h>
-
-// for example usage see mbedtls/programs/ssl/ssl_client2.c
-#include <mbedtls/ctr_drbg.h>
-#include <mbedtls/debug.h>
-#include <mbedtls/entropy.h>
-#include <mbedtls/memory_buffer_alloc.h>
-#include <mbedtls/net_sockets.h>
-
 #include "memory.h"
 #include "print.h"
 #include "string_builder.h"
 #include "text.h"
 #include "type.h"
 
+#include "batch.c"
+#include "ca_store.c"
+#include "concurrency_limit.c"
+#include "connection_pool.c"
+#include "dns.c"
+#include "hedge.c"
+#include "http2.c"
 #include "http_parser.c"
+#include "http_pipeline.c"
 #include "http_request.c"
+#include "instance_list.c"
 #include "json_parser.c"
+#include "options.c"
 #include "platform.h"
+#include "receive_buffer.c"
+#include "request_timing.c"
+#include "ring_buffer.c"
+#include "tls_backend.h"
+#include "tls_connection.c"
+#include "tls_session_cache.c"
+#include "video_table.c"
+
+/*
+ * Instance that requests can go to, with its addresses.
+ */
+struct invidious_instance {
+  // hostname and port are zero terminated
+  struct instance *state;
+  // http://, requests go over plain TCP
+  b8 isPlain;
+  struct dns_resolver resolver;
+  // resolver is started, see InvidiousResolveStart()
+  b8 isResolving;
+  b8 isResolved;
+  // in order they are tried, see DnsAddressInterleave()
+  struct platform_address addresses[CONNECTION_POOL_ADDRESS_MAX];
+  u32 addressCount;
+  // requests in flight at once, see InvidiousRecordResponse()
+  struct concurrency_limit limit;
+  // in nanoseconds, instance asked not to be sent requests before it
+  u64 throttledUntil;
+  // responses of this run, request later than their p95 is sent again to
+  // another instance, see InvidiousHttp11Hedge()
+  struct request_timing_histogram timingHistogram;
+};
 
-struct invidious_context {
-  // Socket
-
-  int sockfd;
+enum {
+  // concurrent streams of HTTP/2 connection
+  INVIDIOUS_HTTP2_STREAM_MAX = 8,
+};
 
-  // Mbed TLS
+// address space of every response buffer, response that does not fit is rejected
+comptime u64 INVIDIOUS_RESPONSE_RESERVED = 256 << 20;
 
-  mbedtls_ssl_context ssl;
-  mbedtls_ssl_config sslConfig;
-  mbedtls_x509_crt cacert;
-  mbedtls_ctr_drbg_context ctrDrbg;
-  mbedtls_entropy_context entropy;
+struct invidious_context {
+  // Instances
+
+  // averages of instances, see InvidiousLoadInstances()
+  struct instance_list instanceList;
+  // zero terminated, null when there is no cache directory
+  struct string instanceListPath;
+  // in same order as in instanceList
+  struct invidious_instance instances[INSTANCE_MAX];
+  // one requests go to, see InstanceListPick()
+  struct invidious_instance *instance;
+
+  // Network
+
+  struct platform_transport transport;
+  // connections are kept open between requests
+  struct connection_pool pool;
+  // TLS sessions of earlier runs, see InvidiousLoadSessions()
+  struct tls_session_cache sessionCache;
+  // zero terminated, null when there is no cache directory
+  struct string sessionCachePath;
+  // answers of name server, see InvidiousLoadDnsCache()
+  struct dns_cache dnsCache;
+  // zero terminated, null when there is no cache directory
+  struct string dnsCachePath;
+  // in nanoseconds, last time server sent something, see InvidiousTransportWait()
+  u64 activeAt;
+  // records of idle connections are handed to kernel, see TlsConnectionKernelTls()
+  b8 isKernelTls;
+  // frames of HTTP/2 connection, mapped on first use and kept, see InvidiousFetchHttp2()
+  struct ring_buffer http2Ring;
+  // response of every stream, reserved on first use and kept
+  struct receive_buffer http2StreamBuffers[INVIDIOUS_HTTP2_STREAM_MAX];
+
+  // Timing, see src/request_timing.c
+
+  // marks every request of fetch shares, see InvidiousFetch()
+  struct request_timing fetchTiming;
+  // phases of every video printed
+  struct request_timing_histogram timingHistogram;
+  // phases are printed after every video, see InvidiousTimingReport()
+  b8 isTiming;
+
+  // Batch, see InvidiousFetchBatch()
+
+  // ids are read from file, answers that are not videos do not stop it
+  b8 isBatch;
+  // videos not printed, in batch
+  u32 failedCount;
+  // requests in flight at once, 0 when as many as connections allow
+  u32 requestMax;
+  // videos are printed as they are answered
+  b8 isUnordered;
+  // file whose ids are given to fetch as they are read, see InvidiousBatchTake()
+  struct invidious_batch *batch;
+
+  // Hedging, see InvidiousHttp11Hedge()
+
+  // late requests are sent again to another instance
+  b8 isHedging;
+  // duplicates of whole run
+  struct hedge_budget hedgeBudget;
+
+  // Coalescing, see InvidiousFetchAll()
+
+  // answers of every video of run, one asked for again is not requested
+  struct video_table videoTable;
+  // videos of fetch in order given, waiting ones are asked for again and are
+  // printed from videoTable
+  struct string *givenIds;
+  b8 *isWaiting;
+  u32 givenCount;
+  // videos before it are printed, when order matters
+  u32 givenPrintedCount;
+
+  // TLS, see tls_backend.h
+
+  struct tls_backend_config tlsConfig;
+  // roots indexed by subject, see InvidiousLoadCaStore()
+  struct ca_store caStore;
 };
 
 #include "string_builder_extended.c"
 
 internalfn void
-MbedtlsDebugCallback(void *data, int level, const char *file, int line, const char *str)
+StringBuilderAppendTlsConnectionError(string_builder *sb, struct tls_connection *connection)
 {
-  string_builder *sb = data;
-
-  // see mbedtls-3.6.3/include/mbedtls/debug.h:144:33
-  string levelTexts[] = {
-      StringFromLiteral("[NDBG]"), // 0 No debug
-      StringFromLiteral("[ERR ]"), // 1 Error
-      StringFromLiteral("[CHG ]"), // 2 State change
-      StringFromLiteral("[INFO]"), // 3 Informational
-      StringFromLiteral("[VERB]"), // 4 Verbose
-  };
-  debug_assert(level >= 0 && level <= ARRAY_COUNT(levelTexts));
-
-  StringBuilderAppendString(sb, &levelTexts[level]);
-  StringBuilderAppendStringLiteral(sb, " ");
-  string relativeFile = StringFromZeroTerminated((u8 *)file, 1024);
-  {
-    string_cursor cursor = StringCursorFromString(&relativeFile);
-    StringCursorConsumeUntil(&cursor, &StringFromLiteral("mbedtls-3.6.3/"));
-    relativeFile = StringCursorExtractRemaining(&cursor);
+  if (connection->error < 0) {
+    StringBuilderAppendTlsBackendError(sb, connection->error);
+  } else {
+    StringBuilderAppendStringLiteral(sb, "error: ");
+    errno = connection->error;
+    StringBuilderAppendPlatformError(sb);
   }
-  StringBuilderAppendString(sb, &relativeFile);
-  StringBuilderAppendStringLiteral(sb, ":");
-  StringBuilderAppendS32(sb, line);
-  StringBuilderAppendStringLiteral(sb, ": ");
-  StringBuilderAppendZeroTerminated(sb, str, 1024);
-
-  string message = StringBuilderFlush(sb);
-  PrintString(&message);
 }
 
-int
-main(int argc, char *argv[])
+// server that sends nothing for this long is taken as down, in nanoseconds
+comptime u64 INVIDIOUS_RESPONSE_TIMEOUT = 10ULL * 1000000000 /* 1e9 */;
+
+/*
+ * Waits for completions of transport, or until connection pool has something
+ * to do. Instance that sends nothing for INVIDIOUS_RESPONSE_TIMEOUT is given
+ * up on, so request can go to another one.
+ * @param wakeAt nanoseconds, wait returns by then even when nothing completes,
+ *        0 when nothing is due
+ * @return count of completions, -1 when server did not answer in time, message is printed
+ */
+internalfn s32
+InvidiousTransportWait(struct invidious_context *context, struct platform_completion *completions,
+                       u32 completionMax, u64 wakeAt, string_builder *sb)
 {
-  enum {
-    KILOBYTES = (1 << 10),
-    MEGABYTES = (1 << 20),
-  };
+  u64 now = NowInNanoseconds();
+  u64 waited = now - context->activeAt;
+  if (waited >= INVIDIOUS_RESPONSE_TIMEOUT) {
+    StringBuilderAppendStringLiteral(sb, "Server did not answer in time.");
+    StringBuilderAppendStringLiteral(sb, "\n  Instance: ");
+    StringBuilderAppendString(sb, &context->instance->state->hostname);
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return -1;
+  }
 
-  struct invidious_context context = {};
-  u8 stackBuf[2 * MEGABYTES];
-  memory_arena stackMemory = {
-      .block = stackBuf,
-      .total = ARRAY_COUNT(stackBuf),
-  };
+  // rounded up, so timeout has passed when wait returns empty
+  u64 remaining = (INVIDIOUS_RESPONSE_TIMEOUT - waited + 999999) / 1000000 /* 1e6 */;
+  s32 timeout = ConnectionPoolTimeout(&context->pool, now);
+  if (timeout == -1 || (u64)timeout > remaining)
+    timeout = (s32)remaining;
+  if (wakeAt != 0) {
+    u64 untilWake = wakeAt > now ? (wakeAt - now + 999999) / 1000000 /* 1e6 */ : 0;
+    if (timeout == -1 || (u64)timeout > untilWake)
+      timeout = (s32)untilWake;
+  }
 
-  string_builder *sb = MakeStringBuilder(&stackMemory, 2048, 32);
+  u32 completionCount = PlatformTransportWait(&context->transport, completions, completionMax, timeout);
+  if (completionCount != 0)
+    context->activeAt = NowInNanoseconds();
+  return (s32)completionCount;
+}
 
-  // hostname
-  struct string hostname = StringFromLiteral("i.iii.st");
-  // port
-  struct string port = StringFromLiteral("443");
-  // video id
-  struct string videoId = StringFromLiteral("d_oVysaqG_0");
+/*
+ * Waits for completions and gives them to connection pool. For when only one
+ * connection is used, so whose they are is known.
+ * @return false when server did not answer in time, message is printed
+ */
+internalfn b8
+InvidiousWait(struct invidious_context *context, string_builder *sb)
+{
+  struct platform_completion completions[16];
+  s32 completionCount = InvidiousTransportWait(context, completions, ARRAY_COUNT(completions), 0, sb);
+  if (completionCount == -1)
+    return 0;
+
+  for (u32 completionIndex = 0; completionIndex < (u32)completionCount; completionIndex++)
+    ConnectionPoolComplete(&context->pool, completions + completionIndex);
+  ConnectionPoolEvict(&context->pool, NowInNanoseconds());
+  return 1;
+}
 
-  // Socket
-  context.sockfd = -1;
+/*
+ * Takes connection to instance from pool, see ConnectionPoolAcquire().
+ */
+internalfn struct pooled_connection *
+InvidiousAcquire(struct invidious_context *context, struct invidious_instance *instance, void *data)
+{
+  return ConnectionPoolAcquire(&context->pool, &instance->state->hostname, &instance->state->port, instance->isPlain,
+                               instance->addresses, instance->addressCount, data);
+}
 
-  {
-    struct addrinfo hints = {
-        .ai_family = AF_INET,
-        .ai_socktype = SOCK_STREAM,
-    };
-    struct addrinfo *res;
+/*
+ * Copies marks of connection into timing of request that is sent on it, when
+ * connection was made after request started, so request waited for it.
+ */
+internalfn void
+InvidiousTimingConnection(struct request_timing *timing, struct pooled_connection *pooled)
+{
+  if (pooled->connectingAt < timing->marks[REQUEST_TIMING_MARK_START])
+    return;
+  RequestTimingMark(timing, REQUEST_TIMING_MARK_CONNECTING, pooled->connectingAt);
+  RequestTimingMark(timing, REQUEST_TIMING_MARK_CONNECTED, pooled->connectedAt);
+  RequestTimingMark(timing, REQUEST_TIMING_MARK_OPENED, pooled->openedAt);
+}
 
-    if (getaddrinfo((char *)hostname.value, (char *)port.value, &hints, &res)) {
-      return 1;
-    }
+/*
+ * Counts phases of video that is printed, and prints them as one line when
+ * asked, e.g. timing d_oVysaqG_0 dns=0 connect=180 tls=2150 ...
+ */
+internalfn void
+InvidiousTimingReport(struct invidious_context *context, string_builder *sb, struct string *videoId,
+                      struct request_timing *timing)
+{
+  RequestTimingHistogramAdd(&context->timingHistogram, timing);
+  if (!context->isTiming)
+    return;
 
-    int sockfd;
-    for (struct addrinfo *p = res; p; p = p->ai_next) {
-      sockfd = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
-      if (sockfd == -1)
-        continue;
+  StringBuilderAppendStringLiteral(sb, "timing ");
+  StringBuilderAppendString(sb, videoId);
+  StringBuilderAppendStringLiteral(sb, " ");
+  StringBuilderAppendRequestTiming(sb, timing);
+  StringBuilderAppendStringLiteral(sb, "\n");
+  struct string message = StringBuilderFlush(sb);
+  PrintString(&message);
+}
 
-      if (connect(sockfd, p->ai_addr, p->ai_addrlen) == 0)
-        break;
+/*
+ * Takes connection to server from pool, connects and does TLS handshake when
+ * there is no idle one.
+ * @return open connection, 0 on error, message is printed
+ */
+internalfn struct pooled_connection *
+InvidiousConnect(struct invidious_context *context, string_builder *sb)
+{
+  struct pooled_connection *pooled = InvidiousAcquire(context, context->instance, 0);
+  if (!pooled) {
+    StringBuilderAppendStringLiteral(sb, "Too many connections to server.\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return 0;
+  }
 
-      close(sockfd);
+  struct tls_connection *connection = &pooled->tls;
+  while (connection->state == TLS_CONNECTION_STATE_CONNECTING ||
+         connection->state == TLS_CONNECTION_STATE_HANDSHAKING) {
+    if (!InvidiousWait(context, sb)) {
+      ConnectionPoolRelease(&context->pool, pooled, 0, NowInNanoseconds());
+      return 0;
     }
+    ConnectionPoolHandshake(pooled, NowInNanoseconds());
+  }
 
-    freeaddrinfo(res);
-
-    if (sockfd == -1)
-      return 1;
-
-    context.sockfd = sockfd;
+  if (connection->state != TLS_CONNECTION_STATE_OPEN) {
+    StringBuilderAppendStringLiteral(sb, "Connecting to server failed.\n  ");
+    StringBuilderAppendTlsConnectionError(sb, connection);
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    ConnectionPoolRelease(&context->pool, pooled, 0, NowInNanoseconds());
+    return 0;
   }
 
-  // Mbed TLS Setup
-  int mbedtlsError;
-  enum { MBEDTLS_ALLOCATED_MEMORY = 544 * KILOBYTES };
-  mbedtls_memory_buffer_alloc_init(MemoryArenaPush(&stackMemory, MBEDTLS_ALLOCATED_MEMORY), MBEDTLS_ALLOCATED_MEMORY);
+  return pooled;
+}
 
-  mbedtls_ssl_init(&context.ssl);
-  mbedtls_ssl_config_init(&context.sslConfig);
-  mbedtls_x509_crt_init(&context.cacert);
-  mbedtls_ctr_drbg_init(&context.ctrDrbg);
-  mbedtls_entropy_init(&context.entropy);
+/*
+ * Reads TLS sessions that earlier runs stored, so handshakes resume them.
+ * Cache is best effort, it is used empty when file cannot be read.
+ */
+internalfn void
+InvidiousLoadSessions(struct invidious_context *context, memory_arena *arena)
+{
+  TlsSessionCacheInit(&context->sessionCache, arena);
+  struct string pathBuffer = {.value = MemoryArenaPush(arena, 4096), .length = 4096};
+  context->sessionCachePath = PlatformCacheFilePath(&pathBuffer, &StringFromLiteral("invidious_tls_sessions"));
+  if (IsStringNull(&context->sessionCachePath))
+    return;
+
+  s32 file = PlatformFileLock(&context->sessionCachePath, 0);
+  if (file == -1)
+    return;
+
+  memory_temp tempMemory = MemoryTempBegin(arena);
+  struct string buffer = {
+      .value = MemoryArenaPush(tempMemory.arena, TLS_SESSION_CACHE_FILE_MAX),
+      .length = TLS_SESSION_CACHE_FILE_MAX,
+  };
+  struct string content = PlatformFileLockedRead(file, &buffer);
+  PlatformFileUnlock(file);
+  if (!IsStringNull(&content))
+    TlsSessionCacheParse(&context->sessionCache, &content, PlatformUnixTime());
+  MemoryTempEnd(&tempMemory);
+  context->sessionCache.isChanged = 0;
+}
 
-  // Load system CA
-  {
-    memory_temp tempMemory = MemoryTempBegin(&stackMemory);
+/*
+ * Writes TLS sessions back when connections got new ones. Sessions that other
+ * runs stored meanwhile are kept.
+ */
+internalfn void
+InvidiousSaveSessions(struct invidious_context *context, memory_arena *arena)
+{
+  if (!context->sessionCache.isChanged || IsStringNull(&context->sessionCachePath))
+    return;
 
-    struct string systemCAPath = StringFromLiteral("/etc/ssl/certs/ca-certificates.crt");
-    u64 systemCALength = PlatformFileSize(&systemCAPath);
-    if (systemCALength == 0) {
-      StringBuilderAppendStringLiteral(sb, "CA certificates not found or invalid on system.");
-      StringBuilderAppendStringLiteral(sb, "\n  Path: ");
-      StringBuilderAppendString(sb, &systemCAPath);
-      StringBuilderAppendStringLiteral(sb, "\n");
-      struct string message = StringBuilderFlush(sb);
-      PrintString(&message);
-      return 1;
-    }
+  s32 file = PlatformFileLock(&context->sessionCachePath, 1);
+  if (file == -1)
+    return;
 
-    systemCALength += 1; // zero-termination
-    struct string buffer = {
-        .length = systemCALength,
-        .value = MemoryArenaPushAligned(tempMemory.arena, systemCALength, 32),
-    };
+  memory_temp tempMemory = MemoryTempBegin(arena);
+  struct string buffer = {
+      .value = MemoryArenaPush(tempMemory.arena, TLS_SESSION_CACHE_FILE_MAX),
+      .length = TLS_SESSION_CACHE_FILE_MAX,
+  };
+  u64 now = PlatformUnixTime();
+  struct string content = PlatformFileLockedRead(file, &buffer);
+  if (!IsStringNull(&content))
+    TlsSessionCacheParse(&context->sessionCache, &content, now);
+  content = TlsSessionCacheSerialize(&context->sessionCache, &buffer, now);
+  if (!IsStringNull(&content))
+    PlatformFileLockedWrite(file, &content);
+  PlatformFileUnlock(file);
+  MemoryTempEnd(&tempMemory);
+  context->sessionCache.isChanged = 0;
+}
 
-    struct string systemCA = PlatformReadFile(&buffer, &systemCAPath);
-    if (IsStringNullOrEmpty(&systemCA)) {
-      StringBuilderAppendStringLiteral(sb, "Reading CA certificates from system failed.");
-      StringBuilderAppendStringLiteral(sb, "\n");
-      struct string message = StringBuilderFlush(sb);
-      PrintString(&message);
-      return 1;
-    }
+/*
+ * Writes answers of name server back, with ones other runs stored meanwhile.
+ */
+internalfn void
+InvidiousSaveDnsCache(struct invidious_context *context, memory_arena *arena)
+{
+  if (!context->dnsCache.isChanged || IsStringNull(&context->dnsCachePath))
+    return;
 
-    systemCA = StringStripWhitespace(&systemCA);
-    // mbedtls_x509_crt_parse expectes zero-terminated
-    systemCA.value[systemCA.length] = 0;
-    systemCA.length += 1;
+  s32 file = PlatformFileLock(&context->dnsCachePath, 1);
+  if (file == -1)
+    return;
 
-    mbedtlsError = mbedtls_x509_crt_parse(&context.cacert, systemCA.value, systemCA.length);
-    if (mbedtlsError < 0) {
-      StringBuilderAppendStringLiteral(sb, "Failed to parse CA cert.");
-      StringBuilderAppendStringLiteral(sb, "\n");
-      StringBuilderAppendMbedtlsError(sb, mbedtlsError);
-      StringBuilderAppendStringLiteral(sb, "\n");
-      struct string message = StringBuilderFlush(sb);
-      PrintString(&message);
-      return 1;
-    }
+  memory_temp tempMemory = MemoryTempBegin(arena);
+  struct string buffer = {
+      .value = MemoryArenaPush(tempMemory.arena, DNS_CACHE_FILE_MAX),
+      .length = DNS_CACHE_FILE_MAX,
+  };
+  u64 now = PlatformUnixTime();
+  struct string content = PlatformFileLockedRead(file, &buffer);
+  if (!IsStringNull(&content))
+    DnsCacheParse(&context->dnsCache, &content, now);
+  content = DnsCacheSerialize(&context->dnsCache, &buffer, now);
+  PlatformFileLockedWrite(file, &content);
+  PlatformFileUnlock(file);
+  MemoryTempEnd(&tempMemory);
+  context->dnsCache.isChanged = 0;
+}
 
-    MemoryTempEnd(&tempMemory);
-  }
+/*
+ * Reads answers of name server that earlier runs stored.
+ */
+internalfn void
+InvidiousLoadDnsCache(struct invidious_context *context, memory_arena *arena)
+{
+  DnsCacheInit(&context->dnsCache, arena);
+  struct string pathBuffer = {.value = MemoryArenaPush(arena, 4096), .length = 4096};
+  context->dnsCachePath = PlatformCacheFilePath(&pathBuffer, &StringFromLiteral("invidious_dns"));
+  if (IsStringNull(&context->dnsCachePath))
+    return;
+
+  s32 file = PlatformFileLock(&context->dnsCachePath, 0);
+  if (file == -1)
+    return;
+
+  memory_temp tempMemory = MemoryTempBegin(arena);
+  struct string buffer = {
+      .value = MemoryArenaPush(tempMemory.arena, DNS_CACHE_FILE_MAX),
+      .length = DNS_CACHE_FILE_MAX,
+  };
+  struct string content = PlatformFileLockedRead(file, &buffer);
+  PlatformFileUnlock(file);
+  if (!IsStringNull(&content))
+    DnsCacheParse(&context->dnsCache, &content, PlatformUnixTime());
+  MemoryTempEnd(&tempMemory);
+}
 
-  // Seed RNG
-  mbedtlsError = mbedtls_ctr_drbg_seed(&context.ctrDrbg, mbedtls_entropy_func, &context.entropy, 0, 0);
-  if (mbedtlsError != 0) {
-    StringBuilderAppendStringLiteral(sb, "Entropy seed failed.");
-    StringBuilderAppendStringLiteral(sb, "\n");
-    struct string message = StringBuilderFlush(sb);
-    PrintString(&message);
-    return 1;
+/*
+ * Starts resolving hostname of instance, so it goes on while TLS library is set
+ * up. Address in text and answers cached by earlier runs are used right away,
+ * otherwise name server is asked, see src/dns.c. Does nothing when it is
+ * started already.
+ */
+internalfn void
+InvidiousResolveStart(struct invidious_context *context, struct invidious_instance *instance)
+{
+  if (instance->isResolving || instance->isResolved)
+    return;
+
+  struct string *hostname = &instance->state->hostname;
+  u64 port;
+  if (!ParseU64(&instance->state->port, &port) || port > 0xffff) {
+    instance->isResolved = 1;
+    return;
   }
 
-  if (mbedtls_ssl_config_defaults(&context.sslConfig, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
-                                  MBEDTLS_SSL_PRESET_DEFAULT) != 0) {
-    StringBuilderAppendStringLiteral(sb, "SSL configuration failed.");
-    StringBuilderAppendStringLiteral(sb, "\n");
-    struct string message = StringBuilderFlush(sb);
-    PrintString(&message);
-    return 1;
+  if (PlatformAddressParse(instance->addresses, hostname, (u16)port)) {
+    instance->addressCount = 1;
+    instance->isResolved = 1;
+    return;
   }
 
-#if 0 && IS_BUILD_DEBUG
-  // NOTE: Enable for troubleshooting handshake errors
-  mbedtls_ssl_conf_dbg(&context.sslConfig, MbedtlsDebugCallback, sb);
-  mbedtls_debug_set_threshold(4);
-#endif
-
-  mbedtls_ssl_conf_min_version(&context.sslConfig, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_4);
-  mbedtls_ssl_conf_max_version(&context.sslConfig, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_4);
-
-#if 0 && IS_BUILD_DEBUG
-  mbedtls_ssl_conf_authmode(&context.sslConfig, MBEDTLS_SSL_VERIFY_OPTIONAL);
-#else
-  mbedtls_ssl_conf_authmode(&context.sslConfig, MBEDTLS_SSL_VERIFY_REQUIRED);
-  mbedtls_ssl_conf_ca_chain(&context.sslConfig, &context.cacert, NULL);
-#endif
-  mbedtls_ssl_conf_rng(&context.sslConfig, mbedtls_ctr_drbg_random, &context.ctrDrbg);
-
-  mbedtlsError = mbedtls_ssl_setup(&context.ssl, &context.sslConfig);
-  if (mbedtlsError) {
-    u32 breakHere = 1;
-    StringBuilderAppendStringLiteral(sb, "SSL setup failed.");
-    StringBuilderAppendStringLiteral(sb, "  Mbed TLS error: ");
-    StringBuilderAppendMbedtlsError(sb, mbedtlsError);
-    StringBuilderAppendStringLiteral(sb, "\n");
-    struct string message = StringBuilderFlush(sb);
-    PrintString(&message);
-    return 1;
+  struct dns_cache_entry *entry = DnsCacheFind(&context->dnsCache, hostname, PlatformUnixTime());
+  if (entry) {
+    instance->addressCount = DnsCacheEntryAddresses(entry, (u16)port, instance->addresses);
+    DnsAddressInterleave(instance->addresses, instance->addressCount);
+    instance->isResolved = 1;
+    return;
   }
 
-  // Attach Mbed TLS to unix socket
-  mbedtls_ssl_set_bio(&context.ssl, &context.sockfd, mbedtls_net_send, mbedtls_net_recv, 0);
-  mbedtls_ssl_set_hostname(&context.ssl, (char *)hostname.value);
+  struct platform_address nameServer;
+  u32 random;
+  struct string randomBuffer = StringFromBuffer((u8 *)&random, sizeof(random));
+  if (!PlatformAddressNameServer(&nameServer) || !PlatformGetRandom(&randomBuffer))
+    return;
 
-  // Handshake
-  mbedtlsError = mbedtls_ssl_handshake(&context.ssl);
-  if (mbedtlsError) {
-    u32 breakHere = 1;
-    StringBuilderAppendStringLiteral(sb, "TLS handshake failed.\n");
-    StringBuilderAppendStringLiteral(sb, "  Mbed TLS error: ");
-    StringBuilderAppendMbedtlsError(sb, mbedtlsError);
-    StringBuilderAppendStringLiteral(sb, "\n");
-    struct string message = StringBuilderFlush(sb);
-    PrintString(&message);
-    return 1;
+  instance->isResolving = DnsResolverStart(&instance->resolver, &nameServer, hostname, (u16)port, random,
+                                           NowInNanoseconds()) == DNS_RESOLVER_STATE_RESOLVING;
+}
+
+/*
+ * Waits for resolver that InvidiousResolveStart() started, starts it when it
+ * is not. When name server does not answer, or there is none, system resolver
+ * is asked, it also knows names in /etc/hosts and search domains.
+ * @return false when hostname cannot be resolved
+ */
+internalfn b8
+InvidiousResolveFinish(struct invidious_context *context, struct invidious_instance *instance, memory_arena *arena)
+{
+  InvidiousResolveStart(context, instance);
+  if (instance->isResolved)
+    return instance->addressCount != 0;
+
+  struct string *hostname = &instance->state->hostname;
+  if (instance->isResolving) {
+    struct dns_resolver *resolver = &instance->resolver;
+    while (DnsResolverUpdate(resolver, NowInNanoseconds()) == DNS_RESOLVER_STATE_RESOLVING)
+      PlatformSocketWait(resolver->socket, PLATFORM_EVENT_READ, DnsResolverTimeout(resolver, NowInNanoseconds()));
+    instance->isResolving = 0;
+
+    if (resolver->state == DNS_RESOLVER_STATE_DONE) {
+      for (u32 addressIndex = 0;
+           addressIndex < resolver->addressCount && addressIndex < ARRAY_COUNT(instance->addresses);
+           addressIndex++) {
+        instance->addresses[addressIndex] = resolver->addresses[addressIndex];
+        instance->addressCount++;
+      }
+      DnsCacheStore(&context->dnsCache, hostname, instance->addresses, instance->addressCount, resolver->ttl,
+                    PlatformUnixTime());
+      InvidiousSaveDnsCache(context, arena);
+    }
   }
 
-  // Send an HTTP Request
-  {
-    /*
-    struct http_request_info requestInfo = {
-        .method = HTTP_METHOD_POST,
-        .version = HTTP_VERSION_20,
-        .url = url,
-
-        .contentType = HTTP_CONTENT_TYPE_JSON,
-        .content = json,
-
-        .contentType = HTTP_CONTENT_TYPE_FORM_URLENCODED,
-        .content =
-            (struct http_form_urlencoded_list){
-                .count = 1,
-                .items =
-                    (struct http_form_urlencoded_item[]){
-                        {
-                            .name = StringFromLiteral("id"),
-                            .value = StringFromLiteral("rZpvPY4V0mciNHBPifitWVlJPaHFIg9Q"),
-                        },
-                    },
-            },
-    };
-    */
+  // system resolver does not tell how long answer is valid, it is not cached
+  if (instance->addressCount == 0)
+    instance->addressCount = PlatformAddressResolveAll(hostname, &instance->state->port, instance->addresses,
+                                                       ARRAY_COUNT(instance->addresses));
 
-    memory_temp tempMemory = MemoryTempBegin(&stackMemory);
+  DnsAddressInterleave(instance->addresses, instance->addressCount);
+  instance->isResolved = 1;
+  return instance->addressCount != 0;
+}
 
-#if 1
-    struct string_builder *pathBuilder = MakeStringBuilder(tempMemory.arena, 256, 0);
-    StringBuilderAppendStringLiteral(pathBuilder, "/api/v1/videos/");
-    StringBuilderAppendString(pathBuilder, &videoId);
-    struct string path = StringBuilderFlush(pathBuilder);
+/*
+ * Reads averages of instances that earlier runs stored, so best instance is
+ * known without probing every run. List is used as it is when file cannot be
+ * read.
+ */
+internalfn void
+InvidiousLoadInstances(struct invidious_context *context, memory_arena *arena)
+{
+  struct string pathBuffer = {.value = MemoryArenaPush(arena, 4096), .length = 4096};
+  context->instanceListPath = PlatformCacheFilePath(&pathBuffer, &StringFromLiteral("invidious_instances"));
+  if (IsStringNull(&context->instanceListPath))
+    return;
+
+  s32 file = PlatformFileLock(&context->instanceListPath, 0);
+  if (file == -1)
+    return;
+
+  memory_temp tempMemory = MemoryTempBegin(arena);
+  struct string buffer = {
+      .value = MemoryArenaPush(tempMemory.arena, INSTANCE_LIST_FILE_MAX),
+      .length = INSTANCE_LIST_FILE_MAX,
+  };
+  struct string content = PlatformFileLockedRead(file, &buffer);
+  PlatformFileUnlock(file);
+  if (!IsStringNull(&content))
+    InstanceListParse(&context->instanceList, &content);
+  MemoryTempEnd(&tempMemory);
+  context->instanceList.isChanged = 0;
+}
 
-    struct http_request_info requestInfo = {
-        .method = HTTP_METHOD_GET,
-        .version = HTTP_VERSION_11,
-        .host = hostname,
-        .path = path,
-        .accept = HTTP_CONTENT_TYPE_JSON,
-    };
+/*
+ * Writes averages of instances back, newer ones that other runs stored
+ * meanwhile are kept.
+ */
+internalfn void
+InvidiousSaveInstances(struct invidious_context *context, memory_arena *arena)
+{
+  if (!context->instanceList.isChanged || IsStringNull(&context->instanceListPath))
+    return;
 
-    struct string request = HttpRequestBuild(&requestInfo, tempMemory.arena);
-#else
-    StringBuilderAppendStringLiteral(sb, "GET ");
-    StringBuilderAppendStringLiteral(sb, "/api/v1/videos/");
-    StringBuilderAppendString(sb, &videoId);
-    StringBuilderAppendStringLiteral(sb, " HTTP/1.1");
-    StringBuilderAppendStringLiteral(sb, "\r\n");
-    StringBuilderAppendStringLiteral(sb, "host: ");
-    StringBuilderAppendString(sb, &hostname);
-    StringBuilderAppendStringLiteral(sb, "\r\n");
-    StringBuilderAppendStringLiteral(sb, "\r\n");
-    struct string request = StringBuilderFlush(sb);
-#endif
+  s32 file = PlatformFileLock(&context->instanceListPath, 1);
+  if (file == -1)
+    return;
 
-    u64 totalBytesWritten = 0;
-    while (1) {
-      int ret = mbedtls_ssl_write(&context.ssl, request.value + totalBytesWritten, request.length - totalBytesWritten);
-      if (ret < 0) {
-        mbedtlsError = ret;
-        if (mbedtlsError == MBEDTLS_ERR_SSL_WANT_READ || mbedtlsError == MBEDTLS_ERR_SSL_WANT_WRITE ||
-            mbedtlsError == MBEDTLS_ERR_SSL_CRYPTO_IN_PROGRESS) {
-          continue;
-        }
+  memory_temp tempMemory = MemoryTempBegin(arena);
+  struct string buffer = {
+      .value = MemoryArenaPush(tempMemory.arena, INSTANCE_LIST_FILE_MAX),
+      .length = INSTANCE_LIST_FILE_MAX,
+  };
+  struct string content = PlatformFileLockedRead(file, &buffer);
+  if (!IsStringNull(&content))
+    InstanceListParse(&context->instanceList, &content);
+  content = InstanceListSerialize(&context->instanceList, &buffer);
+  PlatformFileLockedWrite(file, &content);
+  PlatformFileUnlock(file);
+  MemoryTempEnd(&tempMemory);
+  context->instanceList.isChanged = 0;
+}
 
-        StringBuilderAppendStringLiteral(sb, "Mbed TLS write error: ");
-        StringBuilderAppendMbedtlsError(sb, mbedtlsError);
-        StringBuilderAppendStringLiteral(sb, "\n");
-        struct string message = StringBuilderFlush(sb);
-        PrintString(&message);
+/*
+ * Opens store of system CA certificates, see src/ca_store.c. Store file is
+ * rebuilt from bundle when it is missing or bundle changed since.
+ * @return false when there is no store, bundle has to be parsed as a whole
+ */
+internalfn b8
+InvidiousLoadCaStore(struct invidious_context *context, struct string *bundlePath, memory_arena *arena)
+{
+  u64 bundleSize;
+  u64 bundleModifiedAt;
+  if (!PlatformFileInfo(bundlePath, &bundleSize, &bundleModifiedAt) || bundleSize == 0)
+    return 0;
+
+  struct string pathBuffer = {.value = MemoryArenaPush(arena, 4096), .length = 4096};
+  struct string path = PlatformCacheFilePath(&pathBuffer, &StringFromLiteral("invidious_ca_store"));
+  if (!IsStringNull(&path)) {
+    struct string content = PlatformFileMap(&path);
+    if (!IsStringNull(&content)) {
+      if (CaStoreOpen(&context->caStore, &content, bundleSize, bundleModifiedAt))
         return 1;
-      }
-
-      u64 bytesWritten = (u64)ret;
-      totalBytesWritten += bytesWritten;
-      if (totalBytesWritten == request.length)
-        break;
+      PlatformFileUnmap(&content);
     }
-
-    MemoryTempEnd(&tempMemory);
   }
 
-  // Recieve a HTTP Response and parse it
-  u64 responseBufferMax = 256 * KILOBYTES;
-  u8 *responseBuffer = MemoryArenaPush(&stackMemory, sizeof(*responseBuffer) * responseBufferMax);
-  struct string response;
-  struct http_parser *httpParser = MakeHttpParser(&stackMemory, 1024);
-  {
-    u64 totalBytesRead = 0;
-    while (1) {
-      int ret = mbedtls_ssl_read(&context.ssl, responseBuffer + totalBytesRead, responseBufferMax - totalBytesRead);
-      if (ret < 0) {
-        mbedtlsError = ret;
-        if (mbedtlsError == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY)
-          break;
-        if (mbedtlsError == MBEDTLS_ERR_SSL_CRYPTO_IN_PROGRESS)
-          continue;
-        if (mbedtlsError == MBEDTLS_ERR_SSL_WANT_READ || mbedtlsError == MBEDTLS_ERR_SSL_WANT_WRITE)
-          continue;
-
-        StringBuilderAppendStringLiteral(sb, "TLS read failed.\n");
-        StringBuilderAppendStringLiteral(sb, "  Mbed TLS error: ");
-        StringBuilderAppendMbedtlsError(sb, mbedtlsError);
-        StringBuilderAppendStringLiteral(sb, "\n");
-        struct string message = StringBuilderFlush(sb);
-        PrintString(&message);
-        return 1;
-      }
-
-      u64 bytesRead = (u64)ret;
-      if (bytesRead == 0)
-        break; // EOF
+  // store is used for rest of run
+  memory_arena storeMemory = PlatformMemoryAllocate(CaStoreLengthMax(bundleSize));
+  if (!storeMemory.block)
+    return 0;
+
+  memory_temp tempMemory = MemoryTempBegin(arena);
+  struct string bundleBuffer = {.value = MemoryArenaPush(tempMemory.arena, bundleSize), .length = bundleSize};
+  struct string bundle = PlatformReadFile(&bundleBuffer, bundlePath);
+  struct string storeBuffer = {.value = storeMemory.block, .length = storeMemory.total};
+  struct string content = CaStoreBuild(&storeBuffer, &bundle, bundleSize, bundleModifiedAt);
+  MemoryTempEnd(&tempMemory);
+  if (IsStringNull(&content) || !CaStoreOpen(&context->caStore, &content, bundleSize, bundleModifiedAt))
+    return 0;
+
+  // next runs use it, bundle changing meanwhile is caught by them
+  if (!IsStringNull(&path))
+    PlatformFileReplace(&path, &content);
+  return 1;
+}
 
-      struct string packet = StringFromBuffer(responseBuffer + totalBytesRead, bytesRead);
-      b8 ok = HttpParse(httpParser, &packet);
-      if (ok)
-        break;
-      if (httpParser->error != HTTP_PARSER_ERROR_PARTIAL) {
-        StringBuilderAppendStringLiteral(sb, "Http parser failed.");
-        StringBuilderAppendStringLiteral(sb, "\n     error: ");
-        StringBuilderAppendHttpParserError(sb, httpParser->error);
-        StringBuilderAppendStringLiteral(sb, "\n  position: ");
-        StringBuilderAppendU64(sb, httpParser->position);
-        StringBuilderAppendStringLiteral(sb, "\n");
-        struct string message = StringBuilderFlush(sb);
-        PrintString(&message);
-        return 1;
-      }
 
-      totalBytesRead += bytesRead;
+/*
+ * Writes all of data.
+ * @return false on error, message is printed
+ */
+internalfn b8
+InvidiousWrite(struct invidious_context *context, struct tls_connection *connection, struct string *data,
+               string_builder *sb)
+{
+  u64 totalBytesWritten = 0;
+  while (totalBytesWritten < data->length) {
+    struct string remaining = StringFromBuffer(data->value + totalBytesWritten, data->length - totalBytesWritten);
+    s64 bytesWritten = TlsConnectionWrite(connection, &remaining);
+    if (bytesWritten == TLS_CONNECTION_WOULD_BLOCK) {
+      if (!InvidiousWait(context, sb))
+        return 0;
+      continue;
     }
 
-    response = StringFromBuffer(responseBuffer, totalBytesRead);
-  }
-
-  if (response.length == responseBufferMax) {
-    StringBuilderAppendStringLiteral(sb, "Server responded with too large file than we expected");
-    StringBuilderAppendU64(sb, response.length);
-    StringBuilderAppendStringLiteral(sb, "\n");
-    struct string message = StringBuilderFlush(sb);
-    PrintString(&message);
-    return 1;
-  }
-
-  /* Q: Can we feed json parser http chunked encoded json?
-   * A: Yes. But data must not be cut at any token into split.
-   *    Below is ok:
-   *      First data:  { "a": 1,
-   *      Second data: 2, 3 }
-   *    But below is not:
-   *      First data:  { "versi
-   *      Second data: on": "1.0" }
-   */
-  // extract data from http response
-  struct string json;
-  if (httpParser->state & HTTP_PARSER_STATE_HAS_CHUNKED_ENCODED_BODY) {
-    u64 jsonBufferLength = 0;
-    for (u32 httpTokenIndex = 3; httpTokenIndex < httpParser->tokenCount; httpTokenIndex++) {
-      struct http_token *httpToken = httpParser->tokens + httpTokenIndex;
-      if (httpToken->type != HTTP_TOKEN_CHUNK_DATA)
-        continue;
-
-      struct string data = HttpTokenExtractString(httpToken, &response);
-      jsonBufferLength += data.length;
+    if (bytesWritten < 0) {
+      StringBuilderAppendStringLiteral(sb, "TLS write failed.\n  ");
+      StringBuilderAppendTlsConnectionError(sb, connection);
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string message = StringBuilderFlush(sb);
+      PrintString(&message);
+      return 0;
     }
 
-    string_builder *jsonBuilder = MakeStringBuilder(&stackMemory, jsonBufferLength, 0);
-    for (u32 httpTokenIndex = 3; httpTokenIndex < httpParser->tokenCount; httpTokenIndex++) {
-      struct http_token *httpToken = httpParser->tokens + httpTokenIndex;
-      if (httpToken->type != HTTP_TOKEN_CHUNK_DATA)
-        continue;
-      struct string data = HttpTokenExtractString(httpToken, &response);
-      StringBuilderAppendString(jsonBuilder, &data);
-    }
-    json = StringBuilderFlush(jsonBuilder);
-  } else if (httpParser->state & HTTP_PARSER_STATE_HAS_CONTENT_LENGTH_BODY) {
-    struct http_token *lastHttpToken = httpParser->tokens + httpParser->tokenCount - 1;
-    json = HttpTokenExtractString(lastHttpToken, &response);
-  } else {
-    PrintString(&StringFromLiteral("No body found\n"));
-    return 1;
+    totalBytesWritten += (u64)bytesWritten;
   }
 
+  return 1;
+}
+
+/*
+ * Prints type and title of video from /api/v1/videos/:id response.
+ * @param videoId printed before video when not null, to tell videos of batch apart
+ * @param printed what is printed, it is in sb until it is used again
+ * @return false if json is not what is expected, message is printed
+ */
+internalfn b8
+InvidiousPrintVideo(memory_arena *arena, string_builder *sb, struct string *json, struct string *videoId,
+                    struct string *printed)
+{
   // parse data as json
-  struct json_parser *jsonParser = MakeJsonParser(&stackMemory, 4096);
-  if (!JsonParse(jsonParser, &json)) {
+  struct json_parser *jsonParser = MakeJsonParser(arena, 4096);
+  if (!JsonParse(jsonParser, json)) {
     StringBuilderAppendStringLiteral(sb, "Json parser failed.");
     StringBuilderAppendStringLiteral(sb, "\n  error: ");
     StringBuilderAppendU64(sb, (u64)jsonParser->error);
     StringBuilderAppendStringLiteral(sb, "\n");
     struct string message = StringBuilderFlush(sb);
     PrintString(&message);
-    return 1;
+    return 0;
   }
 
   {
@@ -457,74 +671,3088 @@ main(int argc, char *argv[])
       StringBuilderAppendStringLiteral(sb, "\n");
       struct string message = StringBuilderFlush(sb);
       PrintString(&message);
-      return 1;
+      return 0;
     }
 
     // { "error": "message" }
     if (jsonParser->tokenCount == 3) {
-      struct string field = JsonTokenExtractString(jsonParser->tokens + 1, &json);
+      struct string field = JsonTokenExtractString(jsonParser->tokens + 1, json);
       struct string message;
       if (IsStringEqual(&field, &StringFromLiteral("error")))
         message = StringFromLiteral("Got invalid json from server\n");
-      message = JsonTokenExtractString(jsonParser->tokens + 2, &json);
+      message = JsonTokenExtractString(jsonParser->tokens + 2, json);
       PrintString(&message);
-      return 1;
+      return 0;
     }
   }
 
-  {
-    struct string type = StringNull();
-    struct string title = StringNull();
-
-    struct json_cursor cursor = JsonCursor(&json, jsonParser);
-    if (!JsonCursorIsObject(&cursor))
-      return 1; // error invalid json
-    if (!JsonCursorNext(&cursor))
-      return 1; // error invalid json
+  struct string type = StringNull();
+  struct string title = StringNull();
 
-    while (!JsonCursorIsAtEnd(&cursor) && (IsStringNullOrEmpty(&type) || IsStringNullOrEmpty(&title))) {
-      struct string key = JsonCursorExtractString(&cursor);
+  struct json_cursor cursor = JsonCursor(json, jsonParser);
+  if (!JsonCursorIsObject(&cursor))
+    return 0; // error invalid json
+  if (!JsonCursorNext(&cursor))
+    return 0; // error invalid json
 
-      if (IsStringEqual(&key, &StringFromLiteral("type"))) {
-        if (!JsonCursorNext(&cursor))
-          return 1; // error invalid json
-        if (!JsonCursorIsString(&cursor))
-          return 1; // error invalid json
+  while (!JsonCursorIsAtEnd(&cursor) && (IsStringNullOrEmpty(&type) || IsStringNullOrEmpty(&title))) {
+    struct string key = JsonCursorExtractString(&cursor);
 
-        type = JsonCursorExtractString(&cursor);
-        JsonCursorNext(&cursor);
-        continue;
-      }
+    if (IsStringEqual(&key, &StringFromLiteral("type"))) {
+      if (!JsonCursorNext(&cursor))
+        return 0; // error invalid json
+      if (!JsonCursorIsString(&cursor))
+        return 0; // error invalid json
 
-      else if (IsStringEqual(&key, &StringFromLiteral("title"))) {
-        if (!JsonCursorNext(&cursor))
-          return 1; // error invalid json
-        if (!JsonCursorIsString(&cursor))
-          return 1; // error invalid json
+      type = JsonCursorExtractString(&cursor);
+      JsonCursorNext(&cursor);
+      continue;
+    }
 
-        title = JsonCursorExtractString(&cursor);
-        JsonCursorNext(&cursor);
-        continue;
-      }
+    else if (IsStringEqual(&key, &StringFromLiteral("title"))) {
+      if (!JsonCursorNext(&cursor))
+        return 0; // error invalid json
+      if (!JsonCursorIsString(&cursor))
+        return 0; // error invalid json
 
-      if (!JsonCursorNextKey(&cursor))
-        return 1; // error invalid json
+      title = JsonCursorExtractString(&cursor);
+      JsonCursorNext(&cursor);
+      continue;
     }
 
-    if (IsStringNullOrEmpty(&type) || IsStringNullOrEmpty(&title))
-      return 1; // error invalid json
+    if (!JsonCursorNextKey(&cursor))
+      return 0; // error invalid json
+  }
 
-    StringBuilderAppendStringLiteral(sb, "Type: ");
-    StringBuilderAppendString(sb, &type);
+  if (IsStringNullOrEmpty(&type) || IsStringNullOrEmpty(&title))
+    return 0; // error invalid json
+
+  if (videoId) {
+    StringBuilderAppendStringLiteral(sb, "Id: ");
+    StringBuilderAppendString(sb, videoId);
     StringBuilderAppendStringLiteral(sb, "\n");
-    StringBuilderAppendStringLiteral(sb, "Title: ");
-    StringBuilderAppendString(sb, &title);
+  }
+  StringBuilderAppendStringLiteral(sb, "Type: ");
+  StringBuilderAppendString(sb, &type);
+  StringBuilderAppendStringLiteral(sb, "\n");
+  StringBuilderAppendStringLiteral(sb, "Title: ");
+  StringBuilderAppendString(sb, &title);
+  StringBuilderAppendStringLiteral(sb, "\n");
+
+  struct string message = StringBuilderFlush(sb);
+  PrintString(&message);
+  *printed = message;
+  return 1;
+}
+
+enum invidious_fetch_result {
+  INVIDIOUS_FETCH_OK,
+  // instance failed or did not answer in time, videos that are not printed
+  // yet can be fetched from another one
+  INVIDIOUS_FETCH_INSTANCE_FAILED,
+  // instance refused requests because it has too many, videos that are not
+  // printed yet are fetched once it asks to, or from another one
+  INVIDIOUS_FETCH_THROTTLED,
+  // answer is not a video, or request cannot be made
+  INVIDIOUS_FETCH_FAILED,
+};
+
+/*
+ * Prints videos of fetch that are asked for again, from answer of first time.
+ * When order matters, only ones before first video that is not printed yet.
+ */
+internalfn void
+InvidiousPrintWaiting(struct invidious_context *context, string_builder *sb)
+{
+  for (u32 givenIndex = context->givenPrintedCount; givenIndex < context->givenCount; givenIndex++) {
+    struct string *videoId = context->givenIds + givenIndex;
+    struct video_table_entry *entry = 0;
+    if (context->isWaiting[givenIndex])
+      entry = VideoTableFind(&context->videoTable, videoId);
+    b8 isAnswered = entry && entry->state != VIDEO_TABLE_PENDING;
+    if (isAnswered) {
+      // room for answer is set aside while it is waited for
+      debug_assert(entry->state != VIDEO_TABLE_DROPPED);
+      struct string answer = VideoTableEntryAnswer(&context->videoTable, entry);
+      PrintString(&answer);
+      if (entry->state != VIDEO_TABLE_ANSWERED)
+        context->failedCount++;
+      context->isWaiting[givenIndex] = 0;
+      entry->waiterCount--;
+    }
+
+    // in order, video waits for every one before it
+    if (!context->isUnordered) {
+      if (!isAnswered)
+        break;
+      context->givenPrintedCount = givenIndex + 1;
+    }
+  }
+}
+
+/*
+ * Prints video that is answered, and its phases. Answer is kept for videos
+ * that ask for it again, see InvidiousPrintWaiting().
+ * @return false when fetch must stop. In batch answer that is not a video is
+ *         counted as failed, and it stops nothing.
+ */
+internalfn b8
+InvidiousFinishVideo(struct invidious_context *context, memory_arena *arena, string_builder *sb,
+                     struct string *videoId, struct string *json, struct request_timing *timing)
+{
+  // videos asked for again before it go first, it is next one after them
+  if (!context->isUnordered && context->givenCount != 0) {
+    InvidiousPrintWaiting(context, sb);
+    debug_assert(context->givenPrintedCount < context->givenCount &&
+                 !context->isWaiting[context->givenPrintedCount]);
+    context->givenPrintedCount++;
+  }
+
+  RequestTimingMark(timing, REQUEST_TIMING_MARK_PARSING, NowInNanoseconds());
+  memory_temp tempMemory = MemoryTempBegin(arena);
+  struct string printed;
+  b8 isVideoPrinted = InvidiousPrintVideo(tempMemory.arena, sb, json, context->isBatch ? videoId : 0, &printed);
+  MemoryTempEnd(&tempMemory);
+  if (!isVideoPrinted) {
+    if (!context->isBatch)
+      return 0;
+
+    StringBuilderAppendStringLiteral(sb, "Answer is not a video.");
+    StringBuilderAppendStringLiteral(sb, "\n  Video id: ");
+    StringBuilderAppendString(sb, videoId);
     StringBuilderAppendStringLiteral(sb, "\n");
+    printed = StringBuilderFlush(sb);
+    PrintString(&printed);
+    context->failedCount++;
+  }
 
-    struct string message = StringBuilderFlush(sb);
-    PrintString(&message);
+  struct video_table_entry *entry = VideoTableFind(&context->videoTable, videoId);
+  if (entry && entry->state == VIDEO_TABLE_PENDING)
+    VideoTableAnswer(&context->videoTable, entry, &printed, !isVideoPrinted);
+
+  if (isVideoPrinted) {
+    RequestTimingMark(timing, REQUEST_TIMING_MARK_PARSED, NowInNanoseconds());
+    InvidiousTimingReport(context, sb, videoId, timing);
   }
 
+  if (entry && entry->waiterCount != 0)
+    InvidiousPrintWaiting(context, sb);
+  return 1;
+}
+
+/*
+ * Videos of fetch that are requested. Batch adds more while they are fetched,
+ * see InvidiousBatchTake().
+ */
+struct invidious_videos {
+  struct string *ids;
+  // set for every video printed
+  b8 *isPrinted;
+  u32 count;
+  // ids and isPrinted have room for this many, and as many can be given
+  u32 max;
+};
+
+/*
+ * Adds video to fetch. Video that is given again, or was answered earlier in
+ * run, waits for its answer and is not requested again, unless its answer is
+ * dropped or there is no room to keep it.
+ */
+internalfn void
+InvidiousGive(struct invidious_context *context, struct invidious_videos *videos, struct string *videoId)
+{
+  debug_assert(context->givenCount < videos->max);
+  u32 givenIndex = context->givenCount;
+  context->givenIds[givenIndex] = *videoId;
+  context->givenCount++;
+  struct video_table_entry *entry = VideoTableFind(&context->videoTable, videoId);
+  b8 isWaiting = entry && VideoTableWait(&context->videoTable, entry);
+  context->isWaiting[givenIndex] = isWaiting;
+  if (isWaiting)
+    return;
+
+  // table that is full leaves video to be requested every time
+  if (!entry)
+    VideoTableInsert(&context->videoTable, videoId);
+  videos->ids[videos->count] = *videoId;
+  videos->isPrinted[videos->count] = 0;
+  videos->count++;
+}
+
+enum {
+  INVIDIOUS_VIDEO_ID_LENGTH = 11,
+  // of batch given to one fetch, every one is printed before more are read
+  INVIDIOUS_BATCH_VIDEO_MAX = 1 << 14,
+};
+
+/*
+ * Batch file that is read while its videos are fetched, see
+ * InvidiousFetchBatch().
+ */
+struct invidious_batch {
+  s32 file;
+  // zero terminated, "-" is standard input
+  struct string path;
+  struct batch_reader reader;
+  // ids are copied out of reader, its buffer moves. Video given at index i is
+  // at i * INVIDIOUS_VIDEO_ID_LENGTH.
+  u8 *videoIdBuffer;
+  // every line is read, or reading failed
+  b8 isEnded;
+  b8 isFailed;
+};
+
+/*
+ * @return true when batch can give more videos to fetch
+ */
+internalfn b8
+IsInvidiousBatchOpen(struct invidious_context *context, struct invidious_videos *videos)
+{
+  struct invidious_batch *batch = context->batch;
+  return batch && !batch->isEnded && context->givenCount < videos->max;
+}
+
+/*
+ * Gives videos of lines that are read, without waiting for file unless told
+ * to. Lines that are not video ids are counted as failed.
+ * @param isWaited waits until some video is given or file ends, when fetch has
+ *        nothing else to do
+ * @return videos given
+ */
+internalfn u32
+InvidiousBatchTake(struct invidious_context *context, string_builder *sb, struct invidious_videos *videos,
+                   b8 isWaited)
+{
+  struct invidious_batch *batch = context->batch;
+  struct batch_reader *reader = &batch->reader;
+  u32 givenCount = context->givenCount;
+  while (IsInvidiousBatchOpen(context, videos)) {
+    struct string line;
+    enum batch_reader_result readerResult = BatchReaderNext(reader, &line);
+    if (readerResult == BATCH_READER_LINE) {
+      struct string videoId = OptionsVideoIdFromArgument(&line);
+      if (IsStringNull(&videoId)) {
+        StringBuilderAppendStringLiteral(sb, "Video id is invalid.");
+        StringBuilderAppendStringLiteral(sb, "\n  Line: ");
+        StringBuilderAppendU64(sb, reader->lineNumber);
+        StringBuilderAppendStringLiteral(sb, "\n  Video id: ");
+        StringBuilderAppendString(sb, &line);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string message = StringBuilderFlush(sb);
+        PrintString(&message);
+        context->failedCount++;
+        continue;
+      }
+
+      u8 *value = batch->videoIdBuffer + context->givenCount * INVIDIOUS_VIDEO_ID_LENGTH;
+      MemoryCopy(value, videoId.value, INVIDIOUS_VIDEO_ID_LENGTH);
+      videoId = StringFromBuffer(value, INVIDIOUS_VIDEO_ID_LENGTH);
+      InvidiousGive(context, videos, &videoId);
+    }
+
+    else if (readerResult == BATCH_READER_TOO_LONG) {
+      StringBuilderAppendStringLiteral(sb, "Line is too long.");
+      StringBuilderAppendStringLiteral(sb, "\n  Line: ");
+      StringBuilderAppendU64(sb, reader->lineNumber);
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string message = StringBuilderFlush(sb);
+      PrintString(&message);
+      context->failedCount++;
+    }
+
+    else if (readerResult == BATCH_READER_END) {
+      batch->isEnded = 1;
+    }
+
+    else if (readerResult == BATCH_READER_MORE) {
+      // file that is still being written is not waited for while requests are in flight
+      if ((!isWaited || context->givenCount != givenCount) && !PlatformFileIsReadable(batch->file))
+        break;
+
+      struct string space = BatchReaderSpace(reader);
+      s64 bytesRead = PlatformFileRead(batch->file, &space);
+      if (bytesRead == -1) {
+        StringBuilderAppendStringLiteral(sb, "Reading batch file failed.");
+        StringBuilderAppendStringLiteral(sb, "\n  Path: ");
+        StringBuilderAppendString(sb, &batch->path);
+        StringBuilderAppendStringLiteral(sb, "\n  error: ");
+        StringBuilderAppendPlatformError(sb);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string message = StringBuilderFlush(sb);
+        PrintString(&message);
+        batch->isFailed = 1;
+        batch->isEnded = 1;
+        break;
+      }
+      BatchReaderAppend(reader, (u64)bytesRead);
+    }
+  }
+
+  // given again, answered earlier in run
+  if (context->givenCount != givenCount)
+    InvidiousPrintWaiting(context, sb);
+  return context->givenCount - givenCount;
+}
+
+enum {
+  // seconds, when instance refuses without saying how long to wait
+  INVIDIOUS_RETRY_AFTER_DEFAULT = 1,
+};
+
+// instance that asks to wait longer is left for another one
+comptime u64 INVIDIOUS_THROTTLE_WAIT_MAX = 60ULL * 1000000000 /* 1e9 */;
+
+/*
+ * Takes status of response for concurrency limit of instance. Instance that
+ * refuses requests is not sent more until time it asks for.
+ * @param retryAfter seconds, see "Retry-After"
+ * @param latency nanoseconds, 0 when it is not measured
+ * @param now see NowInNanoseconds()
+ * @return true when instance refused request, message is printed
+ */
+internalfn b8
+InvidiousRecordResponse(struct invidious_instance *instance, string_builder *sb, u16 statusCode, u64 retryAfter,
+                        u64 latency, u64 now)
+{
+  // https://www.rfc-editor.org/rfc/rfc6585#section-4 "429 Too Many Requests"
+  // https://www.rfc-editor.org/rfc/rfc9110#section-15.6.4 "503 Service Unavailable"
+  if (statusCode == 429 || statusCode == 503) {
+    ConcurrencyLimitThrottle(&instance->limit, now);
+    if (retryAfter > INSTANCE_DOWN_DURATION_MAX)
+      retryAfter = INSTANCE_DOWN_DURATION_MAX;
+    u64 until = now + retryAfter * 1000000000 /* 1e9 */;
+    if (instance->throttledUntil < until)
+      instance->throttledUntil = until;
+
+    StringBuilderAppendStringLiteral(sb, "Instance is throttling requests.");
+    StringBuilderAppendStringLiteral(sb, "\n  Instance: ");
+    StringBuilderAppendString(sb, &instance->state->hostname);
+    StringBuilderAppendStringLiteral(sb, "\n  Retry after: ");
+    StringBuilderAppendU64(sb, retryAfter);
+    StringBuilderAppendStringLiteral(sb, " s\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return 1;
+  }
+
+  // proxy in front of instance gave up on it, it is overloaded
+  if (statusCode == 502 || statusCode == 504) {
+    ConcurrencyLimitThrottle(&instance->limit, now);
+    return 0;
+  }
+
+  if (latency != 0)
+    ConcurrencyLimitRecord(&instance->limit, latency, now);
+  return 0;
+}
+
+/*
+ * Waits until instance that context points to takes requests again.
+ */
+internalfn void
+InvidiousThrottleWait(struct invidious_context *context)
+{
+  u64 now = NowInNanoseconds();
+  if (context->instance->throttledUntil > now)
+    PlatformSleep(context->instance->throttledUntil - now);
+  // instance is not late, it is asked to wait
+  context->activeAt = NowInNanoseconds();
+}
+
+internalfn u32
+InvidiousHttp2InFlightCount(struct http2_stream **streams, u32 streamCount)
+{
+  u32 inFlightCount = 0;
+  for (u32 streamIndex = 0; streamIndex < streamCount; streamIndex++) {
+    if (streams[streamIndex] && streams[streamIndex]->state != HTTP2_STREAM_STATE_CLOSED)
+      inFlightCount++;
+  }
+  return inFlightCount;
+}
+
+/*
+ * @return seconds to wait that response of stream asks for
+ */
+internalfn u64
+InvidiousHttp2RetryAfter(struct http2_stream *stream)
+{
+  struct string *retryAfter = 0;
+  struct string *date = 0;
+  for (u32 headerIndex = 0; headerIndex < stream->headerCount; headerIndex++) {
+    struct http_header *header = stream->headers + headerIndex;
+    // names are lowercase in HTTP/2
+    if (IsStringEqual(&header->name, &StringFromLiteral("retry-after")))
+      retryAfter = &header->value;
+    else if (IsStringEqual(&header->name, &StringFromLiteral("date")))
+      date = &header->value;
+  }
+
+  u64 seconds = INVIDIOUS_RETRY_AFTER_DEFAULT;
+  if (retryAfter)
+    HttpParseRetryAfter(retryAfter, date, &seconds);
+  return seconds;
+}
+
+/*
+ * Fetches every video on one HTTP/2 connection. Requests are sent on
+ * concurrent streams as many as server allows, responses can complete in any
+ * order but videos are printed in order they are given, unless context says
+ * order does not matter. Videos batch gives meanwhile go out on streams that
+ * free up.
+ * @param videos isPrinted is set for every video printed
+ * @return message is printed on error
+ */
+internalfn enum invidious_fetch_result
+InvidiousFetchHttp2(struct invidious_context *context, struct tls_connection *tlsConnection, memory_arena *arena,
+                    string_builder *sb, struct invidious_videos *videos)
+{
+  enum {
+    KILOBYTES = (1 << 10),
+    STREAM_MAX = INVIDIOUS_HTTP2_STREAM_MAX,
+    // must hold at least one frame
+    RECEIVE_RING_LENGTH = 64 * KILOBYTES,
+  };
+
+  struct http2_connection *connection = MakeHttp2Connection(arena, STREAM_MAX, 32);
+  Http2Start(connection);
+
+  // every stream has its own buffer until its video is printed, it grows to
+  // fit response and pages past minimum are given back after it
+  struct receive_buffer *streamBuffers = context->http2StreamBuffers;
+  struct http2_stream *streams[STREAM_MAX];
+  u32 streamVideoIndexes[STREAM_MAX];
+  struct request_timing streamTimings[STREAM_MAX];
+  // refused by instance, sent again before others
+  u32 retryIndexes[STREAM_MAX];
+  u32 retryCount = 0;
+  b8 isBuffersReady = 1;
+  for (u32 bufferIndex = 0; bufferIndex < STREAM_MAX; bufferIndex++) {
+    struct receive_buffer *streamBuffer = streamBuffers + bufferIndex;
+    if (streamBuffer->reserved == 0 && !ReceiveBufferInit(streamBuffer, INVIDIOUS_RESPONSE_RESERVED))
+      isBuffersReady = 0;
+    streams[bufferIndex] = 0;
+  }
+
+  // frame that wraps around end of ring is still one piece, so what is left
+  // after complete frames is never moved
+  struct ring_buffer *ring = &context->http2Ring;
+  if (!isBuffersReady || (!ring->value && !RingBufferInit(ring, RECEIVE_RING_LENGTH))) {
+    StringBuilderAppendStringLiteral(sb, "Not enough memory for responses.");
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return INVIDIOUS_FETCH_FAILED;
+  }
+  // left by connection that failed
+  ring->start = 0;
+  ring->length = 0;
+
+  u32 streamMax = STREAM_MAX;
+  if (context->requestMax != 0 && context->requestMax < streamMax)
+    streamMax = context->requestMax;
+
+  struct string *videoIds = videos->ids;
+  u32 sentCount = 0;
+  u32 printedCount = 0;
+  while (printedCount < videos->count || IsInvidiousBatchOpen(context, videos)) {
+    // every video is printed, nothing comes before batch gives more
+    if (printedCount == videos->count) {
+      InvidiousBatchTake(context, sb, videos, 1);
+      continue;
+    }
+
+    // server limits concurrent streams in its settings, so wait for them
+    while (connection->isPeerSettingsReceived && (sentCount < videos->count || retryCount != 0)) {
+      // instance takes only so many at once, none while it asked to wait
+      if (InvidiousHttp2InFlightCount(streams, STREAM_MAX) >= ConcurrencyLimitGet(&context->instance->limit) ||
+          context->instance->throttledUntil > NowInNanoseconds())
+        break;
+
+      u32 bufferIndex = 0;
+      while (bufferIndex < streamMax && streams[bufferIndex])
+        bufferIndex++;
+      if (bufferIndex == streamMax)
+        break;
+
+      u32 videoIndex = retryCount != 0 ? retryIndexes[0] : sentCount;
+      memory_temp tempMemory = MemoryTempBegin(arena);
+      string_builder *pathBuilder = MakeStringBuilder(tempMemory.arena, 64, 0);
+      StringBuilderAppendStringLiteral(pathBuilder, "/api/v1/videos/");
+      StringBuilderAppendString(pathBuilder, videoIds + videoIndex);
+      struct http_request_info requestInfo = {
+          .method = HTTP_METHOD_GET,
+          .version = HTTP_VERSION_20,
+          .host = context->instance->state->hostname,
+          .path = StringBuilderFlush(pathBuilder),
+          .accept = HTTP_CONTENT_TYPE_JSON,
+      };
+      struct http2_stream *stream =
+          Http2Request(connection, &requestInfo, tempMemory.arena, streamBuffers + bufferIndex);
+      MemoryTempEnd(&tempMemory);
+      if (!stream)
+        break;
+
+      streams[bufferIndex] = stream;
+      streamVideoIndexes[bufferIndex] = videoIndex;
+      streamTimings[bufferIndex] = context->fetchTiming;
+      if (retryCount != 0) {
+        retryCount--;
+        MemoryMove(retryIndexes, retryIndexes + 1, sizeof(*retryIndexes) * retryCount);
+      } else {
+        sentCount++;
+      }
+    }
+
+    struct string output = Http2Flush(connection);
+    if (output.length != 0) {
+      if (!InvidiousWrite(context, tlsConnection, &output, sb))
+        return INVIDIOUS_FETCH_INSTANCE_FAILED;
+      // requests of new streams went out in it
+      u64 now = NowInNanoseconds();
+      for (u32 bufferIndex = 0; bufferIndex < STREAM_MAX; bufferIndex++) {
+        if (streams[bufferIndex])
+          RequestTimingMark(streamTimings + bufferIndex, REQUEST_TIMING_MARK_SENT, now);
+      }
+    }
+
+    if (connection->error != HTTP2_ERROR_NONE) {
+      StringBuilderAppendStringLiteral(sb, "HTTP/2 connection failed.");
+      StringBuilderAppendStringLiteral(sb, "\n  error: ");
+      StringBuilderAppendHttp2Error(sb, connection->error);
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string message = StringBuilderFlush(sb);
+      PrintString(&message);
+      return INVIDIOUS_FETCH_INSTANCE_FAILED;
+    }
+
+    // refused requests wait for instance, nothing else is coming
+    if (InvidiousHttp2InFlightCount(streams, STREAM_MAX) == 0 &&
+        context->instance->throttledUntil > NowInNanoseconds()) {
+      InvidiousThrottleWait(context);
+      continue;
+    }
+
+    struct string space = RingBufferSpace(ring);
+    s64 ret = TlsConnectionRead(tlsConnection, space.value, space.length);
+    if (ret == TLS_CONNECTION_WOULD_BLOCK) {
+      if (!InvidiousWait(context, sb))
+        return INVIDIOUS_FETCH_INSTANCE_FAILED;
+      continue;
+    }
+
+    if (ret < 0) {
+      StringBuilderAppendStringLiteral(sb, "TLS read failed.\n  ");
+      StringBuilderAppendTlsConnectionError(sb, tlsConnection);
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string message = StringBuilderFlush(sb);
+      PrintString(&message);
+      return INVIDIOUS_FETCH_INSTANCE_FAILED;
+    }
+
+    u64 bytesRead = (u64)ret;
+    if (bytesRead == 0) {
+      StringBuilderAppendStringLiteral(sb, "Server closed connection without answering.");
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string message = StringBuilderFlush(sb);
+      PrintString(&message);
+      return INVIDIOUS_FETCH_INSTANCE_FAILED;
+    }
+    ring->length += bytesRead;
+
+    // connection consumes complete frames only
+    struct string packet = RingBufferData(ring);
+    b8 ok = Http2Receive(connection, &packet);
+    RingBufferConsume(ring, connection->position);
+    connection->position = 0;
+    if (!ok) {
+      // let server know why, GOAWAY is in output
+      output = Http2Flush(connection);
+      InvidiousWrite(context, tlsConnection, &output, sb);
+      continue;
+    }
+
+    u64 receivedAt = NowInNanoseconds();
+    for (u32 bufferIndex = 0; bufferIndex < STREAM_MAX; bufferIndex++) {
+      struct http2_stream *stream = streams[bufferIndex];
+      if (stream && stream->isHeadersReceived)
+        RequestTimingMark(streamTimings + bufferIndex, REQUEST_TIMING_MARK_FIRST_BYTE, receivedAt);
+      if (!stream || stream->state != HTTP2_STREAM_STATE_CLOSED ||
+          streamTimings[bufferIndex].marks[REQUEST_TIMING_MARK_RECEIVED] != 0)
+        continue;
+
+      RequestTimingMark(streamTimings + bufferIndex, REQUEST_TIMING_MARK_RECEIVED, receivedAt);
+      u64 latency = RequestTimingPhase(streamTimings + bufferIndex, REQUEST_TIMING_PHASE_TTFB);
+      if (stream->error == HTTP2_ERROR_NONE &&
+          InvidiousRecordResponse(context->instance, sb, stream->statusCode, InvidiousHttp2RetryAfter(stream),
+                                  latency, receivedAt)) {
+        if (context->instance->throttledUntil > receivedAt + INVIDIOUS_THROTTLE_WAIT_MAX)
+          return INVIDIOUS_FETCH_THROTTLED;
+
+        // sent again once instance asks to
+        debug_assert(retryCount < STREAM_MAX);
+        retryIndexes[retryCount] = streamVideoIndexes[bufferIndex];
+        retryCount++;
+        Http2StreamRelease(stream);
+        streams[bufferIndex] = 0;
+      } else if (stream->error == HTTP2_ERROR_NONE) {
+        RequestTimingHistogramAdd(&context->instance->timingHistogram, streamTimings + bufferIndex);
+      }
+    }
+
+    // print in order, later videos wait for earlier ones
+    b8 isAnyPrinted = 1;
+    while (isAnyPrinted && printedCount < videos->count) {
+      isAnyPrinted = 0;
+      for (u32 bufferIndex = 0; bufferIndex < STREAM_MAX; bufferIndex++) {
+        struct http2_stream *stream = streams[bufferIndex];
+        if (!stream || stream->state != HTTP2_STREAM_STATE_CLOSED ||
+            (!context->isUnordered && streamVideoIndexes[bufferIndex] != printedCount))
+          continue;
+
+        u32 videoIndex = streamVideoIndexes[bufferIndex];
+        if (stream->error != HTTP2_ERROR_NONE) {
+          StringBuilderAppendStringLiteral(sb, "HTTP/2 stream failed.");
+          StringBuilderAppendStringLiteral(sb, "\n  Video id: ");
+          StringBuilderAppendString(sb, videoIds + videoIndex);
+          StringBuilderAppendStringLiteral(sb, "\n  error: ");
+          StringBuilderAppendHttp2Error(sb, stream->error);
+          StringBuilderAppendStringLiteral(sb, "\n");
+          struct string message = StringBuilderFlush(sb);
+          PrintString(&message);
+          return INVIDIOUS_FETCH_INSTANCE_FAILED;
+        }
+
+        struct string json = Http2StreamBody(stream);
+        if (!InvidiousFinishVideo(context, arena, sb, videoIds + videoIndex, &json, streamTimings + bufferIndex))
+          return INVIDIOUS_FETCH_FAILED;
+
+        Http2StreamRelease(stream);
+        streams[bufferIndex] = 0;
+        // large response is printed, its pages are given back
+        streamBuffers[bufferIndex].length = 0;
+        ReceiveBufferTrim(streamBuffers + bufferIndex);
+        videos->isPrinted[videoIndex] = 1;
+        printedCount++;
+        isAnyPrinted = 1;
+        break;
+      }
+    }
+
+    // videos batch gave meanwhile are sent on streams that are freed
+    if (IsInvidiousBatchOpen(context, videos))
+      InvidiousBatchTake(context, sb, videos, 0);
+  }
+
+  return INVIDIOUS_FETCH_OK;
+}
+
+/*
+ * HTTP/1.1 connection of InvidiousFetchHttp11(). Video at index i is fetched
+ * on connection i % connectionCount, requests are pipelined.
+ */
+struct invidious_http11_connection {
+  // 0 when every request of connection is answered
+  struct pooled_connection *pooled;
+  struct tls_connection *tls;
+  u32 connectionIndex;
+
+  // every connectionCount'th video id starting from connectionIndex
+  struct string *videoIds;
+  struct http_pipeline pipeline;
+
+  // batch of requests that is being written
+  struct string *requestBuffer;
+  struct string request;
+  u64 requestBytesWritten;
+
+  // grows to fit response, pages past what is left are given back after it
+  struct receive_buffer response;
+  // server refused request, it is sent again with ones after it
+  b8 isRefused;
+  // streaming parser retires chunk tokens, so chunk data is collected as it arrives
+  struct http_parser *httpParser;
+  struct receive_buffer body;
+};
+
+/*
+ * Duplicate of request that is late, sent on its own connection to another
+ * instance, see src/hedge.c. It speaks only HTTP/1.1, instance that picks
+ * HTTP/2 is not sent duplicates.
+ */
+struct invidious_hedge {
+  // 0 when no duplicate is in flight
+  struct pooled_connection *pooled;
+  struct invidious_instance *instance;
+  u32 videoIndex;
+  struct request_timing timing;
+
+  struct string *requestBuffer;
+  struct string request;
+  u64 requestBytesWritten;
+
+  struct receive_buffer response;
+  struct http_parser *httpParser;
+  struct receive_buffer body;
+};
+
+enum {
+  // duplicates in flight at once
+  INVIDIOUS_HEDGE_MAX = 4,
+  // duplicates of every hundred requests sent, see HedgeBudgetTake()
+  INVIDIOUS_HEDGE_PERCENT = 5,
+};
+
+struct invidious_http11 {
+  struct invidious_context *context;
+  memory_arena *arena;
+  string_builder *sb;
+  struct http_request_template *requestTemplate;
+
+  struct invidious_http11_connection *connections;
+  u32 connectionCount;
+  // requests in flight on every connection
+  u32 depthMax;
+  // connection did not send because instance takes no more at once
+  b8 isLimited;
+  // instance asked to wait longer than INVIDIOUS_THROTTLE_WAIT_MAX
+  b8 isThrottled;
+
+  // batch adds more while they are fetched, see InvidiousHttp11Add()
+  struct invidious_videos *videos;
+  // videos before it are printed
+  u32 printedCount;
+  // responses wait here until videos before them are printed. Only videos
+  // between printedCount and printedCount + windowLength are requested, so
+  // video at index i has slot i % windowLength.
+  u32 windowLength;
+  struct string *bodies;
+  struct receive_buffer *bodyBuffers;
+  struct request_timing *timings;
+  // request of video is sent again, by slot
+  b8 *isHedged;
+
+  // late requests sent again, none when hedging is off
+  struct invidious_hedge hedges[INVIDIOUS_HEDGE_MAX];
+  u32 hedgeCount;
+  // host of every instance, made on first duplicate sent to it
+  struct http_request_template *hedgeTemplates[INSTANCE_MAX];
+};
+
+enum {
+  INVIDIOUS_HTTP11_CONNECTION_MAX = 8,
+  INVIDIOUS_HTTP11_PIPELINE_DEPTH_MAX = 16,
+};
+
+/*
+ * @return timing of request of connection, it is kept in slot of its video
+ */
+internalfn struct request_timing *
+InvidiousHttp11Timing(struct invidious_http11 *fetch, struct invidious_http11_connection *connection,
+                      u32 requestIndex)
+{
+  u32 videoIndex = connection->connectionIndex + requestIndex * fetch->connectionCount;
+  return fetch->timings + videoIndex % fetch->windowLength;
+}
+
+/*
+ * Puts body of response in slot of its video.
+ * @param received response, body is its last token when it has content length
+ * @param body chunks collected as they arrived, it gets empty buffer of slot
+ * @return false on error, message is printed
+ */
+internalfn b8
+InvidiousHttp11Store(struct invidious_http11 *fetch, u32 videoIndex, struct http_parser *httpParser,
+                     struct string *received, struct receive_buffer *body)
+{
+  u32 slotIndex = videoIndex % fetch->windowLength;
+  struct receive_buffer *slot = fetch->bodyBuffers + slotIndex;
+  debug_assert(slot->length == 0);
+  if ((httpParser->state & HTTP_PARSER_STATE_HAS_CHUNKED_ENCODED_BODY) && body->length != 0) {
+    // collected body is handed over as is, slot's empty buffer collects next one
+    struct receive_buffer empty = *slot;
+    *slot = *body;
+    *body = empty;
+  } else if (httpParser->state & HTTP_PARSER_STATE_HAS_CONTENT_LENGTH_BODY) {
+    // next responses follow it in same buffer
+    struct http_token *lastHttpToken = httpParser->tokens + httpParser->tokenCount - 1;
+    struct string json = HttpTokenExtractString(lastHttpToken, received);
+    if (!ReceiveBufferAppend(slot, &json)) {
+      PrintString(&StringFromLiteral("Not enough memory for responses.\n"));
+      return 0;
+    }
+  } else {
+    PrintString(&StringFromLiteral("No body found\n"));
+    return 0;
+  }
+  fetch->bodies[slotIndex] = StringFromBuffer(slot->value, slot->length);
+  return 1;
+}
+
+/*
+ * @return true when video has answer, from request sent again to another
+ *         instance that came first
+ */
+internalfn b8
+IsInvidiousHttp11Answered(struct invidious_http11 *fetch, u32 videoIndex)
+{
+  // window may have moved past printed video, its slot is of another one
+  return fetch->videos->isPrinted[videoIndex] || !IsStringNull(fetch->bodies + videoIndex % fetch->windowLength);
+}
+
+/*
+ * Parses responses in connection buffer, bodies of completed ones are put in
+ * their slots.
+ * @param isConnectionOpen cleared when server wants connection closed
+ * @return false on error, message is printed
+ */
+internalfn b8
+InvidiousHttp11Receive(struct invidious_http11 *fetch, struct invidious_http11_connection *connection,
+                       b8 *isConnectionOpen)
+{
+  string_builder *sb = fetch->sb;
+  struct http_parser *httpParser = connection->httpParser;
+  struct http_pipeline *pipeline = &connection->pipeline;
+  u64 now = NowInNanoseconds();
+
+  struct receive_buffer *response = &connection->response;
+  // One read can complete many responses
+  while (response->length != 0) {
+    // bytes left after previous response are start of next one
+    if (HttpPipelineInFlightCount(pipeline) != 0)
+      RequestTimingMark(InvidiousHttp11Timing(fetch, connection, pipeline->completedCount),
+                        REQUEST_TIMING_MARK_FIRST_BYTE, now);
+
+    b8 ok;
+    struct string received = StringFromBuffer(response->value, response->length);
+    do {
+      // parser does not consume incomplete lines, so start from where it left
+      struct string packet =
+          StringFromBuffer(response->value + httpParser->position, response->length - httpParser->position);
+      ok = HttpParse(httpParser, &packet);
+
+      for (u32 httpTokenIndex = httpParser->headerTokenCount; httpTokenIndex < httpParser->tokenCount;
+           httpTokenIndex++) {
+        struct http_token *httpToken = httpParser->tokens + httpTokenIndex;
+        if (httpToken->type != HTTP_TOKEN_CHUNK_DATA || httpToken->end == 0)
+          continue;
+
+        struct string data = HttpTokenExtractString(httpToken, &received);
+        if (!ReceiveBufferAppend(&connection->body, &data)) {
+          PrintString(&StringFromLiteral("Server responded with too large file than we expected\n"));
+          return 0;
+        }
+      }
+    } while (httpParser->error == HTTP_PARSER_ERROR_PAUSED);
+
+    if (!ok) {
+      if (httpParser->error == HTTP_PARSER_ERROR_PARTIAL) {
+        // body is read in place, buffer grows once when its length is known
+        u64 responseLength = HttpParserResponseLength(httpParser);
+        if (!ReceiveBufferGrow(response, responseLength)) {
+          StringBuilderAppendStringLiteral(sb, "Server responded with too large file than we expected");
+          StringBuilderAppendU64(sb, responseLength);
+          StringBuilderAppendStringLiteral(sb, "\n");
+          struct string message = StringBuilderFlush(sb);
+          PrintString(&message);
+          return 0;
+        }
+        break; // wait for more data
+      }
+
+      StringBuilderAppendStringLiteral(sb, "Http parser failed.");
+      StringBuilderAppendStringLiteral(sb, "\n     error: ");
+      StringBuilderAppendHttpParserError(sb, httpParser->error);
+      StringBuilderAppendStringLiteral(sb, "\n  position: ");
+      StringBuilderAppendU64(sb, httpParser->position);
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string message = StringBuilderFlush(sb);
+      PrintString(&message);
+      return 0;
+    }
+
+    struct request_timing *timing = InvidiousHttp11Timing(fetch, connection, pipeline->completedCount);
+    u64 retryAfter = INVIDIOUS_RETRY_AFTER_DEFAULT;
+    if (httpParser->state & HTTP_PARSER_STATE_HAS_RETRY_AFTER)
+      retryAfter = httpParser->retryAfter;
+    if (InvidiousRecordResponse(fetch->context->instance, sb, httpParser->statusCode, retryAfter,
+                                RequestTimingPhase(timing, REQUEST_TIMING_PHASE_TTFB), now)) {
+      if (fetch->context->instance->throttledUntil > now + INVIDIOUS_THROTTLE_WAIT_MAX) {
+        fetch->isThrottled = 1;
+        return 0;
+      }
+
+      // responses after it are dropped with connection
+      connection->isRefused = 1;
+      *isConnectionOpen = 0;
+      break;
+    }
+
+    u32 requestIndex = HttpPipelineComplete(pipeline);
+    u32 videoIndex = connection->connectionIndex + requestIndex * fetch->connectionCount;
+    if (IsInvidiousHttp11Answered(fetch, videoIndex)) {
+      // duplicate came first, see InvidiousHttp11Hedge()
+      connection->body.length = 0;
+    } else {
+      // body is kept until video is printed
+      RequestTimingMark(timing, REQUEST_TIMING_MARK_RECEIVED, now);
+      RequestTimingHistogramAdd(&fetch->context->instance->timingHistogram, timing);
+      if (!InvidiousHttp11Store(fetch, videoIndex, httpParser, &received, &connection->body))
+        return 0;
+    }
+
+    if (httpParser->state & HTTP_PARSER_STATE_CONNECTION_CLOSE)
+      *isConnectionOpen = 0;
+
+    // Drop parsed response, next one starts from beginning of buffer
+    ReceiveBufferConsume(response, httpParser->position);
+    ReceiveBufferTrim(response);
+    HttpParserNext(httpParser);
+    httpParser->position = 0;
+
+    if (!*isConnectionOpen)
+      break;
+  }
+
+  return 1;
+}
+
+/*
+ * @return requests in flight on every connection
+ */
+internalfn u32
+InvidiousHttp11InFlightCount(struct invidious_http11 *fetch)
+{
+  u32 inFlightCount = 0;
+  for (u32 connectionIndex = 0; connectionIndex < fetch->connectionCount; connectionIndex++)
+    inFlightCount += HttpPipelineInFlightCount(&fetch->connections[connectionIndex].pipeline);
+  return inFlightCount;
+}
+
+/*
+ * Takes connection from pool for requests of connection.
+ * @return false on error, message is printed
+ */
+internalfn b8
+InvidiousHttp11Acquire(struct invidious_http11 *fetch, struct invidious_http11_connection *connection)
+{
+  struct invidious_context *context = fetch->context;
+  connection->pooled = InvidiousAcquire(context, context->instance, connection);
+  if (!connection->pooled) {
+    StringBuilderAppendStringLiteral(fetch->sb, "Too many connections to server.\n");
+    struct string message = StringBuilderFlush(fetch->sb);
+    PrintString(&message);
+    return 0;
+  }
+  connection->tls = &connection->pooled->tls;
+  return 1;
+}
+
+/*
+ * Replaces closed connection with next one from pool, requests in flight on
+ * it are sent again there. None is taken when every request is answered.
+ * @param isClosedByClient client closed it, e.g. after server refused request
+ * @return false on error, message is printed
+ */
+internalfn b8
+InvidiousHttp11Reconnect(struct invidious_http11 *fetch, struct invidious_http11_connection *connection,
+                         b8 isClosedByClient)
+{
+  string_builder *sb = fetch->sb;
+  struct http_pipeline *pipeline = &connection->pipeline;
+  if (isClosedByClient) {
+    HttpPipelineResend(pipeline);
+  } else if (!HttpPipelineClose(pipeline)) {
+    StringBuilderAppendStringLiteral(sb, "Server closed connection without answering.");
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return 0;
+  }
+
+  connection->request.length = 0;
+  connection->requestBytesWritten = 0;
+  connection->response.length = 0;
+  ReceiveBufferTrim(&connection->response);
+  HttpParserNext(connection->httpParser);
+  connection->httpParser->position = 0;
+  connection->body.length = 0;
+  ReceiveBufferTrim(&connection->body);
+
+  struct invidious_context *context = fetch->context;
+  ConnectionPoolRelease(&context->pool, connection->pooled, 0, NowInNanoseconds());
+  connection->pooled = 0;
+  connection->tls = 0;
+  if (HttpPipelineIsDone(pipeline))
+    return 1;
+
+  return InvidiousHttp11Acquire(fetch, connection);
+}
+
+/*
+ * Moves connection forward as far as it goes without blocking: handshake,
+ * writing next batch of requests and reading responses.
+ * @return false on error, message is printed
+ */
+internalfn b8
+InvidiousHttp11Advance(struct invidious_http11 *fetch, struct invidious_http11_connection *connection)
+{
+  string_builder *sb = fetch->sb;
+  struct tls_connection *tls = connection->tls;
+
+  ConnectionPoolHandshake(connection->pooled, NowInNanoseconds());
+
+  if (tls->state == TLS_CONNECTION_STATE_FAILED) {
+    StringBuilderAppendStringLiteral(sb, "Connecting to server failed.\n  ");
+    StringBuilderAppendTlsConnectionError(sb, tls);
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return 0;
+  }
+
+  if (tls->state != TLS_CONNECTION_STATE_OPEN)
+    return 1;
+
+  struct http_pipeline *pipeline = &connection->pipeline;
+  b8 isConnectionOpen = 1;
+  b8 isBatchAnswered;
+  do {
+    // Send next batch when every request in flight is answered and its
+    // videos have slots. Batch is never deeper than depthMax.
+    b8 isRequestWritten = connection->requestBytesWritten == connection->request.length;
+    if (isRequestWritten && HttpPipelineInFlightCount(pipeline) == 0 && !HttpPipelineIsDone(pipeline)) {
+      // connection is idle and its session ticket came before first response.
+      // Kernel without TLS module or library without keys refuses every time.
+      if (fetch->context->isKernelTls && pipeline->connectionCompletedCount != 0 && !TlsConnectionKernelTls(tls) &&
+          errno != EBUSY)
+        fetch->context->isKernelTls = 0;
+      u32 lastRequestIndex = pipeline->sentCount + pipeline->depthMax - 1;
+      if (lastRequestIndex >= pipeline->requestCount)
+        lastRequestIndex = pipeline->requestCount - 1;
+      u32 lastVideoIndex = connection->connectionIndex + lastRequestIndex * fetch->connectionCount;
+
+      // instance takes only so many requests at once on every connection
+      // together, none while it asked to wait
+      struct invidious_instance *instance = fetch->context->instance;
+      u32 allowedCount = ConcurrencyLimitGet(&instance->limit);
+      if (instance->throttledUntil > NowInNanoseconds())
+        allowedCount = 0;
+      u32 instanceInFlightCount = InvidiousHttp11InFlightCount(fetch);
+      pipeline->limit = allowedCount > instanceInFlightCount ? allowedCount - instanceInFlightCount : 0;
+      if (pipeline->limit == 0)
+        fetch->isLimited = 1;
+      else if (lastVideoIndex < fetch->printedCount + fetch->windowLength) {
+        u32 sentCount = pipeline->sentCount;
+        connection->request =
+            HttpPipelineBatch(pipeline, fetch->requestTemplate, connection->videoIds, connection->requestBuffer);
+        connection->requestBytesWritten = 0;
+        HedgeBudgetAdd(&fetch->context->hedgeBudget, pipeline->sentCount - sentCount);
+        // requests sent again after connection closed start over too
+        for (u32 requestIndex = sentCount; requestIndex < pipeline->sentCount; requestIndex++)
+          *InvidiousHttp11Timing(fetch, connection, requestIndex) = fetch->context->fetchTiming;
+        if (connection->request.length == 0) {
+          StringBuilderAppendStringLiteral(sb, "Request is too long");
+          StringBuilderAppendStringLiteral(sb, "\n");
+          struct string message = StringBuilderFlush(sb);
+          PrintString(&message);
+          return 0;
+        }
+      }
+    }
+
+    if (connection->requestBytesWritten < connection->request.length) {
+      struct string remaining = StringFromBuffer(connection->request.value + connection->requestBytesWritten,
+                                                 connection->request.length - connection->requestBytesWritten);
+      s64 bytesWritten = TlsConnectionWrite(tls, &remaining);
+      if (bytesWritten == -1) {
+        StringBuilderAppendStringLiteral(sb, "TLS write failed.\n  ");
+        StringBuilderAppendTlsConnectionError(sb, tls);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string message = StringBuilderFlush(sb);
+        PrintString(&message);
+        return 0;
+      }
+      if (bytesWritten > 0) {
+        connection->requestBytesWritten += (u64)bytesWritten;
+        if (connection->requestBytesWritten == connection->request.length) {
+          u64 now = NowInNanoseconds();
+          for (u32 requestIndex = pipeline->completedCount; requestIndex < pipeline->sentCount; requestIndex++) {
+            struct request_timing *timing = InvidiousHttp11Timing(fetch, connection, requestIndex);
+            InvidiousTimingConnection(timing, connection->pooled);
+            RequestTimingMark(timing, REQUEST_TIMING_MARK_SENT, now);
+          }
+        }
+      }
+    }
+
+    // Read until nothing is left
+    u32 inFlightCount = HttpPipelineInFlightCount(pipeline);
+    struct receive_buffer *response = &connection->response;
+    while (isConnectionOpen) {
+      // length of chunked body is not known, buffer doubles as it fills
+      if (response->length == response->capacity && !ReceiveBufferGrow(response, response->length + 1)) {
+        StringBuilderAppendStringLiteral(sb, "Server responded with too large file than we expected");
+        StringBuilderAppendU64(sb, response->length);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string message = StringBuilderFlush(sb);
+        PrintString(&message);
+        return 0;
+      }
+
+      s64 bytesRead =
+          TlsConnectionRead(tls, response->value + response->length, response->capacity - response->length);
+      if (bytesRead == TLS_CONNECTION_WOULD_BLOCK)
+        break;
+
+      if (bytesRead < 0) {
+        StringBuilderAppendStringLiteral(sb, "TLS read failed.\n  ");
+        StringBuilderAppendTlsConnectionError(sb, tls);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string message = StringBuilderFlush(sb);
+        PrintString(&message);
+        return 0;
+      }
+
+      if (bytesRead == 0) {
+        isConnectionOpen = 0;
+        break; // EOF
+      }
+
+      response->length += (u64)bytesRead;
+      if (!InvidiousHttp11Receive(fetch, connection, &isConnectionOpen))
+        return 0;
+    }
+
+    isBatchAnswered = inFlightCount != 0 && HttpPipelineInFlightCount(pipeline) == 0;
+  } while (isConnectionOpen && isBatchAnswered);
+
+  if (!isConnectionOpen) {
+    b8 isClosedByClient = connection->isRefused;
+    connection->isRefused = 0;
+    if (!InvidiousHttp11Reconnect(fetch, connection, isClosedByClient))
+      return 0;
+    if (!connection->pooled)
+      return 1;
+
+    // idle connection is open already, its completions will not wake it
+    return InvidiousHttp11Advance(fetch, connection);
+  }
+
+  return 1;
+}
+
+/*
+ * Cancels requests answered by duplicates that came first. Responses are
+ * sent in order on HTTP/1.1 connection, so one that has not started arriving
+ * holds back every one after it. Its connection is closed, requests after it
+ * are sent again on next one.
+ * @return false on error, message is printed
+ */
+internalfn b8
+InvidiousHttp11Cancel(struct invidious_http11 *fetch)
+{
+  for (u32 connectionIndex = 0; connectionIndex < fetch->connectionCount; connectionIndex++) {
+    struct invidious_http11_connection *connection = fetch->connections + connectionIndex;
+    struct http_pipeline *pipeline = &connection->pipeline;
+    if (!connection->pooled || connection->response.length != 0)
+      continue;
+
+    b8 isCancelled = 0;
+    while (HttpPipelineInFlightCount(pipeline) != 0 &&
+           IsInvidiousHttp11Answered(fetch, connectionIndex + pipeline->completedCount * fetch->connectionCount)) {
+      HttpPipelineComplete(pipeline);
+      isCancelled = 1;
+    }
+    if (!isCancelled)
+      continue;
+
+    if (!InvidiousHttp11Reconnect(fetch, connection, 1))
+      return 0;
+    if (connection->pooled && !InvidiousHttp11Advance(fetch, connection))
+      return 0;
+  }
+  return 1;
+}
+
+/*
+ * Lets open connections that have nothing in flight send, e.g. after videos
+ * are printed and their slots are freed.
+ * @return false on error, message is printed
+ */
+internalfn b8
+InvidiousHttp11AdvanceIdle(struct invidious_http11 *fetch)
+{
+  fetch->isLimited = 0;
+  for (u32 connectionIndex = 0; connectionIndex < fetch->connectionCount; connectionIndex++) {
+    struct invidious_http11_connection *connection = fetch->connections + connectionIndex;
+    if (connection->pooled && connection->tls->state == TLS_CONNECTION_STATE_OPEN &&
+        HttpPipelineInFlightCount(&connection->pipeline) == 0 && !InvidiousHttp11Advance(fetch, connection))
+      return 0;
+  }
+  return 1;
+}
+
+/*
+ * Hands videos batch gave to their connections, video at index i goes to
+ * connection i % connectionCount. Connections whose requests were all
+ * answered are taken from pool again.
+ * @param videoIndex first video that is not handed yet
+ * @return false on error, message is printed
+ */
+internalfn b8
+InvidiousHttp11Add(struct invidious_http11 *fetch, u32 videoIndex)
+{
+  struct invidious_videos *videos = fetch->videos;
+  for (; videoIndex < videos->count; videoIndex++) {
+    struct invidious_http11_connection *connection = fetch->connections + videoIndex % fetch->connectionCount;
+    debug_assert(videoIndex / fetch->connectionCount == connection->pipeline.requestCount);
+    connection->videoIds[connection->pipeline.requestCount] = videos->ids[videoIndex];
+    HttpPipelineAdd(&connection->pipeline, 1);
+  }
+
+  for (u32 connectionIndex = 0; connectionIndex < fetch->connectionCount; connectionIndex++) {
+    struct invidious_http11_connection *connection = fetch->connections + connectionIndex;
+    if (connection->pooled || HttpPipelineIsDone(&connection->pipeline))
+      continue;
+    // idle connection is open already, its completions will not wake it
+    if (!InvidiousHttp11Acquire(fetch, connection) || !InvidiousHttp11Advance(fetch, connection))
+      return 0;
+  }
+  return InvidiousHttp11AdvanceIdle(fetch);
+}
+
+/*
+ * Ends duplicate. Its connection is kept only when response is read to the
+ * end, otherwise closing it cancels request.
+ */
+internalfn void
+InvidiousHedgeEnd(struct invidious_http11 *fetch, struct invidious_hedge *hedge, b8 isReusable)
+{
+  ConnectionPoolRelease(&fetch->context->pool, hedge->pooled, isReusable, NowInNanoseconds());
+  hedge->pooled = 0;
+  hedge->response.length = 0;
+  ReceiveBufferTrim(&hedge->response);
+  hedge->body.length = 0;
+  ReceiveBufferTrim(&hedge->body);
+  HttpParserNext(hedge->httpParser);
+  hedge->httpParser->position = 0;
+}
+
+/*
+ * Moves duplicate forward as far as it goes without blocking: handshake,
+ * writing request and reading response. Answer that comes before one of
+ * instance request went to first takes slot of video.
+ */
+internalfn void
+InvidiousHedgeAdvance(struct invidious_http11 *fetch, struct invidious_hedge *hedge)
+{
+  struct tls_connection *tls = &hedge->pooled->tls;
+  ConnectionPoolHandshake(hedge->pooled, NowInNanoseconds());
+
+  if (tls->state == TLS_CONNECTION_STATE_FAILED) {
+    InvidiousHedgeEnd(fetch, hedge, 0);
+    return;
+  }
+
+  if (tls->state != TLS_CONNECTION_STATE_OPEN)
+    return;
+
+  // connection is set up for HTTP/2 stream, it is not kept
+  struct string protocol = TlsBackendAlpnProtocol(&tls->backend);
+  if (IsStringEqual(&protocol, &StringFromLiteral("h2"))) {
+    InvidiousHedgeEnd(fetch, hedge, 0);
+    return;
+  }
+
+  while (hedge->requestBytesWritten < hedge->request.length) {
+    struct string remaining = StringFromBuffer(hedge->request.value + hedge->requestBytesWritten,
+                                               hedge->request.length - hedge->requestBytesWritten);
+    s64 bytesWritten = TlsConnectionWrite(tls, &remaining);
+    if (bytesWritten == TLS_CONNECTION_WOULD_BLOCK)
+      return;
+    if (bytesWritten < 0) {
+      InvidiousHedgeEnd(fetch, hedge, 0);
+      return;
+    }
+    hedge->requestBytesWritten += (u64)bytesWritten;
+    if (hedge->requestBytesWritten == hedge->request.length) {
+      InvidiousTimingConnection(&hedge->timing, hedge->pooled);
+      RequestTimingMark(&hedge->timing, REQUEST_TIMING_MARK_SENT, NowInNanoseconds());
+    }
+  }
+
+  struct receive_buffer *response = &hedge->response;
+  struct http_parser *httpParser = hedge->httpParser;
+  while (1) {
+    // length of chunked body is not known, buffer doubles as it fills
+    if (response->length == response->capacity && !ReceiveBufferGrow(response, response->length + 1)) {
+      InvidiousHedgeEnd(fetch, hedge, 0);
+      return;
+    }
+
+    s64 bytesRead =
+        TlsConnectionRead(tls, response->value + response->length, response->capacity - response->length);
+    if (bytesRead == TLS_CONNECTION_WOULD_BLOCK)
+      return;
+    if (bytesRead <= 0) {
+      // closed without answering
+      InvidiousHedgeEnd(fetch, hedge, 0);
+      return;
+    }
+    response->length += (u64)bytesRead;
+    RequestTimingMark(&hedge->timing, REQUEST_TIMING_MARK_FIRST_BYTE, NowInNanoseconds());
+
+    b8 ok;
+    struct string received = StringFromBuffer(response->value, response->length);
+    do {
+      // parser does not consume incomplete lines, so start from where it left
+      struct string packet =
+          StringFromBuffer(response->value + httpParser->position, response->length - httpParser->position);
+      ok = HttpParse(httpParser, &packet);
+
+      for (u32 httpTokenIndex = httpParser->headerTokenCount; httpTokenIndex < httpParser->tokenCount;
+           httpTokenIndex++) {
+        struct http_token *httpToken = httpParser->tokens + httpTokenIndex;
+        if (httpToken->type != HTTP_TOKEN_CHUNK_DATA || httpToken->end == 0)
+          continue;
+
+        struct string data = HttpTokenExtractString(httpToken, &received);
+        if (!ReceiveBufferAppend(&hedge->body, &data)) {
+          InvidiousHedgeEnd(fetch, hedge, 0);
+          return;
+        }
+      }
+    } while (httpParser->error == HTTP_PARSER_ERROR_PAUSED);
+
+    if (ok)
+      break;
+    // body is read in place, buffer grows once when its length is known
+    if (httpParser->error != HTTP_PARSER_ERROR_PARTIAL ||
+        !ReceiveBufferGrow(response, HttpParserResponseLength(httpParser))) {
+      InvidiousHedgeEnd(fetch, hedge, 0);
+      return;
+    }
+  }
+
+  u64 now = NowInNanoseconds();
+  RequestTimingMark(&hedge->timing, REQUEST_TIMING_MARK_RECEIVED, now);
+  b8 isReusable =
+      !(httpParser->state & HTTP_PARSER_STATE_CONNECTION_CLOSE) && httpParser->position == response->length;
+
+  // instance request went to first decides on answers that are not videos
+  u64 retryAfter = INVIDIOUS_RETRY_AFTER_DEFAULT;
+  if (httpParser->state & HTTP_PARSER_STATE_HAS_RETRY_AFTER)
+    retryAfter = httpParser->retryAfter;
+  if (InvidiousRecordResponse(hedge->instance, fetch->sb, httpParser->statusCode, retryAfter,
+                              RequestTimingPhase(&hedge->timing, REQUEST_TIMING_PHASE_TTFB), now) ||
+      httpParser->statusCode != 200) {
+    InvidiousHedgeEnd(fetch, hedge, isReusable);
+    return;
+  }
+
+  RequestTimingHistogramAdd(&hedge->instance->timingHistogram, &hedge->timing);
+  if (!IsInvidiousHttp11Answered(fetch, hedge->videoIndex)) {
+    struct string received = StringFromBuffer(response->value, response->length);
+    if (InvidiousHttp11Store(fetch, hedge->videoIndex, httpParser, &received, &hedge->body))
+      fetch->timings[hedge->videoIndex % fetch->windowLength] = hedge->timing;
+  }
+  InvidiousHedgeEnd(fetch, hedge, isReusable);
+}
+
+/*
+ * @return duplicate that data of pooled connection is, 0 when it is not one
+ */
+internalfn struct invidious_hedge *
+InvidiousHttp11HedgeOf(struct invidious_http11 *fetch, void *data)
+{
+  for (u32 hedgeIndex = 0; hedgeIndex < fetch->hedgeCount; hedgeIndex++) {
+    if (data == fetch->hedges + hedgeIndex)
+      return fetch->hedges + hedgeIndex;
+  }
+  return 0;
+}
+
+/*
+ * Sends request of video again to next best instance, when budget allows.
+ * @return false when it is not sent
+ */
+internalfn b8
+InvidiousHedgeStart(struct invidious_http11 *fetch, struct invidious_hedge *hedge, u32 videoIndex)
+{
+  struct invidious_context *context = fetch->context;
+  u32 instanceIndex = (u32)(context->instance - context->instances);
+  u64 unixNow = PlatformUnixTime();
+  s32 hedgeIndex = InstanceListPick(&context->instanceList, 1u << instanceIndex, unixNow);
+  if (hedgeIndex == -1)
+    return 0;
+
+  // names are not waited for, nor instances that are down or asked to wait
+  struct invidious_instance *instance = context->instances + hedgeIndex;
+  if (!instance->isResolved || instance->addressCount == 0 || instance->state->downUntil > unixNow ||
+      instance->throttledUntil > NowInNanoseconds())
+    return 0;
+
+  if (!fetch->hedgeTemplates[hedgeIndex]) {
+    struct http_request_info requestInfo = {
+        .method = HTTP_METHOD_GET,
+        .version = HTTP_VERSION_11,
+        .host = instance->state->hostname,
+        .path = StringFromLiteral("/api/v1/videos/" HTTP_REQUEST_TEMPLATE_SLOT),
+        .accept = HTTP_CONTENT_TYPE_JSON,
+    };
+    fetch->hedgeTemplates[hedgeIndex] = MakeHttpRequestTemplate(fetch->arena, &requestInfo);
+    debug_assert(fetch->hedgeTemplates[hedgeIndex] != 0);
+  }
+  struct string *videoId = fetch->videos->ids + videoIndex;
+  hedge->request = HttpRequestTemplateRender(fetch->hedgeTemplates[hedgeIndex], videoId, hedge->requestBuffer);
+  if (hedge->request.length == 0 || !HedgeBudgetTake(&context->hedgeBudget))
+    return 0;
+
+  hedge->pooled = InvidiousAcquire(context, instance, hedge);
+  if (!hedge->pooled)
+    return 0;
+
+  hedge->instance = instance;
+  hedge->videoIndex = videoIndex;
+  hedge->requestBytesWritten = 0;
+  // phases before request was sent are of original one
+  hedge->timing = fetch->timings[videoIndex % fetch->windowLength];
+  for (enum request_timing_mark mark = REQUEST_TIMING_MARK_CONNECTING; mark < REQUEST_TIMING_MARK_COUNT; mark++)
+    hedge->timing.marks[mark] = 0;
+
+  // idle connection is open already, its completions will not wake it
+  InvidiousHedgeAdvance(fetch, hedge);
+  return 1;
+}
+
+/*
+ * Sends requests again to another instance when their first byte is later
+ * than p95 of instance they went to, within budget, and cancels duplicates
+ * whose video is answered.
+ * @return nanoseconds when next request in flight gets late, 0 when none will
+ */
+internalfn u64
+InvidiousHttp11Hedge(struct invidious_http11 *fetch)
+{
+  struct invidious_context *context = fetch->context;
+  for (u32 hedgeIndex = 0; hedgeIndex < fetch->hedgeCount; hedgeIndex++) {
+    struct invidious_hedge *hedge = fetch->hedges + hedgeIndex;
+    if (hedge->pooled && IsInvidiousHttp11Answered(fetch, hedge->videoIndex))
+      InvidiousHedgeEnd(fetch, hedge, 0);
+  }
+
+  u64 delay = HedgeDelay(&context->instance->timingHistogram);
+  if (delay == 0)
+    return 0;
+
+  u64 now = NowInNanoseconds();
+  u64 wakeAt = 0;
+  u32 windowEnd = fetch->printedCount + fetch->windowLength;
+  if (windowEnd > fetch->videos->count)
+    windowEnd = fetch->videos->count;
+  for (u32 videoIndex = fetch->printedCount; videoIndex < windowEnd; videoIndex++) {
+    u32 slotIndex = videoIndex % fetch->windowLength;
+    if (fetch->isHedged[slotIndex] || IsInvidiousHttp11Answered(fetch, videoIndex))
+      continue;
+
+    // requests after first one in flight on connection wait for it
+    struct http_pipeline *pipeline = &fetch->connections[videoIndex % fetch->connectionCount].pipeline;
+    u32 requestIndex = videoIndex / fetch->connectionCount;
+    struct request_timing *timing = fetch->timings + slotIndex;
+    u64 sentAt = timing->marks[REQUEST_TIMING_MARK_SENT];
+    if (requestIndex < pipeline->completedCount || requestIndex >= pipeline->sentCount || sentAt == 0 ||
+        timing->marks[REQUEST_TIMING_MARK_FIRST_BYTE] != 0)
+      continue;
+
+    if (now - sentAt < delay) {
+      if (wakeAt == 0 || sentAt + delay < wakeAt)
+        wakeAt = sentAt + delay;
+      continue;
+    }
+
+    struct invidious_hedge *hedge = 0;
+    for (u32 hedgeIndex = 0; hedgeIndex < fetch->hedgeCount && !hedge; hedgeIndex++) {
+      if (!fetch->hedges[hedgeIndex].pooled)
+        hedge = fetch->hedges + hedgeIndex;
+    }
+    // completions wake fetch, they free duplicates and grow budget
+    if (!hedge || !InvidiousHedgeStart(fetch, hedge, videoIndex))
+      return 0;
+    fetch->isHedged[slotIndex] = 1;
+  }
+  return wakeAt;
+}
+
+/*
+ * Fetches videos on many HTTP/1.1 connections at once, all driven by transport
+ * from this thread. Videos are printed in order they are given, unless
+ * context says order does not matter. Connections go back to pool, open ones
+ * only when every response is read. Videos batch gives meanwhile are sent as
+ * requests before them are answered.
+ * @param firstConnection is already connected
+ * @param videos isPrinted is set for every video printed
+ * @return message is printed on error
+ */
+internalfn enum invidious_fetch_result
+InvidiousFetchHttp11(struct invidious_context *context, struct pooled_connection *firstConnection, memory_arena *arena,
+                     string_builder *sb, struct invidious_videos *videos)
+{
+  enum { KILOBYTES = (1 << 10) };
+
+  // only video id changes between requests
+  struct http_request_info requestInfo = {
+      .method = HTTP_METHOD_GET,
+      .version = HTTP_VERSION_11,
+      .host = context->instance->state->hostname,
+      .path = StringFromLiteral("/api/v1/videos/" HTTP_REQUEST_TEMPLATE_SLOT),
+      .accept = HTTP_CONTENT_TYPE_JSON,
+  };
+
+  struct invidious_http11 fetch = {
+      .context = context,
+      .arena = arena,
+      .sb = sb,
+      .requestTemplate = MakeHttpRequestTemplate(arena, &requestInfo),
+      .connectionCount = videos->max < INVIDIOUS_HTTP11_CONNECTION_MAX ? videos->max
+                                                                        : INVIDIOUS_HTTP11_CONNECTION_MAX,
+      .depthMax = INVIDIOUS_HTTP11_PIPELINE_DEPTH_MAX,
+      .videos = videos,
+      .hedgeCount = context->isHedging ? INVIDIOUS_HEDGE_MAX : 0,
+  };
+  debug_assert(fetch.requestTemplate != 0);
+
+  // requests in flight are spread over connections first, then pipelined
+  if (context->requestMax != 0) {
+    if (fetch.connectionCount > context->requestMax)
+      fetch.connectionCount = context->requestMax;
+    fetch.depthMax = context->requestMax / fetch.connectionCount;
+    if (fetch.depthMax > INVIDIOUS_HTTP11_PIPELINE_DEPTH_MAX)
+      fetch.depthMax = INVIDIOUS_HTTP11_PIPELINE_DEPTH_MAX;
+  }
+
+  // connection that has the oldest video not printed can always send a batch
+  fetch.windowLength = 2 * fetch.connectionCount * fetch.depthMax;
+  if (fetch.windowLength > videos->max)
+    fetch.windowLength = videos->max;
+  fetch.bodies = MemoryArenaPush(arena, sizeof(*fetch.bodies) * fetch.windowLength);
+  fetch.bodyBuffers = MemoryArenaPush(arena, sizeof(*fetch.bodyBuffers) * fetch.windowLength);
+  fetch.timings = MemoryArenaPush(arena, sizeof(*fetch.timings) * fetch.windowLength);
+  fetch.isHedged = MemoryArenaPush(arena, sizeof(*fetch.isHedged) * fetch.windowLength);
+  for (u32 slotIndex = 0; slotIndex < fetch.windowLength; slotIndex++) {
+    fetch.bodies[slotIndex] = StringNull();
+    fetch.bodyBuffers[slotIndex] = (struct receive_buffer){};
+    fetch.isHedged[slotIndex] = 0;
+  }
+  for (u32 hedgeIndex = 0; hedgeIndex < fetch.hedgeCount; hedgeIndex++) {
+    struct invidious_hedge *hedge = fetch.hedges + hedgeIndex;
+    hedge->requestBuffer = MakeString(arena, 1 * KILOBYTES);
+    hedge->httpParser = MakeHttpStreamingParser(arena, 64);
+    HttpParserNext(hedge->httpParser);
+    hedge->httpParser->position = 0;
+  }
+
+  fetch.connections = MemoryArenaPush(arena, sizeof(*fetch.connections) * fetch.connectionCount);
+  for (u32 connectionIndex = 0; connectionIndex < fetch.connectionCount; connectionIndex++) {
+    struct invidious_http11_connection *connection = fetch.connections + connectionIndex;
+    connection->pooled = 0;
+    connection->response = (struct receive_buffer){};
+    connection->isRefused = 0;
+    connection->body = (struct receive_buffer){};
+  }
+  fetch.connections[0].pooled = firstConnection;
+  firstConnection->data = fetch.connections + 0;
+
+  // only address space is taken, pages are committed as responses grow
+  enum invidious_fetch_result result = INVIDIOUS_FETCH_OK;
+  for (u32 slotIndex = 0; slotIndex < fetch.windowLength; slotIndex++) {
+    if (!ReceiveBufferInit(fetch.bodyBuffers + slotIndex, INVIDIOUS_RESPONSE_RESERVED)) {
+      result = INVIDIOUS_FETCH_FAILED;
+      break;
+    }
+  }
+  for (u32 connectionIndex = 0; result == INVIDIOUS_FETCH_OK && connectionIndex < fetch.connectionCount;
+       connectionIndex++) {
+    struct invidious_http11_connection *connection = fetch.connections + connectionIndex;
+    if (!ReceiveBufferInit(&connection->response, INVIDIOUS_RESPONSE_RESERVED) ||
+        !ReceiveBufferInit(&connection->body, INVIDIOUS_RESPONSE_RESERVED))
+      result = INVIDIOUS_FETCH_FAILED;
+  }
+  for (u32 hedgeIndex = 0; result == INVIDIOUS_FETCH_OK && hedgeIndex < fetch.hedgeCount; hedgeIndex++) {
+    struct invidious_hedge *hedge = fetch.hedges + hedgeIndex;
+    if (!ReceiveBufferInit(&hedge->response, INVIDIOUS_RESPONSE_RESERVED) ||
+        !ReceiveBufferInit(&hedge->body, INVIDIOUS_RESPONSE_RESERVED))
+      result = INVIDIOUS_FETCH_FAILED;
+  }
+  if (result != INVIDIOUS_FETCH_OK) {
+    StringBuilderAppendStringLiteral(sb, "Not enough memory for responses.");
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+  }
+
+  for (u32 connectionIndex = 0; result == INVIDIOUS_FETCH_OK && connectionIndex < fetch.connectionCount;
+       connectionIndex++) {
+    struct invidious_http11_connection *connection = fetch.connections + connectionIndex;
+    connection->connectionIndex = connectionIndex;
+
+    // room for videos batch gives later too
+    u32 requestMax = (videos->max - connectionIndex + fetch.connectionCount - 1) / fetch.connectionCount;
+    u32 requestCount = (videos->count + fetch.connectionCount - 1 - connectionIndex) / fetch.connectionCount;
+    connection->videoIds = MemoryArenaPush(arena, sizeof(*connection->videoIds) * requestMax);
+    for (u32 requestIndex = 0; requestIndex < requestCount; requestIndex++)
+      connection->videoIds[requestIndex] = videos->ids[connectionIndex + requestIndex * fetch.connectionCount];
+    HttpPipelineInit(&connection->pipeline, requestCount, fetch.depthMax);
+
+    // batch of requests is written at once, fits in single TLS record
+    connection->requestBuffer = MakeString(arena, 16 * KILOBYTES);
+    connection->request = StringFromBuffer(connection->requestBuffer->value, 0);
+    connection->requestBytesWritten = 0;
+
+    connection->httpParser = MakeHttpStreamingParser(arena, 64);
+    HttpParserNext(connection->httpParser);
+    connection->httpParser->position = 0;
+
+    // first connection is handed over, others are taken from pool once they have requests
+    connection->tls = 0;
+    if (connectionIndex == 0) {
+      connection->tls = &connection->pooled->tls;
+    } else if (requestCount == 0) {
+      continue;
+    } else if (!InvidiousHttp11Acquire(&fetch, connection)) {
+      result = INVIDIOUS_FETCH_FAILED;
+      break;
+    }
+
+    if (connection->tls->state == TLS_CONNECTION_STATE_FAILED) {
+      StringBuilderAppendStringLiteral(sb, "Connecting to server failed.\n  ");
+      StringBuilderAppendTlsConnectionError(sb, connection->tls);
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string message = StringBuilderFlush(sb);
+      PrintString(&message);
+      result = INVIDIOUS_FETCH_INSTANCE_FAILED;
+      break;
+    }
+  }
+
+  // first batch on connections that are already open
+  for (u32 connectionIndex = 0; result == INVIDIOUS_FETCH_OK && connectionIndex < fetch.connectionCount;
+       connectionIndex++) {
+    struct invidious_http11_connection *connection = fetch.connections + connectionIndex;
+    if (connection->pooled && connection->tls->state == TLS_CONNECTION_STATE_OPEN &&
+        !InvidiousHttp11Advance(&fetch, connection))
+      result = INVIDIOUS_FETCH_INSTANCE_FAILED;
+  }
+
+  // requests of every connection go out in one submission with io_uring
+  struct platform_completion completions[4 * (INVIDIOUS_HTTP11_CONNECTION_MAX + INVIDIOUS_HEDGE_MAX)];
+  // next request that gets late, see InvidiousHttp11Hedge()
+  u64 wakeAt = 0;
+  struct string *videoIds = videos->ids;
+  b8 *isPrinted = videos->isPrinted;
+  while (result == INVIDIOUS_FETCH_OK &&
+         (fetch.printedCount < videos->count || IsInvidiousBatchOpen(context, videos))) {
+    // every video is printed, nothing comes before batch gives more
+    if (fetch.printedCount == videos->count) {
+      u32 videoCount = videos->count;
+      InvidiousBatchTake(context, sb, videos, 1);
+      if (!InvidiousHttp11Add(&fetch, videoCount))
+        result = INVIDIOUS_FETCH_INSTANCE_FAILED;
+      continue;
+    }
+
+    // refused requests wait for instance, no response is coming to wake up for
+    if (context->instance->throttledUntil > NowInNanoseconds() && InvidiousHttp11InFlightCount(&fetch) == 0) {
+      InvidiousThrottleWait(context);
+      if (!InvidiousHttp11AdvanceIdle(&fetch)) {
+        result = INVIDIOUS_FETCH_INSTANCE_FAILED;
+        break;
+      }
+    }
+
+    s32 completionCount = InvidiousTransportWait(context, completions, ARRAY_COUNT(completions), wakeAt, sb);
+    if (completionCount == -1) {
+      result = INVIDIOUS_FETCH_INSTANCE_FAILED;
+      break;
+    }
+
+    for (u32 completionIndex = 0; completionIndex < (u32)completionCount; completionIndex++) {
+      void *data = ConnectionPoolComplete(&context->pool, completions + completionIndex);
+      struct invidious_hedge *hedge = InvidiousHttp11HedgeOf(&fetch, data);
+      if (hedge) {
+        InvidiousHedgeAdvance(&fetch, hedge);
+        continue;
+      }
+
+      struct invidious_http11_connection *connection = data;
+      // idle connection, or connection whose requests are answered
+      if (!connection || !connection->pooled)
+        continue;
+      if (!InvidiousHttp11Advance(&fetch, connection)) {
+        result = INVIDIOUS_FETCH_INSTANCE_FAILED;
+        break;
+      }
+    }
+    ConnectionPoolEvict(&context->pool, NowInNanoseconds());
+    if (result != INVIDIOUS_FETCH_OK)
+      break;
+
+    // print in order, later videos wait for earlier ones. Unordered, any
+    // video in window is printed, window still moves only past printed ones.
+    u32 printedCount = fetch.printedCount;
+    u32 windowEnd = fetch.printedCount + fetch.windowLength;
+    if (windowEnd > videos->count)
+      windowEnd = videos->count;
+    for (u32 videoIndex = fetch.printedCount; videoIndex < windowEnd; videoIndex++) {
+      u32 slotIndex = videoIndex % fetch.windowLength;
+      struct string *json = fetch.bodies + slotIndex;
+      if (isPrinted[videoIndex])
+        continue;
+      if (IsStringNull(json)) {
+        if (!context->isUnordered)
+          break;
+        continue;
+      }
+
+      if (!InvidiousFinishVideo(context, arena, sb, videoIds + videoIndex, json, fetch.timings + slotIndex)) {
+        result = INVIDIOUS_FETCH_FAILED;
+        break;
+      }
+
+      // large body gives its pages back
+      struct receive_buffer *slot = fetch.bodyBuffers + slotIndex;
+      slot->length = 0;
+      ReceiveBufferTrim(slot);
+      *json = StringNull();
+      fetch.isHedged[slotIndex] = 0;
+      isPrinted[videoIndex] = 1;
+    }
+    while (fetch.printedCount < videos->count && isPrinted[fetch.printedCount])
+      fetch.printedCount++;
+
+    // videos batch gave meanwhile are sent as requests before them are answered
+    if (result == INVIDIOUS_FETCH_OK && IsInvidiousBatchOpen(context, videos)) {
+      u32 videoCount = videos->count;
+      if (InvidiousBatchTake(context, sb, videos, 0) != 0 && !InvidiousHttp11Add(&fetch, videoCount))
+        result = INVIDIOUS_FETCH_INSTANCE_FAILED;
+    }
+
+    // slots are freed or responses came, connections that waited for them can send
+    if (result == INVIDIOUS_FETCH_OK && (fetch.printedCount != printedCount || fetch.isLimited) &&
+        !InvidiousHttp11AdvanceIdle(&fetch))
+      result = INVIDIOUS_FETCH_INSTANCE_FAILED;
+
+    // late requests are sent again to another instance, ones whose
+    // duplicate came first are cancelled
+    if (result == INVIDIOUS_FETCH_OK && fetch.hedgeCount != 0) {
+      if (!InvidiousHttp11Cancel(&fetch))
+        result = INVIDIOUS_FETCH_INSTANCE_FAILED;
+      else
+        wakeAt = InvidiousHttp11Hedge(&fetch);
+    }
+  }
+
+  if (result == INVIDIOUS_FETCH_INSTANCE_FAILED && fetch.isThrottled)
+    result = INVIDIOUS_FETCH_THROTTLED;
+
+  // kept open for next requests, unless responses are left unread on them
+  for (u32 connectionIndex = 0; connectionIndex < fetch.connectionCount; connectionIndex++) {
+    struct invidious_http11_connection *connection = fetch.connections + connectionIndex;
+    if (connection->pooled)
+      ConnectionPoolRelease(&context->pool, connection->pooled, result == INVIDIOUS_FETCH_OK, NowInNanoseconds());
+    ReceiveBufferRelease(&connection->response);
+    ReceiveBufferRelease(&connection->body);
+  }
+  for (u32 slotIndex = 0; slotIndex < fetch.windowLength; slotIndex++)
+    ReceiveBufferRelease(fetch.bodyBuffers + slotIndex);
+  // duplicates in flight are cancelled
+  for (u32 hedgeIndex = 0; hedgeIndex < fetch.hedgeCount; hedgeIndex++) {
+    struct invidious_hedge *hedge = fetch.hedges + hedgeIndex;
+    if (hedge->pooled)
+      InvidiousHedgeEnd(&fetch, hedge, 0);
+    ReceiveBufferRelease(&hedge->response);
+    ReceiveBufferRelease(&hedge->body);
+  }
+
+  return result;
+}
+
+/*
+ * Probe of instance, GET /api/v1/stats. It is cheap to answer, and instance
+ * answers it only when its backend is up.
+ */
+struct invidious_probe {
+  struct invidious_instance *instance;
+  struct pooled_connection *pooled;
+  // in nanoseconds, see NowInNanoseconds()
+  u64 startedAt;
+  u64 answeredAt;
+  b8 isDone;
+  b8 isFailed;
+  // connection can be used for requests after answer
+  b8 isReusable;
+
+  // request, or frames when HTTP/2 is spoken, that is being written
+  struct string request;
+  u64 requestBytesWritten;
+  // when server picked HTTP/2 with ALPN
+  struct http2_connection *http2;
+  struct http2_stream *stream;
+  struct receive_buffer streamBuffer;
+
+  u8 *responseBuffer;
+  u64 totalBytesRead;
+  struct http_parser *httpParser;
+};
+
+enum {
+  INVIDIOUS_PROBE_MAX = INVIDIOUS_HTTP11_CONNECTION_MAX,
+  // must hold at least one HTTP/2 frame
+  INVIDIOUS_PROBE_RESPONSE_LENGTH_MAX = 64 * 1024,
+};
+
+// probe that is not answered in time fails, in nanoseconds
+comptime u64 INVIDIOUS_PROBE_TIMEOUT = 2ULL * 1000000000 /* 1e9 */;
+
+internalfn void
+InvidiousProbeEnd(struct invidious_probe *probe, b8 isFailed)
+{
+  probe->isDone = 1;
+  probe->isFailed = isFailed;
+  probe->answeredAt = NowInNanoseconds();
+}
+
+/*
+ * Moves probe forward as far as it goes without blocking: handshake, writing
+ * request and reading answer. Answer is judged by its status only.
+ */
+internalfn void
+InvidiousProbeAdvance(struct invidious_probe *probe, memory_arena *arena)
+{
+  struct tls_connection *tls = &probe->pooled->tls;
+  ConnectionPoolHandshake(probe->pooled, NowInNanoseconds());
+
+  if (tls->state == TLS_CONNECTION_STATE_FAILED) {
+    InvidiousProbeEnd(probe, 1);
+    return;
+  }
+
+  if (tls->state != TLS_CONNECTION_STATE_OPEN)
+    return;
+
+  if (IsStringNull(&probe->request)) {
+    struct http_request_info requestInfo = {
+        .method = HTTP_METHOD_GET,
+        .version = HTTP_VERSION_11,
+        .host = probe->instance->state->hostname,
+        .path = StringFromLiteral("/api/v1/stats"),
+        .accept = HTTP_CONTENT_TYPE_JSON,
+    };
+    struct string protocol = TlsBackendAlpnProtocol(&tls->backend);
+    if (IsStringEqual(&protocol, &StringFromLiteral("h2"))) {
+      requestInfo.version = HTTP_VERSION_20;
+      probe->http2 = MakeHttp2Connection(arena, 1, 32);
+      Http2Start(probe->http2);
+      // stats are much smaller
+      if (ReceiveBufferInit(&probe->streamBuffer, INVIDIOUS_PROBE_RESPONSE_LENGTH_MAX))
+        probe->stream = Http2Request(probe->http2, &requestInfo, arena, &probe->streamBuffer);
+      if (!probe->stream) {
+        InvidiousProbeEnd(probe, 1);
+        return;
+      }
+      probe->request = Http2Flush(probe->http2);
+    } else {
+      probe->request = HttpRequestBuild(&requestInfo, arena);
+      if (IsStringNull(&probe->request)) {
+        InvidiousProbeEnd(probe, 1);
+        return;
+      }
+    }
+    probe->requestBytesWritten = 0;
+  }
+
+  while (!probe->isDone) {
+    if (probe->requestBytesWritten < probe->request.length) {
+      struct string remaining = StringFromBuffer(probe->request.value + probe->requestBytesWritten,
+                                                 probe->request.length - probe->requestBytesWritten);
+      s64 bytesWritten = TlsConnectionWrite(tls, &remaining);
+      if (bytesWritten == TLS_CONNECTION_WOULD_BLOCK)
+        return;
+      if (bytesWritten < 0) {
+        InvidiousProbeEnd(probe, 1);
+        return;
+      }
+      probe->requestBytesWritten += (u64)bytesWritten;
+      continue;
+    }
+
+    s64 bytesRead = TlsConnectionRead(tls, probe->responseBuffer + probe->totalBytesRead,
+                                      INVIDIOUS_PROBE_RESPONSE_LENGTH_MAX - probe->totalBytesRead);
+    if (bytesRead == TLS_CONNECTION_WOULD_BLOCK)
+      return;
+    if (bytesRead <= 0) {
+      // closed without answering
+      InvidiousProbeEnd(probe, 1);
+      return;
+    }
+    probe->totalBytesRead += (u64)bytesRead;
+
+    if (probe->http2) {
+      // connection consumes complete frames only
+      struct http2_connection *http2 = probe->http2;
+      struct string packet =
+          StringFromBuffer(probe->responseBuffer + http2->position, probe->totalBytesRead - http2->position);
+      b8 ok = Http2Receive(http2, &packet);
+      MemoryMove(probe->responseBuffer, probe->responseBuffer + http2->position,
+                 probe->totalBytesRead - http2->position);
+      probe->totalBytesRead -= http2->position;
+      http2->position = 0;
+      if (!ok) {
+        InvidiousProbeEnd(probe, 1);
+        return;
+      }
+
+      // settings and window updates are answered
+      probe->request = Http2Flush(http2);
+      probe->requestBytesWritten = 0;
+      if (probe->stream->state == HTTP2_STREAM_STATE_CLOSED)
+        InvidiousProbeEnd(probe, probe->stream->error != HTTP2_ERROR_NONE || probe->stream->statusCode != 200);
+      continue;
+    }
+
+    struct http_parser *httpParser = probe->httpParser;
+    b8 ok;
+    do {
+      // parser does not consume incomplete lines, so start from where it left
+      struct string packet =
+          StringFromBuffer(probe->responseBuffer + httpParser->position, probe->totalBytesRead - httpParser->position);
+      ok = HttpParse(httpParser, &packet);
+    } while (httpParser->error == HTTP_PARSER_ERROR_PAUSED);
+
+    if (!ok) {
+      // answer must fit in buffer, stats are much smaller
+      if (httpParser->error != HTTP_PARSER_ERROR_PARTIAL ||
+          probe->totalBytesRead == INVIDIOUS_PROBE_RESPONSE_LENGTH_MAX)
+        InvidiousProbeEnd(probe, 1);
+      continue;
+    }
+
+    probe->isReusable =
+        !(httpParser->state & HTTP_PARSER_STATE_CONNECTION_CLOSE) && httpParser->position == probe->totalBytesRead;
+    InvidiousProbeEnd(probe, httpParser->statusCode != 200);
+  }
+}
+
+/*
+ * Probes instances not heard from for a while, all at once, so best one can
+ * be picked. Latency is from taking connection to answer, what a request pays
+ * on a new run. Only done when there is a choice.
+ */
+internalfn void
+InvidiousProbeInstances(struct invidious_context *context, memory_arena *arena)
+{
+  struct instance_list *list = &context->instanceList;
+  if (list->instanceCount < 2)
+    return;
+
+  // Resolve all first, so waiting for names is not measured
+  memory_temp tempMemory = MemoryTempBegin(arena);
+  struct invidious_instance *probedInstances[INVIDIOUS_PROBE_MAX];
+  u32 probeCount = 0;
+  u64 now = PlatformUnixTime();
+  for (u32 instanceIndex = 0; instanceIndex < list->instanceCount && probeCount < INVIDIOUS_PROBE_MAX;
+       instanceIndex++) {
+    struct invidious_instance *instance = context->instances + instanceIndex;
+    if (!IsInstanceProbeDue(instance->state, now))
+      continue;
+
+    if (!InvidiousResolveFinish(context, instance, tempMemory.arena)) {
+      InstanceListRecord(list, instance->state, 0, 1, now);
+      continue;
+    }
+    probedInstances[probeCount] = instance;
+    probeCount++;
+  }
+
+  struct invidious_probe probes[INVIDIOUS_PROBE_MAX];
+  for (u32 probeIndex = 0; probeIndex < probeCount; probeIndex++) {
+    struct invidious_probe *probe = probes + probeIndex;
+    *probe = (struct invidious_probe){
+        .instance = probedInstances[probeIndex],
+        .startedAt = NowInNanoseconds(),
+        .request = StringNull(),
+        .responseBuffer = MemoryArenaPush(tempMemory.arena, INVIDIOUS_PROBE_RESPONSE_LENGTH_MAX),
+        .httpParser = MakeHttpStreamingParser(tempMemory.arena, 64),
+    };
+    probe->pooled = InvidiousAcquire(context, probe->instance, probe);
+    if (!probe->pooled) {
+      probeCount = probeIndex;
+      break;
+    }
+    // idle connection is open already, its completions will not wake it
+    InvidiousProbeAdvance(probe, tempMemory.arena);
+  }
+
+  u64 startedAt = NowInNanoseconds();
+  struct platform_completion completions[4 * INVIDIOUS_PROBE_MAX];
+  while (1) {
+    u32 doneCount = 0;
+    for (u32 probeIndex = 0; probeIndex < probeCount; probeIndex++) {
+      struct invidious_probe *probe = probes + probeIndex;
+      // connection attempts can fail while pool is evicting
+      if (!probe->isDone && probe->pooled->tls.state == TLS_CONNECTION_STATE_FAILED)
+        InvidiousProbeAdvance(probe, tempMemory.arena);
+      doneCount += probe->isDone;
+    }
+
+    u64 elapsed = NowInNanoseconds() - startedAt;
+    if (doneCount == probeCount || elapsed >= INVIDIOUS_PROBE_TIMEOUT)
+      break;
+
+    // rounded up, so timeout has passed when wait returns empty
+    u64 remaining = (INVIDIOUS_PROBE_TIMEOUT - elapsed + 999999) / 1000000 /* 1e6 */;
+    s32 timeout = ConnectionPoolTimeout(&context->pool, NowInNanoseconds());
+    if (timeout == -1 || (u64)timeout > remaining)
+      timeout = (s32)remaining;
+
+    u32 completionCount = PlatformTransportWait(&context->transport, completions, ARRAY_COUNT(completions), timeout);
+    for (u32 completionIndex = 0; completionIndex < completionCount; completionIndex++) {
+      struct invidious_probe *probe = ConnectionPoolComplete(&context->pool, completions + completionIndex);
+      if (probe && !probe->isDone)
+        InvidiousProbeAdvance(probe, tempMemory.arena);
+    }
+    ConnectionPoolEvict(&context->pool, NowInNanoseconds());
+  }
+
+  // HTTP/2 connections of probes are not kept, they are set up for one stream
+  now = PlatformUnixTime();
+  for (u32 probeIndex = 0; probeIndex < probeCount; probeIndex++) {
+    struct invidious_probe *probe = probes + probeIndex;
+    b8 isFailed = !probe->isDone || probe->isFailed;
+    u64 latency = isFailed ? 0 : probe->answeredAt - probe->startedAt;
+    InstanceListRecord(list, probe->instance->state, latency, isFailed, now);
+    ConnectionPoolRelease(&context->pool, probe->pooled, !isFailed && probe->isReusable, NowInNanoseconds());
+    ReceiveBufferRelease(&probe->streamBuffer);
+  }
+  MemoryTempEnd(&tempMemory);
+}
+
+/*
+ * Fetches videos from instance that context points to, on HTTP/2 when server
+ * speaks it.
+ * @param videos isPrinted is set for every video printed, none is at start
+ * @return message is printed on error
+ */
+internalfn enum invidious_fetch_result
+InvidiousFetch(struct invidious_context *context, memory_arena *arena, string_builder *sb,
+               struct invidious_videos *videos)
+{
+  // requests start now, those that wait for name of instance pay for it
+  context->fetchTiming = (struct request_timing){};
+  RequestTimingMark(&context->fetchTiming, REQUEST_TIMING_MARK_START, NowInNanoseconds());
+  if (!InvidiousResolveFinish(context, context->instance, arena)) {
+    StringBuilderAppendStringLiteral(sb, "Resolving hostname failed.");
+    StringBuilderAppendStringLiteral(sb, "\n  Instance: ");
+    StringBuilderAppendString(sb, &context->instance->state->hostname);
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return INVIDIOUS_FETCH_INSTANCE_FAILED;
+  }
+  RequestTimingMark(&context->fetchTiming, REQUEST_TIMING_MARK_RESOLVED, NowInNanoseconds());
+
+  // picked only because every other instance is down
+  if (context->instance->throttledUntil > NowInNanoseconds() + INVIDIOUS_THROTTLE_WAIT_MAX) {
+    StringBuilderAppendStringLiteral(sb, "Instance is throttling requests.");
+    StringBuilderAppendStringLiteral(sb, "\n  Instance: ");
+    StringBuilderAppendString(sb, &context->instance->state->hostname);
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return INVIDIOUS_FETCH_THROTTLED;
+  }
+
+  context->activeAt = NowInNanoseconds();
+  struct pooled_connection *pooled = InvidiousConnect(context, sb);
+  if (!pooled)
+    return INVIDIOUS_FETCH_INSTANCE_FAILED;
+
+  // All requests are multiplexed on one connection
+  struct string protocol = TlsBackendAlpnProtocol(&pooled->tls.backend);
+  if (IsStringEqual(&protocol, &StringFromLiteral("h2"))) {
+    InvidiousTimingConnection(&context->fetchTiming, pooled);
+    enum invidious_fetch_result result =
+        InvidiousFetchHttp2(context, &pooled->tls, arena, sb, videos);
+    ConnectionPoolRelease(&context->pool, pooled, result == INVIDIOUS_FETCH_OK, NowInNanoseconds());
+    return result;
+  }
+
+  // Requests are spread over connections and pipelined on each
+  return InvidiousFetchHttp11(context, pooled, arena, sb, videos);
+}
+
+enum {
+  // of batch, videos past 3/4 of it are requested every time they are given
+  INVIDIOUS_VIDEO_ENTRY_MAX = 1 << 16,
+};
+
+/*
+ * Requests go to best instance, ones not answered go to next best. Video that
+ * is given many times, or was answered earlier in run, is requested once and
+ * printed every time from its answer, see src/video_table.c. Batch gives more
+ * videos while they are fetched, see InvidiousBatchTake().
+ * @param videos ones given at start, requested ones that are not printed are
+ *        moved to start
+ * @return message is printed on error
+ */
+internalfn enum invidious_fetch_result
+InvidiousFetchAll(struct invidious_context *context, memory_arena *arena, string_builder *sb,
+                  struct invidious_videos *videos)
+{
+  // videos given again wait for first one, in place it is given
+  memory_temp givenMemory = MemoryTempBegin(arena);
+  context->givenIds = MemoryArenaPush(arena, sizeof(*context->givenIds) * videos->max);
+  context->isWaiting = MemoryArenaPush(arena, sizeof(*context->isWaiting) * videos->max);
+  context->givenCount = 0;
+  context->givenPrintedCount = 0;
+  u32 givenCount = videos->count;
+  videos->count = 0;
+  for (u32 givenIndex = 0; givenIndex < givenCount; givenIndex++) {
+    struct string videoId = videos->ids[givenIndex];
+    InvidiousGive(context, videos, &videoId);
+  }
+  // answered earlier in run
+  InvidiousPrintWaiting(context, sb);
+  // fetch starts with first video batch gives that is requested
+  while (videos->count == 0 && IsInvidiousBatchOpen(context, videos))
+    InvidiousBatchTake(context, sb, videos, 1);
+
+  enum invidious_fetch_result result = videos->count != 0 ? INVIDIOUS_FETCH_INSTANCE_FAILED : INVIDIOUS_FETCH_OK;
+  u32 triedMask = 0;
+  while (result == INVIDIOUS_FETCH_INSTANCE_FAILED || result == INVIDIOUS_FETCH_THROTTLED) {
+    s32 instanceIndex = InstanceListPick(&context->instanceList, triedMask, PlatformUnixTime());
+    if (instanceIndex == -1)
+      break;
+    struct invidious_instance *instance = context->instances + instanceIndex;
+    context->instance = instance;
+    if (triedMask != 0) {
+      StringBuilderAppendStringLiteral(sb, "Trying next instance.");
+      StringBuilderAppendStringLiteral(sb, "\n  Instance: ");
+      StringBuilderAppendString(sb, &context->instance->state->hostname);
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string message = StringBuilderFlush(sb);
+      PrintString(&message);
+    }
+    triedMask |= 1u << instanceIndex;
+
+    // memory of every fetch is reused by next one
+    memory_temp tempMemory = MemoryTempBegin(arena);
+    result = InvidiousFetch(context, tempMemory.arena, sb, videos);
+    MemoryTempEnd(&tempMemory);
+    if (result == INVIDIOUS_FETCH_THROTTLED) {
+      // instance is up, it is left alone for as long as it asked
+      u64 now = NowInNanoseconds();
+      u64 waitSeconds = 0;
+      if (instance->throttledUntil > now)
+        waitSeconds = (instance->throttledUntil - now + 999999999) / 1000000000 /* 1e9 */;
+      u64 unixNow = PlatformUnixTime();
+      InstanceListThrottle(&context->instanceList, instance->state, unixNow + waitSeconds, unixNow);
+    } else {
+      // instance that answered with something other than a video is up
+      InstanceListRecord(&context->instanceList, instance->state, 0, result == INVIDIOUS_FETCH_INSTANCE_FAILED,
+                         PlatformUnixTime());
+    }
+
+    u32 leftCount = 0;
+    for (u32 videoIndex = 0; videoIndex < videos->count; videoIndex++) {
+      if (videos->isPrinted[videoIndex])
+        continue;
+      videos->ids[leftCount] = videos->ids[videoIndex];
+      videos->isPrinted[leftCount] = 0;
+      leftCount++;
+    }
+    videos->count = leftCount;
+    if (videos->count == 0)
+      result = INVIDIOUS_FETCH_OK;
+  }
+
+  // ones after last video requested
+  if (result == INVIDIOUS_FETCH_OK)
+    InvidiousPrintWaiting(context, sb);
+  context->givenCount = 0;
+  MemoryTempEnd(&givenMemory);
+  return result;
+}
+
+/*
+ * Fetches videos whose ids are read from file, one on every line, see
+ * src/batch.c. File can be larger than memory or still being written, so ids
+ * are read as requests are answered and sent while others are in flight, see
+ * InvidiousBatchTake(). Lines that are not video ids are counted as failed.
+ * @param path zero terminated, "-" is standard input
+ * @return message is printed on error
+ */
+internalfn enum invidious_fetch_result
+InvidiousFetchBatch(struct invidious_context *context, memory_arena *arena, string_builder *sb, struct string *path)
+{
+  enum { KILOBYTES = (1 << 10) };
+
+  s32 file = PlatformFileOpen(path);
+  if (file == -1) {
+    StringBuilderAppendStringLiteral(sb, "Reading batch file failed.");
+    StringBuilderAppendStringLiteral(sb, "\n  Path: ");
+    StringBuilderAppendString(sb, path);
+    StringBuilderAppendStringLiteral(sb, "\n  error: ");
+    StringBuilderAppendPlatformError(sb);
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return INVIDIOUS_FETCH_FAILED;
+  }
+
+  memory_temp batchMemory = MemoryTempBegin(arena);
+  struct invidious_batch batch = {
+      .file = file,
+      .path = *path,
+      .videoIdBuffer = MemoryArenaPush(batchMemory.arena, INVIDIOUS_BATCH_VIDEO_MAX * INVIDIOUS_VIDEO_ID_LENGTH),
+  };
+  BatchReaderInit(&batch.reader, MakeString(batchMemory.arena, 64 * KILOBYTES));
+  struct invidious_videos videos = {
+      .ids = MemoryArenaPush(batchMemory.arena, sizeof(*videos.ids) * INVIDIOUS_BATCH_VIDEO_MAX),
+      .isPrinted = MemoryArenaPush(batchMemory.arena, sizeof(*videos.isPrinted) * INVIDIOUS_BATCH_VIDEO_MAX),
+      .max = INVIDIOUS_BATCH_VIDEO_MAX,
+  };
+  context->batch = &batch;
+
+  // every video given is printed before room of ids is used again
+  enum invidious_fetch_result result = INVIDIOUS_FETCH_OK;
+  while (result == INVIDIOUS_FETCH_OK && !batch.isEnded) {
+    videos.count = 0;
+    result = InvidiousFetchAll(context, arena, sb, &videos);
+  }
+  if (result == INVIDIOUS_FETCH_OK && batch.isFailed)
+    result = INVIDIOUS_FETCH_FAILED;
+
+  context->batch = 0;
+  MemoryTempEnd(&batchMemory);
+  PlatformFileClose(file);
+  return result;
+}
+
+/*
+ * Prints every result of /api/v1/search response, videos, playlists and
+ * channels alike.
+ * @return false if json is not what is expected, message is printed
+ */
+internalfn b8
+InvidiousPrintSearch(memory_arena *arena, string_builder *sb, struct string *json)
+{
+  // every result has tens of tokens, most of them are thumbnails
+  struct json_parser *jsonParser = MakeJsonParser(arena, 32768);
+  if (IsStringNullOrEmpty(json) || !JsonParse(jsonParser, json)) {
+    StringBuilderAppendStringLiteral(sb, "Json parser failed.");
+    StringBuilderAppendStringLiteral(sb, "\n  error: ");
+    StringBuilderAppendU64(sb, (u64)jsonParser->error);
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return 0;
+  }
+
+  struct json_cursor cursor = JsonCursor(json, jsonParser);
+  if (!JsonCursorIsArray(&cursor)) {
+    StringBuilderAppendStringLiteral(sb, "Got unexpected json from server");
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return 0;
+  }
+
+  b8 isAtEnd = !JsonCursorNext(&cursor);
+  if (isAtEnd)
+    PrintString(&StringFromLiteral("Nothing is found.\n"));
+
+  while (!isAtEnd) {
+    if (!JsonCursorIsObject(&cursor))
+      return 0; // error invalid json
+
+    // channel has author as its title and no video or playlist id
+    struct string type = StringNull();
+    struct string title = StringNull();
+    struct string author = StringNull();
+    struct string id = StringNull();
+    struct string authorId = StringNull();
+
+    u64 resultEnd = JsonCursorExtractToken(&cursor)->end;
+    isAtEnd = !JsonCursorNext(&cursor);
+    while (!isAtEnd && JsonCursorExtractToken(&cursor)->start < resultEnd) {
+      struct string key = JsonCursorExtractString(&cursor);
+      if (!JsonCursorNext(&cursor))
+        return 0; // error invalid json
+
+      if (JsonCursorIsString(&cursor)) {
+        struct string value = JsonCursorExtractString(&cursor);
+        if (IsStringEqual(&key, &StringFromLiteral("type")))
+          type = value;
+        else if (IsStringEqual(&key, &StringFromLiteral("title")))
+          title = value;
+        else if (IsStringEqual(&key, &StringFromLiteral("author")))
+          author = value;
+        else if (IsStringEqual(&key, &StringFromLiteral("videoId")) ||
+                 IsStringEqual(&key, &StringFromLiteral("playlistId")))
+          id = value;
+        else if (IsStringEqual(&key, &StringFromLiteral("authorId")))
+          authorId = value;
+      }
+
+      // value is skipped with everything in it
+      u64 valueEnd = JsonCursorExtractToken(&cursor)->end;
+      do {
+        isAtEnd = !JsonCursorNext(&cursor);
+      } while (!isAtEnd && JsonCursorExtractToken(&cursor)->start < valueEnd);
+    }
+
+    if (IsStringNullOrEmpty(&title))
+      title = author;
+    if (IsStringNullOrEmpty(&id))
+      id = authorId;
+    if (IsStringNullOrEmpty(&type) || IsStringNullOrEmpty(&title) || IsStringNullOrEmpty(&id))
+      return 0; // error invalid json
+
+    StringBuilderAppendStringLiteral(sb, "Id: ");
+    StringBuilderAppendString(sb, &id);
+    StringBuilderAppendStringLiteral(sb, "\n");
+    StringBuilderAppendStringLiteral(sb, "Type: ");
+    StringBuilderAppendString(sb, &type);
+    StringBuilderAppendStringLiteral(sb, "\n");
+    StringBuilderAppendStringLiteral(sb, "Title: ");
+    StringBuilderAppendString(sb, &title);
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+  }
+
+  return 1;
+}
+
+/*
+ * Answer of single request, see InvidiousRequestHttp11() and
+ * InvidiousRequestHttp2().
+ */
+struct invidious_answer {
+  u16 statusCode;
+  // seconds, see "Retry-After"
+  u64 retryAfter;
+  struct string body;
+  // connection can be used for requests after answer
+  b8 isReusable;
+};
+
+/*
+ * Sends one request on HTTP/1.1 connection and reads its answer. Videos are
+ * pipelined instead, see InvidiousFetchHttp11().
+ * @param body collects body of answer, answer->body points into it
+ * @return false on error, message is printed
+ */
+internalfn b8
+InvidiousRequestHttp11(struct invidious_context *context, struct tls_connection *tls, memory_arena *arena,
+                       string_builder *sb, struct http_request_info *requestInfo, struct receive_buffer *body,
+                       struct invidious_answer *answer)
+{
+  requestInfo->version = HTTP_VERSION_11;
+  struct string request = HttpRequestBuild(requestInfo, arena);
+  if (IsStringNull(&request)) {
+    PrintString(&StringFromLiteral("Request is too large.\n"));
+    return 0;
+  }
+  if (!InvidiousWrite(context, tls, &request, sb))
+    return 0;
+
+  struct receive_buffer response = {};
+  if (!ReceiveBufferInit(&response, INVIDIOUS_RESPONSE_RESERVED)) {
+    PrintString(&StringFromLiteral("Not enough memory for responses.\n"));
+    return 0;
+  }
+
+  // streaming parser retires chunk tokens, so chunk data is collected as it arrives
+  struct http_parser *httpParser = MakeHttpStreamingParser(arena, 64);
+  b8 isAnswered = 0;
+  while (!isAnswered) {
+    if (response.length == response.capacity && !ReceiveBufferGrow(&response, response.length + 1)) {
+      PrintString(&StringFromLiteral("Server responded with too large file than we expected\n"));
+      break;
+    }
+
+    s64 ret = TlsConnectionRead(tls, response.value + response.length, response.capacity - response.length);
+    if (ret == TLS_CONNECTION_WOULD_BLOCK) {
+      if (!InvidiousWait(context, sb))
+        break;
+      continue;
+    }
+
+    if (ret < 0) {
+      StringBuilderAppendStringLiteral(sb, "TLS read failed.\n  ");
+      StringBuilderAppendTlsConnectionError(sb, tls);
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string message = StringBuilderFlush(sb);
+      PrintString(&message);
+      break;
+    }
+
+    if (ret == 0) {
+      StringBuilderAppendStringLiteral(sb, "Server closed connection without answering.");
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string message = StringBuilderFlush(sb);
+      PrintString(&message);
+      break;
+    }
+    response.length += (u64)ret;
+
+    b8 ok;
+    b8 isBodyKept = 1;
+    struct string received = StringFromBuffer(response.value, response.length);
+    do {
+      // parser does not consume incomplete lines, so start from where it left
+      struct string packet =
+          StringFromBuffer(response.value + httpParser->position, response.length - httpParser->position);
+      ok = HttpParse(httpParser, &packet);
+
+      for (u32 httpTokenIndex = httpParser->headerTokenCount; httpTokenIndex < httpParser->tokenCount;
+           httpTokenIndex++) {
+        struct http_token *httpToken = httpParser->tokens + httpTokenIndex;
+        if (httpToken->type != HTTP_TOKEN_CHUNK_DATA || httpToken->end == 0)
+          continue;
+
+        struct string data = HttpTokenExtractString(httpToken, &received);
+        if (!ReceiveBufferAppend(body, &data))
+          isBodyKept = 0;
+      }
+    } while (httpParser->error == HTTP_PARSER_ERROR_PAUSED);
+
+    if (!isBodyKept) {
+      PrintString(&StringFromLiteral("Server responded with too large file than we expected\n"));
+      break;
+    }
+
+    if (!ok) {
+      if (httpParser->error == HTTP_PARSER_ERROR_PARTIAL) {
+        // body is read in place, buffer grows once when its length is known
+        if (!ReceiveBufferGrow(&response, HttpParserResponseLength(httpParser))) {
+          PrintString(&StringFromLiteral("Server responded with too large file than we expected\n"));
+          break;
+        }
+        continue; // wait for more data
+      }
+
+      StringBuilderAppendStringLiteral(sb, "Http parser failed.");
+      StringBuilderAppendStringLiteral(sb, "\n     error: ");
+      StringBuilderAppendHttpParserError(sb, httpParser->error);
+      StringBuilderAppendStringLiteral(sb, "\n  position: ");
+      StringBuilderAppendU64(sb, httpParser->position);
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string message = StringBuilderFlush(sb);
+      PrintString(&message);
+      break;
+    }
+
+    if (!(httpParser->state & HTTP_PARSER_STATE_HAS_CHUNKED_ENCODED_BODY) &&
+        (httpParser->state & HTTP_PARSER_STATE_HAS_CONTENT_LENGTH_BODY)) {
+      struct http_token *lastHttpToken = httpParser->tokens + httpParser->tokenCount - 1;
+      struct string content = HttpTokenExtractString(lastHttpToken, &received);
+      if (!ReceiveBufferAppend(body, &content)) {
+        PrintString(&StringFromLiteral("Not enough memory for responses.\n"));
+        break;
+      }
+    }
+
+    answer->statusCode = httpParser->statusCode;
+    answer->retryAfter = INVIDIOUS_RETRY_AFTER_DEFAULT;
+    if (httpParser->state & HTTP_PARSER_STATE_HAS_RETRY_AFTER)
+      answer->retryAfter = httpParser->retryAfter;
+    answer->body = StringFromBuffer(body->value, body->length);
+    answer->isReusable =
+        !(httpParser->state & HTTP_PARSER_STATE_CONNECTION_CLOSE) && httpParser->position == response.length;
+    isAnswered = 1;
+  }
+
+  ReceiveBufferRelease(&response);
+  return isAnswered;
+}
+
+/*
+ * Sends one request on HTTP/2 connection that is set up for it, and reads its
+ * answer. Connection is not kept, like ones of probes.
+ * @param body stream writes body of answer in it, answer->body points into it
+ * @return false on error, message is printed
+ */
+internalfn b8
+InvidiousRequestHttp2(struct invidious_context *context, struct tls_connection *tls, memory_arena *arena,
+                      string_builder *sb, struct http_request_info *requestInfo, struct receive_buffer *body,
+                      struct invidious_answer *answer)
+{
+  enum {
+    KILOBYTES = (1 << 10),
+    // must hold at least one frame
+    RECEIVE_RING_LENGTH = 64 * KILOBYTES,
+  };
+
+  struct ring_buffer *ring = &context->http2Ring;
+  if (!ring->value && !RingBufferInit(ring, RECEIVE_RING_LENGTH)) {
+    PrintString(&StringFromLiteral("Not enough memory for responses.\n"));
+    return 0;
+  }
+  // left by connection that failed
+  ring->start = 0;
+  ring->length = 0;
+
+  requestInfo->version = HTTP_VERSION_20;
+  struct http2_connection *connection = MakeHttp2Connection(arena, 1, 32);
+  Http2Start(connection);
+  struct http2_stream *stream = Http2Request(connection, requestInfo, arena, body);
+  if (!stream) {
+    PrintString(&StringFromLiteral("Request is too large.\n"));
+    return 0;
+  }
+
+  while (stream->state != HTTP2_STREAM_STATE_CLOSED) {
+    // request first, then settings and window updates that answer server
+    struct string output = Http2Flush(connection);
+    if (output.length != 0 && !InvidiousWrite(context, tls, &output, sb))
+      return 0;
+
+    if (connection->error != HTTP2_ERROR_NONE) {
+      StringBuilderAppendStringLiteral(sb, "HTTP/2 connection failed.");
+      StringBuilderAppendStringLiteral(sb, "\n  error: ");
+      StringBuilderAppendHttp2Error(sb, connection->error);
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string message = StringBuilderFlush(sb);
+      PrintString(&message);
+      return 0;
+    }
+
+    struct string space = RingBufferSpace(ring);
+    s64 ret = TlsConnectionRead(tls, space.value, space.length);
+    if (ret == TLS_CONNECTION_WOULD_BLOCK) {
+      if (!InvidiousWait(context, sb))
+        return 0;
+      continue;
+    }
+
+    if (ret < 0) {
+      StringBuilderAppendStringLiteral(sb, "TLS read failed.\n  ");
+      StringBuilderAppendTlsConnectionError(sb, tls);
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string message = StringBuilderFlush(sb);
+      PrintString(&message);
+      return 0;
+    }
+
+    if (ret == 0) {
+      StringBuilderAppendStringLiteral(sb, "Server closed connection without answering.");
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string message = StringBuilderFlush(sb);
+      PrintString(&message);
+      return 0;
+    }
+    ring->length += (u64)ret;
+
+    // connection consumes complete frames only, GOAWAY is in output when it fails
+    struct string packet = RingBufferData(ring);
+    Http2Receive(connection, &packet);
+    RingBufferConsume(ring, connection->position);
+    connection->position = 0;
+  }
+
+  if (stream->error != HTTP2_ERROR_NONE) {
+    StringBuilderAppendStringLiteral(sb, "HTTP/2 stream failed.");
+    StringBuilderAppendStringLiteral(sb, "\n  error: ");
+    StringBuilderAppendHttp2Error(sb, stream->error);
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return 0;
+  }
+
+  answer->statusCode = stream->statusCode;
+  answer->retryAfter = InvidiousHttp2RetryAfter(stream);
+  answer->body = Http2StreamBody(stream);
+  answer->isReusable = 0;
+  return 1;
+}
+
+/*
+ * Searches on instance that context points to, on HTTP/2 when server speaks
+ * it, and prints what is found.
+ * @param query as it is typed, it is percent-encoded in request
+ * @return message is printed on error
+ */
+internalfn enum invidious_fetch_result
+InvidiousSearchFetch(struct invidious_context *context, memory_arena *arena, string_builder *sb,
+                     struct string *query)
+{
+  if (!InvidiousResolveFinish(context, context->instance, arena)) {
+    StringBuilderAppendStringLiteral(sb, "Resolving hostname failed.");
+    StringBuilderAppendStringLiteral(sb, "\n  Instance: ");
+    StringBuilderAppendString(sb, &context->instance->state->hostname);
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return INVIDIOUS_FETCH_INSTANCE_FAILED;
+  }
+
+  context->activeAt = NowInNanoseconds();
+  struct pooled_connection *pooled = InvidiousConnect(context, sb);
+  if (!pooled)
+    return INVIDIOUS_FETCH_INSTANCE_FAILED;
+
+  // https://docs.invidious.io/api/#get-apiv1search
+  struct http_form_urlencoded_item queryItem = {
+      .name = StringFromLiteral("q"),
+      .value = *query,
+  };
+  struct http_form_urlencoded_list queryList = {
+      .itemCount = 1,
+      .items = &queryItem,
+  };
+  struct http_request_info requestInfo = {
+      .method = HTTP_METHOD_GET,
+      .host = context->instance->state->hostname,
+      .path = StringFromLiteral("/api/v1/search"),
+      .query = &queryList,
+      .accept = HTTP_CONTENT_TYPE_JSON,
+  };
+
+  struct receive_buffer body = {};
+  struct invidious_answer answer = {};
+  b8 isAnswered = 0;
+  if (!ReceiveBufferInit(&body, INVIDIOUS_RESPONSE_RESERVED)) {
+    PrintString(&StringFromLiteral("Not enough memory for responses.\n"));
+  } else {
+    struct string protocol = TlsBackendAlpnProtocol(&pooled->tls.backend);
+    if (IsStringEqual(&protocol, &StringFromLiteral("h2")))
+      isAnswered = InvidiousRequestHttp2(context, &pooled->tls, arena, sb, &requestInfo, &body, &answer);
+    else
+      isAnswered = InvidiousRequestHttp11(context, &pooled->tls, arena, sb, &requestInfo, &body, &answer);
+  }
+  ConnectionPoolRelease(&context->pool, pooled, isAnswered && answer.isReusable, NowInNanoseconds());
+
+  enum invidious_fetch_result result = INVIDIOUS_FETCH_OK;
+  u64 now = NowInNanoseconds();
+  if (!isAnswered) {
+    result = INVIDIOUS_FETCH_INSTANCE_FAILED;
+  } else if (InvidiousRecordResponse(context->instance, sb, answer.statusCode, answer.retryAfter, 0, now)) {
+    result = INVIDIOUS_FETCH_THROTTLED;
+  } else if (answer.statusCode != 200) {
+    StringBuilderAppendStringLiteral(sb, "Search failed.");
+    StringBuilderAppendStringLiteral(sb, "\n  Status: ");
+    StringBuilderAppendU64(sb, answer.statusCode);
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    // instance is down, another one may answer
+    result = answer.statusCode >= 500 ? INVIDIOUS_FETCH_INSTANCE_FAILED : INVIDIOUS_FETCH_FAILED;
+  } else if (!InvidiousPrintSearch(arena, sb, &answer.body)) {
+    result = INVIDIOUS_FETCH_FAILED;
+  }
+
+  ReceiveBufferRelease(&body);
+  return result;
+}
+
+/*
+ * Search goes to best instance, and to next best when it is not answered,
+ * like videos do, see InvidiousFetchAll().
+ * @return message is printed on error
+ */
+internalfn enum invidious_fetch_result
+InvidiousSearch(struct invidious_context *context, memory_arena *arena, string_builder *sb, struct string *query)
+{
+  enum invidious_fetch_result result = INVIDIOUS_FETCH_INSTANCE_FAILED;
+  u32 triedMask = 0;
+  while (result == INVIDIOUS_FETCH_INSTANCE_FAILED || result == INVIDIOUS_FETCH_THROTTLED) {
+    s32 instanceIndex = InstanceListPick(&context->instanceList, triedMask, PlatformUnixTime());
+    if (instanceIndex == -1)
+      break;
+    struct invidious_instance *instance = context->instances + instanceIndex;
+    context->instance = instance;
+    if (triedMask != 0) {
+      StringBuilderAppendStringLiteral(sb, "Trying next instance.");
+      StringBuilderAppendStringLiteral(sb, "\n  Instance: ");
+      StringBuilderAppendString(sb, &context->instance->state->hostname);
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string message = StringBuilderFlush(sb);
+      PrintString(&message);
+    }
+    triedMask |= 1u << instanceIndex;
+
+    memory_temp tempMemory = MemoryTempBegin(arena);
+    result = InvidiousSearchFetch(context, tempMemory.arena, sb, query);
+    MemoryTempEnd(&tempMemory);
+    if (result == INVIDIOUS_FETCH_THROTTLED) {
+      // instance is up, it is left alone for as long as it asked
+      u64 now = NowInNanoseconds();
+      u64 waitSeconds = 0;
+      if (instance->throttledUntil > now)
+        waitSeconds = (instance->throttledUntil - now + 999999999) / 1000000000 /* 1e9 */;
+      u64 unixNow = PlatformUnixTime();
+      InstanceListThrottle(&context->instanceList, instance->state, unixNow + waitSeconds, unixNow);
+    } else {
+      InstanceListRecord(&context->instanceList, instance->state, 0, result == INVIDIOUS_FETCH_INSTANCE_FAILED,
+                         PlatformUnixTime());
+    }
+  }
+  return result;
+}
+
+internalfn struct string
+InvidiousOptionsErrorString(enum options_error error)
+{
+  switch (error) {
+  case OPTIONS_ERROR_INSTANCE_REQUIRED:
+    return StringFromLiteral("Instance is required.");
+  case OPTIONS_ERROR_INSTANCE_INVALID:
+    return StringFromLiteral("Instance is invalid.");
+  case OPTIONS_ERROR_INSTANCE_TOO_MANY:
+    return StringFromLiteral("Too many instances.");
+  case OPTIONS_ERROR_VIDEO_INVALID:
+    return StringFromLiteral("Video id is invalid.");
+  case OPTIONS_ERROR_SEARCH_REQUIRED:
+    return StringFromLiteral("Search query is required.");
+  case OPTIONS_ERROR_SEARCH_INVALID:
+    return StringFromLiteral("Search query is invalid.");
+  case OPTIONS_ERROR_BATCH_REQUIRED:
+    return StringFromLiteral("Batch file is required.");
+  case OPTIONS_ERROR_CONCURRENCY_INVALID:
+    return StringFromLiteral("Concurrency must be a positive number.");
+  default:
+    return StringFromLiteral("Options are invalid.");
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  enum {
+    KILOBYTES = (1 << 10),
+    MEGABYTES = (1 << 20),
+  };
+
+  struct invidious_context context = {};
+  u8 stackBuf[2 * MEGABYTES];
+  memory_arena stackMemory = {
+      .block = stackBuf,
+      .total = ARRAY_COUNT(stackBuf),
+  };
+
+  // answers of videos are flushed from it, so ones that are waited for fit in room video table sets aside
+  string_builder *sb = MakeStringBuilder(&stackMemory, VIDEO_TABLE_WAITED_ANSWER_MAX, 32);
+
+  // instances, i.iii.st when none is given
+  struct options options;
+  OptionsInit(&options);
+  // video ids, one request is sent for each
+  options.videoIds = MemoryArenaPush(&stackMemory, sizeof(*options.videoIds) * (u32)argc);
+  enum options_error optionsError = OptionsParse(&options, (u32)argc, argv);
+  if (optionsError == OPTIONS_ERROR_HELP) {
+    struct string usage = StringFromLiteral(
+        "usage: invidious [options] [video id or url ...]\n"
+        "  -i, --instance url      instance to ask, can be given many times\n"
+        "  --instance-file path    instances, one on every line\n"
+        "  -s, --search query      videos found by query are printed\n"
+        "  --batch path            video ids, one on every line, - is standard input\n"
+        "  --concurrency n         requests in flight at once\n"
+        "  --unordered             videos are printed as they are answered\n"
+        "  --hedge                 late requests are sent again to another instance\n"
+        "  --timing                phases of every request are printed\n"
+        "  --kernel-tls            records of idle connections are handed to kernel\n");
+    PrintString(&usage);
+    return 0;
+  }
+  // nothing given, default video is fetched
+  if (optionsError == OPTIONS_ERROR_VIDEO_REQUIRED) {
+    options.videoIds[0] = StringFromLiteral("d_oVysaqG_0");
+    options.videoIdCount = 1;
+    optionsError = OPTIONS_ERROR_NONE;
+  }
+  if (optionsError != OPTIONS_ERROR_NONE) {
+    struct string errorMessage = InvidiousOptionsErrorString(optionsError);
+    StringBuilderAppendString(sb, &errorMessage);
+    if (!IsStringNull(&options.invalidArgument)) {
+      StringBuilderAppendStringLiteral(sb, "\n  Argument: ");
+      StringBuilderAppendString(sb, &options.invalidArgument);
+    }
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return 1;
+  }
+
+  // one instance on every line, after ones given as arguments
+  if (!IsStringNull(&options.instanceFile)) {
+    // instances point into it, so it is kept until exit
+    struct string buffer = {.value = MemoryArenaPush(&stackMemory, 64 * KILOBYTES), .length = 64 * KILOBYTES};
+    struct string content = PlatformReadFile(&buffer, &options.instanceFile);
+    // file that fills buffer is likely cut
+    if (content.length == buffer.length)
+      content = StringNull();
+    enum options_error instanceFileError = OPTIONS_ERROR_INSTANCE_INVALID;
+    if (!IsStringNull(&content))
+      instanceFileError = OptionsAddInstanceList(&options, &content);
+    if (instanceFileError != OPTIONS_ERROR_NONE) {
+      if (IsStringNull(&content))
+        StringBuilderAppendStringLiteral(sb, "Reading instance file failed.");
+      else if (instanceFileError == OPTIONS_ERROR_INSTANCE_TOO_MANY)
+        StringBuilderAppendStringLiteral(sb, "Too many instances.");
+      else
+        StringBuilderAppendStringLiteral(sb, "Instance is invalid.");
+      StringBuilderAppendStringLiteral(sb, "\n  Path: ");
+      StringBuilderAppendString(sb, &options.instanceFile);
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string message = StringBuilderFlush(sb);
+      PrintString(&message);
+      return 1;
+    }
+  }
+  u32 videoIdCount = options.videoIdCount;
+  struct string *videoIds = options.videoIds;
+
+  InstanceListInit(&context.instanceList, &stackMemory);
+  for (u32 instanceIndex = 0; instanceIndex < options.instanceCount; instanceIndex++) {
+    struct options_instance *given = options.instances + instanceIndex;
+    u32 instanceCount = context.instanceList.instanceCount;
+    struct instance *added = InstanceListAdd(&context.instanceList, &given->hostname, &given->port);
+    if (!added) {
+      StringBuilderAppendStringLiteral(sb, "Instance is invalid.");
+      StringBuilderAppendStringLiteral(sb, "\n  Instance: ");
+      StringBuilderAppendString(sb, &given->hostname);
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string message = StringBuilderFlush(sb);
+      PrintString(&message);
+      return 1;
+    }
+    // same hostname and port over TLS and plain TCP are one instance, first one given wins
+    if (context.instanceList.instanceCount != instanceCount)
+      context.instances[instanceCount].isPlain = given->isPlain;
+  }
+  // limit starts where connections and pipelines allow, it is lowered when instance slows down
+  u32 limitMax = INVIDIOUS_HTTP11_CONNECTION_MAX * INVIDIOUS_HTTP11_PIPELINE_DEPTH_MAX;
+  if (options.requestMax != 0)
+    limitMax = options.requestMax;
+  for (u32 instanceIndex = 0; instanceIndex < context.instanceList.instanceCount; instanceIndex++) {
+    context.instances[instanceIndex].state = context.instanceList.instances + instanceIndex;
+    ConcurrencyLimitInit(&context.instances[instanceIndex].limit, limitMax);
+  }
+  InvidiousLoadInstances(&context, &stackMemory);
+
+  // answers are waited for after TLS is set up, for instances that are
+  // probed and one that is likely picked
+  InvidiousLoadDnsCache(&context, &stackMemory);
+  {
+    u64 now = PlatformUnixTime();
+    s32 pickedIndex = InstanceListPick(&context.instanceList, 0, now);
+    for (u32 instanceIndex = 0; instanceIndex < context.instanceList.instanceCount; instanceIndex++) {
+      struct invidious_instance *instance = context.instances + instanceIndex;
+      if ((s32)instanceIndex == pickedIndex || (context.instanceList.instanceCount > 1 && options.isHedging) ||
+          (context.instanceList.instanceCount > 1 && IsInstanceProbeDue(instance->state, now)))
+        InvidiousResolveStart(&context, instance);
+    }
+  }
+
+  // duplicates of late requests go on connections of their own
+  u32 connectionMax = INVIDIOUS_HTTP11_CONNECTION_MAX + (options.isHedging ? INVIDIOUS_HEDGE_MAX : 0);
+
+  // TLS records are at most 16 KiB, mbedtls/ssl.h:MBEDTLS_SSL_OUT_CONTENT_LEN
+  struct platform_transport_options transportOptions = {
+      .receiveBufferCount = 128,
+      .receiveBufferLength = 16 * KILOBYTES,
+      // two for every connection
+      .sendBufferCount = 2 * connectionMax,
+      .sendBufferLength = 17 * KILOBYTES,
+      // kernel can take records only on epoll, see PlatformTransportKernelTls()
+      .isIoUringDisabled = options.isKernelTls,
+  };
+  context.isKernelTls = options.isKernelTls;
+  // phases of every video are printed, always in debug builds
+  context.isTiming = options.isTiming || IS_BUILD_DEBUG;
+  context.isBatch = !IsStringNull(&options.batchFile);
+  context.requestMax = options.requestMax;
+  context.isUnordered = options.isUnordered;
+  context.isHedging = options.isHedging;
+  HedgeBudgetInit(&context.hedgeBudget, INVIDIOUS_HEDGE_PERCENT);
+  if (!PlatformTransportOpen(&context.transport, &transportOptions)) {
+    StringBuilderAppendStringLiteral(sb, "Creating event loop failed.\n  error: ");
+    StringBuilderAppendPlatformError(sb);
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return 1;
+  }
+
+  // TLS Setup
+  u64 tlsMemorySize = TlsBackendMemorySize(connectionMax);
+  memory_arena tlsMemory = {};
+  if (tlsMemorySize != 0)
+    tlsMemory = PlatformMemoryAllocate(tlsMemorySize);
+  if ((tlsMemorySize != 0 && !tlsMemory.block) || !TlsBackendStartup(tlsMemory.block ? &tlsMemory : 0)) {
+    StringBuilderAppendStringLiteral(sb, "Setting up TLS library failed.");
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return 1;
+  }
+
+  // HTTP/2 when server supports it, HTTP/1.1 otherwise
+  const char *alpnProtocols[] = {"h2", "http/1.1", 0};
+  struct tls_backend_options tlsOptions = {
+      .alpnProtocols = alpnProtocols,
+  };
+
+  // Load system CA
+  struct string systemCAPath = StringFromLiteral("/etc/ssl/certs/ca-certificates.crt");
+  memory_temp caMemory = MemoryTempBegin(&stackMemory);
+  if (InvidiousLoadCaStore(&context, &systemCAPath, &stackMemory)) {
+    tlsOptions.caStore = &context.caStore;
+  } else {
+    u64 systemCALength = PlatformFileSize(&systemCAPath);
+    if (systemCALength == 0) {
+      StringBuilderAppendStringLiteral(sb, "CA certificates not found or invalid on system.");
+      StringBuilderAppendStringLiteral(sb, "\n  Path: ");
+      StringBuilderAppendString(sb, &systemCAPath);
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string message = StringBuilderFlush(sb);
+      PrintString(&message);
+      return 1;
+    }
+
+    systemCALength += 1; // zero-termination
+    struct string buffer = {
+        .length = systemCALength,
+        .value = MemoryArenaPushAligned(caMemory.arena, systemCALength, 32),
+    };
+
+    struct string systemCA = PlatformReadFile(&buffer, &systemCAPath);
+    if (IsStringNullOrEmpty(&systemCA)) {
+      StringBuilderAppendStringLiteral(sb, "Reading CA certificates from system failed.");
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string message = StringBuilderFlush(sb);
+      PrintString(&message);
+      return 1;
+    }
+
+    systemCA = StringStripWhitespace(&systemCA);
+    // PEM is given with zero termination
+    systemCA.value[systemCA.length] = 0;
+    systemCA.length += 1;
+    tlsOptions.roots = systemCA;
+  }
+
+  s32 tlsError;
+  b8 isTlsConfigured = TlsBackendConfigInit(&context.tlsConfig, &tlsOptions, &tlsError);
+  // roots are parsed by now
+  MemoryTempEnd(&caMemory);
+  if (!isTlsConfigured) {
+    StringBuilderAppendStringLiteral(sb, "TLS configuration failed.");
+    StringBuilderAppendStringLiteral(sb, "\n  ");
+    StringBuilderAppendTlsBackendError(sb, tlsError);
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return 1;
+  }
+
+  /*
+  struct http_request_info requestInfo = {
+      .method = HTTP_METHOD_POST,
+      .version = HTTP_VERSION_20,
+      .url = url,
+
+      .contentType = HTTP_CONTENT_TYPE_JSON,
+      .content = json,
+
+      .contentType = HTTP_CONTENT_TYPE_FORM_URLENCODED,
+      .content =
+          (struct http_form_urlencoded_list){
+              .count = 1,
+              .items =
+                  (struct http_form_urlencoded_item[]){
+                      {
+                          .name = StringFromLiteral("id"),
+                          .value = StringFromLiteral("rZpvPY4V0mciNHBPifitWVlJPaHFIg9Q"),
+                      },
+                  },
+          },
+  };
+  */
+
+  struct connection_pool_options poolOptions = {
+      .connectionMax = connectionMax,
+      .hostMax = INSTANCE_MAX,
+      .hostConnectionMax = INVIDIOUS_HTTP11_CONNECTION_MAX,
+      // shorter than servers usually keep idle connections open
+      .idleTimeoutInMilliseconds = 30 * 1000,
+      .sessionCache = &context.sessionCache,
+  };
+  InvidiousLoadSessions(&context, &stackMemory);
+  ConnectionPoolInit(&context.pool, &stackMemory, &context.transport, &context.tlsConfig, &poolOptions);
+
+  memory_arena fetchMemory = PlatformMemoryAllocate(8 * MEGABYTES);
+  if (!fetchMemory.block) {
+    StringBuilderAppendStringLiteral(sb, "Not enough memory for requests.");
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return 1;
+  }
+
+  // answers are kept for whole run, videos given again are not requested.
+  // Room for answers is address space, pages are committed as they come.
+  u32 videoEntryMax = 0;
+  if (context.isBatch) {
+    videoEntryMax = INVIDIOUS_VIDEO_ENTRY_MAX;
+  } else if (videoIdCount > 1) {
+    videoEntryMax = 16;
+    while (videoEntryMax < 2 * videoIdCount)
+      videoEntryMax *= 2;
+  }
+  memory_arena videoMemory = {};
+  if (videoEntryMax != 0)
+    videoMemory = PlatformMemoryAllocate(VideoTableMemoryLength(videoEntryMax));
+  VideoTableInit(&context.videoTable, &videoMemory, videoMemory.block ? videoEntryMax : 0);
+
+  InvidiousProbeInstances(&context, &fetchMemory);
+
+  // videos given as arguments go before ones in batch
+  enum invidious_fetch_result result = INVIDIOUS_FETCH_OK;
+  if (videoIdCount != 0) {
+    struct invidious_videos videos = {
+        .ids = videoIds,
+        .isPrinted = MemoryArenaPush(&stackMemory, sizeof(b8) * videoIdCount),
+        .count = videoIdCount,
+        .max = videoIdCount,
+    };
+    result = InvidiousFetchAll(&context, &fetchMemory, sb, &videos);
+  }
+  if (result == INVIDIOUS_FETCH_OK && context.isBatch)
+    result = InvidiousFetchBatch(&context, &fetchMemory, sb, &options.batchFile);
+  if (result == INVIDIOUS_FETCH_OK && !IsStringNull(&options.search))
+    result = InvidiousSearch(&context, &fetchMemory, sb, &options.search);
+
+  ConnectionPoolClose(&context.pool);
+  RingBufferRelease(&context.http2Ring);
+  for (u32 bufferIndex = 0; bufferIndex < INVIDIOUS_HTTP2_STREAM_MAX; bufferIndex++)
+    ReceiveBufferRelease(context.http2StreamBuffers + bufferIndex);
+  InvidiousSaveSessions(&context, &stackMemory);
+  InvidiousSaveInstances(&context, &stackMemory);
+
+  // percentiles of phases, for telling slow instance from slow client
+  if (context.isTiming && context.timingHistogram.requestCount > 1) {
+    StringBuilderAppendRequestTimingHistogram(sb, &context.timingHistogram, &StringFromLiteral("timing_histogram "));
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+  }
+
+  if (result != INVIDIOUS_FETCH_OK || context.failedCount != 0)
+    return 1;
+
 #if IS_BUILD_DEBUG
   {
     StringBuilderAppendStringLiteral(sb, "Memory total:  ");
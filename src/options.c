@@ -1,12 +1,239 @@
 #include "options.h"
+#include "percent_encoding.h"
 #include "string_cursor.h"
 
 internalfn void
 OptionsInit(struct options *options)
 {
-  options->hostname = StringFromLiteral("i.iii.st");
-  options->port = StringFromLiteral("443");
-  options->videoId = StringNull();
+  options->instances[0] = (struct options_instance){
+      .hostname = StringFromLiteral("i.iii.st"),
+      .port = StringFromLiteral("443"),
+  };
+  options->instanceCount = 1;
+  options->isInstanceDefault = 1;
+  options->instanceFile = StringNull();
+  options->videoIds = 0;
+  options->videoIdCount = 0;
+  options->batchFile = StringNull();
+  options->requestMax = 0;
+  options->isUnordered = 0;
+  options->isHedging = 0;
+  options->search = StringNull();
+  options->isKernelTls = 0;
+  options->isTiming = 0;
+  options->invalidArgument = StringNull();
+}
+
+/*
+ * Adds instance to list, as url or domain.
+ *   https://{domain}[:{port}][/...]
+ *   http://{domain}[:{port}][/...]
+ *   {domain}[:{port}]
+ * Domain can be IPv6 address in brackets, e.g. [::1]:8443.
+ */
+internalfn enum options_error
+OptionsAddInstance(struct options *options, struct string *instance)
+{
+  string text = StringStripWhitespace(instance);
+  string port = StringFromLiteral("443");
+  b8 isPlain = 0;
+
+  string_cursor cursor = StringCursorFromString(&text);
+  string schemeSeparator = StringFromLiteral("://");
+  string scheme = StringCursorExtractUntil(&cursor, &schemeSeparator);
+  if (!IsStringNull(&scheme)) {
+    if (IsStringEqual(&scheme, &StringFromLiteral("http"))) {
+      port = StringFromLiteral("80");
+      isPlain = 1;
+    } else if (!IsStringEqual(&scheme, &StringFromLiteral("https")))
+      return OPTIONS_ERROR_INSTANCE_INVALID;
+    cursor.position += scheme.length + schemeSeparator.length;
+  }
+
+  string authority = StringCursorExtractUntilOrRest(&cursor, &StringFromLiteral("/"));
+  string_cursor authorityCursor = StringCursorFromString(&authority);
+  string domain;
+  if (StringCursorPeekStartsWith(&authorityCursor, &StringFromLiteral("["))) {
+    authorityCursor.position += 1;
+    domain = StringCursorExtractUntil(&authorityCursor, &StringFromLiteral("]"));
+    if (IsStringNull(&domain))
+      return OPTIONS_ERROR_INSTANCE_INVALID;
+    authorityCursor.position += domain.length + 1;
+  } else {
+    domain = StringCursorExtractUntilOrRest(&authorityCursor, &StringFromLiteral(":"));
+    authorityCursor.position += domain.length;
+  }
+
+  if (!IsStringCursorAtEnd(&authorityCursor)) {
+    if (!IsStringCursorStartsWith(&authorityCursor, &StringFromLiteral(":")))
+      return OPTIONS_ERROR_INSTANCE_INVALID;
+    port = StringCursorExtractRemaining(&authorityCursor);
+  }
+
+  u64 portNumber;
+  if (domain.length == 0 || port.length > 5 || !ParseU64(&port, &portNumber) || portNumber == 0 ||
+      portNumber > 0xffff)
+    return OPTIONS_ERROR_INSTANCE_INVALID;
+  for (u64 index = 0; index < domain.length; index++) {
+    u8 character = domain.value[index];
+    if (character <= ' ' || character == '/' || character == '@' || character >= 0x7f)
+      return OPTIONS_ERROR_INSTANCE_INVALID;
+  }
+
+  // Write
+  if (options->isInstanceDefault) {
+    options->instanceCount = 0;
+    options->isInstanceDefault = 0;
+  }
+  for (u32 instanceIndex = 0; instanceIndex < options->instanceCount; instanceIndex++) {
+    struct options_instance *added = options->instances + instanceIndex;
+    if (IsStringEqual(&added->hostname, &domain) && IsStringEqual(&added->port, &port) && added->isPlain == isPlain)
+      return OPTIONS_ERROR_NONE;
+  }
+  if (options->instanceCount == OPTIONS_INSTANCE_MAX)
+    return OPTIONS_ERROR_INSTANCE_TOO_MANY;
+  options->instances[options->instanceCount] = (struct options_instance){
+      .hostname = domain,
+      .port = port,
+      .isPlain = isPlain,
+  };
+  options->instanceCount++;
+  return OPTIONS_ERROR_NONE;
+}
+
+/*
+ * Adds instances in content of instance file, one on every line, see
+ * OptionsAddInstance(). Empty lines and lines starting with # are skipped.
+ * Instances point into content.
+ */
+internalfn enum options_error
+OptionsAddInstanceList(struct options *options, struct string *content)
+{
+  string_cursor cursor = StringCursorFromString(content);
+  string newline = StringFromLiteral("\n");
+  while (!IsStringCursorAtEnd(&cursor)) {
+    string line = StringCursorConsumeUntilOrRest(&cursor, &newline);
+    StringCursorConsumeThrough(&cursor, &newline);
+
+    line = StringStripWhitespace(&line);
+    if (line.length == 0 || line.value[0] == '#')
+      continue;
+
+    enum options_error error = OptionsAddInstance(options, &line);
+    if (error != OPTIONS_ERROR_NONE)
+      return error;
+  }
+  return OPTIONS_ERROR_NONE;
+}
+
+/*
+ * Finds search query in url.
+ *   https://www.youtube.com/results?search_query={query}
+ *   https://{instance}/search?q={query}
+ * @return query, still percent-encoded
+ *         null if url is not a search url
+ */
+internalfn struct string
+OptionsSearchFromUrl(struct string *url)
+{
+  string_cursor cursor = StringCursorFromString(url);
+  string path = StringCursorConsumeThrough(&cursor, &StringFromLiteral("/results?"));
+  if (IsStringNull(&path)) {
+    cursor = StringCursorFromString(url);
+    path = StringCursorConsumeThrough(&cursor, &StringFromLiteral("/search?"));
+    if (IsStringNull(&path))
+      return StringNull();
+  }
+
+  string parameters = StringCursorExtractUntilOrRest(&cursor, &StringFromLiteral("#"));
+  string_cursor parametersCursor = StringCursorFromString(&parameters);
+  string parameterSeparator = StringFromLiteral("&");
+  string pairSeparator = StringFromLiteral("=");
+  while (!IsStringCursorAtEnd(&parametersCursor)) {
+    string parameter = StringCursorConsumeUntilOrRest(&parametersCursor, &parameterSeparator);
+    StringCursorConsumeThrough(&parametersCursor, &parameterSeparator);
+
+    string_cursor parameterCursor = StringCursorFromString(&parameter);
+    string name = StringCursorConsumeUntilOrRest(&parameterCursor, &pairSeparator);
+    if (!IsStringEqual(&name, &StringFromLiteral("search_query")) && !IsStringEqual(&name, &StringFromLiteral("q")))
+      continue;
+
+    StringCursorConsumeThrough(&parameterCursor, &pairSeparator);
+    return StringCursorExtractRemaining(&parameterCursor);
+  }
+
+  return StringNull();
+}
+
+/*
+ * Finds video id in argument, it is id itself or url of video.
+ *   {videoId}
+ *   https://www.youtube.com/watch?v={videoId}
+ *   https://www.youtube.com/embed/{videoId}
+ *   https://youtu.be/{videoId}
+ * @return id, points into argument
+ *         null if argument is not a valid video id
+ */
+internalfn struct string
+OptionsVideoIdFromArgument(struct string *argument)
+{
+  string_cursor cursor = StringCursorFromString(argument);
+
+  // https://developer.mozilla.org/en-US/docs/Learn_web_development/Howto/Web_mechanics/What_is_a_URL#basics_anatomy_of_a_url
+  // https://www.youtube.com/watch?v={videoId}
+  // https://www.youtube.com/embed/{videoId}
+  // https://youtu.be/{videoId}
+
+  string pathSeparator = StringFromLiteral("/");
+  StringCursorConsumeThroughLast(&cursor, &pathSeparator);
+
+  string parameterKeyV = StringFromLiteral("v=");
+  StringCursorConsumeThrough(&cursor, &parameterKeyV);
+
+  string videoId = StringCursorExtractRemaining(&cursor);
+
+  string parameterSeparator = StringFromLiteral("&");
+  string beforeParameterSeparator = StringCursorExtractUntil(&cursor, &parameterSeparator);
+  b8 isParameterSeperatorFound = !IsStringNull(&beforeParameterSeparator);
+  if (isParameterSeperatorFound)
+    videoId = beforeParameterSeparator;
+
+  if (!isParameterSeperatorFound) {
+    string anchorSeparator = StringFromLiteral("#");
+    string beforeAnchorSeparator = StringCursorExtractUntil(&cursor, &anchorSeparator);
+    if (!IsStringNull(&beforeAnchorSeparator))
+      videoId = beforeAnchorSeparator;
+  }
+
+  // validate video id
+  if (videoId.length != 11)
+    return StringNull();
+  for (u32 index = 0; index < videoId.length; index++) {
+    b8 allowed[U8_MAX] = {
+        // A-Z a-z 0-9 - _
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x00
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x10
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, // 0x20
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, // 0x30
+        0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x40
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 1, // 0x50
+        0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x60
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, // 0x70
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x80
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x90
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0xa0
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0xb0
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0xc0
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0xd0
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0xe0
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0     // 0xf0
+    };
+    u8 character = *(videoId.value + index);
+    if (!allowed[character])
+      return StringNull();
+  }
+
+  return videoId;
 }
 
 internalfn enum options_error
@@ -15,122 +242,117 @@ OptionsParse(struct options *options, u32 argumentCount, char **arguments)
   for (u32 argumentIndex = 1; argumentIndex < argumentCount; argumentIndex++) {
     struct string argument = StringFromZeroTerminated((u8 *)arguments[argumentIndex], 1024);
     argument = StringStripWhitespace(&argument);
+    struct string searchInUrl = OptionsSearchFromUrl(&argument);
+    // flags that take value
+    b8 isValueGiven = argumentIndex + 1 < argumentCount;
+    struct string value = StringNull();
+    if (isValueGiven)
+      value = StringFromZeroTerminated((u8 *)arguments[argumentIndex + 1], 1024);
 
-    if (IsStringStartsWith(&argument, &StringFromLiteral("-i")) ||
-        IsStringStartsWith(&argument, &StringFromLiteral("--instance"))) {
-      // expects 1 argument
-      if (argumentIndex + 1 == argumentCount) {
-        // Expected instance. accepted types url domain
+    if (IsStringEqual(&argument, &StringFromLiteral("--instance-file"))) {
+      // expects 1 argument, caller reads it, see OptionsAddInstanceList()
+      if (!isValueGiven)
         return OPTIONS_ERROR_INSTANCE_REQUIRED;
-      }
 
       argumentIndex++;
-      struct string instance = StringFromZeroTerminated((u8 *)arguments[argumentIndex], 1024);
-
-      // Validation, (url, domain)
-      string domain = StringNull();
-      string port = StringFromLiteral("433");
-
-      string_cursor cursor = StringCursorFromString(&instance);
-
-      string schemeSeparator = StringFromLiteral("://");
-      string scheme = StringCursorExtractUntil(&cursor, &schemeSeparator);
-
-      if (IsStringEqual(&scheme, &StringFromLiteral("http")))
-        port = StringFromLiteral("80");
-      else if (IsStringEqual(&scheme, &StringFromLiteral("https")))
-        port = StringFromLiteral("433");
-      else
-        return OPTIONS_ERROR_INSTANCE_INVALID;
-
-      cursor.position += scheme.length + schemeSeparator.length;
-
-      string authority = StringCursorExtractUntilOrRest(&cursor, &StringFromLiteral("/"));
-      string_cursor authorityCursor = StringCursorFromString(&authority);
-      string colon = StringFromLiteral(":");
-      domain = StringCursorExtractUntil(&authorityCursor, &colon);
-      if (IsStringNull(&domain)) {
-        domain = authority;
-      } else {
-        authorityCursor.position += domain.length + colon.length;
-        port = StringCursorExtractRemaining(&authorityCursor);
+      options->instanceFile = value;
+    }
+
+    else if (IsStringEqual(&argument, &StringFromLiteral("-i")) ||
+             IsStringEqual(&argument, &StringFromLiteral("--instance"))) {
+      // expects 1 argument, can be given many times
+      if (!isValueGiven)
+        return OPTIONS_ERROR_INSTANCE_REQUIRED;
+
+      argumentIndex++;
+      enum options_error error = OptionsAddInstance(options, &value);
+      if (error != OPTIONS_ERROR_NONE) {
+        options->invalidArgument = value;
+        return error;
       }
+    }
 
-      // Write
-      options->hostname = domain;
-      options->port = port;
+    else if (IsStringEqual(&argument, &StringFromLiteral("--kernel-tls"))) {
+      options->isKernelTls = 1;
     }
 
-    else if (IsStringStartsWith(&argument, &StringFromLiteral("-h")) ||
-             IsStringStartsWith(&argument, &StringFromLiteral("--help"))) {
-      return OPTIONS_ERROR_HELP;
+    else if (IsStringEqual(&argument, &StringFromLiteral("--timing"))) {
+      options->isTiming = 1;
     }
 
-    else if (IsStringNull(&options->videoId)) {
-      // video id is required
+    else if (IsStringEqual(&argument, &StringFromLiteral("--batch"))) {
+      // expects 1 argument, caller reads it
+      if (!isValueGiven)
+        return OPTIONS_ERROR_BATCH_REQUIRED;
 
-      string_cursor cursor = StringCursorFromString(&argument);
+      argumentIndex++;
+      options->batchFile = value;
+    }
 
-      // https://developer.mozilla.org/en-US/docs/Learn_web_development/Howto/Web_mechanics/What_is_a_URL#basics_anatomy_of_a_url
-      // https://www.youtube.com/watch?v={videoId}
-      // https://www.youtube.com/embed/{videoId}
-      // https://youtu.be/{videoId}
+    else if (IsStringEqual(&argument, &StringFromLiteral("--concurrency"))) {
+      // expects 1 argument
+      u64 requestMax;
+      if (!isValueGiven || value.length > 9 || !ParseU64(&value, &requestMax) || requestMax == 0) {
+        options->invalidArgument = value;
+        return OPTIONS_ERROR_CONCURRENCY_INVALID;
+      }
 
-      string pathSeparator = StringFromLiteral("/");
-      StringCursorConsumeThroughLast(&cursor, &pathSeparator);
+      argumentIndex++;
+      options->requestMax = (u32)requestMax;
+    }
+
+    else if (IsStringEqual(&argument, &StringFromLiteral("--unordered"))) {
+      options->isUnordered = 1;
+    }
+
+    else if (IsStringEqual(&argument, &StringFromLiteral("--hedge"))) {
+      options->isHedging = 1;
+    }
 
-      string parameterKeyV = StringFromLiteral("v=");
-      StringCursorConsumeThrough(&cursor, &parameterKeyV);
+    else if (IsStringEqual(&argument, &StringFromLiteral("-s")) ||
+             IsStringEqual(&argument, &StringFromLiteral("--search"))) {
+      // expects 1 argument
+      struct string search = StringStripWhitespace(&value);
+      if (IsStringNullOrEmpty(&search))
+        return OPTIONS_ERROR_SEARCH_REQUIRED;
 
-      string videoId = StringCursorExtractRemaining(&cursor);
+      // Write
+      argumentIndex++;
+      options->search = search;
+    }
 
-      string parameterSeparator = StringFromLiteral("&");
-      string beforeParameterSeparator = StringCursorExtractUntil(&cursor, &parameterSeparator);
-      b8 isParameterSeperatorFound = !IsStringNull(&beforeParameterSeparator);
-      if (isParameterSeperatorFound)
-        videoId = beforeParameterSeparator;
+    else if (IsStringEqual(&argument, &StringFromLiteral("-h")) ||
+             IsStringEqual(&argument, &StringFromLiteral("--help"))) {
+      return OPTIONS_ERROR_HELP;
+    }
 
-      if (!isParameterSeperatorFound) {
-        string anchorSeparator = StringFromLiteral("#");
-        string beforeAnchorSeparator = StringCursorExtractUntil(&cursor, &anchorSeparator);
-        if (!IsStringNull(&beforeAnchorSeparator))
-          videoId = beforeAnchorSeparator;
+    else if (!IsStringNull(&searchInUrl)) {
+      string buffer = StringFromBuffer(options->searchBuffer, ARRAY_COUNT(options->searchBuffer));
+      string search = PercentDecode(&searchInUrl, &buffer, PERCENT_ENCODING_FORM);
+      if (IsStringNullOrEmpty(&search)) {
+        options->invalidArgument = argument;
+        return OPTIONS_ERROR_SEARCH_INVALID;
       }
 
-      // validate video id
-      if (videoId.length != 11)
+      // Write
+      options->search = search;
+    }
+
+    else {
+      struct string videoId = OptionsVideoIdFromArgument(&argument);
+      if (IsStringNull(&videoId)) {
+        options->invalidArgument = argument;
         return OPTIONS_ERROR_VIDEO_INVALID;
-      for (u32 index = 0; index < videoId.length; index++) {
-        b8 allowed[U8_MAX] = {
-            // A-Z a-z 0-9 - _
-            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x00
-            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x10
-            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, // 0x20
-            1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, // 0x30
-            0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x40
-            1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 1, // 0x50
-            0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x60
-            1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, // 0x70
-            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x80
-            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x90
-            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0xa0
-            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0xb0
-            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0xc0
-            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0xd0
-            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0xe0
-            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0     // 0xf0
-        };
-        u8 character = *(videoId.value + index);
-        if (!allowed[character])
-          return OPTIONS_ERROR_VIDEO_INVALID;
       }
 
       // Write
-      options->videoId = videoId;
+      options->videoIds[options->videoIdCount] = videoId;
+      options->videoIdCount++;
     }
   }
 
-  if (IsStringNull(&options->videoId))
+  // either video, batch or search is required
+  if (options->videoIdCount == 0 && IsStringNull(&options->batchFile) && IsStringNull(&options->search))
     return OPTIONS_ERROR_VIDEO_REQUIRED;
 
   return OPTIONS_ERROR_NONE;
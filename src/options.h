@@ -2,24 +2,85 @@
 
 #include "text.h"
 
-struct options {
+enum {
+  OPTIONS_INSTANCE_MAX = 16,
+};
+
+struct options_instance {
   struct string hostname;
   struct string port;
+  // http://, requests go over plain TCP instead of TLS
+  b8 isPlain;
+};
+
+struct options {
+  // in order they are given, i.iii.st when none is
+  struct options_instance instances[OPTIONS_INSTANCE_MAX];
+  u32 instanceCount;
+  // instances is default one, first instance given takes its place
+  b8 isInstanceDefault;
+  // instances are read from it too, one on every line, null when not given.
+  // Caller reads it, see OptionsAddInstanceList().
+  struct string instanceFile;
+
+  // in order given, caller points it to room for one on every argument
+  struct string *videoIds;
+  u32 videoIdCount;
+  // video ids are read from it one on every line, "-" is standard input,
+  // null when not given
+  struct string batchFile;
+  // requests in flight at once, 0 when as many as connections allow
+  u32 requestMax;
+  // videos are printed as they are answered instead of in order given
+  b8 isUnordered;
+  // late requests are sent again to another instance, see src/hedge.c
+  b8 isHedging;
 
-  struct string videoId;
+  // search query, decoded
+  struct string search;
+  // search query from url is decoded into here
+  u8 searchBuffer[256];
+
+  // records of connections are handed to kernel, Linux kTLS
+  b8 isKernelTls;
+  // phases of every request are printed, see src/request_timing.c
+  b8 isTiming;
+
+  // argument error is about, null when error is not about one
+  struct string invalidArgument;
 };
 
 enum options_error {
   OPTIONS_ERROR_NONE,
   OPTIONS_ERROR_INSTANCE_REQUIRED,
   OPTIONS_ERROR_INSTANCE_INVALID,
+  OPTIONS_ERROR_INSTANCE_TOO_MANY,
   OPTIONS_ERROR_VIDEO_REQUIRED,
   OPTIONS_ERROR_VIDEO_INVALID,
+  OPTIONS_ERROR_SEARCH_REQUIRED,
+  OPTIONS_ERROR_SEARCH_INVALID,
+  OPTIONS_ERROR_BATCH_REQUIRED,
+  OPTIONS_ERROR_CONCURRENCY_INVALID,
   OPTIONS_ERROR_HELP,
 };
 
 internalfn void
 OptionsInit(struct options *options);
 
+internalfn enum options_error
+OptionsAddInstance(struct options *options, struct string *instance);
+
+internalfn enum options_error
+OptionsAddInstanceList(struct options *options, struct string *content);
+
+internalfn struct string
+OptionsVideoIdFromArgument(struct string *argument);
+
+/*
+ * Every flag is matched whole, anything else is video id or url of video or
+ * search. Instances given replace default one.
+ * @return OPTIONS_ERROR_VIDEO_REQUIRED when there is neither video, batch nor
+ *         search, everything else is parsed
+ */
 internalfn enum options_error
 OptionsParse(struct options *options, u32 argumentCount, char **arguments);
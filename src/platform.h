@@ -1,6 +1,7 @@
 #pragma once
 
 #include "memory.h"
+#include "text.h"
 #include "type.h"
 
 internalfn struct memory_arena
@@ -15,6 +16,118 @@ PlatformReadFile(struct string *buffer, struct string *path);
 internalfn u64
 PlatformWriteFile(struct string *buffer, struct string *path);
 
+/*
+ * @return monotonic time, only differences are meaningful
+ */
+internalfn u64
+NowInNanoseconds(void);
+
+/*
+ * @return seconds since 1970-01-01 UTC, for times that outlive process
+ */
+internalfn u64
+PlatformUnixTime(void);
+
+/*
+ * Waits at least given time, e.g. until server asks to be contacted again.
+ */
+internalfn void
+PlatformSleep(u64 nanoseconds);
+
+/*
+ * Fills buffer from random source of system.
+ * @return false on error
+ */
+internalfn b8
+PlatformGetRandom(struct string *buffer);
+
+/*
+ * Path of file in cache directory of user, $XDG_CACHE_HOME or ~/.cache.
+ * Directory is created when missing.
+ * @return zero terminated path in buffer, null when there is no cache directory
+ */
+internalfn struct string
+PlatformCacheFilePath(struct string *buffer, struct string *name);
+
+/*
+ * Opens file, creating it when missing, and waits for lock on it. Lock is
+ * advisory, it only keeps out others that lock.
+ * @param isExclusive for writing, many can hold shared lock
+ * @return file, -1 on error
+ */
+internalfn s32
+PlatformFileLock(struct string *path, b8 isExclusive);
+
+/*
+ * Reads whole locked file.
+ * @return content in buffer, null on error or when it does not fit
+ */
+internalfn struct string
+PlatformFileLockedRead(s32 file, struct string *buffer);
+
+/*
+ * Replaces content of file that is locked exclusively.
+ * @return false on error
+ */
+internalfn b8
+PlatformFileLockedWrite(s32 file, struct string *data);
+
+/*
+ * Releases lock and closes file.
+ */
+internalfn void
+PlatformFileUnlock(s32 file);
+
+/*
+ * Symbolic links are followed.
+ * @param modifiedAt nanoseconds since 1970-01-01 UTC
+ * @return false when path is not a file
+ */
+internalfn b8
+PlatformFileInfo(struct string *path, u64 *size, u64 *modifiedAt);
+
+/*
+ * Maps whole file for reading, pages are read when they are touched.
+ * @return content, null on error or when file is empty
+ */
+internalfn struct string
+PlatformFileMap(struct string *path);
+
+internalfn void
+PlatformFileUnmap(struct string *content);
+
+/*
+ * Writes data to new file next to path, then renames it over path. Readers
+ * see either old or new content, never part of it.
+ * @return false on error
+ */
+internalfn b8
+PlatformFileReplace(struct string *path, struct string *data);
+
+/*
+ * Opens file to be read in pieces, "-" is standard input.
+ * @param path must be zero terminated
+ * @return file, -1 on error
+ */
+internalfn s32
+PlatformFileOpen(struct string *path);
+
+/*
+ * Reads next piece of file, waits until there is some, e.g. on pipe.
+ * @return bytes read, 0 at end of file, -1 on error
+ */
+internalfn s64
+PlatformFileRead(s32 file, struct string *buffer);
+
+/*
+ * @return true when PlatformFileRead() would not wait, also at end of file
+ */
+internalfn b8
+PlatformFileIsReadable(s32 file);
+
+internalfn void
+PlatformFileClose(s32 file);
+
 #include "string_builder.h"
 internalfn void
 StringBuilderAppendPlatformError(struct string_builder *sb);
@@ -22,3 +135,5 @@ StringBuilderAppendPlatformError(struct string_builder *sb);
 #if IS_PLATFORM_LINUX
 #include "platform_linux.c"
 #endif
+
+#include "platform_network.h"
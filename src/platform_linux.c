@@ -1,6 +1,13 @@
+#include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/file.h>
 #include <sys/mman.h>
+#include <sys/random.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "assert.h"
@@ -21,6 +28,264 @@ PlatformMemoryAllocate(u64 size)
   return arena;
 }
 
+internalfn u64
+NowInNanoseconds(void)
+{
+  struct timespec ts;
+  if (clock_gettime(CLOCK_MONOTONIC, &ts))
+    runtime_assert(0 && "clock is unstable");
+
+  return (u64)ts.tv_sec * 1000000000 /* 1e9 */ + (u64)ts.tv_nsec;
+}
+
+internalfn u64
+PlatformUnixTime(void)
+{
+  struct timespec ts;
+  if (clock_gettime(CLOCK_REALTIME, &ts))
+    runtime_assert(0 && "clock is unstable");
+
+  return (u64)ts.tv_sec;
+}
+
+internalfn void
+PlatformSleep(u64 nanoseconds)
+{
+  struct timespec ts = {
+      .tv_sec = (time_t)(nanoseconds / 1000000000 /* 1e9 */),
+      .tv_nsec = (long)(nanoseconds % 1000000000 /* 1e9 */),
+  };
+  // continues where it is left when interrupted by signal
+  while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+    ;
+}
+
+internalfn b8
+PlatformGetRandom(struct string *buffer)
+{
+  s64 result = getrandom(buffer->value, buffer->length, 0);
+  return result >= 0 && (u64)result == buffer->length;
+}
+
+internalfn struct string
+PlatformCacheFilePath(struct string *buffer, struct string *name)
+{
+  struct string directory;
+  struct string suffix;
+  char *cacheHome = getenv("XDG_CACHE_HOME");
+  char *home = getenv("HOME");
+  if (cacheHome && cacheHome[0] == '/') {
+    directory = StringFromZeroTerminated((u8 *)cacheHome, 4096);
+    suffix = StringFromLiteral("/");
+  } else if (home && home[0] == '/') {
+    directory = StringFromZeroTerminated((u8 *)home, 4096);
+    suffix = StringFromLiteral("/.cache/");
+  } else {
+    return StringNull();
+  }
+
+  u64 length = directory.length + suffix.length + name->length;
+  if (length + 1 > buffer->length)
+    return StringNull();
+
+  MemoryCopy(buffer->value, directory.value, directory.length);
+  MemoryCopy(buffer->value + directory.length, suffix.value, suffix.length);
+  // directory without trailing slash
+  buffer->value[directory.length + suffix.length - 1] = 0;
+  if (mkdir((char *)buffer->value, 0700) == -1 && errno != EEXIST)
+    return StringNull();
+  buffer->value[directory.length + suffix.length - 1] = '/';
+
+  MemoryCopy(buffer->value + directory.length + suffix.length, name->value, name->length);
+  buffer->value[length] = 0;
+  return StringFromBuffer(buffer->value, length);
+}
+
+internalfn s32
+PlatformFileLock(struct string *path, b8 isExclusive)
+{
+  debug_assert(path->value[path->length] == 0 && "must be zero terminated");
+
+  s32 file = open((char *)path->value, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (file == -1)
+    return -1;
+
+  while (flock(file, isExclusive ? LOCK_EX : LOCK_SH) == -1) {
+    if (errno == EINTR)
+      continue;
+    close(file);
+    return -1;
+  }
+
+  return file;
+}
+
+internalfn struct string
+PlatformFileLockedRead(s32 file, struct string *buffer)
+{
+  u64 totalBytesRead = 0;
+  while (1) {
+    if (totalBytesRead == buffer->length)
+      return StringNull(); // does not fit
+
+    ssize_t bytesRead = pread(file, buffer->value + totalBytesRead, buffer->length - totalBytesRead,
+                              (off_t)totalBytesRead);
+    if (bytesRead == 0)
+      break; // end of file
+    if (bytesRead < 0) {
+      if (errno == EINTR)
+        continue;
+      return StringNull();
+    }
+
+    totalBytesRead += (u64)bytesRead;
+  }
+
+  return StringFromBuffer(buffer->value, totalBytesRead);
+}
+
+internalfn b8
+PlatformFileLockedWrite(s32 file, struct string *data)
+{
+  if (ftruncate(file, 0) == -1)
+    return 0;
+
+  u64 totalBytesWritten = 0;
+  while (totalBytesWritten < data->length) {
+    ssize_t bytesWritten = pwrite(file, data->value + totalBytesWritten, data->length - totalBytesWritten,
+                                  (off_t)totalBytesWritten);
+    if (bytesWritten < 0) {
+      if (errno == EINTR)
+        continue;
+      return 0;
+    }
+
+    totalBytesWritten += (u64)bytesWritten;
+  }
+
+  return 1;
+}
+
+internalfn void
+PlatformFileUnlock(s32 file)
+{
+  // lock goes with last descriptor of open file
+  close(file);
+}
+
+internalfn b8
+PlatformFileInfo(struct string *path, u64 *size, u64 *modifiedAt)
+{
+  struct stat stat;
+
+  debug_assert(path->value[path->length] == 0 && "must be zero terminated");
+  if (fstatat(AT_FDCWD, (char *)path->value, &stat, 0) == -1)
+    return 0;
+
+  if (!S_ISREG(stat.st_mode) || stat.st_size < 0 || stat.st_mtim.tv_sec < 0)
+    return 0;
+
+  *size = (u64)stat.st_size;
+  *modifiedAt = (u64)stat.st_mtim.tv_sec * 1000000000 /* 1e9 */ + (u64)stat.st_mtim.tv_nsec;
+  return 1;
+}
+
+internalfn struct string
+PlatformFileMap(struct string *path)
+{
+  struct stat stat;
+
+  debug_assert(path->value[path->length] == 0 && "must be zero terminated");
+  s32 file = open((char *)path->value, O_RDONLY | O_CLOEXEC);
+  if (file == -1)
+    return StringNull();
+
+  struct string content = StringNull();
+  if (fstat(file, &stat) == -1 || !S_ISREG(stat.st_mode) || stat.st_size <= 0)
+    goto close;
+
+  // mapping stays after file is closed
+  void *address = mmap(0, (size_t)stat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+  if (address == MAP_FAILED)
+    goto close;
+  content = StringFromBuffer(address, (u64)stat.st_size);
+
+close:
+  close(file);
+  return content;
+}
+
+internalfn void
+PlatformFileUnmap(struct string *content)
+{
+  munmap(content->value, content->length);
+}
+
+internalfn b8
+PlatformFileReplace(struct string *path, struct string *data)
+{
+  struct string suffix = StringFromLiteral(".XXXXXX");
+  char temporaryPath[4096];
+
+  debug_assert(path->value[path->length] == 0 && "must be zero terminated");
+  if (path->length + suffix.length + 1 > sizeof(temporaryPath))
+    return 0;
+  MemoryCopy(temporaryPath, path->value, path->length);
+  MemoryCopy(temporaryPath + path->length, suffix.value, suffix.length + 1);
+
+  // unique name, runs building same file do not write into each other
+  s32 file = mkostemp(temporaryPath, O_CLOEXEC);
+  if (file == -1)
+    return 0;
+
+  b8 isWritten = PlatformFileLockedWrite(file, data);
+  close(file);
+  if (!isWritten || rename(temporaryPath, (char *)path->value) == -1) {
+    unlink(temporaryPath);
+    return 0;
+  }
+
+  return 1;
+}
+
+internalfn s32
+PlatformFileOpen(struct string *path)
+{
+  if (IsStringEqual(path, &StringFromLiteral("-")))
+    return STDIN_FILENO;
+
+  debug_assert(path->value[path->length] == 0 && "must be zero terminated");
+  return open((char *)path->value, O_RDONLY | O_CLOEXEC);
+}
+
+internalfn s64
+PlatformFileRead(s32 file, struct string *buffer)
+{
+  while (1) {
+    ssize_t bytesRead = read(file, buffer->value, buffer->length);
+    if (bytesRead >= 0)
+      return (s64)bytesRead;
+    if (errno != EINTR)
+      return -1;
+  }
+}
+
+internalfn b8
+PlatformFileIsReadable(s32 file)
+{
+  // regular file is always readable
+  struct pollfd pollFd = {.fd = file, .events = POLLIN};
+  return poll(&pollFd, 1, 0) > 0;
+}
+
+internalfn void
+PlatformFileClose(s32 file)
+{
+  // standard input stays open for others
+  if (file != STDIN_FILENO)
+    close(file);
+}
+
 internalfn u64
 PlatformFileSize(struct string *path)
 {
@@ -0,0 +1,80 @@
+#pragma once
+
+/*
+ * Reserved address space
+ *
+ * Range of addresses is reserved up front and memory is put behind its pages
+ * only when they are committed. Buffer that lives in such range grows in place,
+ * pointers into it stay valid and nothing is copied. Pages can be given back
+ * to system while range stays reserved.
+ *
+ * @code
+ *   block = PlatformMemoryReserve(1 << 30)
+ *   PlatformMemoryCommit(block, 64 << 10)
+ *   ... buffer needs more
+ *   PlatformMemoryCommit(block + (64 << 10), 64 << 10)
+ *   ... buffer is small again
+ *   PlatformMemoryDecommit(block + (64 << 10), 64 << 10)
+ *   PlatformMemoryRelease(block, 1 << 30)
+ * @endcode
+ *
+ * Ring buffer has fixed size and its pages are mapped twice instead, see
+ * PlatformMemoryMapRing(), so data that wraps around its end is contiguous.
+ */
+
+#include "type.h"
+
+/*
+ * Pages are committed in multiples of this, it is the allocation granularity
+ * of every system.
+ */
+comptime u64 PLATFORM_MEMORY_COMMIT_GRANULARITY = 64 << 10;
+
+/*
+ * Reserves range that nothing can be read from or written to.
+ * @return start of range, null on error
+ */
+internalfn u8 *
+PlatformMemoryReserve(u64 size);
+
+/*
+ * Makes pages of reserved range readable and writable. They are zero until
+ * they are written.
+ * @param block start of range plus multiple of PLATFORM_MEMORY_COMMIT_GRANULARITY
+ * @return false when system is out of memory
+ */
+internalfn b8
+PlatformMemoryCommit(u8 *block, u64 size);
+
+/*
+ * Gives memory behind pages back to system, range stays reserved.
+ * @param block start of range plus multiple of PLATFORM_MEMORY_COMMIT_GRANULARITY
+ */
+internalfn void
+PlatformMemoryDecommit(u8 *block, u64 size);
+
+/*
+ * @param size what range is reserved with
+ */
+internalfn void
+PlatformMemoryRelease(u8 *block, u64 size);
+
+/*
+ * Maps same pages twice, back to back: byte at block + i is byte at
+ * block + size + i. Span of up to size bytes that starts in first half is
+ * contiguous, also when it wraps around end of ring.
+ * @param size multiple of PLATFORM_MEMORY_COMMIT_GRANULARITY
+ * @return start of 2 * size range, null on error
+ */
+internalfn u8 *
+PlatformMemoryMapRing(u64 size);
+
+/*
+ * @param size what ring is mapped with
+ */
+internalfn void
+PlatformMemoryUnmapRing(u8 *block, u64 size);
+
+#if IS_PLATFORM_LINUX
+#include "platform_memory_linux.c"
+#endif
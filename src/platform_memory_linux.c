@@ -0,0 +1,69 @@
+#include <sys/mman.h>
+#include <unistd.h>
+
+internalfn u8 *
+PlatformMemoryReserve(u64 size)
+{
+  // not counted as committed memory until pages are made writable
+  void *block = mmap(0, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (block == MAP_FAILED)
+    return 0;
+  return block;
+}
+
+internalfn b8
+PlatformMemoryCommit(u8 *block, u64 size)
+{
+  return mprotect(block, size, PROT_READ | PROT_WRITE) == 0;
+}
+
+internalfn void
+PlatformMemoryDecommit(u8 *block, u64 size)
+{
+  // pages are dropped, protecting them again stops them being counted
+  madvise(block, size, MADV_DONTNEED);
+  mprotect(block, size, PROT_NONE);
+}
+
+internalfn void
+PlatformMemoryRelease(u8 *block, u64 size)
+{
+  munmap(block, size);
+}
+
+internalfn u8 *
+PlatformMemoryMapRing(u64 size)
+{
+  // anonymous file is the only way to have pages that can be mapped twice
+  s32 file = memfd_create("ring", MFD_CLOEXEC);
+  if (file == -1)
+    return 0;
+  if (ftruncate(file, (off_t)size) == -1) {
+    close(file);
+    return 0;
+  }
+
+  // both halves are placed in one reserved range, so nothing else gets between them
+  u8 *block = mmap(0, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (block == MAP_FAILED) {
+    close(file);
+    return 0;
+  }
+
+  b8 ok = mmap(block, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, file, 0) != MAP_FAILED &&
+          mmap(block + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, file, 0) != MAP_FAILED;
+  // mappings keep pages alive
+  close(file);
+  if (!ok) {
+    munmap(block, 2 * size);
+    return 0;
+  }
+
+  return block;
+}
+
+internalfn void
+PlatformMemoryUnmapRing(u8 *block, u64 size)
+{
+  munmap(block, 2 * size);
+}
@@ -0,0 +1,242 @@
+#pragma once
+
+/*
+ * Non-blocking sockets and readiness notification
+ *
+ * Sockets never block. When read, write or connect cannot make progress
+ * PLATFORM_SOCKET_WOULD_BLOCK is returned, caller asks reactor to be told when
+ * socket becomes ready and works on other sockets meanwhile. This way one
+ * thread keeps many connections busy.
+ *
+ * @code
+ *   PlatformReactorOpen(&reactor)
+ *   socket = PlatformSocketConnect(&address)
+ *   PlatformReactorAdd(&reactor, socket, PLATFORM_EVENT_WRITE, connection)
+ *   while (...) {
+ *     eventCount = PlatformReactorWait(&reactor, events, ARRAY_COUNT(events), -1)
+ *     for every event
+ *       work on event.data until it would block
+ *       PlatformReactorModify(&reactor, socket, events it waits for, connection)
+ *   }
+ * @endcode
+ */
+
+#include "text.h"
+#include "type.h"
+
+enum platform_event_flag {
+  PLATFORM_EVENT_READ = (1 << 0),
+  PLATFORM_EVENT_WRITE = (1 << 1),
+  // error or hang up, next read or write tells what happened
+  PLATFORM_EVENT_ERROR = (1 << 2),
+};
+
+struct platform_event {
+  // what was given when socket is added to reactor
+  void *data;
+  // PLATFORM_EVENT_*
+  u32 flags;
+};
+
+struct platform_reactor {
+  s32 fd;
+};
+
+struct platform_address {
+  s32 family;
+  u32 length;
+  // struct sockaddr_in or struct sockaddr_in6
+  u8 value[28];
+};
+
+comptime s64 PLATFORM_SOCKET_ERROR = -1;
+comptime s64 PLATFORM_SOCKET_WOULD_BLOCK = -2;
+
+// ciphers of TLS 1.3 that kernel can take, see PlatformSocketKernelTls()
+enum platform_tls_cipher {
+  PLATFORM_TLS_CIPHER_AES_128_GCM,
+  PLATFORM_TLS_CIPHER_AES_256_GCM,
+  PLATFORM_TLS_CIPHER_CHACHA20_POLY1305,
+};
+
+// traffic key of one direction of TLS 1.3 connection
+struct platform_tls_key {
+  enum platform_tls_cipher cipher;
+  // 16 bytes for AES-128, 32 otherwise
+  u8 key[32];
+  u8 iv[12];
+  // of next record
+  u64 sequenceNumber;
+};
+
+/*
+ * Resolves hostname with system resolver, IPv6 and IPv4. Blocks, see
+ * src/dns.c for one that does not.
+ * @param hostname must be zero terminated
+ * @param port must be zero terminated
+ * @return number of addresses filled, 0 when hostname cannot be resolved
+ */
+internalfn u32
+PlatformAddressResolveAll(struct string *hostname, struct string *port, struct platform_address *addresses,
+                          u32 addressMax);
+
+/*
+ * Resolves hostname to its first address, see PlatformAddressResolveAll().
+ * @return false when hostname cannot be resolved
+ */
+internalfn b8
+PlatformAddressResolve(struct string *hostname, struct string *port, struct platform_address *address);
+
+/*
+ * @param octets 4 for IPv4, 16 for IPv6, in network order
+ * @return false when octets are not an address
+ */
+internalfn b8
+PlatformAddressFromOctets(struct platform_address *address, struct string *octets, u16 port);
+
+/*
+ * @return IPv4 or IPv6 address in network order, 4 or 16 octets
+ */
+internalfn struct string
+PlatformAddressOctets(struct platform_address *address);
+
+/*
+ * Takes IPv4 or IPv6 address in text, e.g. "127.0.0.1" or "::1".
+ * @param text must be zero terminated
+ * @return false when text is not an address
+ */
+internalfn b8
+PlatformAddressParse(struct platform_address *address, struct string *text, u16 port);
+
+/*
+ * First name server system is configured with, port 53.
+ * @return false when there is none
+ */
+internalfn b8
+PlatformAddressNameServer(struct platform_address *address);
+
+/*
+ * Starts connecting. Connection is complete when socket becomes writable, see
+ * PlatformSocketConnectError().
+ * @return socket, -1 on error
+ */
+internalfn s32
+PlatformSocketConnect(struct platform_address *address);
+
+/*
+ * @return 0 when connected, reason of failure otherwise
+ */
+internalfn s32
+PlatformSocketConnectError(s32 socket);
+
+/*
+ * Opens UDP socket that sends to and receives from address only.
+ * @return socket, -1 on error
+ */
+internalfn s32
+PlatformSocketOpenDatagram(struct platform_address *address);
+
+/*
+ * Waits until socket is ready for anything in flags or timeout passes, for
+ * one socket outside of reactor.
+ * @param flags PLATFORM_EVENT_READ, PLATFORM_EVENT_WRITE
+ * @param timeoutInMilliseconds -1 waits forever
+ * @return false on timeout
+ */
+internalfn b8
+PlatformSocketWait(s32 socket, u32 flags, s32 timeoutInMilliseconds);
+
+/*
+ * Listens on address. When port is 0, system picks one and address is updated.
+ * @return socket, -1 on error
+ */
+internalfn s32
+PlatformSocketListen(struct platform_address *address);
+
+/*
+ * @return non-blocking socket of accepted connection
+ *         PLATFORM_SOCKET_WOULD_BLOCK when no one is waiting
+ *         PLATFORM_SOCKET_ERROR on error
+ */
+internalfn s32
+PlatformSocketAccept(s32 listener);
+
+/*
+ * @return bytes read, 0 when peer closed connection
+ *         PLATFORM_SOCKET_WOULD_BLOCK or PLATFORM_SOCKET_ERROR
+ */
+internalfn s64
+PlatformSocketRead(s32 socket, u8 *buffer, u64 length);
+
+/*
+ * @return bytes written, PLATFORM_SOCKET_WOULD_BLOCK or PLATFORM_SOCKET_ERROR
+ */
+internalfn s64
+PlatformSocketWrite(s32 socket, u8 *buffer, u64 length);
+
+/*
+ * Kernel encrypts what is written to socket or decrypts what is read from it
+ * from now on, Linux kTLS. Records of that direction must not be buffered
+ * anywhere else. Read with PlatformSocketReadRecord() after receive is taken.
+ * @param isSend direction
+ * @return false when kernel has no TLS module (ENOENT) or cipher, see errno,
+ *         direction stays as it was
+ */
+internalfn b8
+PlatformSocketKernelTls(s32 socket, b8 isSend, struct platform_tls_key *key);
+
+/*
+ * Reads application data that kernel decrypted. Handshake messages that come
+ * after handshake, e.g. session tickets, are skipped. Kernel cannot follow
+ * KeyUpdate, read fails after it.
+ * @return bytes read, 0 when peer closed connection or sent close_notify
+ *         PLATFORM_SOCKET_WOULD_BLOCK or PLATFORM_SOCKET_ERROR
+ */
+internalfn s64
+PlatformSocketReadRecord(s32 socket, u8 *buffer, u64 length);
+
+/*
+ * Checks connection that is not used, without blocking or reading from it.
+ * @return false when peer closed or reset connection, or sent something
+ */
+internalfn b8
+PlatformSocketIsAlive(s32 socket);
+
+internalfn void
+PlatformSocketClose(s32 socket);
+
+/*
+ * @return false on error
+ */
+internalfn b8
+PlatformReactorOpen(struct platform_reactor *reactor);
+
+internalfn void
+PlatformReactorClose(struct platform_reactor *reactor);
+
+/*
+ * Reactor reports socket when it is ready for anything in flags
+ * (PLATFORM_EVENT_READ, PLATFORM_EVENT_WRITE). Errors are always reported.
+ * @return false on error
+ */
+internalfn b8
+PlatformReactorAdd(struct platform_reactor *reactor, s32 socket, u32 flags, void *data);
+
+internalfn b8
+PlatformReactorModify(struct platform_reactor *reactor, s32 socket, u32 flags, void *data);
+
+internalfn void
+PlatformReactorRemove(struct platform_reactor *reactor, s32 socket);
+
+/*
+ * Waits until at least one socket is ready or timeout passes.
+ * @param timeoutInMilliseconds -1 waits forever
+ * @return number of events filled, 0 on timeout
+ */
+internalfn u32
+PlatformReactorWait(struct platform_reactor *reactor, struct platform_event *events, u32 eventMax,
+                    s32 timeoutInMilliseconds);
+
+#if IS_PLATFORM_LINUX
+#include "platform_network_linux.c"
+#endif
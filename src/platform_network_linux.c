@@ -0,0 +1,487 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/tls.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "assert.h"
+#include "memory.h"
+#include "string_cursor.h"
+
+internalfn u32
+PlatformAddressResolveAll(struct string *hostname, struct string *port, struct platform_address *addresses,
+                          u32 addressMax)
+{
+  debug_assert(hostname->value[hostname->length] == 0 && "must be zero terminated");
+  debug_assert(port->value[port->length] == 0 && "must be zero terminated");
+
+  struct addrinfo hints = {
+      .ai_family = AF_UNSPEC,
+      .ai_socktype = SOCK_STREAM,
+      // only families that this host can reach
+      .ai_flags = AI_ADDRCONFIG,
+  };
+  struct addrinfo *res;
+  if (getaddrinfo((char *)hostname->value, (char *)port->value, &hints, &res))
+    return 0;
+
+  u32 addressCount = 0;
+  for (struct addrinfo *p = res; p && addressCount < addressMax; p = p->ai_next) {
+    if (p->ai_addrlen > sizeof(addresses->value))
+      continue;
+
+    struct platform_address *address = addresses + addressCount;
+    address->family = p->ai_family;
+    address->length = (u32)p->ai_addrlen;
+    MemoryCopy(address->value, p->ai_addr, p->ai_addrlen);
+    addressCount++;
+  }
+
+  freeaddrinfo(res);
+  return addressCount;
+}
+
+internalfn b8
+PlatformAddressResolve(struct string *hostname, struct string *port, struct platform_address *address)
+{
+  return PlatformAddressResolveAll(hostname, port, address, 1) == 1;
+}
+
+internalfn b8
+PlatformAddressFromOctets(struct platform_address *address, struct string *octets, u16 port)
+{
+  *address = (struct platform_address){};
+  if (octets->length == 4) {
+    struct sockaddr_in *ipv4 = (struct sockaddr_in *)address->value;
+    ipv4->sin_family = AF_INET;
+    ipv4->sin_port = htons(port);
+    MemoryCopy(&ipv4->sin_addr, octets->value, 4);
+    address->family = AF_INET;
+    address->length = sizeof(*ipv4);
+    return 1;
+  }
+
+  if (octets->length == 16) {
+    struct sockaddr_in6 *ipv6 = (struct sockaddr_in6 *)address->value;
+    ipv6->sin6_family = AF_INET6;
+    ipv6->sin6_port = htons(port);
+    MemoryCopy(&ipv6->sin6_addr, octets->value, 16);
+    address->family = AF_INET6;
+    address->length = sizeof(*ipv6);
+    return 1;
+  }
+
+  return 0;
+}
+
+internalfn struct string
+PlatformAddressOctets(struct platform_address *address)
+{
+  if (address->family == AF_INET6)
+    return StringFromBuffer((u8 *)&((struct sockaddr_in6 *)address->value)->sin6_addr, 16);
+  return StringFromBuffer((u8 *)&((struct sockaddr_in *)address->value)->sin_addr, 4);
+}
+
+internalfn b8
+PlatformAddressParse(struct platform_address *address, struct string *text, u16 port)
+{
+  debug_assert(text->value[text->length] == 0 && "must be zero terminated");
+
+  u8 buffer[16];
+  struct string octets;
+  if (inet_pton(AF_INET, (char *)text->value, buffer) == 1)
+    octets = StringFromBuffer(buffer, 4);
+  else if (inet_pton(AF_INET6, (char *)text->value, buffer) == 1)
+    octets = StringFromBuffer(buffer, 16);
+  else
+    return 0;
+  return PlatformAddressFromOctets(address, &octets, port);
+}
+
+internalfn b8
+PlatformAddressNameServer(struct platform_address *address)
+{
+  s32 file = open("/etc/resolv.conf", O_RDONLY | O_CLOEXEC);
+  if (file == -1)
+    return 0;
+
+  u8 buffer[4096];
+  ssize_t bytesRead = read(file, buffer, sizeof(buffer) - 1);
+  close(file);
+  if (bytesRead <= 0)
+    return 0;
+
+  // nameserver 127.0.0.53
+  struct string content = StringFromBuffer(buffer, (u64)bytesRead);
+  struct string_cursor cursor = StringCursorFromString(&content);
+  while (!IsStringCursorAtEnd(&cursor)) {
+    struct string line = StringCursorConsumeUntilOrRest(&cursor, &StringFromLiteral("\n"));
+    StringCursorAdvanceAfter(&cursor, &StringFromLiteral("\n"));
+
+    struct string_cursor lineCursor = StringCursorFromString(&line);
+    if (!IsStringCursorStartsWith(&lineCursor, &StringFromLiteral("nameserver")))
+      continue;
+
+    struct string value = StringCursorExtractRemaining(&lineCursor);
+    value = StringStripWhitespace(&value);
+    // zero terminated in place of whitespace or newline after it, or in spare octet of buffer
+    value.value[value.length] = 0;
+    if (PlatformAddressParse(address, &value, 53))
+      return 1;
+  }
+
+  return 0;
+}
+
+internalfn s32
+PlatformSocketConnect(struct platform_address *address)
+{
+  s32 socketFd = socket(address->family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (socketFd == -1)
+    return -1;
+
+  // requests are small and written at once, do not wait to coalesce them
+  int isEnabled = 1;
+  setsockopt(socketFd, IPPROTO_TCP, TCP_NODELAY, &isEnabled, sizeof(isEnabled));
+
+  if (connect(socketFd, (struct sockaddr *)address->value, address->length) == -1 && errno != EINPROGRESS) {
+    int error = errno;
+    close(socketFd);
+    errno = error;
+    return -1;
+  }
+
+  return socketFd;
+}
+
+internalfn s32
+PlatformSocketConnectError(s32 socket)
+{
+  int error = 0;
+  socklen_t errorLength = sizeof(error);
+  if (getsockopt(socket, SOL_SOCKET, SO_ERROR, &error, &errorLength) == -1)
+    return errno;
+  return error;
+}
+
+internalfn s32
+PlatformSocketOpenDatagram(struct platform_address *address)
+{
+  s32 socketFd = socket(address->family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (socketFd == -1)
+    return -1;
+
+  if (connect(socketFd, (struct sockaddr *)address->value, address->length) == -1) {
+    int error = errno;
+    close(socketFd);
+    errno = error;
+    return -1;
+  }
+
+  return socketFd;
+}
+
+internalfn b8
+PlatformSocketWait(s32 socket, u32 flags, s32 timeoutInMilliseconds)
+{
+  struct pollfd pollFd = {.fd = socket};
+  if (flags & PLATFORM_EVENT_READ)
+    pollFd.events |= POLLIN;
+  if (flags & PLATFORM_EVENT_WRITE)
+    pollFd.events |= POLLOUT;
+  return poll(&pollFd, 1, timeoutInMilliseconds) > 0;
+}
+
+internalfn s32
+PlatformSocketListen(struct platform_address *address)
+{
+  s32 socketFd = socket(address->family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (socketFd == -1)
+    return -1;
+
+  int isEnabled = 1;
+  setsockopt(socketFd, SOL_SOCKET, SO_REUSEADDR, &isEnabled, sizeof(isEnabled));
+
+  socklen_t length = sizeof(address->value);
+  if (bind(socketFd, (struct sockaddr *)address->value, address->length) == -1 ||
+      listen(socketFd, SOMAXCONN) == -1 || getsockname(socketFd, (struct sockaddr *)address->value, &length) == -1) {
+    int error = errno;
+    close(socketFd);
+    errno = error;
+    return -1;
+  }
+  address->length = (u32)length;
+
+  return socketFd;
+}
+
+internalfn s32
+PlatformSocketAccept(s32 listener)
+{
+  while (1) {
+    s32 socketFd = accept4(listener, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (socketFd != -1) {
+      int isEnabled = 1;
+      setsockopt(socketFd, IPPROTO_TCP, TCP_NODELAY, &isEnabled, sizeof(isEnabled));
+      return socketFd;
+    }
+
+    if (errno == EINTR)
+      continue;
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+      return (s32)PLATFORM_SOCKET_WOULD_BLOCK;
+    return (s32)PLATFORM_SOCKET_ERROR;
+  }
+}
+
+internalfn s64
+PlatformSocketRead(s32 socket, u8 *buffer, u64 length)
+{
+  while (1) {
+    ssize_t bytesRead = recv(socket, buffer, length, 0);
+    if (bytesRead >= 0)
+      return bytesRead;
+
+    if (errno == EINTR)
+      continue;
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+      return PLATFORM_SOCKET_WOULD_BLOCK;
+    return PLATFORM_SOCKET_ERROR;
+  }
+}
+
+internalfn s64
+PlatformSocketWrite(s32 socket, u8 *buffer, u64 length)
+{
+  while (1) {
+    // peer may close connection any time, report it instead of raising SIGPIPE
+    ssize_t bytesWritten = send(socket, buffer, length, MSG_NOSIGNAL);
+    if (bytesWritten >= 0)
+      return bytesWritten;
+
+    if (errno == EINTR)
+      continue;
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+      return PLATFORM_SOCKET_WOULD_BLOCK;
+    return PLATFORM_SOCKET_ERROR;
+  }
+}
+
+internalfn b8
+PlatformSocketKernelTls(s32 socket, b8 isSend, struct platform_tls_key *key)
+{
+  // upper layer protocol is attached once for both directions
+  if (setsockopt(socket, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")) == -1 && errno != EEXIST)
+    return 0;
+
+  // see linux/Documentation/networking/tls.rst
+  union {
+    struct tls_crypto_info info;
+    struct tls12_crypto_info_aes_gcm_128 aes128;
+    struct tls12_crypto_info_aes_gcm_256 aes256;
+    struct tls12_crypto_info_chacha20_poly1305 chacha20;
+  } crypto = {};
+  u8 sequenceNumber[8];
+  for (u32 index = 0; index < sizeof(sequenceNumber); index++)
+    sequenceNumber[index] = (u8)(key->sequenceNumber >> (56 - 8 * index));
+
+  // nonce of GCM is 4 bytes of implicit salt and 8 of explicit iv, ChaCha20
+  // takes all 12 as iv
+  socklen_t cryptoLength;
+  switch (key->cipher) {
+  case PLATFORM_TLS_CIPHER_AES_128_GCM: {
+    crypto.info = (struct tls_crypto_info){.version = TLS_1_3_VERSION, .cipher_type = TLS_CIPHER_AES_GCM_128};
+    MemoryCopy(crypto.aes128.key, key->key, sizeof(crypto.aes128.key));
+    MemoryCopy(crypto.aes128.salt, key->iv, sizeof(crypto.aes128.salt));
+    MemoryCopy(crypto.aes128.iv, key->iv + sizeof(crypto.aes128.salt), sizeof(crypto.aes128.iv));
+    MemoryCopy(crypto.aes128.rec_seq, sequenceNumber, sizeof(crypto.aes128.rec_seq));
+    cryptoLength = sizeof(crypto.aes128);
+  } break;
+  case PLATFORM_TLS_CIPHER_AES_256_GCM: {
+    crypto.info = (struct tls_crypto_info){.version = TLS_1_3_VERSION, .cipher_type = TLS_CIPHER_AES_GCM_256};
+    MemoryCopy(crypto.aes256.key, key->key, sizeof(crypto.aes256.key));
+    MemoryCopy(crypto.aes256.salt, key->iv, sizeof(crypto.aes256.salt));
+    MemoryCopy(crypto.aes256.iv, key->iv + sizeof(crypto.aes256.salt), sizeof(crypto.aes256.iv));
+    MemoryCopy(crypto.aes256.rec_seq, sequenceNumber, sizeof(crypto.aes256.rec_seq));
+    cryptoLength = sizeof(crypto.aes256);
+  } break;
+  case PLATFORM_TLS_CIPHER_CHACHA20_POLY1305: {
+    crypto.info = (struct tls_crypto_info){.version = TLS_1_3_VERSION, .cipher_type = TLS_CIPHER_CHACHA20_POLY1305};
+    MemoryCopy(crypto.chacha20.key, key->key, sizeof(crypto.chacha20.key));
+    MemoryCopy(crypto.chacha20.iv, key->iv, sizeof(crypto.chacha20.iv));
+    MemoryCopy(crypto.chacha20.rec_seq, sequenceNumber, sizeof(crypto.chacha20.rec_seq));
+    cryptoLength = sizeof(crypto.chacha20);
+  } break;
+  default: {
+    errno = EINVAL;
+    return 0;
+  }
+  }
+
+  b8 isTaken = setsockopt(socket, SOL_TLS, isSend ? TLS_TX : TLS_RX, &crypto, cryptoLength) == 0;
+  int error = errno;
+  // keys do not stay on stack
+  MemoryClear(&crypto, sizeof(crypto));
+  errno = error;
+  return isTaken;
+}
+
+internalfn s64
+PlatformSocketReadRecord(s32 socket, u8 *buffer, u64 length)
+{
+  // see RFC 8446 5.1. Record Layer, B.2. Alert Messages
+  enum {
+    TLS_RECORD_ALERT = 21,
+    TLS_RECORD_APPLICATION_DATA = 23,
+    TLS_ALERT_CLOSE_NOTIFY = 0,
+  };
+
+  while (1) {
+    // type of record is told in control message, without it kernel fails
+    // reading anything but application data
+    union {
+      struct cmsghdr header;
+      u8 buffer[CMSG_SPACE(sizeof(u8))];
+    } control;
+    struct iovec vector = {.iov_base = buffer, .iov_len = length};
+    struct msghdr message = {
+        .msg_iov = &vector,
+        .msg_iovlen = 1,
+        .msg_control = control.buffer,
+        .msg_controllen = sizeof(control.buffer),
+    };
+    ssize_t bytesRead = recvmsg(socket, &message, 0);
+    if (bytesRead < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return PLATFORM_SOCKET_WOULD_BLOCK;
+      return PLATFORM_SOCKET_ERROR;
+    }
+
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    if (bytesRead == 0 || !header || header->cmsg_level != SOL_TLS || header->cmsg_type != TLS_GET_RECORD_TYPE)
+      return bytesRead;
+
+    u8 recordType = *CMSG_DATA(header);
+    if (recordType == TLS_RECORD_APPLICATION_DATA)
+      return bytesRead;
+    if (recordType == TLS_RECORD_ALERT) {
+      // level and description
+      if (bytesRead == 2 && buffer[1] == TLS_ALERT_CLOSE_NOTIFY)
+        return 0;
+      errno = ECONNRESET;
+      return PLATFORM_SOCKET_ERROR;
+    }
+    // post-handshake message, bytes are overwritten by next record
+  }
+}
+
+internalfn b8
+PlatformSocketIsAlive(s32 socket)
+{
+  u8 octet;
+  while (1) {
+    ssize_t bytesRead = recv(socket, &octet, sizeof(octet), MSG_PEEK | MSG_DONTWAIT);
+    if (bytesRead >= 0)
+      return 0; // closed, or unexpected data
+
+    if (errno == EINTR)
+      continue;
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+  }
+}
+
+internalfn void
+PlatformSocketClose(s32 socket)
+{
+  close(socket);
+}
+
+internalfn b8
+PlatformReactorOpen(struct platform_reactor *reactor)
+{
+  reactor->fd = epoll_create1(EPOLL_CLOEXEC);
+  return reactor->fd != -1;
+}
+
+internalfn void
+PlatformReactorClose(struct platform_reactor *reactor)
+{
+  close(reactor->fd);
+  reactor->fd = -1;
+}
+
+internalfn u32
+PlatformEpollEventsFromFlags(u32 flags)
+{
+  // level triggered, socket is reported again until it is drained
+  u32 events = 0;
+  if (flags & PLATFORM_EVENT_READ)
+    events |= EPOLLIN | EPOLLRDHUP;
+  if (flags & PLATFORM_EVENT_WRITE)
+    events |= EPOLLOUT;
+  return events;
+}
+
+internalfn b8
+PlatformReactorAdd(struct platform_reactor *reactor, s32 socket, u32 flags, void *data)
+{
+  struct epoll_event event = {
+      .events = PlatformEpollEventsFromFlags(flags),
+      .data.ptr = data,
+  };
+  return epoll_ctl(reactor->fd, EPOLL_CTL_ADD, socket, &event) == 0;
+}
+
+internalfn b8
+PlatformReactorModify(struct platform_reactor *reactor, s32 socket, u32 flags, void *data)
+{
+  struct epoll_event event = {
+      .events = PlatformEpollEventsFromFlags(flags),
+      .data.ptr = data,
+  };
+  return epoll_ctl(reactor->fd, EPOLL_CTL_MOD, socket, &event) == 0;
+}
+
+internalfn void
+PlatformReactorRemove(struct platform_reactor *reactor, s32 socket)
+{
+  epoll_ctl(reactor->fd, EPOLL_CTL_DEL, socket, 0);
+}
+
+internalfn u32
+PlatformReactorWait(struct platform_reactor *reactor, struct platform_event *events, u32 eventMax,
+                    s32 timeoutInMilliseconds)
+{
+  enum { EPOLL_EVENT_MAX = 256 };
+  struct epoll_event epollEvents[EPOLL_EVENT_MAX];
+  if (eventMax > EPOLL_EVENT_MAX)
+    eventMax = EPOLL_EVENT_MAX;
+
+  int eventCount = epoll_wait(reactor->fd, epollEvents, (int)eventMax, timeoutInMilliseconds);
+  if (eventCount <= 0)
+    return 0; // timeout or interrupted by signal
+
+  for (u32 eventIndex = 0; eventIndex < (u32)eventCount; eventIndex++) {
+    struct epoll_event *epollEvent = epollEvents + eventIndex;
+    struct platform_event *event = events + eventIndex;
+    event->data = epollEvent->data.ptr;
+    event->flags = 0;
+    if (epollEvent->events & (EPOLLIN | EPOLLRDHUP))
+      event->flags |= PLATFORM_EVENT_READ;
+    if (epollEvent->events & EPOLLOUT)
+      event->flags |= PLATFORM_EVENT_WRITE;
+    if (epollEvent->events & (EPOLLERR | EPOLLHUP))
+      event->flags |= PLATFORM_EVENT_ERROR;
+  }
+
+  return (u32)eventCount;
+}
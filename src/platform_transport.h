@@ -0,0 +1,273 @@
+#pragma once
+
+/*
+ * Socket transport
+ *
+ * Operations are started on sockets and their results come back later as
+ * completions, from whichever backend is available:
+ *
+ *   io_uring  operations are queued in submission ring and submitted together
+ *             with waiting, so many connects, sends and receives cost one
+ *             system call. Receives are multishot into buffers registered in
+ *             a provided buffer ring, sends come from registered buffers, and
+ *             a send can be linked with receive that waits for its answer.
+ *             Needs Linux 6.1.
+ *   epoll     fallback, reactor reports readiness and transport does read,
+ *             write and connect itself then reports them as completions.
+ *
+ * Received bytes stay in transport buffers until they are given back, so they
+ * are copied at most once.
+ *
+ * @code
+ *   PlatformTransportOpen(&transport, &options)
+ *   socket.data = connection
+ *   PlatformTransportConnect(&transport, &socket, &address)
+ *   while (...) {
+ *     completionCount = PlatformTransportWait(&transport, completions, ARRAY_COUNT(completions), -1)
+ *     for every completion
+ *       CONNECT  PlatformTransportSend(&transport, &socket, request, length, PLATFORM_TRANSPORT_SEND_RECEIVE)
+ *       RECEIVE  use completion.buffer, PlatformTransportRelease(&transport, completion.bufferId)
+ *   }
+ * @endcode
+ */
+
+#include "platform_network.h"
+#include "type.h"
+
+enum platform_transport_backend {
+  PLATFORM_TRANSPORT_BACKEND_EPOLL,
+  PLATFORM_TRANSPORT_BACKEND_IO_URING,
+};
+
+enum platform_completion_type {
+  PLATFORM_COMPLETION_CONNECT,
+  PLATFORM_COMPLETION_ACCEPT,
+  PLATFORM_COMPLETION_RECEIVE,
+  PLATFORM_COMPLETION_SEND,
+};
+
+enum platform_socket_state {
+  PLATFORM_SOCKET_STATE_CONNECTING = (1 << 0),
+  PLATFORM_SOCKET_STATE_ACCEPTING = (1 << 1),
+  PLATFORM_SOCKET_STATE_RECEIVING = (1 << 2),
+  PLATFORM_SOCKET_STATE_SENDING = (1 << 3),
+};
+
+enum platform_transport_send_flag {
+  // start receiving after send, when socket is not receiving already
+  PLATFORM_TRANSPORT_SEND_RECEIVE = (1 << 0),
+};
+
+/*
+ * Socket is owned by caller and must stay in place while transport has
+ * operations on it.
+ */
+struct platform_socket {
+  s32 fd;
+  // given back in completions
+  void *data;
+  // PLATFORM_SOCKET_STATE_*
+  u16 state;
+  // completions of operations that are started before socket is closed are
+  // dropped
+  u16 generation;
+
+  // read when connect is submitted
+  struct platform_address *address;
+
+  // send in flight
+  u8 *sendBuffer;
+  u64 sendLength;
+  u64 sendOffset;
+
+  // epoll: PLATFORM_EVENT_* socket is registered for
+  u32 interest;
+  // kernel decrypts received records, see PlatformTransportKernelTls()
+  b8 isKernelTls;
+};
+
+struct platform_completion {
+  struct platform_socket *socket;
+  // socket->data
+  void *data;
+  enum platform_completion_type type;
+  /*
+   * CONNECT  0
+   * ACCEPT   accepted socket
+   * RECEIVE  bytes received, 0 when peer closed connection
+   * SEND     bytes sent, every byte is sent
+   * Negative errno on failure.
+   */
+  s32 result;
+  // ACCEPT, RECEIVE: operation goes on, otherwise it must be started again
+  b8 isMore;
+  // RECEIVE: bytes received, give back with PlatformTransportRelease()
+  u16 bufferId;
+  u8 *buffer;
+
+  // socket->generation when completed, socket is closed since when they differ
+  u16 generation;
+};
+
+struct platform_transport_options {
+  // buffers that are shared by every receiving socket, power of two
+  u32 receiveBufferCount;
+  u32 receiveBufferLength;
+  // see PlatformTransportSendBuffer()
+  u32 sendBufferCount;
+  u32 sendBufferLength;
+  b8 isIoUringDisabled;
+};
+
+struct platform_transport {
+  enum platform_transport_backend backend;
+  // system calls made, for benchmarks
+  u64 syscallCount;
+
+  u8 *receiveBuffers;
+  u32 receiveBufferCount;
+  u32 receiveBufferLength;
+
+  u8 *sendBuffers;
+  u32 sendBufferCount;
+  u32 sendBufferLength;
+  u32 sendBufferUsedCount;
+
+  // epoll
+
+  struct platform_reactor reactor;
+  u16 *freeReceiveBufferIds;
+  u32 freeReceiveBufferCount;
+  // completions that are not returned yet
+  struct platform_completion *pending;
+  u32 pendingHead;
+  u32 pendingCount;
+  u32 pendingMax;
+
+  // io_uring
+
+  s32 ringFd;
+  b8 isSendBufferRegistered;
+  void *ringMemory;
+  u64 ringMemoryLength;
+  void *sqes;
+  u64 sqesLength;
+  u32 *sqHead;
+  u32 *sqTail;
+  u32 *sqArray;
+  u32 sqMask;
+  u32 sqEntryCount;
+  u32 submitCount;
+  u32 *cqHead;
+  u32 *cqTail;
+  u32 cqMask;
+  void *cqes;
+  // provided buffer ring for multishot receive
+  void *bufferRing;
+  u64 bufferRingLength;
+  u16 bufferRingTail;
+};
+
+/*
+ * Opens io_uring backend, or epoll when io_uring is not available or disabled.
+ * @return false on error
+ */
+internalfn b8
+PlatformTransportOpen(struct platform_transport *transport, struct platform_transport_options *options);
+
+internalfn void
+PlatformTransportClose(struct platform_transport *transport);
+
+/*
+ * Hands out buffer to send from. On io_uring they are registered, so kernel
+ * does not map them on every send.
+ * @return buffer of sendBufferLength, 0 when every one is handed out
+ */
+internalfn u8 *
+PlatformTransportSendBuffer(struct platform_transport *transport);
+
+/*
+ * Starts connecting, PLATFORM_COMPLETION_CONNECT is reported when done.
+ * @param address must stay in place until connected
+ * @return false on error, see errno
+ */
+internalfn b8
+PlatformTransportConnect(struct platform_transport *transport, struct platform_socket *socket,
+                         struct platform_address *address);
+
+/*
+ * Takes connected socket, e.g. accepted one.
+ * @return false on error, see errno
+ */
+internalfn b8
+PlatformTransportAttach(struct platform_transport *transport, struct platform_socket *socket, s32 fd);
+
+/*
+ * Reports every accepted connection as PLATFORM_COMPLETION_ACCEPT.
+ * @param socket listening socket, see PlatformTransportAttach()
+ */
+internalfn void
+PlatformTransportAccept(struct platform_transport *transport, struct platform_socket *socket);
+
+/*
+ * Reports received bytes as PLATFORM_COMPLETION_RECEIVE until peer closes
+ * connection, an error happens or buffers run out (-ENOBUFS).
+ */
+internalfn void
+PlatformTransportReceive(struct platform_transport *transport, struct platform_socket *socket);
+
+/*
+ * Sends every byte, PLATFORM_COMPLETION_SEND is reported when done. Only one
+ * send can be in flight on socket. Buffer must stay in place until then.
+ * @param flags PLATFORM_TRANSPORT_SEND_*
+ */
+internalfn void
+PlatformTransportSend(struct platform_transport *transport, struct platform_socket *socket, u8 *buffer, u64 length,
+                      u32 flags);
+
+/*
+ * Kernel takes TLS records of one direction of socket over, see
+ * PlatformSocketKernelTls(). Only on epoll, where nothing is read from socket
+ * until it is waited for; receive of io_uring may hold records any time.
+ * Received bytes that are not given out as completions yet refuse receive.
+ * @return false when direction stays as it was, see errno
+ */
+internalfn b8
+PlatformTransportKernelTls(struct platform_transport *transport, struct platform_socket *socket, b8 isSend,
+                           struct platform_tls_key *key);
+
+/*
+ * Gives receive buffer back.
+ */
+internalfn void
+PlatformTransportRelease(struct platform_transport *transport, u16 bufferId);
+
+/*
+ * Closes socket. Completions of operations still in flight are dropped.
+ */
+internalfn void
+PlatformTransportCloseSocket(struct platform_transport *transport, struct platform_socket *socket);
+
+/*
+ * Hands connected socket over to another, e.g. winner of connection attempts
+ * that race. Nothing can be in flight on it. From is closed after, to keeps
+ * its data and generation.
+ * @param to must be closed
+ */
+internalfn void
+PlatformTransportMoveSocket(struct platform_transport *transport, struct platform_socket *from,
+                            struct platform_socket *to);
+
+/*
+ * Submits operations that are started and waits until at least one completes
+ * or timeout passes.
+ * @param timeoutInMilliseconds -1 waits forever
+ * @return number of completions filled, 0 on timeout
+ */
+internalfn u32
+PlatformTransportWait(struct platform_transport *transport, struct platform_completion *completions, u32 completionMax,
+                      s32 timeoutInMilliseconds);
+
+#if IS_PLATFORM_LINUX
+#include "platform_transport_linux.c"
+#endif
@@ -0,0 +1,897 @@
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "assert.h"
+#include "memory.h"
+
+/*
+ * user_data of io_uring operation packs socket with operation and generation
+ * of socket:
+ *
+ *   63       48 47                 3 2         0
+ *   generation  socket               operation
+ *
+ * Operation is completion type + 1, 0 is for operations nobody waits for.
+ */
+#define PLATFORM_TRANSPORT_OPERATION_MASK 0x7ULL
+#define PLATFORM_TRANSPORT_SOCKET_MASK 0x0000fffffffffff8ULL
+#define PLATFORM_TRANSPORT_GENERATION_SHIFT 48
+
+comptime u32 PLATFORM_TRANSPORT_SUBMISSION_MAX = 256;
+comptime u32 PLATFORM_TRANSPORT_COMPLETION_MAX = 4096;
+comptime u32 PLATFORM_TRANSPORT_PENDING_MAX = 4096;
+comptime u16 PLATFORM_TRANSPORT_BUFFER_GROUP = 0;
+
+internalfn void *
+PlatformTransportMap(u64 length)
+{
+  void *memory = mmap(0, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  return memory == MAP_FAILED ? 0 : memory;
+}
+
+internalfn void
+PlatformTransportUnmap(void *memory, u64 length)
+{
+  if (memory)
+    munmap(memory, length);
+}
+
+internalfn u8 *
+PlatformTransportReceiveBuffer(struct platform_transport *transport, u16 bufferId)
+{
+  return transport->receiveBuffers + (u64)bufferId * transport->receiveBufferLength;
+}
+
+internalfn u8 *
+PlatformTransportSendBuffer(struct platform_transport *transport)
+{
+  if (transport->sendBufferUsedCount == transport->sendBufferCount)
+    return 0;
+  u8 *buffer = transport->sendBuffers + (u64)transport->sendBufferUsedCount * transport->sendBufferLength;
+  transport->sendBufferUsedCount++;
+  return buffer;
+}
+
+/*
+ * For io_uring, connect is submitted later.
+ * @return blocking socket, -1 on error
+ */
+internalfn s32
+PlatformTransportSocket(struct platform_transport *transport, s32 family)
+{
+  transport->syscallCount++;
+  return socket(family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+}
+
+internalfn void
+PlatformTransportSetNoDelay(struct platform_transport *transport, s32 fd)
+{
+  // requests are small and written at once, do not wait to coalesce them
+  int isEnabled = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &isEnabled, sizeof(isEnabled));
+  transport->syscallCount++;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// io_uring
+////////////////////////////////////////////////////////////////////////////////
+
+internalfn u64
+PlatformTransportUserData(struct platform_socket *socket, enum platform_completion_type type)
+{
+  u64 address = (u64)socket;
+  debug_assert((address & ~PLATFORM_TRANSPORT_SOCKET_MASK) == 0 && "socket must be 8 byte aligned");
+  return ((u64)socket->generation << PLATFORM_TRANSPORT_GENERATION_SHIFT) | address | ((u64)type + 1);
+}
+
+internalfn s32
+PlatformIoUringEnter(struct platform_transport *transport, u32 minComplete, u32 flags, void *arg, u64 argLength)
+{
+  transport->syscallCount++;
+  long submitted = syscall(__NR_io_uring_enter, transport->ringFd, transport->submitCount, minComplete, flags, arg,
+                           argLength);
+  if (submitted < 0)
+    return -1;
+
+  transport->submitCount -= (u32)submitted;
+  return 0;
+}
+
+/*
+ * @return zeroed submission queue entry, queued and submitted on next wait
+ */
+internalfn struct io_uring_sqe *
+PlatformIoUringSqe(struct platform_transport *transport)
+{
+  u32 tail = *transport->sqTail;
+  if (tail - __atomic_load_n(transport->sqHead, __ATOMIC_ACQUIRE) == transport->sqEntryCount) {
+    // ring is full, submit what is queued to make room
+    PlatformIoUringEnter(transport, 0, 0, 0, 0);
+    debug_assert(tail - __atomic_load_n(transport->sqHead, __ATOMIC_ACQUIRE) < transport->sqEntryCount);
+  }
+
+  u32 index = tail & transport->sqMask;
+  struct io_uring_sqe *sqe = (struct io_uring_sqe *)transport->sqes + index;
+  MemoryClear(sqe, sizeof(*sqe));
+  transport->sqArray[index] = index;
+  // kernel reads entry only when it is submitted, after it is filled
+  __atomic_store_n(transport->sqTail, tail + 1, __ATOMIC_RELEASE);
+  transport->submitCount++;
+  return sqe;
+}
+
+internalfn void
+PlatformIoUringReceive(struct platform_transport *transport, struct platform_socket *socket)
+{
+  struct io_uring_sqe *sqe = PlatformIoUringSqe(transport);
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = socket->fd;
+  // kernel picks buffer from provided buffer ring for every receive
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = PLATFORM_TRANSPORT_BUFFER_GROUP;
+  sqe->user_data = PlatformTransportUserData(socket, PLATFORM_COMPLETION_RECEIVE);
+  socket->state |= PLATFORM_SOCKET_STATE_RECEIVING;
+}
+
+internalfn void
+PlatformIoUringSend(struct platform_transport *transport, struct platform_socket *socket, u8 sqeFlags)
+{
+  struct io_uring_sqe *sqe = PlatformIoUringSqe(transport);
+  sqe->fd = socket->fd;
+  sqe->addr = (u64)(socket->sendBuffer + socket->sendOffset);
+  sqe->len = (u32)(socket->sendLength - socket->sendOffset);
+  sqe->flags = sqeFlags;
+  sqe->user_data = PlatformTransportUserData(socket, PLATFORM_COMPLETION_SEND);
+
+  u64 sendBuffersLength = (u64)transport->sendBufferCount * transport->sendBufferLength;
+  if (transport->isSendBufferRegistered && socket->sendBuffer >= transport->sendBuffers &&
+      socket->sendBuffer < transport->sendBuffers + sendBuffersLength) {
+    // stream socket, offset is not used
+    sqe->opcode = IORING_OP_WRITE_FIXED;
+    sqe->buf_index = (u16)((u64)(socket->sendBuffer - transport->sendBuffers) / transport->sendBufferLength);
+  } else {
+    sqe->opcode = IORING_OP_SEND;
+    sqe->msg_flags = MSG_NOSIGNAL;
+  }
+}
+
+internalfn void
+PlatformIoUringRelease(struct platform_transport *transport, u16 bufferId)
+{
+  struct io_uring_buf_ring *bufferRing = transport->bufferRing;
+  struct io_uring_buf *buffer = bufferRing->bufs + (transport->bufferRingTail & (transport->receiveBufferCount - 1));
+  // tail shares place with resv of first entry, it is not written
+  buffer->addr = (u64)PlatformTransportReceiveBuffer(transport, bufferId);
+  buffer->len = transport->receiveBufferLength;
+  buffer->bid = bufferId;
+  transport->bufferRingTail++;
+  __atomic_store_n(&bufferRing->tail, transport->bufferRingTail, __ATOMIC_RELEASE);
+}
+
+internalfn void
+PlatformIoUringClose(struct platform_transport *transport)
+{
+  PlatformTransportUnmap(transport->bufferRing, transport->bufferRingLength);
+  PlatformTransportUnmap(transport->sqes, transport->sqesLength);
+  if (transport->ringMemory)
+    munmap(transport->ringMemory, transport->ringMemoryLength);
+  if (transport->ringFd != -1)
+    close(transport->ringFd);
+  transport->ringFd = -1;
+}
+
+internalfn b8
+PlatformIoUringOpen(struct platform_transport *transport)
+{
+  /*
+   * Multishot receive needs Linux 6.0 and DEFER_TASKRUN 6.1. Older kernels fail
+   * to setup and epoll is used instead.
+   * Completions are posted only when waited for, on this thread.
+   */
+  struct io_uring_params params = {
+      .flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_SINGLE_ISSUER |
+               IORING_SETUP_DEFER_TASKRUN,
+      .cq_entries = PLATFORM_TRANSPORT_COMPLETION_MAX,
+  };
+  transport->syscallCount++;
+  transport->ringFd = (s32)syscall(__NR_io_uring_setup, PLATFORM_TRANSPORT_SUBMISSION_MAX, &params);
+  if (transport->ringFd == -1)
+    return 0;
+
+  u32 requiredFeatures = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+  if ((params.features & requiredFeatures) != requiredFeatures) {
+    PlatformIoUringClose(transport);
+    return 0;
+  }
+
+  // submission and completion rings share one mapping
+  u64 sqRingLength = params.sq_off.array + params.sq_entries * sizeof(u32);
+  u64 cqRingLength = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  transport->ringMemoryLength = sqRingLength > cqRingLength ? sqRingLength : cqRingLength;
+  transport->syscallCount += 2;
+  void *ringMemory = mmap(0, transport->ringMemoryLength, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          transport->ringFd, IORING_OFF_SQ_RING);
+  transport->sqesLength = params.sq_entries * sizeof(struct io_uring_sqe);
+  void *sqes = mmap(0, transport->sqesLength, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, transport->ringFd,
+                    IORING_OFF_SQES);
+  transport->ringMemory = ringMemory == MAP_FAILED ? 0 : ringMemory;
+  transport->sqes = sqes == MAP_FAILED ? 0 : sqes;
+  if (!transport->ringMemory || !transport->sqes) {
+    PlatformIoUringClose(transport);
+    return 0;
+  }
+
+  u8 *ring = transport->ringMemory;
+  transport->sqHead = (u32 *)(ring + params.sq_off.head);
+  transport->sqTail = (u32 *)(ring + params.sq_off.tail);
+  transport->sqMask = *(u32 *)(ring + params.sq_off.ring_mask);
+  transport->sqArray = (u32 *)(ring + params.sq_off.array);
+  transport->sqEntryCount = params.sq_entries;
+  transport->cqHead = (u32 *)(ring + params.cq_off.head);
+  transport->cqTail = (u32 *)(ring + params.cq_off.tail);
+  transport->cqMask = *(u32 *)(ring + params.cq_off.ring_mask);
+  transport->cqes = ring + params.cq_off.cqes;
+
+  // receive buffers, kernel picks one for every multishot receive
+  transport->bufferRingLength = transport->receiveBufferCount * sizeof(struct io_uring_buf);
+  transport->bufferRing = PlatformTransportMap(transport->bufferRingLength);
+  if (!transport->bufferRing) {
+    PlatformIoUringClose(transport);
+    return 0;
+  }
+
+  struct io_uring_buf_reg bufferRingRegistration = {
+      .ring_addr = (u64)transport->bufferRing,
+      .ring_entries = transport->receiveBufferCount,
+      .bgid = PLATFORM_TRANSPORT_BUFFER_GROUP,
+  };
+  transport->syscallCount++;
+  if (syscall(__NR_io_uring_register, transport->ringFd, IORING_REGISTER_PBUF_RING, &bufferRingRegistration, 1)) {
+    PlatformIoUringClose(transport);
+    return 0;
+  }
+
+  for (u32 bufferId = 0; bufferId < transport->receiveBufferCount; bufferId++)
+    PlatformIoUringRelease(transport, (u16)bufferId);
+
+  // send buffers, registered once instead of being mapped on every send
+  if (transport->sendBufferCount) {
+    u64 iovecsLength = transport->sendBufferCount * sizeof(struct iovec);
+    struct iovec *iovecs = PlatformTransportMap(iovecsLength);
+    if (iovecs) {
+      for (u32 bufferIndex = 0; bufferIndex < transport->sendBufferCount; bufferIndex++) {
+        iovecs[bufferIndex].iov_base = transport->sendBuffers + (u64)bufferIndex * transport->sendBufferLength;
+        iovecs[bufferIndex].iov_len = transport->sendBufferLength;
+      }
+
+      transport->syscallCount++;
+      transport->isSendBufferRegistered = syscall(__NR_io_uring_register, transport->ringFd, IORING_REGISTER_BUFFERS,
+                                                  iovecs, transport->sendBufferCount) == 0;
+      PlatformTransportUnmap(iovecs, iovecsLength);
+    }
+
+    if (transport->isSendBufferRegistered) {
+      // writes on socket cannot say MSG_NOSIGNAL, closed connection must be
+      // reported as EPIPE instead of killing process
+      signal(SIGPIPE, SIG_IGN);
+    }
+  }
+
+  return 1;
+}
+
+internalfn u32
+PlatformIoUringReap(struct platform_transport *transport, struct platform_completion *completions, u32 completionMax)
+{
+  u32 completionCount = 0;
+  u32 head = *transport->cqHead;
+  u32 tail = __atomic_load_n(transport->cqTail, __ATOMIC_ACQUIRE);
+  while (head != tail && completionCount < completionMax) {
+    struct io_uring_cqe *cqe = (struct io_uring_cqe *)transport->cqes + (head & transport->cqMask);
+    head++;
+
+    u64 operation = cqe->user_data & PLATFORM_TRANSPORT_OPERATION_MASK;
+    if (operation == 0)
+      continue;
+
+    struct platform_socket *socket = (struct platform_socket *)(cqe->user_data & PLATFORM_TRANSPORT_SOCKET_MASK);
+    u16 generation = (u16)(cqe->user_data >> PLATFORM_TRANSPORT_GENERATION_SHIFT);
+    b8 isBufferSelected = (cqe->flags & IORING_CQE_F_BUFFER) != 0;
+    u16 bufferId = (u16)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+    b8 isMore = (cqe->flags & IORING_CQE_F_MORE) != 0;
+    if (generation != socket->generation) {
+      // socket is closed since
+      if (isBufferSelected)
+        PlatformIoUringRelease(transport, bufferId);
+      continue;
+    }
+
+    struct platform_completion *completion = completions + completionCount;
+    *completion = (struct platform_completion){
+        .socket = socket,
+        .data = socket->data,
+        .type = (enum platform_completion_type)(operation - 1),
+        .result = cqe->res,
+        .isMore = isMore,
+        .generation = generation,
+    };
+
+    switch (completion->type) {
+    case PLATFORM_COMPLETION_CONNECT: {
+      socket->state &= (u16)~PLATFORM_SOCKET_STATE_CONNECTING;
+    } break;
+
+    case PLATFORM_COMPLETION_ACCEPT: {
+      if (!isMore)
+        socket->state &= (u16)~PLATFORM_SOCKET_STATE_ACCEPTING;
+      if (completion->result >= 0)
+        PlatformTransportSetNoDelay(transport, completion->result);
+    } break;
+
+    case PLATFORM_COMPLETION_RECEIVE: {
+      if (!isMore)
+        socket->state &= (u16)~PLATFORM_SOCKET_STATE_RECEIVING;
+      if (isBufferSelected) {
+        completion->bufferId = bufferId;
+        completion->buffer = PlatformTransportReceiveBuffer(transport, bufferId);
+      }
+
+      if (completion->result == -ECANCELED) {
+        // receive linked to send is canceled when send is short, start again
+        PlatformIoUringReceive(transport, socket);
+        continue;
+      }
+    } break;
+
+    case PLATFORM_COMPLETION_SEND: {
+      if (completion->result > 0) {
+        socket->sendOffset += (u64)completion->result;
+        if (socket->sendOffset < socket->sendLength) {
+          PlatformIoUringSend(transport, socket, 0);
+          continue;
+        }
+        completion->result = (s32)socket->sendLength;
+      }
+      socket->state &= (u16)~PLATFORM_SOCKET_STATE_SENDING;
+    } break;
+    }
+
+    completionCount++;
+  }
+
+  __atomic_store_n(transport->cqHead, head, __ATOMIC_RELEASE);
+  return completionCount;
+}
+
+internalfn u32
+PlatformIoUringWait(struct platform_transport *transport, struct platform_completion *completions, u32 completionMax,
+                    s32 timeoutInMilliseconds)
+{
+  while (1) {
+    // completions that are ready cost no system call, queued operations are
+    // submitted together when there is nothing left to do but wait
+    u32 completionCount = PlatformIoUringReap(transport, completions, completionMax);
+    if (completionCount)
+      return completionCount;
+
+    s32 error;
+    if (timeoutInMilliseconds < 0) {
+      error = PlatformIoUringEnter(transport, 1, IORING_ENTER_GETEVENTS, 0, 0);
+    } else {
+      struct __kernel_timespec timeout = {
+          .tv_sec = timeoutInMilliseconds / 1000,
+          .tv_nsec = (timeoutInMilliseconds % 1000) * 1000000LL,
+      };
+      struct io_uring_getevents_arg arg = {
+          .ts = (u64)&timeout,
+      };
+      error = PlatformIoUringEnter(transport, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+      // kernel reports count of submitted operations instead of ETIME, when
+      // there were any, so waiting again would double timeout
+      if (!error)
+        return PlatformIoUringReap(transport, completions, completionMax);
+    }
+
+    // timeout or interrupted by signal
+    if (error && (errno == ETIME || errno == EINTR))
+      return PlatformIoUringReap(transport, completions, completionMax);
+    if (error)
+      return 0;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// epoll
+////////////////////////////////////////////////////////////////////////////////
+
+internalfn void
+PlatformEpollPush(struct platform_transport *transport, struct platform_socket *socket,
+                  enum platform_completion_type type, s32 result)
+{
+  debug_assert(transport->pendingCount < transport->pendingMax);
+  u32 index = (transport->pendingHead + transport->pendingCount) % transport->pendingMax;
+  transport->pending[index] = (struct platform_completion){
+      .socket = socket,
+      .data = socket->data,
+      .type = type,
+      .result = result,
+      .generation = socket->generation,
+  };
+  transport->pendingCount++;
+}
+
+internalfn void
+PlatformEpollWatch(struct platform_transport *transport, struct platform_socket *socket)
+{
+  u32 interest = 0;
+  if (socket->state & (PLATFORM_SOCKET_STATE_ACCEPTING | PLATFORM_SOCKET_STATE_RECEIVING))
+    interest |= PLATFORM_EVENT_READ;
+  if (socket->state & (PLATFORM_SOCKET_STATE_CONNECTING | PLATFORM_SOCKET_STATE_SENDING))
+    interest |= PLATFORM_EVENT_WRITE;
+  if (socket->interest == interest)
+    return;
+
+  transport->syscallCount++;
+  // on failure next wait reports error of socket
+  if (PlatformReactorModify(&transport->reactor, socket->fd, interest, socket))
+    socket->interest = interest;
+}
+
+internalfn void
+PlatformEpollSend(struct platform_transport *transport, struct platform_socket *socket)
+{
+  while (socket->sendOffset < socket->sendLength) {
+    transport->syscallCount++;
+    s64 bytesWritten = PlatformSocketWrite(socket->fd, socket->sendBuffer + socket->sendOffset,
+                                           socket->sendLength - socket->sendOffset);
+    if (bytesWritten == PLATFORM_SOCKET_WOULD_BLOCK)
+      return;
+    if (bytesWritten == PLATFORM_SOCKET_ERROR) {
+      socket->state &= (u16)~PLATFORM_SOCKET_STATE_SENDING;
+      PlatformEpollPush(transport, socket, PLATFORM_COMPLETION_SEND, -errno);
+      return;
+    }
+    socket->sendOffset += (u64)bytesWritten;
+  }
+
+  socket->state &= (u16)~PLATFORM_SOCKET_STATE_SENDING;
+  PlatformEpollPush(transport, socket, PLATFORM_COMPLETION_SEND, (s32)socket->sendLength);
+}
+
+internalfn void
+PlatformEpollReceive(struct platform_transport *transport, struct platform_socket *socket)
+{
+  if (transport->freeReceiveBufferCount == 0) {
+    socket->state &= (u16)~PLATFORM_SOCKET_STATE_RECEIVING;
+    PlatformEpollPush(transport, socket, PLATFORM_COMPLETION_RECEIVE, -ENOBUFS);
+    return;
+  }
+
+  transport->freeReceiveBufferCount--;
+  u16 bufferId = transport->freeReceiveBufferIds[transport->freeReceiveBufferCount];
+  transport->syscallCount++;
+  u8 *buffer = PlatformTransportReceiveBuffer(transport, bufferId);
+  s64 bytesRead = socket->isKernelTls ? PlatformSocketReadRecord(socket->fd, buffer, transport->receiveBufferLength)
+                                      : PlatformSocketRead(socket->fd, buffer, transport->receiveBufferLength);
+  if (bytesRead > 0) {
+    PlatformEpollPush(transport, socket, PLATFORM_COMPLETION_RECEIVE, (s32)bytesRead);
+    struct platform_completion *completion =
+        transport->pending + (transport->pendingHead + transport->pendingCount - 1) % transport->pendingMax;
+    completion->isMore = 1;
+    completion->bufferId = bufferId;
+    completion->buffer = buffer;
+    return;
+  }
+
+  transport->freeReceiveBufferIds[transport->freeReceiveBufferCount] = bufferId;
+  transport->freeReceiveBufferCount++;
+  if (bytesRead == PLATFORM_SOCKET_WOULD_BLOCK)
+    return;
+
+  socket->state &= (u16)~PLATFORM_SOCKET_STATE_RECEIVING;
+  PlatformEpollPush(transport, socket, PLATFORM_COMPLETION_RECEIVE, bytesRead == 0 ? 0 : -errno);
+}
+
+internalfn void
+PlatformEpollAdvance(struct platform_transport *transport, struct platform_socket *socket, u32 flags)
+{
+  if ((socket->state & PLATFORM_SOCKET_STATE_CONNECTING) && (flags & (PLATFORM_EVENT_WRITE | PLATFORM_EVENT_ERROR))) {
+    transport->syscallCount++;
+    s32 error = PlatformSocketConnectError(socket->fd);
+    if (error != EINPROGRESS && error != EALREADY) {
+      socket->state &= (u16)~PLATFORM_SOCKET_STATE_CONNECTING;
+      PlatformEpollPush(transport, socket, PLATFORM_COMPLETION_CONNECT, -error);
+    }
+  }
+
+  if ((socket->state & PLATFORM_SOCKET_STATE_ACCEPTING) && (flags & (PLATFORM_EVENT_READ | PLATFORM_EVENT_ERROR))) {
+    transport->syscallCount++;
+    s32 accepted = PlatformSocketAccept(socket->fd);
+    if (accepted >= 0) {
+      transport->syscallCount++;
+      PlatformEpollPush(transport, socket, PLATFORM_COMPLETION_ACCEPT, accepted);
+      transport->pending[(transport->pendingHead + transport->pendingCount - 1) % transport->pendingMax].isMore = 1;
+    } else if (accepted == PLATFORM_SOCKET_ERROR) {
+      socket->state &= (u16)~PLATFORM_SOCKET_STATE_ACCEPTING;
+      PlatformEpollPush(transport, socket, PLATFORM_COMPLETION_ACCEPT, -errno);
+    }
+  }
+
+  if ((socket->state & PLATFORM_SOCKET_STATE_SENDING) && (flags & (PLATFORM_EVENT_WRITE | PLATFORM_EVENT_ERROR)))
+    PlatformEpollSend(transport, socket);
+
+  if ((socket->state & PLATFORM_SOCKET_STATE_RECEIVING) && (flags & (PLATFORM_EVENT_READ | PLATFORM_EVENT_ERROR)))
+    PlatformEpollReceive(transport, socket);
+
+  PlatformEpollWatch(transport, socket);
+}
+
+internalfn b8
+PlatformEpollOpen(struct platform_transport *transport)
+{
+  transport->syscallCount++;
+  if (!PlatformReactorOpen(&transport->reactor))
+    return 0;
+
+  transport->freeReceiveBufferIds = PlatformTransportMap(transport->receiveBufferCount * sizeof(u16));
+  transport->pendingMax = PLATFORM_TRANSPORT_PENDING_MAX;
+  transport->pending = PlatformTransportMap(transport->pendingMax * sizeof(*transport->pending));
+  if (!transport->freeReceiveBufferIds || !transport->pending)
+    return 0;
+
+  for (u32 bufferId = 0; bufferId < transport->receiveBufferCount; bufferId++)
+    transport->freeReceiveBufferIds[transport->receiveBufferCount - 1 - bufferId] = (u16)bufferId;
+  transport->freeReceiveBufferCount = transport->receiveBufferCount;
+  return 1;
+}
+
+internalfn u32
+PlatformEpollWait(struct platform_transport *transport, struct platform_completion *completions, u32 completionMax,
+                  s32 timeoutInMilliseconds)
+{
+  if (transport->pendingCount == 0) {
+    struct platform_event events[64];
+    // pending is empty, every event pushes at most 3 completions
+    u32 eventMax = ARRAY_COUNT(events);
+    if (eventMax > completionMax)
+      eventMax = completionMax;
+
+    transport->syscallCount++;
+    u32 eventCount = PlatformReactorWait(&transport->reactor, events, eventMax, timeoutInMilliseconds);
+    for (u32 eventIndex = 0; eventIndex < eventCount; eventIndex++)
+      PlatformEpollAdvance(transport, events[eventIndex].data, events[eventIndex].flags);
+  }
+
+  u32 completionCount = 0;
+  while (transport->pendingCount && completionCount < completionMax) {
+    struct platform_completion *completion = transport->pending + transport->pendingHead;
+    transport->pendingHead = (transport->pendingHead + 1) % transport->pendingMax;
+    transport->pendingCount--;
+
+    if (completion->generation != completion->socket->generation) {
+      // socket is closed since
+      if (completion->buffer)
+        PlatformTransportRelease(transport, completion->bufferId);
+      continue;
+    }
+
+    completions[completionCount] = *completion;
+    // socket may be handed to someone else meanwhile
+    completions[completionCount].data = completion->socket->data;
+    completionCount++;
+  }
+
+  return completionCount;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// transport
+////////////////////////////////////////////////////////////////////////////////
+
+internalfn void
+PlatformTransportClose(struct platform_transport *transport)
+{
+  if (transport->backend == PLATFORM_TRANSPORT_BACKEND_IO_URING) {
+    PlatformIoUringClose(transport);
+  } else {
+    if (transport->reactor.fd != -1)
+      PlatformReactorClose(&transport->reactor);
+    PlatformTransportUnmap(transport->freeReceiveBufferIds, transport->receiveBufferCount * sizeof(u16));
+    PlatformTransportUnmap(transport->pending, transport->pendingMax * sizeof(*transport->pending));
+  }
+
+  PlatformTransportUnmap(transport->receiveBuffers,
+                         (u64)transport->receiveBufferCount * transport->receiveBufferLength);
+  PlatformTransportUnmap(transport->sendBuffers, (u64)transport->sendBufferCount * transport->sendBufferLength);
+  *transport = (struct platform_transport){
+      .reactor.fd = -1,
+      .ringFd = -1,
+  };
+}
+
+internalfn b8
+PlatformTransportOpen(struct platform_transport *transport, struct platform_transport_options *options)
+{
+  debug_assert(options->receiveBufferCount > 0 && options->receiveBufferCount <= 32768 &&
+               (options->receiveBufferCount & (options->receiveBufferCount - 1)) == 0 && "must be power of two");
+
+  *transport = (struct platform_transport){
+      .reactor.fd = -1,
+      .ringFd = -1,
+      .receiveBufferCount = options->receiveBufferCount,
+      .receiveBufferLength = options->receiveBufferLength,
+      .sendBufferCount = options->sendBufferCount,
+      .sendBufferLength = options->sendBufferLength,
+  };
+
+  transport->receiveBuffers = PlatformTransportMap((u64)options->receiveBufferCount * options->receiveBufferLength);
+  if (!transport->receiveBuffers) {
+    PlatformTransportClose(transport);
+    return 0;
+  }
+
+  if (options->sendBufferCount) {
+    transport->sendBuffers = PlatformTransportMap((u64)options->sendBufferCount * options->sendBufferLength);
+    if (!transport->sendBuffers) {
+      PlatformTransportClose(transport);
+      return 0;
+    }
+  }
+
+  if (!options->isIoUringDisabled && PlatformIoUringOpen(transport)) {
+    transport->backend = PLATFORM_TRANSPORT_BACKEND_IO_URING;
+    return 1;
+  }
+
+  transport->backend = PLATFORM_TRANSPORT_BACKEND_EPOLL;
+  if (!PlatformEpollOpen(transport)) {
+    PlatformTransportClose(transport);
+    return 0;
+  }
+  return 1;
+}
+
+internalfn b8
+PlatformTransportConnect(struct platform_transport *transport, struct platform_socket *socket,
+                         struct platform_address *address)
+{
+  socket->state = 0;
+  socket->interest = 0;
+  socket->isKernelTls = 0;
+  socket->address = address;
+
+  if (transport->backend == PLATFORM_TRANSPORT_BACKEND_IO_URING) {
+    socket->fd = PlatformTransportSocket(transport, address->family);
+    if (socket->fd == -1)
+      return 0;
+    PlatformTransportSetNoDelay(transport, socket->fd);
+
+    struct io_uring_sqe *sqe = PlatformIoUringSqe(transport);
+    sqe->opcode = IORING_OP_CONNECT;
+    sqe->fd = socket->fd;
+    sqe->addr = (u64)address->value;
+    sqe->off = address->length;
+    sqe->user_data = PlatformTransportUserData(socket, PLATFORM_COMPLETION_CONNECT);
+    socket->state = PLATFORM_SOCKET_STATE_CONNECTING;
+    return 1;
+  }
+
+  // socket, setsockopt and connect
+  transport->syscallCount += 3;
+  socket->fd = PlatformSocketConnect(address);
+  if (socket->fd == -1)
+    return 0;
+
+  socket->state = PLATFORM_SOCKET_STATE_CONNECTING;
+  socket->interest = PLATFORM_EVENT_WRITE;
+  transport->syscallCount++;
+  if (!PlatformReactorAdd(&transport->reactor, socket->fd, socket->interest, socket)) {
+    int error = errno;
+    PlatformSocketClose(socket->fd);
+    socket->fd = -1;
+    socket->state = 0;
+    errno = error;
+    return 0;
+  }
+  return 1;
+}
+
+internalfn b8
+PlatformTransportAttach(struct platform_transport *transport, struct platform_socket *socket, s32 fd)
+{
+  socket->fd = fd;
+  socket->state = 0;
+  socket->interest = 0;
+  socket->isKernelTls = 0;
+
+  if (transport->backend == PLATFORM_TRANSPORT_BACKEND_IO_URING)
+    return 1;
+
+  transport->syscallCount++;
+  return PlatformReactorAdd(&transport->reactor, socket->fd, socket->interest, socket);
+}
+
+internalfn void
+PlatformTransportAccept(struct platform_transport *transport, struct platform_socket *socket)
+{
+  if (transport->backend == PLATFORM_TRANSPORT_BACKEND_IO_URING) {
+    struct io_uring_sqe *sqe = PlatformIoUringSqe(transport);
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = socket->fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = PlatformTransportUserData(socket, PLATFORM_COMPLETION_ACCEPT);
+    socket->state |= PLATFORM_SOCKET_STATE_ACCEPTING;
+    return;
+  }
+
+  socket->state |= PLATFORM_SOCKET_STATE_ACCEPTING;
+  PlatformEpollWatch(transport, socket);
+}
+
+internalfn void
+PlatformTransportReceive(struct platform_transport *transport, struct platform_socket *socket)
+{
+  debug_assert(!(socket->state & PLATFORM_SOCKET_STATE_RECEIVING));
+
+  if (transport->backend == PLATFORM_TRANSPORT_BACKEND_IO_URING) {
+    PlatformIoUringReceive(transport, socket);
+    return;
+  }
+
+  socket->state |= PLATFORM_SOCKET_STATE_RECEIVING;
+  PlatformEpollWatch(transport, socket);
+}
+
+internalfn void
+PlatformTransportSend(struct platform_transport *transport, struct platform_socket *socket, u8 *buffer, u64 length,
+                      u32 flags)
+{
+  debug_assert(!(socket->state & PLATFORM_SOCKET_STATE_SENDING) && "only one send can be in flight");
+  debug_assert(length > 0);
+
+  socket->sendBuffer = buffer;
+  socket->sendLength = length;
+  socket->sendOffset = 0;
+  socket->state |= PLATFORM_SOCKET_STATE_SENDING;
+  b8 isReceiveStarted = (flags & PLATFORM_TRANSPORT_SEND_RECEIVE) && !(socket->state & PLATFORM_SOCKET_STATE_RECEIVING);
+
+  if (transport->backend == PLATFORM_TRANSPORT_BACKEND_IO_URING) {
+    // receive is submitted only after send, in same system call
+    PlatformIoUringSend(transport, socket, isReceiveStarted ? IOSQE_IO_LINK : 0);
+    if (isReceiveStarted)
+      PlatformIoUringReceive(transport, socket);
+    return;
+  }
+
+  if (isReceiveStarted)
+    socket->state |= PLATFORM_SOCKET_STATE_RECEIVING;
+  // socket is usually writable, try before waiting for it
+  if (transport->pendingCount < transport->pendingMax)
+    PlatformEpollSend(transport, socket);
+  PlatformEpollWatch(transport, socket);
+}
+
+internalfn b8
+PlatformTransportKernelTls(struct platform_transport *transport, struct platform_socket *socket, b8 isSend,
+                           struct platform_tls_key *key)
+{
+  if (transport->backend != PLATFORM_TRANSPORT_BACKEND_EPOLL) {
+    errno = EOPNOTSUPP;
+    return 0;
+  }
+
+  if (!isSend) {
+    for (u32 pendingIndex = 0; pendingIndex < transport->pendingCount; pendingIndex++) {
+      struct platform_completion *completion =
+          transport->pending + (transport->pendingHead + pendingIndex) % transport->pendingMax;
+      if (completion->socket == socket && completion->type == PLATFORM_COMPLETION_RECEIVE &&
+          completion->generation == socket->generation) {
+        errno = EBUSY;
+        return 0;
+      }
+    }
+  }
+
+  transport->syscallCount += 2;
+  if (!PlatformSocketKernelTls(socket->fd, isSend, key))
+    return 0;
+  if (!isSend)
+    socket->isKernelTls = 1;
+  return 1;
+}
+
+internalfn void
+PlatformTransportRelease(struct platform_transport *transport, u16 bufferId)
+{
+  debug_assert(bufferId < transport->receiveBufferCount);
+
+  if (transport->backend == PLATFORM_TRANSPORT_BACKEND_IO_URING) {
+    PlatformIoUringRelease(transport, bufferId);
+    return;
+  }
+
+  debug_assert(transport->freeReceiveBufferCount < transport->receiveBufferCount);
+  transport->freeReceiveBufferIds[transport->freeReceiveBufferCount] = bufferId;
+  transport->freeReceiveBufferCount++;
+}
+
+internalfn void
+PlatformTransportCloseSocket(struct platform_transport *transport, struct platform_socket *socket)
+{
+  if (socket->fd == -1)
+    return;
+
+  if (transport->backend == PLATFORM_TRANSPORT_BACKEND_IO_URING) {
+    /*
+     * Operations in flight hold socket open, they are canceled first. Close
+     * follows cancel even when there is nothing to cancel.
+     */
+    if (socket->state) {
+      struct io_uring_sqe *sqe = PlatformIoUringSqe(transport);
+      sqe->opcode = IORING_OP_ASYNC_CANCEL;
+      sqe->fd = socket->fd;
+      sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+      sqe->flags = IOSQE_IO_HARDLINK;
+    }
+
+    struct io_uring_sqe *sqe = PlatformIoUringSqe(transport);
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = socket->fd;
+  } else {
+    transport->syscallCount += 2;
+    PlatformReactorRemove(&transport->reactor, socket->fd);
+    PlatformSocketClose(socket->fd);
+  }
+
+  socket->fd = -1;
+  socket->state = 0;
+  socket->interest = 0;
+  socket->isKernelTls = 0;
+  socket->generation++;
+}
+
+internalfn void
+PlatformTransportMoveSocket(struct platform_transport *transport, struct platform_socket *from,
+                            struct platform_socket *to)
+{
+  debug_assert(from->fd != -1 && from->state == 0 && "nothing can be in flight");
+  debug_assert(to->fd == -1);
+
+  to->fd = from->fd;
+  to->state = 0;
+  to->address = from->address;
+  to->interest = from->interest;
+  to->isKernelTls = from->isKernelTls;
+
+  // io_uring finds socket through user data of operations, none is in flight
+  if (transport->backend == PLATFORM_TRANSPORT_BACKEND_EPOLL) {
+    transport->syscallCount++;
+    // on failure next wait reports error of socket
+    PlatformReactorModify(&transport->reactor, to->fd, to->interest, to);
+  }
+
+  from->fd = -1;
+  from->state = 0;
+  from->interest = 0;
+  from->isKernelTls = 0;
+  from->generation++;
+}
+
+internalfn u32
+PlatformTransportWait(struct platform_transport *transport, struct platform_completion *completions, u32 completionMax,
+                      s32 timeoutInMilliseconds)
+{
+  if (transport->backend == PLATFORM_TRANSPORT_BACKEND_IO_URING)
+    return PlatformIoUringWait(transport, completions, completionMax, timeoutInMilliseconds);
+  return PlatformEpollWait(transport, completions, completionMax, timeoutInMilliseconds);
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+/*
+ * Growable receive buffer
+ *
+ * Buffer lives at start of reserved address space, see src/platform_memory.h.
+ * When it is full, capacity is doubled by committing pages after it, so it
+ * grows in place: nothing is copied and tokens that point into it stay valid.
+ * Response whose length is known up front is given its whole capacity at once
+ * with ReceiveBufferGrow(). After large response is consumed, pages past what
+ * is still in buffer are given back with ReceiveBufferTrim().
+ *
+ * @code
+ *   ReceiveBufferInit(&buffer, 256 << 20)
+ *   while (1) {
+ *     if (buffer.length == buffer.capacity && !ReceiveBufferGrow(&buffer, buffer.length + 1))
+ *       error("response is too large")
+ *     buffer.length += read(buffer.value + buffer.length, buffer.capacity - buffer.length)
+ *     parse, ReceiveBufferGrow(&buffer, length of response) when it is known
+ *     ReceiveBufferConsume(&buffer, length of parsed response)
+ *     ReceiveBufferTrim(&buffer)
+ *   }
+ *   ReceiveBufferRelease(&buffer)
+ * @endcode
+ */
+
+#include "memory.h"
+#include "platform_memory.h"
+#include "text.h"
+#include "type.h"
+
+struct receive_buffer {
+  u8 *value;
+  // bytes in buffer
+  u64 length;
+  // bytes that can be written without growing
+  u64 capacity;
+  // buffer never grows past this, 0 when it is not initialized
+  u64 reserved;
+};
+
+/*
+ * Capacity that is always kept, small responses never commit or give back
+ * pages.
+ */
+comptime u64 RECEIVE_BUFFER_CAPACITY_MIN = PLATFORM_MEMORY_COMMIT_GRANULARITY;
+
+internalfn u64
+ReceiveBufferRoundUp(u64 length)
+{
+  return (length + PLATFORM_MEMORY_COMMIT_GRANULARITY - 1) & ~(PLATFORM_MEMORY_COMMIT_GRANULARITY - 1);
+}
+
+/*
+ * @param reserved upper limit of capacity
+ * @return false when address space cannot be reserved or committed
+ */
+internalfn b8
+ReceiveBufferInit(struct receive_buffer *buffer, u64 reserved)
+{
+  reserved = ReceiveBufferRoundUp(reserved);
+  debug_assert(reserved >= RECEIVE_BUFFER_CAPACITY_MIN);
+  *buffer = (struct receive_buffer){};
+
+  u8 *block = PlatformMemoryReserve(reserved);
+  if (!block)
+    return 0;
+
+  if (!PlatformMemoryCommit(block, RECEIVE_BUFFER_CAPACITY_MIN)) {
+    PlatformMemoryRelease(block, reserved);
+    return 0;
+  }
+
+  buffer->value = block;
+  buffer->capacity = RECEIVE_BUFFER_CAPACITY_MIN;
+  buffer->reserved = reserved;
+  return 1;
+}
+
+/*
+ * Makes capacity at least given one. Capacity is at least doubled so buffer
+ * that is filled by small reads grows few times.
+ * @return false when capacity does not fit in reservation or system is out of
+ *         memory, buffer stays as it was
+ */
+internalfn b8
+ReceiveBufferGrow(struct receive_buffer *buffer, u64 capacity)
+{
+  if (capacity <= buffer->capacity)
+    return 1;
+  if (capacity > buffer->reserved)
+    return 0;
+
+  u64 newCapacity = 2 * buffer->capacity;
+  if (newCapacity < capacity)
+    newCapacity = capacity;
+  newCapacity = ReceiveBufferRoundUp(newCapacity);
+  if (newCapacity > buffer->reserved)
+    newCapacity = buffer->reserved;
+
+  if (!PlatformMemoryCommit(buffer->value + buffer->capacity, newCapacity - buffer->capacity))
+    return 0;
+
+  buffer->capacity = newCapacity;
+  return 1;
+}
+
+/*
+ * @return false when buffer cannot grow to fit data, see ReceiveBufferGrow()
+ */
+internalfn b8
+ReceiveBufferAppend(struct receive_buffer *buffer, struct string *data)
+{
+  if (!ReceiveBufferGrow(buffer, buffer->length + data->length))
+    return 0;
+
+  MemoryCopy(buffer->value + buffer->length, data->value, data->length);
+  buffer->length += data->length;
+  return 1;
+}
+
+/*
+ * Drops bytes from start of buffer, rest is moved to start.
+ */
+internalfn void
+ReceiveBufferConsume(struct receive_buffer *buffer, u64 length)
+{
+  debug_assert(length <= buffer->length);
+  MemoryMove(buffer->value, buffer->value + length, buffer->length - length);
+  buffer->length -= length;
+}
+
+/*
+ * Gives back pages past bytes in buffer, down to RECEIVE_BUFFER_CAPACITY_MIN.
+ * Costs nothing when buffer did not grow.
+ */
+internalfn void
+ReceiveBufferTrim(struct receive_buffer *buffer)
+{
+  u64 capacity = ReceiveBufferRoundUp(buffer->length);
+  if (capacity < RECEIVE_BUFFER_CAPACITY_MIN)
+    capacity = RECEIVE_BUFFER_CAPACITY_MIN;
+  if (capacity >= buffer->capacity)
+    return;
+
+  PlatformMemoryDecommit(buffer->value + capacity, buffer->capacity - capacity);
+  buffer->capacity = capacity;
+}
+
+internalfn void
+ReceiveBufferRelease(struct receive_buffer *buffer)
+{
+  if (buffer->reserved != 0)
+    PlatformMemoryRelease(buffer->value, buffer->reserved);
+  *buffer = (struct receive_buffer){};
+}
@@ -0,0 +1,289 @@
+#pragma once
+
+/*
+ * Request timing
+ *
+ * Every step a request goes through is marked with NowInNanoseconds(), and
+ * phases are differences between marks:
+ *
+ *   START  RESOLVED  CONNECTING  CONNECTED  OPENED  SENT  FIRST_BYTE  RECEIVED  PARSING  PARSED
+ *     |-dns-|            |-connect-|---tls---|        |-ttfb-|-transfer-|          |-parse-|
+ *     |--------------------------------------- total ---------------------------------------|
+ *
+ * Step that request does not go through is not marked and its phase is 0,
+ * e.g. request on connection that was open before request started pays no
+ * connect or TLS. Rest of total is queue: waiting for connection to be taken,
+ * for earlier requests on same connection, or for earlier videos to be
+ * printed.
+ *
+ * Marks are fixed size, they are kept for every request in flight without
+ * allocating. Histogram takes phases of many requests, so percentiles of
+ * batch can be told.
+ *
+ * @code
+ *   struct request_timing timing = {};
+ *   RequestTimingMark(&timing, REQUEST_TIMING_MARK_START, NowInNanoseconds())
+ *   ...
+ *   RequestTimingMark(&timing, REQUEST_TIMING_MARK_PARSED, NowInNanoseconds())
+ *   RequestTimingPhase(&timing, REQUEST_TIMING_PHASE_TTFB)
+ *   RequestTimingHistogramAdd(&histogram, &timing)
+ *   RequestTimingHistogramPercentile(&histogram, REQUEST_TIMING_PHASE_TTFB, 99)
+ * @endcode
+ */
+
+#include "string_builder.h"
+#include "text.h"
+#include "type.h"
+
+enum request_timing_mark {
+  REQUEST_TIMING_MARK_START,
+  // address of instance is known
+  REQUEST_TIMING_MARK_RESOLVED,
+  // TCP connection is being established
+  REQUEST_TIMING_MARK_CONNECTING,
+  REQUEST_TIMING_MARK_CONNECTED,
+  // TLS handshake is done, same as connected for plain connection
+  REQUEST_TIMING_MARK_OPENED,
+  // last byte of request is written
+  REQUEST_TIMING_MARK_SENT,
+  REQUEST_TIMING_MARK_FIRST_BYTE,
+  // response is complete
+  REQUEST_TIMING_MARK_RECEIVED,
+  REQUEST_TIMING_MARK_PARSING,
+  REQUEST_TIMING_MARK_PARSED,
+  REQUEST_TIMING_MARK_COUNT,
+};
+
+enum request_timing_phase {
+  REQUEST_TIMING_PHASE_DNS,
+  REQUEST_TIMING_PHASE_CONNECT,
+  REQUEST_TIMING_PHASE_TLS,
+  REQUEST_TIMING_PHASE_QUEUE,
+  REQUEST_TIMING_PHASE_TTFB,
+  REQUEST_TIMING_PHASE_TRANSFER,
+  REQUEST_TIMING_PHASE_PARSE,
+  REQUEST_TIMING_PHASE_TOTAL,
+  REQUEST_TIMING_PHASE_COUNT,
+};
+
+struct request_timing {
+  // in nanoseconds, see NowInNanoseconds(), 0 when not marked
+  u64 marks[REQUEST_TIMING_MARK_COUNT];
+};
+
+/*
+ * Marks step of request, first time it is done. Later marks of same step are
+ * ignored, e.g. every read marks first byte.
+ * @param now see NowInNanoseconds()
+ */
+internalfn void
+RequestTimingMark(struct request_timing *timing, enum request_timing_mark mark, u64 now)
+{
+  if (timing->marks[mark] == 0)
+    timing->marks[mark] = now;
+}
+
+internalfn u64
+RequestTimingBetween(struct request_timing *timing, enum request_timing_mark from, enum request_timing_mark to)
+{
+  u64 start = timing->marks[from];
+  u64 end = timing->marks[to];
+  if (start == 0 || end < start)
+    return 0;
+  return end - start;
+}
+
+/*
+ * @return nanoseconds, 0 when request did not go through phase
+ */
+internalfn u64
+RequestTimingPhase(struct request_timing *timing, enum request_timing_phase phase)
+{
+  switch (phase) {
+  case REQUEST_TIMING_PHASE_DNS:
+    return RequestTimingBetween(timing, REQUEST_TIMING_MARK_START, REQUEST_TIMING_MARK_RESOLVED);
+  case REQUEST_TIMING_PHASE_CONNECT:
+    return RequestTimingBetween(timing, REQUEST_TIMING_MARK_CONNECTING, REQUEST_TIMING_MARK_CONNECTED);
+  case REQUEST_TIMING_PHASE_TLS:
+    return RequestTimingBetween(timing, REQUEST_TIMING_MARK_CONNECTED, REQUEST_TIMING_MARK_OPENED);
+  case REQUEST_TIMING_PHASE_TTFB:
+    return RequestTimingBetween(timing, REQUEST_TIMING_MARK_SENT, REQUEST_TIMING_MARK_FIRST_BYTE);
+  case REQUEST_TIMING_PHASE_TRANSFER:
+    return RequestTimingBetween(timing, REQUEST_TIMING_MARK_FIRST_BYTE, REQUEST_TIMING_MARK_RECEIVED);
+  case REQUEST_TIMING_PHASE_PARSE:
+    return RequestTimingBetween(timing, REQUEST_TIMING_MARK_PARSING, REQUEST_TIMING_MARK_PARSED);
+  case REQUEST_TIMING_PHASE_TOTAL:
+    return RequestTimingBetween(timing, REQUEST_TIMING_MARK_START, REQUEST_TIMING_MARK_PARSED);
+
+  case REQUEST_TIMING_PHASE_QUEUE: {
+    u64 queue = RequestTimingPhase(timing, REQUEST_TIMING_PHASE_TOTAL);
+    for (enum request_timing_phase other = REQUEST_TIMING_PHASE_DNS; other < REQUEST_TIMING_PHASE_TOTAL; other++) {
+      if (other == REQUEST_TIMING_PHASE_QUEUE)
+        continue;
+      u64 duration = RequestTimingPhase(timing, other);
+      queue = duration < queue ? queue - duration : 0;
+    }
+    return queue;
+  }
+
+  case REQUEST_TIMING_PHASE_COUNT:
+    break;
+  }
+
+  return 0;
+}
+
+internalfn struct string
+RequestTimingPhaseName(enum request_timing_phase phase)
+{
+  struct string names[REQUEST_TIMING_PHASE_COUNT] = {
+      [REQUEST_TIMING_PHASE_DNS] = StringFromLiteral("dns"),
+      [REQUEST_TIMING_PHASE_CONNECT] = StringFromLiteral("connect"),
+      [REQUEST_TIMING_PHASE_TLS] = StringFromLiteral("tls"),
+      [REQUEST_TIMING_PHASE_QUEUE] = StringFromLiteral("queue"),
+      [REQUEST_TIMING_PHASE_TTFB] = StringFromLiteral("ttfb"),
+      [REQUEST_TIMING_PHASE_TRANSFER] = StringFromLiteral("transfer"),
+      [REQUEST_TIMING_PHASE_PARSE] = StringFromLiteral("parse"),
+      [REQUEST_TIMING_PHASE_TOTAL] = StringFromLiteral("total"),
+  };
+  return names[phase];
+}
+
+/*
+ * Appends phases in microseconds, as one line that scripts can split:
+ *   dns=0 connect=180 tls=2150 queue=12 ttfb=48210 transfer=310 parse=95 total=50957
+ */
+internalfn void
+StringBuilderAppendRequestTiming(string_builder *sb, struct request_timing *timing)
+{
+  for (enum request_timing_phase phase = 0; phase < REQUEST_TIMING_PHASE_COUNT; phase++) {
+    if (phase != 0)
+      StringBuilderAppendStringLiteral(sb, " ");
+    struct string name = RequestTimingPhaseName(phase);
+    StringBuilderAppendString(sb, &name);
+    StringBuilderAppendStringLiteral(sb, "=");
+    StringBuilderAppendU64(sb, RequestTimingPhase(timing, phase) / 1000);
+  }
+}
+
+/*
+ * Histogram of phases
+ *
+ * Durations are counted in microseconds, in buckets that are a quarter of
+ * power of two wide: 0 1 2 3 | 4 5 6 7 | 8 10 12 14 | 16 20 24 28 | ...
+ * Percentile is told by upper end of its bucket, off by at most 25%.
+ */
+
+enum {
+  REQUEST_TIMING_HISTOGRAM_SUB_BUCKET_COUNT = 4,
+  // up to 2^40 us, about 12 days
+  REQUEST_TIMING_HISTOGRAM_BUCKET_COUNT = 4 + 39 * REQUEST_TIMING_HISTOGRAM_SUB_BUCKET_COUNT,
+};
+
+struct request_timing_histogram {
+  u32 requestCount;
+  u32 counts[REQUEST_TIMING_PHASE_COUNT][REQUEST_TIMING_HISTOGRAM_BUCKET_COUNT];
+  // in microseconds, percentiles never go past it
+  u64 max[REQUEST_TIMING_PHASE_COUNT];
+};
+
+internalfn u32
+RequestTimingHistogramBucket(u64 microseconds)
+{
+  if (microseconds < REQUEST_TIMING_HISTOGRAM_SUB_BUCKET_COUNT)
+    return (u32)microseconds;
+
+  // two bits after leading one pick sub bucket
+  u32 log2 = 63 - (u32)__builtin_clzll(microseconds);
+  u32 subBucket = (u32)(microseconds >> (log2 - 2)) & 3;
+  u32 bucket = REQUEST_TIMING_HISTOGRAM_SUB_BUCKET_COUNT + (log2 - 2) * REQUEST_TIMING_HISTOGRAM_SUB_BUCKET_COUNT +
+               subBucket;
+  if (bucket >= REQUEST_TIMING_HISTOGRAM_BUCKET_COUNT)
+    bucket = REQUEST_TIMING_HISTOGRAM_BUCKET_COUNT - 1;
+  return bucket;
+}
+
+/*
+ * @return largest microseconds that falls in bucket
+ */
+internalfn u64
+RequestTimingHistogramBucketEnd(u32 bucket)
+{
+  if (bucket < REQUEST_TIMING_HISTOGRAM_SUB_BUCKET_COUNT)
+    return bucket;
+
+  u32 shift = (bucket - REQUEST_TIMING_HISTOGRAM_SUB_BUCKET_COUNT) / REQUEST_TIMING_HISTOGRAM_SUB_BUCKET_COUNT;
+  u64 subBucket = (bucket - REQUEST_TIMING_HISTOGRAM_SUB_BUCKET_COUNT) % REQUEST_TIMING_HISTOGRAM_SUB_BUCKET_COUNT;
+  u64 start = (REQUEST_TIMING_HISTOGRAM_SUB_BUCKET_COUNT + subBucket) << shift;
+  return start + (1ULL << shift) - 1;
+}
+
+/*
+ * Counts every phase of request, phases it did not go through as 0.
+ */
+internalfn void
+RequestTimingHistogramAdd(struct request_timing_histogram *histogram, struct request_timing *timing)
+{
+  histogram->requestCount++;
+  for (enum request_timing_phase phase = 0; phase < REQUEST_TIMING_PHASE_COUNT; phase++) {
+    u64 microseconds = RequestTimingPhase(timing, phase) / 1000;
+    histogram->counts[phase][RequestTimingHistogramBucket(microseconds)]++;
+    if (microseconds > histogram->max[phase])
+      histogram->max[phase] = microseconds;
+  }
+}
+
+/*
+ * @param percent e.g. 99 for p99
+ * @return microseconds, 0 when histogram is empty
+ */
+internalfn u64
+RequestTimingHistogramPercentile(struct request_timing_histogram *histogram, enum request_timing_phase phase,
+                                 u32 percent)
+{
+  if (histogram->requestCount == 0)
+    return 0;
+
+  // rank of request, rounded up so p100 is last one
+  u64 rank = ((u64)histogram->requestCount * percent + 99) / 100;
+  if (rank == 0)
+    rank = 1;
+
+  u64 count = 0;
+  for (u32 bucket = 0; bucket < REQUEST_TIMING_HISTOGRAM_BUCKET_COUNT; bucket++) {
+    count += histogram->counts[phase][bucket];
+    if (count < rank)
+      continue;
+
+    u64 end = RequestTimingHistogramBucketEnd(bucket);
+    return end < histogram->max[phase] ? end : histogram->max[phase];
+  }
+  return histogram->max[phase];
+}
+
+/*
+ * Appends one line for every phase, in microseconds:
+ *   ttfb count=512 p50=47000 p90=55000 p99=63000 max=61234
+ */
+internalfn void
+StringBuilderAppendRequestTimingHistogram(string_builder *sb, struct request_timing_histogram *histogram,
+                                          struct string *prefix)
+{
+  u32 percents[] = {50, 90, 99};
+  for (enum request_timing_phase phase = 0; phase < REQUEST_TIMING_PHASE_COUNT; phase++) {
+    StringBuilderAppendString(sb, prefix);
+    struct string name = RequestTimingPhaseName(phase);
+    StringBuilderAppendString(sb, &name);
+    StringBuilderAppendStringLiteral(sb, " count=");
+    StringBuilderAppendU32(sb, histogram->requestCount);
+    for (u32 percentIndex = 0; percentIndex < ARRAY_COUNT(percents); percentIndex++) {
+      StringBuilderAppendStringLiteral(sb, " p");
+      StringBuilderAppendU32(sb, percents[percentIndex]);
+      StringBuilderAppendStringLiteral(sb, "=");
+      StringBuilderAppendU64(sb, RequestTimingHistogramPercentile(histogram, phase, percents[percentIndex]));
+    }
+    StringBuilderAppendStringLiteral(sb, " max=");
+    StringBuilderAppendU64(sb, histogram->max[phase]);
+    StringBuilderAppendStringLiteral(sb, "\n");
+  }
+}
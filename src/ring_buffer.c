@@ -0,0 +1,97 @@
+#pragma once
+
+/*
+ * Ring buffer that is always contiguous
+ *
+ * Pages of ring are mapped twice, back to back, see PlatformMemoryMapRing().
+ * Bytes in ring and free space after them are each one span in memory, even
+ * when they wrap around end of ring. Parsers take them as plain strings, and
+ * consumed bytes are dropped by moving start of ring instead of moving what is
+ * left. Memory stays at capacity however long connection lives.
+ *
+ * @code
+ *   RingBufferInit(&ring, 64 << 10)
+ *   while (1) {
+ *     space = RingBufferSpace(&ring)
+ *     ring.length += read(space.value, space.length)
+ *     data = RingBufferData(&ring)
+ *     parse(data)
+ *     RingBufferConsume(&ring, length of parsed data)
+ *   }
+ *   RingBufferRelease(&ring)
+ * @endcode
+ */
+
+#include "assert.h"
+#include "platform_memory.h"
+#include "text.h"
+#include "type.h"
+
+struct ring_buffer {
+  // capacity bytes that are mapped twice, null when ring is not initialized
+  u8 *value;
+  u64 capacity;
+  // offset of first byte, below capacity
+  u64 start;
+  // bytes in ring
+  u64 length;
+};
+
+/*
+ * @param capacity rounded up to PLATFORM_MEMORY_COMMIT_GRANULARITY
+ * @return false when ring cannot be mapped
+ */
+internalfn b8
+RingBufferInit(struct ring_buffer *ring, u64 capacity)
+{
+  capacity = (capacity + PLATFORM_MEMORY_COMMIT_GRANULARITY - 1) & ~(PLATFORM_MEMORY_COMMIT_GRANULARITY - 1);
+  *ring = (struct ring_buffer){};
+
+  u8 *block = PlatformMemoryMapRing(capacity);
+  if (!block)
+    return 0;
+
+  ring->value = block;
+  ring->capacity = capacity;
+  return 1;
+}
+
+/*
+ * @return bytes in ring, in order they are written
+ */
+internalfn struct string
+RingBufferData(struct ring_buffer *ring)
+{
+  return StringFromBuffer(ring->value + ring->start, ring->length);
+}
+
+/*
+ * Bytes written here are added to ring by increasing its length.
+ * @return free space after bytes in ring, empty when ring is full
+ */
+internalfn struct string
+RingBufferSpace(struct ring_buffer *ring)
+{
+  return StringFromBuffer(ring->value + ring->start + ring->length, ring->capacity - ring->length);
+}
+
+/*
+ * Drops bytes from start of ring, nothing is moved.
+ */
+internalfn void
+RingBufferConsume(struct ring_buffer *ring, u64 length)
+{
+  debug_assert(length <= ring->length);
+  ring->start += length;
+  if (ring->start >= ring->capacity)
+    ring->start -= ring->capacity;
+  ring->length -= length;
+}
+
+internalfn void
+RingBufferRelease(struct ring_buffer *ring)
+{
+  if (ring->value)
+    PlatformMemoryUnmapRing(ring->value, ring->capacity);
+  *ring = (struct ring_buffer){};
+}
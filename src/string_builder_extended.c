@@ -108,10 +108,22 @@ StringBuilderAppendHttpParserError(string_builder *sb, enum http_parser_error er
           .code = HTTP_PARSER_ERROR_CONTENT_INVALID_LENGTH,
           .message = StringFromLiteral("Content is not matching with specified"),
       },
+      {
+          .code = HTTP_PARSER_ERROR_CONTENT_RANGE_INVALID,
+          .message = StringFromLiteral("Content range is invalid"),
+      },
+      {
+          .code = HTTP_PARSER_ERROR_CONTENT_RANGE_LENGTH_MISMATCH,
+          .message = StringFromLiteral("Content range is not matching with content length"),
+      },
       {
           .code = HTTP_PARSER_ERROR_PARTIAL,
           .message = StringFromLiteral("Partial http"),
       },
+      {
+          .code = HTTP_PARSER_ERROR_PAUSED,
+          .message = StringFromLiteral("Streaming paused, tokens are full"),
+      },
   };
 
   StringBuilderAppendStringLiteral(sb, "HttpParser: ");
@@ -126,6 +138,83 @@ StringBuilderAppendHttpParserError(string_builder *sb, enum http_parser_error er
   StringBuilderAppendString(sb, &message);
 }
 
+internalfn inline void
+StringBuilderAppendHttp2Error(string_builder *sb, enum http2_error errorCode)
+{
+  struct error {
+    enum http2_error code;
+    struct string message;
+  } errors[] = {
+      {
+          .code = HTTP2_ERROR_NONE,
+          .message = StringFromLiteral("No error"),
+      },
+      {
+          .code = HTTP2_ERROR_PROTOCOL,
+          .message = StringFromLiteral("Protocol error"),
+      },
+      {
+          .code = HTTP2_ERROR_INTERNAL,
+          .message = StringFromLiteral("Internal error"),
+      },
+      {
+          .code = HTTP2_ERROR_FLOW_CONTROL,
+          .message = StringFromLiteral("Flow control limits exceeded"),
+      },
+      {
+          .code = HTTP2_ERROR_SETTINGS_TIMEOUT,
+          .message = StringFromLiteral("Settings not acknowledged"),
+      },
+      {
+          .code = HTTP2_ERROR_STREAM_CLOSED,
+          .message = StringFromLiteral("Frame received for closed stream"),
+      },
+      {
+          .code = HTTP2_ERROR_FRAME_SIZE,
+          .message = StringFromLiteral("Frame size incorrect"),
+      },
+      {
+          .code = HTTP2_ERROR_REFUSED_STREAM,
+          .message = StringFromLiteral("Stream not processed"),
+      },
+      {
+          .code = HTTP2_ERROR_CANCEL,
+          .message = StringFromLiteral("Stream cancelled"),
+      },
+      {
+          .code = HTTP2_ERROR_COMPRESSION,
+          .message = StringFromLiteral("Compression state not updated"),
+      },
+      {
+          .code = HTTP2_ERROR_CONNECT,
+          .message = StringFromLiteral("TCP connection error for CONNECT method"),
+      },
+      {
+          .code = HTTP2_ERROR_ENHANCE_YOUR_CALM,
+          .message = StringFromLiteral("Processing capacity exceeded"),
+      },
+      {
+          .code = HTTP2_ERROR_INADEQUATE_SECURITY,
+          .message = StringFromLiteral("Negotiated TLS parameters not acceptable"),
+      },
+      {
+          .code = HTTP2_ERROR_HTTP_1_1_REQUIRED,
+          .message = StringFromLiteral("Use HTTP/1.1 for the request"),
+      },
+  };
+
+  StringBuilderAppendStringLiteral(sb, "Http2: ");
+  struct string message = StringFromLiteral("Unknown error");
+  for (u32 errorIndex = 0; errorIndex < ARRAY_COUNT(errors); errorIndex++) {
+    struct error *error = errors + errorIndex;
+    if (error->code == errorCode) {
+      message = error->message;
+      break;
+    }
+  }
+  StringBuilderAppendString(sb, &message);
+}
+
 internalfn inline void
 StringBuilderAppendMbedtlsError(string_builder *sb, int errnum)
 {
@@ -2513,3 +2602,15 @@ StringBuilderAppendWolfsslError(string_builder *sb, int errnum)
   StringBuilderAppendS32(sb, errnum);
   StringBuilderAppendStringLiteral(sb, ")");
 }
+
+internalfn inline void
+StringBuilderAppendTlsBackendError(string_builder *sb, int errnum)
+{
+#if IS_TLS_BACKEND_WOLFSSL
+  StringBuilderAppendStringLiteral(sb, "wolfSSL error: ");
+  StringBuilderAppendWolfsslError(sb, errnum);
+#else
+  StringBuilderAppendStringLiteral(sb, "Mbed TLS error: ");
+  StringBuilderAppendMbedtlsError(sb, errnum);
+#endif
+}
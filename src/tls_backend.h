@@ -0,0 +1,204 @@
+#pragma once
+
+/*
+ * TLS library behind connections
+ *
+ * Library is picked when program is built, see build.sh:
+ *
+ *   Mbed TLS  --with-mbedtls, tls_backend_mbedtls.c
+ *   wolfSSL   --with-wolfssl, tls_backend_wolfssl.c, IS_TLS_BACKEND_WOLFSSL
+ *
+ * Everything above it, connecting, requests and parsing responses, is same
+ * code for both. Backend never touches sockets, records go through
+ * TlsBackendIoSend() and TlsBackendIoReceive() that src/tls_connection.c
+ * implements on its transport buffers. They report would block instead of
+ * waiting and backend reports it back as TLS_BACKEND_WANT.
+ *
+ * @code
+ *   TlsBackendStartup(&memory)                         // see TlsBackendMemorySize()
+ *   TlsBackendConfigInit(&config, &options, &error)
+ *   TlsBackendInit(&backend, &config, io, &error)
+ *   TlsBackendSetHostname(&backend, "example.com", &error)
+ *   TlsBackendSessionImport(&backend, &session)        // resumes, optional
+ *   while (TlsBackendHandshake(&backend, &error) == TLS_BACKEND_WANT)
+ *     wait for transport
+ *   TlsBackendWrite(&backend, data, length, &bytesWritten, &error)
+ *   TlsBackendRead(&backend, buffer, length, &bytesRead, &error)
+ *   TlsBackendSessionExport(&backend, &buffer, &lifetime)  // after ticket
+ *   TlsBackendTrafficKeys(&backend, &send, &receive)   // kernel takes records
+ *   TlsBackendCloseNotify(&backend)
+ *   TlsBackendReset(&backend, &error)                  // connect again
+ *   TlsBackendFree(&backend)
+ * @endcode
+ *
+ * Errors are negative codes of library, see StringBuilderAppendTlsBackendError().
+ */
+
+#include "memory.h"
+#include "platform_network.h"
+#include "text.h"
+#include "type.h"
+
+#include "ca_store.c"
+
+#if !defined(IS_TLS_BACKEND_WOLFSSL)
+#define IS_TLS_BACKEND_WOLFSSL 0
+#endif
+
+enum tls_backend_result {
+  TLS_BACKEND_DONE,
+  // transport has to send or receive first, call again after it did
+  TLS_BACKEND_WANT,
+  // read: peer sent close_notify
+  TLS_BACKEND_CLOSED,
+  // read: server gave a TLS 1.3 session ticket, session can be exported
+  TLS_BACKEND_SESSION_TICKET,
+  // see error
+  TLS_BACKEND_FAILED,
+};
+
+enum tls_backend_io {
+  TLS_BACKEND_IO_WOULD_BLOCK = -1,
+  TLS_BACKEND_IO_RESET = -2,
+  TLS_BACKEND_IO_FAILED = -3,
+};
+
+struct tls_backend_options {
+  // server presents certificate, client checks certificate of server
+  b8 isServer;
+
+  // client: roots in PEM with zero termination, used when there is no store
+  struct string roots;
+  // client: roots indexed by subject, see src/ca_store.c
+  struct ca_store *caStore;
+
+  // server: its certificate and private key in PEM with zero termination
+  struct string certificate;
+  struct string key;
+
+  // in order of preference, zero terminated list, can be null
+  const char **alpnProtocols;
+};
+
+struct tls_backend_config;
+struct tls_backend;
+
+/*
+ * Moves records of connection between backend and transport, see
+ * src/tls_connection.c.
+ * @param io given to TlsBackendInit()
+ * @return bytes moved, 0 when peer closed connection, TLS_BACKEND_IO_* otherwise
+ */
+internalfn s64
+TlsBackendIoSend(void *io, const u8 *buffer, u64 length);
+
+internalfn s64
+TlsBackendIoReceive(void *io, u8 *buffer, u64 length);
+
+/*
+ * @param connectionMax connections open at once
+ * @return bytes library wants to allocate from, 0 when it allocates with C
+ *         library
+ */
+internalfn u64
+TlsBackendMemorySize(u32 connectionMax);
+
+/*
+ * Sets up library for whole process, once before anything else.
+ * @param memory see TlsBackendMemorySize(), null leaves allocating to C
+ *        library
+ * @return false on error
+ */
+internalfn b8
+TlsBackendStartup(memory_arena *memory);
+
+/*
+ * Config that every connection of one side shares. It must stay in place
+ * while connections use it.
+ * @return false on error, see error
+ */
+internalfn b8
+TlsBackendConfigInit(struct tls_backend_config *config, struct tls_backend_options *options, s32 *error);
+
+/*
+ * @param io given back to TlsBackendIoSend() and TlsBackendIoReceive()
+ * @return false on error, see error, there is nothing to free then
+ */
+internalfn b8
+TlsBackendInit(struct tls_backend *backend, struct tls_backend_config *config, void *io, s32 *error);
+
+/*
+ * Name that is sent with SNI and that certificate of server is checked for.
+ * @param hostname zero terminated
+ * @return false on error, see error
+ */
+internalfn b8
+TlsBackendSetHostname(struct tls_backend *backend, const char *hostname, s32 *error);
+
+internalfn enum tls_backend_result
+TlsBackendHandshake(struct tls_backend *backend, s32 *error);
+
+/*
+ * @param bytesRead set when TLS_BACKEND_DONE
+ */
+internalfn enum tls_backend_result
+TlsBackendRead(struct tls_backend *backend, u8 *buffer, u64 length, u64 *bytesRead, s32 *error);
+
+/*
+ * @param bytesWritten set when TLS_BACKEND_DONE, can be less than length
+ */
+internalfn enum tls_backend_result
+TlsBackendWrite(struct tls_backend *backend, u8 *data, u64 length, u64 *bytesWritten, s32 *error);
+
+/*
+ * Queues close_notify, best effort.
+ */
+internalfn void
+TlsBackendCloseNotify(struct tls_backend *backend);
+
+/*
+ * Forgets connection, backend can do handshake again.
+ * @return false on error, see error
+ */
+internalfn b8
+TlsBackendReset(struct tls_backend *backend, s32 *error);
+
+internalfn void
+TlsBackendFree(struct tls_backend *backend);
+
+/*
+ * @return protocol that server picked, null when it did not pick one
+ */
+internalfn struct string
+TlsBackendAlpnProtocol(struct tls_backend *backend);
+
+/*
+ * Serializes session, call after ticket is received.
+ * @param lifetime seconds that server keeps ticket valid
+ * @return session in buffer, null on error
+ */
+internalfn struct string
+TlsBackendSessionExport(struct tls_backend *backend, struct string *buffer, u64 *lifetime);
+
+/*
+ * Offers exported session on next handshake.
+ * @return false when library refused it, handshake is full then
+ */
+internalfn b8
+TlsBackendSessionImport(struct tls_backend *backend, struct string *session);
+
+/*
+ * Keys and sequence numbers of TLS 1.3 application traffic, so kernel can
+ * take records over, see PlatformSocketKernelTls(). Backend must not be used
+ * for that direction after.
+ * @return false when library does not give keys, cipher is not one kernel
+ *         knows, or records are buffered in library
+ */
+internalfn b8
+TlsBackendTrafficKeys(struct tls_backend *backend, struct platform_tls_key *send, struct platform_tls_key *receive);
+
+#if IS_TLS_BACKEND_WOLFSSL
+#include "tls_backend_wolfssl.c"
+#else
+#include "tls_backend_mbedtls.c"
+#endif
@@ -0,0 +1,563 @@
+#pragma once
+
+/*
+ * Mbed TLS behind tls_backend.h, see mbedtls/programs/ssl/ssl_client2.c
+ *
+ * Library allocates from one block that is sized for connections at startup,
+ * see TlsBackendMemorySize(). Roots in store are parsed when chain of server
+ * names them as issuer, see TlsBackendFindTrustedIssuers(). Traffic keys for
+ * kernel are expanded from secrets that library exports, see
+ * TlsBackendTrafficKeys().
+ */
+
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/debug.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/memory_buffer_alloc.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/pk.h>
+#include <mbedtls/platform.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/ssl_ticket.h>
+#include <mbedtls/x509_crt.h>
+#include <psa/crypto.h>
+
+#include "tls_backend.h"
+
+// prints every step of library, for troubleshooting handshake errors
+#if !defined(IS_TLS_BACKEND_DEBUG)
+#define IS_TLS_BACKEND_DEBUG 0
+#endif
+
+#if IS_TLS_BACKEND_DEBUG
+#include "platform.h"
+#include "print.h"
+#include "string_builder.h"
+#include "string_cursor.h"
+#endif
+
+struct tls_backend_config {
+  mbedtls_ssl_config ssl;
+  // roots for client, own certificate for server
+  mbedtls_x509_crt certificate;
+  mbedtls_pk_context key;
+#if defined(MBEDTLS_SSL_TICKET_C)
+  mbedtls_ssl_ticket_context ticket;
+#endif
+  mbedtls_ctr_drbg_context ctrDrbg;
+  mbedtls_entropy_context entropy;
+};
+
+struct tls_backend {
+  mbedtls_ssl_context ssl;
+#if defined(MBEDTLS_SSL_PROTO_TLS1_3)
+  // application traffic secrets of TLS 1.3, client and server, see
+  // TlsBackendExportKeys()
+  u8 trafficSecrets[2][MBEDTLS_MD_MAX_SIZE];
+  u8 trafficSecretLength;
+#endif
+};
+
+internalfn int
+TlsBackendSend(void *io, const unsigned char *buffer, size_t length)
+{
+  s64 result = TlsBackendIoSend(io, buffer, length);
+  if (result >= 0)
+    return (int)result;
+  if (result == TLS_BACKEND_IO_WOULD_BLOCK)
+    return MBEDTLS_ERR_SSL_WANT_WRITE;
+  return result == TLS_BACKEND_IO_RESET ? MBEDTLS_ERR_NET_CONN_RESET : MBEDTLS_ERR_NET_SEND_FAILED;
+}
+
+internalfn int
+TlsBackendReceive(void *io, unsigned char *buffer, size_t length)
+{
+  s64 result = TlsBackendIoReceive(io, buffer, length);
+  if (result >= 0)
+    return (int)result;
+  if (result == TLS_BACKEND_IO_WOULD_BLOCK)
+    return MBEDTLS_ERR_SSL_WANT_READ;
+  return result == TLS_BACKEND_IO_RESET ? MBEDTLS_ERR_NET_CONN_RESET : MBEDTLS_ERR_NET_RECV_FAILED;
+}
+
+#if IS_TLS_BACKEND_DEBUG
+internalfn void
+TlsBackendDebugCallback(void *data, int level, const char *file, int line, const char *str)
+{
+  string_builder *sb = data;
+
+  // see mbedtls-3.6.3/include/mbedtls/debug.h:144:33
+  string levelTexts[] = {
+      StringFromLiteral("[NDBG]"), // 0 No debug
+      StringFromLiteral("[ERR ]"), // 1 Error
+      StringFromLiteral("[CHG ]"), // 2 State change
+      StringFromLiteral("[INFO]"), // 3 Informational
+      StringFromLiteral("[VERB]"), // 4 Verbose
+  };
+  debug_assert(level >= 0 && level <= ARRAY_COUNT(levelTexts));
+
+  StringBuilderAppendString(sb, &levelTexts[level]);
+  StringBuilderAppendStringLiteral(sb, " ");
+  string relativeFile = StringFromZeroTerminated((u8 *)file, 1024);
+  {
+    string_cursor cursor = StringCursorFromString(&relativeFile);
+    StringCursorConsumeUntil(&cursor, &StringFromLiteral("mbedtls-3.6.3/"));
+    relativeFile = StringCursorExtractRemaining(&cursor);
+  }
+  StringBuilderAppendString(sb, &relativeFile);
+  StringBuilderAppendStringLiteral(sb, ":");
+  StringBuilderAppendS32(sb, line);
+  StringBuilderAppendStringLiteral(sb, ": ");
+  StringBuilderAppendZeroTerminated(sb, str, 1024);
+
+  string message = StringBuilderFlush(sb);
+  PrintString(&message);
+}
+
+#endif
+
+#if defined(MBEDTLS_SSL_PROTO_TLS1_3)
+/*
+ * Key export callback of Mbed TLS, keeps secrets of application traffic.
+ */
+internalfn void
+TlsBackendExportKeys(void *data, mbedtls_ssl_key_export_type type, const unsigned char *secret, size_t secretLength,
+                     const unsigned char clientRandom[32], const unsigned char serverRandom[32],
+                     mbedtls_tls_prf_types prfType)
+{
+  struct tls_backend *backend = data;
+  u32 secretIndex;
+  if (type == MBEDTLS_SSL_KEY_EXPORT_TLS1_3_CLIENT_APPLICATION_TRAFFIC_SECRET)
+    secretIndex = 0;
+  else if (type == MBEDTLS_SSL_KEY_EXPORT_TLS1_3_SERVER_APPLICATION_TRAFFIC_SECRET)
+    secretIndex = 1;
+  else
+    return;
+
+  if (secretLength > sizeof(backend->trafficSecrets[secretIndex]))
+    return;
+  MemoryCopy(backend->trafficSecrets[secretIndex], (u8 *)secret, secretLength);
+  backend->trafficSecretLength = (u8)secretLength;
+}
+
+/*
+ * HKDF-Expand-Label with empty context, see RFC 8446 7.1. Key Schedule.
+ * @return false on error
+ */
+internalfn b8
+TlsBackendExpandLabel(psa_algorithm_t hash, u8 *secret, u64 secretLength, struct string *label, u8 *output,
+                      u64 outputLength)
+{
+  struct string prefix = StringFromLiteral("tls13 ");
+  // length, label length, label, context length
+  u8 info[2 + 1 + 32 + 1];
+  debug_assert(prefix.length + label->length <= 32);
+  u64 infoLength = 0;
+  info[infoLength++] = (u8)(outputLength >> 8);
+  info[infoLength++] = (u8)outputLength;
+  info[infoLength++] = (u8)(prefix.length + label->length);
+  MemoryCopy(info + infoLength, prefix.value, prefix.length);
+  infoLength += prefix.length;
+  MemoryCopy(info + infoLength, label->value, label->length);
+  infoLength += label->length;
+  info[infoLength++] = 0;
+
+  psa_key_derivation_operation_t operation = PSA_KEY_DERIVATION_OPERATION_INIT;
+  b8 isExpanded =
+      psa_key_derivation_setup(&operation, PSA_ALG_HKDF_EXPAND(hash)) == PSA_SUCCESS &&
+      psa_key_derivation_input_bytes(&operation, PSA_KEY_DERIVATION_INPUT_SECRET, secret, secretLength) ==
+          PSA_SUCCESS &&
+      psa_key_derivation_input_bytes(&operation, PSA_KEY_DERIVATION_INPUT_INFO, info, infoLength) == PSA_SUCCESS &&
+      psa_key_derivation_output_bytes(&operation, output, outputLength) == PSA_SUCCESS;
+  psa_key_derivation_abort(&operation);
+  return isExpanded;
+}
+
+/*
+ * @param counter record sequence number of library, big-endian
+ */
+internalfn u64
+TlsBackendSequenceNumber(const unsigned char *counter)
+{
+  u64 sequenceNumber = 0;
+  for (u32 index = 0; index < 8; index++)
+    sequenceNumber = (sequenceNumber << 8) | counter[index];
+  return sequenceNumber;
+}
+#endif
+
+#if defined(MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK)
+/*
+ * Trusted CA callback of Mbed TLS, parses roots that issued certificate.
+ * @param candidates list that Mbed TLS frees, empty when none did
+ */
+internalfn int
+TlsBackendFindTrustedIssuers(void *data, mbedtls_x509_crt const *child, mbedtls_x509_crt **candidates)
+{
+  struct ca_store *store = data;
+  struct string issuer = StringFromBuffer(child->issuer_raw.p, child->issuer_raw.len);
+
+  *candidates = 0;
+  mbedtls_x509_crt *first = 0;
+  for (s32 index = CaStoreFind(store, &issuer); index != -1; index = CaStoreNext(store, index, &issuer)) {
+    if (!first) {
+      first = mbedtls_calloc(1, sizeof(*first));
+      if (!first)
+        return MBEDTLS_ERR_X509_ALLOC_FAILED;
+      mbedtls_x509_crt_init(first);
+    }
+
+    // store is mapped until exit, it does not have to be copied
+    struct string der = CaStoreCertificate(store, (u32)index);
+    mbedtls_x509_crt_parse_der_nocopy(first, der.value, der.length);
+  }
+
+  if (first && first->raw.p == 0) {
+    // none parsed
+    mbedtls_x509_crt_free(first);
+    mbedtls_free(first);
+    first = 0;
+  }
+
+  *candidates = first;
+  return 0;
+}
+#endif
+
+internalfn u64
+TlsBackendMemorySize(u32 connectionMax)
+{
+#if defined(MBEDTLS_MEMORY_BUFFER_ALLOC_C)
+  enum {
+    KILOBYTES = (1 << 10),
+  };
+  // CA certificates and first connection, then every other connection needs
+  // its own record buffers
+  return 544 * KILOBYTES + (u64)(connectionMax - 1) * 96 * KILOBYTES;
+#else
+  return 0;
+#endif
+}
+
+internalfn b8
+TlsBackendStartup(memory_arena *memory)
+{
+#if defined(MBEDTLS_MEMORY_BUFFER_ALLOC_C)
+  if (memory)
+    mbedtls_memory_buffer_alloc_init(memory->block, memory->total);
+#endif
+  return 1;
+}
+
+internalfn b8
+TlsBackendConfigInit(struct tls_backend_config *config, struct tls_backend_options *options, s32 *error)
+{
+  mbedtls_ssl_config_init(&config->ssl);
+  mbedtls_x509_crt_init(&config->certificate);
+  mbedtls_pk_init(&config->key);
+#if defined(MBEDTLS_SSL_TICKET_C)
+  mbedtls_ssl_ticket_init(&config->ticket);
+#endif
+  mbedtls_ctr_drbg_init(&config->ctrDrbg);
+  mbedtls_entropy_init(&config->entropy);
+
+  *error = mbedtls_ctr_drbg_seed(&config->ctrDrbg, mbedtls_entropy_func, &config->entropy, 0, 0);
+  if (*error)
+    return 0;
+
+  *error = mbedtls_ssl_config_defaults(&config->ssl, options->isServer ? MBEDTLS_SSL_IS_SERVER : MBEDTLS_SSL_IS_CLIENT,
+                                       MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT);
+  if (*error)
+    return 0;
+
+#if IS_TLS_BACKEND_DEBUG
+  memory_arena debugMemory = PlatformMemoryAllocate(64 * 1024);
+  mbedtls_ssl_conf_dbg(&config->ssl, TlsBackendDebugCallback, MakeStringBuilder(&debugMemory, 2048, 32));
+  mbedtls_debug_set_threshold(4);
+#endif
+
+  mbedtls_ssl_conf_min_version(&config->ssl, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_4);
+  mbedtls_ssl_conf_max_version(&config->ssl, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_4);
+  mbedtls_ssl_conf_rng(&config->ssl, mbedtls_ctr_drbg_random, &config->ctrDrbg);
+
+  if (options->isServer) {
+    *error = mbedtls_x509_crt_parse(&config->certificate, options->certificate.value, options->certificate.length);
+    if (*error)
+      return 0;
+    *error = mbedtls_pk_parse_key(&config->key, options->key.value, options->key.length, 0, 0, mbedtls_ctr_drbg_random,
+                                  &config->ctrDrbg);
+    if (*error)
+      return 0;
+    *error = mbedtls_ssl_conf_own_cert(&config->ssl, &config->certificate, &config->key);
+    if (*error)
+      return 0;
+
+#if defined(MBEDTLS_SSL_TICKET_C)
+    // tickets are valid for a day
+    *error = mbedtls_ssl_ticket_setup(&config->ticket, mbedtls_ctr_drbg_random, &config->ctrDrbg,
+                                      MBEDTLS_CIPHER_AES_256_GCM, 24 * 60 * 60);
+    if (*error)
+      return 0;
+    mbedtls_ssl_conf_session_tickets_cb(&config->ssl, mbedtls_ssl_ticket_write, mbedtls_ssl_ticket_parse,
+                                        &config->ticket);
+#endif
+  } else {
+    mbedtls_ssl_conf_authmode(&config->ssl, MBEDTLS_SSL_VERIFY_REQUIRED);
+    b8 isCaCallbackUsed = 0;
+#if defined(MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK)
+    if (options->caStore) {
+      mbedtls_ssl_conf_ca_cb(&config->ssl, TlsBackendFindTrustedIssuers, options->caStore);
+      isCaCallbackUsed = 1;
+    }
+#endif
+    if (!isCaCallbackUsed) {
+      if (options->caStore) {
+        // store is mapped until exit, it does not have to be copied
+        for (u32 index = 0; index < options->caStore->certificateCount; index++) {
+          struct string der = CaStoreCertificate(options->caStore, index);
+          mbedtls_x509_crt_parse_der_nocopy(&config->certificate, der.value, der.length);
+        }
+      } else {
+        // some of bundle may not parse, positive is how many did not
+        *error = mbedtls_x509_crt_parse(&config->certificate, options->roots.value, options->roots.length);
+        if (*error < 0)
+          return 0;
+        *error = 0;
+      }
+      mbedtls_ssl_conf_ca_chain(&config->ssl, &config->certificate, 0);
+    }
+
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && defined(MBEDTLS_SSL_CLI_C) && defined(MBEDTLS_SSL_PROTO_TLS1_3)
+    // tickets are reported by mbedtls_ssl_read(), so sessions can be stored
+    mbedtls_ssl_conf_session_tickets(&config->ssl, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+    mbedtls_ssl_conf_tls13_enable_signal_new_session_tickets(&config->ssl,
+                                                             MBEDTLS_SSL_TLS1_3_SIGNAL_NEW_SESSION_TICKETS_ENABLED);
+#endif
+  }
+
+  if (options->alpnProtocols) {
+    *error = mbedtls_ssl_conf_alpn_protocols(&config->ssl, options->alpnProtocols);
+    if (*error)
+      return 0;
+  }
+
+  return 1;
+}
+
+internalfn b8
+TlsBackendInit(struct tls_backend *backend, struct tls_backend_config *config, void *io, s32 *error)
+{
+  mbedtls_ssl_init(&backend->ssl);
+  *error = mbedtls_ssl_setup(&backend->ssl, &config->ssl);
+  if (*error) {
+    mbedtls_ssl_free(&backend->ssl);
+    return 0;
+  }
+
+  mbedtls_ssl_set_bio(&backend->ssl, io, TlsBackendSend, TlsBackendReceive, 0);
+#if defined(MBEDTLS_SSL_PROTO_TLS1_3)
+  backend->trafficSecretLength = 0;
+  mbedtls_ssl_set_export_keys_cb(&backend->ssl, TlsBackendExportKeys, backend);
+#endif
+  return 1;
+}
+
+internalfn b8
+TlsBackendSetHostname(struct tls_backend *backend, const char *hostname, s32 *error)
+{
+  *error = mbedtls_ssl_set_hostname(&backend->ssl, hostname);
+  return *error == 0;
+}
+
+internalfn enum tls_backend_result
+TlsBackendHandshake(struct tls_backend *backend, s32 *error)
+{
+  while (1) {
+    int mbedtlsError = mbedtls_ssl_handshake(&backend->ssl);
+    if (mbedtlsError == 0)
+      return TLS_BACKEND_DONE;
+    else if (mbedtlsError == MBEDTLS_ERR_SSL_WANT_READ || mbedtlsError == MBEDTLS_ERR_SSL_WANT_WRITE)
+      return TLS_BACKEND_WANT;
+    else if (mbedtlsError == MBEDTLS_ERR_SSL_CRYPTO_IN_PROGRESS)
+      continue;
+
+    *error = mbedtlsError;
+    return TLS_BACKEND_FAILED;
+  }
+}
+
+internalfn enum tls_backend_result
+TlsBackendRead(struct tls_backend *backend, u8 *buffer, u64 length, u64 *bytesRead, s32 *error)
+{
+  while (1) {
+    int ret = mbedtls_ssl_read(&backend->ssl, buffer, length);
+    if (ret >= 0) {
+      *bytesRead = (u64)ret;
+      return TLS_BACKEND_DONE;
+    }
+
+    int mbedtlsError = ret;
+    if (mbedtlsError == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY)
+      return TLS_BACKEND_CLOSED;
+    else if (mbedtlsError == MBEDTLS_ERR_SSL_CRYPTO_IN_PROGRESS)
+      continue;
+#if defined(MBEDTLS_ERR_SSL_RECEIVED_NEW_SESSION_TICKET)
+    else if (mbedtlsError == MBEDTLS_ERR_SSL_RECEIVED_NEW_SESSION_TICKET)
+      return TLS_BACKEND_SESSION_TICKET;
+#endif
+    else if (mbedtlsError == MBEDTLS_ERR_SSL_WANT_READ || mbedtlsError == MBEDTLS_ERR_SSL_WANT_WRITE)
+      return TLS_BACKEND_WANT;
+
+    *error = mbedtlsError;
+    return TLS_BACKEND_FAILED;
+  }
+}
+
+internalfn enum tls_backend_result
+TlsBackendWrite(struct tls_backend *backend, u8 *data, u64 length, u64 *bytesWritten, s32 *error)
+{
+  while (1) {
+    int ret = mbedtls_ssl_write(&backend->ssl, data, length);
+    if (ret >= 0) {
+      *bytesWritten = (u64)ret;
+      return TLS_BACKEND_DONE;
+    }
+
+    int mbedtlsError = ret;
+    if (mbedtlsError == MBEDTLS_ERR_SSL_CRYPTO_IN_PROGRESS)
+      continue;
+    else if (mbedtlsError == MBEDTLS_ERR_SSL_WANT_WRITE || mbedtlsError == MBEDTLS_ERR_SSL_WANT_READ)
+      return TLS_BACKEND_WANT;
+
+    *error = mbedtlsError;
+    return TLS_BACKEND_FAILED;
+  }
+}
+
+internalfn void
+TlsBackendCloseNotify(struct tls_backend *backend)
+{
+  mbedtls_ssl_close_notify(&backend->ssl);
+}
+
+internalfn b8
+TlsBackendReset(struct tls_backend *backend, s32 *error)
+{
+  *error = mbedtls_ssl_session_reset(&backend->ssl);
+#if defined(MBEDTLS_SSL_PROTO_TLS1_3)
+  MemoryClear(backend->trafficSecrets, sizeof(backend->trafficSecrets));
+  backend->trafficSecretLength = 0;
+#endif
+  return *error == 0;
+}
+
+internalfn void
+TlsBackendFree(struct tls_backend *backend)
+{
+  mbedtls_ssl_free(&backend->ssl);
+}
+
+internalfn struct string
+TlsBackendAlpnProtocol(struct tls_backend *backend)
+{
+  const char *protocol = mbedtls_ssl_get_alpn_protocol(&backend->ssl);
+  if (!protocol)
+    return StringNull();
+  return StringFromZeroTerminated((u8 *)protocol, 255);
+}
+
+internalfn struct string
+TlsBackendSessionExport(struct tls_backend *backend, struct string *buffer, u64 *lifetime)
+{
+  mbedtls_ssl_session session;
+  mbedtls_ssl_session_init(&session);
+  if (mbedtls_ssl_get_session(&backend->ssl, &session)) {
+    mbedtls_ssl_session_free(&session);
+    return StringNull();
+  }
+
+  *lifetime = (u64)-1;
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && defined(MBEDTLS_SSL_CLI_C)
+  // there is no getter, lifetime server gave with ticket
+  *lifetime = session.MBEDTLS_PRIVATE(ticket_lifetime);
+#endif
+
+  size_t sessionLength;
+  int mbedtlsError = mbedtls_ssl_session_save(&session, buffer->value, buffer->length, &sessionLength);
+  mbedtls_ssl_session_free(&session);
+  if (mbedtlsError)
+    return StringNull();
+  return StringFromBuffer(buffer->value, sessionLength);
+}
+
+internalfn b8
+TlsBackendSessionImport(struct tls_backend *backend, struct string *session)
+{
+  mbedtls_ssl_session loaded;
+  mbedtls_ssl_session_init(&loaded);
+  // session that is saved by other Mbed TLS version or config is refused
+  b8 isImported = mbedtls_ssl_session_load(&loaded, session->value, session->length) == 0 &&
+                  mbedtls_ssl_set_session(&backend->ssl, &loaded) == 0;
+  mbedtls_ssl_session_free(&loaded);
+  return isImported;
+}
+
+internalfn b8
+TlsBackendTrafficKeys(struct tls_backend *backend, struct platform_tls_key *send, struct platform_tls_key *receive)
+{
+#if defined(MBEDTLS_SSL_PROTO_TLS1_3)
+  mbedtls_ssl_context *ssl = &backend->ssl;
+  if (!mbedtls_ssl_is_handshake_over(ssl) || backend->trafficSecretLength == 0)
+    return 0;
+  // record that library read or wrote only partly would be lost
+  if (mbedtls_ssl_check_pending(ssl) || mbedtls_ssl_get_bytes_avail(ssl) || ssl->MBEDTLS_PRIVATE(out_left) != 0)
+    return 0;
+
+  // see RFC 8446 B.4. Cipher Suites
+  enum platform_tls_cipher cipher;
+  psa_algorithm_t hash;
+  u64 keyLength;
+  switch (mbedtls_ssl_get_ciphersuite_id_from_ssl(ssl)) {
+  case 0x1301: {
+    cipher = PLATFORM_TLS_CIPHER_AES_128_GCM;
+    hash = PSA_ALG_SHA_256;
+    keyLength = 16;
+  } break;
+  case 0x1302: {
+    cipher = PLATFORM_TLS_CIPHER_AES_256_GCM;
+    hash = PSA_ALG_SHA_384;
+    keyLength = 32;
+  } break;
+  case 0x1303: {
+    cipher = PLATFORM_TLS_CIPHER_CHACHA20_POLY1305;
+    hash = PSA_ALG_SHA_256;
+    keyLength = 32;
+  } break;
+  default:
+    return 0;
+  }
+
+  // each side sends with its own secret
+  b8 isServer = mbedtls_ssl_conf_get_endpoint(mbedtls_ssl_context_get_config(ssl)) == MBEDTLS_SSL_IS_SERVER;
+  struct platform_tls_key *keys[2] = {isServer ? receive : send, isServer ? send : receive};
+  for (u32 keyIndex = 0; keyIndex < ARRAY_COUNT(keys); keyIndex++) {
+    struct platform_tls_key *key = keys[keyIndex];
+    *key = (struct platform_tls_key){.cipher = cipher};
+    u8 *secret = backend->trafficSecrets[keyIndex];
+    if (!TlsBackendExpandLabel(hash, secret, backend->trafficSecretLength, &StringFromLiteral("key"), key->key,
+                               keyLength) ||
+        !TlsBackendExpandLabel(hash, secret, backend->trafficSecretLength, &StringFromLiteral("iv"), key->iv,
+                               sizeof(key->iv))) {
+      MemoryClear(send, sizeof(*send));
+      MemoryClear(receive, sizeof(*receive));
+      return 0;
+    }
+  }
+
+  send->sequenceNumber = TlsBackendSequenceNumber(ssl->MBEDTLS_PRIVATE(cur_out_ctr));
+  receive->sequenceNumber = TlsBackendSequenceNumber(ssl->MBEDTLS_PRIVATE(in_ctr));
+  return 1;
+#else
+  return 0;
+#endif
+}
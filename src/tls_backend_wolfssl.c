@@ -0,0 +1,326 @@
+#pragma once
+
+/*
+ * wolfSSL behind tls_backend.h
+ *
+ * Needs wolfSSL configured with ALPN, SNI, session tickets and OpenSSL extra
+ * for exporting sessions, see 3rdparty/wolfssl/build.sh. Library allocates
+ * with malloc. There is no callback that asks for issuer of certificate, so
+ * every root in store is loaded up front, from DER without decoding PEM.
+ * Traffic keys are not exported, so kernel never takes records over.
+ */
+
+#include <wolfssl/options.h>
+#include <wolfssl/ssl.h>
+#include <wolfssl/wolfcrypt/error-crypt.h>
+
+#include "tls_backend.h"
+
+struct tls_backend_config {
+  WOLFSSL_CTX *ctx;
+  // protocols separated by comma, see wolfSSL_UseALPN()
+  char alpnProtocols[64];
+  u32 alpnProtocolsLength;
+};
+
+struct tls_backend {
+  WOLFSSL *ssl;
+  struct tls_backend_config *config;
+  void *io;
+  // set by TlsBackendSessionTicketCallback(), reported by next read
+  b8 isSessionTicketReceived;
+};
+
+internalfn int
+TlsBackendSend(WOLFSSL *ssl, char *buffer, int length, void *io)
+{
+  s64 result = TlsBackendIoSend(io, (u8 *)buffer, (u64)length);
+  if (result >= 0)
+    return (int)result;
+  if (result == TLS_BACKEND_IO_WOULD_BLOCK)
+    return WOLFSSL_CBIO_ERR_WANT_WRITE;
+  return result == TLS_BACKEND_IO_RESET ? WOLFSSL_CBIO_ERR_CONN_RST : WOLFSSL_CBIO_ERR_GENERAL;
+}
+
+internalfn int
+TlsBackendReceive(WOLFSSL *ssl, char *buffer, int length, void *io)
+{
+  s64 result = TlsBackendIoReceive(io, (u8 *)buffer, (u64)length);
+  if (result > 0)
+    return (int)result;
+  if (result == 0)
+    return WOLFSSL_CBIO_ERR_CONN_CLOSE;
+  if (result == TLS_BACKEND_IO_WOULD_BLOCK)
+    return WOLFSSL_CBIO_ERR_WANT_READ;
+  return result == TLS_BACKEND_IO_RESET ? WOLFSSL_CBIO_ERR_CONN_RST : WOLFSSL_CBIO_ERR_GENERAL;
+}
+
+internalfn int
+TlsBackendSessionTicketCallback(WOLFSSL *ssl, const unsigned char *ticket, int ticketLength, void *data)
+{
+  struct tls_backend *backend = data;
+  backend->isSessionTicketReceived = 1;
+  return 0;
+}
+
+/*
+ * @return false on error, see error
+ */
+internalfn b8
+TlsBackendNew(struct tls_backend *backend, s32 *error)
+{
+  struct tls_backend_config *config = backend->config;
+  backend->ssl = wolfSSL_new(config->ctx);
+  if (!backend->ssl) {
+    *error = MEMORY_E;
+    return 0;
+  }
+
+  wolfSSL_SetIOReadCtx(backend->ssl, backend->io);
+  wolfSSL_SetIOWriteCtx(backend->ssl, backend->io);
+  wolfSSL_set_SessionTicket_cb(backend->ssl, TlsBackendSessionTicketCallback, backend);
+  backend->isSessionTicketReceived = 0;
+
+  if (config->alpnProtocolsLength != 0) {
+    int wolfsslError = wolfSSL_UseALPN(backend->ssl, config->alpnProtocols, config->alpnProtocolsLength,
+                                       WOLFSSL_ALPN_CONTINUE_ON_MISMATCH);
+    if (wolfsslError != WOLFSSL_SUCCESS) {
+      wolfSSL_free(backend->ssl);
+      backend->ssl = 0;
+      *error = wolfsslError;
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+/*
+ * @param ret what call returned
+ */
+internalfn enum tls_backend_result
+TlsBackendResult(struct tls_backend *backend, int ret, s32 *error)
+{
+  int wolfsslError = wolfSSL_get_error(backend->ssl, ret);
+  if (wolfsslError == WOLFSSL_ERROR_WANT_READ || wolfsslError == WOLFSSL_ERROR_WANT_WRITE)
+    return TLS_BACKEND_WANT;
+  if (wolfsslError == WOLFSSL_ERROR_ZERO_RETURN)
+    return TLS_BACKEND_CLOSED;
+
+  *error = wolfsslError;
+  return TLS_BACKEND_FAILED;
+}
+
+internalfn u64
+TlsBackendMemorySize(u32 connectionMax)
+{
+  return 0;
+}
+
+internalfn b8
+TlsBackendStartup(memory_arena *memory)
+{
+  return wolfSSL_Init() == WOLFSSL_SUCCESS;
+}
+
+internalfn b8
+TlsBackendConfigInit(struct tls_backend_config *config, struct tls_backend_options *options, s32 *error)
+{
+  *config = (struct tls_backend_config){};
+  config->ctx = wolfSSL_CTX_new(options->isServer ? wolfTLSv1_3_server_method() : wolfTLSv1_3_client_method());
+  if (!config->ctx) {
+    *error = MEMORY_E;
+    return 0;
+  }
+
+  wolfSSL_CTX_SetIORecv(config->ctx, TlsBackendReceive);
+  wolfSSL_CTX_SetIOSend(config->ctx, TlsBackendSend);
+
+  // PEM is given with zero termination
+  int wolfsslError;
+  if (options->isServer) {
+    wolfsslError = wolfSSL_CTX_use_certificate_buffer(config->ctx, options->certificate.value,
+                                                      (long)options->certificate.length - 1, WOLFSSL_FILETYPE_PEM);
+    if (wolfsslError != WOLFSSL_SUCCESS) {
+      *error = wolfsslError;
+      return 0;
+    }
+    wolfsslError = wolfSSL_CTX_use_PrivateKey_buffer(config->ctx, options->key.value, (long)options->key.length - 1,
+                                                     WOLFSSL_FILETYPE_PEM);
+    if (wolfsslError != WOLFSSL_SUCCESS) {
+      *error = wolfsslError;
+      return 0;
+    }
+  } else {
+    wolfSSL_CTX_set_verify(config->ctx, WOLFSSL_VERIFY_PEER | WOLFSSL_VERIFY_FAIL_IF_NO_PEER_CERT, 0);
+    if (options->caStore) {
+      // roots that do not load are skipped, as in bundle
+      struct ca_store *store = options->caStore;
+      for (u32 index = 0; index < store->certificateCount; index++) {
+        struct string der = CaStoreCertificate(store, index);
+        wolfSSL_CTX_load_verify_buffer(config->ctx, der.value, (long)der.length, WOLFSSL_FILETYPE_ASN1);
+      }
+    } else {
+      wolfsslError = wolfSSL_CTX_load_verify_buffer(config->ctx, options->roots.value, (long)options->roots.length - 1,
+                                                    WOLFSSL_FILETYPE_PEM);
+      if (wolfsslError != WOLFSSL_SUCCESS) {
+        *error = wolfsslError;
+        return 0;
+      }
+    }
+  }
+
+  if (options->alpnProtocols) {
+    for (const char **protocol = options->alpnProtocols; *protocol; protocol++) {
+      struct string name = StringFromZeroTerminated((u8 *)*protocol, 255);
+      if (config->alpnProtocolsLength + 1 + name.length > sizeof(config->alpnProtocols)) {
+        *error = BUFFER_E;
+        return 0;
+      }
+      if (config->alpnProtocolsLength != 0)
+        config->alpnProtocols[config->alpnProtocolsLength++] = ',';
+      MemoryCopy(config->alpnProtocols + config->alpnProtocolsLength, name.value, name.length);
+      config->alpnProtocolsLength += (u32)name.length;
+    }
+  }
+
+  return 1;
+}
+
+internalfn b8
+TlsBackendInit(struct tls_backend *backend, struct tls_backend_config *config, void *io, s32 *error)
+{
+  *backend = (struct tls_backend){
+      .config = config,
+      .io = io,
+  };
+  return TlsBackendNew(backend, error);
+}
+
+internalfn b8
+TlsBackendSetHostname(struct tls_backend *backend, const char *hostname, s32 *error)
+{
+  struct string name = StringFromZeroTerminated((u8 *)hostname, 255);
+  int wolfsslError = wolfSSL_UseSNI(backend->ssl, WOLFSSL_SNI_HOST_NAME, name.value, (u16)name.length);
+  if (wolfsslError == WOLFSSL_SUCCESS)
+    wolfsslError = wolfSSL_check_domain_name(backend->ssl, hostname);
+  if (wolfsslError != WOLFSSL_SUCCESS) {
+    *error = wolfsslError;
+    return 0;
+  }
+  return 1;
+}
+
+internalfn enum tls_backend_result
+TlsBackendHandshake(struct tls_backend *backend, s32 *error)
+{
+  int ret = wolfSSL_is_server(backend->ssl) ? wolfSSL_accept(backend->ssl) : wolfSSL_connect(backend->ssl);
+  if (ret == WOLFSSL_SUCCESS)
+    return TLS_BACKEND_DONE;
+  return TlsBackendResult(backend, ret, error);
+}
+
+internalfn enum tls_backend_result
+TlsBackendRead(struct tls_backend *backend, u8 *buffer, u64 length, u64 *bytesRead, s32 *error)
+{
+  if (backend->isSessionTicketReceived) {
+    backend->isSessionTicketReceived = 0;
+    return TLS_BACKEND_SESSION_TICKET;
+  }
+
+  int ret = wolfSSL_read(backend->ssl, buffer, length > S32_MAX ? S32_MAX : (int)length);
+  if (ret > 0) {
+    *bytesRead = (u64)ret;
+    return TLS_BACKEND_DONE;
+  }
+
+  enum tls_backend_result result = TlsBackendResult(backend, ret, error);
+  // ticket is processed by read that then wants more
+  if (result == TLS_BACKEND_WANT && backend->isSessionTicketReceived) {
+    backend->isSessionTicketReceived = 0;
+    return TLS_BACKEND_SESSION_TICKET;
+  }
+  return result;
+}
+
+internalfn enum tls_backend_result
+TlsBackendWrite(struct tls_backend *backend, u8 *data, u64 length, u64 *bytesWritten, s32 *error)
+{
+  // when it wants transport, same data must be given again
+  int ret = wolfSSL_write(backend->ssl, data, length > S32_MAX ? S32_MAX : (int)length);
+  if (ret > 0) {
+    *bytesWritten = (u64)ret;
+    return TLS_BACKEND_DONE;
+  }
+  return TlsBackendResult(backend, ret, error);
+}
+
+internalfn void
+TlsBackendCloseNotify(struct tls_backend *backend)
+{
+  wolfSSL_shutdown(backend->ssl);
+}
+
+internalfn b8
+TlsBackendReset(struct tls_backend *backend, s32 *error)
+{
+  wolfSSL_free(backend->ssl);
+  return TlsBackendNew(backend, error);
+}
+
+internalfn void
+TlsBackendFree(struct tls_backend *backend)
+{
+  wolfSSL_free(backend->ssl);
+  backend->ssl = 0;
+}
+
+internalfn struct string
+TlsBackendAlpnProtocol(struct tls_backend *backend)
+{
+  char *protocol;
+  u16 protocolLength;
+  if (wolfSSL_ALPN_GetProtocol(backend->ssl, &protocol, &protocolLength) != WOLFSSL_SUCCESS)
+    return StringNull();
+  return StringFromBuffer((u8 *)protocol, protocolLength);
+}
+
+internalfn struct string
+TlsBackendSessionExport(struct tls_backend *backend, struct string *buffer, u64 *lifetime)
+{
+  WOLFSSL_SESSION *session = wolfSSL_get1_session(backend->ssl);
+  if (!session)
+    return StringNull();
+
+  struct string exported = StringNull();
+  int sessionLength = wolfSSL_i2d_SSL_SESSION(session, 0);
+  if (sessionLength > 0 && (u64)sessionLength <= buffer->length) {
+    u8 *cursor = buffer->value;
+    if (wolfSSL_i2d_SSL_SESSION(session, &cursor) == sessionLength)
+      exported = StringFromBuffer(buffer->value, (u64)sessionLength);
+  }
+  // lifetime server gave with ticket
+  *lifetime = (u64)wolfSSL_SESSION_get_timeout(session);
+  wolfSSL_SESSION_free(session);
+  return exported;
+}
+
+internalfn b8
+TlsBackendSessionImport(struct tls_backend *backend, struct string *session)
+{
+  const u8 *cursor = session->value;
+  WOLFSSL_SESSION *loaded = wolfSSL_d2i_SSL_SESSION(0, &cursor, (long)session->length);
+  if (!loaded)
+    return 0;
+  b8 isImported = wolfSSL_set_session(backend->ssl, loaded) == WOLFSSL_SUCCESS;
+  wolfSSL_SESSION_free(loaded);
+  return isImported;
+}
+
+internalfn b8
+TlsBackendTrafficKeys(struct tls_backend *backend, struct platform_tls_key *send, struct platform_tls_key *receive)
+{
+  // keys of TLS 1.3 are not exported by build that 3rdparty/wolfssl/build.sh
+  // configures, records stay in library
+  return 0;
+}
@@ -0,0 +1,707 @@
+#pragma once
+
+/*
+ * TLS connection driven by transport completions
+ *
+ * Connecting, handshake, reads and writes never block. TLS library, see
+ * tls_backend.h, is given socket functions that read from bytes transport
+ * already received and write into send buffer, they report that they would
+ * block instead of waiting.
+ * Send buffer is handed to transport after every call, caller gives every
+ * completion of connection back and calls again.
+ *
+ *   CLOSED --> CONNECTING --> HANDSHAKING --> OPEN
+ *                  |               |            |
+ *                  '---------------'------------'--> FAILED
+ *
+ * Host with many addresses is connected to with Happy Eyeballs, RFC 8305.
+ * Attempts to its addresses start one after another, next one when previous
+ * fails or does not connect in 250 ms, and the first that connects is used.
+ * So dead address costs 250 ms instead of SYN timeout of kernel.
+ *
+ * Open connection can hand its records to kernel, Linux kTLS, see
+ * TlsConnectionKernelTls(). Reads and writes then only copy plaintext between
+ * caller and transport buffers, TLS library is skipped.
+ *
+ * Plain connection, isPlain set before connecting, skips TLS altogether. It is
+ * open as soon as TCP connection is established and bytes go as they are, for
+ * http:// servers, e.g. local one benchmarks run against.
+ *
+ * @code
+ *   TlsConnectionInit(&connection, &tlsConfig, &transport, &connection)
+ *   TlsConnectionConnectAny(&connection, addresses, addressCount, 0, &hostname, NowInNanoseconds())
+ *   while (...) {
+ *     PlatformTransportWait(&transport, completions, ..., TlsConnectionAttemptTimeout(&connection, now))
+ *     connection = completion.data
+ *     TlsConnectionComplete(connection, &completion)
+ *     TlsConnectionAttempt(connection, NowInNanoseconds())
+ *     if (connection->state != TLS_CONNECTION_STATE_OPEN)
+ *       TlsConnectionHandshake(connection)
+ *     else
+ *       TlsConnectionWrite(connection, &request) or TlsConnectionRead(connection, ...)
+ *   }
+ * @endcode
+ */
+
+#include "platform_transport.h"
+#include "tls_backend.h"
+#include "type.h"
+
+enum tls_connection_state {
+  TLS_CONNECTION_STATE_CLOSED,
+  // waiting TCP connection to be established
+  TLS_CONNECTION_STATE_CONNECTING,
+  TLS_CONNECTION_STATE_HANDSHAKING,
+  // application data can be read and written
+  TLS_CONNECTION_STATE_OPEN,
+  // see error
+  TLS_CONNECTION_STATE_FAILED,
+};
+
+enum {
+  // receive completions that TLS library did not read yet
+  TLS_CONNECTION_RECEIVED_MAX = 16,
+  // connection attempts in flight at once
+  TLS_CONNECTION_ATTEMPT_MAX = 4,
+};
+
+// see RFC 8305 5. Connection Attempt Delay, recommended value
+comptime u64 TLS_CONNECTION_ATTEMPT_DELAY = 250 * 1000000ULL /* 1e6 */;
+
+struct tls_connection_received {
+  u8 *buffer;
+  u16 bufferId;
+  u32 offset;
+  u32 length;
+};
+
+struct tls_connection {
+  enum tls_connection_state state;
+  // negative is TLS library error, see tls_backend.h, positive is errno
+  s32 error;
+
+  struct platform_transport *transport;
+  // socket.data is given back in completions
+  struct platform_socket socket;
+
+  // Happy Eyeballs, see TlsConnectionConnectAny()
+  struct platform_address *addresses;
+  u32 addressCount;
+  // tried first, others follow in order
+  u32 addressFirst;
+  // number of addresses tried
+  u32 addressNext;
+  // in nanoseconds, when next attempt starts, 0 right away
+  u64 attemptAt;
+  // sockets connecting, socket of winner is moved to socket
+  struct platform_socket attempts[TLS_CONNECTION_ATTEMPT_MAX];
+  // attempts are used instead of socket while connecting
+  b8 isRacing;
+
+  struct tls_connection_received received[TLS_CONNECTION_RECEIVED_MAX];
+  u32 receivedHead;
+  u32 receivedCount;
+  // receive ended, 0 when peer closed connection, otherwise negative errno
+  b8 isReceiveEnded;
+  s32 receiveResult;
+
+  // while one is sent, other is filled
+  u8 *sendBuffers[2];
+  u32 sendLengths[2];
+  u32 sendFillIndex;
+  b8 isSending;
+  // negative errno
+  s32 sendResult;
+
+  // server gave a TLS 1.3 session ticket, session can be stored for resuming
+  // it, see TlsSessionCacheStore()
+  b8 isSessionTicketReceived;
+
+  // kernel decrypts and encrypts records, see TlsConnectionKernelTls()
+  b8 isKernelTlsReceive;
+  b8 isKernelTlsSend;
+  // no TLS, set by caller and kept when connection is closed
+  b8 isPlain;
+
+  struct tls_backend backend;
+};
+
+comptime s64 TLS_CONNECTION_WOULD_BLOCK = -2;
+
+internalfn s64
+TlsBackendIoSend(void *io, const u8 *buffer, u64 length)
+{
+  struct tls_connection *connection = io;
+  if (connection->sendResult < 0)
+    return connection->sendResult == -ECONNRESET || connection->sendResult == -EPIPE ? TLS_BACKEND_IO_RESET
+                                                                                     : TLS_BACKEND_IO_FAILED;
+
+  u32 fillIndex = connection->sendFillIndex;
+  u32 capacity = connection->transport->sendBufferLength - connection->sendLengths[fillIndex];
+  if (capacity == 0)
+    return TLS_BACKEND_IO_WOULD_BLOCK;
+
+  u32 bytesWritten = length < capacity ? (u32)length : capacity;
+  MemoryCopy(connection->sendBuffers[fillIndex] + connection->sendLengths[fillIndex], (u8 *)buffer, bytesWritten);
+  connection->sendLengths[fillIndex] += bytesWritten;
+  return bytesWritten;
+}
+
+internalfn s64
+TlsBackendIoReceive(void *io, u8 *buffer, u64 length)
+{
+  struct tls_connection *connection = io;
+  if (connection->receivedCount == 0) {
+    if (!connection->isReceiveEnded)
+      return TLS_BACKEND_IO_WOULD_BLOCK;
+    if (connection->receiveResult == 0)
+      return 0;
+    return connection->receiveResult == -ECONNRESET ? TLS_BACKEND_IO_RESET : TLS_BACKEND_IO_FAILED;
+  }
+
+  u64 totalBytesRead = 0;
+  while (totalBytesRead < length && connection->receivedCount != 0) {
+    struct tls_connection_received *received = connection->received + connection->receivedHead;
+    u64 bytesRead = received->length - received->offset;
+    if (bytesRead > length - totalBytesRead)
+      bytesRead = length - totalBytesRead;
+    MemoryCopy(buffer + totalBytesRead, received->buffer + received->offset, bytesRead);
+    received->offset += (u32)bytesRead;
+    totalBytesRead += bytesRead;
+
+    if (received->offset == received->length) {
+      PlatformTransportRelease(connection->transport, received->bufferId);
+      connection->receivedHead = (connection->receivedHead + 1) % TLS_CONNECTION_RECEIVED_MAX;
+      connection->receivedCount--;
+    }
+  }
+
+  return (s64)totalBytesRead;
+}
+
+/*
+ * Hands what TLS library wrote to transport, when nothing is being sent.
+ */
+internalfn void
+TlsConnectionFlush(struct tls_connection *connection)
+{
+  u32 fillIndex = connection->sendFillIndex;
+  if (connection->isSending || connection->sendLengths[fillIndex] == 0 || connection->socket.fd == -1)
+    return;
+
+  // answer is waited for on same submission, unless it already is
+  PlatformTransportSend(connection->transport, &connection->socket, connection->sendBuffers[fillIndex],
+                        connection->sendLengths[fillIndex], PLATFORM_TRANSPORT_SEND_RECEIVE);
+  connection->isSending = 1;
+  connection->sendFillIndex = fillIndex ^ 1;
+  connection->sendLengths[connection->sendFillIndex] = 0;
+}
+
+internalfn void
+TlsConnectionFail(struct tls_connection *connection, s32 error)
+{
+  connection->state = TLS_CONNECTION_STATE_FAILED;
+  connection->error = error;
+}
+
+/*
+ * @param data given back in platform_completion
+ * @return false on error, see connection->error
+ */
+internalfn b8
+TlsConnectionInit(struct tls_connection *connection, struct tls_backend_config *tlsConfig,
+                  struct platform_transport *transport, void *data)
+{
+  *connection = (struct tls_connection){
+      .state = TLS_CONNECTION_STATE_CLOSED,
+      .transport = transport,
+      .socket = {.fd = -1, .data = data},
+  };
+  for (u32 attemptIndex = 0; attemptIndex < TLS_CONNECTION_ATTEMPT_MAX; attemptIndex++)
+    connection->attempts[attemptIndex] = (struct platform_socket){.fd = -1, .data = data};
+
+  for (u32 sendBufferIndex = 0; sendBufferIndex < ARRAY_COUNT(connection->sendBuffers); sendBufferIndex++) {
+    connection->sendBuffers[sendBufferIndex] = PlatformTransportSendBuffer(transport);
+    if (!connection->sendBuffers[sendBufferIndex]) {
+      TlsConnectionFail(connection, ENOBUFS);
+      return 0;
+    }
+  }
+
+  s32 tlsError;
+  if (!TlsBackendInit(&connection->backend, tlsConfig, connection, &tlsError)) {
+    TlsConnectionFail(connection, tlsError);
+    return 0;
+  }
+  return 1;
+}
+
+/*
+ * Starts connecting to server, handshake starts when connect completes.
+ * Plain connection is open then.
+ * @param hostname must be zero terminated, server certificate is checked for it
+ * @return state of connection
+ */
+internalfn enum tls_connection_state
+TlsConnectionConnect(struct tls_connection *connection, struct platform_address *address, struct string *hostname)
+{
+  debug_assert(connection->state == TLS_CONNECTION_STATE_CLOSED);
+  debug_assert(hostname->value[hostname->length] == 0 && "must be zero terminated");
+
+  s32 tlsError;
+  if (!connection->isPlain && !TlsBackendSetHostname(&connection->backend, (char *)hostname->value, &tlsError)) {
+    TlsConnectionFail(connection, tlsError);
+    return connection->state;
+  }
+
+  if (!PlatformTransportConnect(connection->transport, &connection->socket, address)) {
+    TlsConnectionFail(connection, errno);
+    return connection->state;
+  }
+
+  connection->state = TLS_CONNECTION_STATE_CONNECTING;
+  return connection->state;
+}
+
+internalfn b8
+TlsConnectionIsAttemptInFlight(struct tls_connection *connection)
+{
+  for (u32 attemptIndex = 0; attemptIndex < TLS_CONNECTION_ATTEMPT_MAX; attemptIndex++) {
+    if (connection->attempts[attemptIndex].fd != -1)
+      return 1;
+  }
+  return 0;
+}
+
+/*
+ * Starts attempts that are due, see TlsConnectionConnectAny(). Call after
+ * every TlsConnectionComplete(), failed attempt lets next one start at once.
+ * @param now see NowInNanoseconds()
+ * @return state of connection, failed when every attempt failed
+ */
+internalfn enum tls_connection_state
+TlsConnectionAttempt(struct tls_connection *connection, u64 now)
+{
+  if (connection->state != TLS_CONNECTION_STATE_CONNECTING || !connection->isRacing)
+    return connection->state;
+
+  while (connection->addressNext < connection->addressCount && now >= connection->attemptAt) {
+    struct platform_socket *attempt = 0;
+    for (u32 attemptIndex = 0; attemptIndex < TLS_CONNECTION_ATTEMPT_MAX; attemptIndex++) {
+      if (connection->attempts[attemptIndex].fd == -1) {
+        attempt = connection->attempts + attemptIndex;
+        break;
+      }
+    }
+    if (!attempt)
+      break;
+
+    struct platform_address *address =
+        connection->addresses + (connection->addressFirst + connection->addressNext) % connection->addressCount;
+    connection->addressNext++;
+    // e.g. host has no IPv6 route, next address is tried at once
+    if (!PlatformTransportConnect(connection->transport, attempt, address)) {
+      connection->error = errno;
+      continue;
+    }
+    connection->attemptAt = now + TLS_CONNECTION_ATTEMPT_DELAY;
+  }
+
+  if (!TlsConnectionIsAttemptInFlight(connection) && connection->addressNext == connection->addressCount)
+    TlsConnectionFail(connection, connection->error);
+  return connection->state;
+}
+
+/*
+ * Starts connecting to server at any of its addresses, handshake starts when
+ * one of them connects.
+ * @param addresses in order they are tried, see DnsAddressInterleave(). They
+ *        must stay in place until connection is open, socket.address points
+ *        to one that is connected to.
+ * @param addressFirst tried first, e.g. one that connected last time
+ * @param hostname must be zero terminated, server certificate is checked for it
+ * @param now see NowInNanoseconds()
+ * @return state of connection
+ */
+internalfn enum tls_connection_state
+TlsConnectionConnectAny(struct tls_connection *connection, struct platform_address *addresses, u32 addressCount,
+                        u32 addressFirst, struct string *hostname, u64 now)
+{
+  debug_assert(addressFirst < addressCount);
+  if (addressCount == 1)
+    return TlsConnectionConnect(connection, addresses, hostname);
+
+  debug_assert(connection->state == TLS_CONNECTION_STATE_CLOSED);
+  debug_assert(hostname->value[hostname->length] == 0 && "must be zero terminated");
+
+  s32 tlsError;
+  if (!connection->isPlain && !TlsBackendSetHostname(&connection->backend, (char *)hostname->value, &tlsError)) {
+    TlsConnectionFail(connection, tlsError);
+    return connection->state;
+  }
+
+  connection->addresses = addresses;
+  connection->addressCount = addressCount;
+  connection->addressFirst = addressFirst;
+  connection->addressNext = 0;
+  connection->attemptAt = 0;
+  connection->isRacing = 1;
+  connection->error = ECONNREFUSED;
+  connection->state = TLS_CONNECTION_STATE_CONNECTING;
+  return TlsConnectionAttempt(connection, now);
+}
+
+/*
+ * @param now see NowInNanoseconds()
+ * @return nanoseconds until next attempt is due, -1 when none is
+ */
+internalfn u64
+TlsConnectionAttemptTimeout(struct tls_connection *connection, u64 now)
+{
+  if (connection->state != TLS_CONNECTION_STATE_CONNECTING || !connection->isRacing ||
+      connection->addressNext == connection->addressCount)
+    return (u64)-1;
+  return connection->attemptAt > now ? connection->attemptAt - now : 0;
+}
+
+internalfn void
+TlsConnectionCloseAttempts(struct tls_connection *connection)
+{
+  for (u32 attemptIndex = 0; attemptIndex < TLS_CONNECTION_ATTEMPT_MAX; attemptIndex++)
+    PlatformTransportCloseSocket(connection->transport, connection->attempts + attemptIndex);
+  connection->addresses = 0;
+  connection->addressCount = 0;
+  connection->addressNext = 0;
+  connection->isRacing = 0;
+}
+
+/*
+ * Takes completion of connection attempt. First one that connects wins, its
+ * socket becomes socket of connection and others are closed.
+ */
+internalfn void
+TlsConnectionCompleteAttempt(struct tls_connection *connection, struct platform_completion *completion)
+{
+  struct platform_socket *attempt = completion->socket;
+  if (completion->generation != attempt->generation || connection->state != TLS_CONNECTION_STATE_CONNECTING)
+    return;
+  debug_assert(completion->type == PLATFORM_COMPLETION_CONNECT);
+
+  if (completion->result < 0) {
+    PlatformTransportCloseSocket(connection->transport, attempt);
+    connection->error = -completion->result;
+    // next one starts at once
+    connection->attemptAt = 0;
+    if (!TlsConnectionIsAttemptInFlight(connection) && connection->addressNext == connection->addressCount)
+      TlsConnectionFail(connection, connection->error);
+    return;
+  }
+
+  PlatformTransportMoveSocket(connection->transport, attempt, &connection->socket);
+  TlsConnectionCloseAttempts(connection);
+  connection->error = 0;
+  connection->state = connection->isPlain ? TLS_CONNECTION_STATE_OPEN : TLS_CONNECTION_STATE_HANDSHAKING;
+}
+
+/*
+ * Takes accepted socket, for server side of connection.
+ * @return state of connection
+ */
+internalfn enum tls_connection_state
+TlsConnectionAccept(struct tls_connection *connection, s32 socket)
+{
+  debug_assert(connection->state == TLS_CONNECTION_STATE_CLOSED);
+
+  if (!PlatformTransportAttach(connection->transport, &connection->socket, socket)) {
+    TlsConnectionFail(connection, errno);
+    PlatformSocketClose(socket);
+    connection->socket.fd = -1;
+    return connection->state;
+  }
+
+  // client speaks first
+  PlatformTransportReceive(connection->transport, &connection->socket);
+  connection->state = TLS_CONNECTION_STATE_HANDSHAKING;
+  return connection->state;
+}
+
+/*
+ * Takes completion of connection's socket. Call TlsConnectionHandshake(),
+ * TlsConnectionRead() or TlsConnectionWrite() after to move on.
+ */
+internalfn void
+TlsConnectionComplete(struct tls_connection *connection, struct platform_completion *completion)
+{
+  if (completion->socket != &connection->socket) {
+    TlsConnectionCompleteAttempt(connection, completion);
+    return;
+  }
+
+  // connection is closed after completion is taken, e.g. earlier in same batch
+  if (completion->generation != connection->socket.generation) {
+    if (completion->buffer)
+      PlatformTransportRelease(connection->transport, completion->bufferId);
+    return;
+  }
+
+  switch (completion->type) {
+  case PLATFORM_COMPLETION_CONNECT: {
+    if (completion->result < 0) {
+      TlsConnectionFail(connection, -completion->result);
+      break;
+    }
+    if (connection->state == TLS_CONNECTION_STATE_CONNECTING)
+      connection->state = connection->isPlain ? TLS_CONNECTION_STATE_OPEN : TLS_CONNECTION_STATE_HANDSHAKING;
+  } break;
+
+  case PLATFORM_COMPLETION_RECEIVE: {
+    if (completion->result > 0) {
+      if (connection->receivedCount == TLS_CONNECTION_RECEIVED_MAX) {
+        PlatformTransportRelease(connection->transport, completion->bufferId);
+        TlsConnectionFail(connection, ENOBUFS);
+        break;
+      }
+
+      u32 index = (connection->receivedHead + connection->receivedCount) % TLS_CONNECTION_RECEIVED_MAX;
+      connection->received[index] = (struct tls_connection_received){
+          .buffer = completion->buffer,
+          .bufferId = completion->bufferId,
+          .length = (u32)completion->result,
+      };
+      connection->receivedCount++;
+    }
+
+    if (completion->isMore)
+      break;
+
+    // multishot receive stops when transport runs out of buffers, others give
+    // theirs back meanwhile
+    if (completion->result > 0 || completion->result == -ENOBUFS) {
+      if (!(connection->socket.state & PLATFORM_SOCKET_STATE_RECEIVING))
+        PlatformTransportReceive(connection->transport, &connection->socket);
+    } else {
+      connection->isReceiveEnded = 1;
+      connection->receiveResult = completion->result;
+    }
+  } break;
+
+  case PLATFORM_COMPLETION_SEND: {
+    connection->isSending = 0;
+    if (completion->result < 0)
+      connection->sendResult = completion->result;
+    else
+      TlsConnectionFlush(connection);
+  } break;
+
+  case PLATFORM_COMPLETION_ACCEPT: {
+    debug_assert(0 && "connections do not listen");
+  } break;
+  }
+}
+
+/*
+ * Moves connection forward as far as it can go without blocking.
+ * @return state of connection, TLS_CONNECTION_STATE_OPEN when handshake is
+ *         complete
+ */
+internalfn enum tls_connection_state
+TlsConnectionHandshake(struct tls_connection *connection)
+{
+  if (connection->state != TLS_CONNECTION_STATE_HANDSHAKING)
+    return connection->state;
+
+  s32 tlsError;
+  enum tls_backend_result result = TlsBackendHandshake(&connection->backend, &tlsError);
+  if (result == TLS_BACKEND_DONE)
+    connection->state = TLS_CONNECTION_STATE_OPEN;
+  else if (result != TLS_BACKEND_WANT)
+    TlsConnectionFail(connection, tlsError);
+
+  TlsConnectionFlush(connection);
+  return connection->state;
+}
+
+/*
+ * Writes as much of data as send buffers take. When not every byte is written,
+ * call again with rest of data after send completes.
+ * @return bytes written
+ *         TLS_CONNECTION_WOULD_BLOCK when nothing can be written now
+ *         -1 on error, see connection->error
+ */
+internalfn s64
+TlsConnectionWrite(struct tls_connection *connection, struct string *data)
+{
+  debug_assert(connection->state == TLS_CONNECTION_STATE_OPEN);
+
+  // bytes go to socket as they are
+  b8 isPassThrough = connection->isPlain || connection->isKernelTlsSend;
+  u64 totalBytesWritten = 0;
+  while (isPassThrough && totalBytesWritten < data->length) {
+    s64 bytesWritten = TlsBackendIoSend(connection, data->value + totalBytesWritten, data->length - totalBytesWritten);
+    if (bytesWritten == TLS_BACKEND_IO_WOULD_BLOCK)
+      break;
+    if (bytesWritten < 0) {
+      TlsConnectionFail(connection, -connection->sendResult);
+      return -1;
+    }
+    totalBytesWritten += (u64)bytesWritten;
+  }
+
+  while (!isPassThrough && totalBytesWritten < data->length) {
+    u64 bytesWritten;
+    s32 tlsError;
+    enum tls_backend_result result = TlsBackendWrite(&connection->backend, data->value + totalBytesWritten,
+                                                     data->length - totalBytesWritten, &bytesWritten, &tlsError);
+    if (result == TLS_BACKEND_DONE) {
+      totalBytesWritten += bytesWritten;
+      continue;
+    }
+
+    if (result != TLS_BACKEND_WANT) {
+      TlsConnectionFail(connection, tlsError);
+      return -1;
+    }
+    break;
+  }
+
+  TlsConnectionFlush(connection);
+  if (totalBytesWritten == 0 && data->length != 0)
+    return TLS_CONNECTION_WOULD_BLOCK;
+  return (s64)totalBytesWritten;
+}
+
+/*
+ * Reads what is received without blocking.
+ * @return bytes read, 0 when peer closed connection
+ *         TLS_CONNECTION_WOULD_BLOCK when nothing is available now
+ *         -1 on error, see connection->error
+ */
+internalfn s64
+TlsConnectionRead(struct tls_connection *connection, u8 *buffer, u64 length)
+{
+  debug_assert(connection->state == TLS_CONNECTION_STATE_OPEN);
+
+  if (connection->isPlain || connection->isKernelTlsReceive) {
+    s64 bytesRead = TlsBackendIoReceive(connection, buffer, length);
+    if (bytesRead == TLS_BACKEND_IO_WOULD_BLOCK)
+      return TLS_CONNECTION_WOULD_BLOCK;
+    if (bytesRead < 0) {
+      TlsConnectionFail(connection, -connection->receiveResult);
+      return -1;
+    }
+    return bytesRead;
+  }
+
+  while (1) {
+    u64 bytesRead;
+    s32 tlsError;
+    enum tls_backend_result result = TlsBackendRead(&connection->backend, buffer, length, &bytesRead, &tlsError);
+    // post-handshake messages may be answered
+    TlsConnectionFlush(connection);
+    switch (result) {
+    case TLS_BACKEND_DONE:
+      return (s64)bytesRead;
+    case TLS_BACKEND_CLOSED:
+      return 0;
+    case TLS_BACKEND_SESSION_TICKET:
+      connection->isSessionTicketReceived = 1;
+      continue;
+    case TLS_BACKEND_WANT:
+      return TLS_CONNECTION_WOULD_BLOCK;
+    case TLS_BACKEND_FAILED:
+      TlsConnectionFail(connection, tlsError);
+      return -1;
+    }
+  }
+}
+
+/*
+ * Hands records of open connection to kernel, see PlatformSocketKernelTls().
+ * Works only when nothing is buffered between library and socket, e.g. after
+ * every response is read, call again later otherwise. Receive is taken first,
+ * when kernel does not take send too library keeps writing records. Session
+ * tickets that come after are skipped, so call after ticket is received.
+ * @return true when kernel decrypts what is read, false when library keeps
+ *         doing it, see errno
+ */
+internalfn b8
+TlsConnectionKernelTls(struct tls_connection *connection)
+{
+  if (connection->isKernelTlsReceive)
+    return 1;
+  if (connection->isPlain) {
+    errno = EOPNOTSUPP;
+    return 0;
+  }
+  if (connection->state != TLS_CONNECTION_STATE_OPEN || connection->receivedCount != 0 ||
+      connection->isReceiveEnded || (connection->socket.state & PLATFORM_SOCKET_STATE_SENDING) ||
+      connection->sendLengths[connection->sendFillIndex] != 0) {
+    errno = EBUSY;
+    return 0;
+  }
+
+  struct platform_tls_key sendKey;
+  struct platform_tls_key receiveKey;
+  if (!TlsBackendTrafficKeys(&connection->backend, &sendKey, &receiveKey)) {
+    errno = EOPNOTSUPP;
+    return 0;
+  }
+
+  struct platform_transport *transport = connection->transport;
+  connection->isKernelTlsReceive = PlatformTransportKernelTls(transport, &connection->socket, 0, &receiveKey);
+  if (connection->isKernelTlsReceive)
+    connection->isKernelTlsSend = PlatformTransportKernelTls(transport, &connection->socket, 1, &sendKey);
+
+  int error = errno;
+  MemoryClear(&sendKey, sizeof(sendKey));
+  MemoryClear(&receiveKey, sizeof(receiveKey));
+  errno = error;
+  return connection->isKernelTlsReceive;
+}
+
+/*
+ * Closes socket, connection can be connected again.
+ */
+internalfn void
+TlsConnectionClose(struct tls_connection *connection)
+{
+  if (connection->socket.fd != -1) {
+    if (connection->state == TLS_CONNECTION_STATE_OPEN && !connection->isKernelTlsSend && !connection->isPlain) {
+      // best effort, it is not waited for
+      TlsBackendCloseNotify(&connection->backend);
+      TlsConnectionFlush(connection);
+    }
+
+    PlatformTransportCloseSocket(connection->transport, &connection->socket);
+  }
+  if (connection->isRacing)
+    TlsConnectionCloseAttempts(connection);
+
+  while (connection->receivedCount != 0) {
+    PlatformTransportRelease(connection->transport, connection->received[connection->receivedHead].bufferId);
+    connection->receivedHead = (connection->receivedHead + 1) % TLS_CONNECTION_RECEIVED_MAX;
+    connection->receivedCount--;
+  }
+  connection->receivedHead = 0;
+  connection->isReceiveEnded = 0;
+  connection->receiveResult = 0;
+  connection->sendLengths[0] = 0;
+  connection->sendLengths[1] = 0;
+  connection->isSending = 0;
+  connection->sendResult = 0;
+  connection->isSessionTicketReceived = 0;
+  connection->isKernelTlsReceive = 0;
+  connection->isKernelTlsSend = 0;
+
+  connection->state = TLS_CONNECTION_STATE_CLOSED;
+  s32 tlsError;
+  if (!TlsBackendReset(&connection->backend, &tlsError))
+    TlsConnectionFail(connection, tlsError);
+}
+
+internalfn void
+TlsConnectionRelease(struct tls_connection *connection)
+{
+  TlsConnectionClose(connection);
+  TlsBackendFree(&connection->backend);
+}
@@ -0,0 +1,303 @@
+#pragma once
+
+/*
+ * TLS sessions that outlive process
+ *
+ * After TLS 1.3 handshake server gives client session tickets. Offering one
+ * on next connection resumes session, server skips sending its certificate
+ * and client skips checking it. Sessions are kept per host and port until
+ * their ticket expires, and moved between runs through a file that caller
+ * locks:
+ *
+ * @code
+ *   TlsSessionCacheInit(&cache, arena)
+ *   file = PlatformFileLock(&path, 0)
+ *   TlsSessionCacheParse(&cache, &content, now)
+ *   PlatformFileUnlock(file)
+ *
+ *   TlsSessionCacheResume(&cache, &hostname, &port, &backend, now)  // before handshake
+ *   TlsSessionCacheStore(&cache, &hostname, &port, &backend, now)   // after ticket is received
+ *
+ *   file = PlatformFileLock(&path, 1)
+ *   TlsSessionCacheParse(&cache, &content, now)  // keeps what others stored meanwhile
+ *   content = TlsSessionCacheSerialize(&cache, &buffer, now)
+ *   PlatformFileLockedWrite(file, &content)
+ *   PlatformFileUnlock(file)
+ * @endcode
+ *
+ * File format, integers are little endian:
+ *
+ *   "ITSC" u32 version, u32 entryCount
+ *   entryCount times:
+ *     u64 expiresAt   seconds since 1970-01-01 UTC
+ *     u16 keyLength, u16 sessionLength
+ *     key             "hostname:port"
+ *     session         see TlsBackendSessionExport()
+ */
+
+#include "memory.h"
+#include "text.h"
+#include "tls_backend.h"
+#include "type.h"
+
+enum {
+  TLS_SESSION_CACHE_ENTRY_MAX = 16,
+  // hostname:port
+  TLS_SESSION_CACHE_KEY_MAX = 255 + 1 + 5,
+  // session can have peer certificate in it, e.g. MBEDTLS_SSL_KEEP_PEER_CERTIFICATE
+  TLS_SESSION_CACHE_SESSION_MAX = 4096,
+  // RFC 8446 4.6.1. New Session Ticket Message
+  TLS_SESSION_CACHE_LIFETIME_MAX = 7 * 24 * 60 * 60,
+
+  // sessions of one TLS library can not be resumed by other, file that other
+  // build wrote is taken as empty
+  TLS_SESSION_CACHE_VERSION = IS_TLS_BACKEND_WOLFSSL ? 0x101 : 1,
+  TLS_SESSION_CACHE_HEADER_LENGTH = 4 + 4 + 4,
+  TLS_SESSION_CACHE_ENTRY_HEADER_LENGTH = 8 + 2 + 2,
+  // every entry at its largest
+  TLS_SESSION_CACHE_FILE_MAX =
+      TLS_SESSION_CACHE_HEADER_LENGTH +
+      TLS_SESSION_CACHE_ENTRY_MAX *
+          (TLS_SESSION_CACHE_ENTRY_HEADER_LENGTH + TLS_SESSION_CACHE_KEY_MAX + TLS_SESSION_CACHE_SESSION_MAX),
+};
+
+struct tls_session_cache_entry {
+  // seconds since 1970-01-01 UTC
+  u64 expiresAt;
+  u16 keyLength;
+  u16 sessionLength;
+  u8 key[TLS_SESSION_CACHE_KEY_MAX];
+  u8 session[TLS_SESSION_CACHE_SESSION_MAX];
+};
+
+struct tls_session_cache {
+  struct tls_session_cache_entry *entries;
+  u32 entryCount;
+  // something is stored since file is read, so it has to be written back
+  b8 isChanged;
+};
+
+internalfn void
+TlsSessionCacheInit(struct tls_session_cache *cache, memory_arena *arena)
+{
+  *cache = (struct tls_session_cache){
+      .entries = MemoryArenaPush(arena, sizeof(*cache->entries) * TLS_SESSION_CACHE_ENTRY_MAX),
+  };
+}
+
+/*
+ * @return key length, 0 when it does not fit
+ */
+internalfn u16
+TlsSessionCacheKey(u8 key[TLS_SESSION_CACHE_KEY_MAX], struct string *hostname, struct string *port)
+{
+  u64 length = hostname->length + 1 + port->length;
+  if (length > TLS_SESSION_CACHE_KEY_MAX)
+    return 0;
+
+  MemoryCopy(key, hostname->value, hostname->length);
+  key[hostname->length] = ':';
+  MemoryCopy(key + hostname->length + 1, port->value, port->length);
+  return (u16)length;
+}
+
+internalfn struct tls_session_cache_entry *
+TlsSessionCacheFind(struct tls_session_cache *cache, u8 *key, u16 keyLength)
+{
+  struct string keyString = StringFromBuffer(key, keyLength);
+  for (u32 entryIndex = 0; entryIndex < cache->entryCount; entryIndex++) {
+    struct tls_session_cache_entry *entry = cache->entries + entryIndex;
+    struct string entryKey = StringFromBuffer(entry->key, entry->keyLength);
+    if (IsStringEqual(&entryKey, &keyString))
+      return entry;
+  }
+  return 0;
+}
+
+/*
+ * Stores session unless one for same key expires later. When cache is full,
+ * session that expires first makes place.
+ * @return false when session is not stored
+ */
+internalfn b8
+TlsSessionCacheInsert(struct tls_session_cache *cache, u8 *key, u16 keyLength, u8 *session, u16 sessionLength,
+                      u64 expiresAt)
+{
+  struct tls_session_cache_entry *entry = TlsSessionCacheFind(cache, key, keyLength);
+  if (entry) {
+    if (entry->expiresAt >= expiresAt)
+      return 0;
+  } else if (cache->entryCount < TLS_SESSION_CACHE_ENTRY_MAX) {
+    entry = cache->entries + cache->entryCount;
+    cache->entryCount++;
+  } else {
+    entry = cache->entries + 0;
+    for (u32 entryIndex = 1; entryIndex < cache->entryCount; entryIndex++) {
+      if (cache->entries[entryIndex].expiresAt < entry->expiresAt)
+        entry = cache->entries + entryIndex;
+    }
+    if (entry->expiresAt >= expiresAt)
+      return 0;
+  }
+
+  entry->expiresAt = expiresAt;
+  entry->keyLength = keyLength;
+  MemoryCopy(entry->key, key, keyLength);
+  entry->sessionLength = sessionLength;
+  MemoryCopy(entry->session, session, sessionLength);
+  return 1;
+}
+
+internalfn u64
+TlsSessionCacheReadInteger(u8 *octets, u32 length)
+{
+  u64 value = 0;
+  for (u32 index = length; index > 0; index--)
+    value = (value << 8) | octets[index - 1];
+  return value;
+}
+
+internalfn void
+TlsSessionCacheWriteInteger(u8 *octets, u32 length, u64 value)
+{
+  for (u32 index = 0; index < length; index++) {
+    octets[index] = (u8)value;
+    value >>= 8;
+  }
+}
+
+/*
+ * Takes sessions from file content. Sessions that are expired, or expire
+ * before ones already in cache, are left out.
+ * @param now seconds since 1970-01-01 UTC, see PlatformUnixTime()
+ * @return false when content is not a session cache, empty content is
+ */
+internalfn b8
+TlsSessionCacheParse(struct tls_session_cache *cache, struct string *content, u64 now)
+{
+  if (content->length == 0)
+    return 1;
+
+  u8 *octets = content->value;
+  if (content->length < TLS_SESSION_CACHE_HEADER_LENGTH || octets[0] != 'I' || octets[1] != 'T' ||
+      octets[2] != 'S' || octets[3] != 'C' || TlsSessionCacheReadInteger(octets + 4, 4) != TLS_SESSION_CACHE_VERSION)
+    return 0;
+
+  u64 entryCount = TlsSessionCacheReadInteger(octets + 8, 4);
+  u64 position = TLS_SESSION_CACHE_HEADER_LENGTH;
+  for (u64 entryIndex = 0; entryIndex < entryCount; entryIndex++) {
+    if (content->length - position < TLS_SESSION_CACHE_ENTRY_HEADER_LENGTH)
+      return 0;
+    u64 expiresAt = TlsSessionCacheReadInteger(octets + position, 8);
+    u64 keyLength = TlsSessionCacheReadInteger(octets + position + 8, 2);
+    u64 sessionLength = TlsSessionCacheReadInteger(octets + position + 10, 2);
+    position += TLS_SESSION_CACHE_ENTRY_HEADER_LENGTH;
+
+    if (keyLength > TLS_SESSION_CACHE_KEY_MAX || sessionLength > TLS_SESSION_CACHE_SESSION_MAX ||
+        content->length - position < keyLength + sessionLength)
+      return 0;
+
+    u8 *key = octets + position;
+    u8 *session = key + keyLength;
+    position += keyLength + sessionLength;
+    if (expiresAt <= now)
+      continue;
+
+    TlsSessionCacheInsert(cache, key, (u16)keyLength, session, (u16)sessionLength, expiresAt);
+  }
+
+  return position == content->length;
+}
+
+/*
+ * Writes sessions that are not expired in file format.
+ * @param buffer TLS_SESSION_CACHE_FILE_MAX is enough
+ * @param now seconds since 1970-01-01 UTC, see PlatformUnixTime()
+ * @return content in buffer, null when it does not fit
+ */
+internalfn struct string
+TlsSessionCacheSerialize(struct tls_session_cache *cache, struct string *buffer, u64 now)
+{
+  if (buffer->length < TLS_SESSION_CACHE_HEADER_LENGTH)
+    return StringNull();
+
+  u8 *octets = buffer->value;
+  u64 position = TLS_SESSION_CACHE_HEADER_LENGTH;
+  u32 entryCount = 0;
+  for (u32 entryIndex = 0; entryIndex < cache->entryCount; entryIndex++) {
+    struct tls_session_cache_entry *entry = cache->entries + entryIndex;
+    if (entry->expiresAt <= now)
+      continue;
+
+    u64 entryLength = (u64)TLS_SESSION_CACHE_ENTRY_HEADER_LENGTH + entry->keyLength + entry->sessionLength;
+    if (buffer->length - position < entryLength)
+      return StringNull();
+
+    TlsSessionCacheWriteInteger(octets + position, 8, entry->expiresAt);
+    TlsSessionCacheWriteInteger(octets + position + 8, 2, entry->keyLength);
+    TlsSessionCacheWriteInteger(octets + position + 10, 2, entry->sessionLength);
+    position += TLS_SESSION_CACHE_ENTRY_HEADER_LENGTH;
+    MemoryCopy(octets + position, entry->key, entry->keyLength);
+    position += entry->keyLength;
+    MemoryCopy(octets + position, entry->session, entry->sessionLength);
+    position += entry->sessionLength;
+    entryCount++;
+  }
+
+  MemoryCopy(octets, "ITSC", 4);
+  TlsSessionCacheWriteInteger(octets + 4, 4, TLS_SESSION_CACHE_VERSION);
+  TlsSessionCacheWriteInteger(octets + 8, 4, entryCount);
+  return StringFromBuffer(octets, position);
+}
+
+/*
+ * Offers stored session of host on next handshake of backend.
+ * @param now seconds since 1970-01-01 UTC, see PlatformUnixTime()
+ * @return false when there is none, handshake is full then
+ */
+internalfn b8
+TlsSessionCacheResume(struct tls_session_cache *cache, struct string *hostname, struct string *port,
+                      struct tls_backend *backend, u64 now)
+{
+  u8 key[TLS_SESSION_CACHE_KEY_MAX];
+  u16 keyLength = TlsSessionCacheKey(key, hostname, port);
+  if (keyLength == 0)
+    return 0;
+
+  struct tls_session_cache_entry *entry = TlsSessionCacheFind(cache, key, keyLength);
+  if (!entry || entry->expiresAt <= now)
+    return 0;
+
+  struct string session = StringFromBuffer(entry->session, entry->sessionLength);
+  return TlsBackendSessionImport(backend, &session);
+}
+
+/*
+ * Stores session of backend, call after ticket is received, see
+ * tls_connection.isSessionTicketReceived.
+ * @param now seconds since 1970-01-01 UTC, see PlatformUnixTime()
+ * @return false when it is not stored
+ */
+internalfn b8
+TlsSessionCacheStore(struct tls_session_cache *cache, struct string *hostname, struct string *port,
+                     struct tls_backend *backend, u64 now)
+{
+  u8 key[TLS_SESSION_CACHE_KEY_MAX];
+  u16 keyLength = TlsSessionCacheKey(key, hostname, port);
+  if (keyLength == 0)
+    return 0;
+
+  u8 serialized[TLS_SESSION_CACHE_SESSION_MAX];
+  struct string buffer = StringFromBuffer(serialized, sizeof(serialized));
+  u64 lifetime = 0;
+  struct string session = TlsBackendSessionExport(backend, &buffer, &lifetime);
+  if (lifetime > TLS_SESSION_CACHE_LIFETIME_MAX)
+    lifetime = TLS_SESSION_CACHE_LIFETIME_MAX;
+  if (IsStringNull(&session) || lifetime == 0)
+    return 0;
+
+  if (!TlsSessionCacheInsert(cache, key, keyLength, session.value, (u16)session.length, now + lifetime))
+    return 0;
+  cache->isChanged = 1;
+  return 1;
+}
@@ -0,0 +1,254 @@
+#pragma once
+
+/*
+ * Answers of videos for whole run
+ *
+ * Lists of videos often name same video many times, e.g. playlists that
+ * overlap. Video is requested once: it is put in table before its request is
+ * sent, every other time it is asked for waits for its answer, and once
+ * answered is printed again from what is kept here.
+ *
+ * Table is open addressing with linear probing, entries are never removed.
+ * Answers are kept one after another; every video whose answer is not here
+ * yet has room set aside for a usual one, and for longest one once it is
+ * waited for, so answer that is waited for is never dropped. When table or
+ * room is full, more videos are not put in, they are requested every time
+ * they are asked for. So is video whose answer is dropped.
+ *
+ * @code
+ *   VideoTableInit(&table, arena, entryMax)
+ *   entry = VideoTableFind(&table, &videoId)
+ *   if (entry && VideoTableWait(&table, entry)) {
+ *     // once it is not pending
+ *     answer = VideoTableEntryAnswer(&table, entry)
+ *   } else {
+ *     if (!entry)
+ *       entry = VideoTableInsert(&table, &videoId)   // 0 when full
+ *     // request video and print answer
+ *     VideoTableAnswer(&table, entry, &printed, isFailed)
+ *   }
+ * @endcode
+ */
+
+#include "assert.h"
+#include "math.h"
+#include "memory.h"
+#include "text.h"
+#include "type.h"
+
+enum {
+  // video ids are 11 characters
+  VIDEO_TABLE_KEY_MAX = 16,
+  // room set aside for answer, longer ones are kept only when there is more
+  VIDEO_TABLE_ANSWER_MAX = 1024,
+  // room set aside for answer that is waited for, it is never longer
+  VIDEO_TABLE_WAITED_ANSWER_MAX = 2 * VIDEO_TABLE_ANSWER_MAX,
+  // of every entry, answers are id, type and title
+  VIDEO_TABLE_ANSWER_AVERAGE = 256,
+};
+
+enum video_table_state {
+  VIDEO_TABLE_EMPTY = 0,
+  // request is sent, answer is not here yet
+  VIDEO_TABLE_PENDING,
+  VIDEO_TABLE_ANSWERED,
+  // answer is not a video
+  VIDEO_TABLE_FAILED,
+  // answer is longer than room that is left, it is not kept
+  VIDEO_TABLE_DROPPED,
+};
+
+struct video_table_entry {
+  u8 key[VIDEO_TABLE_KEY_MAX];
+  u8 keyLength;
+  u8 state;
+  // times it is asked for while its answer is not printed for them
+  u32 waiterCount;
+  u32 answerOffset;
+  u32 answerLength;
+};
+
+struct video_table {
+  struct video_table_entry *entries;
+  // power of two, 0 when table is off
+  u32 entryMax;
+  u32 entryCount;
+  u32 pendingCount;
+  // pending ones that are waited for
+  u32 waitedCount;
+
+  u8 *answers;
+  u64 answersLength;
+  u64 answersCapacity;
+};
+
+/*
+ * @param entryMax power of two
+ * @return bytes VideoTableInit() takes from arena
+ */
+internalfn u64
+VideoTableMemoryLength(u32 entryMax)
+{
+  return (u64)entryMax * sizeof(struct video_table_entry) + (u64)entryMax * VIDEO_TABLE_ANSWER_AVERAGE;
+}
+
+/*
+ * @param entryMax power of two, 0 turns table off
+ */
+internalfn void
+VideoTableInit(struct video_table *table, memory_arena *arena, u32 entryMax)
+{
+  debug_assert(entryMax == 0 || IsPowerOfTwo(entryMax));
+  *table = (struct video_table){
+      .entryMax = entryMax,
+      .answersCapacity = (u64)entryMax * VIDEO_TABLE_ANSWER_AVERAGE,
+  };
+  if (entryMax == 0)
+    return;
+
+  table->entries = MemoryArenaPush(arena, sizeof(*table->entries) * entryMax);
+  MemoryClear(table->entries, sizeof(*table->entries) * entryMax);
+  table->answers = MemoryArenaPush(arena, table->answersCapacity);
+}
+
+internalfn u32
+VideoTableHash(struct string *videoId)
+{
+  // FNV-1a
+  u32 hash = 0x811c9dc5;
+  for (u64 index = 0; index < videoId->length; index++) {
+    hash ^= videoId->value[index];
+    hash *= 0x01000193;
+  }
+  return hash;
+}
+
+/*
+ * @return entry of video, or empty one where it goes, 0 when table is off
+ */
+internalfn struct video_table_entry *
+VideoTableSlot(struct video_table *table, struct string *videoId)
+{
+  if (table->entryMax == 0)
+    return 0;
+
+  u32 mask = table->entryMax - 1;
+  u32 index = VideoTableHash(videoId) & mask;
+  while (1) {
+    struct video_table_entry *entry = table->entries + index;
+    if (entry->state == VIDEO_TABLE_EMPTY)
+      return entry;
+    struct string key = StringFromBuffer(entry->key, entry->keyLength);
+    if (IsStringEqual(&key, videoId))
+      return entry;
+    index = (index + 1) & mask;
+  }
+}
+
+/*
+ * @return 0 when video is not in table
+ */
+internalfn struct video_table_entry *
+VideoTableFind(struct video_table *table, struct string *videoId)
+{
+  struct video_table_entry *entry = VideoTableSlot(table, videoId);
+  if (!entry || entry->state == VIDEO_TABLE_EMPTY)
+    return 0;
+  return entry;
+}
+
+/*
+ * @return room set aside for answers of pending videos
+ */
+internalfn u64
+VideoTableReservedLength(struct video_table *table)
+{
+  return (u64)table->pendingCount * VIDEO_TABLE_ANSWER_MAX +
+         (u64)table->waitedCount * (VIDEO_TABLE_WAITED_ANSWER_MAX - VIDEO_TABLE_ANSWER_MAX);
+}
+
+/*
+ * Puts video that is about to be requested in table.
+ * @return pending entry, 0 when table is full
+ */
+internalfn struct video_table_entry *
+VideoTableInsert(struct video_table *table, struct string *videoId)
+{
+  // probing stays short while table is at most 3/4 full
+  if (videoId->length > VIDEO_TABLE_KEY_MAX || (u64)(table->entryCount + 1) * 4 > (u64)table->entryMax * 3)
+    return 0;
+  // every pending video has room for its answer
+  if (table->answersLength + VideoTableReservedLength(table) + VIDEO_TABLE_ANSWER_MAX > table->answersCapacity)
+    return 0;
+
+  struct video_table_entry *entry = VideoTableSlot(table, videoId);
+  debug_assert(entry && entry->state == VIDEO_TABLE_EMPTY);
+  MemoryCopy(entry->key, videoId->value, videoId->length);
+  entry->keyLength = (u8)videoId->length;
+  entry->state = VIDEO_TABLE_PENDING;
+  entry->waiterCount = 0;
+  table->entryCount++;
+  table->pendingCount++;
+  return entry;
+}
+
+/*
+ * Video that is asked for again waits for answer of entry. Pending entry that
+ * is waited for first time sets aside room for longest answer.
+ * @return false when video cannot wait, its answer is dropped or there is no
+ *         room for it, so it is requested again
+ */
+internalfn b8
+VideoTableWait(struct video_table *table, struct video_table_entry *entry)
+{
+  if (entry->state == VIDEO_TABLE_DROPPED)
+    return 0;
+
+  if (entry->state == VIDEO_TABLE_PENDING && entry->waiterCount == 0) {
+    u64 reservedLength = VideoTableReservedLength(table) + VIDEO_TABLE_WAITED_ANSWER_MAX - VIDEO_TABLE_ANSWER_MAX;
+    if (table->answersLength + reservedLength > table->answersCapacity)
+      return 0;
+    table->waitedCount++;
+  }
+  entry->waiterCount++;
+  return 1;
+}
+
+/*
+ * Keeps what is printed for video, it is printed again for videos waiting for
+ * it.
+ * @param answer at most VIDEO_TABLE_WAITED_ANSWER_MAX when it is waited for
+ * @param isFailed answer is not a video
+ */
+internalfn void
+VideoTableAnswer(struct video_table *table, struct video_table_entry *entry, struct string *answer, b8 isFailed)
+{
+  debug_assert(entry->state == VIDEO_TABLE_PENDING);
+  debug_assert(entry->waiterCount == 0 || answer->length <= VIDEO_TABLE_WAITED_ANSWER_MAX);
+  table->pendingCount--;
+  if (entry->waiterCount != 0)
+    table->waitedCount--;
+
+  // room of entry is given up first, so answer that is waited for fits in it
+  if (table->answersLength + answer->length + VideoTableReservedLength(table) > table->answersCapacity) {
+    entry->state = VIDEO_TABLE_DROPPED;
+    entry->answerLength = 0;
+    return;
+  }
+
+  MemoryCopy(table->answers + table->answersLength, answer->value, answer->length);
+  entry->answerOffset = (u32)table->answersLength;
+  entry->answerLength = (u32)answer->length;
+  entry->state = isFailed ? VIDEO_TABLE_FAILED : VIDEO_TABLE_ANSWERED;
+  table->answersLength += answer->length;
+}
+
+/*
+ * @return what is printed for video, empty when it is dropped
+ */
+internalfn struct string
+VideoTableEntryAnswer(struct video_table *table, struct video_table_entry *entry)
+{
+  debug_assert(entry->state != VIDEO_TABLE_PENDING);
+  return StringFromBuffer(table->answers + entry->answerOffset, entry->answerLength);
+}
@@ -0,0 +1,209 @@
+#include "batch.c"
+#include "print.h"
+#include "string_builder.h"
+
+#define TEST_ERROR_LIST(X)                                                                                             \
+  X(LINES, "Lines must be given stripped, without empty and comment lines")                                            \
+  X(TOO_LONG, "Line longer than buffer must be reported once and dropped")                                             \
+  X(LINE_NUMBER, "Line number must count every line read")
+
+enum batch_test_error {
+  BATCH_TEST_ERROR_NONE = 0,
+#define X(tag, message) BATCH_TEST_ERROR_##tag,
+  TEST_ERROR_LIST(X)
+#undef X
+
+  // src: https://mesonbuild.com/Unit-tests.html#skipped-tests-and-hard-errors
+  // For the default exitcode testing protocol, the GNU standard approach in
+  // this case is to exit the program with error code 77. Meson will detect this
+  // and report these tests as skipped rather than failed. This behavior was
+  // added in version 0.37.0.
+  MESON_TEST_SKIP = 77,
+  // In addition, sometimes a test fails set up so that it should fail even if
+  // it is marked as an expected failure. The GNU standard approach in this case
+  // is to exit the program with error code 99. Again, Meson will detect this
+  // and report these tests as ERROR, ignoring the setting of should_fail. This
+  // behavior was added in version 0.50.0.
+  MESON_TEST_FAILED_TO_SET_UP = 99,
+};
+
+internalfn void
+StringBuilderAppendTestError(struct string_builder *sb, enum batch_test_error errorCode)
+{
+  struct string message = StringFromLiteral("Unknown error");
+  struct error {
+    enum batch_test_error code;
+    struct string message;
+  } errors[] = {
+#define XX(tag, msg) {.code = BATCH_TEST_ERROR_##tag, .message = StringFromLiteral(msg)},
+      TEST_ERROR_LIST(XX)
+#undef XX
+  };
+
+  for (u32 errorIndex = 0; errorIndex < ARRAY_COUNT(errors); errorIndex++) {
+    struct error *error = errors + errorIndex;
+    if (error->code != errorCode)
+      continue;
+
+    message = error->message;
+    break;
+  }
+
+  StringBuilderAppendString(sb, &message);
+}
+
+/*
+ * Reads input in pieces as if it came from pipe.
+ * @return lines joined with ",", too long line is "!"
+ */
+internalfn struct string
+ReadBatch(string_builder *lines, struct string *buffer, struct string *input, u64 pieceLength, u32 *lineNumber)
+{
+  struct batch_reader reader;
+  BatchReaderInit(&reader, buffer);
+  u64 position = 0;
+  while (1) {
+    struct string line;
+    enum batch_reader_result result = BatchReaderNext(&reader, &line);
+    if (result == BATCH_READER_END)
+      break;
+
+    if (result == BATCH_READER_MORE) {
+      struct string space = BatchReaderSpace(&reader);
+      u64 length = input->length - position;
+      if (length > pieceLength)
+        length = pieceLength;
+      if (length > space.length)
+        length = space.length;
+      MemoryCopy(space.value, input->value + position, length);
+      position += length;
+      BatchReaderAppend(&reader, length);
+      continue;
+    }
+
+    if (lines->length != 0)
+      StringBuilderAppendStringLiteral(lines, ",");
+    if (result == BATCH_READER_TOO_LONG)
+      StringBuilderAppendStringLiteral(lines, "!");
+    else
+      StringBuilderAppendString(lines, &line);
+  }
+
+  *lineNumber = reader.lineNumber;
+  if (lines->length == 0)
+    return StringFromLiteral("");
+  return StringBuilderFlush(lines);
+}
+
+internalfn void
+PrintBatchError(string_builder *sb, enum batch_test_error errorCode, struct string *expected, struct string *got)
+{
+  StringBuilderAppendTestError(sb, errorCode);
+  StringBuilderAppendStringLiteral(sb, "\n  expected: ");
+  StringBuilderAppendString(sb, expected);
+  StringBuilderAppendStringLiteral(sb, "\n       got: ");
+  StringBuilderAppendString(sb, got);
+  StringBuilderAppendStringLiteral(sb, "\n");
+  struct string errorMessage = StringBuilderFlush(sb);
+  PrintString(&errorMessage);
+}
+
+int
+main(void)
+{
+  enum batch_test_error errorCode = BATCH_TEST_ERROR_NONE;
+
+  // setup
+  enum {
+    KILOBYTES = (1 << 10),
+  };
+  u8 stackBuffer[16 * KILOBYTES];
+  memory_arena stackMemory = {
+      .block = stackBuffer,
+      .total = ARRAY_COUNT(stackBuffer),
+  };
+
+  string_builder *sb = MakeStringBuilder(&stackMemory, 4 * KILOBYTES, 32);
+  string_builder *lines = MakeStringBuilder(&stackMemory, 1 * KILOBYTES, 32);
+
+  // enum batch_reader_result BatchReaderNext(struct batch_reader *reader, struct string *line)
+  {
+    struct test_case {
+      struct string input;
+      u64 bufferLength;
+      u64 pieceLength;
+      struct string expected;
+      u32 lineNumber;
+      enum batch_test_error error;
+    } testCases[] = {
+        {
+            .input = StringFromLiteral(""),
+            .bufferLength = 16,
+            .pieceLength = 16,
+            .expected = StringFromLiteral(""),
+            .lineNumber = 0,
+            .error = BATCH_TEST_ERROR_LINES,
+        },
+        {
+            .input = StringFromLiteral("d_oVysaqG_0\nnAQyQ3hjEDI\n"),
+            .bufferLength = 16,
+            .pieceLength = 16,
+            .expected = StringFromLiteral("d_oVysaqG_0,nAQyQ3hjEDI"),
+            .lineNumber = 2,
+            .error = BATCH_TEST_ERROR_LINES,
+        },
+        // last line without newline, pieces split lines anywhere
+        {
+            .input = StringFromLiteral("a\n\n# comment\n  b \r\nlast"),
+            .bufferLength = 16,
+            .pieceLength = 3,
+            .expected = StringFromLiteral("a,b,last"),
+            .lineNumber = 5,
+            .error = BATCH_TEST_ERROR_LINES,
+        },
+        // line fills buffer many times, rest of it is not another line
+        {
+            .input = StringFromLiteral("short\nmuch_longer_than_buffer\nok\n"),
+            .bufferLength = 8,
+            .pieceLength = 8,
+            .expected = StringFromLiteral("short,!,ok"),
+            .lineNumber = 3,
+            .error = BATCH_TEST_ERROR_TOO_LONG,
+        },
+        {
+            .input = StringFromLiteral("much_longer_than_buffer"),
+            .bufferLength = 8,
+            .pieceLength = 5,
+            .expected = StringFromLiteral("!"),
+            .lineNumber = 1,
+            .error = BATCH_TEST_ERROR_TOO_LONG,
+        },
+    };
+
+    for (u32 testCaseIndex = 0; testCaseIndex < ARRAY_COUNT(testCases); testCaseIndex++) {
+      struct test_case *testCase = testCases + testCaseIndex;
+      memory_temp tempMemory = MemoryTempBegin(&stackMemory);
+      struct string *buffer = MakeString(tempMemory.arena, testCase->bufferLength);
+      u32 lineNumber;
+      struct string got = ReadBatch(lines, buffer, &testCase->input, testCase->pieceLength, &lineNumber);
+      MemoryTempEnd(&tempMemory);
+
+      if (!IsStringEqual(&got, &testCase->expected)) {
+        errorCode = testCase->error;
+        PrintBatchError(sb, errorCode, &testCase->expected, &got);
+      } else if (lineNumber != testCase->lineNumber) {
+        errorCode = BATCH_TEST_ERROR_LINE_NUMBER;
+        StringBuilderAppendTestError(sb, errorCode);
+        StringBuilderAppendStringLiteral(sb, "\n  expected: ");
+        StringBuilderAppendU64(sb, testCase->lineNumber);
+        StringBuilderAppendStringLiteral(sb, "\n       got: ");
+        StringBuilderAppendU64(sb, lineNumber);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+      }
+    }
+  }
+
+  return (int)errorCode;
+}
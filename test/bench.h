@@ -0,0 +1,99 @@
+#pragma once
+
+/*
+ * Helpers shared by benchmarks.
+ *
+ * Every metric is printed as one machine readable line:
+ *
+ *   bench <name> <metric> <value>
+ *
+ * where name and metric have no spaces and value is an unsigned integer.
+ * Other lines are for humans and ignored by tools.
+ *
+ * Output of a previous run can be given back with --baseline=path, then every
+ * metric is followed by a line that shows how much it changed.
+ *
+ * @code
+ *   ./http_parser_bench test/data > before.txt
+ *   # apply changes and rebuild
+ *   ./http_parser_bench test/data --baseline=before.txt
+ * @endcode
+ */
+
+#include "platform.h"
+#include "string_builder.h"
+#include "string_cursor.h"
+#include "text.h"
+
+struct bench {
+  struct string_builder *sb;
+  // machine readable output of previous run, can be null
+  struct string baseline;
+};
+
+internalfn b8
+BenchBaselineFind(struct string *baseline, struct string *name, struct string *metric, u64 *value)
+{
+  struct string *prefix = &StringFromLiteral("bench ");
+  struct string *SP = &StringFromLiteral(" ");
+  struct string *LF = &StringFromLiteral("\n");
+
+  struct string_cursor cursor = StringCursorFromString(baseline);
+  while (!IsStringCursorAtEnd(&cursor)) {
+    struct string line = StringCursorConsumeUntilOrRest(&cursor, LF);
+    StringCursorConsumeSubstring(&cursor, LF->length);
+
+    struct string_cursor lineCursor = StringCursorFromString(&line);
+    if (!IsStringCursorStartsWith(&lineCursor, prefix))
+      continue;
+
+    struct string lineName = StringCursorConsumeUntil(&lineCursor, SP);
+    if (!IsStringEqual(&lineName, name))
+      continue;
+    StringCursorConsumeSubstring(&lineCursor, SP->length);
+
+    struct string lineMetric = StringCursorConsumeUntil(&lineCursor, SP);
+    if (!IsStringEqual(&lineMetric, metric))
+      continue;
+    StringCursorConsumeSubstring(&lineCursor, SP->length);
+
+    struct string lineValue = StringCursorExtractRemaining(&lineCursor);
+    return ParseU64(&lineValue, value);
+  }
+
+  return 0;
+}
+
+internalfn void
+BenchReport(struct bench *bench, struct string *name, struct string *metric, u64 value)
+{
+  struct string_builder *sb = bench->sb;
+
+  StringBuilderAppendStringLiteral(sb, "bench ");
+  StringBuilderAppendString(sb, name);
+  StringBuilderAppendStringLiteral(sb, " ");
+  StringBuilderAppendString(sb, metric);
+  StringBuilderAppendStringLiteral(sb, " ");
+  StringBuilderAppendU64(sb, value);
+  StringBuilderAppendStringLiteral(sb, "\n");
+
+  u64 baselineValue = 0;
+  if (!IsStringNull(&bench->baseline) && BenchBaselineFind(&bench->baseline, name, metric, &baselineValue) &&
+      baselineValue != 0) {
+    f32 change = ((f32)value - (f32)baselineValue) / (f32)baselineValue * 100.0f;
+    StringBuilderAppendStringLiteral(sb, "  baseline ");
+    StringBuilderAppendU64(sb, baselineValue);
+    StringBuilderAppendStringLiteral(sb, " change ");
+    if (change < 0) {
+      StringBuilderAppendStringLiteral(sb, "-");
+      change = -change;
+    } else {
+      StringBuilderAppendStringLiteral(sb, "+");
+    }
+    StringBuilderAppendF32(sb, change, 2);
+    StringBuilderAppendStringLiteral(sb, "%\n");
+  }
+
+  struct string message = StringBuilderFlush(sb);
+  PrintString(&message);
+}
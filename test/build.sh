@@ -52,6 +52,54 @@ lib=""
 "$cc" $cflags $ldflags $inc -o "$output" $src $lib
 RunTest "$output" "TEST http request failed."
 
+### http_pipeline
+inc="-I$ProjectRoot/include -I$ProjectRoot/src"
+src="$pwd/http_pipeline_test.c"
+output="$outputDir/$(BasenameWithoutExtension "$src")"
+lib=""
+"$cc" $cflags $ldflags $inc -o "$output" $src $lib
+RunTest "$output" "TEST http pipeline failed."
+
+### ca_store
+inc="-I$ProjectRoot/include -I$ProjectRoot/src"
+src="$pwd/ca_store_test.c"
+output="$outputDir/$(BasenameWithoutExtension "$src")"
+lib=""
+"$cc" $cflags $ldflags $inc -o "$output" $src $lib
+RunTest "$output" "TEST ca store failed."
+
+### dns
+inc="-I$ProjectRoot/include -I$ProjectRoot/src"
+src="$pwd/dns_test.c"
+output="$outputDir/$(BasenameWithoutExtension "$src")"
+lib=""
+"$cc" $cflags $ldflags $inc -o "$output" $src $lib
+RunTest "$output" "TEST dns failed."
+
+### instance_list
+inc="-I$ProjectRoot/include -I$ProjectRoot/src"
+src="$pwd/instance_list_test.c"
+output="$outputDir/$(BasenameWithoutExtension "$src")"
+lib=""
+"$cc" $cflags $ldflags $inc -o "$output" $src $lib
+RunTest "$output" "TEST instance list failed."
+
+### deflate
+inc="-I$ProjectRoot/include -I$ProjectRoot/src"
+src="$pwd/deflate_test.c"
+output="$outputDir/$(BasenameWithoutExtension "$src")"
+lib=""
+"$cc" $cflags $ldflags $inc -o "$output" $src $lib
+RunTest "$output" "TEST deflate failed."
+
+### http2
+inc="-I$ProjectRoot/include -I$ProjectRoot/src"
+src="$pwd/http2_test.c"
+output="$outputDir/$(BasenameWithoutExtension "$src")"
+lib=""
+"$cc" $cflags $ldflags $inc -o "$output" $src $lib
+RunTest "$output" "TEST http2 failed."
+
 ### options
 inc="-I$ProjectRoot/include -I$ProjectRoot/src"
 src="$pwd/options_test.c"
@@ -60,6 +108,62 @@ lib=""
 "$cc" $cflags $ldflags $inc -o "$output" $src $lib
 RunTest "$output" "TEST options failed."
 
+### receive_buffer
+inc="-I$ProjectRoot/include -I$ProjectRoot/src"
+src="$pwd/receive_buffer_test.c"
+output="$outputDir/$(BasenameWithoutExtension "$src")"
+lib=""
+"$cc" $cflags $ldflags $inc -o "$output" $src $lib
+RunTest "$output" "TEST receive buffer failed."
+
+### ring_buffer
+inc="-I$ProjectRoot/include -I$ProjectRoot/src"
+src="$pwd/ring_buffer_test.c"
+output="$outputDir/$(BasenameWithoutExtension "$src")"
+lib=""
+"$cc" $cflags $ldflags $inc -o "$output" $src $lib
+RunTest "$output" "TEST ring buffer failed."
+
+### request_timing
+inc="-I$ProjectRoot/include -I$ProjectRoot/src"
+src="$pwd/request_timing_test.c"
+output="$outputDir/$(BasenameWithoutExtension "$src")"
+lib=""
+"$cc" $cflags $ldflags $inc -o "$output" $src $lib
+RunTest "$output" "TEST request timing failed."
+
+### batch
+inc="-I$ProjectRoot/include -I$ProjectRoot/src"
+src="$pwd/batch_test.c"
+output="$outputDir/$(BasenameWithoutExtension "$src")"
+lib=""
+"$cc" $cflags $ldflags $inc -o "$output" $src $lib
+RunTest "$output" "TEST batch failed."
+
+### concurrency_limit
+inc="-I$ProjectRoot/include -I$ProjectRoot/src"
+src="$pwd/concurrency_limit_test.c"
+output="$outputDir/$(BasenameWithoutExtension "$src")"
+lib=""
+"$cc" $cflags $ldflags $inc -o "$output" $src $lib
+RunTest "$output" "TEST concurrency limit failed."
+
+### hedge
+inc="-I$ProjectRoot/include -I$ProjectRoot/src"
+src="$pwd/hedge_test.c"
+output="$outputDir/$(BasenameWithoutExtension "$src")"
+lib=""
+"$cc" $cflags $ldflags $inc -o "$output" $src $lib
+RunTest "$output" "TEST hedge failed."
+
+### video_table
+inc="-I$ProjectRoot/include -I$ProjectRoot/src"
+src="$pwd/video_table_test.c"
+output="$outputDir/$(BasenameWithoutExtension "$src")"
+lib=""
+"$cc" $cflags $ldflags $inc -o "$output" $src $lib
+RunTest "$output" "TEST video table failed."
+
 if [ $failedTestCount -ne 0 ]; then
   echo $failedTestCount tests failed.
   exit 1
@@ -77,4 +181,59 @@ if [ $IsBenchmarksEnabled -eq '1' ]; then
   #"$cc" $cflags -O2 -g -fno-inline $inc -o "$output" $src $lib
   #"$cc" $cflags -O2 $inc -o "$output" $src $lib
   "$cc" $cflags $inc -o "$output" $src $lib
+
+  inc="-I$ProjectRoot/include -I$ProjectRoot/src"
+  src="$pwd/http_parser_bench.c"
+  output="$outputDir/$(BasenameWithoutExtension "$src")"
+  lib="$LIB_M"
+  "$cc" $cflags $inc -o "$output" $src $lib
+
+  inc="-I$ProjectRoot/include -I$ProjectRoot/src"
+  src="$pwd/percent_encoding_bench.c"
+  output="$outputDir/$(BasenameWithoutExtension "$src")"
+  lib="$LIB_M"
+  "$cc" $cflags $inc -o "$output" $src $lib
+
+  inc="-I$ProjectRoot/include -I$ProjectRoot/src"
+  src="$pwd/transport_bench.c"
+  output="$outputDir/$(BasenameWithoutExtension "$src")"
+  lib="$LIB_M"
+  "$cc" $cflags $inc -o "$output" $src $lib
+
+  inc="-I$ProjectRoot/include -I$ProjectRoot/src"
+  src="$pwd/invidious_server.c"
+  output="$outputDir/$(BasenameWithoutExtension "$src")"
+  lib="$LIB_M"
+  "$cc" $cflags $inc -o "$output" $src $lib
+
+  # runs built client, see its header
+  inc="-I$ProjectRoot/include -I$ProjectRoot/src"
+  src="$pwd/end_to_end_bench.c"
+  output="$outputDir/$(BasenameWithoutExtension "$src")"
+  lib="$LIB_M"
+  "$cc" $cflags $inc -o "$output" $src $lib
+
+  # needs TLS library, it is set up when program is built
+  if [ -n "$LIB_MBEDTLS$LIB_WOLFSSL" ]; then
+    inc="-I$ProjectRoot/include -I$ProjectRoot/src $INC_MBEDTLS $INC_WOLFSSL"
+    src="$pwd/reactor_bench.c"
+    output="$outputDir/$(BasenameWithoutExtension "$src")"
+    lib="$LIB_MBEDTLS $LIB_WOLFSSL $LIB_M"
+    "$cc" $cflags $inc -o "$output" $src $lib
+
+    src="$pwd/tls_session_bench.c"
+    output="$outputDir/$(BasenameWithoutExtension "$src")"
+    lib="$LIB_MBEDTLS $LIB_WOLFSSL $LIB_M"
+    "$cc" $cflags $inc -o "$output" $src $lib
+
+    src="$pwd/tls_backend_bench.c"
+    output="$outputDir/$(BasenameWithoutExtension "$src")"
+    lib="$LIB_MBEDTLS $LIB_WOLFSSL $LIB_M"
+    "$cc" $cflags $inc -o "$output" $src $lib
+
+    src="$pwd/kernel_tls_bench.c"
+    output="$outputDir/$(BasenameWithoutExtension "$src")"
+    lib="$LIB_MBEDTLS $LIB_WOLFSSL $LIB_M"
+    "$cc" $cflags $inc -o "$output" $src $lib
+  fi
 fi
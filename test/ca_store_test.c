@@ -0,0 +1,400 @@
+#include "ca_store.c"
+#include "print.h"
+#include "string_builder.h"
+
+#define TEST_ERROR_LIST(X)                                                                                             \
+  X(CERTIFICATE_NAMES, "Issuer and subject must be found in certificate")                                              \
+  X(STORE_BUILD, "Store must have every certificate in bundle")                                                        \
+  X(STORE_FIND, "Store must find every certificate with subject")                                                      \
+  X(STORE_STALE, "Store must not open when bundle changed or content is damaged")
+
+enum ca_store_test_error {
+  CA_STORE_TEST_ERROR_NONE = 0,
+#define X(tag, message) CA_STORE_TEST_ERROR_##tag,
+  TEST_ERROR_LIST(X)
+#undef X
+
+  // src: https://mesonbuild.com/Unit-tests.html#skipped-tests-and-hard-errors
+  // For the default exitcode testing protocol, the GNU standard approach in
+  // this case is to exit the program with error code 77. Meson will detect this
+  // and report these tests as skipped rather than failed. This behavior was
+  // added in version 0.37.0.
+  MESON_TEST_SKIP = 77,
+  // In addition, sometimes a test fails set up so that it should fail even if
+  // it is marked as an expected failure. The GNU standard approach in this case
+  // is to exit the program with error code 99. Again, Meson will detect this
+  // and report these tests as ERROR, ignoring the setting of should_fail. This
+  // behavior was added in version 0.50.0.
+  MESON_TEST_FAILED_TO_SET_UP = 99,
+};
+
+internalfn void
+StringBuilderAppendTestError(struct string_builder *sb, enum ca_store_test_error errorCode)
+{
+  struct string message = StringFromLiteral("Unknown error");
+  struct error {
+    enum ca_store_test_error code;
+    struct string message;
+  } errors[] = {
+#define XX(tag, msg) {.code = CA_STORE_TEST_ERROR_##tag, .message = StringFromLiteral(msg)},
+      TEST_ERROR_LIST(XX)
+#undef XX
+  };
+
+  for (u32 errorIndex = 0; errorIndex < ARRAY_COUNT(errors); errorIndex++) {
+    struct error *error = errors + errorIndex;
+    if (error->code != errorCode)
+      continue;
+
+    message = error->message;
+    break;
+  }
+
+  StringBuilderAppendString(sb, &message);
+}
+
+// openssl req -x509 -newkey ec -pkeyopt ec_paramgen_curve:P-256 -days 36500 -subj "/CN=Test Root A/O=Invidious"
+#define ROOT_A_PEM \
+  "-----BEGIN CERTIFICATE-----\n" \
+  "MIIBqzCCAVGgAwIBAgIULv8HWGJQin7221seesHy8wsXXp8wCgYIKoZIzj0EAwIw\n" \
+  "KjEUMBIGA1UEAwwLVGVzdCBSb290IEExEjAQBgNVBAoMCUludmlkaW91czAgFw0y\n" \
+  "NjEwMTgxMjQ4MzBaGA8yMTI2MDkyNDEyNDgzMFowKjEUMBIGA1UEAwwLVGVzdCBS\n" \
+  "b290IEExEjAQBgNVBAoMCUludmlkaW91czBZMBMGByqGSM49AgEGCCqGSM49AwEH\n" \
+  "A0IABC4yNYsmtGImBTX1Es9wD1/HFoRsiQNUu0xjRA0jzgtB1lzBvDV/FslGfEqa\n" \
+  "ROzTmaRf2moIGzK90yNzYQFdfCmjUzBRMB0GA1UdDgQWBBT02lULUr1h1beqxuG2\n" \
+  "718CA0tsUjAfBgNVHSMEGDAWgBT02lULUr1h1beqxuG2718CA0tsUjAPBgNVHRMB\n" \
+  "Af8EBTADAQH/MAoGCCqGSM49BAMCA0gAMEUCIQCVlH0Kx5NA6X5BJkhfgT9TyL/Q\n" \
+  "gH1XuvISZ7Fr9gov6wIgSRsHiTS2Zg3Zg1OrQwYSDRDVz37neAgfov5FhQEQnOg=\n" \
+  "-----END CERTIFICATE-----\n"
+
+// same with "/CN=Test Root B/O=Invidious"
+#define ROOT_B_PEM \
+  "-----BEGIN CERTIFICATE-----\n" \
+  "MIIBqjCCAVGgAwIBAgIUMdmWq+VaA0TSOoCCpcYmzh8cnv4wCgYIKoZIzj0EAwIw\n" \
+  "KjEUMBIGA1UEAwwLVGVzdCBSb290IEIxEjAQBgNVBAoMCUludmlkaW91czAgFw0y\n" \
+  "NjEwMTgxMjQ4MzBaGA8yMTI2MDkyNDEyNDgzMFowKjEUMBIGA1UEAwwLVGVzdCBS\n" \
+  "b290IEIxEjAQBgNVBAoMCUludmlkaW91czBZMBMGByqGSM49AgEGCCqGSM49AwEH\n" \
+  "A0IABDI/3+veSh82vbVAg/sx2yW2TA6s/87vsj2mu3KPwWXd3n6bzMvfCZe8/Ut/\n" \
+  "vWe2hOVydloLVIE0gpMv5udrZUajUzBRMB0GA1UdDgQWBBSEjMeSb/oWfTzieorf\n" \
+  "fmPq8IFO0jAfBgNVHSMEGDAWgBSEjMeSb/oWfTzieorffmPq8IFO0jAPBgNVHRMB\n" \
+  "Af8EBTADAQH/MAoGCCqGSM49BAMCA0cAMEQCIDMNIHGsUB7Ov6e1634UkvkS7HtB\n" \
+  "eMhulF5qVvrnb1NNAiA0F2yR2G2/uI4CmlSXw6D7AFNsYrXPEJgc3rKviBLdfw==\n" \
+  "-----END CERTIFICATE-----\n"
+
+// version 1 certificate, without extensions, "/CN=localhost" signed by root A
+#define LEAF_PEM \
+  "-----BEGIN CERTIFICATE-----\n" \
+  "MIIBOzCB4QIUdhxJdeFwy1g8vk7/1auW1UGbFH4wCgYIKoZIzj0EAwIwKjEUMBIG\n" \
+  "A1UEAwwLVGVzdCBSb290IEExEjAQBgNVBAoMCUludmlkaW91czAgFw0yNjEwMTgx\n" \
+  "MjQ4MzBaGA8yMTI2MDkyNDEyNDgzMFowFDESMBAGA1UEAwwJbG9jYWxob3N0MFkw\n" \
+  "EwYHKoZIzj0CAQYIKoZIzj0DAQcDQgAEIfbrC0acNjEO74J1sbt1Fh9hT9evhzbX\n" \
+  "IReWghzc8epgZ+g8oK9p6pH0xlHU9rUgflAxHA0gyxp4dIIW7t8f7TAKBggqhkjO\n" \
+  "PQQDAgNJADBGAiEAmy02ogWxIMA+3UFOdYNWsmNBxxMZqhmA+b7FQhFPOeYCIQCX\n" \
+  "IR+0FX4q7Wd/15+9Ba2zIzPj95F9YXkzQ3b1p/vpyw==\n" \
+  "-----END CERTIFICATE-----\n"
+
+/*
+ * @return DER of first certificate in PEM
+ */
+internalfn struct string
+DecodePem(memory_arena *arena, struct string *pem)
+{
+  struct string_cursor cursor = StringCursorFromString(pem);
+  if (!StringCursorAdvanceAfter(&cursor, &StringFromLiteral("-----BEGIN CERTIFICATE-----")))
+    return StringNull();
+  struct string base64 = StringCursorConsumeUntil(&cursor, &StringFromLiteral("-----END CERTIFICATE-----"));
+  if (IsStringNull(&base64))
+    return StringNull();
+
+  u8 *der = MemoryArenaPush(arena, base64.length);
+  return StringFromBuffer(der, CaStoreDecodeBase64(der, &base64));
+}
+
+int
+main(void)
+{
+  enum ca_store_test_error errorCode = CA_STORE_TEST_ERROR_NONE;
+
+  // setup
+  enum {
+    KILOBYTES = (1 << 10),
+    MEGABYTES = (1 << 20),
+  };
+  u8 stackBuffer[1 * MEGABYTES];
+  memory_arena stackMemory = {
+      .block = stackBuffer,
+      .total = ARRAY_COUNT(stackBuffer),
+  };
+
+  string_builder *sb = MakeStringBuilder(&stackMemory, 128 * KILOBYTES, 32);
+
+  struct string rootAPem = StringFromLiteral(ROOT_A_PEM);
+  struct string rootBPem = StringFromLiteral(ROOT_B_PEM);
+  struct string leafPem = StringFromLiteral(LEAF_PEM);
+  struct string rootA = DecodePem(&stackMemory, &rootAPem);
+  struct string rootB = DecodePem(&stackMemory, &rootBPem);
+  struct string leaf = DecodePem(&stackMemory, &leafPem);
+  if (IsStringNullOrEmpty(&rootA) || IsStringNullOrEmpty(&rootB) || IsStringNullOrEmpty(&leaf))
+    return MESON_TEST_FAILED_TO_SET_UP;
+
+  // see: openssl asn1parse -i
+  struct string rootASubject = StringFromBuffer(
+      (u8[]){
+          0x30, 0x2a, 0x31, 0x14, 0x30, 0x12, 0x06, 0x03, 0x55, 0x04, 0x03, 0x0c, 0x0b, 0x54, 0x65,
+          0x73, 0x74, 0x20, 0x52, 0x6f, 0x6f, 0x74, 0x20, 0x41, 0x31, 0x12, 0x30, 0x10, 0x06, 0x03,
+          0x55, 0x04, 0x0a, 0x0c, 0x09, 0x49, 0x6e, 0x76, 0x69, 0x64, 0x69, 0x6f, 0x75, 0x73,
+      },
+      44);
+  struct string leafSubject = StringFromBuffer(
+      (u8[]){
+          0x30, 0x14, 0x31, 0x12, 0x30, 0x10, 0x06, 0x03, 0x55, 0x04, 0x03,
+          0x0c, 0x09, 0x6c, 0x6f, 0x63, 0x61, 0x6c, 0x68, 0x6f, 0x73, 0x74,
+      },
+      22);
+
+  // b8 CaStoreCertificateNames(struct string *der, struct string *issuer, struct string *subject)
+  {
+    struct test_case {
+      struct string *der;
+      struct string *expectedIssuer;
+      struct string *expectedSubject;
+    } testCases[] = {
+        {
+            // self signed
+            .der = &rootA,
+            .expectedIssuer = &rootASubject,
+            .expectedSubject = &rootASubject,
+        },
+        {
+            // no version, it defaults to 1
+            .der = &leaf,
+            .expectedIssuer = &rootASubject,
+            .expectedSubject = &leafSubject,
+        },
+    };
+
+    for (u32 testCaseIndex = 0; testCaseIndex < ARRAY_COUNT(testCases); testCaseIndex++) {
+      struct test_case *testCase = testCases + testCaseIndex;
+      struct string issuer = StringNull();
+      struct string subject = StringNull();
+      b8 isCertificate = CaStoreCertificateNames(testCase->der, &issuer, &subject);
+      if (!isCertificate || !IsStringEqual(&issuer, testCase->expectedIssuer) ||
+          !IsStringEqual(&subject, testCase->expectedSubject)) {
+        errorCode = CA_STORE_TEST_ERROR_CERTIFICATE_NAMES;
+        StringBuilderAppendTestError(sb, errorCode);
+        StringBuilderAppendStringLiteral(sb, "\n  expected issuer:\n");
+        StringBuilderAppendHexDump(sb, testCase->expectedIssuer);
+        StringBuilderAppendStringLiteral(sb, "\n       got issuer:\n");
+        StringBuilderAppendHexDump(sb, &issuer);
+        StringBuilderAppendStringLiteral(sb, "\n  expected subject:\n");
+        StringBuilderAppendHexDump(sb, testCase->expectedSubject);
+        StringBuilderAppendStringLiteral(sb, "\n       got subject:\n");
+        StringBuilderAppendHexDump(sb, &subject);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+      }
+    }
+
+    // truncated
+    struct string issuer;
+    struct string subject;
+    struct string truncated = StringSlice(&rootA, 0, rootA.length - 1);
+    if (CaStoreCertificateNames(&truncated, &issuer, &subject)) {
+      errorCode = CA_STORE_TEST_ERROR_CERTIFICATE_NAMES;
+      StringBuilderAppendTestError(sb, errorCode);
+      StringBuilderAppendStringLiteral(sb, "\n  truncated certificate must not have names\n");
+      struct string errorMessage = StringBuilderFlush(sb);
+      PrintString(&errorMessage);
+    }
+  }
+
+  // root A twice, like renewed root with same subject, and block that is not base64
+  struct string bundle = StringFromLiteral("# Test bundle\n" ROOT_A_PEM "\n"
+                                           "-----BEGIN CERTIFICATE-----\n"
+                                           "not base64\n"
+                                           "-----END CERTIFICATE-----\n" ROOT_B_PEM LEAF_PEM ROOT_A_PEM);
+  comptime u64 bundleModifiedAt = 1760791710123456789;
+  struct string buffer = {
+      .value = MemoryArenaPush(&stackMemory, CaStoreLengthMax(bundle.length)),
+      .length = CaStoreLengthMax(bundle.length),
+  };
+
+  // struct string CaStoreBuild(struct string *buffer, struct string *bundle, u64 bundleSize, u64 bundleModifiedAt)
+  // b8 CaStoreOpen(struct ca_store *store, struct string *content, u64 bundleSize, u64 bundleModifiedAt)
+  struct string content = CaStoreBuild(&buffer, &bundle, bundle.length, bundleModifiedAt);
+  struct ca_store store = {};
+  if (IsStringNull(&content) || !CaStoreOpen(&store, &content, bundle.length, bundleModifiedAt) ||
+      store.certificateCount != 4) {
+    errorCode = CA_STORE_TEST_ERROR_STORE_BUILD;
+    StringBuilderAppendTestError(sb, errorCode);
+    StringBuilderAppendStringLiteral(sb, "\n  expected certificates: 4");
+    StringBuilderAppendStringLiteral(sb, "\n       got certificates: ");
+    StringBuilderAppendU64(sb, store.certificateCount);
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string errorMessage = StringBuilderFlush(sb);
+    PrintString(&errorMessage);
+    return (int)errorCode;
+  }
+
+  // s32 CaStoreFind(struct ca_store *store, struct string *subject)
+  // s32 CaStoreNext(struct ca_store *store, s32 index, struct string *subject)
+  {
+    u8 unknownSubjectBuffer[44];
+    MemoryCopy(unknownSubjectBuffer, rootASubject.value, rootASubject.length);
+    unknownSubjectBuffer[23] = 'C'; // Test Root C
+    struct string unknownSubject = StringFromBuffer(unknownSubjectBuffer, sizeof(unknownSubjectBuffer));
+    struct string rootBSubject;
+    struct string rootBIssuer;
+    if (!CaStoreCertificateNames(&rootB, &rootBIssuer, &rootBSubject))
+      return MESON_TEST_FAILED_TO_SET_UP;
+
+    struct test_case {
+      struct string *subject;
+      u32 expectedCount;
+      struct string *expected;
+    } testCases[] = {
+        {
+            .subject = &rootASubject,
+            .expectedCount = 2,
+            .expected = &rootA,
+        },
+        {
+            .subject = &rootBSubject,
+            .expectedCount = 1,
+            .expected = &rootB,
+        },
+        {
+            .subject = &leafSubject,
+            .expectedCount = 1,
+            .expected = &leaf,
+        },
+        {
+            .subject = &unknownSubject,
+            .expectedCount = 0,
+        },
+    };
+
+    for (u32 testCaseIndex = 0; testCaseIndex < ARRAY_COUNT(testCases); testCaseIndex++) {
+      struct test_case *testCase = testCases + testCaseIndex;
+      u32 count = 0;
+      b8 isEqual = 1;
+      for (s32 index = CaStoreFind(&store, testCase->subject); index != -1;
+           index = CaStoreNext(&store, index, testCase->subject)) {
+        struct string certificate = CaStoreCertificate(&store, (u32)index);
+        if (!testCase->expected || !IsStringEqual(&certificate, testCase->expected))
+          isEqual = 0;
+        count++;
+      }
+
+      if (count != testCase->expectedCount || !isEqual) {
+        errorCode = CA_STORE_TEST_ERROR_STORE_FIND;
+        StringBuilderAppendTestError(sb, errorCode);
+        StringBuilderAppendStringLiteral(sb, "\n  subject:\n");
+        StringBuilderAppendHexDump(sb, testCase->subject);
+        StringBuilderAppendStringLiteral(sb, "\n  expected: ");
+        StringBuilderAppendU64(sb, testCase->expectedCount);
+        StringBuilderAppendStringLiteral(sb, " certificates");
+        StringBuilderAppendStringLiteral(sb, "\n       got: ");
+        StringBuilderAppendU64(sb, count);
+        StringBuilderAppendStringLiteral(sb, " certificates");
+        if (!isEqual)
+          StringBuilderAppendStringLiteral(sb, ", not all expected one");
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+      }
+    }
+  }
+
+  {
+    struct test_case {
+      char *name;
+      u64 bundleSize;
+      u64 bundleModifiedAt;
+      // byte that is changed, length means none
+      u64 changeIndex;
+      u64 length;
+    } testCases[] = {
+        {
+            .name = "bundle size changed",
+            .bundleSize = bundle.length + 1,
+            .bundleModifiedAt = bundleModifiedAt,
+            .changeIndex = content.length,
+            .length = content.length,
+        },
+        {
+            .name = "bundle modified",
+            .bundleSize = bundle.length,
+            .bundleModifiedAt = bundleModifiedAt + 1,
+            .changeIndex = content.length,
+            .length = content.length,
+        },
+        {
+            .name = "truncated",
+            .bundleSize = bundle.length,
+            .bundleModifiedAt = bundleModifiedAt,
+            .changeIndex = content.length - 1,
+            .length = content.length - 1,
+        },
+        {
+            .name = "magic",
+            .bundleSize = bundle.length,
+            .bundleModifiedAt = bundleModifiedAt,
+            .changeIndex = 0,
+            .length = content.length,
+        },
+        {
+            .name = "version",
+            .bundleSize = bundle.length,
+            .bundleModifiedAt = bundleModifiedAt,
+            .changeIndex = 4,
+            .length = content.length,
+        },
+        {
+            .name = "certificate count",
+            .bundleSize = bundle.length,
+            .bundleModifiedAt = bundleModifiedAt,
+            .changeIndex = 27,
+            .length = content.length,
+        },
+        {
+            // offset of first certificate
+            .name = "entry",
+            .bundleSize = bundle.length,
+            .bundleModifiedAt = bundleModifiedAt,
+            .changeIndex = CA_STORE_HEADER_LENGTH + 11,
+            .length = content.length,
+        },
+    };
+
+    for (u32 testCaseIndex = 0; testCaseIndex < ARRAY_COUNT(testCases); testCaseIndex++) {
+      memory_temp tempMemory = MemoryTempBegin(&stackMemory);
+      struct test_case *testCase = testCases + testCaseIndex;
+
+      struct string damaged = {
+          .value = MemoryArenaPush(tempMemory.arena, content.length),
+          .length = testCase->length,
+      };
+      MemoryCopy(damaged.value, content.value, content.length);
+      if (testCase->changeIndex < testCase->length)
+        damaged.value[testCase->changeIndex] ^= 0xff;
+
+      struct ca_store damagedStore;
+      if (CaStoreOpen(&damagedStore, &damaged, testCase->bundleSize, testCase->bundleModifiedAt)) {
+        errorCode = CA_STORE_TEST_ERROR_STORE_STALE;
+        StringBuilderAppendTestError(sb, errorCode);
+        StringBuilderAppendStringLiteral(sb, "\n  case: ");
+        struct string name = StringFromZeroTerminated((u8 *)testCase->name, 64);
+        StringBuilderAppendString(sb, &name);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+      }
+
+      MemoryTempEnd(&tempMemory);
+    }
+  }
+
+  return (int)errorCode;
+}
@@ -0,0 +1,176 @@
+#include "concurrency_limit.c"
+#include "print.h"
+#include "string_builder.h"
+
+#define TEST_ERROR_LIST(X)                                                                                             \
+  X(THROTTLE, "Throttle must halve limit once per latency, down to one")                                               \
+  X(GROWS, "Limit must grow back to maximum when responses are fast")                                                  \
+  X(BACKS_OFF, "Limit must decrease when responses get slower")
+
+enum concurrency_limit_test_error {
+  CONCURRENCY_LIMIT_TEST_ERROR_NONE = 0,
+#define X(tag, message) CONCURRENCY_LIMIT_TEST_ERROR_##tag,
+  TEST_ERROR_LIST(X)
+#undef X
+
+  // src: https://mesonbuild.com/Unit-tests.html#skipped-tests-and-hard-errors
+  // For the default exitcode testing protocol, the GNU standard approach in
+  // this case is to exit the program with error code 77. Meson will detect this
+  // and report these tests as skipped rather than failed. This behavior was
+  // added in version 0.37.0.
+  MESON_TEST_SKIP = 77,
+  // In addition, sometimes a test fails set up so that it should fail even if
+  // it is marked as an expected failure. The GNU standard approach in this case
+  // is to exit the program with error code 99. Again, Meson will detect this
+  // and report these tests as ERROR, ignoring the setting of should_fail. This
+  // behavior was added in version 0.50.0.
+  MESON_TEST_FAILED_TO_SET_UP = 99,
+};
+
+internalfn void
+StringBuilderAppendTestError(struct string_builder *sb, enum concurrency_limit_test_error errorCode)
+{
+  struct string message = StringFromLiteral("Unknown error");
+  struct error {
+    enum concurrency_limit_test_error code;
+    struct string message;
+  } errors[] = {
+#define XX(tag, msg) {.code = CONCURRENCY_LIMIT_TEST_ERROR_##tag, .message = StringFromLiteral(msg)},
+      TEST_ERROR_LIST(XX)
+#undef XX
+  };
+
+  for (u32 errorIndex = 0; errorIndex < ARRAY_COUNT(errors); errorIndex++) {
+    struct error *error = errors + errorIndex;
+    if (error->code != errorCode)
+      continue;
+
+    message = error->message;
+    break;
+  }
+
+  StringBuilderAppendString(sb, &message);
+}
+
+internalfn void
+PrintLimitError(string_builder *sb, enum concurrency_limit_test_error errorCode, u32 expected, u32 got)
+{
+  StringBuilderAppendTestError(sb, errorCode);
+  StringBuilderAppendStringLiteral(sb, "\n  expected: ");
+  StringBuilderAppendU64(sb, expected);
+  StringBuilderAppendStringLiteral(sb, "\n       got: ");
+  StringBuilderAppendU64(sb, got);
+  StringBuilderAppendStringLiteral(sb, "\n");
+  struct string errorMessage = StringBuilderFlush(sb);
+  PrintString(&errorMessage);
+}
+
+int
+main(void)
+{
+  enum concurrency_limit_test_error errorCode = CONCURRENCY_LIMIT_TEST_ERROR_NONE;
+
+  // setup
+  enum {
+    KILOBYTES = (1 << 10),
+  };
+  u8 stackBuffer[8 * KILOBYTES];
+  memory_arena stackMemory = {
+      .block = stackBuffer,
+      .total = ARRAY_COUNT(stackBuffer),
+  };
+
+  string_builder *sb = MakeStringBuilder(&stackMemory, 4 * KILOBYTES, 32);
+
+  comptime u64 MILLISECOND = 1000000;
+  comptime u32 LIMIT_MAX = 16;
+
+  // void ConcurrencyLimitThrottle(struct concurrency_limit *limit, u64 now)
+  {
+    struct concurrency_limit limit;
+    ConcurrencyLimitInit(&limit, LIMIT_MAX);
+    ConcurrencyLimitRecord(&limit, 10 * MILLISECOND, 10 * MILLISECOND);
+
+    struct test_case {
+      u64 now;
+      u32 expected;
+    } testCases[] = {
+        {.now = 20 * MILLISECOND, .expected = 8},
+        // refusals of requests sent before first one
+        {.now = 25 * MILLISECOND, .expected = 8},
+        {.now = 29 * MILLISECOND, .expected = 8},
+        {.now = 30 * MILLISECOND, .expected = 4},
+        {.now = 40 * MILLISECOND, .expected = 2},
+        {.now = 50 * MILLISECOND, .expected = 1},
+        {.now = 60 * MILLISECOND, .expected = 1},
+    };
+
+    for (u32 testCaseIndex = 0; testCaseIndex < ARRAY_COUNT(testCases); testCaseIndex++) {
+      struct test_case *testCase = testCases + testCaseIndex;
+      ConcurrencyLimitThrottle(&limit, testCase->now);
+      u32 got = ConcurrencyLimitGet(&limit);
+      if (got != testCase->expected) {
+        errorCode = CONCURRENCY_LIMIT_TEST_ERROR_THROTTLE;
+        PrintLimitError(sb, errorCode, testCase->expected, got);
+        break;
+      }
+    }
+  }
+
+  // void ConcurrencyLimitRecord(struct concurrency_limit *limit, u64 latency, u64 now)
+  {
+    struct concurrency_limit limit;
+    ConcurrencyLimitInit(&limit, LIMIT_MAX);
+    ConcurrencyLimitRecord(&limit, 10 * MILLISECOND, 10 * MILLISECOND);
+    ConcurrencyLimitThrottle(&limit, 20 * MILLISECOND);
+    ConcurrencyLimitThrottle(&limit, 30 * MILLISECOND);
+    ConcurrencyLimitThrottle(&limit, 40 * MILLISECOND);
+    ConcurrencyLimitThrottle(&limit, 50 * MILLISECOND);
+
+    // by one after limit many responses: 1 + 2 + ... + 15
+    u64 now = 50 * MILLISECOND;
+    u32 responseCount = 0;
+    while (ConcurrencyLimitGet(&limit) < LIMIT_MAX && responseCount < 1000) {
+      now += MILLISECOND;
+      ConcurrencyLimitRecord(&limit, 10 * MILLISECOND, now);
+      responseCount++;
+    }
+
+    for (u32 index = 0; index < 100; index++) {
+      now += MILLISECOND;
+      ConcurrencyLimitRecord(&limit, 10 * MILLISECOND, now);
+    }
+
+    u32 got = ConcurrencyLimitGet(&limit);
+    if (got != LIMIT_MAX || responseCount < 120 || responseCount > 160) {
+      errorCode = CONCURRENCY_LIMIT_TEST_ERROR_GROWS;
+      PrintLimitError(sb, errorCode, 120, responseCount);
+    }
+
+    // server starts queueing requests, responses are ten times slower
+    for (u32 index = 0; index < 100; index++) {
+      now += 10 * MILLISECOND;
+      ConcurrencyLimitRecord(&limit, 100 * MILLISECOND, now);
+    }
+
+    got = ConcurrencyLimitGet(&limit);
+    if (got >= LIMIT_MAX / 2 || got < 2) {
+      errorCode = CONCURRENCY_LIMIT_TEST_ERROR_BACKS_OFF;
+      PrintLimitError(sb, errorCode, LIMIT_MAX / 2, got);
+    }
+
+    // server is idle again
+    for (u32 index = 0; index < 1000; index++) {
+      now += MILLISECOND;
+      ConcurrencyLimitRecord(&limit, 10 * MILLISECOND, now);
+    }
+
+    got = ConcurrencyLimitGet(&limit);
+    if (got != LIMIT_MAX) {
+      errorCode = CONCURRENCY_LIMIT_TEST_ERROR_GROWS;
+      PrintLimitError(sb, errorCode, LIMIT_MAX, got);
+    }
+  }
+
+  return (int)errorCode;
+}
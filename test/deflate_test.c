@@ -0,0 +1,389 @@
+#include "deflate.c"
+#include "print.h"
+#include "string_builder.h"
+
+#define TEST_ERROR_LIST(X)                                                                                             \
+  X(CRC32, "CRC-32 must match check value")                                                                            \
+  X(GZIP_COMPRESS, "Input must be compressed")                                                                         \
+  X(GZIP_HEADER, "Gzip member must have valid header and trailer")                                                     \
+  X(INFLATE, "Compressed must inflate back to input")                                                                  \
+  X(RATIO, "Repetitive input must compress")
+
+enum deflate_test_error {
+  DEFLATE_TEST_ERROR_NONE = 0,
+#define X(tag, message) DEFLATE_TEST_ERROR_##tag,
+  TEST_ERROR_LIST(X)
+#undef X
+
+  // src: https://mesonbuild.com/Unit-tests.html#skipped-tests-and-hard-errors
+  // For the default exitcode testing protocol, the GNU standard approach in
+  // this case is to exit the program with error code 77. Meson will detect this
+  // and report these tests as skipped rather than failed. This behavior was
+  // added in version 0.37.0.
+  MESON_TEST_SKIP = 77,
+  // In addition, sometimes a test fails set up so that it should fail even if
+  // it is marked as an expected failure. The GNU standard approach in this case
+  // is to exit the program with error code 99. Again, Meson will detect this
+  // and report these tests as ERROR, ignoring the setting of should_fail. This
+  // behavior was added in version 0.50.0.
+  MESON_TEST_FAILED_TO_SET_UP = 99,
+};
+
+internalfn void
+StringBuilderAppendTestError(struct string_builder *sb, enum deflate_test_error errorCode)
+{
+  struct string message = StringFromLiteral("Unknown error");
+  struct error {
+    enum deflate_test_error code;
+    struct string message;
+  } errors[] = {
+#define XX(tag, msg) {.code = DEFLATE_TEST_ERROR_##tag, .message = StringFromLiteral(msg)},
+      TEST_ERROR_LIST(XX)
+#undef XX
+  };
+
+  for (u32 errorIndex = 0; errorIndex < ARRAY_COUNT(errors); errorIndex++) {
+    struct error *error = errors + errorIndex;
+    if (error->code != errorCode)
+      continue;
+
+    message = error->message;
+    break;
+  }
+
+  StringBuilderAppendString(sb, &message);
+}
+
+/*
+ * Minimal inflate, only for blocks encoder writes: stored and fixed Huffman.
+ */
+struct inflate_reader {
+  struct string *input;
+  u64 position;
+  u32 bits;
+  u32 bitCount;
+  b8 isOverrun;
+};
+
+internalfn u32
+InflateReadBits(struct inflate_reader *reader, u32 count)
+{
+  while (reader->bitCount < count) {
+    if (reader->position == reader->input->length) {
+      reader->isOverrun = 1;
+      return 0;
+    }
+    reader->bits |= (u32)reader->input->value[reader->position++] << reader->bitCount;
+    reader->bitCount += 8;
+  }
+  u32 value = reader->bits & ((1u << count) - 1);
+  reader->bits = count == 32 ? 0 : reader->bits >> count;
+  reader->bitCount -= count;
+  return value;
+}
+
+// Huffman codes are read most significant bit first
+internalfn u32
+InflateReadCode(struct inflate_reader *reader, u32 count)
+{
+  u32 code = 0;
+  for (u32 index = 0; index < count; index++)
+    code = (code << 1) | InflateReadBits(reader, 1);
+  return code;
+}
+
+internalfn u32
+InflateFixedLiteral(struct inflate_reader *reader)
+{
+  u32 code = InflateReadCode(reader, 7);
+  if (code <= 0x17)
+    return 256 + code;
+  code = (code << 1) | InflateReadBits(reader, 1);
+  if (code >= 0x30 && code <= 0xbf)
+    return code - 0x30;
+  if (code >= 0xc0 && code <= 0xc7)
+    return 280 + (code - 0xc0);
+  code = (code << 1) | InflateReadBits(reader, 1);
+  return 144 + (code - 0x190);
+}
+
+/*
+ * @return inflated
+ *         null if input is invalid or buffer is small
+ */
+internalfn struct string
+Inflate(struct string *input, struct string *buffer)
+{
+  struct inflate_reader reader = {.input = input};
+  u64 length = 0;
+  b8 isFinal = 0;
+  while (!isFinal) {
+    isFinal = (b8)InflateReadBits(&reader, 1);
+    u32 type = InflateReadBits(&reader, 2);
+    if (type == 0) {
+      reader.bits = 0;
+      reader.bitCount = 0;
+      if (reader.position + 4 > input->length)
+        return StringNull();
+      u8 *header = input->value + reader.position;
+      u32 storedLength = (u32)header[0] | (u32)header[1] << 8;
+      u32 storedLengthComplement = (u32)header[2] | (u32)header[3] << 8;
+      reader.position += 4;
+      if ((storedLength ^ 0xffff) != storedLengthComplement || reader.position + storedLength > input->length ||
+          length + storedLength > buffer->length)
+        return StringNull();
+      MemoryCopy(buffer->value + length, input->value + reader.position, storedLength);
+      reader.position += storedLength;
+      length += storedLength;
+    } else if (type == 1) {
+      while (1) {
+        u32 symbol = InflateFixedLiteral(&reader);
+        if (reader.isOverrun || symbol > 285)
+          return StringNull();
+        if (symbol < 256) {
+          if (length == buffer->length)
+            return StringNull();
+          buffer->value[length++] = (u8)symbol;
+          continue;
+        }
+        if (symbol == DEFLATE_END_OF_BLOCK)
+          break;
+
+        u32 lengthSymbol = symbol - 257;
+        u32 matchLength =
+            DEFLATE_LENGTH_BASE[lengthSymbol] + InflateReadBits(&reader, DEFLATE_LENGTH_EXTRA[lengthSymbol]);
+        u32 distanceSymbol = InflateReadCode(&reader, 5);
+        if (distanceSymbol >= 30)
+          return StringNull();
+        u32 distance =
+            DEFLATE_DISTANCE_BASE[distanceSymbol] + InflateReadBits(&reader, DEFLATE_DISTANCE_EXTRA[distanceSymbol]);
+        if (reader.isOverrun || distance > length || length + matchLength > buffer->length)
+          return StringNull();
+        // overlapping copy repeats text
+        for (u32 index = 0; index < matchLength; index++, length++)
+          buffer->value[length] = buffer->value[length - distance];
+      }
+    } else {
+      return StringNull();
+    }
+
+    if (reader.isOverrun)
+      return StringNull();
+  }
+
+  return StringFromBuffer(buffer->value, length);
+}
+
+internalfn u64
+RandomXorShift64(u64 *state)
+{
+  u64 x = *state;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  *state = x;
+  return x;
+}
+
+int
+main(void)
+{
+  enum deflate_test_error errorCode = DEFLATE_TEST_ERROR_NONE;
+
+  // setup
+  enum {
+    KILOBYTES = (1 << 10),
+    MEGABYTES = (1 << 20),
+  };
+  u8 stackBuffer[4 * MEGABYTES];
+  memory_arena stackMemory = {
+      .block = stackBuffer,
+      .total = ARRAY_COUNT(stackBuffer),
+  };
+
+  string_builder *sb = MakeStringBuilder(&stackMemory, 1 * KILOBYTES, 32);
+
+  // u32 Crc32(u32 crc, struct string *input)
+  {
+    // https://reveng.sourceforge.io/crc-catalogue/17plus.htm#crc.cat.crc-32-iso-hdlc
+    struct string input = StringFromLiteral("123456789");
+    u32 expected = 0xcbf43926;
+    u32 got = Crc32(0, &input);
+    if (got != expected) {
+      errorCode = DEFLATE_TEST_ERROR_CRC32;
+
+      StringBuilderAppendTestError(sb, errorCode);
+      StringBuilderAppendStringLiteral(sb, "\n  expected: ");
+      StringBuilderAppendHex(sb, expected);
+      StringBuilderAppendStringLiteral(sb, "\n       got: ");
+      StringBuilderAppendHex(sb, got);
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string errorMessage = StringBuilderFlush(sb);
+      PrintString(&errorMessage);
+    }
+  }
+
+  // struct string GzipCompress(struct deflate_encoder *encoder, struct string *input, struct string *buffer)
+  {
+    struct deflate_encoder *encoder = MakeDeflateEncoder(&stackMemory);
+
+    enum input_kind {
+      INPUT_KIND_TEXT,
+      // repeats same json object, must compress well
+      INPUT_KIND_REPEATED,
+      // random octets, must be stored
+      INPUT_KIND_RANDOM,
+      // long runs of one octet, matches overlap themselves
+      INPUT_KIND_RUNS,
+      // octets above 143 have longer codes
+      INPUT_KIND_UTF8,
+    };
+    struct test_case {
+      enum input_kind kind;
+      u64 length;
+      // compressed must be at most length / ratio, 0 to not check
+      u32 ratio;
+    } testCases[] = {
+        {.kind = INPUT_KIND_TEXT, .length = 0},
+        {.kind = INPUT_KIND_TEXT, .length = 1},
+        {.kind = INPUT_KIND_TEXT, .length = 3},
+        {.kind = INPUT_KIND_TEXT, .length = 300},
+        {.kind = INPUT_KIND_REPEATED, .length = 64 * KILOBYTES, .ratio = 20},
+        // more symbols than one block holds, back references go over window
+        {.kind = INPUT_KIND_REPEATED, .length = 700 * KILOBYTES, .ratio = 20},
+        {.kind = INPUT_KIND_RANDOM, .length = 200 * KILOBYTES},
+        {.kind = INPUT_KIND_RUNS, .length = 100 * KILOBYTES, .ratio = 100},
+        {.kind = INPUT_KIND_UTF8, .length = 4 * KILOBYTES},
+    };
+
+    for (u32 testCaseIndex = 0; testCaseIndex < ARRAY_COUNT(testCases); testCaseIndex++) {
+      memory_temp tempMemory = MemoryTempBegin(&stackMemory);
+      struct test_case *testCase = testCases + testCaseIndex;
+
+      struct string *input = MakeString(tempMemory.arena, testCase->length);
+      {
+        struct string text = StringFromLiteral("The quick brown fox jumps over the lazy dog. ");
+        struct string object = StringFromLiteral("{\"type\":\"video\",\"title\":\"Lorem ipsum\","
+                                                 "\"videoId\":\"d_oVysaqG_0\",\"lengthSeconds\":213,"
+                                                 "\"viewCount\":1048576},");
+        struct string utf8 = StringFromLiteral("\xc3\xa7" "ay \xd0\xb4\xd0\xb0 \xe2\x82\xac ");
+        u64 seed = 0x9e3779b97f4a7c15;
+        for (u64 index = 0; index < input->length; index++) {
+          switch (testCase->kind) {
+          case INPUT_KIND_TEXT:
+            input->value[index] = text.value[index % text.length];
+            break;
+          case INPUT_KIND_REPEATED:
+            input->value[index] = object.value[index % object.length];
+            // numbers change from object to object
+            if (index % object.length == object.length - 3)
+              input->value[index] = (u8)('0' + (index / object.length) % 10);
+            break;
+          case INPUT_KIND_RANDOM:
+            input->value[index] = (u8)RandomXorShift64(&seed);
+            break;
+          case INPUT_KIND_RUNS:
+            input->value[index] = (u8)('a' + (index / 4096) % 26);
+            break;
+          case INPUT_KIND_UTF8:
+            // random order so most of it is written as literals
+            input->value[index] = utf8.value[RandomXorShift64(&seed) % utf8.length];
+            break;
+          }
+        }
+      }
+
+      struct string *buffer = MakeString(tempMemory.arena, GzipBound(input->length));
+      struct string compressed = GzipCompress(encoder, input, buffer);
+      if (IsStringNull(&compressed)) {
+        errorCode = DEFLATE_TEST_ERROR_GZIP_COMPRESS;
+
+        StringBuilderAppendTestError(sb, errorCode);
+        StringBuilderAppendStringLiteral(sb, "\n  case: ");
+        StringBuilderAppendU32(sb, testCaseIndex);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+
+        MemoryTempEnd(&tempMemory);
+        continue;
+      }
+
+      // buffer one octet smaller than bound is not accepted
+      struct string shortBuffer = StringFromBuffer(buffer->value, buffer->length - 1);
+      struct string shortCompressed = GzipCompress(encoder, input, &shortBuffer);
+      if (!IsStringNull(&shortCompressed)) {
+        errorCode = DEFLATE_TEST_ERROR_GZIP_COMPRESS;
+
+        StringBuilderAppendTestError(sb, errorCode);
+        StringBuilderAppendStringLiteral(sb, "\n  case: ");
+        StringBuilderAppendU32(sb, testCaseIndex);
+        StringBuilderAppendStringLiteral(sb, "\n  expected: null when buffer is smaller than bound\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+      }
+
+      // header and trailer
+      u8 *header = compressed.value;
+      u8 *trailer = compressed.value + compressed.length - GZIP_TRAILER_LENGTH;
+      u32 crc = 0;
+      u32 inputSize = 0;
+      for (u32 index = 0; index < 4; index++) {
+        crc |= (u32)trailer[index] << (8 * index);
+        inputSize |= (u32)trailer[4 + index] << (8 * index);
+      }
+      if (compressed.length < GZIP_HEADER_LENGTH + GZIP_TRAILER_LENGTH || header[0] != 0x1f || header[1] != 0x8b ||
+          header[2] != 8 || header[3] != 0 || crc != Crc32(0, input) || inputSize != (u32)input->length) {
+        errorCode = DEFLATE_TEST_ERROR_GZIP_HEADER;
+
+        StringBuilderAppendTestError(sb, errorCode);
+        StringBuilderAppendStringLiteral(sb, "\n  case: ");
+        StringBuilderAppendU32(sb, testCaseIndex);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+
+        MemoryTempEnd(&tempMemory);
+        continue;
+      }
+
+      struct string deflated = StringFromBuffer(compressed.value + GZIP_HEADER_LENGTH,
+                                                compressed.length - GZIP_HEADER_LENGTH - GZIP_TRAILER_LENGTH);
+      struct string *inflateBuffer = MakeString(tempMemory.arena, input->length);
+      struct string inflated = Inflate(&deflated, inflateBuffer);
+      if (IsStringNull(&inflated) || !IsStringEqual(&inflated, input)) {
+        errorCode = DEFLATE_TEST_ERROR_INFLATE;
+
+        StringBuilderAppendTestError(sb, errorCode);
+        StringBuilderAppendStringLiteral(sb, "\n  case: ");
+        StringBuilderAppendU32(sb, testCaseIndex);
+        StringBuilderAppendStringLiteral(sb, "\n  input length: ");
+        StringBuilderAppendU64(sb, input->length);
+        StringBuilderAppendStringLiteral(sb, "\n  inflated length: ");
+        StringBuilderAppendU64(sb, inflated.length);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+      }
+
+      if (testCase->ratio != 0 && compressed.length > input->length / testCase->ratio) {
+        errorCode = DEFLATE_TEST_ERROR_RATIO;
+
+        StringBuilderAppendTestError(sb, errorCode);
+        StringBuilderAppendStringLiteral(sb, "\n  case: ");
+        StringBuilderAppendU32(sb, testCaseIndex);
+        StringBuilderAppendStringLiteral(sb, "\n  expected at most: ");
+        StringBuilderAppendU64(sb, input->length / testCase->ratio);
+        StringBuilderAppendStringLiteral(sb, "\n                got: ");
+        StringBuilderAppendU64(sb, compressed.length);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+      }
+
+      MemoryTempEnd(&tempMemory);
+    }
+  }
+
+  return (int)errorCode;
+}
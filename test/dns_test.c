@@ -0,0 +1,707 @@
+#include <sys/socket.h>
+
+#include "dns.c"
+#include "print.h"
+#include "string_builder.h"
+
+#define TEST_ERROR_LIST(X)                                                                                             \
+  X(QUERY_BUILD, "Query must have hostname as labels")                                                                 \
+  X(RESPONSE_PARSE, "Addresses must be taken from answer to query only")                                               \
+  X(ADDRESS_INTERLEAVE, "Address families must alternate starting with IPv6")                                          \
+  X(CACHE, "Cache must keep answers for their TTL")                                                                    \
+  X(RESOLVER, "Resolver must resolve with name server stand-in")
+
+enum dns_test_error {
+  DNS_TEST_ERROR_NONE = 0,
+#define X(tag, message) DNS_TEST_ERROR_##tag,
+  TEST_ERROR_LIST(X)
+#undef X
+
+  // src: https://mesonbuild.com/Unit-tests.html#skipped-tests-and-hard-errors
+  // For the default exitcode testing protocol, the GNU standard approach in
+  // this case is to exit the program with error code 77. Meson will detect this
+  // and report these tests as skipped rather than failed. This behavior was
+  // added in version 0.37.0.
+  MESON_TEST_SKIP = 77,
+  // In addition, sometimes a test fails set up so that it should fail even if
+  // it is marked as an expected failure. The GNU standard approach in this case
+  // is to exit the program with error code 99. Again, Meson will detect this
+  // and report these tests as ERROR, ignoring the setting of should_fail. This
+  // behavior was added in version 0.50.0.
+  MESON_TEST_FAILED_TO_SET_UP = 99,
+};
+
+internalfn void
+StringBuilderAppendTestError(struct string_builder *sb, enum dns_test_error errorCode)
+{
+  struct string message = StringFromLiteral("Unknown error");
+  struct error {
+    enum dns_test_error code;
+    struct string message;
+  } errors[] = {
+#define XX(tag, msg) {.code = DNS_TEST_ERROR_##tag, .message = StringFromLiteral(msg)},
+      TEST_ERROR_LIST(XX)
+#undef XX
+  };
+
+  for (u32 errorIndex = 0; errorIndex < ARRAY_COUNT(errors); errorIndex++) {
+    struct error *error = errors + errorIndex;
+    if (error->code != errorCode)
+      continue;
+
+    message = error->message;
+    break;
+  }
+
+  StringBuilderAppendString(sb, &message);
+}
+
+/*
+ * Writes answer to query, like name server does.
+ * @param flags of answer, e.g. 0x8180 for response with recursion
+ * @param records resource records that follow question, names are pointers
+ *        to question
+ * @return length of answer
+ */
+internalfn u64
+AnswerQuery(u8 *buffer, struct string *query, u16 flags, u16 answerCount, struct string *records)
+{
+  MemoryCopy(buffer, query->value, query->length);
+  DnsWriteU16(buffer + 2, flags);
+  DnsWriteU16(buffer + 6, answerCount);
+  MemoryCopy(buffer + query->length, records->value, records->length);
+  return query->length + records->length;
+}
+
+/*
+ * @return address in text, e.g. "127.0.0.1" or "::1"
+ */
+internalfn struct platform_address
+AddressFromText(char *text)
+{
+  struct platform_address address = {};
+  struct string string = StringFromZeroTerminated((u8 *)text, 64);
+  PlatformAddressParse(&address, &string, 443);
+  return address;
+}
+
+internalfn b8
+IsAddressEqual(struct platform_address *left, struct platform_address *right)
+{
+  struct string leftOctets = PlatformAddressOctets(left);
+  struct string rightOctets = PlatformAddressOctets(right);
+  return IsStringEqual(&leftOctets, &rightOctets);
+}
+
+internalfn void
+StringBuilderAppendAddresses(struct string_builder *sb, struct platform_address *addresses, u32 addressCount)
+{
+  for (u32 addressIndex = 0; addressIndex < addressCount; addressIndex++) {
+    struct string octets = PlatformAddressOctets(addresses + addressIndex);
+    StringBuilderAppendStringLiteral(sb, " ");
+    for (u32 octetIndex = 0; octetIndex < octets.length; octetIndex++)
+      StringBuilderAppendHex(sb, octets.value[octetIndex]);
+  }
+}
+
+int
+main(void)
+{
+  enum dns_test_error errorCode = DNS_TEST_ERROR_NONE;
+
+  // setup
+  enum {
+    KILOBYTES = (1 << 10),
+    MEGABYTES = (1 << 20),
+  };
+  u8 stackBuffer[1 * MEGABYTES];
+  memory_arena stackMemory = {
+      .block = stackBuffer,
+      .total = ARRAY_COUNT(stackBuffer),
+  };
+
+  string_builder *sb = MakeStringBuilder(&stackMemory, 16 * KILOBYTES, 32);
+
+  // u64 DnsQueryBuild(u8 *buffer, u16 id, struct string *hostname, u16 type)
+  {
+    u8 expectedQuery[] = {
+        // id, recursion desired, one question
+        0x12, 0x34, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        // i.iii.st
+        0x01, 'i', 0x03, 'i', 'i', 'i', 0x02, 's', 't', 0x00,
+        // AAAA, IN
+        0x00, 0x1c, 0x00, 0x01,
+    };
+    struct test_case {
+      struct string hostname;
+      b8 isValid;
+    } testCases[] = {
+        {.hostname = StringFromLiteral("i.iii.st"), .isValid = 1},
+        // fully qualified
+        {.hostname = StringFromLiteral("i.iii.st."), .isValid = 1},
+        {.hostname = StringFromLiteral(""), .isValid = 0},
+        {.hostname = StringFromLiteral("i..st"), .isValid = 0},
+        {.hostname = StringFromLiteral(".iii.st"), .isValid = 0},
+        // label longer than 63
+        {
+            .hostname = StringFromLiteral("i.aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa.st"),
+            .isValid = 0,
+        },
+    };
+
+    for (u32 testCaseIndex = 0; testCaseIndex < ARRAY_COUNT(testCases); testCaseIndex++) {
+      struct test_case *testCase = testCases + testCaseIndex;
+      u8 buffer[DNS_MESSAGE_MAX];
+      u64 length = DnsQueryBuild(buffer, 0x1234, &testCase->hostname, DNS_TYPE_AAAA);
+      struct string query = StringFromBuffer(buffer, length);
+      struct string expected = testCase->isValid ? StringFromBuffer(expectedQuery, sizeof(expectedQuery))
+                                                 : StringFromBuffer(buffer, 0);
+      if (!IsStringEqual(&query, &expected)) {
+        errorCode = DNS_TEST_ERROR_QUERY_BUILD;
+        StringBuilderAppendTestError(sb, errorCode);
+        StringBuilderAppendStringLiteral(sb, "\n  hostname: ");
+        StringBuilderAppendString(sb, &testCase->hostname);
+        StringBuilderAppendStringLiteral(sb, "\n  expected:\n");
+        StringBuilderAppendHexDump(sb, &expected);
+        StringBuilderAppendStringLiteral(sb, "\n       got:\n");
+        StringBuilderAppendHexDump(sb, &query);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+      }
+    }
+  }
+
+  struct string hostname = StringFromLiteral("i.iii.st");
+  u8 queryABuffer[DNS_MESSAGE_MAX];
+  struct string queryA = StringFromBuffer(queryABuffer, DnsQueryBuild(queryABuffer, 0xa, &hostname, DNS_TYPE_A));
+  u8 queryAaaaBuffer[DNS_MESSAGE_MAX];
+  struct string queryAaaa =
+      StringFromBuffer(queryAaaaBuffer, DnsQueryBuild(queryAaaaBuffer, 0xaaaa, &hostname, DNS_TYPE_AAAA));
+
+  // name of record points to question, 0xc00c
+  struct string recordsA = StringFromBuffer(
+      (u8[]){
+          0xc0, 0x0c, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x01, 0x2c, 0x00, 0x04, 192,  0,    2,    1,
+          0xc0, 0x0c, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x3c, 0x00, 0x04, 192,  0,    2,    2,
+      },
+      32);
+  struct string recordsAaaa = StringFromBuffer(
+      (u8[]){
+          0xc0, 0x0c, 0x00, 0x1c, 0x00, 0x01, 0x00, 0x00, 0x0e, 0x10, 0x00, 0x10, 0x20, 0x01, 0x0d, 0xb8,
+          0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
+      },
+      28);
+  /*
+   * i.iii.st CNAME edge.iii.st, name is compressed: "edge" then pointer to
+   * "iii.st" in question at 14. Then edge.iii.st A, with pointer to target of
+   * CNAME at 12 + 14 + 12 = 38.
+   */
+  struct string recordsCname = StringFromBuffer(
+      (u8[]){
+          0xc0, 0x0c, 0x00, 0x05, 0x00, 0x01, 0x00, 0x00, 0x00, 0x1e, 0x00, 0x07, 0x04, 'e',  'd',  'g',
+          'e',  0xc0, 0x0e, 0xc0, 0x26, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x01, 0x2c, 0x00, 0x04, 192,
+          0,    2,    3,
+      },
+      35);
+  // record of other class and other type, then A record that ends early
+  struct string recordsOther = StringFromBuffer(
+      (u8[]){
+          0xc0, 0x0c, 0x00, 0x01, 0x00, 0x03, 0x00, 0x00, 0x01, 0x2c, 0x00, 0x04, 192,  0,    2,    4,
+          0xc0, 0x0c, 0x00, 0x10, 0x00, 0x01, 0x00, 0x00, 0x01, 0x2c, 0x00, 0x01, 0x00,
+      },
+      29);
+  struct string recordsTruncated = StringSlice(&recordsA, 0, recordsA.length - 1);
+  struct string recordsNone = StringFromBuffer(queryABuffer, 0);
+
+  // enum dns_response_result DnsResponseParse(struct string *response, u16 id, u16 type, u16 port,
+  //                                           struct platform_address *addresses, u32 *addressCount, u32 *ttl)
+  {
+    struct platform_address addressA1 = AddressFromText("192.0.2.1");
+    struct platform_address addressA2 = AddressFromText("192.0.2.2");
+    struct platform_address addressA3 = AddressFromText("192.0.2.3");
+    struct platform_address addressAaaa = AddressFromText("2001:db8::1");
+
+    struct test_case {
+      char *name;
+      struct string *query;
+      u16 flags;
+      u16 answerCount;
+      struct string *records;
+      u16 id;
+      u16 type;
+      enum dns_response_result expectedResult;
+      struct platform_address *expectedAddresses[2];
+      u32 expectedAddressCount;
+      u32 expectedTtl;
+    } testCases[] = {
+        {
+            .name = "A records, lowest TTL",
+            .query = &queryA,
+            .flags = 0x8180,
+            .answerCount = 2,
+            .records = &recordsA,
+            .id = 0xa,
+            .type = DNS_TYPE_A,
+            .expectedResult = DNS_RESPONSE_OK,
+            .expectedAddresses = {&addressA1, &addressA2},
+            .expectedAddressCount = 2,
+            .expectedTtl = 60,
+        },
+        {
+            .name = "AAAA record",
+            .query = &queryAaaa,
+            .flags = 0x8180,
+            .answerCount = 1,
+            .records = &recordsAaaa,
+            .id = 0xaaaa,
+            .type = DNS_TYPE_AAAA,
+            .expectedResult = DNS_RESPONSE_OK,
+            .expectedAddresses = {&addressAaaa},
+            .expectedAddressCount = 1,
+            .expectedTtl = 3600,
+        },
+        {
+            .name = "CNAME then A record, compressed names",
+            .query = &queryA,
+            .flags = 0x8180,
+            .answerCount = 2,
+            .records = &recordsCname,
+            .id = 0xa,
+            .type = DNS_TYPE_A,
+            .expectedResult = DNS_RESPONSE_OK,
+            .expectedAddresses = {&addressA3},
+            .expectedAddressCount = 1,
+            .expectedTtl = 30,
+        },
+        {
+            .name = "no records of type",
+            .query = &queryA,
+            .flags = 0x8180,
+            .answerCount = 0,
+            .records = &recordsNone,
+            .id = 0xa,
+            .type = DNS_TYPE_A,
+            .expectedResult = DNS_RESPONSE_OK,
+        },
+        {
+            .name = "records of other class and type are skipped",
+            .query = &queryA,
+            .flags = 0x8180,
+            .answerCount = 2,
+            .records = &recordsOther,
+            .id = 0xa,
+            .type = DNS_TYPE_A,
+            .expectedResult = DNS_RESPONSE_OK,
+        },
+        {
+            .name = "name error",
+            .query = &queryA,
+            .flags = 0x8183,
+            .answerCount = 0,
+            .records = &recordsNone,
+            .id = 0xa,
+            .type = DNS_TYPE_A,
+            .expectedResult = DNS_RESPONSE_NAME_ERROR,
+        },
+        {
+            .name = "server failure",
+            .query = &queryA,
+            .flags = 0x8182,
+            .answerCount = 0,
+            .records = &recordsNone,
+            .id = 0xa,
+            .type = DNS_TYPE_A,
+            .expectedResult = DNS_RESPONSE_SERVER_ERROR,
+        },
+        {
+            .name = "truncated answer",
+            .query = &queryA,
+            .flags = 0x8380,
+            .answerCount = 2,
+            .records = &recordsA,
+            .id = 0xa,
+            .type = DNS_TYPE_A,
+            .expectedResult = DNS_RESPONSE_SERVER_ERROR,
+        },
+        {
+            .name = "other id",
+            .query = &queryA,
+            .flags = 0x8180,
+            .answerCount = 2,
+            .records = &recordsA,
+            .id = 0xb,
+            .type = DNS_TYPE_A,
+            .expectedResult = DNS_RESPONSE_INVALID,
+        },
+        {
+            .name = "answer to other type",
+            .query = &queryA,
+            .flags = 0x8180,
+            .answerCount = 2,
+            .records = &recordsA,
+            .id = 0xa,
+            .type = DNS_TYPE_AAAA,
+            .expectedResult = DNS_RESPONSE_INVALID,
+        },
+        {
+            .name = "query instead of answer",
+            .query = &queryA,
+            .flags = 0x0100,
+            .answerCount = 0,
+            .records = &recordsNone,
+            .id = 0xa,
+            .type = DNS_TYPE_A,
+            .expectedResult = DNS_RESPONSE_INVALID,
+        },
+        {
+            .name = "record ends after message",
+            .query = &queryA,
+            .flags = 0x8180,
+            .answerCount = 2,
+            .records = &recordsTruncated,
+            .id = 0xa,
+            .type = DNS_TYPE_A,
+            .expectedResult = DNS_RESPONSE_INVALID,
+        },
+    };
+
+    for (u32 testCaseIndex = 0; testCaseIndex < ARRAY_COUNT(testCases); testCaseIndex++) {
+      struct test_case *testCase = testCases + testCaseIndex;
+      u8 buffer[DNS_MESSAGE_MAX];
+      struct string response = StringFromBuffer(
+          buffer, AnswerQuery(buffer, testCase->query, testCase->flags, testCase->answerCount, testCase->records));
+
+      struct platform_address addresses[DNS_ADDRESS_MAX];
+      u32 addressCount = DNS_ADDRESS_MAX;
+      u32 ttl;
+      enum dns_response_result result =
+          DnsResponseParse(&response, testCase->id, testCase->type, 443, addresses, &addressCount, &ttl);
+
+      b8 isExpected = result == testCase->expectedResult && addressCount == testCase->expectedAddressCount &&
+                      (testCase->expectedAddressCount == 0 || ttl == testCase->expectedTtl);
+      for (u32 addressIndex = 0; isExpected && addressIndex < addressCount; addressIndex++)
+        isExpected = IsAddressEqual(addresses + addressIndex, testCase->expectedAddresses[addressIndex]);
+
+      if (!isExpected) {
+        errorCode = DNS_TEST_ERROR_RESPONSE_PARSE;
+        StringBuilderAppendTestError(sb, errorCode);
+        StringBuilderAppendStringLiteral(sb, "\n  case: ");
+        StringBuilderAppendZeroTerminated(sb, testCase->name, 64);
+        StringBuilderAppendStringLiteral(sb, "\n  expected result: ");
+        StringBuilderAppendU32(sb, testCase->expectedResult);
+        StringBuilderAppendStringLiteral(sb, " addresses: ");
+        StringBuilderAppendU32(sb, testCase->expectedAddressCount);
+        StringBuilderAppendStringLiteral(sb, " ttl: ");
+        StringBuilderAppendU32(sb, testCase->expectedTtl);
+        StringBuilderAppendStringLiteral(sb, "\n       got result: ");
+        StringBuilderAppendU32(sb, result);
+        StringBuilderAppendStringLiteral(sb, " addresses: ");
+        StringBuilderAppendU32(sb, addressCount);
+        StringBuilderAppendStringLiteral(sb, " ttl: ");
+        StringBuilderAppendU32(sb, ttl);
+        StringBuilderAppendStringLiteral(sb, "\n  got:");
+        StringBuilderAppendAddresses(sb, addresses, addressCount);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+      }
+    }
+  }
+
+  // void DnsAddressInterleave(struct platform_address *addresses, u32 addressCount)
+  {
+    struct test_case {
+      char *addresses[5];
+      char *expected[5];
+      u32 addressCount;
+    } testCases[] = {
+        {
+            .addresses = {"192.0.2.1", "192.0.2.2", "2001:db8::1", "2001:db8::2", "192.0.2.3"},
+            .expected = {"2001:db8::1", "192.0.2.1", "2001:db8::2", "192.0.2.2", "192.0.2.3"},
+            .addressCount = 5,
+        },
+        {
+            .addresses = {"2001:db8::1", "2001:db8::2", "2001:db8::3", "192.0.2.1"},
+            .expected = {"2001:db8::1", "192.0.2.1", "2001:db8::2", "2001:db8::3"},
+            .addressCount = 4,
+        },
+        {
+            .addresses = {"192.0.2.1", "192.0.2.2"},
+            .expected = {"192.0.2.1", "192.0.2.2"},
+            .addressCount = 2,
+        },
+    };
+
+    for (u32 testCaseIndex = 0; testCaseIndex < ARRAY_COUNT(testCases); testCaseIndex++) {
+      struct test_case *testCase = testCases + testCaseIndex;
+      struct platform_address addresses[5];
+      struct platform_address expected[5];
+      for (u32 addressIndex = 0; addressIndex < testCase->addressCount; addressIndex++) {
+        addresses[addressIndex] = AddressFromText(testCase->addresses[addressIndex]);
+        expected[addressIndex] = AddressFromText(testCase->expected[addressIndex]);
+      }
+
+      DnsAddressInterleave(addresses, testCase->addressCount);
+
+      b8 isExpected = 1;
+      for (u32 addressIndex = 0; isExpected && addressIndex < testCase->addressCount; addressIndex++)
+        isExpected = IsAddressEqual(addresses + addressIndex, expected + addressIndex);
+      if (!isExpected) {
+        errorCode = DNS_TEST_ERROR_ADDRESS_INTERLEAVE;
+        StringBuilderAppendTestError(sb, errorCode);
+        StringBuilderAppendStringLiteral(sb, "\n  expected:");
+        StringBuilderAppendAddresses(sb, expected, testCase->addressCount);
+        StringBuilderAppendStringLiteral(sb, "\n       got:");
+        StringBuilderAppendAddresses(sb, addresses, testCase->addressCount);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+      }
+    }
+  }
+
+  // b8 DnsCacheStore(struct dns_cache *cache, struct string *hostname, struct platform_address *addresses,
+  //                  u32 addressCount, u32 ttl, u64 now)
+  // struct dns_cache_entry *DnsCacheFind(struct dns_cache *cache, struct string *hostname, u64 now)
+  // struct string DnsCacheSerialize(struct dns_cache *cache, struct string *buffer, u64 now)
+  // b8 DnsCacheParse(struct dns_cache *cache, struct string *content, u64 now)
+  {
+    comptime u64 now = 1760791710;
+    struct platform_address addresses[] = {
+        AddressFromText("2001:db8::1"),
+        AddressFromText("192.0.2.1"),
+    };
+    struct string otherHostname = StringFromLiteral("yewtu.be");
+    struct string upperHostname = StringFromLiteral("I.IIi.st");
+
+    struct dns_cache cache;
+    DnsCacheInit(&cache, &stackMemory);
+    b8 isStored = DnsCacheStore(&cache, &hostname, addresses, ARRAY_COUNT(addresses), 300, now);
+    b8 isOtherStored = DnsCacheStore(&cache, &otherHostname, addresses + 1, 1, 60, now);
+    // system resolver answers, TTL is not known
+    b8 isUnknownTtlStored = DnsCacheStore(&cache, &hostname, addresses, 1, 0, now);
+
+    struct dns_cache_entry *entry = DnsCacheFind(&cache, &upperHostname, now + 299);
+    struct platform_address entryAddresses[2 * DNS_ADDRESS_MAX];
+    u32 entryAddressCount = entry ? DnsCacheEntryAddresses(entry, 8443, entryAddresses) : 0;
+    b8 isExpected = isStored && isOtherStored && !isUnknownTtlStored && cache.isChanged && entryAddressCount == 2 &&
+                    IsAddressEqual(entryAddresses + 0, addresses + 0) &&
+                    IsAddressEqual(entryAddresses + 1, addresses + 1) &&
+                    !DnsCacheFind(&cache, &hostname, now + 300) && DnsCacheFind(&cache, &otherHostname, now + 59);
+    if (!isExpected) {
+      errorCode = DNS_TEST_ERROR_CACHE;
+      StringBuilderAppendTestError(sb, errorCode);
+      StringBuilderAppendStringLiteral(sb, "\n  answer must be found until it expires\n");
+      struct string errorMessage = StringBuilderFlush(sb);
+      PrintString(&errorMessage);
+    }
+
+    // other run reads file after first answer expired
+    struct string buffer = {
+        .value = MemoryArenaPush(&stackMemory, DNS_CACHE_FILE_MAX),
+        .length = DNS_CACHE_FILE_MAX,
+    };
+    struct string content = DnsCacheSerialize(&cache, &buffer, now);
+    struct dns_cache parsedCache;
+    DnsCacheInit(&parsedCache, &stackMemory);
+    b8 isParsed = DnsCacheParse(&parsedCache, &content, now + 60);
+    entry = DnsCacheFind(&parsedCache, &hostname, now + 60);
+    entryAddressCount = entry ? DnsCacheEntryAddresses(entry, 443, entryAddresses) : 0;
+    isExpected = isParsed && parsedCache.entryCount == 1 && entryAddressCount == 2 &&
+                 IsAddressEqual(entryAddresses + 1, addresses + 1) &&
+                 !DnsCacheFind(&parsedCache, &otherHostname, now + 60);
+    if (!isExpected) {
+      errorCode = DNS_TEST_ERROR_CACHE;
+      StringBuilderAppendTestError(sb, errorCode);
+      StringBuilderAppendStringLiteral(sb, "\n  answers that are not expired must be read back");
+      StringBuilderAppendStringLiteral(sb, "\n  got entries: ");
+      StringBuilderAppendU32(sb, parsedCache.entryCount);
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string errorMessage = StringBuilderFlush(sb);
+      PrintString(&errorMessage);
+    }
+
+    struct string damagedContents[] = {
+        StringSlice(&content, 0, content.length - 1),
+        StringFromLiteral("IDNX\x01\x00\x00\x00\x00\x00\x00\x00"),
+        StringFromLiteral("IDNS\x02\x00\x00\x00\x00\x00\x00\x00"),
+    };
+    for (u32 damagedIndex = 0; damagedIndex < ARRAY_COUNT(damagedContents); damagedIndex++) {
+      struct dns_cache damagedCache;
+      DnsCacheInit(&damagedCache, &stackMemory);
+      if (DnsCacheParse(&damagedCache, damagedContents + damagedIndex, now)) {
+        errorCode = DNS_TEST_ERROR_CACHE;
+        StringBuilderAppendTestError(sb, errorCode);
+        StringBuilderAppendStringLiteral(sb, "\n  damaged content must not be read, case: ");
+        StringBuilderAppendU32(sb, damagedIndex);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+      }
+    }
+  }
+
+  // enum dns_resolver_state DnsResolverStart(struct dns_resolver *resolver, struct platform_address *nameServer,
+  //                                          struct string *hostname, u16 port, u32 random, u64 now)
+  // enum dns_resolver_state DnsResolverUpdate(struct dns_resolver *resolver, u64 now)
+  {
+    // name server stand-in on loopback, it answers when test tells it to
+    struct platform_address nameServer = AddressFromText("127.0.0.1");
+    s32 server = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    socklen_t nameServerLength = sizeof(nameServer.value);
+    if (server == -1 || bind(server, (struct sockaddr *)nameServer.value, nameServer.length) == -1 ||
+        getsockname(server, (struct sockaddr *)nameServer.value, &nameServerLength) == -1)
+      return MESON_TEST_FAILED_TO_SET_UP;
+
+    enum {
+      ANSWER_AAAA = (1 << 0),
+      ANSWER_A = (1 << 1),
+    };
+    struct test_case {
+      char *name;
+      // what stand-in answers, from this many nanoseconds since start
+      u32 answers;
+      u64 answeredAfter;
+      // nanoseconds since start when resolver is updated
+      u64 updates[4];
+      u32 updateCount;
+      enum dns_resolver_state expectedState;
+      u32 expectedAddressCount;
+      u32 expectedTtl;
+      u32 expectedQueryCount;
+    } testCases[] = {
+        {
+            .name = "both families",
+            .answers = ANSWER_AAAA | ANSWER_A,
+            .updates = {0},
+            .updateCount = 1,
+            .expectedState = DNS_RESOLVER_STATE_DONE,
+            .expectedAddressCount = 3,
+            .expectedTtl = 60,
+            .expectedQueryCount = 2,
+        },
+        {
+            .name = "A is waited for",
+            .answers = ANSWER_AAAA,
+            .updates = {0, DNS_RESOLVER_RESOLUTION_DELAY - 1},
+            .updateCount = 2,
+            .expectedState = DNS_RESOLVER_STATE_RESOLVING,
+            .expectedAddressCount = 1,
+            .expectedTtl = 3600,
+            .expectedQueryCount = 2,
+        },
+        {
+            .name = "A is not waited for after resolution delay",
+            .answers = ANSWER_AAAA,
+            .updates = {0, DNS_RESOLVER_RESOLUTION_DELAY},
+            .updateCount = 2,
+            .expectedState = DNS_RESOLVER_STATE_DONE,
+            .expectedAddressCount = 1,
+            .expectedTtl = 3600,
+            .expectedQueryCount = 2,
+        },
+        {
+            .name = "queries are sent again",
+            .answers = ANSWER_AAAA | ANSWER_A,
+            .answeredAfter = DNS_RESOLVER_TIMEOUT + 1,
+            .updates = {0, DNS_RESOLVER_TIMEOUT, DNS_RESOLVER_TIMEOUT + 1},
+            .updateCount = 3,
+            .expectedState = DNS_RESOLVER_STATE_DONE,
+            .expectedAddressCount = 3,
+            .expectedTtl = 60,
+            .expectedQueryCount = 4,
+        },
+        {
+            .name = "no answer, timeout doubles",
+            .answers = 0,
+            .updates = {0, DNS_RESOLVER_TIMEOUT, 3 * DNS_RESOLVER_TIMEOUT, 7 * DNS_RESOLVER_TIMEOUT},
+            .updateCount = 4,
+            .expectedState = DNS_RESOLVER_STATE_FAILED,
+            .expectedQueryCount = 6,
+        },
+    };
+
+    for (u32 testCaseIndex = 0; testCaseIndex < ARRAY_COUNT(testCases); testCaseIndex++) {
+      struct test_case *testCase = testCases + testCaseIndex;
+      comptime u64 start = 1000000000;
+      struct dns_resolver resolver;
+      DnsResolverStart(&resolver, &nameServer, &hostname, 443, 0xaaaa000a + testCaseIndex, start);
+
+      // loopback delivers datagram when it is sent, nothing is waited for
+      u32 queryCount = 0;
+      for (u32 updateIndex = 0; updateIndex < testCase->updateCount; updateIndex++) {
+        u64 elapsed = testCase->updates[updateIndex];
+        while (1) {
+          u8 message[DNS_MESSAGE_MAX];
+          struct platform_address peer;
+          socklen_t peerLength = sizeof(peer.value);
+          ssize_t length = recvfrom(server, message, sizeof(message), 0, (struct sockaddr *)peer.value, &peerLength);
+          if (length <= 0)
+            break;
+          queryCount++;
+
+          u16 type = (u16)DnsReadInteger(message + length - 4, 2);
+          u32 answer = type == DNS_TYPE_AAAA ? ANSWER_AAAA : ANSWER_A;
+          if (elapsed < testCase->answeredAfter || !(testCase->answers & answer))
+            continue;
+
+          struct string query = StringFromBuffer(message, (u64)length);
+          struct string *records = type == DNS_TYPE_AAAA ? &recordsAaaa : &recordsA;
+          u8 response[DNS_MESSAGE_MAX];
+          u64 responseLength = AnswerQuery(response, &query, 0x8180, type == DNS_TYPE_AAAA ? 1 : 2, records);
+          sendto(server, response, responseLength, 0, (struct sockaddr *)peer.value, peerLength);
+        }
+
+        DnsResolverUpdate(&resolver, start + elapsed);
+      }
+
+      if (resolver.state != testCase->expectedState || resolver.addressCount != testCase->expectedAddressCount ||
+          (testCase->expectedAddressCount != 0 && resolver.ttl != testCase->expectedTtl) ||
+          queryCount != testCase->expectedQueryCount) {
+        errorCode = DNS_TEST_ERROR_RESOLVER;
+        StringBuilderAppendTestError(sb, errorCode);
+        StringBuilderAppendStringLiteral(sb, "\n  case: ");
+        StringBuilderAppendZeroTerminated(sb, testCase->name, 64);
+        StringBuilderAppendStringLiteral(sb, "\n  expected state: ");
+        StringBuilderAppendU32(sb, testCase->expectedState);
+        StringBuilderAppendStringLiteral(sb, " addresses: ");
+        StringBuilderAppendU32(sb, testCase->expectedAddressCount);
+        StringBuilderAppendStringLiteral(sb, " ttl: ");
+        StringBuilderAppendU32(sb, testCase->expectedTtl);
+        StringBuilderAppendStringLiteral(sb, " queries: ");
+        StringBuilderAppendU32(sb, testCase->expectedQueryCount);
+        StringBuilderAppendStringLiteral(sb, "\n       got state: ");
+        StringBuilderAppendU32(sb, resolver.state);
+        StringBuilderAppendStringLiteral(sb, " addresses: ");
+        StringBuilderAppendU32(sb, resolver.addressCount);
+        StringBuilderAppendStringLiteral(sb, " ttl: ");
+        StringBuilderAppendU32(sb, resolver.ttl);
+        StringBuilderAppendStringLiteral(sb, " queries: ");
+        StringBuilderAppendU32(sb, queryCount);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+      }
+
+      DnsResolverClose(&resolver);
+    }
+
+    // nothing listens on name server
+    PlatformSocketClose(server);
+    struct dns_resolver resolver;
+    // port unreachable of first query is reported when second is sent, or read
+    if (DnsResolverStart(&resolver, &nameServer, &hostname, 443, 0, 0) == DNS_RESOLVER_STATE_RESOLVING)
+      PlatformSocketWait(resolver.socket, PLATFORM_EVENT_READ, 1000);
+    if (DnsResolverUpdate(&resolver, 0) != DNS_RESOLVER_STATE_FAILED) {
+      errorCode = DNS_TEST_ERROR_RESOLVER;
+      StringBuilderAppendTestError(sb, errorCode);
+      StringBuilderAppendStringLiteral(sb, "\n  resolver must fail at once when name server is not listening\n");
+      struct string errorMessage = StringBuilderFlush(sb);
+      PrintString(&errorMessage);
+    }
+    DnsResolverClose(&resolver);
+  }
+
+  return (int)errorCode;
+}
@@ -0,0 +1,309 @@
+#include <fcntl.h>
+#include <ftw.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "invidious_server.h"
+#include "platform.h"
+#include "string_builder.h"
+
+/*
+ * Runs built client end to end against local stand-in of an instance, see
+ * invidious_server.h, over plain HTTP so nothing is measured but the client,
+ * its startup included.
+ *
+ *   ./end_to_end_bench build/invidious test/data/invidious
+ *
+ * Server is forked for every scenario:
+ *   content_length  responses are sent at once with content-length
+ *   chunked         responses are sent in 4 KiB chunks
+ *   latency_20ms    every response is held back 20 ms, like a far instance
+ *
+ * Client is run with one video many times, then once with many videos.
+ * Every run starts with empty cache directory. Then it searches once for a
+ * query with spaces, '&' and non-ASCII bytes, and server answers it only when
+ * query arrives percent-encoded as it is given. Search is checked, not
+ * measured.
+ *
+ * Reported metrics:
+ *   latency_p50_us, latency_p90_us, latency_p99_us  of runs with one video
+ *   requests_per_second                             of run with many videos
+ *
+ * See bench.h for machine readable output and --baseline.
+ */
+
+enum {
+  KILOBYTES = (1 << 10),
+  MEGABYTES = (1 << 20),
+  SINGLE_RUN_COUNT = 64,
+  BATCH_VIDEO_COUNT = 512,
+};
+
+// client fails when server does not get it back after decoding
+#define SEARCH_QUERY "cats & dogs \xc3\xbc 100%"
+
+struct scenario {
+  struct string name;
+  struct invidious_server_options server;
+};
+
+internalfn int
+RemoveCacheEntry(const char *path, const struct stat *status, int flag, struct FTW *ftw)
+{
+  remove(path);
+  return 0;
+}
+
+/*
+ * Runs client as its own process, with output thrown away.
+ * @param arguments zero terminated
+ * @return nanoseconds it took, 0 when it failed
+ */
+internalfn u64
+RunClient(char *client, char **arguments, char *cacheDirectory)
+{
+  char cacheVariable[256];
+  snprintf(cacheVariable, sizeof(cacheVariable), "XDG_CACHE_HOME=%s", cacheDirectory);
+  char *environment[] = {cacheVariable, 0};
+
+  u64 startedAt = NowInNanoseconds();
+  pid_t pid = fork();
+  if (pid == -1)
+    return 0;
+  if (pid == 0) {
+    s32 null = open("/dev/null", O_WRONLY);
+    dup2(null, STDOUT_FILENO);
+    execve(client, arguments, environment);
+    _exit(127);
+  }
+
+  int status;
+  if (waitpid(pid, &status, 0) == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    return 0;
+  u64 elapsed = NowInNanoseconds() - startedAt;
+
+  // every run starts cold
+  nftw(cacheDirectory, RemoveCacheEntry, 16, FTW_DEPTH | FTW_PHYS);
+  mkdir(cacheDirectory, 0700);
+  return elapsed;
+}
+
+internalfn void
+SortU64(u64 *values, u32 count)
+{
+  for (u32 index = 1; index < count; index++) {
+    u64 value = values[index];
+    u32 insertIndex = index;
+    for (; insertIndex > 0 && values[insertIndex - 1] > value; insertIndex--)
+      values[insertIndex] = values[insertIndex - 1];
+    values[insertIndex] = value;
+  }
+}
+
+internalfn void
+Report(struct bench *bench, struct string *name, u64 *latencies, u32 latencyCount, u64 batchElapsed)
+{
+  string_builder *sb = bench->sb;
+  SortU64(latencies, latencyCount);
+  u64 p50 = latencies[(latencyCount - 1) * 50 / 100] / 1000;
+  u64 p90 = latencies[(latencyCount - 1) * 90 / 100] / 1000;
+  u64 p99 = latencies[(latencyCount - 1) * 99 / 100] / 1000;
+  if (batchElapsed == 0)
+    batchElapsed = 1;
+  u64 requestsPerSecond = (u64)BATCH_VIDEO_COUNT * 1000000000UL / batchElapsed;
+
+  StringBuilderAppendString(sb, name);
+  StringBuilderAppendStringLiteral(sb, ": one video p50 ");
+  StringBuilderAppendU64(sb, p50);
+  StringBuilderAppendStringLiteral(sb, " us, p90 ");
+  StringBuilderAppendU64(sb, p90);
+  StringBuilderAppendStringLiteral(sb, " us, p99 ");
+  StringBuilderAppendU64(sb, p99);
+  StringBuilderAppendStringLiteral(sb, " us, ");
+  StringBuilderAppendU64(sb, BATCH_VIDEO_COUNT);
+  StringBuilderAppendStringLiteral(sb, " videos in ");
+  StringBuilderAppendU64(sb, batchElapsed / 1000000);
+  StringBuilderAppendStringLiteral(sb, " ms, ");
+  StringBuilderAppendU64(sb, requestsPerSecond);
+  StringBuilderAppendStringLiteral(sb, " req/s\n");
+  struct string message = StringBuilderFlush(sb);
+  PrintString(&message);
+
+  BenchReport(bench, name, &StringFromLiteral("latency_p50_us"), p50);
+  BenchReport(bench, name, &StringFromLiteral("latency_p90_us"), p90);
+  BenchReport(bench, name, &StringFromLiteral("latency_p99_us"), p99);
+  BenchReport(bench, name, &StringFromLiteral("requests_per_second"), requestsPerSecond);
+}
+
+int
+main(int argc, char *argv[])
+{
+  // setup
+  u8 stackBuffer[64 * KILOBYTES];
+  memory_arena stackMemory = {
+      .block = stackBuffer,
+      .total = ARRAY_COUNT(stackBuffer),
+  };
+
+  string_builder *sb = MakeStringBuilder(&stackMemory, 1024, 32);
+
+  memory_arena heapMemory = {
+      .total = 2 * MEGABYTES,
+  };
+  heapMemory.block = PlatformAllocate(heapMemory.total);
+  if (!heapMemory.block) {
+    StringBuilderAppendStringLiteral(sb, "Could not allocate ");
+    StringBuilderAppendU64(sb, heapMemory.total / MEGABYTES);
+    StringBuilderAppendStringLiteral(sb, "MiB memory");
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return 1;
+  }
+
+  char *client = 0;
+  struct string directory = StringFromLiteral("test/data/invidious");
+  struct bench bench = {.sb = sb, .baseline = StringNull()};
+  for (u32 argumentIndex = 1; argumentIndex < (u32)argc; argumentIndex++) {
+    struct string argument = StringFromZeroTerminated((u8 *)argv[argumentIndex], 1024);
+    struct string *baselineOption = &StringFromLiteral("--baseline=");
+    if (IsStringStartsWith(&argument, baselineOption)) {
+      struct string path = StringSlice(&argument, baselineOption->length, argument.length);
+      struct string *buffer = MakeString(&heapMemory, 1 * MEGABYTES);
+      if (PlatformReadFile(buffer, &path, &bench.baseline) != IO_ERROR_NONE) {
+        StringBuilderAppendStringLiteral(sb, "Could not read baseline.");
+        StringBuilderAppendStringLiteral(sb, "\n  path: ");
+        StringBuilderAppendString(sb, &path);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string message = StringBuilderFlush(sb);
+        PrintString(&message);
+        return 1;
+      }
+    } else if (!client) {
+      client = argv[argumentIndex];
+    } else {
+      directory = argument;
+    }
+  }
+  if (!client) {
+    PrintString(&StringFromLiteral("usage: end_to_end_bench client [directory] [--baseline=path]\n"));
+    return 1;
+  }
+
+  char cacheDirectory[] = "/tmp/end_to_end_bench_XXXXXX";
+  if (!mkdtemp(cacheDirectory)) {
+    PrintString(&StringFromLiteral("Could not create cache directory.\n"));
+    return 1;
+  }
+
+  // every video is asked for once, only few are recorded
+  char (*videoIds)[12] = MemoryArenaPush(&heapMemory, sizeof(*videoIds) * BATCH_VIDEO_COUNT);
+  for (u32 videoIndex = 0; videoIndex < BATCH_VIDEO_COUNT; videoIndex++)
+    snprintf(videoIds[videoIndex], sizeof(*videoIds), "bench%06u", videoIndex);
+
+  struct scenario scenarios[] = {
+      {
+          .name = StringFromLiteral("content_length"),
+          .server = {.directory = directory, .search = StringFromLiteral(SEARCH_QUERY)},
+      },
+      {
+          .name = StringFromLiteral("chunked"),
+          .server = {.directory = directory, .chunkLength = 4 * KILOBYTES, .search = StringFromLiteral(SEARCH_QUERY)},
+      },
+      {
+          .name = StringFromLiteral("latency_20ms"),
+          .server = {.directory = directory, .latencyInMilliseconds = 20, .search = StringFromLiteral(SEARCH_QUERY)},
+      },
+  };
+
+  int exitCode = 0;
+  for (u32 scenarioIndex = 0; scenarioIndex < ARRAY_COUNT(scenarios); scenarioIndex++) {
+    struct scenario *scenario = scenarios + scenarioIndex;
+
+    struct platform_address address;
+    if (!PlatformAddressResolve(&StringFromLiteral("127.0.0.1"), &StringFromLiteral("0"), &address)) {
+      PrintString(&StringFromLiteral("Could not resolve loopback address.\n"));
+      exitCode = 1;
+      break;
+    }
+
+    s32 listener = PlatformSocketListen(&address);
+    if (listener == -1) {
+      StringBuilderAppendStringLiteral(sb, "Could not listen.\n  error: ");
+      StringBuilderAppendPlatformError(sb);
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string message = StringBuilderFlush(sb);
+      PrintString(&message);
+      exitCode = 1;
+      break;
+    }
+
+    pid_t serverPid = fork();
+    if (serverPid == -1) {
+      PrintString(&StringFromLiteral("Could not start server.\n"));
+      exitCode = 1;
+      break;
+    }
+    if (serverPid == 0) {
+      InvidiousServerServe(&scenario->server, listener);
+      _exit(1);
+    }
+    PlatformSocketClose(listener);
+
+    char instance[64];
+    snprintf(instance, sizeof(instance), "http://127.0.0.1:%u", ntohs(((struct sockaddr_in *)address.value)->sin_port));
+
+    u64 latencies[SINGLE_RUN_COUNT];
+    u32 latencyCount = 0;
+    for (; latencyCount < SINGLE_RUN_COUNT; latencyCount++) {
+      char *arguments[] = {client, "-i", instance, videoIds[latencyCount], 0};
+      latencies[latencyCount] = RunClient(client, arguments, cacheDirectory);
+      if (latencies[latencyCount] == 0)
+        break;
+    }
+
+    u64 batchElapsed = 0;
+    if (latencyCount == SINGLE_RUN_COUNT) {
+      char **arguments = MemoryArenaPush(&heapMemory, sizeof(*arguments) * (BATCH_VIDEO_COUNT + 4));
+      arguments[0] = client;
+      arguments[1] = "-i";
+      arguments[2] = instance;
+      for (u32 videoIndex = 0; videoIndex < BATCH_VIDEO_COUNT; videoIndex++)
+        arguments[3 + videoIndex] = videoIds[videoIndex];
+      arguments[3 + BATCH_VIDEO_COUNT] = 0;
+      batchElapsed = RunClient(client, arguments, cacheDirectory);
+    }
+
+    u64 searchElapsed = 0;
+    if (batchElapsed != 0) {
+      char *arguments[] = {client, "-i", instance, "-s", SEARCH_QUERY, 0};
+      searchElapsed = RunClient(client, arguments, cacheDirectory);
+    }
+
+    kill(serverPid, SIGTERM);
+    waitpid(serverPid, 0, 0);
+
+    if (latencyCount != SINGLE_RUN_COUNT || batchElapsed == 0 || searchElapsed == 0) {
+      StringBuilderAppendStringLiteral(sb, "Client failed.\n  scenario: ");
+      StringBuilderAppendString(sb, &scenario->name);
+      StringBuilderAppendStringLiteral(sb, "\n  instance: ");
+      StringBuilderAppendZeroTerminated(sb, instance, sizeof(instance));
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string message = StringBuilderFlush(sb);
+      PrintString(&message);
+      exitCode = 1;
+      break;
+    }
+
+    Report(&bench, &scenario->name, latencies, SINGLE_RUN_COUNT, batchElapsed);
+  }
+
+  rmdir(cacheDirectory);
+  return exitCode;
+}
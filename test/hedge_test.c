@@ -0,0 +1,135 @@
+#include "hedge.c"
+#include "print.h"
+#include "string_builder.h"
+
+#define TEST_ERROR_LIST(X)                                                                                             \
+  X(BUDGET, "Duplicates must not go past share of requests sent")                                                      \
+  X(DELAY, "Delay must be p95 of time to first byte, 0 before enough responses")
+
+enum hedge_test_error {
+  HEDGE_TEST_ERROR_NONE = 0,
+#define X(tag, message) HEDGE_TEST_ERROR_##tag,
+  TEST_ERROR_LIST(X)
+#undef X
+
+  // src: https://mesonbuild.com/Unit-tests.html#skipped-tests-and-hard-errors
+  // For the default exitcode testing protocol, the GNU standard approach in
+  // this case is to exit the program with error code 77. Meson will detect this
+  // and report these tests as skipped rather than failed. This behavior was
+  // added in version 0.37.0.
+  MESON_TEST_SKIP = 77,
+  // In addition, sometimes a test fails set up so that it should fail even if
+  // it is marked as an expected failure. The GNU standard approach in this case
+  // is to exit the program with error code 99. Again, Meson will detect this
+  // and report these tests as ERROR, ignoring the setting of should_fail. This
+  // behavior was added in version 0.50.0.
+  MESON_TEST_FAILED_TO_SET_UP = 99,
+};
+
+internalfn void
+StringBuilderAppendTestError(struct string_builder *sb, enum hedge_test_error errorCode)
+{
+  struct string message = StringFromLiteral("Unknown error");
+  struct error {
+    enum hedge_test_error code;
+    struct string message;
+  } errors[] = {
+#define XX(tag, msg) {.code = HEDGE_TEST_ERROR_##tag, .message = StringFromLiteral(msg)},
+      TEST_ERROR_LIST(XX)
+#undef XX
+  };
+
+  for (u32 errorIndex = 0; errorIndex < ARRAY_COUNT(errors); errorIndex++) {
+    struct error *error = errors + errorIndex;
+    if (error->code != errorCode)
+      continue;
+
+    message = error->message;
+    break;
+  }
+
+  StringBuilderAppendString(sb, &message);
+}
+
+internalfn void
+PrintHedgeError(string_builder *sb, enum hedge_test_error errorCode, u64 expected, u64 got)
+{
+  StringBuilderAppendTestError(sb, errorCode);
+  StringBuilderAppendStringLiteral(sb, "\n  expected: ");
+  StringBuilderAppendU64(sb, expected);
+  StringBuilderAppendStringLiteral(sb, "\n       got: ");
+  StringBuilderAppendU64(sb, got);
+  StringBuilderAppendStringLiteral(sb, "\n");
+  struct string errorMessage = StringBuilderFlush(sb);
+  PrintString(&errorMessage);
+}
+
+int
+main(void)
+{
+  enum hedge_test_error errorCode = HEDGE_TEST_ERROR_NONE;
+
+  // setup
+  enum {
+    KILOBYTES = (1 << 10),
+  };
+  u8 stackBuffer[8 * KILOBYTES];
+  memory_arena stackMemory = {
+      .block = stackBuffer,
+      .total = ARRAY_COUNT(stackBuffer),
+  };
+
+  string_builder *sb = MakeStringBuilder(&stackMemory, 4 * KILOBYTES, 32);
+
+  // b8 HedgeBudgetTake(struct hedge_budget *budget)
+  {
+    struct hedge_budget budget;
+    HedgeBudgetInit(&budget, 5);
+    b8 isTakenEarly = HedgeBudgetTake(&budget);
+
+    // every request is late, only one in twenty is sent twice
+    u32 hedgeCount = 0;
+    for (u32 requestIndex = 0; requestIndex < 1000; requestIndex++) {
+      HedgeBudgetAdd(&budget, 1);
+      hedgeCount += HedgeBudgetTake(&budget);
+    }
+
+    if (isTakenEarly || hedgeCount != 50) {
+      errorCode = HEDGE_TEST_ERROR_BUDGET;
+      PrintHedgeError(sb, errorCode, 50, hedgeCount);
+    }
+
+    HedgeBudgetInit(&budget, 0);
+    HedgeBudgetAdd(&budget, 1000);
+    if (HedgeBudgetTake(&budget)) {
+      errorCode = HEDGE_TEST_ERROR_BUDGET;
+      PrintHedgeError(sb, errorCode, 0, 1);
+    }
+  }
+
+  // u64 HedgeDelay(struct request_timing_histogram *histogram)
+  {
+    comptime u64 MILLISECOND = 1000000;
+    struct request_timing_histogram histogram = {};
+
+    // time to first byte of 1 ms to 100 ms
+    u64 delayEarly = 0;
+    for (u64 milliseconds = 1; milliseconds <= 100; milliseconds++) {
+      if (milliseconds == HEDGE_RESPONSE_MIN)
+        delayEarly = HedgeDelay(&histogram);
+      struct request_timing timing = {};
+      RequestTimingMark(&timing, REQUEST_TIMING_MARK_START, 1000);
+      RequestTimingMark(&timing, REQUEST_TIMING_MARK_SENT, 1000);
+      RequestTimingMark(&timing, REQUEST_TIMING_MARK_FIRST_BYTE, 1000 + milliseconds * MILLISECOND);
+      RequestTimingHistogramAdd(&histogram, &timing);
+    }
+
+    u64 got = HedgeDelay(&histogram);
+    if (delayEarly != 0 || got < 95 * MILLISECOND || got > 100 * MILLISECOND) {
+      errorCode = HEDGE_TEST_ERROR_DELAY;
+      PrintHedgeError(sb, errorCode, 95 * MILLISECOND, delayEarly != 0 ? delayEarly : got);
+    }
+  }
+
+  return (int)errorCode;
+}
@@ -0,0 +1,958 @@
+#include "http2.c"
+#include "print.h"
+#include "string_builder.h"
+
+#define TEST_ERROR_LIST(X)                                                                                             \
+  X(HPACK_DECODE, "Header block must decode to expected fields")                                                       \
+  X(HPACK_ENCODE, "Fields must encode to expected header block")                                                       \
+  X(HTTP2_SERVER, "Server must receive valid frames from client")                                                      \
+  X(HTTP2_RESPONSE, "Stream must receive response that server sent")                                                   \
+  X(HTTP2_EXPECTED, "Connection must finish with expected streams")
+
+enum http2_test_error {
+  HTTP2_TEST_ERROR_NONE = 0,
+#define X(tag, message) HTTP2_TEST_ERROR_##tag,
+  TEST_ERROR_LIST(X)
+#undef X
+
+  // src: https://mesonbuild.com/Unit-tests.html#skipped-tests-and-hard-errors
+  // For the default exitcode testing protocol, the GNU standard approach in
+  // this case is to exit the program with error code 77. Meson will detect this
+  // and report these tests as skipped rather than failed. This behavior was
+  // added in version 0.37.0.
+  MESON_TEST_SKIP = 77,
+  // In addition, sometimes a test fails set up so that it should fail even if
+  // it is marked as an expected failure. The GNU standard approach in this case
+  // is to exit the program with error code 99. Again, Meson will detect this
+  // and report these tests as ERROR, ignoring the setting of should_fail. This
+  // behavior was added in version 0.50.0.
+  MESON_TEST_FAILED_TO_SET_UP = 99,
+};
+
+internalfn void
+StringBuilderAppendTestError(struct string_builder *sb, enum http2_test_error errorCode)
+{
+  struct string message = StringFromLiteral("Unknown error");
+  struct error {
+    enum http2_test_error code;
+    struct string message;
+  } errors[] = {
+#define XX(tag, msg) {.code = HTTP2_TEST_ERROR_##tag, .message = StringFromLiteral(msg)},
+      TEST_ERROR_LIST(XX)
+#undef XX
+  };
+
+  for (u32 errorIndex = 0; errorIndex < ARRAY_COUNT(errors); errorIndex++) {
+    struct error *error = errors + errorIndex;
+    if (error->code != errorCode)
+      continue;
+
+    message = error->message;
+    break;
+  }
+
+  StringBuilderAppendString(sb, &message);
+}
+
+internalfn u8
+TestResponseByte(u32 streamId, u64 index)
+{
+  return (u8)(streamId * 3 + index);
+}
+
+internalfn u8
+TestContentByte(u64 index)
+{
+  return (u8)('a' + index % 26);
+}
+
+/*****************************************************************
+ * Stand-in for an h2 server. It checks what client sends and
+ * answers every request with a body that depends on stream id.
+ *****************************************************************/
+
+struct test_server_request {
+  u32 streamId;
+  b8 isComplete;
+  b8 isHeadersSent;
+  b8 isPushPromised;
+  u64 contentLength;
+  u64 contentReceived;
+  // how much client allows server to send
+  s64 sendWindow;
+  // how much server allows client to send
+  s64 receiveWindow;
+  u64 bodySent;
+};
+
+struct test_server {
+  // behavior
+  u32 maxConcurrentStreams;
+  u32 initialWindowSize;
+  u64 bodyLength;
+  b8 isContinuation;
+  b8 isPadded;
+  b8 isPing;
+  b8 isPushPromise;
+  u32 goAwayAfter;
+
+  // failure reason, null if none
+  char *error;
+
+  b8 isPrefaceReceived;
+  b8 isSettingsAckReceived;
+  b8 isPingSent;
+  b8 isPingAckReceived;
+  b8 isGoAwaySent;
+  u32 lastStreamId;
+  b8 isGoAwayReceived;
+  u32 goAwayError;
+
+  struct hpack_table decoder;
+  struct hpack_table encoder;
+  struct string scratch;
+  s64 sendWindow;
+  s64 receiveWindow;
+
+  u32 requestCount;
+  struct test_server_request requests[16];
+
+  struct string output;
+  u64 outputLength;
+};
+
+internalfn u8 *
+TestServerPushFrame(struct test_server *server, u64 length, enum http2_frame_type type, u8 flags, u32 streamId)
+{
+  debug_assert(server->outputLength + HTTP2_FRAME_HEADER_LENGTH + length <= server->output.length);
+  u8 *frame = server->output.value + server->outputLength;
+  frame[0] = (u8)(length >> 16);
+  frame[1] = (u8)(length >> 8);
+  frame[2] = (u8)(length >> 0);
+  frame[3] = (u8)type;
+  frame[4] = flags;
+  Http2WriteU32(frame + 5, streamId);
+  server->outputLength += HTTP2_FRAME_HEADER_LENGTH + length;
+  return frame + HTTP2_FRAME_HEADER_LENGTH;
+}
+
+internalfn void
+TestServerStart(struct test_server *server)
+{
+  HpackTableInit(&server->decoder, HPACK_TABLE_SIZE_DEFAULT);
+  HpackTableInit(&server->encoder, HPACK_TABLE_SIZE_DEFAULT);
+  server->sendWindow = HTTP2_WINDOW_SIZE_DEFAULT;
+  server->receiveWindow = HTTP2_WINDOW_SIZE_DEFAULT;
+
+  u8 *settings = TestServerPushFrame(server, 12, HTTP2_FRAME_SETTINGS, 0, 0);
+  settings[0] = 0;
+  settings[1] = HTTP2_SETTINGS_MAX_CONCURRENT_STREAMS;
+  Http2WriteU32(settings + 2, server->maxConcurrentStreams);
+  settings[6] = 0;
+  settings[7] = HTTP2_SETTINGS_INITIAL_WINDOW_SIZE;
+  Http2WriteU32(settings + 8, server->initialWindowSize);
+
+  if (server->isPing) {
+    u8 *ping = TestServerPushFrame(server, 8, HTTP2_FRAME_PING, 0, 0);
+    MemoryCopy(ping, "pingpong", 8);
+    server->isPingSent = 1;
+  }
+}
+
+internalfn struct test_server_request *
+TestServerFindRequest(struct test_server *server, u32 streamId)
+{
+  for (u32 requestIndex = 0; requestIndex < server->requestCount; requestIndex++) {
+    struct test_server_request *request = server->requests + requestIndex;
+    if (request->streamId == streamId)
+      return request;
+  }
+  return 0;
+}
+
+internalfn void
+TestServerReceive(struct test_server *server, struct string *input)
+{
+  u64 position = 0;
+  if (!server->isPrefaceReceived) {
+    struct string preface = StringFromLiteral(HTTP2_CONNECTION_PREFACE);
+    u64 prefixLength = input->length < preface.length ? input->length : preface.length;
+    struct string prefix = StringFromBuffer(input->value, prefixLength);
+    if (!IsStringEqual(&prefix, &preface)) {
+      server->error = "connection preface is expected";
+      return;
+    }
+    server->isPrefaceReceived = 1;
+    position = preface.length;
+  }
+
+  while (position < input->length && !server->error) {
+    if (input->length - position < HTTP2_FRAME_HEADER_LENGTH) {
+      server->error = "client wrote partial frame header";
+      return;
+    }
+    u8 *frame = input->value + position;
+    u32 length = (u32)frame[0] << 16 | (u32)frame[1] << 8 | (u32)frame[2];
+    enum http2_frame_type type = frame[3];
+    u8 flags = frame[4];
+    u32 streamId = Http2ReadU32(frame + 5);
+    if (input->length - position - HTTP2_FRAME_HEADER_LENGTH < length) {
+      server->error = "client wrote partial frame";
+      return;
+    }
+    struct string payload = StringFromBuffer(frame + HTTP2_FRAME_HEADER_LENGTH, length);
+    position += HTTP2_FRAME_HEADER_LENGTH + length;
+
+    switch (type) {
+    case HTTP2_FRAME_HEADERS: {
+      if ((streamId & 1) == 0 || TestServerFindRequest(server, streamId) ||
+          server->requestCount == ARRAY_COUNT(server->requests)) {
+        server->error = "HEADERS must open new odd numbered stream";
+        return;
+      }
+      if (!(flags & HTTP2_FLAG_END_HEADERS)) {
+        server->error = "request header block is expected to fit a frame";
+        return;
+      }
+
+      struct test_server_request *request = server->requests + server->requestCount++;
+      *request = (struct test_server_request){
+          .streamId = streamId,
+          .isComplete = (flags & HTTP2_FLAG_END_STREAM) != 0,
+          .sendWindow = HTTP2_WINDOW_SIZE_DEFAULT,
+          .receiveWindow = server->initialWindowSize,
+      };
+
+      b8 isPathFound = 0;
+      b8 isAuthorityFound = 0;
+      u64 blockPosition = 0;
+      while (blockPosition < payload.length) {
+        struct http_header field;
+        if (!HpackDecodeField(&server->decoder, &payload, &blockPosition, &server->scratch, &field)) {
+          server->error = "request header block cannot be decoded";
+          return;
+        }
+        if (IsStringEqual(&field.name, &StringFromLiteral(":path")))
+          isPathFound = IsStringStartsWith(&field.value, &StringFromLiteral("/api/v1/videos/"));
+        else if (IsStringEqual(&field.name, &StringFromLiteral(":authority")))
+          isAuthorityFound = IsStringEqual(&field.value, &StringFromLiteral("i.iii.st"));
+        else if (IsStringEqual(&field.name, &StringFromLiteral("content-length")))
+          ParseU64(&field.value, &request->contentLength);
+      }
+      if (!isPathFound || !isAuthorityFound) {
+        server->error = ":path and :authority of request are wrong";
+        return;
+      }
+    } break;
+
+    case HTTP2_FRAME_DATA: {
+      struct test_server_request *request = TestServerFindRequest(server, streamId);
+      if (!request || request->isComplete) {
+        server->error = "DATA must be on open stream";
+        return;
+      }
+      request->receiveWindow -= length;
+      server->receiveWindow -= length;
+      if (request->receiveWindow < 0 || server->receiveWindow < 0) {
+        server->error = "client exceeded flow control window";
+        return;
+      }
+      for (u64 index = 0; index < length; index++) {
+        if (payload.value[index] != TestContentByte(request->contentReceived + index)) {
+          server->error = "request content is wrong";
+          return;
+        }
+      }
+      request->contentReceived += length;
+      if (flags & HTTP2_FLAG_END_STREAM) {
+        request->isComplete = 1;
+        if (request->contentReceived != request->contentLength) {
+          server->error = "request content is not content-length long";
+          return;
+        }
+      }
+
+      // consumed, give window back
+      if (length != 0) {
+        Http2WriteU32(TestServerPushFrame(server, 4, HTTP2_FRAME_WINDOW_UPDATE, 0, 0), length);
+        server->receiveWindow += length;
+        if (!request->isComplete) {
+          Http2WriteU32(TestServerPushFrame(server, 4, HTTP2_FRAME_WINDOW_UPDATE, 0, streamId), length);
+          request->receiveWindow += length;
+        }
+      }
+    } break;
+
+    case HTTP2_FRAME_SETTINGS: {
+      if (flags & HTTP2_FLAG_ACK) {
+        server->isSettingsAckReceived = 1;
+        break;
+      }
+      for (u64 index = 0; index + 6 <= payload.length; index += 6) {
+        if (payload.value[index + 1] == HTTP2_SETTINGS_ENABLE_PUSH && Http2ReadU32(payload.value + index + 2) != 0) {
+          server->error = "client must disable server push";
+          return;
+        }
+      }
+      TestServerPushFrame(server, 0, HTTP2_FRAME_SETTINGS, HTTP2_FLAG_ACK, 0);
+    } break;
+
+    case HTTP2_FRAME_WINDOW_UPDATE: {
+      u32 increment = Http2ReadU32(payload.value);
+      if (streamId == 0) {
+        server->sendWindow += increment;
+      } else {
+        struct test_server_request *request = TestServerFindRequest(server, streamId);
+        if (request)
+          request->sendWindow += increment;
+      }
+    } break;
+
+    case HTTP2_FRAME_PING: {
+      if (!(flags & HTTP2_FLAG_ACK) || !IsStringEqual(&payload, &StringFromLiteral("pingpong"))) {
+        server->error = "PING must be answered with same payload";
+        return;
+      }
+      server->isPingAckReceived = 1;
+    } break;
+
+    case HTTP2_FRAME_GOAWAY: {
+      server->isGoAwayReceived = 1;
+      server->goAwayError = Http2ReadU32(payload.value + 4);
+    } break;
+
+    default: {
+      server->error = "unexpected frame from client";
+      return;
+    } break;
+    }
+  }
+}
+
+internalfn void
+TestServerRespond(struct test_server *server)
+{
+  if (server->goAwayAfter != 0 && !server->isGoAwaySent && server->requestCount >= server->goAwayAfter) {
+    server->lastStreamId = server->requests[server->goAwayAfter - 1].streamId;
+    u8 *payload = TestServerPushFrame(server, 8, HTTP2_FRAME_GOAWAY, 0, 0);
+    Http2WriteU32(payload + 0, server->lastStreamId);
+    Http2WriteU32(payload + 4, HTTP2_ERROR_NONE);
+    server->isGoAwaySent = 1;
+  }
+
+  for (u32 requestIndex = 0; requestIndex < server->requestCount; requestIndex++) {
+    struct test_server_request *request = server->requests + requestIndex;
+    if (!request->isComplete || request->isHeadersSent ||
+        (server->isGoAwaySent && request->streamId > server->lastStreamId))
+      continue;
+
+    if (server->isPushPromise) {
+      u8 *promise = TestServerPushFrame(server, 5, HTTP2_FRAME_PUSH_PROMISE, HTTP2_FLAG_END_HEADERS, request->streamId);
+      Http2WriteU32(promise, 2);
+      promise[4] = 0x82; // :method GET
+      request->isPushPromised = 1;
+    }
+
+    u8 blockBuffer[256];
+    struct string block = StringFromBuffer(blockBuffer, sizeof(blockBuffer));
+    u64 blockLength = 0;
+    u8 contentLengthBuffer[20];
+    struct string contentLength = StringFromBuffer(contentLengthBuffer, sizeof(contentLengthBuffer));
+    struct http_header fields[] = {
+        {StringFromLiteral(":status"), StringFromLiteral("200")},
+        {StringFromLiteral("content-type"), StringFromLiteral("application/json")},
+        {StringFromLiteral("server"), StringFromLiteral("h2 stand-in")},
+        {StringFromLiteral("content-length"), FormatU64(&contentLength, server->bodyLength)},
+    };
+    for (u32 fieldIndex = 0; fieldIndex < ARRAY_COUNT(fields); fieldIndex++)
+      HpackEncodeField(&server->encoder, &block, &blockLength, fields + fieldIndex, HPACK_INDEXING_INCREMENTAL);
+
+    u64 firstLength = server->isContinuation ? blockLength / 2 : blockLength;
+    u8 *headers = TestServerPushFrame(server, firstLength, HTTP2_FRAME_HEADERS,
+                                      firstLength == blockLength ? HTTP2_FLAG_END_HEADERS : 0, request->streamId);
+    MemoryCopy(headers, block.value, firstLength);
+    if (firstLength != blockLength) {
+      u8 *continuation = TestServerPushFrame(server, blockLength - firstLength, HTTP2_FRAME_CONTINUATION,
+                                             HTTP2_FLAG_END_HEADERS, request->streamId);
+      MemoryCopy(continuation, block.value + firstLength, blockLength - firstLength);
+    }
+    request->isHeadersSent = 1;
+  }
+
+  // DATA of streams interleaved, as windows allow
+  comptime u64 chunkMax = 5000;
+  comptime u8 padLength = 10;
+  b8 isSent = 1;
+  while (isSent) {
+    isSent = 0;
+    for (u32 requestIndex = 0; requestIndex < server->requestCount; requestIndex++) {
+      struct test_server_request *request = server->requests + requestIndex;
+      if (!request->isHeadersSent || request->bodySent == server->bodyLength)
+        continue;
+
+      u64 overhead = server->isPadded ? 1 + padLength : 0;
+      s64 window = server->sendWindow < request->sendWindow ? server->sendWindow : request->sendWindow;
+      if (window <= (s64)overhead)
+        continue;
+
+      u64 length = server->bodyLength - request->bodySent;
+      if (length > chunkMax)
+        length = chunkMax;
+      if (length > (u64)window - overhead)
+        length = (u64)window - overhead;
+
+      b8 isLast = request->bodySent + length == server->bodyLength;
+      u8 flags = (u8)((isLast ? HTTP2_FLAG_END_STREAM : 0) | (server->isPadded ? HTTP2_FLAG_PADDED : 0));
+      u8 *data = TestServerPushFrame(server, length + overhead, HTTP2_FRAME_DATA, flags, request->streamId);
+      if (server->isPadded) {
+        *data++ = padLength;
+        MemoryClear(data + length, padLength);
+      }
+      for (u64 index = 0; index < length; index++)
+        data[index] = TestResponseByte(request->streamId, request->bodySent + index);
+
+      request->bodySent += length;
+      request->sendWindow -= (s64)(length + overhead);
+      server->sendWindow -= (s64)(length + overhead);
+      isSent = 1;
+    }
+  }
+}
+
+int
+main(void)
+{
+  enum http2_test_error errorCode = HTTP2_TEST_ERROR_NONE;
+
+  // setup
+  enum {
+    KILOBYTES = (1 << 10),
+    MEGABYTES = (1 << 20),
+  };
+  u8 stackBuffer[2 * MEGABYTES];
+  memory_arena stackMemory = {
+      .block = stackBuffer,
+      .total = ARRAY_COUNT(stackBuffer),
+  };
+
+  string_builder *sb = MakeStringBuilder(&stackMemory, 64 * KILOBYTES, 32);
+  struct string *scratch = MakeString(&stackMemory, 4 * KILOBYTES);
+
+  // b8 HpackDecodeField(struct hpack_table *table, struct string *block, u64 *position, struct string *scratch,
+  //                     struct http_header *field)
+  // b8 HpackEncodeField(struct hpack_table *table, struct string *buffer, u64 *position, struct http_header *field,
+  //                     enum hpack_indexing indexing)
+  {
+    struct test_block {
+      struct string block;
+      u32 fieldCount;
+      struct http_header *fields;
+    };
+
+    struct http_header request1[] = {
+        {StringFromLiteral(":method"), StringFromLiteral("GET")},
+        {StringFromLiteral(":scheme"), StringFromLiteral("http")},
+        {StringFromLiteral(":path"), StringFromLiteral("/")},
+        {StringFromLiteral(":authority"), StringFromLiteral("www.example.com")},
+    };
+    struct http_header request2[] = {
+        {StringFromLiteral(":method"), StringFromLiteral("GET")},
+        {StringFromLiteral(":scheme"), StringFromLiteral("http")},
+        {StringFromLiteral(":path"), StringFromLiteral("/")},
+        {StringFromLiteral(":authority"), StringFromLiteral("www.example.com")},
+        {StringFromLiteral("cache-control"), StringFromLiteral("no-cache")},
+    };
+    struct http_header request3[] = {
+        {StringFromLiteral(":method"), StringFromLiteral("GET")},
+        {StringFromLiteral(":scheme"), StringFromLiteral("https")},
+        {StringFromLiteral(":path"), StringFromLiteral("/index.html")},
+        {StringFromLiteral(":authority"), StringFromLiteral("www.example.com")},
+        {StringFromLiteral("custom-key"), StringFromLiteral("custom-value")},
+    };
+    struct http_header response1[] = {
+        {StringFromLiteral(":status"), StringFromLiteral("302")},
+        {StringFromLiteral("cache-control"), StringFromLiteral("private")},
+        {StringFromLiteral("date"), StringFromLiteral("Mon, 21 Oct 2013 20:13:21 GMT")},
+        {StringFromLiteral("location"), StringFromLiteral("https://www.example.com")},
+    };
+    struct http_header response2[] = {
+        {StringFromLiteral(":status"), StringFromLiteral("307")},
+        {StringFromLiteral("cache-control"), StringFromLiteral("private")},
+        {StringFromLiteral("date"), StringFromLiteral("Mon, 21 Oct 2013 20:13:21 GMT")},
+        {StringFromLiteral("location"), StringFromLiteral("https://www.example.com")},
+    };
+    struct http_header response3[] = {
+        {StringFromLiteral(":status"), StringFromLiteral("200")},
+        {StringFromLiteral("cache-control"), StringFromLiteral("private")},
+        {StringFromLiteral("date"), StringFromLiteral("Mon, 21 Oct 2013 20:13:22 GMT")},
+        {StringFromLiteral("location"), StringFromLiteral("https://www.example.com")},
+        {StringFromLiteral("content-encoding"), StringFromLiteral("gzip")},
+        {StringFromLiteral("set-cookie"),
+         StringFromLiteral("foo=ASDJKHQKBZXOQWEOPIUAXQWEOIU; max-age=3600; version=1")},
+    };
+
+    struct test_case {
+      struct string name;
+      u32 tableSize;
+      // encoder does Huffman coding unless it is longer, so only blocks that are
+      // fully Huffman coded can be reproduced
+      b8 isEncodingChecked;
+      struct test_block blocks[3];
+    } testCases[] = {
+        // https://www.rfc-editor.org/rfc/rfc7541#appendix-C.3
+        {
+            .name = StringFromLiteral("C.3 Requests without Huffman Coding"),
+            .tableSize = HPACK_TABLE_SIZE_DEFAULT,
+            .isEncodingChecked = 0,
+            .blocks =
+                {
+                    {
+                        .block = StringFromLiteral("\x82\x86\x84\x41\x0f"
+                                                   "www.example.com"),
+                        .fieldCount = ARRAY_COUNT(request1),
+                        .fields = request1,
+                    },
+                    {
+                        .block = StringFromLiteral("\x82\x86\x84\xbe\x58\x08"
+                                                   "no-cache"),
+                        .fieldCount = ARRAY_COUNT(request2),
+                        .fields = request2,
+                    },
+                    {
+                        .block = StringFromLiteral("\x82\x87\x85\xbf\x40\x0a"
+                                                   "custom-key"
+                                                   "\x0c"
+                                                   "custom-value"),
+                        .fieldCount = ARRAY_COUNT(request3),
+                        .fields = request3,
+                    },
+                },
+        },
+        // https://www.rfc-editor.org/rfc/rfc7541#appendix-C.4
+        {
+            .name = StringFromLiteral("C.4 Requests with Huffman Coding"),
+            .tableSize = HPACK_TABLE_SIZE_DEFAULT,
+            .isEncodingChecked = 1,
+            .blocks =
+                {
+                    {
+                        .block = StringFromLiteral("\x82\x86\x84\x41\x8c\xf1\xe3\xc2\xe5\xf2\x3a\x6b\xa0\xab\x90\xf4"
+                                                   "\xff"),
+                        .fieldCount = ARRAY_COUNT(request1),
+                        .fields = request1,
+                    },
+                    {
+                        .block = StringFromLiteral("\x82\x86\x84\xbe\x58\x86\xa8\xeb\x10\x64\x9c\xbf"),
+                        .fieldCount = ARRAY_COUNT(request2),
+                        .fields = request2,
+                    },
+                    {
+                        .block = StringFromLiteral("\x82\x87\x85\xbf\x40\x88\x25\xa8\x49\xe9\x5b\xa9\x7d\x7f\x89\x25"
+                                                   "\xa8\x49\xe9\x5b\xb8\xe8\xb4\xbf"),
+                        .fieldCount = ARRAY_COUNT(request3),
+                        .fields = request3,
+                    },
+                },
+        },
+        // https://www.rfc-editor.org/rfc/rfc7541#appendix-C.6
+        // table is small, so entries are evicted
+        {
+            .name = StringFromLiteral("C.6 Responses with Huffman Coding"),
+            .tableSize = 256,
+            .isEncodingChecked = 1,
+            .blocks =
+                {
+                    {
+                        .block = StringFromLiteral("\x48\x82\x64\x02\x58\x85\xae\xc3\x77\x1a\x4b\x61\x96\xd0\x7a\xbe"
+                                                   "\x94\x10\x54\xd4\x44\xa8\x20\x05\x95\x04\x0b\x81\x66\xe0\x82\xa6"
+                                                   "\x2d\x1b\xff\x6e\x91\x9d\x29\xad\x17\x18\x63\xc7\x8f\x0b\x97\xc8"
+                                                   "\xe9\xae\x82\xae\x43\xd3"),
+                        .fieldCount = ARRAY_COUNT(response1),
+                        .fields = response1,
+                    },
+                    {
+                        .block = StringFromLiteral("\x48\x83\x64\x0e\xff\xc1\xc0\xbf"),
+                        .fieldCount = ARRAY_COUNT(response2),
+                        .fields = response2,
+                    },
+                    {
+                        .block = StringFromLiteral("\x88\xc1\x61\x96\xd0\x7a\xbe\x94\x10\x54\xd4\x44\xa8\x20\x05\x95"
+                                                   "\x04\x0b\x81\x66\xe0\x84\xa6\x2d\x1b\xff\xc0\x5a\x83\x9b\xd9\xab"
+                                                   "\x77\xad\x94\xe7\x82\x1d\xd7\xf2\xe6\xc7\xb3\x35\xdf\xdf\xcd\x5b"
+                                                   "\x39\x60\xd5\xaf\x27\x08\x7f\x36\x72\xc1\xab\x27\x0f\xb5\x29\x1f"
+                                                   "\x95\x87\x31\x60\x65\xc0\x03\xed\x4e\xe5\xb1\x06\x3d\x50\x07"),
+                        .fieldCount = ARRAY_COUNT(response3),
+                        .fields = response3,
+                    },
+                },
+        },
+    };
+
+    struct hpack_table decoder;
+    struct hpack_table encoder;
+    u8 encodedBuffer[256];
+    for (u32 testCaseIndex = 0; testCaseIndex < ARRAY_COUNT(testCases); testCaseIndex++) {
+      struct test_case *testCase = testCases + testCaseIndex;
+      HpackTableInit(&decoder, testCase->tableSize);
+      HpackTableInit(&encoder, testCase->tableSize);
+
+      for (u32 blockIndex = 0; blockIndex < ARRAY_COUNT(testCase->blocks); blockIndex++) {
+        struct test_block *testBlock = testCase->blocks + blockIndex;
+
+        u32 fieldIndex = 0;
+        u64 position = 0;
+        b8 isMatched = 1;
+        while (isMatched && position < testBlock->block.length) {
+          struct http_header field;
+          isMatched = HpackDecodeField(&decoder, &testBlock->block, &position, scratch, &field) &&
+                      fieldIndex < testBlock->fieldCount &&
+                      IsStringEqual(&field.name, &testBlock->fields[fieldIndex].name) &&
+                      IsStringEqual(&field.value, &testBlock->fields[fieldIndex].value);
+          fieldIndex++;
+        }
+        if (!isMatched || fieldIndex != testBlock->fieldCount) {
+          errorCode = HTTP2_TEST_ERROR_HPACK_DECODE;
+          StringBuilderAppendTestError(sb, errorCode);
+          StringBuilderAppendStringLiteral(sb, "\n  ");
+          StringBuilderAppendString(sb, &testCase->name);
+          StringBuilderAppendStringLiteral(sb, " block ");
+          StringBuilderAppendU64(sb, blockIndex + 1);
+          StringBuilderAppendStringLiteral(sb, " field ");
+          StringBuilderAppendU64(sb, fieldIndex);
+          StringBuilderAppendStringLiteral(sb, "\n");
+          struct string errorMessage = StringBuilderFlush(sb);
+          PrintString(&errorMessage);
+          break;
+        }
+
+        if (!testCase->isEncodingChecked)
+          continue;
+
+        struct string encoded = StringFromBuffer(encodedBuffer, sizeof(encodedBuffer));
+        u64 encodedLength = 0;
+        for (fieldIndex = 0; fieldIndex < testBlock->fieldCount; fieldIndex++)
+          HpackEncodeField(&encoder, &encoded, &encodedLength, testBlock->fields + fieldIndex,
+                           HPACK_INDEXING_INCREMENTAL);
+        encoded.length = encodedLength;
+        if (!IsStringEqual(&encoded, &testBlock->block)) {
+          errorCode = HTTP2_TEST_ERROR_HPACK_ENCODE;
+          StringBuilderAppendTestError(sb, errorCode);
+          StringBuilderAppendStringLiteral(sb, "\n  ");
+          StringBuilderAppendString(sb, &testCase->name);
+          StringBuilderAppendStringLiteral(sb, " block ");
+          StringBuilderAppendU64(sb, blockIndex + 1);
+          StringBuilderAppendStringLiteral(sb, "\n  expected:\n");
+          StringBuilderAppendHexDump(sb, &testBlock->block);
+          StringBuilderAppendStringLiteral(sb, "\n       got:\n");
+          StringBuilderAppendHexDump(sb, &encoded);
+          StringBuilderAppendStringLiteral(sb, "\n");
+          struct string errorMessage = StringBuilderFlush(sb);
+          PrintString(&errorMessage);
+          break;
+        }
+      }
+    }
+  }
+
+  // b8 Http2Receive(struct http2_connection *connection, struct string *input)
+  // struct http2_stream *Http2Request(struct http2_connection *connection, struct http_request_info *info,
+  //                                   memory_arena *memory, struct receive_buffer *buffer)
+  {
+    struct test_case {
+      struct string name;
+      u32 requestCount;
+      b8 isPost;
+      u64 contentLength;
+      struct test_server server;
+
+      u32 expectedCompletedCount;
+      u32 expectedRefusedCount;
+      enum http2_error expectedError;
+      u32 expectedMaxActiveCount;
+    } testCases[] = {
+        {
+            .name = StringFromLiteral("many streams on one connection, interleaved responses"),
+            .requestCount = 8,
+            .server =
+                {
+                    .maxConcurrentStreams = 3,
+                    .initialWindowSize = HTTP2_WINDOW_SIZE_DEFAULT,
+                    .bodyLength = 100000,
+                },
+            .expectedCompletedCount = 8,
+            .expectedMaxActiveCount = 3,
+        },
+        {
+            .name = StringFromLiteral("response is much bigger than what buffer commits up front"),
+            .requestCount = 1,
+            .server =
+                {
+                    .maxConcurrentStreams = 100,
+                    .initialWindowSize = HTTP2_WINDOW_SIZE_DEFAULT,
+                    .bodyLength = 400000,
+                },
+            .expectedCompletedCount = 1,
+            .expectedMaxActiveCount = 1,
+        },
+        {
+            .name = StringFromLiteral("header block in CONTINUATION, padded DATA, PING"),
+            .requestCount = 2,
+            .server =
+                {
+                    .maxConcurrentStreams = 100,
+                    .initialWindowSize = HTTP2_WINDOW_SIZE_DEFAULT,
+                    .bodyLength = 20000,
+                    .isContinuation = 1,
+                    .isPadded = 1,
+                    .isPing = 1,
+                },
+            .expectedCompletedCount = 2,
+            .expectedMaxActiveCount = 2,
+        },
+        {
+            .name = StringFromLiteral("request content is bigger than window"),
+            .requestCount = 2,
+            .isPost = 1,
+            .contentLength = 50000,
+            .server =
+                {
+                    .maxConcurrentStreams = 100,
+                    .initialWindowSize = 1000,
+                    .bodyLength = 100,
+                },
+            .expectedCompletedCount = 2,
+            .expectedMaxActiveCount = 2,
+        },
+        {
+            .name = StringFromLiteral("server goes away after 2 requests"),
+            .requestCount = 4,
+            .server =
+                {
+                    .maxConcurrentStreams = 100,
+                    .initialWindowSize = HTTP2_WINDOW_SIZE_DEFAULT,
+                    .bodyLength = 100,
+                    .goAwayAfter = 2,
+                },
+            .expectedCompletedCount = 2,
+            .expectedRefusedCount = 2,
+            .expectedMaxActiveCount = 4,
+        },
+        {
+            .name = StringFromLiteral("server push is disabled"),
+            .requestCount = 1,
+            .server =
+                {
+                    .maxConcurrentStreams = 100,
+                    .initialWindowSize = HTTP2_WINDOW_SIZE_DEFAULT,
+                    .bodyLength = 100,
+                    .isPushPromise = 1,
+                },
+            .expectedError = HTTP2_ERROR_PROTOCOL,
+            .expectedMaxActiveCount = 1,
+        },
+    };
+
+    comptime u32 STREAM_MAX = 4;
+    comptime u32 REQUEST_MAX = 8;
+    comptime u64 RESPONSE_RESERVED = 1024 * KILOBYTES;
+
+    struct string videoIds[] = {
+        StringFromLiteral("d_oVysaqG_0"), StringFromLiteral("aqz-KE-bpKQ"), StringFromLiteral("YE7VzlLtp-4"),
+        StringFromLiteral("eRsGyueVLvQ"), StringFromLiteral("R6MlUcmOul8"), StringFromLiteral("WhWc3b3KhnY"),
+    };
+
+    for (u32 testCaseIndex = 0; testCaseIndex < ARRAY_COUNT(testCases) && errorCode == HTTP2_TEST_ERROR_NONE;
+         testCaseIndex++) {
+      memory_temp tempMemory = MemoryTempBegin(&stackMemory);
+      struct test_case *testCase = testCases + testCaseIndex;
+      debug_assert(testCase->requestCount <= REQUEST_MAX);
+
+      struct test_server *server = &testCase->server;
+      server->scratch = *MakeString(tempMemory.arena, 4 * KILOBYTES);
+      server->output = *MakeString(tempMemory.arena, 512 * KILOBYTES);
+      TestServerStart(server);
+
+      struct http2_connection *connection = MakeHttp2Connection(tempMemory.arena, STREAM_MAX, 8);
+      Http2Start(connection);
+
+      // like client does, wait for server settings before requests
+      struct string serverPreface = StringFromBuffer(server->output.value, server->outputLength);
+      server->outputLength = 0;
+      Http2Receive(connection, &serverPreface);
+      if (!connection->isPeerSettingsReceived) {
+        errorCode = MESON_TEST_FAILED_TO_SET_UP;
+        break;
+      }
+
+      struct string *content = MakeString(tempMemory.arena, testCase->contentLength);
+      for (u64 index = 0; index < content->length; index++)
+        content->value[index] = TestContentByte(index);
+
+      struct receive_buffer buffers[STREAM_MAX];
+      struct http2_stream *bufferStreams[STREAM_MAX];
+      for (u32 bufferIndex = 0; bufferIndex < STREAM_MAX; bufferIndex++) {
+        if (!ReceiveBufferInit(buffers + bufferIndex, RESPONSE_RESERVED)) {
+          errorCode = MESON_TEST_FAILED_TO_SET_UP;
+          break;
+        }
+        bufferStreams[bufferIndex] = 0;
+      }
+      if (errorCode != HTTP2_TEST_ERROR_NONE)
+        break;
+
+      u32 sentCount = 0;
+      u32 completedCount = 0;
+      u32 refusedCount = 0;
+      u32 maxActiveCount = 0;
+      u32 iteration = 0;
+      for (; iteration < 1000 && errorCode == HTTP2_TEST_ERROR_NONE; iteration++) {
+        // open as many streams as allowed
+        while (sentCount < testCase->requestCount) {
+          u32 bufferIndex = 0;
+          while (bufferIndex < STREAM_MAX && bufferStreams[bufferIndex])
+            bufferIndex++;
+          if (bufferIndex == STREAM_MAX)
+            break;
+
+          string_builder *pathBuilder = MakeStringBuilder(tempMemory.arena, 64, 0);
+          StringBuilderAppendStringLiteral(pathBuilder, "/api/v1/videos/");
+          StringBuilderAppendString(pathBuilder, videoIds + sentCount % ARRAY_COUNT(videoIds));
+          struct http_request_info requestInfo = {
+              .method = testCase->isPost ? HTTP_METHOD_POST : HTTP_METHOD_GET,
+              .version = HTTP_VERSION_20,
+              .host = StringFromLiteral("i.iii.st"),
+              .path = StringBuilderFlush(pathBuilder),
+              .headerCount = 1,
+              .headers = (struct http_header[]){{StringFromLiteral("user-agent"), StringFromLiteral("invidious")}},
+              .contentType = testCase->isPost ? HTTP_CONTENT_TYPE_JSON : HTTP_CONTENT_TYPE_NONE,
+              .content = testCase->isPost ? content : 0,
+          };
+          struct http2_stream *stream = Http2Request(connection, &requestInfo, tempMemory.arena, buffers + bufferIndex);
+          if (!stream)
+            break;
+          bufferStreams[bufferIndex] = stream;
+          sentCount++;
+        }
+
+        u32 activeCount = 0;
+        for (u32 bufferIndex = 0; bufferIndex < STREAM_MAX; bufferIndex++)
+          activeCount += bufferStreams[bufferIndex] != 0;
+        if (activeCount > maxActiveCount)
+          maxActiveCount = activeCount;
+
+        struct string clientOutput = Http2Flush(connection);
+        if (clientOutput.length != 0)
+          TestServerReceive(server, &clientOutput);
+        if (server->error) {
+          errorCode = HTTP2_TEST_ERROR_HTTP2_SERVER;
+          StringBuilderAppendTestError(sb, errorCode);
+          StringBuilderAppendStringLiteral(sb, "\n  ");
+          StringBuilderAppendString(sb, &testCase->name);
+          StringBuilderAppendStringLiteral(sb, "\n  ");
+          struct string serverError = StringFromZeroTerminated((u8 *)server->error, 256);
+          StringBuilderAppendString(sb, &serverError);
+          StringBuilderAppendStringLiteral(sb, "\n");
+          struct string errorMessage = StringBuilderFlush(sb);
+          PrintString(&errorMessage);
+          break;
+        }
+        if (connection->error != HTTP2_ERROR_NONE)
+          break;
+
+        TestServerRespond(server);
+        struct string serverOutput = StringFromBuffer(server->output.value, server->outputLength);
+        server->outputLength = 0;
+        connection->position = 0;
+        Http2Receive(connection, &serverOutput);
+
+        // collect closed streams
+        b8 isProgressed = clientOutput.length != 0 || serverOutput.length != 0;
+        for (u32 bufferIndex = 0; bufferIndex < STREAM_MAX; bufferIndex++) {
+          struct http2_stream *stream = bufferStreams[bufferIndex];
+          if (!stream || stream->state != HTTP2_STREAM_STATE_CLOSED)
+            continue;
+
+          if (stream->error == HTTP2_ERROR_REFUSED_STREAM) {
+            refusedCount++;
+          } else if (stream->error == HTTP2_ERROR_NONE) {
+            struct string body = Http2StreamBody(stream);
+            b8 isBodyMatched = body.length == server->bodyLength;
+            for (u64 index = 0; isBodyMatched && index < body.length; index++)
+              isBodyMatched = body.value[index] == TestResponseByte(stream->id, index);
+
+            if (stream->statusCode != 200 || !isBodyMatched || stream->headerCount != 3 ||
+                !IsStringEqual(&stream->headers[0].value, &StringFromLiteral("application/json"))) {
+              errorCode = HTTP2_TEST_ERROR_HTTP2_RESPONSE;
+              StringBuilderAppendTestError(sb, errorCode);
+              StringBuilderAppendStringLiteral(sb, "\n  ");
+              StringBuilderAppendString(sb, &testCase->name);
+              StringBuilderAppendStringLiteral(sb, "\n  stream ");
+              StringBuilderAppendU64(sb, stream->id);
+              StringBuilderAppendStringLiteral(sb, " status ");
+              StringBuilderAppendU64(sb, stream->statusCode);
+              StringBuilderAppendStringLiteral(sb, " headers ");
+              StringBuilderAppendU64(sb, stream->headerCount);
+              StringBuilderAppendStringLiteral(sb, " body ");
+              StringBuilderAppendU64(sb, body.length);
+              if (isBodyMatched)
+                StringBuilderAppendStringLiteral(sb, " matched\n");
+              else
+                StringBuilderAppendStringLiteral(sb, " not matched\n");
+              struct string errorMessage = StringBuilderFlush(sb);
+              PrintString(&errorMessage);
+              break;
+            }
+            completedCount++;
+          }
+
+          Http2StreamRelease(stream);
+          bufferStreams[bufferIndex] = 0;
+          isProgressed = 1;
+        }
+
+        if (!isProgressed)
+          break;
+      }
+
+      b8 isServerChecked = (!server->isPing || server->isPingAckReceived) && server->isSettingsAckReceived &&
+                           (server->isGoAwayReceived == (testCase->expectedError != HTTP2_ERROR_NONE)) &&
+                           server->goAwayError == testCase->expectedError;
+      if (errorCode == HTTP2_TEST_ERROR_NONE &&
+          (completedCount != testCase->expectedCompletedCount || refusedCount != testCase->expectedRefusedCount ||
+           connection->error != testCase->expectedError || maxActiveCount != testCase->expectedMaxActiveCount ||
+           !isServerChecked)) {
+        errorCode = HTTP2_TEST_ERROR_HTTP2_EXPECTED;
+        StringBuilderAppendTestError(sb, errorCode);
+        StringBuilderAppendStringLiteral(sb, "\n  ");
+        StringBuilderAppendString(sb, &testCase->name);
+        StringBuilderAppendStringLiteral(sb, "\n  expected: completed ");
+        StringBuilderAppendU64(sb, testCase->expectedCompletedCount);
+        StringBuilderAppendStringLiteral(sb, " refused ");
+        StringBuilderAppendU64(sb, testCase->expectedRefusedCount);
+        StringBuilderAppendStringLiteral(sb, " error ");
+        StringBuilderAppendU64(sb, testCase->expectedError);
+        StringBuilderAppendStringLiteral(sb, " active ");
+        StringBuilderAppendU64(sb, testCase->expectedMaxActiveCount);
+        StringBuilderAppendStringLiteral(sb, "\n       got: completed ");
+        StringBuilderAppendU64(sb, completedCount);
+        StringBuilderAppendStringLiteral(sb, " refused ");
+        StringBuilderAppendU64(sb, refusedCount);
+        StringBuilderAppendStringLiteral(sb, " error ");
+        StringBuilderAppendU64(sb, connection->error);
+        StringBuilderAppendStringLiteral(sb, " active ");
+        StringBuilderAppendU64(sb, maxActiveCount);
+        if (!isServerChecked)
+          StringBuilderAppendStringLiteral(sb, " (server did not get expected frames)");
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+      }
+
+      for (u32 bufferIndex = 0; bufferIndex < STREAM_MAX; bufferIndex++)
+        ReceiveBufferRelease(buffers + bufferIndex);
+      MemoryTempEnd(&tempMemory);
+    }
+  }
+
+  return (int)errorCode;
+}
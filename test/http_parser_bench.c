@@ -0,0 +1,424 @@
+#include "bench.h"
+#include "http_parser.c"
+#include "platform.h"
+#include "string_builder.h"
+
+/*
+ * Replays recorded HTTP responses through HttpParse() the way they arrive from
+ * network.
+ *
+ * Each response is fed:
+ *   - whole, in one call
+ *   - in 16 KiB pieces, size of a TLS record
+ *   - in random pieces between 1 byte and 4 KiB (or 1/8 of small responses),
+ *     seeded so runs are comparable
+ *
+ * Reported metrics:
+ *   ns_per_header             of head alone, for every corpus
+ *   ns_per_response           whole response, for every way it is fed
+ *   scanned_bytes_per_second  of head and chunk framing, bytes parser reads;
+ *                             body is skipped by its length, not scanned
+ *   ns_per_chunk              for corpuses whose chunks are most of what is
+ *                             scanned, few small chunks cost less than noise
+ *                             of head
+ * See bench.h for machine readable output and --baseline.
+ *
+ * Corpus is read from directory given as argument, test/data:
+ *   http/small_json.http     stats endpoint with content-length
+ *   http/many_headers.http   cdn style response with 38 headers, chunked
+ *   twitter.json             served chunked in 8 KiB chunks and with only
+ *                            content-length header
+ */
+
+enum {
+  KILOBYTES = (1 << 10),
+  MEGABYTES = (1 << 20),
+};
+
+enum feed_mode {
+  FEED_MODE_WHOLE,
+  FEED_MODE_TLS_RECORD,
+  FEED_MODE_RANDOM,
+};
+
+struct corpus {
+  struct string name;
+  struct string response;
+  // length of status line, headers and empty line
+  u64 headLength;
+  // length of chunk size lines, CRLFs after chunk data and last chunk
+  u64 framingLength;
+  u32 headerCount;
+  u32 chunkCount;
+};
+
+struct feed {
+  struct string name;
+  enum feed_mode mode;
+  u32 splitCount;
+  u32 *splits;
+};
+
+internalfn u64
+RandomXorShift64(u64 *state)
+{
+  u64 x = *state;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  *state = x;
+  return x;
+}
+
+/*
+ * Computes sizes of pieces that response is cut into. Pieces can end
+ * anywhere, even in status line: parser does not consume incomplete lines,
+ * and resumes from its position when rest arrives.
+ * @return number of pieces, splits can be null to only count
+ */
+internalfn u32
+FeedSplit(enum feed_mode mode, struct string *response, u32 *splits)
+{
+  u64 seed = 0x9e3779b97f4a7c15;
+  u64 randomMax = response->length / 8 + 1;
+  if (randomMax > 4 * KILOBYTES)
+    randomMax = 4 * KILOBYTES;
+  u32 splitCount = 0;
+  for (u64 position = 0; position < response->length; splitCount++) {
+    u64 length = 0;
+    switch (mode) {
+    case FEED_MODE_WHOLE:
+      length = response->length;
+      break;
+    case FEED_MODE_TLS_RECORD:
+      length = 16 * KILOBYTES;
+      break;
+    case FEED_MODE_RANDOM:
+      length = 1 + RandomXorShift64(&seed) % randomMax;
+      break;
+    }
+
+    if (length > response->length - position)
+      length = response->length - position;
+
+    if (splits)
+      splits[splitCount] = (u32)length;
+    position += length;
+  }
+
+  return splitCount;
+}
+
+/*
+ * @param chunkCount counts chunks with data when it is not null
+ * @param chunkDataLength counts their data when it is not null
+ */
+internalfn enum http_parser_error
+Feed(struct http_parser *parser, struct string *response, struct feed *feed, u32 *chunkCount,
+     u64 *chunkDataLength)
+{
+  u64 filled = 0;
+  for (u32 splitIndex = 0; splitIndex < feed->splitCount; splitIndex++) {
+    filled += feed->splits[splitIndex];
+
+    do {
+      struct string data = StringSlice(response, parser->position, filled);
+      HttpParse(parser, &data);
+
+      if (chunkCount) {
+        for (u32 tokenIndex = parser->headerTokenCount; tokenIndex < parser->tokenCount; tokenIndex++) {
+          struct http_token *token = parser->tokens + tokenIndex;
+          if (token->type != HTTP_TOKEN_CHUNK_DATA || token->end == 0)
+            continue;
+          *chunkCount += 1;
+          if (chunkDataLength)
+            *chunkDataLength += token->end - token->start;
+        }
+      }
+    } while (parser->error == HTTP_PARSER_ERROR_PAUSED);
+
+    if (parser->error != HTTP_PARSER_ERROR_PARTIAL)
+      break;
+  }
+
+  return parser->error;
+}
+
+internalfn b8
+CorpusInit(struct corpus *corpus, memory_arena *arena)
+{
+  struct string_cursor cursor = StringCursorFromString(&corpus->response);
+  struct string *CRLF = &StringFromLiteral("\r\n");
+  struct string *CRLFCRLF = &StringFromLiteral("\r\n\r\n");
+
+  struct string head = StringCursorExtractUntil(&cursor, CRLFCRLF);
+  if (IsStringNull(&head))
+    return 0;
+  corpus->headLength = head.length + CRLFCRLF->length;
+
+  // every CRLF in head ends a header line, except the first that ends status line
+  struct string_cursor headCursor = StringCursorFromString(&head);
+  corpus->headerCount = 0;
+  while (StringCursorAdvanceAfter(&headCursor, CRLF))
+    corpus->headerCount++;
+
+  // verify and count chunks
+  memory_temp tempMemory = MemoryTempBegin(arena);
+  struct http_parser *parser = MakeHttpStreamingParser(tempMemory.arena, 64);
+  u32 splits[] = {(u32)corpus->response.length};
+  struct feed feed = {.splitCount = 1, .splits = splits};
+  corpus->chunkCount = 0;
+  u64 chunkDataLength = 0;
+  enum http_parser_error error = Feed(parser, &corpus->response, &feed, &corpus->chunkCount, &chunkDataLength);
+  MemoryTempEnd(&tempMemory);
+
+  // content-length body is skipped whole, so nothing after head is scanned
+  corpus->framingLength = 0;
+  if (corpus->chunkCount != 0)
+    corpus->framingLength = corpus->response.length - corpus->headLength - chunkDataLength;
+  return error == HTTP_PARSER_ERROR_NONE;
+}
+
+/*
+ * Runs parser many times and returns the fastest run.
+ * Fastest run is the one least disturbed by rest of the system.
+ */
+internalfn u64
+Measure(memory_arena *arena, struct string *response, struct feed *feed)
+{
+  comptime u64 minimumDuration = 200 * 1000000UL /* 200ms */;
+  comptime u32 maximumRunCount = 100000;
+
+  u64 best = (u64)-1;
+  u64 total = 0;
+  for (u32 runIndex = 0; runIndex < maximumRunCount && total < minimumDuration; runIndex++) {
+    memory_temp tempMemory = MemoryTempBegin(arena);
+    struct http_parser *parser = MakeHttpStreamingParser(tempMemory.arena, 64);
+
+    u64 startedAt = NowInNanoseconds();
+    Feed(parser, response, feed, 0, 0);
+    u64 elapsed = NowInNanoseconds() - startedAt;
+
+    MemoryTempEnd(&tempMemory);
+
+    total += elapsed;
+    if (elapsed < best)
+      best = elapsed;
+  }
+
+  return best;
+}
+
+internalfn b8
+LoadFile(memory_arena *arena, struct string_builder *sb, struct string *directory, struct string *name,
+         struct string *content)
+{
+  StringBuilderAppendString(sb, directory);
+  StringBuilderAppendStringLiteral(sb, "/");
+  StringBuilderAppendString(sb, name);
+  struct string path = StringBuilderFlushZeroTerminated(sb);
+
+  struct string *buffer = MakeString(arena, 1 * MEGABYTES);
+  enum platform_error error = PlatformReadFile(buffer, &path, content);
+  if (error != IO_ERROR_NONE) {
+    StringBuilderAppendStringLiteral(sb, "Could not read file.");
+    StringBuilderAppendStringLiteral(sb, "\n  path: ");
+    StringBuilderAppendString(sb, &path);
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return 0;
+  }
+
+  return 1;
+}
+
+int
+main(int argc, char *argv[])
+{
+  // setup
+  u8 stackBuffer[1 * MEGABYTES];
+  memory_arena stackMemory = {
+      .block = stackBuffer,
+      .total = ARRAY_COUNT(stackBuffer),
+  };
+
+  string_builder *sb = MakeStringBuilder(&stackMemory, 1024, 32);
+
+  memory_arena heapMemory = {
+      .total = 32 * MEGABYTES,
+  };
+  heapMemory.block = PlatformAllocate(heapMemory.total);
+  if (!heapMemory.block) {
+    StringBuilderAppendStringLiteral(sb, "Could not allocate ");
+    StringBuilderAppendU64(sb, heapMemory.total / MEGABYTES);
+    StringBuilderAppendStringLiteral(sb, "MiB memory");
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return 1;
+  }
+
+  struct bench bench = {.sb = sb, .baseline = StringNull()};
+  struct string directory = StringNull();
+  for (u32 argumentIndex = 1; argumentIndex < argc; argumentIndex++) {
+    struct string argument = StringFromZeroTerminated((u8 *)argv[argumentIndex], 1024);
+    struct string *baselineOption = &StringFromLiteral("--baseline=");
+    if (IsStringStartsWith(&argument, baselineOption)) {
+      struct string path = StringSlice(&argument, baselineOption->length, argument.length);
+      struct string *buffer = MakeString(&heapMemory, 1 * MEGABYTES);
+      if (PlatformReadFile(buffer, &path, &bench.baseline) != IO_ERROR_NONE) {
+        StringBuilderAppendStringLiteral(sb, "Could not read baseline.");
+        StringBuilderAppendStringLiteral(sb, "\n  path: ");
+        StringBuilderAppendString(sb, &path);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string message = StringBuilderFlush(sb);
+        PrintString(&message);
+        return 1;
+      }
+    } else if (!IsStringStartsWith(&argument, &StringFromLiteral("--"))) {
+      directory = argument;
+    }
+  }
+  if (IsStringNullOrEmpty(&directory)) {
+    StringBuilderAppendStringLiteral(sb, "Needs test data directory as argument");
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return 1;
+  }
+
+  // corpus
+  struct corpus corpuses[4];
+  u32 corpusCount = 0;
+  {
+    struct string response;
+
+    if (!LoadFile(&heapMemory, sb, &directory, &StringFromLiteral("http/small_json.http"), &response))
+      return 1;
+    corpuses[corpusCount++] = (struct corpus){.name = StringFromLiteral("small_json"), .response = response};
+
+    if (!LoadFile(&heapMemory, sb, &directory, &StringFromLiteral("http/many_headers.http"), &response))
+      return 1;
+    corpuses[corpusCount++] = (struct corpus){.name = StringFromLiteral("many_headers"), .response = response};
+
+    struct string json;
+    if (!LoadFile(&heapMemory, sb, &directory, &StringFromLiteral("twitter.json"), &json))
+      return 1;
+
+    // as served by invidious behind nginx
+    string_builder *responseBuilder = MakeStringBuilder(&heapMemory, json.length + 64 * KILOBYTES, 32);
+    StringBuilderAppendStringLiteral(responseBuilder, "HTTP/1.1 200 OK\r\n"
+                                                      "Server: nginx\r\n"
+                                                      "Date: Fri, 18 Apr 2025 07:14:00 GMT\r\n"
+                                                      "Content-Type: application/json\r\n"
+                                                      "Transfer-Encoding: chunked\r\n"
+                                                      "Connection: keep-alive\r\n"
+                                                      "\r\n");
+    for (u64 position = 0; position < json.length; position += 8 * KILOBYTES) {
+      u64 end = position + 8 * KILOBYTES;
+      if (end > json.length)
+        end = json.length;
+      struct string chunk = StringSlice(&json, position, end);
+      StringBuilderAppendHex(responseBuilder, chunk.length);
+      StringBuilderAppendStringLiteral(responseBuilder, "\r\n");
+      StringBuilderAppendString(responseBuilder, &chunk);
+      StringBuilderAppendStringLiteral(responseBuilder, "\r\n");
+    }
+    StringBuilderAppendStringLiteral(responseBuilder, "0\r\n\r\n");
+    response = StringBuilderFlush(responseBuilder);
+    corpuses[corpusCount++] = (struct corpus){.name = StringFromLiteral("large_chunked"), .response = response};
+
+    responseBuilder = MakeStringBuilder(&heapMemory, json.length + 64, 32);
+    StringBuilderAppendStringLiteral(responseBuilder, "HTTP/1.1 200 OK\r\nContent-Length: ");
+    StringBuilderAppendU64(responseBuilder, json.length);
+    StringBuilderAppendStringLiteral(responseBuilder, "\r\n\r\n");
+    StringBuilderAppendString(responseBuilder, &json);
+    response = StringBuilderFlush(responseBuilder);
+    corpuses[corpusCount++] = (struct corpus){.name = StringFromLiteral("content_length"), .response = response};
+  }
+
+  for (u32 corpusIndex = 0; corpusIndex < corpusCount; corpusIndex++) {
+    struct corpus *corpus = corpuses + corpusIndex;
+    if (!CorpusInit(corpus, &heapMemory)) {
+      StringBuilderAppendStringLiteral(sb, "Could not parse ");
+      StringBuilderAppendString(sb, &corpus->name);
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string message = StringBuilderFlush(sb);
+      PrintString(&message);
+      return 1;
+    }
+  }
+
+  struct feed feeds[] = {
+      {.name = StringFromLiteral("whole"), .mode = FEED_MODE_WHOLE},
+      {.name = StringFromLiteral("16k"), .mode = FEED_MODE_TLS_RECORD},
+      {.name = StringFromLiteral("random"), .mode = FEED_MODE_RANDOM},
+  };
+
+  for (u32 corpusIndex = 0; corpusIndex < corpusCount; corpusIndex++) {
+    struct corpus *corpus = corpuses + corpusIndex;
+
+    // headers alone, parser stops at body with partial
+    u64 headElapsed;
+    {
+      struct string head = StringSlice(&corpus->response, 0, corpus->headLength);
+      u32 splits[] = {(u32)head.length};
+      struct feed feed = {.splitCount = 1, .splits = splits};
+      headElapsed = Measure(&heapMemory, &head, &feed);
+    }
+    BenchReport(&bench, &corpus->name, &StringFromLiteral("ns_per_header"), headElapsed / corpus->headerCount);
+
+    for (u32 feedIndex = 0; feedIndex < ARRAY_COUNT(feeds); feedIndex++) {
+      struct feed *feed = feeds + feedIndex;
+      memory_temp tempMemory = MemoryTempBegin(&heapMemory);
+
+      feed->splitCount = FeedSplit(feed->mode, &corpus->response, 0);
+      feed->splits = MemoryArenaPush(tempMemory.arena, sizeof(*feed->splits) * feed->splitCount);
+      FeedSplit(feed->mode, &corpus->response, feed->splits);
+
+      u64 elapsed = Measure(tempMemory.arena, &corpus->response, feed);
+      if (elapsed == 0)
+        elapsed = 1;
+      u64 scannedLength = corpus->headLength + corpus->framingLength;
+      u64 scannedBytesPerSecond = scannedLength * 1000000000UL / elapsed;
+
+      StringBuilderAppendString(sb, &corpus->name);
+      StringBuilderAppendStringLiteral(sb, "/");
+      StringBuilderAppendString(sb, &feed->name);
+      struct string name = StringBuilderFlush(sb);
+      // name is overwritten by next flush, keep copy
+      u8 nameBuffer[64];
+      debug_assert(name.length <= sizeof(nameBuffer));
+      MemoryCopy(nameBuffer, name.value, name.length);
+      name.value = nameBuffer;
+
+      StringBuilderAppendString(sb, &name);
+      StringBuilderAppendStringLiteral(sb, ": ");
+      StringBuilderAppendU64(sb, corpus->response.length);
+      StringBuilderAppendStringLiteral(sb, " bytes in ");
+      StringBuilderAppendU32(sb, feed->splitCount);
+      StringBuilderAppendStringLiteral(sb, " pieces, ");
+      StringBuilderAppendU64(sb, elapsed);
+      StringBuilderAppendStringLiteral(sb, " ns, ");
+      StringBuilderAppendU64(sb, scannedLength);
+      StringBuilderAppendStringLiteral(sb, " bytes scanned at ");
+      StringBuilderAppendF32(sb, (f32)scannedBytesPerSecond / (f32)MEGABYTES, 2);
+      StringBuilderAppendStringLiteral(sb, " MiB/s\n");
+      struct string message = StringBuilderFlush(sb);
+      PrintString(&message);
+
+      BenchReport(&bench, &name, &StringFromLiteral("ns_per_response"), elapsed);
+      BenchReport(&bench, &name, &StringFromLiteral("scanned_bytes_per_second"), scannedBytesPerSecond);
+      // cost of few small chunks is lost in noise of head
+      if (corpus->framingLength > corpus->headLength) {
+        u64 bodyElapsed = elapsed > headElapsed ? elapsed - headElapsed : 0;
+        BenchReport(&bench, &name, &StringFromLiteral("ns_per_chunk"), bodyElapsed / corpus->chunkCount);
+      }
+
+      MemoryTempEnd(&tempMemory);
+    }
+  }
+
+  return 0;
+}
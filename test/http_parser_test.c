@@ -68,7 +68,11 @@ StringBuilderAppendHttpParserError(string_builder *sb, enum http_parser_error er
       [HTTP_PARSER_ERROR_CHUNK_SIZE_IS_INVALID] = StringFromLiteral("Chunk size is invalid"),
       [HTTP_PARSER_ERROR_CHUNK_DATA_MALFORMED] = StringFromLiteral("Chunk data is malformed"),
       [HTTP_PARSER_ERROR_CONTENT_INVALID_LENGTH] = StringFromLiteral("Content has invalid length"),
+      [HTTP_PARSER_ERROR_CONTENT_RANGE_INVALID] = StringFromLiteral("Content range is invalid"),
+      [HTTP_PARSER_ERROR_CONTENT_RANGE_LENGTH_MISMATCH] =
+          StringFromLiteral("Content range is not matching with content length"),
       [HTTP_PARSER_ERROR_PARTIAL] = StringFromLiteral("Partial response"),
+      [HTTP_PARSER_ERROR_PAUSED] = StringFromLiteral("Paused"),
   };
   struct string *httpParserErrorText = httpParserErrorTexts + (u32)error;
   StringBuilderAppendString(sb, httpParserErrorText);
@@ -181,6 +185,7 @@ main(void)
         struct http_token *httpTokens;
         struct string *httpTokenStrings;
         struct string *content;
+        struct http_content_range *contentRange;
       } expected;
     } testCases[] = {
 #define CRLF "\r\n"
@@ -260,8 +265,6 @@ main(void)
                     .error = HTTP_PARSER_ERROR_CHUNK_SIZE_IS_INVALID,
                 },
         },
-    // TODO: Do http parser checks chunk data length
-#if 0
         {
             .httpResponse = &StringFromLiteral(
                 /*** --- Status-Line -------------------------------- ***/
@@ -282,7 +285,6 @@ main(void)
                     .error = HTTP_PARSER_ERROR_CHUNK_DATA_MALFORMED,
                 },
         },
-#endif
         {
             .httpResponse = &StringFromLiteral(
                 /*** --- Status-Line -------------------------------- ***/
@@ -475,6 +477,201 @@ main(void)
                     .content = &StringFromLiteral("[ 1, 2, 3 ]"),
                 },
         },
+        {
+            .httpResponse = &StringFromLiteral(
+                /*** --- Status-Line -------------------------------- ***/
+                "HTTP/1.1 206 Partial Content" CRLF
+                /*** --- Header Fields ------------------------------ ***/
+                /**/ "Content-Range: bytes 100-110/1234" CRLF
+                /**/ "Content-Length: 11" CRLF
+                /**/ CRLF
+                /*** --- Message Body ------------------------------- ***/
+                /**/ "[ 1, 2, 3 ]"
+                /*** --- Next Response ------------------------------ ***/
+                /**/ "HTTP/1.1 200 OK" CRLF),
+            .expected =
+                {
+                    .error = HTTP_PARSER_ERROR_NONE,
+                    .httpTokenCount = 5,
+                    .httpTokens =
+                        // NOTE: when changing this array, do not forget to update httpTokenCount, httpTokenStrings
+                    // fields
+                    (struct http_token[]){
+                        {.type = HTTP_TOKEN_HTTP_VERSION, .start = 0x0, .end = 0x8},
+                        {.type = HTTP_TOKEN_STATUS_CODE, .start = 0x9, .end = 0xc},
+                        {.type = HTTP_TOKEN_HEADER_CONTENT_RANGE, .start = 0x2d, .end = 0x3f},
+                        {.type = HTTP_TOKEN_HEADER_CONTENT_LENGTH, .start = 0x51, .end = 0x53},
+                        {.type = HTTP_TOKEN_CONTENT, .start = 0x57, .end = 0x62},
+                        // NOTE: when changing this array, do not forget to update httpTokenCount, httpTokenStrings
+                        // fields
+                    },
+                    .httpTokenStrings =
+                        (struct string[]){
+                            StringFromLiteral("HTTP/1.1"),
+                            StringFromLiteral("206"),
+                            StringFromLiteral("bytes 100-110/1234"),
+                            StringFromLiteral("11"),
+                            StringFromLiteral("[ 1, 2, 3 ]"),
+                        },
+                    .content = &StringFromLiteral("[ 1, 2, 3 ]"),
+                    .contentRange = &(struct http_content_range){.start = 100, .end = 110, .total = 1234},
+                },
+        },
+        {
+            // 206 without Content-Length, length comes from Content-Range
+            .httpResponse = &StringFromLiteral(
+                /*** --- Status-Line -------------------------------- ***/
+                "HTTP/1.1 206 Partial Content" CRLF
+                /*** --- Header Fields ------------------------------ ***/
+                /**/ "Accept-Ranges: bytes" CRLF
+                /**/ "Content-Range: bytes 0-10/*" CRLF
+                /**/ CRLF
+                /*** --- Message Body ------------------------------- ***/
+                /**/ "[ 1, 2, 3 ]"),
+            .expected =
+                {
+                    .error = HTTP_PARSER_ERROR_NONE,
+                    .httpTokenCount = 5,
+                    .httpTokens =
+                        // NOTE: when changing this array, do not forget to update httpTokenCount, httpTokenStrings
+                    // fields
+                    (struct http_token[]){
+                        {.type = HTTP_TOKEN_HTTP_VERSION, .start = 0x0, .end = 0x8},
+                        {.type = HTTP_TOKEN_STATUS_CODE, .start = 0x9, .end = 0xc},
+                        {.type = HTTP_TOKEN_HEADER_ACCEPT_RANGES, .start = 0x2d, .end = 0x32},
+                        {.type = HTTP_TOKEN_HEADER_CONTENT_RANGE, .start = 0x43, .end = 0x4f},
+                        {.type = HTTP_TOKEN_CONTENT, .start = 0x53, .end = 0x5e},
+                        // NOTE: when changing this array, do not forget to update httpTokenCount, httpTokenStrings
+                        // fields
+                    },
+                    .httpTokenStrings =
+                        (struct string[]){
+                            StringFromLiteral("HTTP/1.1"),
+                            StringFromLiteral("206"),
+                            StringFromLiteral("bytes"),
+                            StringFromLiteral("bytes 0-10/*"),
+                            StringFromLiteral("[ 1, 2, 3 ]"),
+                        },
+                    .content = &StringFromLiteral("[ 1, 2, 3 ]"),
+                    .contentRange =
+                        &(struct http_content_range){.start = 0, .end = 10, .total = HTTP_CONTENT_RANGE_UNKNOWN},
+                },
+        },
+        {
+            .httpResponse = &StringFromLiteral(
+                /*** --- Status-Line -------------------------------- ***/
+                "HTTP/1.1 200 OK" CRLF
+                /*** --- Header Fields ------------------------------ ***/
+                /**/ "Content-Length: 0" CRLF
+                /**/ CRLF),
+            .expected =
+                {
+                    .error = HTTP_PARSER_ERROR_NONE,
+                    .httpTokenCount = 3,
+                    .httpTokens =
+                        // NOTE: when changing this array, do not forget to update httpTokenCount, httpTokenStrings
+                    // fields
+                    (struct http_token[]){
+                        {.type = HTTP_TOKEN_HTTP_VERSION, .start = 0x0, .end = 0x8},
+                        {.type = HTTP_TOKEN_STATUS_CODE, .start = 0x9, .end = 0xc},
+                        {.type = HTTP_TOKEN_HEADER_CONTENT_LENGTH, .start = 0x21, .end = 0x22},
+                        // NOTE: when changing this array, do not forget to update httpTokenCount, httpTokenStrings
+                        // fields
+                    },
+                    .httpTokenStrings =
+                        (struct string[]){
+                            StringFromLiteral("HTTP/1.1"),
+                            StringFromLiteral("200"),
+                            StringFromLiteral("0"),
+                        },
+                },
+        },
+        {
+            .httpResponse = &StringFromLiteral(
+                /*** --- Status-Line -------------------------------- ***/
+                "HTTP/1.1 206 Partial Content" CRLF
+                /*** --- Header Fields ------------------------------ ***/
+                /**/ "Content-Range: bytes 0-99/1234" CRLF
+                /**/ "Content-Length: 11" CRLF
+                /**/ CRLF
+                /*** --- Message Body ------------------------------- ***/
+                /**/ "[ 1, 2, 3 ]"),
+            .expected =
+                {
+                    .error = HTTP_PARSER_ERROR_CONTENT_RANGE_LENGTH_MISMATCH,
+                },
+        },
+        {
+            .httpResponse = &StringFromLiteral(
+                /*** --- Status-Line -------------------------------- ***/
+                "HTTP/1.1 206 Partial Content" CRLF
+                /*** --- Header Fields ------------------------------ ***/
+                /**/ "Content-Range: bytes 10-0/1234" CRLF
+                /**/ CRLF),
+            .expected =
+                {
+                    .error = HTTP_PARSER_ERROR_CONTENT_RANGE_INVALID,
+                },
+        },
+        {
+            .httpResponse = &StringFromLiteral(
+                /*** --- Status-Line -------------------------------- ***/
+                "HTTP/1.1 206 Partial Content" CRLF
+                /*** --- Header Fields ------------------------------ ***/
+                /**/ "Content-Range: bytes 0-1234/1234" CRLF
+                /**/ CRLF),
+            .expected =
+                {
+                    .error = HTTP_PARSER_ERROR_CONTENT_RANGE_INVALID,
+                },
+        },
+        {
+            .httpResponse = &StringFromLiteral(
+                /*** --- Status-Line -------------------------------- ***/
+                "HTTP/1.1 206 Partial Content" CRLF
+                /*** --- Header Fields ------------------------------ ***/
+                /**/ "Content-Range: items 0-10/20" CRLF
+                /**/ CRLF),
+            .expected =
+                {
+                    .error = HTTP_PARSER_ERROR_CONTENT_RANGE_INVALID,
+                },
+        },
+        {
+            .httpResponse = &StringFromLiteral(
+                /*** --- Status-Line -------------------------------- ***/
+                "HTTP/1.1 416 Range Not Satisfiable" CRLF
+                /*** --- Header Fields ------------------------------ ***/
+                /**/ "Content-Range: bytes */1234" CRLF
+                /**/ "Content-Length: 0" CRLF
+                /**/ CRLF),
+            .expected =
+                {
+                    .error = HTTP_PARSER_ERROR_NONE,
+                    .httpTokenCount = 4,
+                    .httpTokens =
+                        // NOTE: when changing this array, do not forget to update httpTokenCount, httpTokenStrings
+                    // fields
+                    (struct http_token[]){
+                        {.type = HTTP_TOKEN_HTTP_VERSION, .start = 0x0, .end = 0x8},
+                        {.type = HTTP_TOKEN_STATUS_CODE, .start = 0x9, .end = 0xc},
+                        {.type = HTTP_TOKEN_HEADER_CONTENT_RANGE, .start = 0x33, .end = 0x3f},
+                        {.type = HTTP_TOKEN_HEADER_CONTENT_LENGTH, .start = 0x51, .end = 0x52},
+                        // NOTE: when changing this array, do not forget to update httpTokenCount, httpTokenStrings
+                        // fields
+                    },
+                    .httpTokenStrings =
+                        (struct string[]){
+                            StringFromLiteral("HTTP/1.1"),
+                            StringFromLiteral("416"),
+                            StringFromLiteral("bytes */1234"),
+                            StringFromLiteral("0"),
+                        },
+                    .contentRange = &(struct http_content_range){.start = HTTP_CONTENT_RANGE_UNKNOWN,
+                                                                 .end = HTTP_CONTENT_RANGE_UNKNOWN,
+                                                                 .total = 1234},
+                },
+        },
 #undef CRLF
     };
 
@@ -607,8 +804,9 @@ main(void)
         StringBuilderAppendString(contentBuilder, &data);
       }
 
-      struct string content = StringBuilderFlush(contentBuilder);
-      struct string *expectedContent = testCase->expected.content;
+      struct string content = contentBuilder->length != 0 ? StringBuilderFlush(contentBuilder) : StringNull();
+      struct string noContent = StringNull();
+      struct string *expectedContent = testCase->expected.content ? testCase->expected.content : &noContent;
       if (!IsStringEqual(&content, expectedContent)) {
         errorCode = expectedError == HTTP_PARSER_ERROR_NONE ? HTTP_PARSER_TEST_ERROR_PARSE_EXPECTED_TRUE
                                                             : HTTP_PARSER_TEST_ERROR_PARSE_EXPECTED_FALSE;
@@ -630,6 +828,39 @@ main(void)
         continue;
       }
 
+      // Test content range
+      struct http_content_range *expectedContentRange = testCase->expected.contentRange;
+      struct http_content_range *gotContentRange = &httpParser->contentRange;
+      if (expectedContentRange && (expectedContentRange->start != gotContentRange->start ||
+                                   expectedContentRange->end != gotContentRange->end ||
+                                   expectedContentRange->total != gotContentRange->total)) {
+        errorCode = HTTP_PARSER_TEST_ERROR_PARSE_EXPECTED_TRUE;
+        if (failedTestCount == 0) {
+          StringBuilderAppendString(sb, GetHttpParserTestErrorMessage(errorCode));
+          StringBuilderAppendStringLiteral(sb, "\nHTTP response:\n```\n");
+          StringBuilderAppendPrintableHexDump(sb, httpResponse);
+          StringBuilderAppendStringLiteral(sb, "\n```");
+        }
+        StringBuilderAppendStringLiteral(sb, "\n  expected content range: ");
+        StringBuilderAppendU64(sb, expectedContentRange->start);
+        StringBuilderAppendStringLiteral(sb, "-");
+        StringBuilderAppendU64(sb, expectedContentRange->end);
+        StringBuilderAppendStringLiteral(sb, "/");
+        StringBuilderAppendU64(sb, expectedContentRange->total);
+        StringBuilderAppendStringLiteral(sb, "\n                   but got: ");
+        StringBuilderAppendU64(sb, gotContentRange->start);
+        StringBuilderAppendStringLiteral(sb, "-");
+        StringBuilderAppendU64(sb, gotContentRange->end);
+        StringBuilderAppendStringLiteral(sb, "/");
+        StringBuilderAppendU64(sb, gotContentRange->total);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+
+        failedTestCount++;
+        continue;
+      }
+
       MemoryTempEnd(&tempMemory);
     }
   }
@@ -945,5 +1176,497 @@ main(void)
     }
   }
 
+  // Streaming parser must keep content of content-length body that arrives in pieces
+  {
+    struct string response = StringFromLiteral("HTTP/1.1 200 OK\r\n"
+                                               "Content-Length: 10\r\n"
+                                               "\r\n"
+                                               "0123456789");
+    struct string expectedContent = StringFromLiteral("0123456789");
+    // headers, then body split in middle, then last byte alone
+    u64 firstPacketLengths[] = {17, 39, 43, 48};
+
+    for (u32 testCaseIndex = 0; testCaseIndex < ARRAY_COUNT(firstPacketLengths); testCaseIndex++) {
+      memory_temp tempMemory = MemoryTempBegin(&stackMemory);
+      u64 firstPacketLength = firstPacketLengths[testCaseIndex];
+      struct http_parser *httpParser = MakeHttpStreamingParser(tempMemory.arena, 8);
+
+      struct string packet = StringSlice(&response, 0, firstPacketLength);
+      b8 ok = HttpParse(httpParser, &packet);
+      if (!ok && httpParser->error == HTTP_PARSER_ERROR_PARTIAL) {
+        packet = StringSlice(&response, httpParser->position, response.length);
+        ok = HttpParse(httpParser, &packet);
+      }
+
+      struct http_token *lastHttpToken = httpParser->tokens + httpParser->tokenCount - 1;
+      struct string content = StringNull();
+      if (ok && httpParser->tokenCount != 0 && lastHttpToken->type == HTTP_TOKEN_CONTENT)
+        content = HttpTokenExtractString(lastHttpToken, &response);
+      if (!ok || !IsStringEqual(&content, &expectedContent)) {
+        errorCode = HTTP_PARSER_TEST_ERROR_PARSE_EXPECTED_TRUE;
+        StringBuilderAppendString(sb, GetHttpParserTestErrorMessage(errorCode));
+        StringBuilderAppendStringLiteral(sb, "\n  first packet length: ");
+        StringBuilderAppendU64(sb, firstPacketLength);
+        StringBuilderAppendStringLiteral(sb, "\n  expected error: ");
+        StringBuilderAppendHttpParserError(sb, HTTP_PARSER_ERROR_NONE);
+        StringBuilderAppendStringLiteral(sb, "\n  got error: ");
+        StringBuilderAppendHttpParserError(sb, httpParser->error);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+      }
+
+      MemoryTempEnd(&tempMemory);
+    }
+  }
+
+  // Streaming parser must parse long chunked body with fixed number of tokens
+  {
+    struct test_case {
+      u32 httpTokenMax;
+      u32 chunkCount;
+      u32 packetLength;
+      b8 isStreaming;
+      struct {
+        enum http_parser_error error;
+      } expected;
+    } testCases[] = {
+        {
+            .httpTokenMax = 8,
+            .chunkCount = 300,
+            .packetLength = 7,
+            .isStreaming = 1,
+            .expected = {.error = HTTP_PARSER_ERROR_NONE},
+        },
+        {
+            .httpTokenMax = 8,
+            .chunkCount = 300,
+            .packetLength = 4096,
+            .isStreaming = 1,
+            .expected = {.error = HTTP_PARSER_ERROR_NONE},
+        },
+        {
+            .httpTokenMax = 8,
+            .chunkCount = 300,
+            .packetLength = 4096,
+            .isStreaming = 0,
+            .expected = {.error = HTTP_PARSER_ERROR_OUT_OF_MEMORY},
+        },
+    };
+
+    for (u32 testCaseIndex = 0; testCaseIndex < ARRAY_COUNT(testCases); testCaseIndex++) {
+      memory_temp tempMemory = MemoryTempBegin(&stackMemory);
+      struct test_case *testCase = testCases + testCaseIndex;
+
+      // build response, chunk data contains CRLF on purpose
+      string_builder *responseBuilder = MakeStringBuilder(tempMemory.arena, 64 * KILOBYTES, 32);
+      string_builder *expectedContentBuilder = MakeStringBuilder(tempMemory.arena, 32 * KILOBYTES, 32);
+      StringBuilderAppendStringLiteral(responseBuilder, "HTTP/1.1 200 OK\r\n"
+                                                        "Content-Type: application/json\r\n"
+                                                        "Transfer-Encoding: chunked\r\n"
+                                                        "\r\n");
+      for (u32 chunkIndex = 0; chunkIndex < testCase->chunkCount; chunkIndex++) {
+        u64 chunkLength = 2 + (chunkIndex % 10);
+        StringBuilderAppendHex(responseBuilder, chunkLength);
+        StringBuilderAppendStringLiteral(responseBuilder, "\r\n");
+        for (u64 index = 0; index < chunkLength; index++) {
+          struct string *character = (index % 4 == 0) ? &StringFromLiteral("\r\n") : &StringFromLiteral("ab");
+          struct string piece = StringSlice(character, index % 2, index % 2 + 1);
+          StringBuilderAppendString(responseBuilder, &piece);
+          StringBuilderAppendString(expectedContentBuilder, &piece);
+        }
+        StringBuilderAppendStringLiteral(responseBuilder, "\r\n");
+      }
+      StringBuilderAppendStringLiteral(responseBuilder, "0\r\n\r\n");
+      struct string response = StringBuilderFlush(responseBuilder);
+      struct string expectedContent = StringBuilderFlush(expectedContentBuilder);
+
+      struct http_parser *httpParser = testCase->isStreaming
+                                           ? MakeHttpStreamingParser(tempMemory.arena, testCase->httpTokenMax)
+                                           : MakeHttpParser(tempMemory.arena, testCase->httpTokenMax);
+
+      // feed response in pieces, like socket does. first packet carries status line.
+      string_builder *contentBuilder = MakeStringBuilder(tempMemory.arena, 32 * KILOBYTES, 0);
+      u64 filled = 32;
+      while (1) {
+        if (filled > response.length)
+          filled = response.length;
+
+        b8 ok;
+        do {
+          struct string packet = StringSlice(&response, httpParser->position, filled);
+          ok = HttpParse(httpParser, &packet);
+
+          for (u32 httpTokenIndex = httpParser->headerTokenCount; httpTokenIndex < httpParser->tokenCount;
+               httpTokenIndex++) {
+            struct http_token *httpToken = httpParser->tokens + httpTokenIndex;
+            if (httpToken->type != HTTP_TOKEN_CHUNK_DATA || httpToken->end == 0)
+              continue;
+            struct string data = HttpTokenExtractString(httpToken, &response);
+            StringBuilderAppendString(contentBuilder, &data);
+          }
+        } while (httpParser->error == HTTP_PARSER_ERROR_PAUSED);
+
+        if (ok || httpParser->error != HTTP_PARSER_ERROR_PARTIAL || filled == response.length)
+          break;
+
+        filled += testCase->packetLength;
+      }
+
+      enum http_parser_error expectedError = testCase->expected.error;
+      enum http_parser_error gotError = httpParser->error;
+      if (gotError != expectedError) {
+        errorCode = expectedError == HTTP_PARSER_ERROR_NONE ? HTTP_PARSER_TEST_ERROR_PARSE_EXPECTED_TRUE
+                                                            : HTTP_PARSER_TEST_ERROR_PARSE_EXPECTED_FALSE;
+        StringBuilderAppendString(sb, GetHttpParserTestErrorMessage(errorCode));
+        StringBuilderAppendStringLiteral(sb, "\n  streaming: ");
+        StringBuilderAppendBool(sb, testCase->isStreaming);
+        StringBuilderAppendStringLiteral(sb, " token max: ");
+        StringBuilderAppendU32(sb, testCase->httpTokenMax);
+        StringBuilderAppendStringLiteral(sb, " packet length: ");
+        StringBuilderAppendU32(sb, testCase->packetLength);
+        StringBuilderAppendStringLiteral(sb, "\n  expected error: ");
+        StringBuilderAppendHttpParserError(sb, expectedError);
+        StringBuilderAppendStringLiteral(sb, "\n  got error: ");
+        StringBuilderAppendHttpParserError(sb, gotError);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+        MemoryTempEnd(&tempMemory);
+        continue;
+      }
+
+      if (expectedError != HTTP_PARSER_ERROR_NONE) {
+        MemoryTempEnd(&tempMemory);
+        continue;
+      }
+
+      struct string content = StringBuilderFlush(contentBuilder);
+      if (!IsStringEqual(&content, &expectedContent)) {
+        errorCode = HTTP_PARSER_TEST_ERROR_PARSE_EXPECTED_TRUE;
+        StringBuilderAppendString(sb, GetHttpParserTestErrorMessage(errorCode));
+        StringBuilderAppendStringLiteral(sb, "\n  packet length: ");
+        StringBuilderAppendU32(sb, testCase->packetLength);
+        StringBuilderAppendStringLiteral(sb, "\n  expected content length: ");
+        StringBuilderAppendU64(sb, expectedContent.length);
+        StringBuilderAppendStringLiteral(sb, "\n                      got: ");
+        StringBuilderAppendU64(sb, content.length);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+      }
+
+      MemoryTempEnd(&tempMemory);
+    }
+  }
+
+  // Parser must parse pipelined responses in order from same stream
+  {
+    struct string stream = StringFromLiteral(
+        // content-length
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Length: 11\r\n"
+        "\r\n"
+        "[ 1, 2, 3 ]"
+        // no content
+        "HTTP/1.1 204 No Content\r\n"
+        "Date: Fri, 18 Apr 2025 07:14:00 GMT\r\n"
+        "\r\n"
+        // chunked with trailer
+        "HTTP/1.1 200 OK\r\n"
+        "Transfer-Encoding: chunked\r\n"
+        "\r\n"
+        "5\r\n"
+        "[ 4, \r\n"
+        "6\r\n"
+        "5, 6 ]\r\n"
+        "0\r\n"
+        "Expires: Fri, 18 Apr 2025 07:14:00 GMT\r\n"
+        "\r\n"
+        // partial content, last one
+        "HTTP/1.1 206 Partial Content\r\n"
+        "Content-Range: bytes 0-2/3\r\n"
+        "Connection: close\r\n"
+        "\r\n"
+        "[7]");
+
+    struct expected_response {
+      u16 statusCode;
+      struct string content;
+    } expectedResponses[] = {
+        {.statusCode = 200, .content = StringFromLiteral("[ 1, 2, 3 ]")},
+        {.statusCode = 204, .content = StringNull()},
+        {.statusCode = 200, .content = StringFromLiteral("[ 4, 5, 6 ]")},
+        {.statusCode = 206, .content = StringFromLiteral("[7]")},
+    };
+
+    u64 packetLengths[] = {1, 5, 64, stream.length};
+    for (u32 packetLengthIndex = 0; packetLengthIndex < ARRAY_COUNT(packetLengths); packetLengthIndex++) {
+      memory_temp tempMemory = MemoryTempBegin(&stackMemory);
+      u64 packetLength = packetLengths[packetLengthIndex];
+
+      struct http_parser *httpParser = MakeHttpStreamingParser(tempMemory.arena, 16);
+      string_builder *contentBuilder = MakeStringBuilder(tempMemory.arena, 1 * KILOBYTES, 0);
+
+      u32 responseCount = 0;
+      b8 isFailed = 0;
+      for (u64 filled = 0; filled < stream.length && !isFailed;) {
+        filled += packetLength;
+        if (filled > stream.length)
+          filled = stream.length;
+
+        while (httpParser->position != filled) {
+          b8 ok;
+          do {
+            struct string packet = StringSlice(&stream, httpParser->position, filled);
+            ok = HttpParse(httpParser, &packet);
+
+            for (u32 httpTokenIndex = httpParser->headerTokenCount; httpTokenIndex < httpParser->tokenCount;
+                 httpTokenIndex++) {
+              struct http_token *httpToken = httpParser->tokens + httpTokenIndex;
+              if ((httpToken->type != HTTP_TOKEN_CHUNK_DATA && httpToken->type != HTTP_TOKEN_CONTENT) ||
+                  httpToken->end == 0)
+                continue;
+              struct string data = HttpTokenExtractString(httpToken, &stream);
+              StringBuilderAppendString(contentBuilder, &data);
+            }
+          } while (httpParser->error == HTTP_PARSER_ERROR_PAUSED);
+
+          if (httpParser->error == HTTP_PARSER_ERROR_PARTIAL)
+            break;
+
+          struct expected_response *expected =
+              responseCount < ARRAY_COUNT(expectedResponses) ? expectedResponses + responseCount : 0;
+          struct string content = contentBuilder->length != 0 ? StringBuilderFlush(contentBuilder) : StringNull();
+          b8 isLast = responseCount + 1 == ARRAY_COUNT(expectedResponses);
+          b8 isConnectionClose = (httpParser->state & HTTP_PARSER_STATE_CONNECTION_CLOSE) != 0;
+          if (!ok || !expected || httpParser->statusCode != expected->statusCode ||
+              !IsStringEqual(&content, &expected->content) || isConnectionClose != isLast) {
+            errorCode = HTTP_PARSER_TEST_ERROR_PARSE_EXPECTED_TRUE;
+            StringBuilderAppendString(sb, GetHttpParserTestErrorMessage(errorCode));
+            StringBuilderAppendStringLiteral(sb, "\n  packet length: ");
+            StringBuilderAppendU64(sb, packetLength);
+            StringBuilderAppendStringLiteral(sb, "\n  response: ");
+            StringBuilderAppendU32(sb, responseCount);
+            StringBuilderAppendStringLiteral(sb, "\n  error: ");
+            StringBuilderAppendHttpParserError(sb, httpParser->error);
+            StringBuilderAppendStringLiteral(sb, "\n  status code: ");
+            StringBuilderAppendU16(sb, httpParser->statusCode);
+            StringBuilderAppendStringLiteral(sb, "\n  content:\n");
+            StringBuilderAppendPrintableHexDump(sb, &content);
+            StringBuilderAppendStringLiteral(sb, "\n");
+            struct string errorMessage = StringBuilderFlush(sb);
+            PrintString(&errorMessage);
+            isFailed = 1;
+            break;
+          }
+
+          responseCount++;
+          HttpParserNext(httpParser);
+        }
+      }
+
+      if (!isFailed && responseCount != ARRAY_COUNT(expectedResponses)) {
+        errorCode = HTTP_PARSER_TEST_ERROR_PARSE_EXPECTED_TRUE;
+        StringBuilderAppendString(sb, GetHttpParserTestErrorMessage(errorCode));
+        StringBuilderAppendStringLiteral(sb, "\n  packet length: ");
+        StringBuilderAppendU64(sb, packetLength);
+        StringBuilderAppendStringLiteral(sb, "\n  expected response count: ");
+        StringBuilderAppendU32(sb, ARRAY_COUNT(expectedResponses));
+        StringBuilderAppendStringLiteral(sb, "\n                      got: ");
+        StringBuilderAppendU32(sb, responseCount);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+      }
+
+      MemoryTempEnd(&tempMemory);
+    }
+  }
+
+  // Length of response must be known once headers of content-length body are parsed
+  {
+    struct test_case {
+      struct string response;
+      u64 filled;
+      u64 expected;
+    } testCases[] = {
+        {
+            .response = StringFromLiteral("HTTP/1.1 200 OK\r\n"
+                                          "Content-Length: 11\r\n"
+                                          "\r\n"
+                                          "[ 1, 2, 3 ]"),
+            .filled = 20,
+            .expected = 0,
+        },
+        {
+            .response = StringFromLiteral("HTTP/1.1 200 OK\r\n"
+                                          "Content-Length: 11\r\n"
+                                          "\r\n"
+                                          "[ 1, 2, 3 ]"),
+            .filled = 40,
+            .expected = 50,
+        },
+        {
+            .response = StringFromLiteral("HTTP/1.1 200 OK\r\n"
+                                          "Content-Length: 11\r\n"
+                                          "\r\n"
+                                          "[ 1, 2, 3 ]"),
+            .filled = 45,
+            .expected = 50,
+        },
+        {
+            .response = StringFromLiteral("HTTP/1.1 200 OK\r\n"
+                                          "Transfer-Encoding: chunked\r\n"
+                                          "\r\n"
+                                          "5\r\n"
+                                          "[ 4, \r\n"
+                                          "0\r\n"
+                                          "\r\n"),
+            .filled = 50,
+            .expected = 0,
+        },
+    };
+
+    for (u32 testCaseIndex = 0; testCaseIndex < ARRAY_COUNT(testCases); testCaseIndex++) {
+      struct test_case *testCase = testCases + testCaseIndex;
+      memory_temp tempMemory = MemoryTempBegin(&stackMemory);
+
+      struct http_parser *httpParser = MakeHttpParser(tempMemory.arena, 16);
+      struct string packet = StringSlice(&testCase->response, 0, testCase->filled);
+      HttpParse(httpParser, &packet);
+
+      u64 got = HttpParserResponseLength(httpParser);
+      if (got != testCase->expected) {
+        errorCode = HTTP_PARSER_TEST_ERROR_PARSE_EXPECTED_TRUE;
+        StringBuilderAppendString(sb, GetHttpParserTestErrorMessage(errorCode));
+        StringBuilderAppendStringLiteral(sb, "\n  filled: ");
+        StringBuilderAppendU64(sb, testCase->filled);
+        StringBuilderAppendStringLiteral(sb, "\n  expected response length: ");
+        StringBuilderAppendU64(sb, testCase->expected);
+        StringBuilderAppendStringLiteral(sb, "\n                       got: ");
+        StringBuilderAppendU64(sb, got);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+      }
+
+      MemoryTempEnd(&tempMemory);
+    }
+  }
+
+  // Retry-After must be given in seconds, date form relative to Date of response
+  {
+    comptime u64 NONE = (u64)-1;
+    struct test_case {
+      struct string response;
+      u64 expected;
+    } testCases[] = {
+        {
+            .response = StringFromLiteral("HTTP/1.1 429 Too Many Requests\r\n"
+                                          "Retry-After: 120\r\n"
+                                          "Content-Length: 0\r\n"
+                                          "\r\n"),
+            .expected = 120,
+        },
+        {
+            // Date may come after Retry-After
+            .response = StringFromLiteral("HTTP/1.1 503 Service Unavailable\r\n"
+                                          "Retry-After: Fri, 31 Dec 1999 23:59:59 GMT\r\n"
+                                          "Date: Fri, 31 Dec 1999 23:58:29 GMT\r\n"
+                                          "Content-Length: 0\r\n"
+                                          "\r\n"),
+            .expected = 90,
+        },
+        {
+            // leap day, date in past
+            .response = StringFromLiteral("HTTP/1.1 429 Too Many Requests\r\n"
+                                          "Date: Thu, 29 Feb 2024 12:00:00 GMT\r\n"
+                                          "Retry-After: Thu, 29 Feb 2024 11:00:00 GMT\r\n"
+                                          "Content-Length: 0\r\n"
+                                          "\r\n"),
+            .expected = 0,
+        },
+        {
+            // date cannot be compared without Date
+            .response = StringFromLiteral("HTTP/1.1 429 Too Many Requests\r\n"
+                                          "Retry-After: Fri, 31 Dec 1999 23:59:59 GMT\r\n"
+                                          "Content-Length: 0\r\n"
+                                          "\r\n"),
+            .expected = NONE,
+        },
+        {
+            // invalid value is ignored, response is still parsed
+            .response = StringFromLiteral("HTTP/1.1 429 Too Many Requests\r\n"
+                                          "Retry-After: soon\r\n"
+                                          "Content-Length: 0\r\n"
+                                          "\r\n"),
+            .expected = NONE,
+        },
+        {
+            .response = StringFromLiteral("HTTP/1.1 200 OK\r\n"
+                                          "Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n"
+                                          "Content-Length: 0\r\n"
+                                          "\r\n"),
+            .expected = NONE,
+        },
+    };
+
+    for (u32 testCaseIndex = 0; testCaseIndex < ARRAY_COUNT(testCases); testCaseIndex++) {
+      struct test_case *testCase = testCases + testCaseIndex;
+      memory_temp tempMemory = MemoryTempBegin(&stackMemory);
+
+      struct http_parser *httpParser = MakeHttpParser(tempMemory.arena, 16);
+      b8 isParsed = HttpParse(httpParser, &testCase->response);
+      u64 got = (httpParser->state & HTTP_PARSER_STATE_HAS_RETRY_AFTER) ? httpParser->retryAfter : NONE;
+      if (!isParsed || got != testCase->expected) {
+        errorCode = HTTP_PARSER_TEST_ERROR_PARSE_EXPECTED_TRUE;
+        StringBuilderAppendString(sb, GetHttpParserTestErrorMessage(errorCode));
+        StringBuilderAppendStringLiteral(sb, "\n  response: ");
+        StringBuilderAppendString(sb, &testCase->response);
+        StringBuilderAppendStringLiteral(sb, "\n  expected retry after: ");
+        StringBuilderAppendU64(sb, testCase->expected);
+        StringBuilderAppendStringLiteral(sb, "\n                   got: ");
+        StringBuilderAppendU64(sb, got);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+      }
+
+      MemoryTempEnd(&tempMemory);
+    }
+  }
+
+  // b8 HttpParseDate(struct string *value, u64 *unixTime)
+  {
+    u64 unixTime = 0;
+    b8 isExpected = HttpParseDate(&StringFromLiteral("Sun, 06 Nov 1994 08:49:37 GMT"), &unixTime) &&
+                    unixTime == 784111777;
+    isExpected = isExpected && HttpParseDate(&StringFromLiteral("Thu, 01 Jan 1970 00:00:00 GMT"), &unixTime) &&
+                 unixTime == 0;
+    // RFC 850 and asctime formats
+    isExpected = isExpected && !HttpParseDate(&StringFromLiteral("Sunday, 06-Nov-94 08:49:37 GMT"), &unixTime);
+    isExpected = isExpected && !HttpParseDate(&StringFromLiteral("Sun Nov  6 08:49:37 1994"), &unixTime);
+    isExpected = isExpected && !HttpParseDate(&StringFromLiteral("Sun, 06 Foo 1994 08:49:37 GMT"), &unixTime);
+    isExpected = isExpected && !HttpParseDate(&StringFromLiteral("Sun, 06 Nov 1994 25:49:37 GMT"), &unixTime);
+
+    // b8 HttpParseRetryAfter(struct string *value, struct string *date, u64 *seconds)
+    u64 seconds = 0;
+    struct string *date = &StringFromLiteral("Sun, 06 Nov 1994 08:49:37 GMT");
+    isExpected = isExpected && HttpParseRetryAfter(&StringFromLiteral("7"), 0, &seconds) && seconds == 7;
+    isExpected = isExpected &&
+                 HttpParseRetryAfter(&StringFromLiteral("Sun, 06 Nov 1994 08:50:07 GMT"), date, &seconds) &&
+                 seconds == 30;
+    isExpected = isExpected && !HttpParseRetryAfter(&StringFromLiteral("Sun, 06 Nov 1994 08:50:07 GMT"), 0, &seconds);
+    isExpected = isExpected && !HttpParseRetryAfter(&StringFromLiteral("-1"), date, &seconds);
+    if (!isExpected) {
+      errorCode = HTTP_PARSER_TEST_ERROR_PARSE_EXPECTED_TRUE;
+      StringBuilderAppendString(sb, GetHttpParserTestErrorMessage(errorCode));
+      StringBuilderAppendStringLiteral(sb, "\n  date is not parsed as expected\n");
+      struct string errorMessage = StringBuilderFlush(sb);
+      PrintString(&errorMessage);
+    }
+  }
+
   return (int)errorCode;
 }
@@ -0,0 +1,387 @@
+#include "http_pipeline.c"
+#include "print.h"
+#include "string_builder.h"
+
+#define TEST_ERROR_LIST(X)                                                                                             \
+  X(PIPELINE_BATCH, "Batch must be requests rendered back to back")                                                    \
+  X(PIPELINE_ORDER, "Responses must complete requests in order they are sent")                                         \
+  X(PIPELINE_EXPECTED, "Pipeline must finish in expected number of writes and connections")                           \
+  X(PIPELINE_RESEND, "Resend must send requests in flight again and keep depth")                                       \
+  X(PIPELINE_ADD, "Added requests must be sent after ones before them")
+
+enum http_pipeline_test_error {
+  HTTP_PIPELINE_TEST_ERROR_NONE = 0,
+#define X(tag, message) HTTP_PIPELINE_TEST_ERROR_##tag,
+  TEST_ERROR_LIST(X)
+#undef X
+
+  // src: https://mesonbuild.com/Unit-tests.html#skipped-tests-and-hard-errors
+  // For the default exitcode testing protocol, the GNU standard approach in
+  // this case is to exit the program with error code 77. Meson will detect this
+  // and report these tests as skipped rather than failed. This behavior was
+  // added in version 0.37.0.
+  MESON_TEST_SKIP = 77,
+  // In addition, sometimes a test fails set up so that it should fail even if
+  // it is marked as an expected failure. The GNU standard approach in this case
+  // is to exit the program with error code 99. Again, Meson will detect this
+  // and report these tests as ERROR, ignoring the setting of should_fail. This
+  // behavior was added in version 0.50.0.
+  MESON_TEST_FAILED_TO_SET_UP = 99,
+};
+
+internalfn void
+StringBuilderAppendTestError(struct string_builder *sb, enum http_pipeline_test_error errorCode)
+{
+  struct string message = StringFromLiteral("Unknown error");
+  struct error {
+    enum http_pipeline_test_error code;
+    struct string message;
+  } errors[] = {
+#define XX(tag, msg) {.code = HTTP_PIPELINE_TEST_ERROR_##tag, .message = StringFromLiteral(msg)},
+      TEST_ERROR_LIST(XX)
+#undef XX
+  };
+
+  for (u32 errorIndex = 0; errorIndex < ARRAY_COUNT(errors); errorIndex++) {
+    struct error *error = errors + errorIndex;
+    if (error->code != errorCode)
+      continue;
+
+    message = error->message;
+    break;
+  }
+
+  StringBuilderAppendString(sb, &message);
+}
+
+int
+main(void)
+{
+  enum http_pipeline_test_error errorCode = HTTP_PIPELINE_TEST_ERROR_NONE;
+
+  // setup
+  enum {
+    KILOBYTES = (1 << 10),
+    MEGABYTES = (1 << 20),
+  };
+  u8 stackBuffer[1 * MEGABYTES];
+  memory_arena stackMemory = {
+      .block = stackBuffer,
+      .total = ARRAY_COUNT(stackBuffer),
+  };
+
+  string_builder *sb = MakeStringBuilder(&stackMemory, 128 * KILOBYTES, 32);
+
+  struct http_request_info templateInfo = {
+      .method = HTTP_METHOD_GET,
+      .version = HTTP_VERSION_11,
+      .host = StringFromLiteral("i.iii.st"),
+      .path = StringFromLiteral("/api/v1/videos/" HTTP_REQUEST_TEMPLATE_SLOT),
+  };
+  struct http_request_template *template = MakeHttpRequestTemplate(&stackMemory, &templateInfo);
+  if (!template)
+    return MESON_TEST_FAILED_TO_SET_UP;
+
+  struct string videoIds[] = {
+      StringFromLiteral("d_oVysaqG_0"), StringFromLiteral("aqz-KE-bpKQ"), StringFromLiteral("YE7VzlLtp-4"),
+      StringFromLiteral("eRsGyueVLvQ"), StringFromLiteral("R6MlUcmOul8"), StringFromLiteral("WhWc3b3KhnY"),
+  };
+  u32 requestMax = 100;
+  struct string *values = MemoryArenaPush(&stackMemory, sizeof(*values) * requestMax);
+  for (u32 requestIndex = 0; requestIndex < requestMax; requestIndex++)
+    values[requestIndex] = videoIds[requestIndex % ARRAY_COUNT(videoIds)];
+  u64 requestLength = HttpRequestTemplateLength(template, values);
+
+  comptime u32 SERVER_LIMIT_NONE = (u32)-1;
+
+  // struct string HttpPipelineBatch(struct http_pipeline *pipeline, struct http_request_template *template,
+  //                                 struct string *values, struct string *buffer)
+  // u32 HttpPipelineComplete(struct http_pipeline *pipeline)
+  // b8 HttpPipelineClose(struct http_pipeline *pipeline)
+  {
+    struct test_case {
+      u32 requestCount;
+      u32 depthMax;
+      // set by caller, 0 leaves it at depthMax
+      u32 limit;
+      // how many responses server gives on every connection before closing it,
+      // last one is used for rest of connections
+      u32 serverLimitCount;
+      u32 *serverLimits;
+      // how many requests fit in write buffer
+      u32 bufferRequestCount;
+
+      b8 expectedIsDone;
+      u32 expectedWriteCount;
+      u32 expectedConnectionCount;
+      u32 expectedDepth;
+    } testCases[] = {
+        {
+            // 100 videos in handful of round trips
+            .requestCount = 100,
+            .depthMax = 16,
+            .serverLimitCount = 1,
+            .serverLimits = (u32[]){SERVER_LIMIT_NONE},
+            .bufferRequestCount = 16,
+            .expectedIsDone = 1,
+            .expectedWriteCount = 7,
+            .expectedConnectionCount = 1,
+            .expectedDepth = 16,
+        },
+        {
+            // server answers 3 requests then closes connection
+            .requestCount = 10,
+            .depthMax = 8,
+            .serverLimitCount = 1,
+            .serverLimits = (u32[]){3},
+            .bufferRequestCount = 16,
+            .expectedIsDone = 1,
+            .expectedWriteCount = 4,
+            .expectedConnectionCount = 4,
+            .expectedDepth = 3,
+        },
+        {
+            // depth grows back when server keeps connection open
+            .requestCount = 12,
+            .depthMax = 4,
+            .serverLimitCount = 2,
+            .serverLimits = (u32[]){1, SERVER_LIMIT_NONE},
+            .bufferRequestCount = 16,
+            .expectedIsDone = 1,
+            .expectedWriteCount = 6,
+            .expectedConnectionCount = 2,
+            .expectedDepth = 4,
+        },
+        {
+            // batch is limited by write buffer
+            .requestCount = 5,
+            .depthMax = 8,
+            .serverLimitCount = 1,
+            .serverLimits = (u32[]){SERVER_LIMIT_NONE},
+            .bufferRequestCount = 2,
+            .expectedIsDone = 1,
+            .expectedWriteCount = 3,
+            .expectedConnectionCount = 1,
+            .expectedDepth = 8,
+        },
+        {
+            // no pipelining
+            .requestCount = 4,
+            .depthMax = 1,
+            .serverLimitCount = 1,
+            .serverLimits = (u32[]){SERVER_LIMIT_NONE},
+            .bufferRequestCount = 16,
+            .expectedIsDone = 1,
+            .expectedWriteCount = 4,
+            .expectedConnectionCount = 1,
+            .expectedDepth = 1,
+        },
+        {
+            // caller allows fewer requests in flight than depth
+            .requestCount = 10,
+            .depthMax = 8,
+            .limit = 3,
+            .serverLimitCount = 1,
+            .serverLimits = (u32[]){SERVER_LIMIT_NONE},
+            .bufferRequestCount = 16,
+            .expectedIsDone = 1,
+            .expectedWriteCount = 4,
+            .expectedConnectionCount = 1,
+            .expectedDepth = 8,
+        },
+        {
+            // server closes connection without answering
+            .requestCount = 4,
+            .depthMax = 4,
+            .serverLimitCount = 2,
+            .serverLimits = (u32[]){2, 0},
+            .bufferRequestCount = 16,
+            .expectedIsDone = 0,
+            .expectedWriteCount = 2,
+            .expectedConnectionCount = 2,
+            .expectedDepth = 1,
+        },
+    };
+
+    for (u32 testCaseIndex = 0; testCaseIndex < ARRAY_COUNT(testCases); testCaseIndex++) {
+      memory_temp tempMemory = MemoryTempBegin(&stackMemory);
+      struct test_case *testCase = testCases + testCaseIndex;
+      debug_assert(testCase->requestCount <= requestMax);
+
+      struct string *buffer = MakeString(tempMemory.arena, requestLength * testCase->bufferRequestCount + 1);
+      struct string *expectedBatchBuffer = MakeString(tempMemory.arena, buffer->length);
+
+      struct http_pipeline pipeline;
+      HttpPipelineInit(&pipeline, testCase->requestCount, testCase->depthMax);
+      if (testCase->limit != 0)
+        pipeline.limit = testCase->limit;
+
+      u32 writeCount = 0;
+      u32 connectionCount = 0;
+      u32 expectedRequestIndex = 0;
+      while (!HttpPipelineIsDone(&pipeline) && errorCode == HTTP_PIPELINE_TEST_ERROR_NONE) {
+        u32 serverLimitIndex = connectionCount;
+        if (serverLimitIndex >= testCase->serverLimitCount)
+          serverLimitIndex = testCase->serverLimitCount - 1;
+        u32 serverLimit = testCase->serverLimits[serverLimitIndex];
+        u32 servedCount = 0;
+        connectionCount++;
+
+        while (1) {
+          u32 firstRequestIndex = pipeline.sentCount;
+          struct string batch = HttpPipelineBatch(&pipeline, template, values, buffer);
+          if (batch.length != 0)
+            writeCount++;
+
+          // batch must be same as requests rendered one after another
+          u64 expectedBatchLength = 0;
+          for (u32 requestIndex = firstRequestIndex; requestIndex < pipeline.sentCount; requestIndex++) {
+            struct string remaining = StringFromBuffer(expectedBatchBuffer->value + expectedBatchLength,
+                                                       expectedBatchBuffer->length - expectedBatchLength);
+            struct string request = HttpRequestTemplateRender(template, values + requestIndex, &remaining);
+            expectedBatchLength += request.length;
+          }
+          struct string expectedBatch = StringFromBuffer(expectedBatchBuffer->value, expectedBatchLength);
+          if (!IsStringEqual(&expectedBatch, &batch)) {
+            errorCode = HTTP_PIPELINE_TEST_ERROR_PIPELINE_BATCH;
+            StringBuilderAppendTestError(sb, errorCode);
+            StringBuilderAppendStringLiteral(sb, "\n  expected:\n");
+            StringBuilderAppendHexDump(sb, &expectedBatch);
+            StringBuilderAppendStringLiteral(sb, "\n       got:\n");
+            StringBuilderAppendHexDump(sb, &batch);
+            StringBuilderAppendStringLiteral(sb, "\n");
+            struct string errorMessage = StringBuilderFlush(sb);
+            PrintString(&errorMessage);
+            break;
+          }
+
+          // server answers what is in flight, in order, until its limit
+          while (HttpPipelineInFlightCount(&pipeline) != 0 && servedCount < serverLimit) {
+            u32 requestIndex = HttpPipelineComplete(&pipeline);
+            servedCount++;
+            if (requestIndex != expectedRequestIndex) {
+              errorCode = HTTP_PIPELINE_TEST_ERROR_PIPELINE_ORDER;
+              StringBuilderAppendTestError(sb, errorCode);
+              StringBuilderAppendStringLiteral(sb, "\n  expected: ");
+              StringBuilderAppendU64(sb, expectedRequestIndex);
+              StringBuilderAppendStringLiteral(sb, "\n       got: ");
+              StringBuilderAppendU64(sb, requestIndex);
+              StringBuilderAppendStringLiteral(sb, "\n");
+              struct string errorMessage = StringBuilderFlush(sb);
+              PrintString(&errorMessage);
+              break;
+            }
+            expectedRequestIndex++;
+          }
+
+          if (errorCode != HTTP_PIPELINE_TEST_ERROR_NONE || HttpPipelineIsDone(&pipeline) || servedCount == serverLimit)
+            break;
+        }
+
+        if (!HttpPipelineClose(&pipeline))
+          break;
+      }
+
+      if (errorCode == HTTP_PIPELINE_TEST_ERROR_NONE &&
+          (HttpPipelineIsDone(&pipeline) != testCase->expectedIsDone || writeCount != testCase->expectedWriteCount ||
+           connectionCount != testCase->expectedConnectionCount || pipeline.depth != testCase->expectedDepth)) {
+        errorCode = HTTP_PIPELINE_TEST_ERROR_PIPELINE_EXPECTED;
+        StringBuilderAppendTestError(sb, errorCode);
+        StringBuilderAppendStringLiteral(sb, "\n  requestCount: ");
+        StringBuilderAppendU64(sb, testCase->requestCount);
+        StringBuilderAppendStringLiteral(sb, " depthMax: ");
+        StringBuilderAppendU64(sb, testCase->depthMax);
+        StringBuilderAppendStringLiteral(sb, "\n  expected: done ");
+        StringBuilderAppendU64(sb, testCase->expectedIsDone);
+        StringBuilderAppendStringLiteral(sb, " writes ");
+        StringBuilderAppendU64(sb, testCase->expectedWriteCount);
+        StringBuilderAppendStringLiteral(sb, " connections ");
+        StringBuilderAppendU64(sb, testCase->expectedConnectionCount);
+        StringBuilderAppendStringLiteral(sb, " depth ");
+        StringBuilderAppendU64(sb, testCase->expectedDepth);
+        StringBuilderAppendStringLiteral(sb, "\n       got: done ");
+        StringBuilderAppendU64(sb, HttpPipelineIsDone(&pipeline));
+        StringBuilderAppendStringLiteral(sb, " writes ");
+        StringBuilderAppendU64(sb, writeCount);
+        StringBuilderAppendStringLiteral(sb, " connections ");
+        StringBuilderAppendU64(sb, connectionCount);
+        StringBuilderAppendStringLiteral(sb, " depth ");
+        StringBuilderAppendU64(sb, pipeline.depth);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+      }
+
+      MemoryTempEnd(&tempMemory);
+    }
+  }
+
+  // void HttpPipelineResend(struct http_pipeline *pipeline)
+  {
+    memory_temp tempMemory = MemoryTempBegin(&stackMemory);
+    struct string *buffer = MakeString(tempMemory.arena, 8 * requestLength);
+
+    struct http_pipeline pipeline;
+    HttpPipelineInit(&pipeline, 6, 4);
+    HttpPipelineBatch(&pipeline, template, values, buffer);
+    HttpPipelineComplete(&pipeline);
+    HttpPipelineComplete(&pipeline);
+    // server refused third request, client closes connection
+    HttpPipelineResend(&pipeline);
+    u32 inFlightCount = HttpPipelineInFlightCount(&pipeline);
+    u32 firstRequestIndex = pipeline.sentCount;
+    HttpPipelineBatch(&pipeline, template, values, buffer);
+
+    if (inFlightCount != 0 || firstRequestIndex != 2 || pipeline.sentCount != 6 || pipeline.depth != 4) {
+      errorCode = HTTP_PIPELINE_TEST_ERROR_PIPELINE_RESEND;
+      StringBuilderAppendTestError(sb, errorCode);
+      StringBuilderAppendStringLiteral(sb, "\n  expected: first 2 sent 6 depth 4");
+      StringBuilderAppendStringLiteral(sb, "\n       got: first ");
+      StringBuilderAppendU64(sb, firstRequestIndex);
+      StringBuilderAppendStringLiteral(sb, " sent ");
+      StringBuilderAppendU64(sb, pipeline.sentCount);
+      StringBuilderAppendStringLiteral(sb, " depth ");
+      StringBuilderAppendU64(sb, pipeline.depth);
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string errorMessage = StringBuilderFlush(sb);
+      PrintString(&errorMessage);
+    }
+
+    MemoryTempEnd(&tempMemory);
+  }
+
+  // void HttpPipelineAdd(struct http_pipeline *pipeline, u32 requestCount)
+  {
+    memory_temp tempMemory = MemoryTempBegin(&stackMemory);
+    struct string *buffer = MakeString(tempMemory.arena, 8 * requestLength);
+
+    struct http_pipeline pipeline;
+    HttpPipelineInit(&pipeline, 2, 4);
+    HttpPipelineBatch(&pipeline, template, values, buffer);
+    HttpPipelineComplete(&pipeline);
+    HttpPipelineComplete(&pipeline);
+    b8 isDone = HttpPipelineIsDone(&pipeline);
+    // more come after every request is answered
+    HttpPipelineAdd(&pipeline, 3);
+    u32 firstRequestIndex = pipeline.sentCount;
+    struct string batch = HttpPipelineBatch(&pipeline, template, values, buffer);
+
+    if (!isDone || HttpPipelineIsDone(&pipeline) || firstRequestIndex != 2 || pipeline.sentCount != 5 ||
+        batch.length != 3 * requestLength) {
+      errorCode = HTTP_PIPELINE_TEST_ERROR_PIPELINE_ADD;
+      StringBuilderAppendTestError(sb, errorCode);
+      StringBuilderAppendStringLiteral(sb, "\n  expected: first 2 sent 5");
+      StringBuilderAppendStringLiteral(sb, "\n       got: first ");
+      StringBuilderAppendU64(sb, firstRequestIndex);
+      StringBuilderAppendStringLiteral(sb, " sent ");
+      StringBuilderAppendU64(sb, pipeline.sentCount);
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string errorMessage = StringBuilderFlush(sb);
+      PrintString(&errorMessage);
+    }
+
+    MemoryTempEnd(&tempMemory);
+  }
+
+  return (int)errorCode;
+}
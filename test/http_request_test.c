@@ -4,7 +4,9 @@
 
 #define TEST_ERROR_LIST(X)                                                                                             \
   X(REQUEST_BUILD_EXPECTED_VAILD, "Valid HTTP request must be built from info")                                        \
-  X(REQUEST_BUILD_EXPECTED_INVALID, "HTTP request must fail to be built from info")
+  X(REQUEST_BUILD_EXPECTED_INVALID, "HTTP request must fail to be built from info")                                    \
+  X(PERCENT_ENCODE, "String must be percent-encoded")                                                                 \
+  X(PERCENT_DECODE, "String must be percent-decoded")
 
 enum http_request_test_error {
   HTTP_REQUEST_TEST_ERROR_NONE = 0,
@@ -84,6 +86,13 @@ StringBuilderAppendPrintableHexDump(string_builder *sb, struct string *string)
   StringBuilderAppendHexDump(sb, string);
 }
 
+// 16 characters, 5 of them reserved, space is +
+#define LONG_VALUE "a b&c=d/e?f%g~h."
+#define LONG_VALUE_ENCODED "a+b%26c%3Dd%2Fe%3Ff%25g~h."
+#define REPEAT_2(s) s s
+#define REPEAT_8(s) REPEAT_2(REPEAT_2(REPEAT_2(s)))
+#define REPEAT_128(s) REPEAT_2(REPEAT_8(REPEAT_8(s)))
+
 int
 main(void)
 {
@@ -195,6 +204,124 @@ main(void)
                 // content
                 "fruit=apple&kind=fuji"),
         },
+        {
+            // reserved characters in form are encoded
+            .requestInfo =
+                {
+                    .method = HTTP_METHOD_POST,
+                    .version = HTTP_VERSION_11,
+                    .path = StringFromLiteral("/test"),
+                    .host = StringFromLiteral("example.com"),
+                    .contentType = HTTP_CONTENT_TYPE_FORM_URLENCODED,
+                    .content = &((struct http_form_urlencoded_list){
+                        .itemCount = 2,
+                        .items =
+                            (struct http_form_urlencoded_item[]){
+                                {.name = StringFromLiteral("a&b"), .value = StringFromLiteral("1+1=2")},
+                                {.name = StringFromLiteral("city"), .value = StringFromLiteral("\xc4\xb0zmir 100%")},
+                            },
+                    }),
+                },
+            .expected = StringFromLiteral(
+                // request line
+                "POST /test HTTP/1.1"
+                "\r\n"
+                // headers
+                "host:example.com"
+                "\r\n"
+                "content-type:application/x-www-form-urlencoded"
+                "\r\n"
+                "content-length:38"
+                "\r\n"
+                "\r\n"
+                // content
+                "a%26b=1%2B1%3D2&city=%C4%B0zmir+100%25"),
+        },
+        {
+            // content longer than request line and headers
+            .requestInfo =
+                {
+                    .method = HTTP_METHOD_POST,
+                    .version = HTTP_VERSION_11,
+                    .path = StringFromLiteral("/test"),
+                    .host = StringFromLiteral("example.com"),
+                    .contentType = HTTP_CONTENT_TYPE_FORM_URLENCODED,
+                    .content = &((struct http_form_urlencoded_list){
+                        .itemCount = 1,
+                        .items =
+                            (struct http_form_urlencoded_item[]){
+                                {.name = StringFromLiteral("q"), .value = StringFromLiteral(REPEAT_128(LONG_VALUE))},
+                            },
+                    }),
+                },
+            .expected = StringFromLiteral(
+                // request line
+                "POST /test HTTP/1.1"
+                "\r\n"
+                // headers
+                "host:example.com"
+                "\r\n"
+                "content-type:application/x-www-form-urlencoded"
+                "\r\n"
+                "content-length:3330"
+                "\r\n"
+                "\r\n"
+                // content
+                "q=" REPEAT_128(LONG_VALUE_ENCODED)),
+        },
+        {
+            .requestInfo =
+                {
+                    .method = HTTP_METHOD_GET,
+                    .version = HTTP_VERSION_11,
+                    .host = StringFromLiteral("i.iii.st"),
+                    .path = StringFromLiteral("/api/v1/search"),
+                    .query = &((struct http_form_urlencoded_list){
+                        .itemCount = 2,
+                        .items =
+                            (struct http_form_urlencoded_item[]){
+                                {.name = StringFromLiteral("q"), .value = StringFromLiteral("rust & c++")},
+                                {.name = StringFromLiteral("page"), .value = StringFromLiteral("2")},
+                            },
+                    }),
+                },
+            .expected = StringFromLiteral(
+                // request line
+                "GET /api/v1/search?q=rust+%26+c%2B%2B&page=2 HTTP/1.1"
+                "\r\n"
+                // headers
+                "host:i.iii.st"
+                "\r\n"
+                "\r\n"
+                // content
+                ),
+        },
+        {
+            // url already has query
+            .requestInfo =
+                {
+                    .method = HTTP_METHOD_GET,
+                    .version = HTTP_VERSION_11,
+                    .url = StringFromLiteral("https://i.iii.st/api/v1/search?type=video"),
+                    .query = &((struct http_form_urlencoded_list){
+                        .itemCount = 1,
+                        .items =
+                            (struct http_form_urlencoded_item[]){
+                                {.name = StringFromLiteral("q"), .value = StringFromLiteral("a/b")},
+                            },
+                    }),
+                },
+            .expected = StringFromLiteral(
+                // request line
+                "GET /api/v1/search?type=video&q=a%2Fb HTTP/1.1"
+                "\r\n"
+                // headers
+                "host:i.iii.st"
+                "\r\n"
+                "\r\n"
+                // content
+                ),
+        },
         {
             .requestInfo =
                 {
@@ -220,6 +347,106 @@ main(void)
                 // content
                 "{ \"car\": \"Toyota\", \"model\": \"Corolla\", \"year\": 2005 }"),
         },
+        {
+            .requestInfo =
+                {
+                    .method = HTTP_METHOD_POST,
+                    .version = HTTP_VERSION_11,
+                    .path = StringFromLiteral("/import"),
+                    .host = StringFromLiteral("127.0.0.1"),
+                    .contentType = HTTP_CONTENT_TYPE_JSON,
+                    .contentEncoding = HTTP_ENCODING_GZIP,
+                    .content = &StringFromLiteral(
+                        "{\"videoIds\":[\"d_oVysaqG_0\",\"d_oVysaqG_0\",\"d_oVysaqG_0\",\"d_oVysaqG_0\"]}"),
+                },
+            .expected = StringFromLiteral(
+                // request line
+                "POST /import HTTP/1.1"
+                "\r\n"
+                // headers
+                "host:127.0.0.1"
+                "\r\n"
+                "content-type:application/json"
+                "\r\n"
+                "content-encoding:gzip"
+                "\r\n"
+                "content-length:51"
+                "\r\n"
+                "\r\n"
+                // content, 70 octets compressed
+                "\x1f\x8b\x08\x00\x00\x00\x00\x00\x00\xff\xab\x56\x2a\xcb\x4c\x49\xcd"
+                "\xf7\x4c\x29\x56\xb2\x8a\x56\x4a\x89\xcf\x0f\xab\x2c\x4e\x2c\x74\x8f"
+                "\x37\x50\xd2\x21\x9a\x17\x5b\x0b\x00\x03\x0b\xe7\xd6\x46\x00\x00\x00"),
+        },
+        {
+            // encoding is not supported
+            .requestInfo =
+                {
+                    .method = HTTP_METHOD_POST,
+                    .version = HTTP_VERSION_11,
+                    .path = StringFromLiteral("/import"),
+                    .host = StringFromLiteral("127.0.0.1"),
+                    .contentType = HTTP_CONTENT_TYPE_JSON,
+                    .contentEncoding = HTTP_ENCODING_BROTLI,
+                    .content = &StringFromLiteral("{}"),
+                },
+            .expected = StringNull(),
+        },
+        {
+            .requestInfo =
+                {
+                    .method = HTTP_METHOD_GET,
+                    .version = HTTP_VERSION_11,
+                    .host = StringFromLiteral("i.iii.st"),
+                    .path = StringFromLiteral("/videoplayback"),
+                    .range = &(struct http_range){.start = 0, .end = 1048575},
+                },
+            .expected = StringFromLiteral(
+                // request line
+                "GET /videoplayback HTTP/1.1"
+                "\r\n"
+                // headers
+                "host:i.iii.st"
+                "\r\n"
+                "range:bytes=0-1048575"
+                "\r\n"
+                "\r\n"
+                // content
+                ),
+        },
+        {
+            .requestInfo =
+                {
+                    .method = HTTP_METHOD_GET,
+                    .version = HTTP_VERSION_11,
+                    .host = StringFromLiteral("i.iii.st"),
+                    .path = StringFromLiteral("/videoplayback"),
+                    .range = &(struct http_range){.start = 1048576, .end = HTTP_RANGE_END},
+                },
+            .expected = StringFromLiteral(
+                // request line
+                "GET /videoplayback HTTP/1.1"
+                "\r\n"
+                // headers
+                "host:i.iii.st"
+                "\r\n"
+                "range:bytes=1048576-"
+                "\r\n"
+                "\r\n"
+                // content
+                ),
+        },
+        {
+            // range end before start
+            .requestInfo =
+                {
+                    .method = HTTP_METHOD_GET,
+                    .version = HTTP_VERSION_11,
+                    .host = StringFromLiteral("i.iii.st"),
+                    .range = &(struct http_range){.start = 500, .end = 499},
+                },
+            .expected = StringNull(),
+        },
         {
             .requestInfo = {},
             .expected = StringNull(),
@@ -261,5 +488,278 @@ main(void)
     }
   }
 
+  // struct string PercentEncode(struct string *string, struct string *buffer, enum percent_encoding mode)
+  // struct string PercentDecode(struct string *string, struct string *buffer, enum percent_encoding mode)
+  {
+    struct test_case {
+      enum percent_encoding mode;
+      struct string decoded;
+      struct string encoded;
+    } testCases[] = {
+        {
+            .mode = PERCENT_ENCODING_URL,
+            .decoded = StringFromLiteral(""),
+            .encoded = StringFromLiteral(""),
+        },
+        {
+            .mode = PERCENT_ENCODING_URL,
+            .decoded = StringFromLiteral("AZaz09-._~"),
+            .encoded = StringFromLiteral("AZaz09-._~"),
+        },
+        {
+            .mode = PERCENT_ENCODING_URL,
+            .decoded = StringFromLiteral(" !\"#$%&'()*+,/:;=?@[]\x7f\x80\xff"),
+            .encoded = StringFromLiteral("%20%21%22%23%24%25%26%27%28%29%2A%2B%2C%2F%3A%3B%3D%3F%40%5B%5D%7F%80%FF"),
+        },
+        {
+            // long runs of unreserved characters between reserved ones
+            .mode = PERCENT_ENCODING_URL,
+            .decoded = StringFromLiteral("The_quick-brown.fox~jumps_over_the_lazy_dog/"
+                                         "0123456789abcdefghijklmnopqrstuvwxyz?"),
+            .encoded = StringFromLiteral("The_quick-brown.fox~jumps_over_the_lazy_dog%2F"
+                                         "0123456789abcdefghijklmnopqrstuvwxyz%3F"),
+        },
+        {
+            .mode = PERCENT_ENCODING_FORM,
+            .decoded = StringFromLiteral(REPEAT_8(LONG_VALUE)),
+            .encoded = StringFromLiteral(REPEAT_8(LONG_VALUE_ENCODED)),
+        },
+    };
+
+    for (u32 testCaseIndex = 0; testCaseIndex < ARRAY_COUNT(testCases); testCaseIndex++) {
+      memory_temp tempMemory = MemoryTempBegin(&stackMemory);
+      struct test_case *testCase = testCases + testCaseIndex;
+
+      struct string *decoded = &testCase->decoded;
+      struct string *encoded = &testCase->encoded;
+
+      u64 encodedLength = PercentEncodedLength(decoded, testCase->mode);
+      struct string *buffer = MakeString(tempMemory.arena, encoded->length);
+      struct string got = PercentEncode(decoded, buffer, testCase->mode);
+      if (encodedLength != encoded->length || !IsStringEqual(&got, encoded)) {
+        errorCode = HTTP_REQUEST_TEST_ERROR_PERCENT_ENCODE;
+
+        StringBuilderAppendTestError(sb, errorCode);
+        StringBuilderAppendStringLiteral(sb, "\n  expected:\n");
+        StringBuilderAppendHexDump(sb, encoded);
+        StringBuilderAppendStringLiteral(sb, "\n       got:\n");
+        StringBuilderAppendHexDump(sb, &got);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+      }
+
+      // decoding in place
+      got = PercentDecode(buffer, buffer, testCase->mode);
+      if (!IsStringEqual(&got, decoded)) {
+        errorCode = HTTP_REQUEST_TEST_ERROR_PERCENT_DECODE;
+
+        StringBuilderAppendTestError(sb, errorCode);
+        StringBuilderAppendStringLiteral(sb, "\n  expected:\n");
+        StringBuilderAppendHexDump(sb, decoded);
+        StringBuilderAppendStringLiteral(sb, "\n       got:\n");
+        StringBuilderAppendHexDump(sb, &got);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+      }
+
+      // buffer one byte short
+      if (encoded->length > 0) {
+        struct string shortBuffer = StringFromBuffer(buffer->value, encoded->length - 1);
+        got = PercentEncode(decoded, &shortBuffer, testCase->mode);
+        if (!IsStringNull(&got)) {
+          errorCode = HTTP_REQUEST_TEST_ERROR_PERCENT_ENCODE;
+
+          StringBuilderAppendTestError(sb, errorCode);
+          StringBuilderAppendStringLiteral(sb, "\n  expected: null when buffer is short\n       got:\n");
+          StringBuilderAppendHexDump(sb, &got);
+          StringBuilderAppendStringLiteral(sb, "\n");
+          struct string errorMessage = StringBuilderFlush(sb);
+          PrintString(&errorMessage);
+        }
+
+        // b8 StringBuilderAppendPercentEncoded(string_builder *stringBuilder, struct string *src,
+        //                                      enum percent_encoding mode)
+        struct string_builder shortBuilder = {.outBuffer = &shortBuffer};
+        if (StringBuilderAppendPercentEncoded(&shortBuilder, decoded, testCase->mode) || shortBuilder.length != 0) {
+          errorCode = HTTP_REQUEST_TEST_ERROR_PERCENT_ENCODE;
+
+          StringBuilderAppendTestError(sb, errorCode);
+          StringBuilderAppendStringLiteral(sb, "\n  expected: nothing appended when builder is short\n");
+          struct string errorMessage = StringBuilderFlush(sb);
+          PrintString(&errorMessage);
+        }
+      }
+
+      MemoryTempEnd(&tempMemory);
+    }
+
+    // invalid escapes
+    struct string invalids[] = {
+        StringFromLiteral("%"),
+        StringFromLiteral("abc%4"),
+        StringFromLiteral("%G0"),
+        StringFromLiteral("0123456789abcdefghijklmnopqrstuvwxyz%zz"),
+    };
+    for (u32 invalidIndex = 0; invalidIndex < ARRAY_COUNT(invalids); invalidIndex++) {
+      struct string *invalid = invalids + invalidIndex;
+      u8 buffer[64];
+      struct string bufferString = StringFromBuffer(buffer, ARRAY_COUNT(buffer));
+      struct string got = PercentDecode(invalid, &bufferString, PERCENT_ENCODING_URL);
+      if (!IsStringNull(&got)) {
+        errorCode = HTTP_REQUEST_TEST_ERROR_PERCENT_DECODE;
+
+        StringBuilderAppendTestError(sb, errorCode);
+        StringBuilderAppendStringLiteral(sb, "\n  expected: null for ");
+        StringBuilderAppendString(sb, invalid);
+        StringBuilderAppendStringLiteral(sb, "\n       got:\n");
+        StringBuilderAppendHexDump(sb, &got);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+      }
+    }
+  }
+
+  // struct string HttpRequestTemplateRender(struct http_request_template *template, struct string *values,
+  //                                          struct string *buffer)
+  {
+    struct test_case {
+      struct http_request_info templateInfo;
+      struct string *values;
+      u64 bufferLength;
+      struct string expected;
+    } testCases[] = {
+        {
+            .templateInfo =
+                {
+                    .method = HTTP_METHOD_GET,
+                    .version = HTTP_VERSION_11,
+                    .host = StringFromLiteral("i.iii.st"),
+                    .path = StringFromLiteral("/api/v1/videos/" HTTP_REQUEST_TEMPLATE_SLOT),
+                },
+            .values = (struct string[]){StringFromLiteral("d_oVysaqG_0")},
+            .bufferLength = 1024,
+            .expected = StringFromLiteral(
+                // request line
+                "GET /api/v1/videos/d_oVysaqG_0 HTTP/1.1"
+                "\r\n"
+                // headers
+                "host:i.iii.st"
+                "\r\n"
+                "\r\n"
+                // content
+                ),
+        },
+        {
+            .templateInfo =
+                {
+                    .method = HTTP_METHOD_GET,
+                    .version = HTTP_VERSION_11,
+                    .host = StringFromLiteral(HTTP_REQUEST_TEMPLATE_SLOT),
+                    .path = StringFromLiteral("/api/v1/search?q=" HTTP_REQUEST_TEMPLATE_SLOT
+                                              "&page=" HTTP_REQUEST_TEMPLATE_SLOT),
+                    .headerCount = 1,
+                    .headers =
+                        (struct http_header[]){
+                            {.name = StringFromLiteral("user-agent"),
+                             .value = StringFromLiteral(HTTP_REQUEST_TEMPLATE_SLOT)},
+                        },
+                },
+            .values =
+                (struct string[]){
+                    StringFromLiteral("big+buck+bunny"),
+                    StringFromLiteral(""),
+                    StringFromLiteral("127.0.0.1"),
+                    StringFromLiteral("invidious"),
+                },
+            .bufferLength = 1024,
+            .expected = StringFromLiteral(
+                // request line
+                "GET /api/v1/search?q=big+buck+bunny&page= HTTP/1.1"
+                "\r\n"
+                // headers
+                "host:127.0.0.1"
+                "\r\n"
+                "user-agent:invidious"
+                "\r\n"
+                "\r\n"
+                // content
+                ),
+        },
+        {
+            // buffer is not big enough
+            .templateInfo =
+                {
+                    .method = HTTP_METHOD_GET,
+                    .version = HTTP_VERSION_11,
+                    .host = StringFromLiteral("i.iii.st"),
+                    .path = StringFromLiteral("/api/v1/videos/" HTTP_REQUEST_TEMPLATE_SLOT),
+                },
+            .values = (struct string[]){StringFromLiteral("d_oVysaqG_0")},
+            .bufferLength = 16,
+            .expected = StringNull(),
+        },
+        {
+            // slot is not allowed in content
+            .templateInfo =
+                {
+                    .method = HTTP_METHOD_POST,
+                    .version = HTTP_VERSION_11,
+                    .path = StringFromLiteral("/test"),
+                    .host = StringFromLiteral("127.0.0.1"),
+                    .contentType = HTTP_CONTENT_TYPE_JSON,
+                    .content = &StringFromLiteral("{ \"id\": \"" HTTP_REQUEST_TEMPLATE_SLOT "\" }"),
+                },
+            .values = (struct string[]){StringFromLiteral("d_oVysaqG_0")},
+            .bufferLength = 1024,
+            .expected = StringNull(),
+        },
+    };
+
+    for (u32 testCaseIndex = 0; testCaseIndex < ARRAY_COUNT(testCases); testCaseIndex++) {
+      memory_temp tempMemory = MemoryTempBegin(&stackMemory);
+      struct test_case *testCase = testCases + testCaseIndex;
+      struct string *expected = &testCase->expected;
+
+      struct string got = StringNull();
+      struct string gotFromParts = StringNull();
+      struct http_request_template *template = MakeHttpRequestTemplate(tempMemory.arena, &testCase->templateInfo);
+      if (template) {
+        struct string *buffer = MakeString(tempMemory.arena, testCase->bufferLength);
+        got = HttpRequestTemplateRender(template, testCase->values, buffer);
+
+        // parts must add up to same request
+        struct string *parts = MemoryArenaPush(tempMemory.arena, sizeof(*parts) * HttpRequestTemplatePartMax(template));
+        u32 partCount = HttpRequestTemplateRenderParts(template, testCase->values, parts);
+        string_builder *partBuilder = MakeStringBuilder(tempMemory.arena, 1024, 0);
+        for (u32 partIndex = 0; partIndex < partCount; partIndex++)
+          StringBuilderAppendString(partBuilder, parts + partIndex);
+        gotFromParts = StringBuilderFlush(partBuilder);
+        if (IsStringNull(expected))
+          gotFromParts = StringNull();
+      }
+
+      if (!IsStringEqual(expected, &got) || !IsStringEqual(expected, &gotFromParts)) {
+        errorCode = !IsStringNull(expected) ? HTTP_REQUEST_TEST_ERROR_REQUEST_BUILD_EXPECTED_VAILD
+                                            : HTTP_REQUEST_TEST_ERROR_REQUEST_BUILD_EXPECTED_INVALID;
+
+        StringBuilderAppendTestError(sb, errorCode);
+        StringBuilderAppendStringLiteral(sb, "\n  expected:\n");
+        StringBuilderAppendPrintableHexDump(sb, expected);
+        StringBuilderAppendStringLiteral(sb, "\n       got:\n");
+        StringBuilderAppendPrintableHexDump(sb, &got);
+        StringBuilderAppendStringLiteral(sb, "\n  got from parts:\n");
+        StringBuilderAppendPrintableHexDump(sb, &gotFromParts);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+      }
+
+      MemoryTempEnd(&tempMemory);
+    }
+  }
+
   return (int)errorCode;
 }
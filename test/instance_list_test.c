@@ -0,0 +1,343 @@
+#include "instance_list.c"
+#include "print.h"
+#include "string_builder.h"
+
+#define TEST_ERROR_LIST(X)                                                                                             \
+  X(ADD, "Instance must be added once")                                                                                \
+  X(RECORD, "Averages must move toward samples")                                                                      \
+  X(THROTTLE, "Throttled instance must be left alone until it asks to")                                                \
+  X(PICK, "Fastest instance that is up must be picked")                                                                \
+  X(PROBE_DUE, "Instance must be probed when it is not heard from")                                                    \
+  X(FILE, "Averages must be read back from file")
+
+enum instance_list_test_error {
+  INSTANCE_LIST_TEST_ERROR_NONE = 0,
+#define X(tag, message) INSTANCE_LIST_TEST_ERROR_##tag,
+  TEST_ERROR_LIST(X)
+#undef X
+
+  // src: https://mesonbuild.com/Unit-tests.html#skipped-tests-and-hard-errors
+  // For the default exitcode testing protocol, the GNU standard approach in
+  // this case is to exit the program with error code 77. Meson will detect this
+  // and report these tests as skipped rather than failed. This behavior was
+  // added in version 0.37.0.
+  MESON_TEST_SKIP = 77,
+  // In addition, sometimes a test fails set up so that it should fail even if
+  // it is marked as an expected failure. The GNU standard approach in this case
+  // is to exit the program with error code 99. Again, Meson will detect this
+  // and report these tests as ERROR, ignoring the setting of should_fail. This
+  // behavior was added in version 0.50.0.
+  MESON_TEST_FAILED_TO_SET_UP = 99,
+};
+
+internalfn void
+StringBuilderAppendTestError(struct string_builder *sb, enum instance_list_test_error errorCode)
+{
+  struct string message = StringFromLiteral("Unknown error");
+  struct error {
+    enum instance_list_test_error code;
+    struct string message;
+  } errors[] = {
+#define XX(tag, msg) {.code = INSTANCE_LIST_TEST_ERROR_##tag, .message = StringFromLiteral(msg)},
+      TEST_ERROR_LIST(XX)
+#undef XX
+  };
+
+  for (u32 errorIndex = 0; errorIndex < ARRAY_COUNT(errors); errorIndex++) {
+    struct error *error = errors + errorIndex;
+    if (error->code != errorCode)
+      continue;
+
+    message = error->message;
+    break;
+  }
+
+  StringBuilderAppendString(sb, &message);
+}
+
+int
+main(void)
+{
+  enum instance_list_test_error errorCode = INSTANCE_LIST_TEST_ERROR_NONE;
+
+  // setup
+  enum {
+    KILOBYTES = (1 << 10),
+    MEGABYTES = (1 << 20),
+  };
+  u8 stackBuffer[256 * KILOBYTES];
+  memory_arena stackMemory = {
+      .block = stackBuffer,
+      .total = ARRAY_COUNT(stackBuffer),
+  };
+
+  string_builder *sb = MakeStringBuilder(&stackMemory, 4 * KILOBYTES, 32);
+
+  comptime u64 now = 1760791710;
+  comptime u64 MILLISECONDS = 1000000 /* 1e6 */;
+  struct string port = StringFromLiteral("443");
+  struct string hostnames[] = {
+      StringFromLiteral("i.iii.st"),
+      StringFromLiteral("yewtu.be"),
+      StringFromLiteral("inv.nadeko.net"),
+  };
+
+  // struct instance *InstanceListAdd(struct instance_list *list, struct string *hostname, struct string *port)
+  {
+    struct instance_list list;
+    InstanceListInit(&list, &stackMemory);
+    struct instance *first = InstanceListAdd(&list, hostnames + 0, &port);
+    struct instance *second = InstanceListAdd(&list, hostnames + 1, &port);
+    struct instance *again = InstanceListAdd(&list, &StringFromLiteral("YEWTU.be"), &port);
+    struct instance *otherPort = InstanceListAdd(&list, hostnames + 1, &StringFromLiteral("8443"));
+    struct instance *noPort = InstanceListAdd(&list, hostnames + 1, &StringFromLiteral(""));
+
+    b8 isExpected = first && second && again == second && otherPort && otherPort != second && !noPort &&
+                    list.instanceCount == 3 && first->hostname.value[first->hostname.length] == 0 &&
+                    IsStringEqual(&second->hostname, hostnames + 1) && InstanceScore(first) == INSTANCE_SCORE_UNKNOWN;
+    for (u32 index = list.instanceCount; index < INSTANCE_MAX; index++) {
+      u8 hostnameBuffer[2] = {'a', (u8)('a' + index)};
+      struct string hostname = StringFromBuffer(hostnameBuffer, ARRAY_COUNT(hostnameBuffer));
+      isExpected = isExpected && InstanceListAdd(&list, &hostname, &port);
+    }
+    isExpected = isExpected && !InstanceListAdd(&list, &StringFromLiteral("full.example"), &port);
+    if (!isExpected) {
+      errorCode = INSTANCE_LIST_TEST_ERROR_ADD;
+      StringBuilderAppendTestError(sb, errorCode);
+      StringBuilderAppendStringLiteral(sb, "\n  got count: ");
+      StringBuilderAppendU32(sb, list.instanceCount);
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string errorMessage = StringBuilderFlush(sb);
+      PrintString(&errorMessage);
+    }
+  }
+
+  // void InstanceListRecord(struct instance_list *list, struct instance *instance, u64 latency, b8 isFailed, u64 now)
+  {
+    struct instance_list list;
+    InstanceListInit(&list, &stackMemory);
+    struct instance *instance = InstanceListAdd(&list, hostnames + 0, &port);
+
+    InstanceListRecord(&list, instance, 100 * MILLISECONDS, 0, now);
+    b8 isExpected = list.isChanged && instance->latency == 100 * MILLISECONDS && instance->updatedAt == now &&
+                    InstanceScore(instance) == 100 * MILLISECONDS;
+
+    // one quarter of way to sample
+    InstanceListRecord(&list, instance, 500 * MILLISECONDS, 0, now);
+    isExpected = isExpected && instance->latency == 200 * MILLISECONDS;
+    // request that succeeded without measuring does not move latency
+    InstanceListRecord(&list, instance, 0, 0, now);
+    isExpected = isExpected && instance->latency == 200 * MILLISECONDS;
+
+    // failures in a row keep instance down longer and longer
+    InstanceListRecord(&list, instance, 0, 1, now);
+    isExpected = isExpected && instance->failureCount == 1 && instance->downUntil == now + INSTANCE_DOWN_DURATION &&
+                 instance->errorRate == INSTANCE_ERROR_RATE_ONE / 4 &&
+                 InstanceScore(instance) == 200 * MILLISECONDS * 4 / 3;
+    InstanceListRecord(&list, instance, 0, 1, now);
+    isExpected = isExpected && instance->failureCount == 2 && instance->downUntil == now + 2 * INSTANCE_DOWN_DURATION;
+    for (u32 failureIndex = 0; failureIndex < 40; failureIndex++)
+      InstanceListRecord(&list, instance, 0, 1, now);
+    isExpected = isExpected && instance->downUntil == now + INSTANCE_DOWN_DURATION_MAX &&
+                 instance->errorRate < INSTANCE_ERROR_RATE_ONE && InstanceScore(instance) != INSTANCE_SCORE_UNKNOWN;
+
+    // answer brings it back up
+    InstanceListRecord(&list, instance, 200 * MILLISECONDS, 0, now + 1);
+    isExpected = isExpected && instance->failureCount == 0 && instance->downUntil == 0 &&
+                 instance->errorRate < INSTANCE_ERROR_RATE_ONE && instance->updatedAt == now + 1;
+    if (!isExpected) {
+      errorCode = INSTANCE_LIST_TEST_ERROR_RECORD;
+      StringBuilderAppendTestError(sb, errorCode);
+      StringBuilderAppendStringLiteral(sb, "\n  got latency: ");
+      StringBuilderAppendU64(sb, instance->latency);
+      StringBuilderAppendStringLiteral(sb, "\n  got error rate: ");
+      StringBuilderAppendU32(sb, instance->errorRate);
+      StringBuilderAppendStringLiteral(sb, "\n  got failures: ");
+      StringBuilderAppendU32(sb, instance->failureCount);
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string errorMessage = StringBuilderFlush(sb);
+      PrintString(&errorMessage);
+    }
+  }
+
+  // void InstanceListThrottle(struct instance_list *list, struct instance *instance, u64 until, u64 now)
+  {
+    struct instance_list list;
+    InstanceListInit(&list, &stackMemory);
+    struct instance *instance = InstanceListAdd(&list, hostnames + 0, &port);
+    InstanceListAdd(&list, hostnames + 1, &port);
+    InstanceListRecord(&list, instance, 100 * MILLISECONDS, 0, now);
+    InstanceListRecord(&list, list.instances + 1, 300 * MILLISECONDS, 0, now);
+    list.isChanged = 0;
+
+    InstanceListThrottle(&list, instance, now + 120, now);
+    // it is not failure
+    b8 isExpected = list.isChanged && instance->downUntil == now + 120 && instance->failureCount == 0 &&
+                    instance->errorRate == 0 && InstanceListPick(&list, 0, now + 1) == 1 &&
+                    InstanceListPick(&list, 0, now + 120) == 0;
+    // shorter wait does not cut longer one
+    InstanceListThrottle(&list, instance, now + 60, now);
+    isExpected = isExpected && instance->downUntil == now + 120;
+    if (!isExpected) {
+      errorCode = INSTANCE_LIST_TEST_ERROR_THROTTLE;
+      StringBuilderAppendTestError(sb, errorCode);
+      StringBuilderAppendStringLiteral(sb, "\n  got down until: ");
+      StringBuilderAppendU64(sb, instance->downUntil - now);
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string errorMessage = StringBuilderFlush(sb);
+      PrintString(&errorMessage);
+    }
+  }
+
+  // s32 InstanceListPick(struct instance_list *list, u32 triedMask, u64 now)
+  {
+    struct instance_list list;
+    InstanceListInit(&list, &stackMemory);
+    for (u32 index = 0; index < ARRAY_COUNT(hostnames); index++)
+      InstanceListAdd(&list, hostnames + index, &port);
+
+    struct test_case {
+      // latency in milliseconds, 0 when it never answered
+      u64 latencies[3];
+      u32 failureCounts[3];
+      u32 triedMask;
+      s32 expected;
+    } testCases[] = {
+        // nothing is known, given order
+        {.latencies = {0, 0, 0}, .expected = 0},
+        {.latencies = {300, 100, 200}, .expected = 1},
+        // ones that answered go before ones that never did
+        {.latencies = {0, 0, 200}, .expected = 2},
+        // failed request goes to next best
+        {.latencies = {300, 100, 200}, .triedMask = 1 << 1, .expected = 2},
+        {.latencies = {300, 100, 200}, .triedMask = (1 << 1) | (1 << 2), .expected = 0},
+        {.latencies = {300, 100, 200}, .triedMask = 7, .expected = -1},
+        // fastest is down, slow one that is up is picked
+        {.latencies = {300, 100, 200}, .failureCounts = {0, 1, 1}, .expected = 0},
+        // every one is down, one that comes back first is picked
+        {.latencies = {300, 100, 200}, .failureCounts = {3, 2, 2}, .expected = 1},
+        // unreliable is worse than slow
+        {.latencies = {100, 120, 0}, .failureCounts = {0, 0, 0}, .expected = 1},
+    };
+
+    for (u32 testCaseIndex = 0; testCaseIndex < ARRAY_COUNT(testCases); testCaseIndex++) {
+      struct test_case *testCase = testCases + testCaseIndex;
+      for (u32 index = 0; index < list.instanceCount; index++) {
+        struct instance *instance = list.instances + index;
+        instance->latency = 0;
+        instance->errorRate = 0;
+        instance->failureCount = 0;
+        instance->downUntil = 0;
+        if (testCase->latencies[index] != 0)
+          InstanceListRecord(&list, instance, testCase->latencies[index] * MILLISECONDS, 0, now);
+        for (u32 failureIndex = 0; failureIndex < testCase->failureCounts[index]; failureIndex++)
+          InstanceListRecord(&list, instance, 0, 1, now);
+      }
+      // last case, first one failed once long ago and recovered
+      if (testCaseIndex == ARRAY_COUNT(testCases) - 1) {
+        InstanceListRecord(&list, list.instances + 0, 0, 1, now - 60);
+        InstanceListRecord(&list, list.instances + 0, 0, 0, now - 30);
+      }
+
+      s32 got = InstanceListPick(&list, testCase->triedMask, now + 1);
+      if (got != testCase->expected) {
+        errorCode = INSTANCE_LIST_TEST_ERROR_PICK;
+        StringBuilderAppendTestError(sb, errorCode);
+        StringBuilderAppendStringLiteral(sb, "\n  case: ");
+        StringBuilderAppendU32(sb, testCaseIndex);
+        StringBuilderAppendStringLiteral(sb, "\n  expected: ");
+        StringBuilderAppendS32(sb, testCase->expected);
+        StringBuilderAppendStringLiteral(sb, "\n       got: ");
+        StringBuilderAppendS32(sb, got);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+      }
+    }
+  }
+
+  // b8 IsInstanceProbeDue(struct instance *instance, u64 now)
+  {
+    struct instance_list list;
+    InstanceListInit(&list, &stackMemory);
+    struct instance *instance = InstanceListAdd(&list, hostnames + 0, &port);
+
+    b8 isExpected = IsInstanceProbeDue(instance, now);
+    InstanceListRecord(&list, instance, 100 * MILLISECONDS, 0, now);
+    isExpected = isExpected && !IsInstanceProbeDue(instance, now + INSTANCE_PROBE_INTERVAL - 1) &&
+                 IsInstanceProbeDue(instance, now + INSTANCE_PROBE_INTERVAL) &&
+                 // clock went back
+                 IsInstanceProbeDue(instance, now - 1);
+    // down instance is probed once it can be picked again
+    InstanceListRecord(&list, instance, 0, 1, now);
+    isExpected = isExpected && !IsInstanceProbeDue(instance, now + INSTANCE_DOWN_DURATION - 1) &&
+                 IsInstanceProbeDue(instance, now + INSTANCE_DOWN_DURATION);
+    if (!isExpected) {
+      errorCode = INSTANCE_LIST_TEST_ERROR_PROBE_DUE;
+      StringBuilderAppendTestError(sb, errorCode);
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string errorMessage = StringBuilderFlush(sb);
+      PrintString(&errorMessage);
+    }
+  }
+
+  // struct string InstanceListSerialize(struct instance_list *list, struct string *buffer)
+  // b8 InstanceListParse(struct instance_list *list, struct string *content)
+  {
+    struct instance_list list;
+    InstanceListInit(&list, &stackMemory);
+    struct instance *first = InstanceListAdd(&list, hostnames + 0, &port);
+    struct instance *second = InstanceListAdd(&list, &StringFromLiteral("::1"), &StringFromLiteral("8443"));
+    // never heard from, not written
+    InstanceListAdd(&list, hostnames + 2, &port);
+    InstanceListRecord(&list, first, 100 * MILLISECONDS, 0, now);
+    InstanceListRecord(&list, second, 300 * MILLISECONDS, 0, now);
+    InstanceListRecord(&list, second, 0, 1, now + 1);
+
+    struct string buffer = {
+        .value = MemoryArenaPush(&stackMemory, INSTANCE_LIST_FILE_MAX),
+        .length = INSTANCE_LIST_FILE_MAX,
+    };
+    struct string content = InstanceListSerialize(&list, &buffer);
+
+    // other run has other list, and heard from first one later
+    struct instance_list parsedList;
+    InstanceListInit(&parsedList, &stackMemory);
+    struct instance *parsedFirst = InstanceListAdd(&parsedList, hostnames + 0, &port);
+    struct instance *parsedSecond = InstanceListAdd(&parsedList, &StringFromLiteral("::1"), &StringFromLiteral("8443"));
+    struct instance *parsedOther = InstanceListAdd(&parsedList, hostnames + 1, &port);
+    InstanceListRecord(&parsedList, parsedFirst, 50 * MILLISECONDS, 0, now + 10);
+    b8 isParsed = InstanceListParse(&parsedList, &content);
+
+    b8 isExpected = isParsed && parsedFirst->latency == 50 * MILLISECONDS && parsedFirst->updatedAt == now + 10 &&
+                    parsedSecond->latency == second->latency && parsedSecond->errorRate == second->errorRate &&
+                    parsedSecond->failureCount == 1 && parsedSecond->downUntil == second->downUntil &&
+                    parsedSecond->updatedAt == now + 1 && parsedOther->updatedAt == 0;
+    if (!isExpected) {
+      errorCode = INSTANCE_LIST_TEST_ERROR_FILE;
+      StringBuilderAppendTestError(sb, errorCode);
+      StringBuilderAppendStringLiteral(sb, "\n  newer averages must be taken from file only\n");
+      struct string errorMessage = StringBuilderFlush(sb);
+      PrintString(&errorMessage);
+    }
+
+    struct string damagedContents[] = {
+        StringSlice(&content, 0, content.length - 1),
+        StringFromLiteral("IINX\x01\x00\x00\x00\x00\x00\x00\x00"),
+        StringFromLiteral("IINS\x02\x00\x00\x00\x00\x00\x00\x00"),
+    };
+    for (u32 damagedIndex = 0; damagedIndex < ARRAY_COUNT(damagedContents); damagedIndex++) {
+      if (InstanceListParse(&parsedList, damagedContents + damagedIndex)) {
+        errorCode = INSTANCE_LIST_TEST_ERROR_FILE;
+        StringBuilderAppendTestError(sb, errorCode);
+        StringBuilderAppendStringLiteral(sb, "\n  damaged content must not be read, case: ");
+        StringBuilderAppendU32(sb, damagedIndex);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+      }
+    }
+  }
+
+  return (int)errorCode;
+}
@@ -0,0 +1,126 @@
+#include <netinet/in.h>
+
+#include "invidious_server.h"
+#include "platform.h"
+#include "string_builder.h"
+
+/*
+ * Serves recorded api responses on loopback, see invidious_server.h, so
+ * client can be run against it by hand:
+ *
+ *   ./invidious_server --port=8080 --latency=50 --chunk=4096 test/data/invidious
+ *   ./invidious -i http://127.0.0.1:8080 d_oVysaqG_0
+ *
+ * Options:
+ *   --port=N       0 or none lets system pick one, it is printed
+ *   --latency=ms   every response is held back this long
+ *   --chunk=bytes  bodies are sent chunked
+ *   --gzip         bodies are compressed for requests that accept gzip
+ *   --throttle=N   requests over N held back at once are answered with 429
+ *   --stall=ms     every Nth request is held back this much longer
+ *   --stall-every=N
+ *   --search=query search that asks for another query is 404
+ *   directory      recorded responses, test/data/invidious by default
+ */
+
+int
+main(int argc, char *argv[])
+{
+  enum {
+    KILOBYTES = (1 << 10),
+  };
+
+  u8 stackBuffer[16 * KILOBYTES];
+  memory_arena stackMemory = {
+      .block = stackBuffer,
+      .total = ARRAY_COUNT(stackBuffer),
+  };
+  string_builder *sb = MakeStringBuilder(&stackMemory, 1024, 32);
+
+  struct invidious_server_options options = {
+      .directory = StringFromLiteral("test/data/invidious"),
+  };
+  struct string port = StringFromLiteral("0");
+  for (u32 argumentIndex = 1; argumentIndex < (u32)argc; argumentIndex++) {
+    struct string argument = StringFromZeroTerminated((u8 *)argv[argumentIndex], 1024);
+    struct string *portOption = &StringFromLiteral("--port=");
+    struct string *latencyOption = &StringFromLiteral("--latency=");
+    struct string *chunkOption = &StringFromLiteral("--chunk=");
+    struct string *throttleOption = &StringFromLiteral("--throttle=");
+    struct string *stallOption = &StringFromLiteral("--stall=");
+    struct string *stallEveryOption = &StringFromLiteral("--stall-every=");
+    struct string *searchOption = &StringFromLiteral("--search=");
+    u64 value;
+
+    if (IsStringStartsWith(&argument, portOption)) {
+      port = StringSlice(&argument, portOption->length, argument.length);
+      if (!ParseU64(&port, &value) || value > 0xffff)
+        goto usage;
+    } else if (IsStringStartsWith(&argument, latencyOption)) {
+      struct string latency = StringSlice(&argument, latencyOption->length, argument.length);
+      if (!ParseU64(&latency, &value) || value > 60 * 1000)
+        goto usage;
+      options.latencyInMilliseconds = (u32)value;
+    } else if (IsStringStartsWith(&argument, chunkOption)) {
+      struct string chunk = StringSlice(&argument, chunkOption->length, argument.length);
+      if (!ParseU64(&chunk, &value) || value > INVIDIOUS_SERVER_FILE_MAX)
+        goto usage;
+      options.chunkLength = (u32)value;
+    } else if (IsStringStartsWith(&argument, throttleOption)) {
+      struct string throttle = StringSlice(&argument, throttleOption->length, argument.length);
+      if (!ParseU64(&throttle, &value) || value > INVIDIOUS_SERVER_CONNECTION_MAX * INVIDIOUS_SERVER_PENDING_MAX)
+        goto usage;
+      options.throttleCount = (u32)value;
+    } else if (IsStringStartsWith(&argument, stallOption)) {
+      struct string stall = StringSlice(&argument, stallOption->length, argument.length);
+      if (!ParseU64(&stall, &value) || value > 60 * 1000)
+        goto usage;
+      options.stallInMilliseconds = (u32)value;
+    } else if (IsStringStartsWith(&argument, stallEveryOption)) {
+      struct string stallEvery = StringSlice(&argument, stallEveryOption->length, argument.length);
+      if (!ParseU64(&stallEvery, &value) || value > 0xffffffff)
+        goto usage;
+      options.stallEvery = (u32)value;
+    } else if (IsStringStartsWith(&argument, searchOption)) {
+      options.search = StringSlice(&argument, searchOption->length, argument.length);
+    } else if (IsStringEqual(&argument, &StringFromLiteral("--gzip"))) {
+      options.isGzip = 1;
+    } else if (!IsStringStartsWith(&argument, &StringFromLiteral("-"))) {
+      options.directory = argument;
+    } else {
+      goto usage;
+    }
+  }
+
+  struct platform_address address;
+  if (!PlatformAddressResolve(&StringFromLiteral("127.0.0.1"), &port, &address)) {
+    PrintString(&StringFromLiteral("Could not resolve loopback address.\n"));
+    return 1;
+  }
+
+  s32 listener = PlatformSocketListen(&address);
+  if (listener == -1) {
+    StringBuilderAppendStringLiteral(sb, "Could not listen.\n  error: ");
+    StringBuilderAppendPlatformError(sb);
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return 1;
+  }
+
+  StringBuilderAppendStringLiteral(sb, "Serving ");
+  StringBuilderAppendString(sb, &options.directory);
+  StringBuilderAppendStringLiteral(sb, " on http://127.0.0.1:");
+  StringBuilderAppendU16(sb, ntohs(((struct sockaddr_in *)address.value)->sin_port));
+  StringBuilderAppendStringLiteral(sb, "\n");
+  struct string message = StringBuilderFlush(sb);
+  PrintString(&message);
+
+  InvidiousServerServe(&options, listener);
+  return 1;
+
+usage:
+  PrintString(&StringFromLiteral("usage: invidious_server [--port=N] [--latency=ms] [--chunk=bytes] [--gzip] "
+                                 "[--throttle=N] [--stall=ms --stall-every=N] [--search=query] [directory]\n"));
+  return 1;
+}
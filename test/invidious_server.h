@@ -0,0 +1,573 @@
+#pragma once
+
+/*
+ * Local stand-in for an Invidious instance, for running client end to end
+ * without network.
+ *
+ * Recorded api responses are served from a directory over plain HTTP/1.1:
+ *
+ *   /api/v1/videos/{id}          videos/{id}.json
+ *   /api/v1/channels/{id}[/...]  channels/{id}.json
+ *   /api/v1/search?...           search.json
+ *   /api/v1/stats                stats.json
+ *
+ * Video or channel that is not recorded is answered with default.json of its
+ * directory, so any id can be asked for. Anything else is 404. Server that
+ * expects a search answers it only when its query decodes to one expected,
+ * so it checks how client percent-encodes it.
+ *
+ * Connections are kept alive and requests can be pipelined, responses go out
+ * in order they are asked for. Every response is held back for latency after
+ * its request is received, sent chunked when chunk length is given and gzip
+ * compressed when it is enabled and request accepts it. Response is rendered
+ * once, when it is first asked for, and only copied to sockets after.
+ *
+ * Server that is throttling answers requests over its limit at once with
+ * "429 Too Many Requests", like instances behind rate limiting proxy do.
+ * Server that stalls holds some responses back for longer, and responses
+ * pipelined after them on same connection wait for them.
+ *
+ * @code
+ *   listener = PlatformSocketListen(&address)
+ *   InvidiousServerServe(&options, listener)  // until killed
+ * @endcode
+ */
+
+#include "deflate.c"
+#include "memory.h"
+#include "percent_encoding.h"
+#include "platform.h"
+#include "platform_network.h"
+#include "string_builder.h"
+#include "string_cursor.h"
+#include "text.h"
+
+enum {
+  INVIDIOUS_SERVER_CONNECTION_MAX = 1024,
+  // request of client that pipelines deeper closes connection
+  INVIDIOUS_SERVER_PENDING_MAX = 256,
+  INVIDIOUS_SERVER_REQUEST_MAX = 8 * 1024,
+  INVIDIOUS_SERVER_RESPONSE_MAX = 256,
+  INVIDIOUS_SERVER_PATH_MAX = 256,
+  INVIDIOUS_SERVER_FILE_MAX = 8 * 1024 * 1024,
+  // rendered responses
+  INVIDIOUS_SERVER_MEMORY = 512 * 1024 * 1024,
+};
+
+struct invidious_server_options {
+  // recorded responses, zero terminated
+  struct string directory;
+  // every response is held back this long after its request is received
+  u32 latencyInMilliseconds;
+  // body is sent in chunks of this many bytes, 0 sends it with content-length
+  u32 chunkLength;
+  // body is gzip compressed for requests that accept it
+  b8 isGzip;
+  // requests held back on every connection together, more are refused, 0 is
+  // no limit
+  u32 throttleCount;
+  // every stallEvery'th request is held back this much longer, like instance
+  // that stalls now and then, 0 never stalls
+  u32 stallEvery;
+  u32 stallInMilliseconds;
+  // query that search must ask for, as it is typed, null answers every search
+  struct string search;
+};
+
+struct invidious_server_response {
+  // file relative to directory, e.g. videos/default.json
+  u8 pathBuffer[INVIDIOUS_SERVER_PATH_MAX];
+  struct string path;
+  struct string body;
+  // status line, headers and body as they are written, as is and gzip
+  // compressed, null until asked for
+  struct string rendered[2];
+};
+
+struct invidious_server_connection {
+  s32 socket;
+  b8 isUsed;
+  struct invidious_server_connection *nextFree;
+
+  // bytes of requests that are not complete
+  u8 request[INVIDIOUS_SERVER_REQUEST_MAX];
+  u32 requestLength;
+
+  // responses that are asked for and not sent yet, oldest first
+  struct string *pending[INVIDIOUS_SERVER_PENDING_MAX];
+  // in nanoseconds, when they can be sent, see NowInNanoseconds()
+  u64 pendingReadyAt[INVIDIOUS_SERVER_PENDING_MAX];
+  u32 pendingHead;
+  u32 pendingCount;
+  u64 responseBytesWritten;
+  b8 isWriteWatched;
+};
+
+struct invidious_server {
+  struct invidious_server_options options;
+  memory_arena arena;
+  struct deflate_encoder *encoder;
+  // file is read into it
+  struct string fileBuffer;
+  // body is compressed into it
+  struct string gzipBuffer;
+
+  struct invidious_server_response responses[INVIDIOUS_SERVER_RESPONSE_MAX];
+  u32 responseCount;
+  struct string notFound;
+  struct string tooManyRequests;
+  // on every connection, refused ones are not counted
+  u32 pendingCount;
+  // every one asked for, see stallEvery
+  u32 answeredCount;
+
+  struct platform_reactor reactor;
+  struct invidious_server_connection *connections;
+  struct invidious_server_connection *freeList;
+};
+
+/*
+ * @param status e.g. "200 OK"
+ * @param headers lines that end with CRLF, may be empty
+ * @return response in arena, null when arena is full
+ */
+internalfn struct string
+InvidiousServerRender(struct invidious_server *server, struct string *status, struct string *headers,
+                      struct string *body, b8 isGzip)
+{
+  u64 chunkLength = server->options.chunkLength;
+  // every chunk has size line and CRLF, last one is empty
+  u64 chunkCount = chunkLength ? body->length / chunkLength + 2 : 0;
+  u64 length = 256 + headers->length + body->length + chunkCount * 32;
+  if (server->arena.used + length + 64 > server->arena.total)
+    return StringNull();
+
+  string_builder *sb = MakeStringBuilder(&server->arena, length, 32);
+  StringBuilderAppendStringLiteral(sb, "HTTP/1.1 ");
+  StringBuilderAppendString(sb, status);
+  StringBuilderAppendStringLiteral(sb, "\r\n"
+                                       "content-type: application/json\r\n");
+  StringBuilderAppendString(sb, headers);
+  if (isGzip)
+    StringBuilderAppendStringLiteral(sb, "content-encoding: gzip\r\n");
+
+  if (chunkLength == 0) {
+    StringBuilderAppendStringLiteral(sb, "content-length: ");
+    StringBuilderAppendU64(sb, body->length);
+    StringBuilderAppendStringLiteral(sb, "\r\n\r\n");
+    StringBuilderAppendString(sb, body);
+    return StringBuilderFlush(sb);
+  }
+
+  StringBuilderAppendStringLiteral(sb, "transfer-encoding: chunked\r\n\r\n");
+  for (u64 offset = 0; offset < body->length; offset += chunkLength) {
+    u64 chunkEnd = offset + chunkLength < body->length ? offset + chunkLength : body->length;
+    struct string chunk = StringSlice(body, offset, chunkEnd);
+    StringBuilderAppendHex(sb, chunk.length);
+    StringBuilderAppendStringLiteral(sb, "\r\n");
+    StringBuilderAppendString(sb, &chunk);
+    StringBuilderAppendStringLiteral(sb, "\r\n");
+  }
+  StringBuilderAppendStringLiteral(sb, "0\r\n\r\n");
+  return StringBuilderFlush(sb);
+}
+
+/*
+ * Finds recorded response, reads it when it is asked for first time.
+ * @param path relative to directory
+ * @return null when file is not found or cannot be kept
+ */
+internalfn struct invidious_server_response *
+InvidiousServerResponse(struct invidious_server *server, struct string *path)
+{
+  for (u32 responseIndex = 0; responseIndex < server->responseCount; responseIndex++) {
+    struct invidious_server_response *response = server->responses + responseIndex;
+    if (IsStringEqual(&response->path, path))
+      return response;
+  }
+
+  struct string *directory = &server->options.directory;
+  u8 fullPathBuffer[2 * INVIDIOUS_SERVER_PATH_MAX];
+  if (server->responseCount == INVIDIOUS_SERVER_RESPONSE_MAX || path->length >= INVIDIOUS_SERVER_PATH_MAX ||
+      directory->length + 1 + path->length >= sizeof(fullPathBuffer))
+    return 0;
+
+  MemoryCopy(fullPathBuffer, directory->value, directory->length);
+  fullPathBuffer[directory->length] = '/';
+  MemoryCopy(fullPathBuffer + directory->length + 1, path->value, path->length);
+  struct string fullPath = StringFromBuffer(fullPathBuffer, directory->length + 1 + path->length);
+  fullPath.value[fullPath.length] = 0;
+
+  struct string content;
+  if (PlatformReadFile(&server->fileBuffer, &fullPath, &content) != IO_ERROR_NONE)
+    return 0;
+  if (server->arena.used + content.length > server->arena.total)
+    return 0;
+
+  struct invidious_server_response *response = server->responses + server->responseCount;
+  server->responseCount++;
+  *response = (struct invidious_server_response){};
+  MemoryCopy(response->pathBuffer, path->value, path->length);
+  response->path = StringFromBuffer(response->pathBuffer, path->length);
+  response->body = StringFromBuffer(MemoryArenaPush(&server->arena, content.length), content.length);
+  MemoryCopy(response->body.value, content.value, content.length);
+  return response;
+}
+
+/*
+ * @return file request is answered with, relative to directory, in buffer
+ *         null when nothing is recorded for it
+ */
+internalfn struct string
+InvidiousServerRoute(struct string *target, u8 *buffer, u64 bufferLength)
+{
+  struct string_cursor cursor = StringCursorFromString(target);
+  struct string path = StringCursorConsumeUntilOrRest(&cursor, &StringFromLiteral("?"));
+
+  struct string directory;
+  struct string id;
+  struct string *videoPrefix = &StringFromLiteral("/api/v1/videos/");
+  struct string *channelPrefix = &StringFromLiteral("/api/v1/channels/");
+  if (IsStringEqual(&path, &StringFromLiteral("/api/v1/search"))) {
+    return StringFromLiteral("search.json");
+  } else if (IsStringEqual(&path, &StringFromLiteral("/api/v1/stats"))) {
+    return StringFromLiteral("stats.json");
+  } else if (IsStringStartsWith(&path, videoPrefix)) {
+    directory = StringFromLiteral("videos/");
+    id = StringSlice(&path, videoPrefix->length, path.length);
+  } else if (IsStringStartsWith(&path, channelPrefix)) {
+    directory = StringFromLiteral("channels/");
+    struct string rest = StringSlice(&path, channelPrefix->length, path.length);
+    struct string_cursor restCursor = StringCursorFromString(&rest);
+    id = StringCursorConsumeUntilOrRest(&restCursor, &StringFromLiteral("/"));
+  } else {
+    return StringNull();
+  }
+
+  // id names a file, so it must not leave directory
+  if (id.length == 0 || directory.length + id.length + 5 > bufferLength)
+    return StringNull();
+  for (u64 index = 0; index < id.length; index++) {
+    u8 character = id.value[index];
+    b8 isIdCharacter = (character >= 'a' && character <= 'z') || (character >= 'A' && character <= 'Z') ||
+                       (character >= '0' && character <= '9') || character == '-' || character == '_';
+    if (!isIdCharacter)
+      return StringNull();
+  }
+
+  MemoryCopy(buffer, directory.value, directory.length);
+  MemoryCopy(buffer + directory.length, id.value, id.length);
+  MemoryCopy(buffer + directory.length + id.length, (u8 *)".json", 5);
+  return StringFromBuffer(buffer, directory.length + id.length + 5);
+}
+
+/*
+ * @param search query as it is typed
+ * @return false when target is search whose query is not search, or is not
+ *         percent-encoded, true for every other target
+ */
+internalfn b8
+IsInvidiousServerSearchExpected(struct string *target, struct string *search)
+{
+  struct string_cursor cursor = StringCursorFromString(target);
+  struct string path = StringCursorConsumeUntilOrRest(&cursor, &StringFromLiteral("?"));
+  if (!IsStringEqual(&path, &StringFromLiteral("/api/v1/search")))
+    return 1;
+
+  // https://www.rfc-editor.org/rfc/rfc9112#section-3.2 request-target is visible ASCII
+  for (u64 index = 0; index < target->length; index++) {
+    if (target->value[index] <= ' ' || target->value[index] > '~')
+      return 0;
+  }
+
+  StringCursorConsumeThrough(&cursor, &StringFromLiteral("?"));
+  struct string *parameterSeparator = &StringFromLiteral("&");
+  struct string *pairSeparator = &StringFromLiteral("=");
+  while (!IsStringCursorAtEnd(&cursor)) {
+    struct string parameter = StringCursorConsumeUntilOrRest(&cursor, parameterSeparator);
+    StringCursorConsumeThrough(&cursor, parameterSeparator);
+
+    struct string_cursor parameterCursor = StringCursorFromString(&parameter);
+    struct string name = StringCursorConsumeUntilOrRest(&parameterCursor, pairSeparator);
+    if (!IsStringEqual(&name, &StringFromLiteral("q")))
+      continue;
+
+    StringCursorConsumeThrough(&parameterCursor, pairSeparator);
+    struct string value = StringCursorExtractRemaining(&parameterCursor);
+    u8 queryBuffer[INVIDIOUS_SERVER_PATH_MAX];
+    struct string buffer = StringFromBuffer(queryBuffer, sizeof(queryBuffer));
+    struct string query = PercentDecode(&value, &buffer, PERCENT_ENCODING_FORM);
+    return !IsStringNull(&query) && IsStringEqual(&query, search);
+  }
+  return 0;
+}
+
+/*
+ * @param head request line and headers
+ * @return bytes to answer request with
+ */
+internalfn struct string *
+InvidiousServerAnswer(struct invidious_server *server, struct string *head)
+{
+  struct string_cursor cursor = StringCursorFromString(head);
+  struct string *SP = &StringFromLiteral(" ");
+  struct string *CRLF = &StringFromLiteral("\r\n");
+
+  struct string method = StringCursorConsumeUntil(&cursor, SP);
+  StringCursorConsumeThrough(&cursor, SP);
+  struct string target = StringCursorConsumeUntil(&cursor, SP);
+  StringCursorConsumeThrough(&cursor, CRLF);
+  if (!IsStringEqual(&method, &StringFromLiteral("GET")) || IsStringNullOrEmpty(&target))
+    return &server->notFound;
+  if (!IsStringNull(&server->options.search) && !IsInvidiousServerSearchExpected(&target, &server->options.search))
+    return &server->notFound;
+
+  b8 isGzip = 0;
+  struct string *acceptEncoding = &StringFromLiteral("accept-encoding:");
+  while (!IsStringCursorAtEnd(&cursor)) {
+    struct string line = StringCursorConsumeUntilOrRest(&cursor, CRLF);
+    StringCursorConsumeThrough(&cursor, CRLF);
+    if (line.length < acceptEncoding->length)
+      continue;
+    struct string name = StringSlice(&line, 0, acceptEncoding->length);
+    struct string value = StringSlice(&line, acceptEncoding->length, line.length);
+    if (IsStringEqualIgnoreCase(&name, acceptEncoding) && IsStringContains(&value, &StringFromLiteral("gzip")))
+      isGzip = server->options.isGzip;
+  }
+
+  u8 pathBuffer[INVIDIOUS_SERVER_PATH_MAX];
+  struct string path = InvidiousServerRoute(&target, pathBuffer, sizeof(pathBuffer));
+  if (IsStringNull(&path))
+    return &server->notFound;
+
+  struct invidious_server_response *response = InvidiousServerResponse(server, &path);
+  if (!response) {
+    // id that is not recorded
+    struct string_cursor pathCursor = StringCursorFromString(&path);
+    struct string directory = StringCursorConsumeThroughLast(&pathCursor, &StringFromLiteral("/"));
+    if (IsStringNull(&directory))
+      return &server->notFound;
+    MemoryCopy(pathBuffer + directory.length, (u8 *)"default.json", 12);
+    path = StringFromBuffer(pathBuffer, directory.length + 12);
+    response = InvidiousServerResponse(server, &path);
+    if (!response)
+      return &server->notFound;
+  }
+
+  struct string *rendered = response->rendered + isGzip;
+  if (IsStringNull(rendered)) {
+    struct string body = response->body;
+    if (isGzip)
+      body = GzipCompress(server->encoder, &response->body, &server->gzipBuffer);
+    *rendered = InvidiousServerRender(server, &StringFromLiteral("200 OK"), &StringFromLiteral(""), &body, isGzip);
+    if (IsStringNull(rendered))
+      return &server->notFound;
+  }
+  return rendered;
+}
+
+/*
+ * Takes requests that are received, reads what socket has and writes
+ * responses that are ready.
+ * @param now see NowInNanoseconds()
+ * @return false when connection is done
+ */
+internalfn b8
+InvidiousServerConnectionAdvance(struct invidious_server *server, struct invidious_server_connection *connection,
+                                 u64 now)
+{
+  u64 latency = (u64)server->options.latencyInMilliseconds * 1000000 /* 1e6 */;
+  u64 stall = (u64)server->options.stallInMilliseconds * 1000000 /* 1e6 */;
+  struct string *requestEnd = &StringFromLiteral("\r\n\r\n");
+  while (1) {
+    u32 freeLength = INVIDIOUS_SERVER_REQUEST_MAX - connection->requestLength;
+    if (freeLength == 0)
+      return 0; // request is too long
+    s64 bytesRead = PlatformSocketRead(connection->socket, connection->request + connection->requestLength, freeLength);
+    if (bytesRead == PLATFORM_SOCKET_WOULD_BLOCK)
+      break;
+    if (bytesRead <= 0)
+      return 0;
+    connection->requestLength += (u32)bytesRead;
+
+    struct string received = StringFromBuffer(connection->request, connection->requestLength);
+    struct string_cursor cursor = StringCursorFromString(&received);
+    while (1) {
+      struct string head = StringCursorConsumeUntil(&cursor, requestEnd);
+      if (IsStringNull(&head))
+        break;
+      StringCursorConsumeThrough(&cursor, requestEnd);
+
+      if (connection->pendingCount == INVIDIOUS_SERVER_PENDING_MAX)
+        return 0;
+      u32 index = (connection->pendingHead + connection->pendingCount) % INVIDIOUS_SERVER_PENDING_MAX;
+      b8 isRefused = server->options.throttleCount != 0 && server->pendingCount >= server->options.throttleCount;
+      if (isRefused) {
+        connection->pending[index] = &server->tooManyRequests;
+        connection->pendingReadyAt[index] = now;
+      } else {
+        connection->pending[index] = InvidiousServerAnswer(server, &head);
+        connection->pendingReadyAt[index] = now + latency;
+        server->pendingCount++;
+        server->answeredCount++;
+        if (server->options.stallEvery != 0 && server->answeredCount % server->options.stallEvery == 0)
+          connection->pendingReadyAt[index] += stall;
+      }
+      connection->pendingCount++;
+    }
+
+    struct string rest = StringCursorExtractRemaining(&cursor);
+    MemoryMove(connection->request, rest.value, rest.length);
+    connection->requestLength = (u32)rest.length;
+  }
+
+  while (connection->pendingCount != 0 && connection->pendingReadyAt[connection->pendingHead] <= now) {
+    struct string *response = connection->pending[connection->pendingHead];
+    s64 bytesWritten = PlatformSocketWrite(connection->socket, response->value + connection->responseBytesWritten,
+                                           response->length - connection->responseBytesWritten);
+    if (bytesWritten == PLATFORM_SOCKET_WOULD_BLOCK)
+      break;
+    if (bytesWritten < 0)
+      return 0;
+
+    connection->responseBytesWritten += (u64)bytesWritten;
+    if (connection->responseBytesWritten == response->length) {
+      if (response != &server->tooManyRequests)
+        server->pendingCount--;
+      connection->responseBytesWritten = 0;
+      connection->pendingHead = (connection->pendingHead + 1) % INVIDIOUS_SERVER_PENDING_MAX;
+      connection->pendingCount--;
+    }
+  }
+
+  // response that is held back is written when its time comes, see InvidiousServerServe()
+  b8 isWriteWatched = connection->pendingCount != 0 && connection->pendingReadyAt[connection->pendingHead] <= now;
+  if (connection->isWriteWatched != isWriteWatched) {
+    u32 interest = PLATFORM_EVENT_READ | (isWriteWatched ? PLATFORM_EVENT_WRITE : 0);
+    if (!PlatformReactorModify(&server->reactor, connection->socket, interest, connection))
+      return 0;
+    connection->isWriteWatched = isWriteWatched;
+  }
+  return 1;
+}
+
+internalfn void
+InvidiousServerConnectionFree(struct invidious_server *server, struct invidious_server_connection *connection)
+{
+  for (u32 pendingIndex = 0; pendingIndex < connection->pendingCount; pendingIndex++) {
+    u32 index = (connection->pendingHead + pendingIndex) % INVIDIOUS_SERVER_PENDING_MAX;
+    if (connection->pending[index] != &server->tooManyRequests)
+      server->pendingCount--;
+  }
+  PlatformReactorRemove(&server->reactor, connection->socket);
+  PlatformSocketClose(connection->socket);
+  connection->isUsed = 0;
+  connection->nextFree = server->freeList;
+  server->freeList = connection;
+}
+
+/*
+ * Serves on listener until process is killed.
+ * @return only on error, message is printed
+ */
+internalfn void
+InvidiousServerServe(struct invidious_server_options *options, s32 listener)
+{
+  struct invidious_server *server = PlatformAllocate(sizeof(*server));
+  struct invidious_server_connection *connections =
+      PlatformAllocate(sizeof(*connections) * INVIDIOUS_SERVER_CONNECTION_MAX);
+  u8 *memory = PlatformAllocate(INVIDIOUS_SERVER_MEMORY);
+  if (!server || !connections || !memory) {
+    PrintString(&StringFromLiteral("Server memory allocation failed.\n"));
+    return;
+  }
+
+  *server = (struct invidious_server){
+      .options = *options,
+      .arena = {.block = memory, .total = INVIDIOUS_SERVER_MEMORY},
+      .connections = connections,
+  };
+  server->encoder = MakeDeflateEncoder(&server->arena);
+  server->fileBuffer = StringFromBuffer(MemoryArenaPush(&server->arena, INVIDIOUS_SERVER_FILE_MAX),
+                                        INVIDIOUS_SERVER_FILE_MAX);
+  server->gzipBuffer = StringFromBuffer(MemoryArenaPush(&server->arena, GzipBound(INVIDIOUS_SERVER_FILE_MAX)),
+                                        GzipBound(INVIDIOUS_SERVER_FILE_MAX));
+  struct string notFoundBody = StringFromLiteral("{\"error\":\"Not found\"}");
+  server->notFound =
+      InvidiousServerRender(server, &StringFromLiteral("404 Not Found"), &StringFromLiteral(""), &notFoundBody, 0);
+  struct string tooManyRequestsBody = StringFromLiteral("{\"error\":\"Too many requests\"}");
+  server->tooManyRequests = InvidiousServerRender(server, &StringFromLiteral("429 Too Many Requests"),
+                                                  &StringFromLiteral("retry-after: 1\r\n"), &tooManyRequestsBody, 0);
+
+  for (u32 connectionIndex = INVIDIOUS_SERVER_CONNECTION_MAX; connectionIndex-- > 0;) {
+    connections[connectionIndex].isUsed = 0;
+    connections[connectionIndex].nextFree = server->freeList;
+    server->freeList = connections + connectionIndex;
+  }
+
+  if (!PlatformReactorOpen(&server->reactor) ||
+      !PlatformReactorAdd(&server->reactor, listener, PLATFORM_EVENT_READ, 0)) {
+    PrintString(&StringFromLiteral("Server reactor setup failed.\n"));
+    return;
+  }
+
+  struct platform_event events[64];
+  while (1) {
+    // wake up when first response that is held back is due
+    s32 timeout = -1;
+    u64 now = NowInNanoseconds();
+    for (u32 connectionIndex = 0; connectionIndex < INVIDIOUS_SERVER_CONNECTION_MAX; connectionIndex++) {
+      struct invidious_server_connection *connection = connections + connectionIndex;
+      b8 isHeldBack = options->latencyInMilliseconds != 0 || options->stallInMilliseconds != 0;
+      if (!isHeldBack || !connection->isUsed || connection->pendingCount == 0 || connection->isWriteWatched)
+        continue;
+
+      u64 readyAt = connection->pendingReadyAt[connection->pendingHead];
+      if (readyAt <= now) {
+        if (!InvidiousServerConnectionAdvance(server, connection, now)) {
+          InvidiousServerConnectionFree(server, connection);
+          continue;
+        }
+        // next one may be held back longer, e.g. stalled
+        if (connection->pendingCount == 0 || connection->isWriteWatched)
+          continue;
+        readyAt = connection->pendingReadyAt[connection->pendingHead];
+      }
+      // rounded up, so it is due when wait returns
+      s32 remaining = (s32)((readyAt - now + 999999) / 1000000 /* 1e6 */);
+      if (timeout == -1 || remaining < timeout)
+        timeout = remaining;
+    }
+
+    u32 eventCount = PlatformReactorWait(&server->reactor, events, ARRAY_COUNT(events), timeout);
+    now = NowInNanoseconds();
+    for (u32 eventIndex = 0; eventIndex < eventCount; eventIndex++) {
+      struct invidious_server_connection *connection = events[eventIndex].data;
+
+      // listener
+      if (!connection) {
+        s32 socket;
+        while ((socket = PlatformSocketAccept(listener)) >= 0) {
+          connection = server->freeList;
+          if (!connection || !PlatformReactorAdd(&server->reactor, socket, PLATFORM_EVENT_READ, connection)) {
+            PlatformSocketClose(socket);
+            continue;
+          }
+
+          server->freeList = connection->nextFree;
+          connection->socket = socket;
+          connection->isUsed = 1;
+          connection->requestLength = 0;
+          connection->pendingHead = 0;
+          connection->pendingCount = 0;
+          connection->responseBytesWritten = 0;
+          connection->isWriteWatched = 0;
+        }
+        continue;
+      }
+
+      if (!InvidiousServerConnectionAdvance(server, connection, now))
+        InvidiousServerConnectionFree(server, connection);
+    }
+  }
+}
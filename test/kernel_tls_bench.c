@@ -0,0 +1,461 @@
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "bench.h"
+#include "platform.h"
+#include "platform_transport.h"
+#include "string_builder.h"
+#include "tls_connection.c"
+#include "tls_localhost.h"
+
+/*
+ * Compares decrypting in TLS library with decrypting in kernel, Linux kTLS,
+ * see TlsConnectionKernelTls().
+ *
+ * Server is forked and encrypts in TLS library, for every line client sends it
+ * answers with 16 MiB. Client downloads over one connection with library, then
+ * hands records of connection to kernel and downloads again. Client runs on
+ * epoll, kernel cannot take records over io_uring.
+ *
+ * Reported metrics:
+ *   user_space     mebibytes_per_second
+ *                  cpu_microseconds_per_mebibyte  user and system time of
+ *                                                 client
+ *   kernel         available                      0 when kernel has no TLS
+ *                                                 module or cipher, library
+ *                                                 or transport does not
+ *                                                 export keys
+ *                  mebibytes_per_second
+ *                  cpu_microseconds_per_mebibyte
+ *
+ * @code
+ *   modprobe tls
+ *   ./build.sh --with-mbedtls
+ *   build/test/kernel_tls_bench
+ * @endcode
+ */
+
+enum {
+  KILOBYTES = (1 << 10),
+  MEGABYTES = (1 << 20),
+  DOWNLOAD_LENGTH = 16 * MEGABYTES,
+  DOWNLOAD_COUNT = 8,
+  // connection of user space run may still be closing
+  SERVER_CONNECTION_MAX = 4,
+  // TLS records are at most 16 KiB
+  TRANSPORT_BUFFER_LENGTH = 17 * KILOBYTES,
+};
+
+////////////////////////////////////////////////////////////////
+// SERVER
+////////////////////////////////////////////////////////////////
+
+struct server_connection {
+  struct tls_connection tls;
+  u32 pendingDownloadCount;
+  u64 downloadBytesWritten;
+  b8 isUsed;
+};
+
+/*
+ * @param chunk repeated until download is written
+ * @return false when connection is done
+ */
+internalfn b8
+ServerConnectionAdvance(struct server_connection *connection, struct string *chunk)
+{
+  struct tls_connection *tls = &connection->tls;
+  if (tls->state == TLS_CONNECTION_STATE_HANDSHAKING)
+    TlsConnectionHandshake(tls);
+  if (tls->state == TLS_CONNECTION_STATE_FAILED)
+    return 0;
+  if (tls->state != TLS_CONNECTION_STATE_OPEN)
+    return 1;
+
+  // every line asks for a download
+  u8 buffer[256];
+  while (1) {
+    s64 bytesRead = TlsConnectionRead(tls, buffer, sizeof(buffer));
+    if (bytesRead == TLS_CONNECTION_WOULD_BLOCK)
+      break;
+    if (bytesRead <= 0)
+      return 0;
+    for (u64 index = 0; index < (u64)bytesRead; index++) {
+      if (buffer[index] == '\n')
+        connection->pendingDownloadCount++;
+    }
+  }
+
+  while (connection->pendingDownloadCount != 0) {
+    u64 remainingLength = DOWNLOAD_LENGTH - connection->downloadBytesWritten;
+    struct string remaining = StringFromBuffer(chunk->value, remainingLength < chunk->length ? remainingLength
+                                                                                              : chunk->length);
+    s64 bytesWritten = TlsConnectionWrite(tls, &remaining);
+    if (bytesWritten == TLS_CONNECTION_WOULD_BLOCK)
+      break;
+    if (bytesWritten < 0)
+      return 0;
+
+    connection->downloadBytesWritten += (u64)bytesWritten;
+    if (connection->downloadBytesWritten == DOWNLOAD_LENGTH) {
+      connection->downloadBytesWritten = 0;
+      connection->pendingDownloadCount--;
+    }
+  }
+
+  return tls->state != TLS_CONNECTION_STATE_FAILED;
+}
+
+/*
+ * Serves until it is killed.
+ */
+internalfn void
+Serve(s32 listener)
+{
+  struct tls_backend_config tlsConfig;
+  if (!TlsLocalhostSetup(&tlsConfig, 1)) {
+    PrintString(&StringFromLiteral("Server TLS setup failed.\n"));
+    return;
+  }
+
+  struct platform_transport transport;
+  struct platform_transport_options options = {
+      .receiveBufferCount = 2 * SERVER_CONNECTION_MAX,
+      .receiveBufferLength = TRANSPORT_BUFFER_LENGTH,
+      .sendBufferCount = 2 * SERVER_CONNECTION_MAX,
+      .sendBufferLength = TRANSPORT_BUFFER_LENGTH,
+  };
+  // listener is only one without data
+  struct platform_socket listenerSocket = {.data = 0};
+  if (!PlatformTransportOpen(&transport, &options) || !PlatformTransportAttach(&transport, &listenerSocket, listener)) {
+    PrintString(&StringFromLiteral("Server transport setup failed.\n"));
+    return;
+  }
+  PlatformTransportAccept(&transport, &listenerSocket);
+
+  // one record worth
+  struct string chunk = {
+      .value = PlatformAllocate(16 * KILOBYTES),
+      .length = 16 * KILOBYTES,
+  };
+  struct server_connection *connections = PlatformAllocate(sizeof(*connections) * SERVER_CONNECTION_MAX);
+  if (!chunk.value || !connections)
+    return;
+  for (u64 index = 0; index < chunk.length; index++)
+    chunk.value[index] = (u8)('a' + index % 26);
+  for (u32 connectionIndex = 0; connectionIndex < SERVER_CONNECTION_MAX; connectionIndex++) {
+    struct server_connection *connection = connections + connectionIndex;
+    if (!TlsConnectionInit(&connection->tls, &tlsConfig, &transport, connection))
+      return;
+    connection->isUsed = 0;
+  }
+
+  struct platform_completion completions[64];
+  while (1) {
+    u32 completionCount = PlatformTransportWait(&transport, completions, ARRAY_COUNT(completions), -1);
+    for (u32 completionIndex = 0; completionIndex < completionCount; completionIndex++) {
+      struct platform_completion *completion = completions + completionIndex;
+      struct server_connection *connection = completion->data;
+
+      // listener
+      if (!connection) {
+        if (!completion->isMore)
+          PlatformTransportAccept(&transport, &listenerSocket);
+        s32 socket = completion->result;
+        if (socket < 0)
+          continue;
+
+        for (u32 connectionIndex = 0; connectionIndex < SERVER_CONNECTION_MAX && !connection; connectionIndex++) {
+          if (!connections[connectionIndex].isUsed)
+            connection = connections + connectionIndex;
+        }
+        if (!connection) {
+          PlatformSocketClose(socket);
+          continue;
+        }
+
+        connection->isUsed = 1;
+        connection->pendingDownloadCount = 0;
+        connection->downloadBytesWritten = 0;
+        TlsConnectionAccept(&connection->tls, socket);
+        if (connection->tls.state != TLS_CONNECTION_STATE_FAILED)
+          continue;
+      } else {
+        TlsConnectionComplete(&connection->tls, completion);
+        if (ServerConnectionAdvance(connection, &chunk))
+          continue;
+      }
+
+      TlsConnectionClose(&connection->tls);
+      connection->isUsed = 0;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////
+// CLIENT
+////////////////////////////////////////////////////////////////
+
+struct client {
+  struct platform_transport transport;
+  struct tls_connection tls;
+  struct platform_address address;
+};
+
+/*
+ * Gives completions to connection.
+ */
+internalfn void
+ClientWait(struct client *client)
+{
+  struct platform_completion completions[64];
+  u32 completionCount = PlatformTransportWait(&client->transport, completions, ARRAY_COUNT(completions), -1);
+  for (u32 completionIndex = 0; completionIndex < completionCount; completionIndex++) {
+    struct platform_completion *completion = completions + completionIndex;
+    TlsConnectionComplete(completion->data, completion);
+  }
+}
+
+/*
+ * @return false on error
+ */
+internalfn b8
+ClientOpen(struct client *client)
+{
+  TlsConnectionConnect(&client->tls, &client->address, &StringFromLiteral("localhost"));
+  while (1) {
+    TlsConnectionHandshake(&client->tls);
+    if (client->tls.state == TLS_CONNECTION_STATE_FAILED)
+      return 0;
+    if (client->tls.state == TLS_CONNECTION_STATE_OPEN)
+      return 1;
+    ClientWait(client);
+  }
+}
+
+internalfn void
+ClientClose(struct client *client)
+{
+  TlsConnectionClose(&client->tls);
+  struct platform_completion completions[64];
+  PlatformTransportWait(&client->transport, completions, ARRAY_COUNT(completions), 0);
+}
+
+/*
+ * Asks for one download and reads it, every byte is gone when it returns.
+ * @return false on error
+ */
+internalfn b8
+ClientDownload(struct client *client)
+{
+  struct tls_connection *tls = &client->tls;
+  struct string request = StringFromLiteral("\n");
+  while (1) {
+    s64 bytesWritten = TlsConnectionWrite(tls, &request);
+    if (bytesWritten == 1)
+      break;
+    if (bytesWritten != TLS_CONNECTION_WOULD_BLOCK)
+      return 0;
+    ClientWait(client);
+  }
+
+  u8 buffer[16 * KILOBYTES];
+  u64 totalBytesRead = 0;
+  while (totalBytesRead < DOWNLOAD_LENGTH) {
+    s64 bytesRead = TlsConnectionRead(tls, buffer, sizeof(buffer));
+    if (bytesRead == TLS_CONNECTION_WOULD_BLOCK)
+      ClientWait(client);
+    else if (bytesRead <= 0)
+      return 0;
+    else
+      totalBytesRead += (u64)bytesRead;
+  }
+  return 1;
+}
+
+/*
+ * @return microseconds that process spent on CPU, user and system
+ */
+internalfn u64
+CpuTimeInMicroseconds(void)
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return (u64)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 + (u64)usage.ru_utime.tv_usec +
+         (u64)usage.ru_stime.tv_usec;
+}
+
+/*
+ * Downloads DOWNLOAD_COUNT times and reports it under name.
+ * @return false on error
+ */
+internalfn b8
+ClientMeasure(struct client *client, struct bench *bench, struct string *name)
+{
+  string_builder *sb = bench->sb;
+  u64 startedAt = NowInNanoseconds();
+  u64 cpuStartedAt = CpuTimeInMicroseconds();
+  for (u32 downloadIndex = 0; downloadIndex < DOWNLOAD_COUNT; downloadIndex++) {
+    if (!ClientDownload(client)) {
+      StringBuilderAppendStringLiteral(sb, "Download failed.\n  error: ");
+      StringBuilderAppendS32(sb, client->tls.error);
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string message = StringBuilderFlush(sb);
+      PrintString(&message);
+      return 0;
+    }
+  }
+  u64 elapsed = NowInNanoseconds() - startedAt;
+  u64 cpuElapsed = CpuTimeInMicroseconds() - cpuStartedAt;
+  if (elapsed == 0)
+    elapsed = 1;
+
+  u64 mebibytes = (u64)DOWNLOAD_COUNT * (DOWNLOAD_LENGTH / MEGABYTES);
+  u64 mebibytesPerSecond = mebibytes * 1000000000 / elapsed;
+  u64 cpuPerMebibyte = cpuElapsed / mebibytes;
+  StringBuilderAppendString(sb, name);
+  StringBuilderAppendStringLiteral(sb, ": ");
+  StringBuilderAppendU64(sb, mebibytes);
+  StringBuilderAppendStringLiteral(sb, " MiB, ");
+  StringBuilderAppendU64(sb, mebibytesPerSecond);
+  StringBuilderAppendStringLiteral(sb, " MiB/s, ");
+  StringBuilderAppendU64(sb, cpuPerMebibyte);
+  StringBuilderAppendStringLiteral(sb, " us CPU per MiB\n");
+  struct string message = StringBuilderFlush(sb);
+  PrintString(&message);
+
+  BenchReport(bench, name, &StringFromLiteral("mebibytes_per_second"), mebibytesPerSecond);
+  BenchReport(bench, name, &StringFromLiteral("cpu_microseconds_per_mebibyte"), cpuPerMebibyte);
+  return 1;
+}
+
+int
+main(int argc, char *argv[])
+{
+  // setup
+  u8 stackBuffer[64 * KILOBYTES];
+  memory_arena stackMemory = {
+      .block = stackBuffer,
+      .total = ARRAY_COUNT(stackBuffer),
+  };
+
+  string_builder *sb = MakeStringBuilder(&stackMemory, 1024, 32);
+
+  memory_arena heapMemory = {
+      .total = 2 * MEGABYTES,
+  };
+  heapMemory.block = PlatformAllocate(heapMemory.total);
+  if (!heapMemory.block) {
+    StringBuilderAppendStringLiteral(sb, "Could not allocate ");
+    StringBuilderAppendU64(sb, heapMemory.total / MEGABYTES);
+    StringBuilderAppendStringLiteral(sb, "MiB memory");
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return 1;
+  }
+
+  struct bench bench = {.sb = sb, .baseline = StringNull()};
+  for (u32 argumentIndex = 1; argumentIndex < argc; argumentIndex++) {
+    struct string argument = StringFromZeroTerminated((u8 *)argv[argumentIndex], 1024);
+    struct string *baselineOption = &StringFromLiteral("--baseline=");
+    if (IsStringStartsWith(&argument, baselineOption)) {
+      struct string path = StringSlice(&argument, baselineOption->length, argument.length);
+      struct string *buffer = MakeString(&heapMemory, 1 * MEGABYTES);
+      if (PlatformReadFile(buffer, &path, &bench.baseline) != IO_ERROR_NONE) {
+        StringBuilderAppendStringLiteral(sb, "Could not read baseline.");
+        StringBuilderAppendStringLiteral(sb, "\n  path: ");
+        StringBuilderAppendString(sb, &path);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string message = StringBuilderFlush(sb);
+        PrintString(&message);
+        return 1;
+      }
+    }
+  }
+
+  struct client *client = PlatformAllocate(sizeof(*client));
+  if (!client ||
+      !PlatformAddressResolve(&StringFromLiteral("127.0.0.1"), &StringFromLiteral("0"), &client->address)) {
+    PrintString(&StringFromLiteral("Could not resolve loopback address.\n"));
+    return 1;
+  }
+
+  s32 listener = PlatformSocketListen(&client->address);
+  if (listener == -1) {
+    StringBuilderAppendStringLiteral(sb, "Could not listen.\n  error: ");
+    StringBuilderAppendPlatformError(sb);
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return 1;
+  }
+
+  pid_t serverPid = fork();
+  if (serverPid == -1) {
+    PrintString(&StringFromLiteral("Could not start server.\n"));
+    return 1;
+  }
+  if (serverPid == 0) {
+    Serve(listener);
+    _exit(1);
+  }
+  PlatformSocketClose(listener);
+
+  int exitCode = 0;
+  struct platform_transport_options options = {
+      .receiveBufferCount = 16,
+      .receiveBufferLength = TRANSPORT_BUFFER_LENGTH,
+      .sendBufferCount = 2,
+      .sendBufferLength = TRANSPORT_BUFFER_LENGTH,
+      .isIoUringDisabled = 1,
+  };
+  struct tls_backend_config tlsConfig;
+  if (!PlatformTransportOpen(&client->transport, &options) || !TlsLocalhostSetup(&tlsConfig, 0) ||
+      !TlsConnectionInit(&client->tls, &tlsConfig, &client->transport, &client->tls)) {
+    PrintString(&StringFromLiteral("Client setup failed.\n"));
+    exitCode = 1;
+    goto stop;
+  }
+
+  // user space
+  if (!ClientOpen(client) || !ClientMeasure(client, &bench, &StringFromLiteral("user_space"))) {
+    PrintString(&StringFromLiteral("User space run failed.\n"));
+    exitCode = 1;
+    goto stop;
+  }
+  ClientClose(client);
+
+  // kernel, first download takes session ticket and leaves connection idle
+  if (!ClientOpen(client) || !ClientDownload(client)) {
+    PrintString(&StringFromLiteral("Kernel run failed.\n"));
+    exitCode = 1;
+    goto stop;
+  }
+  if (!TlsConnectionKernelTls(&client->tls)) {
+    StringBuilderAppendStringLiteral(sb, "kernel: not available, library decrypts\n  error: ");
+    StringBuilderAppendPlatformError(sb);
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    BenchReport(&bench, &StringFromLiteral("kernel"), &StringFromLiteral("available"), 0);
+  } else {
+    if (!client->tls.isKernelTlsSend)
+      PrintString(&StringFromLiteral("kernel: decrypts, library still encrypts\n"));
+    BenchReport(&bench, &StringFromLiteral("kernel"), &StringFromLiteral("available"), 1);
+    if (!ClientMeasure(client, &bench, &StringFromLiteral("kernel"))) {
+      exitCode = 1;
+      goto stop;
+    }
+  }
+  ClientClose(client);
+
+  TlsConnectionRelease(&client->tls);
+  PlatformTransportClose(&client->transport);
+
+stop:
+  kill(serverPid, SIGTERM);
+  waitpid(serverPid, 0, 0);
+  return exitCode;
+}
@@ -5,7 +5,9 @@
 #define TEST_ERROR_LIST(X)                                                                                             \
   X(PARSE_EXPECTED_TRUE, "Options must be parsed successfully")                                                        \
   X(PARSE_EXPECTED_FALSE, "Options must NOT be able to parsed")                                                        \
-  X(PARSE_EXPECTED_VIDEOID, "Video id must match with expected")
+  X(PARSE_EXPECTED_VIDEOID, "Video id must match with expected")                                                      \
+  X(PARSE_EXPECTED_SEARCH, "Search must match with expected")                                                        \
+  X(PARSE_EXPECTED_INSTANCE, "Instances must match with expected")
 
 enum options_test_error {
   OPTIONS_TEST_ERROR_NONE = 0,
@@ -61,8 +63,13 @@ StringBuilderAppendOptionsError(string_builder *sb, enum options_error errorCode
       {.code = OPTIONS_ERROR_NONE, .message = StringFromLiteral("None")},
       {.code = OPTIONS_ERROR_INSTANCE_REQUIRED, .message = StringFromLiteral("instance required")},
       {.code = OPTIONS_ERROR_INSTANCE_INVALID, .message = StringFromLiteral("instance invalid")},
+      {.code = OPTIONS_ERROR_INSTANCE_TOO_MANY, .message = StringFromLiteral("instance too many")},
       {.code = OPTIONS_ERROR_VIDEO_REQUIRED, .message = StringFromLiteral("video required")},
       {.code = OPTIONS_ERROR_VIDEO_INVALID, .message = StringFromLiteral("video invalid")},
+      {.code = OPTIONS_ERROR_SEARCH_REQUIRED, .message = StringFromLiteral("search required")},
+      {.code = OPTIONS_ERROR_SEARCH_INVALID, .message = StringFromLiteral("search invalid")},
+      {.code = OPTIONS_ERROR_BATCH_REQUIRED, .message = StringFromLiteral("batch required")},
+      {.code = OPTIONS_ERROR_CONCURRENCY_INVALID, .message = StringFromLiteral("concurrency invalid")},
       {.code = OPTIONS_ERROR_HELP, .message = StringFromLiteral("Help")},
   };
   string message = StringFromLiteral("Unknown options error");
@@ -118,7 +125,9 @@ main(void)
       char **arguments;
       struct {
         enum options_error value;
-        struct string videoId;
+        // null after last one
+        struct string videoIds[2];
+        struct string search;
       } expected;
     } testCases[] = {
         {
@@ -131,7 +140,7 @@ main(void)
             .expected =
                 {
                     .value = OPTIONS_ERROR_NONE,
-                    .videoId = StringFromLiteral("d_oVysaqG_0"),
+                    .videoIds = {StringFromLiteral("d_oVysaqG_0")},
                 },
         },
         {
@@ -144,7 +153,7 @@ main(void)
             .expected =
                 {
                     .value = OPTIONS_ERROR_NONE,
-                    .videoId = StringFromLiteral("nAQyQ3hjEDI"),
+                    .videoIds = {StringFromLiteral("nAQyQ3hjEDI")},
                 },
         },
         {
@@ -157,7 +166,7 @@ main(void)
             .expected =
                 {
                     .value = OPTIONS_ERROR_NONE,
-                    .videoId = StringFromLiteral("d_oVysaqG_0"),
+                    .videoIds = {StringFromLiteral("d_oVysaqG_0")},
                 },
         },
         {
@@ -170,7 +179,7 @@ main(void)
             .expected =
                 {
                     .value = OPTIONS_ERROR_NONE,
-                    .videoId = StringFromLiteral("d_oVysaqG_0"),
+                    .videoIds = {StringFromLiteral("d_oVysaqG_0")},
                 },
         },
         {
@@ -183,7 +192,7 @@ main(void)
             .expected =
                 {
                     .value = OPTIONS_ERROR_NONE,
-                    .videoId = StringFromLiteral("d_oVysaqG_0"),
+                    .videoIds = {StringFromLiteral("d_oVysaqG_0")},
                 },
         },
         {
@@ -196,7 +205,7 @@ main(void)
             .expected =
                 {
                     .value = OPTIONS_ERROR_NONE,
-                    .videoId = StringFromLiteral("d_oVysaqG_0"),
+                    .videoIds = {StringFromLiteral("d_oVysaqG_0")},
                 },
         },
         {
@@ -209,7 +218,37 @@ main(void)
             .expected =
                 {
                     .value = OPTIONS_ERROR_NONE,
-                    .videoId = StringFromLiteral("mh1U5ltHQiQ"),
+                    .videoIds = {StringFromLiteral("mh1U5ltHQiQ")},
+                },
+        },
+        {
+            .argumentCount = 5,
+            .arguments =
+                (char *[]){
+                    "program",
+                    "mh1U5ltHQiQ",
+                    "--concurrency",
+                    "4",
+                    "https://youtu.be/d_oVysaqG_0",
+                },
+            .expected =
+                {
+                    .value = OPTIONS_ERROR_NONE,
+                    .videoIds = {StringFromLiteral("mh1U5ltHQiQ"), StringFromLiteral("d_oVysaqG_0")},
+                },
+        },
+        {
+            // flags are matched whole, not by prefix
+            .argumentCount = 3,
+            .arguments =
+                (char *[]){
+                    "program",
+                    "--instance-files",
+                    "instances.txt",
+                },
+            .expected =
+                {
+                    .value = OPTIONS_ERROR_VIDEO_INVALID,
                 },
         },
         {
@@ -235,13 +274,81 @@ main(void)
                     .value = OPTIONS_ERROR_VIDEO_INVALID,
                 },
         },
+        {
+            .argumentCount = 3,
+            .arguments =
+                (char *[]){
+                    "program",
+                    "--search",
+                    "rust & c++ 100%",
+                },
+            .expected =
+                {
+                    .value = OPTIONS_ERROR_NONE,
+                    .search = StringFromLiteral("rust & c++ 100%"),
+                },
+        },
+        {
+            .argumentCount = 2,
+            .arguments =
+                (char *[]){
+                    "program",
+                    "-s",
+                },
+            .expected =
+                {
+                    .value = OPTIONS_ERROR_SEARCH_REQUIRED,
+                },
+        },
+        {
+            .argumentCount = 2,
+            .arguments =
+                (char *[]){
+                    "program",
+                    "https://www.youtube.com/results?search_query=rust+%26+c%2B%2B+100%25",
+                },
+            .expected =
+                {
+                    .value = OPTIONS_ERROR_NONE,
+                    .search = StringFromLiteral("rust & c++ 100%"),
+                },
+        },
+        {
+            .argumentCount = 2,
+            .arguments =
+                (char *[]){
+                    "program",
+                    "https://yewtu.be/search?page=2&q=%C3%A7ay+demleme+rehberi+-+uzun+bir+arama+c%C3%BCmlesi"
+                    "&type=video",
+                },
+            .expected =
+                {
+                    .value = OPTIONS_ERROR_NONE,
+                    .search = StringFromLiteral("\xc3\xa7""ay demleme rehberi - uzun bir arama c\xc3\xbcmlesi"),
+                },
+        },
+        {
+            .argumentCount = 2,
+            .arguments =
+                (char *[]){
+                    "program",
+                    "https://yewtu.be/search?q=100%ZZ",
+                },
+            .expected =
+                {
+                    .value = OPTIONS_ERROR_SEARCH_INVALID,
+                },
+        },
     };
 
     for (u32 testCaseIndex = 0; testCaseIndex < ARRAY_COUNT(testCases); testCaseIndex++) {
       struct test_case *testCase = testCases + testCaseIndex;
 
-      struct options optionsBuffer = {};
+      struct options optionsBuffer;
       struct options *options = &optionsBuffer;
+      OptionsInit(options);
+      struct string videoIds[8];
+      options->videoIds = videoIds;
       u32 argumentCount = testCase->argumentCount;
       char **arguments = testCase->arguments;
 
@@ -265,21 +372,311 @@ main(void)
       if (expected != OPTIONS_ERROR_NONE)
         continue;
 
-      struct string *expectedVideoId = &testCase->expected.videoId;
-      struct string *videoId = &options->videoId;
-      if (!IsStringEqual(videoId, expectedVideoId)) {
+      struct string *expectedSearch = &testCase->expected.search;
+      struct string *search = &options->search;
+      if (!IsStringEqual(search, expectedSearch)) {
+        errorCode = OPTIONS_TEST_ERROR_PARSE_EXPECTED_SEARCH;
+
+        StringBuilderAppendErrorMessage(sb, errorCode);
+        StringBuilderAppendStringLiteral(sb, "\n  expected: ");
+        StringBuilderAppendPrintableString(sb, expectedSearch);
+        StringBuilderAppendStringLiteral(sb, "\n       got: ");
+        StringBuilderAppendPrintableString(sb, search);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+        continue;
+      }
+
+      for (u32 videoIdIndex = 0; videoIdIndex <= ARRAY_COUNT(testCase->expected.videoIds); videoIdIndex++) {
+        struct string expectedVideoId = StringNull();
+        if (videoIdIndex < ARRAY_COUNT(testCase->expected.videoIds))
+          expectedVideoId = testCase->expected.videoIds[videoIdIndex];
+        struct string videoId = videoIdIndex < options->videoIdCount ? options->videoIds[videoIdIndex] : StringNull();
+        if (IsStringEqual(&videoId, &expectedVideoId))
+          continue;
+
         errorCode = OPTIONS_TEST_ERROR_PARSE_EXPECTED_VIDEOID;
 
         StringBuilderAppendErrorMessage(sb, errorCode);
+        StringBuilderAppendStringLiteral(sb, "\n  at index: ");
+        StringBuilderAppendU32(sb, videoIdIndex);
         StringBuilderAppendStringLiteral(sb, "\n  expected: ");
-        StringBuilderAppendPrintableString(sb, expectedVideoId);
+        StringBuilderAppendPrintableString(sb, &expectedVideoId);
         StringBuilderAppendStringLiteral(sb, "\n       got: ");
-        StringBuilderAppendPrintableString(sb, videoId);
+        StringBuilderAppendPrintableString(sb, &videoId);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+        break;
+      }
+    }
+  }
+
+  // enum options_error OptionsAddInstance(struct options *options, struct string *instance)
+  {
+    struct test_case {
+      struct string instance;
+      struct {
+        enum options_error value;
+        struct string hostname;
+        struct string port;
+        b8 isPlain;
+      } expected;
+    } testCases[] = {
+        {
+            .instance = StringFromLiteral("https://yewtu.be"),
+            .expected = {.hostname = StringFromLiteral("yewtu.be"), .port = StringFromLiteral("443")},
+        },
+        {
+            .instance = StringFromLiteral("https://inv.nadeko.net/feed/popular"),
+            .expected = {.hostname = StringFromLiteral("inv.nadeko.net"), .port = StringFromLiteral("443")},
+        },
+        {
+            .instance = StringFromLiteral("http://invidious.local"),
+            .expected =
+                {
+                    .hostname = StringFromLiteral("invidious.local"),
+                    .port = StringFromLiteral("80"),
+                    .isPlain = 1,
+                },
+        },
+        {
+            .instance = StringFromLiteral("http://localhost:3000/"),
+            .expected =
+                {
+                    .hostname = StringFromLiteral("localhost"),
+                    .port = StringFromLiteral("3000"),
+                    .isPlain = 1,
+                },
+        },
+        {
+            .instance = StringFromLiteral("yewtu.be"),
+            .expected = {.hostname = StringFromLiteral("yewtu.be"), .port = StringFromLiteral("443")},
+        },
+        {
+            .instance = StringFromLiteral("  yewtu.be:8443\n"),
+            .expected = {.hostname = StringFromLiteral("yewtu.be"), .port = StringFromLiteral("8443")},
+        },
+        {
+            .instance = StringFromLiteral("https://[::1]:8443/api"),
+            .expected = {.hostname = StringFromLiteral("::1"), .port = StringFromLiteral("8443")},
+        },
+        {
+            .instance = StringFromLiteral("ftp://yewtu.be"),
+            .expected = {.value = OPTIONS_ERROR_INSTANCE_INVALID},
+        },
+        {
+            .instance = StringFromLiteral("https://"),
+            .expected = {.value = OPTIONS_ERROR_INSTANCE_INVALID},
+        },
+        {
+            .instance = StringFromLiteral("https://yewtu.be:"),
+            .expected = {.value = OPTIONS_ERROR_INSTANCE_INVALID},
+        },
+        {
+            .instance = StringFromLiteral("https://yewtu.be:99999"),
+            .expected = {.value = OPTIONS_ERROR_INSTANCE_INVALID},
+        },
+        {
+            .instance = StringFromLiteral("https://yewtu.be:44a"),
+            .expected = {.value = OPTIONS_ERROR_INSTANCE_INVALID},
+        },
+        {
+            .instance = StringFromLiteral("https://[::1:8443"),
+            .expected = {.value = OPTIONS_ERROR_INSTANCE_INVALID},
+        },
+        {
+            .instance = StringFromLiteral("https://user@yewtu.be"),
+            .expected = {.value = OPTIONS_ERROR_INSTANCE_INVALID},
+        },
+    };
+
+    for (u32 testCaseIndex = 0; testCaseIndex < ARRAY_COUNT(testCases); testCaseIndex++) {
+      struct test_case *testCase = testCases + testCaseIndex;
+
+      struct options options = {};
+      enum options_error expected = testCase->expected.value;
+      enum options_error got = OptionsAddInstance(&options, &testCase->instance);
+      if (got != expected) {
+        errorCode = expected ? OPTIONS_TEST_ERROR_PARSE_EXPECTED_FALSE : OPTIONS_TEST_ERROR_PARSE_EXPECTED_TRUE;
+
+        StringBuilderAppendErrorMessage(sb, errorCode);
+        StringBuilderAppendStringLiteral(sb, "\n  instance: ");
+        StringBuilderAppendPrintableString(sb, &testCase->instance);
+        StringBuilderAppendStringLiteral(sb, "\n  expected: ");
+        StringBuilderAppendOptionsError(sb, expected);
+        StringBuilderAppendStringLiteral(sb, "\n       got: ");
+        StringBuilderAppendOptionsError(sb, got);
         StringBuilderAppendStringLiteral(sb, "\n");
         struct string errorMessage = StringBuilderFlush(sb);
         PrintString(&errorMessage);
         continue;
       }
+
+      if (expected != OPTIONS_ERROR_NONE)
+        continue;
+
+      struct options_instance *instance = options.instances + 0;
+      if (options.instanceCount != 1 || !IsStringEqual(&instance->hostname, &testCase->expected.hostname) ||
+          !IsStringEqual(&instance->port, &testCase->expected.port) ||
+          instance->isPlain != testCase->expected.isPlain) {
+        errorCode = OPTIONS_TEST_ERROR_PARSE_EXPECTED_INSTANCE;
+
+        StringBuilderAppendErrorMessage(sb, errorCode);
+        StringBuilderAppendStringLiteral(sb, "\n  instance: ");
+        StringBuilderAppendPrintableString(sb, &testCase->instance);
+        StringBuilderAppendStringLiteral(sb, "\n  expected: ");
+        StringBuilderAppendString(sb, &testCase->expected.hostname);
+        StringBuilderAppendStringLiteral(sb, " ");
+        StringBuilderAppendString(sb, &testCase->expected.port);
+        if (testCase->expected.isPlain)
+          StringBuilderAppendStringLiteral(sb, " plain");
+        StringBuilderAppendStringLiteral(sb, "\n       got: ");
+        StringBuilderAppendPrintableString(sb, &instance->hostname);
+        StringBuilderAppendStringLiteral(sb, " ");
+        StringBuilderAppendPrintableString(sb, &instance->port);
+        if (instance->isPlain)
+          StringBuilderAppendStringLiteral(sb, " plain");
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+      }
+    }
+  }
+
+  // instance list: default is replaced, duplicates are dropped, list is capped
+  {
+    struct options options;
+    OptionsInit(&options);
+    struct string content = StringFromLiteral("# public instances\n"
+                                              "\n"
+                                              "https://yewtu.be\r\n"
+                                              "  inv.nadeko.net  \n"
+                                              "yewtu.be\n"
+                                              "http://localhost:3000\n"
+                                              "localhost:3000");
+    enum options_error got = OptionsAddInstanceList(&options, &content);
+    struct string expectedHostnames[] = {
+        StringFromLiteral("yewtu.be"),
+        StringFromLiteral("inv.nadeko.net"),
+        StringFromLiteral("localhost"),
+        StringFromLiteral("localhost"),
+    };
+    b8 isEqual = got == OPTIONS_ERROR_NONE && options.instanceCount == ARRAY_COUNT(expectedHostnames);
+    for (u32 index = 0; isEqual && index < ARRAY_COUNT(expectedHostnames); index++)
+      isEqual = IsStringEqual(&options.instances[index].hostname, expectedHostnames + index);
+    // same host and port over TLS is another instance
+    isEqual = isEqual && options.instances[2].isPlain && !options.instances[3].isPlain;
+
+    char *arguments[] = {"program", "-i", "https://a.example", "--instance", "b.example:8443", "d_oVysaqG_0"};
+    struct options parsed;
+    OptionsInit(&parsed);
+    struct string videoIds[ARRAY_COUNT(arguments)];
+    parsed.videoIds = videoIds;
+    got = OptionsParse(&parsed, ARRAY_COUNT(arguments), arguments);
+    isEqual = isEqual && got == OPTIONS_ERROR_NONE && parsed.instanceCount == 2 &&
+              IsStringEqual(&parsed.instances[0].hostname, &StringFromLiteral("a.example")) &&
+              IsStringEqual(&parsed.instances[1].port, &StringFromLiteral("8443"));
+
+    char *fileArguments[] = {"program", "--instance-file", "instances.txt", "d_oVysaqG_0"};
+    OptionsInit(&parsed);
+    parsed.videoIds = videoIds;
+    got = OptionsParse(&parsed, ARRAY_COUNT(fileArguments), fileArguments);
+    isEqual = isEqual && got == OPTIONS_ERROR_NONE &&
+              IsStringEqual(&parsed.instanceFile, &StringFromLiteral("instances.txt")) && parsed.instanceCount == 1 &&
+              IsStringEqual(&parsed.instances[0].hostname, &StringFromLiteral("i.iii.st"));
+
+    struct options full = {};
+    u8 hostnames[OPTIONS_INSTANCE_MAX + 1][16];
+    for (u32 index = 0; index <= OPTIONS_INSTANCE_MAX; index++) {
+      struct string hostname = StringFromBuffer(hostnames[index], 2);
+      hostname.value[0] = 'a';
+      hostname.value[1] = (u8)('a' + index);
+      got = OptionsAddInstance(&full, &hostname);
+    }
+    isEqual = isEqual && got == OPTIONS_ERROR_INSTANCE_TOO_MANY && full.instanceCount == OPTIONS_INSTANCE_MAX;
+
+    if (!isEqual) {
+      errorCode = OPTIONS_TEST_ERROR_PARSE_EXPECTED_INSTANCE;
+      StringBuilderAppendErrorMessage(sb, errorCode);
+      StringBuilderAppendStringLiteral(sb, "\n  instance list is not parsed as expected\n");
+      struct string errorMessage = StringBuilderFlush(sb);
+      PrintString(&errorMessage);
+    }
+  }
+
+  // kernel TLS is a flag, video id after it is still parsed
+  {
+    char *arguments[] = {"program", "--kernel-tls", "d_oVysaqG_0"};
+    struct options options;
+    OptionsInit(&options);
+    struct string videoIds[ARRAY_COUNT(arguments)];
+    options.videoIds = videoIds;
+    enum options_error got = OptionsParse(&options, ARRAY_COUNT(arguments), arguments);
+    if (got != OPTIONS_ERROR_NONE || !options.isKernelTls || options.videoIdCount != 1 ||
+        !IsStringEqual(options.videoIds + 0, &StringFromLiteral("d_oVysaqG_0"))) {
+      errorCode = OPTIONS_TEST_ERROR_PARSE_EXPECTED_TRUE;
+      StringBuilderAppendErrorMessage(sb, errorCode);
+      StringBuilderAppendStringLiteral(sb, "\n  --kernel-tls is not parsed as expected\n");
+      struct string errorMessage = StringBuilderFlush(sb);
+      PrintString(&errorMessage);
+    }
+  }
+
+  // timing is a flag too, it is off unless given
+  {
+    char *arguments[] = {"program", "d_oVysaqG_0", "--timing"};
+    struct options options;
+    OptionsInit(&options);
+    struct string videoIds[ARRAY_COUNT(arguments)];
+    options.videoIds = videoIds;
+    b8 isOffByDefault = !options.isTiming;
+    enum options_error got = OptionsParse(&options, ARRAY_COUNT(arguments), arguments);
+    if (got != OPTIONS_ERROR_NONE || !isOffByDefault || !options.isTiming || options.videoIdCount != 1 ||
+        !IsStringEqual(options.videoIds + 0, &StringFromLiteral("d_oVysaqG_0"))) {
+      errorCode = OPTIONS_TEST_ERROR_PARSE_EXPECTED_TRUE;
+      StringBuilderAppendErrorMessage(sb, errorCode);
+      StringBuilderAppendStringLiteral(sb, "\n  --timing is not parsed as expected\n");
+      struct string errorMessage = StringBuilderFlush(sb);
+      PrintString(&errorMessage);
+    }
+  }
+
+  // batch takes place of video, concurrency must be a positive number
+  {
+    char *arguments[] = {"program", "--batch", "-", "--concurrency", "64", "--unordered", "--hedge"};
+    struct options options;
+    OptionsInit(&options);
+    struct string videoIds[8];
+    options.videoIds = videoIds;
+    b8 isOffByDefault =
+        IsStringNull(&options.batchFile) && options.requestMax == 0 && !options.isUnordered && !options.isHedging;
+    enum options_error got = OptionsParse(&options, ARRAY_COUNT(arguments), arguments);
+    b8 isExpected = got == OPTIONS_ERROR_NONE && isOffByDefault &&
+                    IsStringEqual(&options.batchFile, &StringFromLiteral("-")) && options.requestMax == 64 &&
+                    options.isUnordered && options.isHedging && options.videoIdCount == 0;
+
+    char *withoutPath[] = {"program", "--batch"};
+    OptionsInit(&options);
+    isExpected = isExpected && OptionsParse(&options, ARRAY_COUNT(withoutPath), withoutPath) ==
+                                   OPTIONS_ERROR_BATCH_REQUIRED;
+
+    char *invalidValues[] = {"0", "-1", "many", "9999999999"};
+    for (u32 valueIndex = 0; valueIndex < ARRAY_COUNT(invalidValues); valueIndex++) {
+      char *invalid[] = {"program", "d_oVysaqG_0", "--concurrency", invalidValues[valueIndex]};
+      OptionsInit(&options);
+      options.videoIds = videoIds;
+      isExpected = isExpected && OptionsParse(&options, ARRAY_COUNT(invalid), invalid) ==
+                                     OPTIONS_ERROR_CONCURRENCY_INVALID;
+    }
+
+    if (!isExpected) {
+      errorCode = OPTIONS_TEST_ERROR_PARSE_EXPECTED_TRUE;
+      StringBuilderAppendErrorMessage(sb, errorCode);
+      StringBuilderAppendStringLiteral(sb, "\n  --batch, --concurrency and --hedge are not parsed as expected\n");
+      struct string errorMessage = StringBuilderFlush(sb);
+      PrintString(&errorMessage);
     }
   }
 
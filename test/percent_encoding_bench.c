@@ -0,0 +1,274 @@
+#include "bench.h"
+#include "percent_encoding.h"
+#include "platform.h"
+#include "string_builder.h"
+
+/*
+ * Measures PercentEncode() and PercentDecode() against plain byte at a time
+ * loops, on inputs that look like what the program sends:
+ *   video_id     11 characters, nothing to encode
+ *   search       short query with spaces and a few reserved characters
+ *   title        4 KiB of words, mostly unreserved
+ *   unreserved   64 KiB, nothing to encode
+ *   utf8         4 KiB of non ASCII text, almost everything is encoded
+ *
+ * Inputs are generated with fixed seed so runs are comparable. See bench.h for
+ * machine readable output and --baseline.
+ */
+
+enum {
+  KILOBYTES = (1 << 10),
+  MEGABYTES = (1 << 20),
+};
+
+struct input {
+  struct string name;
+  struct string decoded;
+  struct string encoded;
+};
+
+internalfn u64
+RandomXorShift64(u64 *state)
+{
+  u64 x = *state;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  *state = x;
+  return x;
+}
+
+internalfn struct string
+ScalarEncode(struct string *string, struct string *buffer)
+{
+  comptime u8 HEX_DIGITS[16] = "0123456789ABCDEF";
+  u64 length = 0;
+  for (u64 index = 0; index < string->length; index++) {
+    u8 character = string->value[index];
+    if (IsPercentUnreserved(character)) {
+      buffer->value[length++] = character;
+    } else if (character == ' ') {
+      buffer->value[length++] = '+';
+    } else {
+      buffer->value[length++] = '%';
+      buffer->value[length++] = HEX_DIGITS[character >> 4];
+      buffer->value[length++] = HEX_DIGITS[character & 0xf];
+    }
+  }
+  return StringFromBuffer(buffer->value, length);
+}
+
+internalfn struct string
+ScalarDecode(struct string *string, struct string *buffer)
+{
+  u64 length = 0;
+  for (u64 index = 0; index < string->length; index++) {
+    u8 character = string->value[index];
+    if (character == '%') {
+      buffer->value[length++] =
+          (u8)(PercentHexValue(string->value[index + 1]) << 4 | PercentHexValue(string->value[index + 2]));
+      index += 2;
+    } else if (character == '+') {
+      buffer->value[length++] = ' ';
+    } else {
+      buffer->value[length++] = character;
+    }
+  }
+  return StringFromBuffer(buffer->value, length);
+}
+
+enum operation {
+  OPERATION_ENCODE,
+  OPERATION_DECODE,
+  OPERATION_SCALAR_ENCODE,
+  OPERATION_SCALAR_DECODE,
+};
+
+/*
+ * Runs operation many times and returns the fastest run.
+ * Fastest run is the one least disturbed by rest of the system.
+ */
+internalfn u64
+Measure(enum operation operation, struct input *input, struct string *buffer)
+{
+  comptime u64 minimumDuration = 200 * 1000000UL /* 200ms */;
+  comptime u32 maximumRunCount = 1000000;
+  // short inputs are repeated so clock resolution does not dominate
+  u32 repeatCount = (u32)(64 * KILOBYTES / (input->decoded.length + 1)) + 1;
+
+  u64 best = (u64)-1;
+  u64 total = 0;
+  for (u32 runIndex = 0; runIndex < maximumRunCount && total < minimumDuration; runIndex++) {
+    u64 startedAt = NowInNanoseconds();
+    for (u32 repeatIndex = 0; repeatIndex < repeatCount; repeatIndex++) {
+      struct string result;
+      switch (operation) {
+      case OPERATION_ENCODE:
+        result = PercentEncode(&input->decoded, buffer, PERCENT_ENCODING_FORM);
+        break;
+      case OPERATION_DECODE:
+        result = PercentDecode(&input->encoded, buffer, PERCENT_ENCODING_FORM);
+        break;
+      case OPERATION_SCALAR_ENCODE:
+        result = ScalarEncode(&input->decoded, buffer);
+        break;
+      case OPERATION_SCALAR_DECODE:
+        result = ScalarDecode(&input->encoded, buffer);
+        break;
+      }
+      // keep compiler from removing the work
+      __asm__ volatile("" : : "r"(result.value), "r"(result.length) : "memory");
+    }
+    u64 elapsed = (NowInNanoseconds() - startedAt) / repeatCount;
+
+    total += elapsed * repeatCount;
+    if (elapsed < best)
+      best = elapsed;
+  }
+
+  return best;
+}
+
+internalfn struct string
+GenerateText(memory_arena *arena, u64 length, struct string *alphabet, u64 seed)
+{
+  struct string *text = MakeString(arena, length);
+  for (u64 index = 0; index < length; index++)
+    text->value[index] = alphabet->value[RandomXorShift64(&seed) % alphabet->length];
+  return *text;
+}
+
+int
+main(int argc, char *argv[])
+{
+  // setup
+  u8 stackBuffer[64 * KILOBYTES];
+  memory_arena stackMemory = {
+      .block = stackBuffer,
+      .total = ARRAY_COUNT(stackBuffer),
+  };
+
+  string_builder *sb = MakeStringBuilder(&stackMemory, 1024, 32);
+
+  memory_arena heapMemory = {
+      .total = 8 * MEGABYTES,
+  };
+  heapMemory.block = PlatformAllocate(heapMemory.total);
+  if (!heapMemory.block) {
+    StringBuilderAppendStringLiteral(sb, "Could not allocate ");
+    StringBuilderAppendU64(sb, heapMemory.total / MEGABYTES);
+    StringBuilderAppendStringLiteral(sb, "MiB memory");
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return 1;
+  }
+
+  struct bench bench = {.sb = sb, .baseline = StringNull()};
+  for (u32 argumentIndex = 1; argumentIndex < argc; argumentIndex++) {
+    struct string argument = StringFromZeroTerminated((u8 *)argv[argumentIndex], 1024);
+    struct string *baselineOption = &StringFromLiteral("--baseline=");
+    if (IsStringStartsWith(&argument, baselineOption)) {
+      struct string path = StringSlice(&argument, baselineOption->length, argument.length);
+      struct string *buffer = MakeString(&heapMemory, 1 * MEGABYTES);
+      if (PlatformReadFile(buffer, &path, &bench.baseline) != IO_ERROR_NONE) {
+        StringBuilderAppendStringLiteral(sb, "Could not read baseline.");
+        StringBuilderAppendStringLiteral(sb, "\n  path: ");
+        StringBuilderAppendString(sb, &path);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string message = StringBuilderFlush(sb);
+        PrintString(&message);
+        return 1;
+      }
+    }
+  }
+
+  // inputs
+  struct input inputs[5];
+  u32 inputCount = 0;
+  {
+    struct string words = StringFromLiteral("abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz"
+                                            "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789      -.,:!?'&()");
+    struct string unreserved = StringFromLiteral("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-._~");
+    // cyrillic letters, spaces and punctuation
+    struct string utf8 = StringFromLiteral("\xd0\xb0\xd0\xb1\xd0\xb2\xd0\xb3\xd0\xb4\xd0\xb5 ,.");
+
+    inputs[inputCount++] = (struct input){
+        .name = StringFromLiteral("video_id"),
+        .decoded = StringFromLiteral("d_oVysaqG_0"),
+    };
+    inputs[inputCount++] = (struct input){
+        .name = StringFromLiteral("search"),
+        .decoded = StringFromLiteral("how to cook rice & beans (easy) - 10 minutes"),
+    };
+    inputs[inputCount++] = (struct input){
+        .name = StringFromLiteral("title"),
+        .decoded = GenerateText(&heapMemory, 4 * KILOBYTES, &words, 0x9e3779b97f4a7c15),
+    };
+    inputs[inputCount++] = (struct input){
+        .name = StringFromLiteral("unreserved"),
+        .decoded = GenerateText(&heapMemory, 64 * KILOBYTES, &unreserved, 0x9e3779b97f4a7c15),
+    };
+    inputs[inputCount++] = (struct input){
+        .name = StringFromLiteral("utf8"),
+        .decoded = GenerateText(&heapMemory, 4 * KILOBYTES, &utf8, 0x9e3779b97f4a7c15),
+    };
+
+    for (u32 inputIndex = 0; inputIndex < inputCount; inputIndex++) {
+      struct input *input = inputs + inputIndex;
+      struct string *buffer =
+          MakeString(&heapMemory, PercentEncodedLength(&input->decoded, PERCENT_ENCODING_FORM));
+      input->encoded = PercentEncode(&input->decoded, buffer, PERCENT_ENCODING_FORM);
+    }
+  }
+
+  struct string *buffer = MakeString(&heapMemory, 3 * 64 * KILOBYTES);
+
+  struct {
+    struct string name;
+    enum operation operation;
+  } operations[] = {
+      {.name = StringFromLiteral("encode"), .operation = OPERATION_ENCODE},
+      {.name = StringFromLiteral("decode"), .operation = OPERATION_DECODE},
+      {.name = StringFromLiteral("scalar_encode"), .operation = OPERATION_SCALAR_ENCODE},
+      {.name = StringFromLiteral("scalar_decode"), .operation = OPERATION_SCALAR_DECODE},
+  };
+
+  for (u32 inputIndex = 0; inputIndex < inputCount; inputIndex++) {
+    struct input *input = inputs + inputIndex;
+
+    for (u32 operationIndex = 0; operationIndex < ARRAY_COUNT(operations); operationIndex++) {
+      enum operation operation = operations[operationIndex].operation;
+      u64 elapsed = Measure(operation, input, buffer);
+      if (elapsed == 0)
+        elapsed = 1;
+      // throughput is measured on decoded length for both directions
+      u64 bytesPerSecond = input->decoded.length * 1000000000UL / elapsed;
+
+      StringBuilderAppendString(sb, &input->name);
+      StringBuilderAppendStringLiteral(sb, "/");
+      StringBuilderAppendString(sb, &operations[operationIndex].name);
+      struct string name = StringBuilderFlush(sb);
+      // name is overwritten by next flush, keep copy
+      u8 nameBuffer[64];
+      debug_assert(name.length <= sizeof(nameBuffer));
+      MemoryCopy(nameBuffer, name.value, name.length);
+      name.value = nameBuffer;
+
+      StringBuilderAppendString(sb, &name);
+      StringBuilderAppendStringLiteral(sb, ": ");
+      StringBuilderAppendU64(sb, input->decoded.length);
+      StringBuilderAppendStringLiteral(sb, " bytes, ");
+      StringBuilderAppendU64(sb, elapsed);
+      StringBuilderAppendStringLiteral(sb, " ns, ");
+      StringBuilderAppendF32(sb, (f32)bytesPerSecond / (f32)MEGABYTES, 2);
+      StringBuilderAppendStringLiteral(sb, " MiB/s\n");
+      struct string message = StringBuilderFlush(sb);
+      PrintString(&message);
+
+      BenchReport(&bench, &name, &StringFromLiteral("bytes_per_second"), bytesPerSecond);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,545 @@
+#include <signal.h>
+#include <sys/wait.h>
+
+#include "bench.h"
+#include "http_parser.c"
+#include "platform.h"
+#include "platform_transport.h"
+#include "string_builder.h"
+#include "tls_connection.c"
+#include "tls_localhost.h"
+
+/*
+ * Measures how many requests one thread completes when TLS connections are
+ * driven by transport, against a local TLS stand-in server.
+ *
+ * Server is forked, it runs its own transport and answers every request with
+ * same 4 KiB json over TLS 1.3 with keep-alive. Client opens 1, 16 and 256
+ * connections, each sends next request as soon as previous one is answered,
+ * until 8192 requests are answered. Client runs on epoll, then on io_uring
+ * when it is available.
+ *
+ * Reported metrics:
+ *   handshakes_per_second  until every connection is open
+ *   requests_per_second    from first connect to last response
+ *
+ * See bench.h for machine readable output and --baseline.
+ */
+
+enum {
+  KILOBYTES = (1 << 10),
+  MEGABYTES = (1 << 20),
+  REQUEST_COUNT = 8192,
+  CLIENT_CONNECTION_MAX = 256,
+  // connections of previous run may still be closing
+  SERVER_CONNECTION_MAX = 2 * CLIENT_CONNECTION_MAX,
+  RESPONSE_BUFFER_LENGTH = 16 * KILOBYTES,
+  // TLS records are at most 16 KiB
+  TRANSPORT_BUFFER_LENGTH = 17 * KILOBYTES,
+};
+
+////////////////////////////////////////////////////////////////
+// SERVER
+////////////////////////////////////////////////////////////////
+
+struct server_connection {
+  struct tls_connection tls;
+  struct server_connection *nextFree;
+
+  u8 requestBuffer[4 * KILOBYTES];
+  u64 requestLength;
+
+  // requests that are received but not answered
+  u32 pendingResponseCount;
+  u64 responseBytesWritten;
+};
+
+internalfn void
+ServerConnectionFree(struct server_connection **freeList, struct server_connection *connection)
+{
+  TlsConnectionClose(&connection->tls);
+  connection->nextFree = *freeList;
+  *freeList = connection;
+}
+
+/*
+ * @return false when connection is done
+ */
+internalfn b8
+ServerConnectionAdvance(struct server_connection *connection, struct string *response)
+{
+  struct tls_connection *tls = &connection->tls;
+  if (tls->state == TLS_CONNECTION_STATE_HANDSHAKING)
+    TlsConnectionHandshake(tls);
+  if (tls->state == TLS_CONNECTION_STATE_FAILED)
+    return 0;
+  if (tls->state != TLS_CONNECTION_STATE_OPEN)
+    return 1;
+
+  // every empty line ends a request, requests have no body
+  while (1) {
+    u64 capacity = sizeof(connection->requestBuffer) - connection->requestLength;
+    s64 bytesRead = TlsConnectionRead(tls, connection->requestBuffer + connection->requestLength, capacity);
+    if (bytesRead == TLS_CONNECTION_WOULD_BLOCK)
+      break;
+    if (bytesRead <= 0)
+      return 0;
+    connection->requestLength += (u64)bytesRead;
+
+    u64 consumedLength = 0;
+    for (u64 index = 0; index + 4 <= connection->requestLength; index++) {
+      u8 *octets = connection->requestBuffer + index;
+      if (octets[0] == '\r' && octets[1] == '\n' && octets[2] == '\r' && octets[3] == '\n') {
+        connection->pendingResponseCount++;
+        consumedLength = index + 4;
+      }
+    }
+    MemoryMove(connection->requestBuffer, connection->requestBuffer + consumedLength,
+               connection->requestLength - consumedLength);
+    connection->requestLength -= consumedLength;
+    if (connection->requestLength == sizeof(connection->requestBuffer))
+      return 0; // request is too long
+  }
+
+  while (connection->pendingResponseCount != 0) {
+    struct string remaining = StringFromBuffer(response->value + connection->responseBytesWritten,
+                                               response->length - connection->responseBytesWritten);
+    s64 bytesWritten = TlsConnectionWrite(tls, &remaining);
+    if (bytesWritten == TLS_CONNECTION_WOULD_BLOCK)
+      break;
+    if (bytesWritten < 0)
+      return 0;
+
+    connection->responseBytesWritten += (u64)bytesWritten;
+    if (connection->responseBytesWritten == response->length) {
+      connection->responseBytesWritten = 0;
+      connection->pendingResponseCount--;
+    }
+  }
+
+  return tls->state != TLS_CONNECTION_STATE_FAILED;
+}
+
+/*
+ * Serves until it is killed.
+ */
+internalfn void
+Serve(s32 listener, struct string *response)
+{
+  struct tls_backend_config tlsConfig;
+  if (!TlsLocalhostSetup(&tlsConfig, 1)) {
+    PrintString(&StringFromLiteral("Server TLS setup failed.\n"));
+    return;
+  }
+
+  struct platform_transport transport;
+  struct platform_transport_options options = {
+      .receiveBufferCount = 2 * SERVER_CONNECTION_MAX,
+      .receiveBufferLength = TRANSPORT_BUFFER_LENGTH,
+      .sendBufferCount = 2 * SERVER_CONNECTION_MAX,
+      .sendBufferLength = TRANSPORT_BUFFER_LENGTH,
+  };
+  // listener is only one without data
+  struct platform_socket listenerSocket = {.data = 0};
+  if (!PlatformTransportOpen(&transport, &options) || !PlatformTransportAttach(&transport, &listenerSocket, listener)) {
+    PrintString(&StringFromLiteral("Server transport setup failed.\n"));
+    return;
+  }
+  PlatformTransportAccept(&transport, &listenerSocket);
+
+  struct server_connection *connections = PlatformAllocate(sizeof(*connections) * SERVER_CONNECTION_MAX);
+  struct server_connection *freeList = 0;
+  if (!connections)
+    return;
+  for (u32 connectionIndex = SERVER_CONNECTION_MAX; connectionIndex-- > 0;) {
+    struct server_connection *connection = connections + connectionIndex;
+    if (!TlsConnectionInit(&connection->tls, &tlsConfig, &transport, connection))
+      return;
+    connection->nextFree = freeList;
+    freeList = connection;
+  }
+
+  struct platform_completion completions[64];
+  while (1) {
+    u32 completionCount = PlatformTransportWait(&transport, completions, ARRAY_COUNT(completions), -1);
+    for (u32 completionIndex = 0; completionIndex < completionCount; completionIndex++) {
+      struct platform_completion *completion = completions + completionIndex;
+      struct server_connection *connection = completion->data;
+
+      // listener
+      if (!connection) {
+        if (!completion->isMore)
+          PlatformTransportAccept(&transport, &listenerSocket);
+        s32 socket = completion->result;
+        if (socket < 0)
+          continue;
+        if (!freeList) {
+          PlatformSocketClose(socket);
+          continue;
+        }
+
+        connection = freeList;
+        freeList = connection->nextFree;
+        connection->requestLength = 0;
+        connection->pendingResponseCount = 0;
+        connection->responseBytesWritten = 0;
+        TlsConnectionAccept(&connection->tls, socket);
+        if (connection->tls.state == TLS_CONNECTION_STATE_FAILED)
+          ServerConnectionFree(&freeList, connection);
+        continue;
+      }
+
+      TlsConnectionComplete(&connection->tls, completion);
+      if (!ServerConnectionAdvance(connection, response))
+        ServerConnectionFree(&freeList, connection);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////
+// CLIENT
+////////////////////////////////////////////////////////////////
+
+struct client_connection {
+  struct tls_connection tls;
+  b8 isOpen;
+
+  b8 isRequestInFlight;
+  u64 requestBytesWritten;
+
+  u8 *responseBuffer;
+  u64 totalBytesRead;
+  struct http_parser *httpParser;
+};
+
+struct client {
+  struct string request;
+  u32 openCount;
+  u32 sentCount;
+  u32 completedCount;
+};
+
+/*
+ * @return false on error
+ */
+internalfn b8
+ClientConnectionAdvance(struct client *client, struct client_connection *connection)
+{
+  struct tls_connection *tls = &connection->tls;
+  if (tls->state == TLS_CONNECTION_STATE_CONNECTING || tls->state == TLS_CONNECTION_STATE_HANDSHAKING)
+    TlsConnectionHandshake(tls);
+  if (tls->state == TLS_CONNECTION_STATE_FAILED)
+    return 0;
+  if (tls->state != TLS_CONNECTION_STATE_OPEN)
+    return 1;
+
+  if (!connection->isOpen) {
+    connection->isOpen = 1;
+    client->openCount++;
+  }
+
+  b8 isAnswered;
+  do {
+    isAnswered = 0;
+
+    if (!connection->isRequestInFlight && client->sentCount < REQUEST_COUNT) {
+      connection->isRequestInFlight = 1;
+      connection->requestBytesWritten = 0;
+      client->sentCount++;
+    }
+
+    if (connection->isRequestInFlight && connection->requestBytesWritten < client->request.length) {
+      struct string remaining = StringFromBuffer(client->request.value + connection->requestBytesWritten,
+                                                 client->request.length - connection->requestBytesWritten);
+      s64 bytesWritten = TlsConnectionWrite(tls, &remaining);
+      if (bytesWritten == -1)
+        return 0;
+      if (bytesWritten > 0)
+        connection->requestBytesWritten += (u64)bytesWritten;
+    }
+
+    while (connection->isRequestInFlight) {
+      if (connection->totalBytesRead == RESPONSE_BUFFER_LENGTH)
+        return 0; // response is too long
+      s64 bytesRead = TlsConnectionRead(tls, connection->responseBuffer + connection->totalBytesRead,
+                                        RESPONSE_BUFFER_LENGTH - connection->totalBytesRead);
+      if (bytesRead == TLS_CONNECTION_WOULD_BLOCK)
+        break;
+      if (bytesRead <= 0)
+        return 0;
+      connection->totalBytesRead += (u64)bytesRead;
+
+      struct http_parser *httpParser = connection->httpParser;
+      struct string packet = StringFromBuffer(connection->responseBuffer + httpParser->position,
+                                              connection->totalBytesRead - httpParser->position);
+      if (!HttpParse(httpParser, &packet)) {
+        if (httpParser->error == HTTP_PARSER_ERROR_PARTIAL)
+          continue;
+        return 0;
+      }
+      if (httpParser->statusCode != 200)
+        return 0;
+
+      // one request is in flight, so nothing follows response
+      connection->totalBytesRead = 0;
+      HttpParserNext(httpParser);
+      httpParser->position = 0;
+      connection->isRequestInFlight = 0;
+      client->completedCount++;
+      isAnswered = 1;
+    }
+  } while (isAnswered && client->sentCount < REQUEST_COUNT);
+
+  return tls->state != TLS_CONNECTION_STATE_FAILED;
+}
+
+int
+main(int argc, char *argv[])
+{
+  // setup
+  u8 stackBuffer[64 * KILOBYTES];
+  memory_arena stackMemory = {
+      .block = stackBuffer,
+      .total = ARRAY_COUNT(stackBuffer),
+  };
+
+  string_builder *sb = MakeStringBuilder(&stackMemory, 1024, 32);
+
+  memory_arena heapMemory = {
+      .total = 8 * MEGABYTES,
+  };
+  heapMemory.block = PlatformAllocate(heapMemory.total);
+  if (!heapMemory.block) {
+    StringBuilderAppendStringLiteral(sb, "Could not allocate ");
+    StringBuilderAppendU64(sb, heapMemory.total / MEGABYTES);
+    StringBuilderAppendStringLiteral(sb, "MiB memory");
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return 1;
+  }
+
+  struct bench bench = {.sb = sb, .baseline = StringNull()};
+  for (u32 argumentIndex = 1; argumentIndex < argc; argumentIndex++) {
+    struct string argument = StringFromZeroTerminated((u8 *)argv[argumentIndex], 1024);
+    struct string *baselineOption = &StringFromLiteral("--baseline=");
+    if (IsStringStartsWith(&argument, baselineOption)) {
+      struct string path = StringSlice(&argument, baselineOption->length, argument.length);
+      struct string *buffer = MakeString(&heapMemory, 1 * MEGABYTES);
+      if (PlatformReadFile(buffer, &path, &bench.baseline) != IO_ERROR_NONE) {
+        StringBuilderAppendStringLiteral(sb, "Could not read baseline.");
+        StringBuilderAppendStringLiteral(sb, "\n  path: ");
+        StringBuilderAppendString(sb, &path);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string message = StringBuilderFlush(sb);
+        PrintString(&message);
+        return 1;
+      }
+    }
+  }
+
+  // response that looks like /api/v1/videos/:id
+  struct string response;
+  {
+    comptime u64 bodyLength = 4 * KILOBYTES;
+    string_builder *responseBuilder = MakeStringBuilder(&heapMemory, bodyLength + 256, 32);
+    StringBuilderAppendStringLiteral(responseBuilder, "HTTP/1.1 200 OK\r\n"
+                                                      "content-type: application/json\r\n"
+                                                      "content-length: ");
+    StringBuilderAppendU64(responseBuilder, bodyLength);
+    StringBuilderAppendStringLiteral(responseBuilder, "\r\n\r\n");
+    struct string *head = &StringFromLiteral("{\"type\":\"video\",\"title\":\"Stand-in\",\"description\":\"");
+    struct string *tail = &StringFromLiteral("\"}");
+    StringBuilderAppendString(responseBuilder, head);
+    for (u64 index = head->length + tail->length; index < bodyLength; index++)
+      StringBuilderAppendStringLiteral(responseBuilder, "a");
+    StringBuilderAppendString(responseBuilder, tail);
+    response = StringBuilderFlush(responseBuilder);
+  }
+
+  struct platform_address address;
+  if (!PlatformAddressResolve(&StringFromLiteral("127.0.0.1"), &StringFromLiteral("0"), &address)) {
+    PrintString(&StringFromLiteral("Could not resolve loopback address.\n"));
+    return 1;
+  }
+
+  s32 listener = PlatformSocketListen(&address);
+  if (listener == -1) {
+    StringBuilderAppendStringLiteral(sb, "Could not listen.\n  error: ");
+    StringBuilderAppendPlatformError(sb);
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return 1;
+  }
+
+  pid_t serverPid = fork();
+  if (serverPid == -1) {
+    PrintString(&StringFromLiteral("Could not start server.\n"));
+    return 1;
+  }
+  if (serverPid == 0) {
+    Serve(listener, &response);
+    _exit(1);
+  }
+  PlatformSocketClose(listener);
+
+  int exitCode = 0;
+  struct tls_backend_config tlsConfig;
+  if (!TlsLocalhostSetup(&tlsConfig, 0)) {
+    PrintString(&StringFromLiteral("Client setup failed.\n"));
+    exitCode = 1;
+    goto stop;
+  }
+
+  struct client client = {
+      .request = StringFromLiteral("GET /api/v1/videos/d_oVysaqG_0 HTTP/1.1\r\n"
+                                   "host: localhost\r\n"
+                                   "accept: application/json\r\n"
+                                   "\r\n"),
+  };
+
+  struct client_connection *connections = MemoryArenaPush(&heapMemory, sizeof(*connections) * CLIENT_CONNECTION_MAX);
+  for (u32 connectionIndex = 0; connectionIndex < CLIENT_CONNECTION_MAX; connectionIndex++) {
+    struct client_connection *connection = connections + connectionIndex;
+    connection->responseBuffer = MemoryArenaPush(&heapMemory, RESPONSE_BUFFER_LENGTH);
+    connection->httpParser = MakeHttpStreamingParser(&heapMemory, 16);
+  }
+
+  struct string *backends[] = {
+      &StringFromLiteral("epoll"),
+      &StringFromLiteral("io_uring"),
+  };
+  for (u32 backendIndex = 0; backendIndex < ARRAY_COUNT(backends); backendIndex++) {
+    struct string *backend = backends[backendIndex];
+    struct platform_transport transport;
+    struct platform_transport_options options = {
+        .receiveBufferCount = 2 * CLIENT_CONNECTION_MAX,
+        .receiveBufferLength = TRANSPORT_BUFFER_LENGTH,
+        .sendBufferCount = 2 * CLIENT_CONNECTION_MAX,
+        .sendBufferLength = TRANSPORT_BUFFER_LENGTH,
+        .isIoUringDisabled = backendIndex == 0,
+    };
+    if (!PlatformTransportOpen(&transport, &options)) {
+      PrintString(&StringFromLiteral("Client transport setup failed.\n"));
+      exitCode = 1;
+      break;
+    }
+    if (backendIndex == 1 && transport.backend != PLATFORM_TRANSPORT_BACKEND_IO_URING) {
+      PrintString(&StringFromLiteral("io_uring is not available, skipped.\n"));
+      PlatformTransportClose(&transport);
+      break;
+    }
+
+    for (u32 connectionIndex = 0; connectionIndex < CLIENT_CONNECTION_MAX; connectionIndex++) {
+      struct client_connection *connection = connections + connectionIndex;
+      if (!TlsConnectionInit(&connection->tls, &tlsConfig, &transport, connection)) {
+        PrintString(&StringFromLiteral("Client setup failed.\n"));
+        exitCode = 1;
+        goto stop;
+      }
+    }
+
+    u32 connectionCounts[] = {1, 16, CLIENT_CONNECTION_MAX};
+    for (u32 runIndex = 0; runIndex < ARRAY_COUNT(connectionCounts); runIndex++) {
+      u32 connectionCount = connectionCounts[runIndex];
+      client.openCount = 0;
+      client.sentCount = 0;
+      client.completedCount = 0;
+
+      u64 startedAt = NowInNanoseconds();
+      u64 handshakeElapsed = 0;
+      for (u32 connectionIndex = 0; connectionIndex < connectionCount; connectionIndex++) {
+        struct client_connection *connection = connections + connectionIndex;
+        connection->isOpen = 0;
+        connection->isRequestInFlight = 0;
+        connection->totalBytesRead = 0;
+        HttpParserNext(connection->httpParser);
+        connection->httpParser->position = 0;
+        TlsConnectionConnect(&connection->tls, &address, &StringFromLiteral("localhost"));
+      }
+
+      b8 isFailed = 0;
+      struct platform_completion completions[64];
+      while (!isFailed && client.completedCount < REQUEST_COUNT) {
+        u32 completionCount = PlatformTransportWait(&transport, completions, ARRAY_COUNT(completions), -1);
+        for (u32 completionIndex = 0; completionIndex < completionCount; completionIndex++) {
+          struct platform_completion *completion = completions + completionIndex;
+          struct client_connection *connection = completion->data;
+          TlsConnectionComplete(&connection->tls, completion);
+          if (!ClientConnectionAdvance(&client, connection)) {
+            isFailed = 1;
+            break;
+          }
+        }
+
+        if (handshakeElapsed == 0 && client.openCount == connectionCount)
+          handshakeElapsed = NowInNanoseconds() - startedAt;
+      }
+      u64 elapsed = NowInNanoseconds() - startedAt;
+
+      for (u32 connectionIndex = 0; connectionIndex < connectionCount; connectionIndex++)
+        TlsConnectionClose(&connections[connectionIndex].tls);
+      // submit closes
+      PlatformTransportWait(&transport, completions, ARRAY_COUNT(completions), 0);
+
+      if (isFailed) {
+        StringBuilderAppendStringLiteral(sb, "Request failed.\n  backend: ");
+        StringBuilderAppendString(sb, backend);
+        StringBuilderAppendStringLiteral(sb, "\n  connections: ");
+        StringBuilderAppendU32(sb, connectionCount);
+        StringBuilderAppendStringLiteral(sb, "\n  completed: ");
+        StringBuilderAppendU32(sb, client.completedCount);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string message = StringBuilderFlush(sb);
+        PrintString(&message);
+        exitCode = 1;
+        break;
+      }
+
+      if (elapsed == 0)
+        elapsed = 1;
+      if (handshakeElapsed == 0)
+        handshakeElapsed = 1;
+      u64 requestsPerSecond = (u64)REQUEST_COUNT * 1000000000UL / elapsed;
+      u64 handshakesPerSecond = (u64)connectionCount * 1000000000UL / handshakeElapsed;
+
+      StringBuilderAppendString(sb, backend);
+      StringBuilderAppendStringLiteral(sb, "_connections_");
+      StringBuilderAppendU32(sb, connectionCount);
+      struct string name = StringBuilderFlush(sb);
+      // name is overwritten by next flush, keep copy
+      u8 nameBuffer[64];
+      debug_assert(name.length <= sizeof(nameBuffer));
+      MemoryCopy(nameBuffer, name.value, name.length);
+      name.value = nameBuffer;
+
+      StringBuilderAppendString(sb, &name);
+      StringBuilderAppendStringLiteral(sb, ": ");
+      StringBuilderAppendU64(sb, REQUEST_COUNT);
+      StringBuilderAppendStringLiteral(sb, " requests in ");
+      StringBuilderAppendU64(sb, elapsed / 1000000);
+      StringBuilderAppendStringLiteral(sb, " ms, ");
+      StringBuilderAppendU64(sb, requestsPerSecond);
+      StringBuilderAppendStringLiteral(sb, " req/s, ");
+      StringBuilderAppendU64(sb, handshakesPerSecond);
+      StringBuilderAppendStringLiteral(sb, " handshake/s\n");
+      struct string message = StringBuilderFlush(sb);
+      PrintString(&message);
+
+      BenchReport(&bench, &name, &StringFromLiteral("handshakes_per_second"), handshakesPerSecond);
+      BenchReport(&bench, &name, &StringFromLiteral("requests_per_second"), requestsPerSecond);
+    }
+
+    for (u32 connectionIndex = 0; connectionIndex < CLIENT_CONNECTION_MAX; connectionIndex++)
+      TlsConnectionRelease(&connections[connectionIndex].tls);
+    PlatformTransportClose(&transport);
+    if (exitCode)
+      break;
+  }
+
+stop:
+  kill(serverPid, SIGTERM);
+  waitpid(serverPid, 0, 0);
+  return exitCode;
+}
@@ -0,0 +1,174 @@
+#include "receive_buffer.c"
+#include "print.h"
+#include "string_builder.h"
+
+#define TEST_ERROR_LIST(X)                                                                                             \
+  X(INIT, "Buffer must start with minimum capacity committed")                                                         \
+  X(GROW, "Buffer must grow in place, at least doubling, within reservation")                                          \
+  X(CONSUME, "Consumed bytes must be dropped and rest moved to start")                                                 \
+  X(TRIM, "Pages past bytes in buffer must be given back")
+
+enum receive_buffer_test_error {
+  RECEIVE_BUFFER_TEST_ERROR_NONE = 0,
+#define X(tag, message) RECEIVE_BUFFER_TEST_ERROR_##tag,
+  TEST_ERROR_LIST(X)
+#undef X
+
+  // src: https://mesonbuild.com/Unit-tests.html#skipped-tests-and-hard-errors
+  // For the default exitcode testing protocol, the GNU standard approach in
+  // this case is to exit the program with error code 77. Meson will detect this
+  // and report these tests as skipped rather than failed. This behavior was
+  // added in version 0.37.0.
+  MESON_TEST_SKIP = 77,
+  // In addition, sometimes a test fails set up so that it should fail even if
+  // it is marked as an expected failure. The GNU standard approach in this case
+  // is to exit the program with error code 99. Again, Meson will detect this
+  // and report these tests as ERROR, ignoring the setting of should_fail. This
+  // behavior was added in version 0.50.0.
+  MESON_TEST_FAILED_TO_SET_UP = 99,
+};
+
+internalfn void
+StringBuilderAppendTestError(struct string_builder *sb, enum receive_buffer_test_error errorCode)
+{
+  struct string message = StringFromLiteral("Unknown error");
+  struct error {
+    enum receive_buffer_test_error code;
+    struct string message;
+  } errors[] = {
+#define XX(tag, msg) {.code = RECEIVE_BUFFER_TEST_ERROR_##tag, .message = StringFromLiteral(msg)},
+      TEST_ERROR_LIST(XX)
+#undef XX
+  };
+
+  for (u32 errorIndex = 0; errorIndex < ARRAY_COUNT(errors); errorIndex++) {
+    struct error *error = errors + errorIndex;
+    if (error->code != errorCode)
+      continue;
+
+    message = error->message;
+    break;
+  }
+
+  StringBuilderAppendString(sb, &message);
+}
+
+internalfn void
+PrintReceiveBufferError(string_builder *sb, enum receive_buffer_test_error errorCode, struct receive_buffer *buffer)
+{
+  StringBuilderAppendTestError(sb, errorCode);
+  StringBuilderAppendStringLiteral(sb, "\n  length: ");
+  StringBuilderAppendU64(sb, buffer->length);
+  StringBuilderAppendStringLiteral(sb, " capacity: ");
+  StringBuilderAppendU64(sb, buffer->capacity);
+  StringBuilderAppendStringLiteral(sb, " reserved: ");
+  StringBuilderAppendU64(sb, buffer->reserved);
+  StringBuilderAppendStringLiteral(sb, "\n");
+  struct string errorMessage = StringBuilderFlush(sb);
+  PrintString(&errorMessage);
+}
+
+int
+main(void)
+{
+  enum receive_buffer_test_error errorCode = RECEIVE_BUFFER_TEST_ERROR_NONE;
+
+  // setup
+  enum {
+    KILOBYTES = (1 << 10),
+    MEGABYTES = (1 << 20),
+  };
+  u8 stackBuffer[64 * KILOBYTES];
+  memory_arena stackMemory = {
+      .block = stackBuffer,
+      .total = ARRAY_COUNT(stackBuffer),
+  };
+
+  string_builder *sb = MakeStringBuilder(&stackMemory, 4 * KILOBYTES, 32);
+
+  struct receive_buffer buffer;
+  if (!ReceiveBufferInit(&buffer, 1 * MEGABYTES))
+    return MESON_TEST_FAILED_TO_SET_UP;
+
+  // b8 ReceiveBufferInit(struct receive_buffer *buffer, u64 reserved)
+  {
+    b8 isExpected = buffer.value && buffer.length == 0 && buffer.capacity == RECEIVE_BUFFER_CAPACITY_MIN &&
+                    buffer.reserved == 1 * MEGABYTES;
+    if (!isExpected) {
+      errorCode = RECEIVE_BUFFER_TEST_ERROR_INIT;
+      PrintReceiveBufferError(sb, errorCode, &buffer);
+    }
+  }
+
+  // b8 ReceiveBufferGrow(struct receive_buffer *buffer, u64 capacity)
+  {
+    u8 *value = buffer.value;
+    // fill whole capacity, growth must keep what is written
+    MemoryClear(buffer.value, buffer.capacity);
+    buffer.value[0] = 'a';
+    buffer.value[buffer.capacity - 1] = 'b';
+    buffer.length = buffer.capacity;
+
+    b8 isExpected = ReceiveBufferGrow(&buffer, buffer.length + 1) && buffer.value == value &&
+                    buffer.capacity == 2 * RECEIVE_BUFFER_CAPACITY_MIN;
+    // new pages are writable
+    buffer.value[buffer.capacity - 1] = 'c';
+    isExpected = isExpected && buffer.value[0] == 'a' && buffer.value[RECEIVE_BUFFER_CAPACITY_MIN - 1] == 'b';
+
+    // capacity that is known up front is given at once
+    isExpected = isExpected && ReceiveBufferGrow(&buffer, 300 * KILOBYTES) && buffer.capacity == 320 * KILOBYTES;
+    // smaller capacity changes nothing
+    isExpected = isExpected && ReceiveBufferGrow(&buffer, 10) && buffer.capacity == 320 * KILOBYTES;
+    // doubling stops at reservation
+    isExpected = isExpected && ReceiveBufferGrow(&buffer, 320 * KILOBYTES + 1) && buffer.capacity == 640 * KILOBYTES;
+    isExpected = isExpected && ReceiveBufferGrow(&buffer, 640 * KILOBYTES + 1) && buffer.capacity == 1 * MEGABYTES;
+    buffer.value[buffer.capacity - 1] = 'd';
+    // past reservation buffer stays as it was
+    isExpected = isExpected && !ReceiveBufferGrow(&buffer, 1 * MEGABYTES + 1) && buffer.capacity == 1 * MEGABYTES &&
+                 buffer.value == value;
+    if (!isExpected) {
+      errorCode = RECEIVE_BUFFER_TEST_ERROR_GROW;
+      PrintReceiveBufferError(sb, errorCode, &buffer);
+    }
+  }
+
+  // void ReceiveBufferConsume(struct receive_buffer *buffer, u64 length)
+  {
+    buffer.length = 0;
+    struct string first = StringFromLiteral("HTTP/1.1 200 OK\r\n\r\n");
+    struct string second = StringFromLiteral("HTTP/1.1 204 No Content\r\n");
+    b8 isExpected = ReceiveBufferAppend(&buffer, &first) && ReceiveBufferAppend(&buffer, &second);
+    ReceiveBufferConsume(&buffer, first.length);
+    struct string rest = StringFromBuffer(buffer.value, buffer.length);
+    isExpected = isExpected && IsStringEqual(&rest, &second);
+    if (!isExpected) {
+      errorCode = RECEIVE_BUFFER_TEST_ERROR_CONSUME;
+      PrintReceiveBufferError(sb, errorCode, &buffer);
+    }
+  }
+
+  // void ReceiveBufferTrim(struct receive_buffer *buffer)
+  {
+    struct string second = StringFromLiteral("HTTP/1.1 204 No Content\r\n");
+    ReceiveBufferTrim(&buffer);
+    struct string rest = StringFromBuffer(buffer.value, buffer.length);
+    b8 isExpected = buffer.capacity == RECEIVE_BUFFER_CAPACITY_MIN && IsStringEqual(&rest, &second);
+
+    // what is still in buffer is kept
+    buffer.length = 0;
+    isExpected = isExpected && ReceiveBufferGrow(&buffer, 200 * KILOBYTES);
+    buffer.length = 130 * KILOBYTES;
+    ReceiveBufferTrim(&buffer);
+    isExpected = isExpected && buffer.capacity == 192 * KILOBYTES;
+
+    // pages that are given back can be taken again, they are zero
+    isExpected = isExpected && ReceiveBufferGrow(&buffer, 1 * MEGABYTES) && buffer.value[buffer.capacity - 1] == 0;
+    if (!isExpected) {
+      errorCode = RECEIVE_BUFFER_TEST_ERROR_TRIM;
+      PrintReceiveBufferError(sb, errorCode, &buffer);
+    }
+  }
+
+  ReceiveBufferRelease(&buffer);
+  return (int)errorCode;
+}
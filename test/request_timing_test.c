@@ -0,0 +1,229 @@
+#include "request_timing.c"
+#include "print.h"
+#include "string_builder.h"
+
+#define TEST_ERROR_LIST(X)                                                                                             \
+  X(PHASE, "Phases must be differences between their marks")                                                           \
+  X(PHASE_SKIPPED, "Phase of step that is not marked must be 0, queue must take rest of total")                        \
+  X(LINE, "Phases must be appended in microseconds as one line")                                                       \
+  X(BUCKET, "Bucket must hold duration, and previous bucket must end before it")                                       \
+  X(PERCENTILE, "Percentile must be within quarter of exact one and never past max")
+
+enum request_timing_test_error {
+  REQUEST_TIMING_TEST_ERROR_NONE = 0,
+#define X(tag, message) REQUEST_TIMING_TEST_ERROR_##tag,
+  TEST_ERROR_LIST(X)
+#undef X
+
+  // src: https://mesonbuild.com/Unit-tests.html#skipped-tests-and-hard-errors
+  // For the default exitcode testing protocol, the GNU standard approach in
+  // this case is to exit the program with error code 77. Meson will detect this
+  // and report these tests as skipped rather than failed. This behavior was
+  // added in version 0.37.0.
+  MESON_TEST_SKIP = 77,
+  // In addition, sometimes a test fails set up so that it should fail even if
+  // it is marked as an expected failure. The GNU standard approach in this case
+  // is to exit the program with error code 99. Again, Meson will detect this
+  // and report these tests as ERROR, ignoring the setting of should_fail. This
+  // behavior was added in version 0.50.0.
+  MESON_TEST_FAILED_TO_SET_UP = 99,
+};
+
+internalfn void
+StringBuilderAppendTestError(struct string_builder *sb, enum request_timing_test_error errorCode)
+{
+  struct string message = StringFromLiteral("Unknown error");
+  struct error {
+    enum request_timing_test_error code;
+    struct string message;
+  } errors[] = {
+#define XX(tag, msg) {.code = REQUEST_TIMING_TEST_ERROR_##tag, .message = StringFromLiteral(msg)},
+      TEST_ERROR_LIST(XX)
+#undef XX
+  };
+
+  for (u32 errorIndex = 0; errorIndex < ARRAY_COUNT(errors); errorIndex++) {
+    struct error *error = errors + errorIndex;
+    if (error->code != errorCode)
+      continue;
+
+    message = error->message;
+    break;
+  }
+
+  StringBuilderAppendString(sb, &message);
+}
+
+internalfn void
+PrintTimingError(string_builder *sb, enum request_timing_test_error errorCode, struct request_timing *timing)
+{
+  StringBuilderAppendTestError(sb, errorCode);
+  StringBuilderAppendStringLiteral(sb, "\n  got: ");
+  StringBuilderAppendRequestTiming(sb, timing);
+  StringBuilderAppendStringLiteral(sb, "\n");
+  struct string errorMessage = StringBuilderFlush(sb);
+  PrintString(&errorMessage);
+}
+
+int
+main(void)
+{
+  enum request_timing_test_error errorCode = REQUEST_TIMING_TEST_ERROR_NONE;
+
+  // setup
+  enum {
+    KILOBYTES = (1 << 10),
+  };
+  u8 stackBuffer[64 * KILOBYTES];
+  memory_arena stackMemory = {
+      .block = stackBuffer,
+      .total = ARRAY_COUNT(stackBuffer),
+  };
+
+  string_builder *sb = MakeStringBuilder(&stackMemory, 4 * KILOBYTES, 32);
+
+  // request on new TLS connection, times are in microseconds from start
+  struct request_timing fresh = {};
+  {
+    u64 start = 1000000000;
+    u64 microseconds[REQUEST_TIMING_MARK_COUNT] = {
+        [REQUEST_TIMING_MARK_START] = 0,          [REQUEST_TIMING_MARK_RESOLVED] = 300,
+        [REQUEST_TIMING_MARK_CONNECTING] = 310,   [REQUEST_TIMING_MARK_CONNECTED] = 1310,
+        [REQUEST_TIMING_MARK_OPENED] = 3310,      [REQUEST_TIMING_MARK_SENT] = 3320,
+        [REQUEST_TIMING_MARK_FIRST_BYTE] = 53320, [REQUEST_TIMING_MARK_RECEIVED] = 54320,
+        [REQUEST_TIMING_MARK_PARSING] = 54330,    [REQUEST_TIMING_MARK_PARSED] = 54430,
+    };
+    for (enum request_timing_mark mark = 0; mark < REQUEST_TIMING_MARK_COUNT; mark++)
+      RequestTimingMark(&fresh, mark, start + microseconds[mark] * 1000);
+    // later reads do not move first byte
+    RequestTimingMark(&fresh, REQUEST_TIMING_MARK_FIRST_BYTE, start + 54000 * 1000);
+
+    u64 expected[REQUEST_TIMING_PHASE_COUNT] = {
+        [REQUEST_TIMING_PHASE_DNS] = 300,       [REQUEST_TIMING_PHASE_CONNECT] = 1000,
+        [REQUEST_TIMING_PHASE_TLS] = 2000,      [REQUEST_TIMING_PHASE_QUEUE] = 30,
+        [REQUEST_TIMING_PHASE_TTFB] = 50000,    [REQUEST_TIMING_PHASE_TRANSFER] = 1000,
+        [REQUEST_TIMING_PHASE_PARSE] = 100,     [REQUEST_TIMING_PHASE_TOTAL] = 54430,
+    };
+    b8 isExpected = 1;
+    for (enum request_timing_phase phase = 0; phase < REQUEST_TIMING_PHASE_COUNT; phase++)
+      isExpected = isExpected && RequestTimingPhase(&fresh, phase) == expected[phase] * 1000;
+    if (!isExpected) {
+      errorCode = REQUEST_TIMING_TEST_ERROR_PHASE;
+      PrintTimingError(sb, errorCode, &fresh);
+    }
+  }
+
+  // request on connection that was open before, name was known
+  struct request_timing reused = {};
+  {
+    u64 start = 2000000000;
+    RequestTimingMark(&reused, REQUEST_TIMING_MARK_START, start);
+    RequestTimingMark(&reused, REQUEST_TIMING_MARK_SENT, start + 5000);
+    RequestTimingMark(&reused, REQUEST_TIMING_MARK_FIRST_BYTE, start + 25000);
+    RequestTimingMark(&reused, REQUEST_TIMING_MARK_RECEIVED, start + 26000);
+    RequestTimingMark(&reused, REQUEST_TIMING_MARK_PARSING, start + 40000);
+    RequestTimingMark(&reused, REQUEST_TIMING_MARK_PARSED, start + 41000);
+
+    b8 isExpected = RequestTimingPhase(&reused, REQUEST_TIMING_PHASE_DNS) == 0 &&
+                    RequestTimingPhase(&reused, REQUEST_TIMING_PHASE_CONNECT) == 0 &&
+                    RequestTimingPhase(&reused, REQUEST_TIMING_PHASE_TLS) == 0 &&
+                    RequestTimingPhase(&reused, REQUEST_TIMING_PHASE_TTFB) == 20000 &&
+                    // before it is sent and while earlier videos are printed
+                    RequestTimingPhase(&reused, REQUEST_TIMING_PHASE_QUEUE) == 19000 &&
+                    RequestTimingPhase(&reused, REQUEST_TIMING_PHASE_TOTAL) == 41000;
+
+    // request that failed before response has no total
+    struct request_timing failed = {};
+    RequestTimingMark(&failed, REQUEST_TIMING_MARK_START, start);
+    RequestTimingMark(&failed, REQUEST_TIMING_MARK_SENT, start + 5000);
+    isExpected = isExpected && RequestTimingPhase(&failed, REQUEST_TIMING_PHASE_TTFB) == 0 &&
+                 RequestTimingPhase(&failed, REQUEST_TIMING_PHASE_TOTAL) == 0 &&
+                 RequestTimingPhase(&failed, REQUEST_TIMING_PHASE_QUEUE) == 0;
+    if (!isExpected) {
+      errorCode = REQUEST_TIMING_TEST_ERROR_PHASE_SKIPPED;
+      PrintTimingError(sb, errorCode, &reused);
+    }
+  }
+
+  // void StringBuilderAppendRequestTiming(string_builder *sb, struct request_timing *timing)
+  {
+    StringBuilderAppendRequestTiming(sb, &fresh);
+    struct string got = StringBuilderFlush(sb);
+    struct string expected = StringFromLiteral(
+        "dns=300 connect=1000 tls=2000 queue=30 ttfb=50000 transfer=1000 parse=100 total=54430");
+    if (!IsStringEqual(&got, &expected)) {
+      errorCode = REQUEST_TIMING_TEST_ERROR_LINE;
+      StringBuilderAppendTestError(sb, errorCode);
+      StringBuilderAppendStringLiteral(sb, "\n  expected: ");
+      StringBuilderAppendString(sb, &expected);
+      StringBuilderAppendStringLiteral(sb, "\n       got: ");
+      StringBuilderAppendString(sb, &got);
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string errorMessage = StringBuilderFlush(sb);
+      PrintString(&errorMessage);
+    }
+  }
+
+  // u32 RequestTimingHistogramBucket(u64 microseconds)
+  {
+    u64 values[] = {0, 1, 3, 4, 7, 8, 9, 10, 15, 16, 100, 999, 1000, 1023, 1024, 123456789, 1ULL << 39};
+    for (u32 valueIndex = 0; valueIndex < ARRAY_COUNT(values); valueIndex++) {
+      u64 value = values[valueIndex];
+      u32 bucket = RequestTimingHistogramBucket(value);
+      b8 isExpected = bucket < REQUEST_TIMING_HISTOGRAM_BUCKET_COUNT &&
+                      RequestTimingHistogramBucketEnd(bucket) >= value &&
+                      (bucket == 0 || RequestTimingHistogramBucketEnd(bucket - 1) < value);
+      if (!isExpected) {
+        errorCode = REQUEST_TIMING_TEST_ERROR_BUCKET;
+        StringBuilderAppendTestError(sb, errorCode);
+        StringBuilderAppendStringLiteral(sb, "\n  microseconds: ");
+        StringBuilderAppendU64(sb, value);
+        StringBuilderAppendStringLiteral(sb, " bucket: ");
+        StringBuilderAppendU32(sb, bucket);
+        StringBuilderAppendStringLiteral(sb, " end: ");
+        StringBuilderAppendU64(sb, RequestTimingHistogramBucketEnd(bucket));
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string errorMessage = StringBuilderFlush(sb);
+        PrintString(&errorMessage);
+        break;
+      }
+    }
+  }
+
+  // u64 RequestTimingHistogramPercentile(struct request_timing_histogram *histogram, enum request_timing_phase phase,
+  //                                      u32 percent)
+  {
+    struct request_timing_histogram histogram = {};
+    b8 isExpected = RequestTimingHistogramPercentile(&histogram, REQUEST_TIMING_PHASE_TTFB, 50) == 0;
+
+    // time to first byte of 1 ms to 100 ms
+    for (u64 milliseconds = 1; milliseconds <= 100; milliseconds++) {
+      struct request_timing timing = {};
+      RequestTimingMark(&timing, REQUEST_TIMING_MARK_START, 1000);
+      RequestTimingMark(&timing, REQUEST_TIMING_MARK_SENT, 1000);
+      RequestTimingMark(&timing, REQUEST_TIMING_MARK_FIRST_BYTE, 1000 + milliseconds * 1000000);
+      RequestTimingHistogramAdd(&histogram, &timing);
+    }
+
+    u32 percents[] = {50, 90, 99, 100};
+    u64 exacts[] = {50000, 90000, 99000, 100000};
+    for (u32 percentIndex = 0; percentIndex < ARRAY_COUNT(percents); percentIndex++) {
+      u64 got = RequestTimingHistogramPercentile(&histogram, REQUEST_TIMING_PHASE_TTFB, percents[percentIndex]);
+      isExpected = isExpected && got >= exacts[percentIndex] && got <= exacts[percentIndex] * 5 / 4 &&
+                   got <= histogram.max[REQUEST_TIMING_PHASE_TTFB];
+    }
+    isExpected = isExpected && histogram.requestCount == 100 && histogram.max[REQUEST_TIMING_PHASE_TTFB] == 100000 &&
+                 RequestTimingHistogramPercentile(&histogram, REQUEST_TIMING_PHASE_DNS, 99) == 0;
+    if (!isExpected) {
+      errorCode = REQUEST_TIMING_TEST_ERROR_PERCENTILE;
+      StringBuilderAppendTestError(sb, errorCode);
+      StringBuilderAppendStringLiteral(sb, "\n");
+      struct string prefix = StringFromLiteral("  ");
+      StringBuilderAppendRequestTimingHistogram(sb, &histogram, &prefix);
+      struct string errorMessage = StringBuilderFlush(sb);
+      PrintString(&errorMessage);
+    }
+  }
+
+  return (int)errorCode;
+}
@@ -0,0 +1,206 @@
+#include "ring_buffer.c"
+#include "http_parser.c"
+#include "json_parser.c"
+#include "print.h"
+#include "string_builder.h"
+
+#define TEST_ERROR_LIST(X)                                                                                             \
+  X(INIT, "Ring must be mapped with capacity rounded up")                                                              \
+  X(MIRROR, "Both halves of ring must be same memory")                                                                 \
+  X(WRAP, "Bytes that wrap around end of ring must be contiguous")                                                     \
+  X(PARSE, "Response that wraps around end of ring must be parsed in place")
+
+enum ring_buffer_test_error {
+  RING_BUFFER_TEST_ERROR_NONE = 0,
+#define X(tag, message) RING_BUFFER_TEST_ERROR_##tag,
+  TEST_ERROR_LIST(X)
+#undef X
+
+  // src: https://mesonbuild.com/Unit-tests.html#skipped-tests-and-hard-errors
+  // For the default exitcode testing protocol, the GNU standard approach in
+  // this case is to exit the program with error code 77. Meson will detect this
+  // and report these tests as skipped rather than failed. This behavior was
+  // added in version 0.37.0.
+  MESON_TEST_SKIP = 77,
+  // In addition, sometimes a test fails set up so that it should fail even if
+  // it is marked as an expected failure. The GNU standard approach in this case
+  // is to exit the program with error code 99. Again, Meson will detect this
+  // and report these tests as ERROR, ignoring the setting of should_fail. This
+  // behavior was added in version 0.50.0.
+  MESON_TEST_FAILED_TO_SET_UP = 99,
+};
+
+internalfn void
+StringBuilderAppendTestError(struct string_builder *sb, enum ring_buffer_test_error errorCode)
+{
+  struct string message = StringFromLiteral("Unknown error");
+  struct error {
+    enum ring_buffer_test_error code;
+    struct string message;
+  } errors[] = {
+#define XX(tag, msg) {.code = RING_BUFFER_TEST_ERROR_##tag, .message = StringFromLiteral(msg)},
+      TEST_ERROR_LIST(XX)
+#undef XX
+  };
+
+  for (u32 errorIndex = 0; errorIndex < ARRAY_COUNT(errors); errorIndex++) {
+    struct error *error = errors + errorIndex;
+    if (error->code != errorCode)
+      continue;
+
+    message = error->message;
+    break;
+  }
+
+  StringBuilderAppendString(sb, &message);
+}
+
+internalfn void
+PrintRingBufferError(string_builder *sb, enum ring_buffer_test_error errorCode, struct ring_buffer *ring)
+{
+  StringBuilderAppendTestError(sb, errorCode);
+  StringBuilderAppendStringLiteral(sb, "\n  start: ");
+  StringBuilderAppendU64(sb, ring->start);
+  StringBuilderAppendStringLiteral(sb, " length: ");
+  StringBuilderAppendU64(sb, ring->length);
+  StringBuilderAppendStringLiteral(sb, " capacity: ");
+  StringBuilderAppendU64(sb, ring->capacity);
+  StringBuilderAppendStringLiteral(sb, "\n");
+  struct string errorMessage = StringBuilderFlush(sb);
+  PrintString(&errorMessage);
+}
+
+/*
+ * Writes data in pieces, as socket does.
+ * @return false when ring is full
+ */
+internalfn b8
+RingBufferWrite(struct ring_buffer *ring, struct string *data)
+{
+  struct string space = RingBufferSpace(ring);
+  if (space.length < data->length)
+    return 0;
+  MemoryCopy(space.value, data->value, data->length);
+  ring->length += data->length;
+  return 1;
+}
+
+int
+main(void)
+{
+  enum ring_buffer_test_error errorCode = RING_BUFFER_TEST_ERROR_NONE;
+
+  // setup
+  enum {
+    KILOBYTES = (1 << 10),
+  };
+  u8 stackBuffer[64 * KILOBYTES];
+  memory_arena stackMemory = {
+      .block = stackBuffer,
+      .total = ARRAY_COUNT(stackBuffer),
+  };
+
+  string_builder *sb = MakeStringBuilder(&stackMemory, 4 * KILOBYTES, 32);
+
+  struct ring_buffer ring;
+  if (!RingBufferInit(&ring, 60 * KILOBYTES))
+    return MESON_TEST_FAILED_TO_SET_UP;
+
+  // b8 RingBufferInit(struct ring_buffer *ring, u64 capacity)
+  {
+    struct string space = RingBufferSpace(&ring);
+    b8 isExpected = ring.value && ring.capacity == 64 * KILOBYTES && ring.start == 0 && ring.length == 0 &&
+                    space.value == ring.value && space.length == 64 * KILOBYTES;
+    if (!isExpected) {
+      errorCode = RING_BUFFER_TEST_ERROR_INIT;
+      PrintRingBufferError(sb, errorCode, &ring);
+    }
+  }
+
+  // u8 *PlatformMemoryMapRing(u64 size)
+  {
+    // both halves are same memory under different addresses, compiler must not keep what is written
+    volatile u8 *value = ring.value;
+    value[0] = 'a';
+    value[ring.capacity + 1] = 'b';
+    b8 isExpected = value[ring.capacity] == 'a' && value[1] == 'b';
+    if (!isExpected) {
+      errorCode = RING_BUFFER_TEST_ERROR_MIRROR;
+      PrintRingBufferError(sb, errorCode, &ring);
+    }
+  }
+
+  // void RingBufferConsume(struct ring_buffer *ring, u64 length)
+  {
+    // bytes of pattern tell their own position
+    u8 pattern[40 * KILOBYTES];
+    for (u32 index = 0; index < ARRAY_COUNT(pattern); index++)
+      pattern[index] = (u8)(index % 251);
+    struct string first = StringFromBuffer(pattern, 40 * KILOBYTES);
+    struct string second = StringFromBuffer(pattern + 10 * KILOBYTES, 30 * KILOBYTES);
+
+    b8 isExpected = RingBufferWrite(&ring, &first);
+    RingBufferConsume(&ring, 30 * KILOBYTES);
+    // second write ends past end of ring
+    isExpected = isExpected && RingBufferWrite(&ring, &second) && ring.start == 30 * KILOBYTES &&
+                 ring.length == 40 * KILOBYTES && RingBufferSpace(&ring).length == 24 * KILOBYTES;
+
+    struct string data = RingBufferData(&ring);
+    struct string expected[] = {
+        StringFromBuffer(pattern + 30 * KILOBYTES, 10 * KILOBYTES),
+        second,
+    };
+    struct string got[] = {
+        StringFromBuffer(data.value, 10 * KILOBYTES),
+        StringFromBuffer(data.value + 10 * KILOBYTES, 30 * KILOBYTES),
+    };
+    isExpected = isExpected && IsStringEqual(got + 0, expected + 0) && IsStringEqual(got + 1, expected + 1);
+
+    // start goes around too
+    RingBufferConsume(&ring, 40 * KILOBYTES);
+    isExpected = isExpected && ring.start == 6 * KILOBYTES && ring.length == 0;
+    if (!isExpected) {
+      errorCode = RING_BUFFER_TEST_ERROR_WRAP;
+      PrintRingBufferError(sb, errorCode, &ring);
+    }
+  }
+
+  // HttpParse() and JsonParse() on strings that wrap
+  {
+    // response starts 16 bytes before end of ring
+    ring.start = ring.capacity - 16;
+    ring.length = 0;
+
+    struct string response = StringFromLiteral("HTTP/1.1 200 OK\r\n"
+                                               "Content-Length: 31\r\n"
+                                               "\r\n"
+                                               "{\"type\":\"video\",\"title\":\"Ring\"}");
+    struct string json = StringFromLiteral("{\"type\":\"video\",\"title\":\"Ring\"}");
+    b8 isExpected = RingBufferWrite(&ring, &response);
+
+    memory_temp tempMemory = MemoryTempBegin(&stackMemory);
+    struct http_parser *httpParser = MakeHttpParser(tempMemory.arena, 16);
+    struct string data = RingBufferData(&ring);
+    isExpected = isExpected && HttpParse(httpParser, &data) && httpParser->statusCode == 200;
+
+    struct string content = StringNull();
+    if (isExpected) {
+      struct http_token *lastHttpToken = httpParser->tokens + httpParser->tokenCount - 1;
+      content = HttpTokenExtractString(lastHttpToken, &data);
+    }
+    struct json_parser *jsonParser = MakeJsonParser(tempMemory.arena, 16);
+    isExpected = isExpected && IsStringEqual(&content, &json) && JsonParse(jsonParser, &content) &&
+                 jsonParser->tokenCount == 5;
+
+    RingBufferConsume(&ring, httpParser->position);
+    isExpected = isExpected && ring.length == 0 && ring.start == response.length - 16;
+    MemoryTempEnd(&tempMemory);
+    if (!isExpected) {
+      errorCode = RING_BUFFER_TEST_ERROR_PARSE;
+      PrintRingBufferError(sb, errorCode, &ring);
+    }
+  }
+
+  RingBufferRelease(&ring);
+  return (int)errorCode;
+}
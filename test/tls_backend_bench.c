@@ -0,0 +1,542 @@
+#include <malloc.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "bench.h"
+#include "platform.h"
+#include "platform_transport.h"
+#include "string_builder.h"
+#include "tls_connection.c"
+#include "tls_localhost.h"
+
+/*
+ * Compares TLS libraries, see src/tls_backend.h, against a local TLS
+ * stand-in server that uses same library.
+ *
+ * Server is forked, for every line client sends it answers with 16 MiB. Client
+ * opens 16 connections at once, then does full handshakes one after another,
+ * then downloads over one connection.
+ *
+ * Reported metrics:
+ *   handshake      p50_microseconds, p99_microseconds
+ *                  from connect until handshake is done
+ *   download       mebibytes_per_second
+ *   memory         config_bytes       heap that client config holds
+ *                  connection_bytes   heap that one open connection holds
+ *   binary         bytes              size of this program, library is linked
+ *                                     statically
+ *
+ * Only one library is built in, so metrics have same names for both and one
+ * is compared to other with --baseline, see bench.h:
+ *
+ * @code
+ *   ./build.sh --with-mbedtls
+ *   build/test/tls_backend_bench > mbedtls.txt
+ *   ./build.sh --with-wolfssl
+ *   build/test/tls_backend_bench --baseline=mbedtls.txt
+ * @endcode
+ */
+
+enum {
+  KILOBYTES = (1 << 10),
+  MEGABYTES = (1 << 20),
+  HANDSHAKE_COUNT = 256,
+  DOWNLOAD_LENGTH = 16 * MEGABYTES,
+  DOWNLOAD_COUNT = 4,
+  CLIENT_CONNECTION_MAX = 16,
+  // connections of previous run may still be closing
+  SERVER_CONNECTION_MAX = 2 * CLIENT_CONNECTION_MAX,
+  // TLS records are at most 16 KiB
+  TRANSPORT_BUFFER_LENGTH = 17 * KILOBYTES,
+};
+
+////////////////////////////////////////////////////////////////
+// SERVER
+////////////////////////////////////////////////////////////////
+
+struct server_connection {
+  struct tls_connection tls;
+  u32 pendingDownloadCount;
+  u64 downloadBytesWritten;
+  struct server_connection *nextFree;
+};
+
+internalfn void
+ServerConnectionFree(struct server_connection **freeList, struct server_connection *connection)
+{
+  TlsConnectionClose(&connection->tls);
+  connection->nextFree = *freeList;
+  *freeList = connection;
+}
+
+/*
+ * @param chunk repeated until download is written
+ * @return false when connection is done
+ */
+internalfn b8
+ServerConnectionAdvance(struct server_connection *connection, struct string *chunk)
+{
+  struct tls_connection *tls = &connection->tls;
+  if (tls->state == TLS_CONNECTION_STATE_HANDSHAKING)
+    TlsConnectionHandshake(tls);
+  if (tls->state == TLS_CONNECTION_STATE_FAILED)
+    return 0;
+  if (tls->state != TLS_CONNECTION_STATE_OPEN)
+    return 1;
+
+  // every line asks for a download
+  u8 buffer[256];
+  while (1) {
+    s64 bytesRead = TlsConnectionRead(tls, buffer, sizeof(buffer));
+    if (bytesRead == TLS_CONNECTION_WOULD_BLOCK)
+      break;
+    if (bytesRead <= 0)
+      return 0;
+    for (u64 index = 0; index < (u64)bytesRead; index++) {
+      if (buffer[index] == '\n')
+        connection->pendingDownloadCount++;
+    }
+  }
+
+  while (connection->pendingDownloadCount != 0) {
+    u64 remainingLength = DOWNLOAD_LENGTH - connection->downloadBytesWritten;
+    struct string remaining = StringFromBuffer(chunk->value, remainingLength < chunk->length ? remainingLength
+                                                                                              : chunk->length);
+    s64 bytesWritten = TlsConnectionWrite(tls, &remaining);
+    if (bytesWritten == TLS_CONNECTION_WOULD_BLOCK)
+      break;
+    if (bytesWritten < 0)
+      return 0;
+
+    connection->downloadBytesWritten += (u64)bytesWritten;
+    if (connection->downloadBytesWritten == DOWNLOAD_LENGTH) {
+      connection->downloadBytesWritten = 0;
+      connection->pendingDownloadCount--;
+    }
+  }
+
+  return tls->state != TLS_CONNECTION_STATE_FAILED;
+}
+
+/*
+ * Serves until it is killed.
+ */
+internalfn void
+Serve(s32 listener)
+{
+  struct tls_backend_config tlsConfig;
+  if (!TlsLocalhostSetup(&tlsConfig, 1)) {
+    PrintString(&StringFromLiteral("Server TLS setup failed.\n"));
+    return;
+  }
+
+  struct platform_transport transport;
+  struct platform_transport_options options = {
+      .receiveBufferCount = 2 * SERVER_CONNECTION_MAX,
+      .receiveBufferLength = TRANSPORT_BUFFER_LENGTH,
+      .sendBufferCount = 2 * SERVER_CONNECTION_MAX,
+      .sendBufferLength = TRANSPORT_BUFFER_LENGTH,
+  };
+  // listener is only one without data
+  struct platform_socket listenerSocket = {.data = 0};
+  if (!PlatformTransportOpen(&transport, &options) || !PlatformTransportAttach(&transport, &listenerSocket, listener)) {
+    PrintString(&StringFromLiteral("Server transport setup failed.\n"));
+    return;
+  }
+  PlatformTransportAccept(&transport, &listenerSocket);
+
+  // one record worth
+  struct string chunk = {
+      .value = PlatformAllocate(16 * KILOBYTES),
+      .length = 16 * KILOBYTES,
+  };
+  struct server_connection *connections = PlatformAllocate(sizeof(*connections) * SERVER_CONNECTION_MAX);
+  struct server_connection *freeList = 0;
+  if (!chunk.value || !connections)
+    return;
+  for (u64 index = 0; index < chunk.length; index++)
+    chunk.value[index] = (u8)('a' + index % 26);
+  for (u32 connectionIndex = SERVER_CONNECTION_MAX; connectionIndex-- > 0;) {
+    struct server_connection *connection = connections + connectionIndex;
+    if (!TlsConnectionInit(&connection->tls, &tlsConfig, &transport, connection))
+      return;
+    connection->nextFree = freeList;
+    freeList = connection;
+  }
+
+  struct platform_completion completions[64];
+  while (1) {
+    u32 completionCount = PlatformTransportWait(&transport, completions, ARRAY_COUNT(completions), -1);
+    for (u32 completionIndex = 0; completionIndex < completionCount; completionIndex++) {
+      struct platform_completion *completion = completions + completionIndex;
+      struct server_connection *connection = completion->data;
+
+      // listener
+      if (!connection) {
+        if (!completion->isMore)
+          PlatformTransportAccept(&transport, &listenerSocket);
+        s32 socket = completion->result;
+        if (socket < 0)
+          continue;
+        if (!freeList) {
+          PlatformSocketClose(socket);
+          continue;
+        }
+
+        connection = freeList;
+        freeList = connection->nextFree;
+        connection->pendingDownloadCount = 0;
+        connection->downloadBytesWritten = 0;
+        TlsConnectionAccept(&connection->tls, socket);
+        if (connection->tls.state == TLS_CONNECTION_STATE_FAILED)
+          ServerConnectionFree(&freeList, connection);
+        continue;
+      }
+
+      TlsConnectionComplete(&connection->tls, completion);
+      if (!ServerConnectionAdvance(connection, &chunk))
+        ServerConnectionFree(&freeList, connection);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////
+// CLIENT
+////////////////////////////////////////////////////////////////
+
+struct client {
+  struct platform_transport transport;
+  struct tls_connection connections[CLIENT_CONNECTION_MAX];
+  struct platform_address address;
+};
+
+/*
+ * Gives completions to their connections.
+ */
+internalfn void
+ClientWait(struct client *client)
+{
+  struct platform_completion completions[64];
+  u32 completionCount = PlatformTransportWait(&client->transport, completions, ARRAY_COUNT(completions), -1);
+  for (u32 completionIndex = 0; completionIndex < completionCount; completionIndex++) {
+    struct platform_completion *completion = completions + completionIndex;
+    TlsConnectionComplete(completion->data, completion);
+  }
+}
+
+/*
+ * Submits closes of connections.
+ */
+internalfn void
+ClientClose(struct client *client, u32 connectionCount)
+{
+  for (u32 connectionIndex = 0; connectionIndex < connectionCount; connectionIndex++)
+    TlsConnectionClose(client->connections + connectionIndex);
+  struct platform_completion completions[64];
+  PlatformTransportWait(&client->transport, completions, ARRAY_COUNT(completions), 0);
+}
+
+/*
+ * Connects every connection at once, waits until all of them are open.
+ * @return false on error
+ */
+internalfn b8
+ClientOpen(struct client *client, u32 connectionCount)
+{
+  struct string *hostname = &StringFromLiteral("localhost");
+  for (u32 connectionIndex = 0; connectionIndex < connectionCount; connectionIndex++)
+    TlsConnectionConnect(client->connections + connectionIndex, &client->address, hostname);
+
+  while (1) {
+    u32 openCount = 0;
+    for (u32 connectionIndex = 0; connectionIndex < connectionCount; connectionIndex++) {
+      struct tls_connection *tls = client->connections + connectionIndex;
+      TlsConnectionHandshake(tls);
+      if (tls->state == TLS_CONNECTION_STATE_FAILED)
+        return 0;
+      if (tls->state == TLS_CONNECTION_STATE_OPEN)
+        openCount++;
+    }
+    if (openCount == connectionCount)
+      return 1;
+    ClientWait(client);
+  }
+}
+
+/*
+ * Asks for one download and reads it.
+ * @return nanoseconds download took, 0 on error
+ */
+internalfn u64
+ClientDownload(struct client *client, struct tls_connection *tls)
+{
+  u64 startedAt = NowInNanoseconds();
+  struct string request = StringFromLiteral("\n");
+  while (1) {
+    s64 bytesWritten = TlsConnectionWrite(tls, &request);
+    if (bytesWritten == 1)
+      break;
+    if (bytesWritten != TLS_CONNECTION_WOULD_BLOCK)
+      return 0;
+    ClientWait(client);
+  }
+
+  u8 buffer[16 * KILOBYTES];
+  u64 totalBytesRead = 0;
+  while (totalBytesRead < DOWNLOAD_LENGTH) {
+    s64 bytesRead = TlsConnectionRead(tls, buffer, sizeof(buffer));
+    if (bytesRead == TLS_CONNECTION_WOULD_BLOCK)
+      ClientWait(client);
+    else if (bytesRead <= 0)
+      return 0;
+    else
+      totalBytesRead += (u64)bytesRead;
+  }
+
+  u64 elapsed = NowInNanoseconds() - startedAt;
+  return elapsed == 0 ? 1 : elapsed;
+}
+
+/*
+ * @return bytes that C library handed out and are not freed
+ */
+internalfn u64
+HeapInUse(void)
+{
+  struct mallinfo2 info = mallinfo2();
+  // large blocks are mapped on their own
+  return info.uordblks + info.hblkhd;
+}
+
+internalfn void
+SortU64(u64 *values, u32 count)
+{
+  for (u32 index = 1; index < count; index++) {
+    u64 value = values[index];
+    u32 insertIndex = index;
+    while (insertIndex > 0 && values[insertIndex - 1] > value) {
+      values[insertIndex] = values[insertIndex - 1];
+      insertIndex--;
+    }
+    values[insertIndex] = value;
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  // setup
+  u8 stackBuffer[64 * KILOBYTES];
+  memory_arena stackMemory = {
+      .block = stackBuffer,
+      .total = ARRAY_COUNT(stackBuffer),
+  };
+
+  string_builder *sb = MakeStringBuilder(&stackMemory, 1024, 32);
+
+  memory_arena heapMemory = {
+      .total = 2 * MEGABYTES,
+  };
+  heapMemory.block = PlatformAllocate(heapMemory.total);
+  if (!heapMemory.block) {
+    StringBuilderAppendStringLiteral(sb, "Could not allocate ");
+    StringBuilderAppendU64(sb, heapMemory.total / MEGABYTES);
+    StringBuilderAppendStringLiteral(sb, "MiB memory");
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return 1;
+  }
+
+  struct bench bench = {.sb = sb, .baseline = StringNull()};
+  for (u32 argumentIndex = 1; argumentIndex < argc; argumentIndex++) {
+    struct string argument = StringFromZeroTerminated((u8 *)argv[argumentIndex], 1024);
+    struct string *baselineOption = &StringFromLiteral("--baseline=");
+    if (IsStringStartsWith(&argument, baselineOption)) {
+      struct string path = StringSlice(&argument, baselineOption->length, argument.length);
+      struct string *buffer = MakeString(&heapMemory, 1 * MEGABYTES);
+      if (PlatformReadFile(buffer, &path, &bench.baseline) != IO_ERROR_NONE) {
+        StringBuilderAppendStringLiteral(sb, "Could not read baseline.");
+        StringBuilderAppendStringLiteral(sb, "\n  path: ");
+        StringBuilderAppendString(sb, &path);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string message = StringBuilderFlush(sb);
+        PrintString(&message);
+        return 1;
+      }
+    }
+  }
+
+  struct client *client = PlatformAllocate(sizeof(*client));
+  if (!client ||
+      !PlatformAddressResolve(&StringFromLiteral("127.0.0.1"), &StringFromLiteral("0"), &client->address)) {
+    PrintString(&StringFromLiteral("Could not resolve loopback address.\n"));
+    return 1;
+  }
+
+  s32 listener = PlatformSocketListen(&client->address);
+  if (listener == -1) {
+    StringBuilderAppendStringLiteral(sb, "Could not listen.\n  error: ");
+    StringBuilderAppendPlatformError(sb);
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return 1;
+  }
+
+  pid_t serverPid = fork();
+  if (serverPid == -1) {
+    PrintString(&StringFromLiteral("Could not start server.\n"));
+    return 1;
+  }
+  if (serverPid == 0) {
+    Serve(listener);
+    _exit(1);
+  }
+  PlatformSocketClose(listener);
+
+  if (IS_TLS_BACKEND_WOLFSSL)
+    PrintString(&StringFromLiteral("TLS library: wolfSSL\n"));
+  else
+    PrintString(&StringFromLiteral("TLS library: Mbed TLS\n"));
+
+  int exitCode = 0;
+  struct platform_transport_options options = {
+      .receiveBufferCount = 4 * CLIENT_CONNECTION_MAX,
+      .receiveBufferLength = TRANSPORT_BUFFER_LENGTH,
+      .sendBufferCount = 2 * CLIENT_CONNECTION_MAX,
+      .sendBufferLength = TRANSPORT_BUFFER_LENGTH,
+  };
+  if (!PlatformTransportOpen(&client->transport, &options)) {
+    PrintString(&StringFromLiteral("Client transport setup failed.\n"));
+    exitCode = 1;
+    goto stop;
+  }
+
+  // memory, transport buffers are not taken from heap
+  struct tls_backend_config tlsConfig;
+  u64 heapBefore = HeapInUse();
+  if (!TlsLocalhostSetup(&tlsConfig, 0)) {
+    PrintString(&StringFromLiteral("Client setup failed.\n"));
+    exitCode = 1;
+    goto stop;
+  }
+  u64 configBytes = HeapInUse() - heapBefore;
+
+  heapBefore = HeapInUse();
+  for (u32 connectionIndex = 0; connectionIndex < CLIENT_CONNECTION_MAX; connectionIndex++) {
+    struct tls_connection *tls = client->connections + connectionIndex;
+    if (!TlsConnectionInit(tls, &tlsConfig, &client->transport, tls)) {
+      PrintString(&StringFromLiteral("Client setup failed.\n"));
+      exitCode = 1;
+      goto stop;
+    }
+  }
+  if (!ClientOpen(client, CLIENT_CONNECTION_MAX)) {
+    PrintString(&StringFromLiteral("Handshake failed.\n"));
+    exitCode = 1;
+    goto stop;
+  }
+  u64 connectionBytes = (HeapInUse() - heapBefore) / CLIENT_CONNECTION_MAX;
+  ClientClose(client, CLIENT_CONNECTION_MAX);
+
+  StringBuilderAppendStringLiteral(sb, "memory: config ");
+  StringBuilderAppendU64(sb, configBytes);
+  StringBuilderAppendStringLiteral(sb, " bytes, open connection ");
+  StringBuilderAppendU64(sb, connectionBytes);
+  StringBuilderAppendStringLiteral(sb, " bytes\n");
+  struct string message = StringBuilderFlush(sb);
+  PrintString(&message);
+
+  BenchReport(&bench, &StringFromLiteral("memory"), &StringFromLiteral("config_bytes"), configBytes);
+  BenchReport(&bench, &StringFromLiteral("memory"), &StringFromLiteral("connection_bytes"), connectionBytes);
+
+  // handshake
+  u64 *latencies = MemoryArenaPush(&heapMemory, sizeof(*latencies) * HANDSHAKE_COUNT);
+  for (u32 handshakeIndex = 0; handshakeIndex < HANDSHAKE_COUNT; handshakeIndex++) {
+    u64 startedAt = NowInNanoseconds();
+    if (!ClientOpen(client, 1)) {
+      StringBuilderAppendStringLiteral(sb, "Handshake failed.\n  error: ");
+      StringBuilderAppendS32(sb, client->connections[0].error);
+      StringBuilderAppendStringLiteral(sb, "\n");
+      message = StringBuilderFlush(sb);
+      PrintString(&message);
+      exitCode = 1;
+      goto stop;
+    }
+    latencies[handshakeIndex] = NowInNanoseconds() - startedAt;
+    ClientClose(client, 1);
+  }
+
+  SortU64(latencies, HANDSHAKE_COUNT);
+  u64 p50 = latencies[HANDSHAKE_COUNT * 50 / 100] / 1000;
+  u64 p99 = latencies[HANDSHAKE_COUNT * 99 / 100] / 1000;
+
+  StringBuilderAppendStringLiteral(sb, "handshake: ");
+  StringBuilderAppendU64(sb, HANDSHAKE_COUNT);
+  StringBuilderAppendStringLiteral(sb, " handshakes, p50 ");
+  StringBuilderAppendU64(sb, p50);
+  StringBuilderAppendStringLiteral(sb, " us, p99 ");
+  StringBuilderAppendU64(sb, p99);
+  StringBuilderAppendStringLiteral(sb, " us\n");
+  message = StringBuilderFlush(sb);
+  PrintString(&message);
+
+  BenchReport(&bench, &StringFromLiteral("handshake"), &StringFromLiteral("p50_microseconds"), p50);
+  BenchReport(&bench, &StringFromLiteral("handshake"), &StringFromLiteral("p99_microseconds"), p99);
+
+  // download
+  if (!ClientOpen(client, 1)) {
+    PrintString(&StringFromLiteral("Handshake failed.\n"));
+    exitCode = 1;
+    goto stop;
+  }
+  u64 downloadElapsed = 0;
+  for (u32 downloadIndex = 0; downloadIndex < DOWNLOAD_COUNT; downloadIndex++) {
+    u64 elapsed = ClientDownload(client, client->connections + 0);
+    if (elapsed == 0) {
+      StringBuilderAppendStringLiteral(sb, "Download failed.\n  error: ");
+      StringBuilderAppendS32(sb, client->connections[0].error);
+      StringBuilderAppendStringLiteral(sb, "\n");
+      message = StringBuilderFlush(sb);
+      PrintString(&message);
+      exitCode = 1;
+      goto stop;
+    }
+    downloadElapsed += elapsed;
+  }
+  ClientClose(client, 1);
+
+  u64 mebibytesPerSecond = (u64)DOWNLOAD_COUNT * (DOWNLOAD_LENGTH / MEGABYTES) * 1000000000 / downloadElapsed;
+  StringBuilderAppendStringLiteral(sb, "download: ");
+  StringBuilderAppendU64(sb, (u64)DOWNLOAD_COUNT * (DOWNLOAD_LENGTH / MEGABYTES));
+  StringBuilderAppendStringLiteral(sb, " MiB, ");
+  StringBuilderAppendU64(sb, mebibytesPerSecond);
+  StringBuilderAppendStringLiteral(sb, " MiB/s\n");
+  message = StringBuilderFlush(sb);
+  PrintString(&message);
+
+  BenchReport(&bench, &StringFromLiteral("download"), &StringFromLiteral("mebibytes_per_second"), mebibytesPerSecond);
+
+  // binary
+  struct stat binaryStat;
+  if (stat("/proc/self/exe", &binaryStat) == 0) {
+    StringBuilderAppendStringLiteral(sb, "binary: ");
+    StringBuilderAppendU64(sb, (u64)binaryStat.st_size);
+    StringBuilderAppendStringLiteral(sb, " bytes\n");
+    message = StringBuilderFlush(sb);
+    PrintString(&message);
+
+    BenchReport(&bench, &StringFromLiteral("binary"), &StringFromLiteral("bytes"), (u64)binaryStat.st_size);
+  }
+
+  for (u32 connectionIndex = 0; connectionIndex < CLIENT_CONNECTION_MAX; connectionIndex++)
+    TlsConnectionRelease(client->connections + connectionIndex);
+  PlatformTransportClose(&client->transport);
+
+stop:
+  kill(serverPid, SIGTERM);
+  waitpid(serverPid, 0, 0);
+  return exitCode;
+}
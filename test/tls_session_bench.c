@@ -0,0 +1,406 @@
+#include <signal.h>
+#include <sys/wait.h>
+
+#include "bench.h"
+#include "platform.h"
+#include "platform_transport.h"
+#include "string_builder.h"
+#include "tls_connection.c"
+#include "tls_localhost.h"
+#include "tls_session_cache.c"
+
+/*
+ * Measures TLS 1.3 handshake latency with full handshake and with session
+ * resumed from a ticket, against a local TLS stand-in server.
+ *
+ * Server is forked, it hands out session tickets after every handshake.
+ * Client does one handshake at a time. Full handshakes wait for ticket and
+ * store session, which goes through file format of session cache as it does
+ * between runs, then every resumed handshake offers it.
+ *
+ * Reported metrics, for full and resumed handshakes:
+ *   p50_microseconds, p99_microseconds  from connect until handshake is done
+ *   received_bytes                      during handshake, resumed one has no
+ *                                       certificate
+ *
+ * See bench.h for machine readable output and --baseline.
+ */
+
+enum {
+  KILOBYTES = (1 << 10),
+  MEGABYTES = (1 << 20),
+  HANDSHAKE_COUNT = 512,
+  // TLS records are at most 16 KiB
+  TRANSPORT_BUFFER_LENGTH = 17 * KILOBYTES,
+  SERVER_CONNECTION_MAX = 16,
+};
+
+////////////////////////////////////////////////////////////////
+// SERVER
+////////////////////////////////////////////////////////////////
+
+struct server_connection {
+  struct tls_connection tls;
+  struct server_connection *nextFree;
+};
+
+internalfn void
+ServerConnectionFree(struct server_connection **freeList, struct server_connection *connection)
+{
+  TlsConnectionClose(&connection->tls);
+  connection->nextFree = *freeList;
+  *freeList = connection;
+}
+
+/*
+ * Does handshake, which sends ticket at its end, then waits for client to
+ * close connection.
+ * @return false when connection is done
+ */
+internalfn b8
+ServerConnectionAdvance(struct server_connection *connection)
+{
+  struct tls_connection *tls = &connection->tls;
+  if (tls->state == TLS_CONNECTION_STATE_HANDSHAKING)
+    TlsConnectionHandshake(tls);
+  if (tls->state == TLS_CONNECTION_STATE_FAILED)
+    return 0;
+  if (tls->state != TLS_CONNECTION_STATE_OPEN)
+    return 1;
+
+  u8 buffer[256];
+  while (1) {
+    s64 bytesRead = TlsConnectionRead(tls, buffer, sizeof(buffer));
+    if (bytesRead == TLS_CONNECTION_WOULD_BLOCK)
+      return 1;
+    if (bytesRead <= 0)
+      return 0;
+  }
+}
+
+/*
+ * Serves until it is killed.
+ */
+internalfn void
+Serve(s32 listener)
+{
+  struct tls_backend_config tlsConfig;
+  if (!TlsLocalhostSetup(&tlsConfig, 1)) {
+    PrintString(&StringFromLiteral("Server TLS setup failed.\n"));
+    return;
+  }
+
+  struct platform_transport transport;
+  struct platform_transport_options options = {
+      .receiveBufferCount = 2 * SERVER_CONNECTION_MAX,
+      .receiveBufferLength = TRANSPORT_BUFFER_LENGTH,
+      .sendBufferCount = 2 * SERVER_CONNECTION_MAX,
+      .sendBufferLength = TRANSPORT_BUFFER_LENGTH,
+  };
+  // listener is only one without data
+  struct platform_socket listenerSocket = {.data = 0};
+  if (!PlatformTransportOpen(&transport, &options) || !PlatformTransportAttach(&transport, &listenerSocket, listener)) {
+    PrintString(&StringFromLiteral("Server transport setup failed.\n"));
+    return;
+  }
+  PlatformTransportAccept(&transport, &listenerSocket);
+
+  struct server_connection *connections = PlatformAllocate(sizeof(*connections) * SERVER_CONNECTION_MAX);
+  struct server_connection *freeList = 0;
+  if (!connections)
+    return;
+  for (u32 connectionIndex = SERVER_CONNECTION_MAX; connectionIndex-- > 0;) {
+    struct server_connection *connection = connections + connectionIndex;
+    if (!TlsConnectionInit(&connection->tls, &tlsConfig, &transport, connection))
+      return;
+    connection->nextFree = freeList;
+    freeList = connection;
+  }
+
+  struct platform_completion completions[64];
+  while (1) {
+    u32 completionCount = PlatformTransportWait(&transport, completions, ARRAY_COUNT(completions), -1);
+    for (u32 completionIndex = 0; completionIndex < completionCount; completionIndex++) {
+      struct platform_completion *completion = completions + completionIndex;
+      struct server_connection *connection = completion->data;
+
+      // listener
+      if (!connection) {
+        if (!completion->isMore)
+          PlatformTransportAccept(&transport, &listenerSocket);
+        s32 socket = completion->result;
+        if (socket < 0)
+          continue;
+        if (!freeList) {
+          PlatformSocketClose(socket);
+          continue;
+        }
+
+        connection = freeList;
+        freeList = connection->nextFree;
+        TlsConnectionAccept(&connection->tls, socket);
+        if (connection->tls.state == TLS_CONNECTION_STATE_FAILED)
+          ServerConnectionFree(&freeList, connection);
+        continue;
+      }
+
+      TlsConnectionComplete(&connection->tls, completion);
+      if (!ServerConnectionAdvance(connection))
+        ServerConnectionFree(&freeList, connection);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////
+// CLIENT
+////////////////////////////////////////////////////////////////
+
+struct client {
+  struct platform_transport transport;
+  struct tls_connection tls;
+  struct platform_address address;
+  // during handshake
+  u64 receivedBytes;
+};
+
+/*
+ * Gives completions to connection.
+ */
+internalfn void
+ClientWait(struct client *client)
+{
+  struct platform_completion completions[16];
+  u32 completionCount = PlatformTransportWait(&client->transport, completions, ARRAY_COUNT(completions), -1);
+  for (u32 completionIndex = 0; completionIndex < completionCount; completionIndex++) {
+    struct platform_completion *completion = completions + completionIndex;
+    if (completion->type == PLATFORM_COMPLETION_RECEIVE && completion->result > 0 &&
+        completion->generation == client->tls.socket.generation)
+      client->receivedBytes += (u64)completion->result;
+    TlsConnectionComplete(&client->tls, completion);
+  }
+}
+
+/*
+ * Connects and does handshake, then waits for ticket when session is stored.
+ * @param sessionCache session is resumed from it when it has one, otherwise
+ *        session is stored in it
+ * @return nanoseconds handshake took, 0 on error
+ */
+internalfn u64
+ClientHandshake(struct client *client, struct tls_session_cache *sessionCache, b8 isResumed)
+{
+  struct string *hostname = &StringFromLiteral("localhost");
+  struct string *port = &StringFromLiteral("443");
+  // bench clock starts at zero, tickets expire long after
+  u64 now = 0;
+
+  struct tls_connection *tls = &client->tls;
+  if (isResumed && !TlsSessionCacheResume(sessionCache, hostname, port, &tls->backend, now))
+    return 0;
+
+  client->receivedBytes = 0;
+  u64 startedAt = NowInNanoseconds();
+  TlsConnectionConnect(tls, &client->address, hostname);
+  while (tls->state == TLS_CONNECTION_STATE_CONNECTING || tls->state == TLS_CONNECTION_STATE_HANDSHAKING) {
+    ClientWait(client);
+    TlsConnectionHandshake(tls);
+  }
+  u64 elapsed = NowInNanoseconds() - startedAt;
+  if (tls->state != TLS_CONNECTION_STATE_OPEN)
+    return 0;
+
+  if (!isResumed) {
+    // ticket follows handshake
+    u8 buffer[256];
+    while (!tls->isSessionTicketReceived) {
+      s64 bytesRead = TlsConnectionRead(tls, buffer, sizeof(buffer));
+      if (bytesRead == TLS_CONNECTION_WOULD_BLOCK)
+        ClientWait(client);
+      else if (!tls->isSessionTicketReceived)
+        return 0;
+    }
+    // kept when it expires no later than one already stored
+    TlsSessionCacheStore(sessionCache, hostname, port, &tls->backend, now);
+  }
+
+  TlsConnectionClose(tls);
+  // submit close
+  struct platform_completion completions[16];
+  PlatformTransportWait(&client->transport, completions, ARRAY_COUNT(completions), 0);
+
+  return elapsed == 0 ? 1 : elapsed;
+}
+
+internalfn void
+SortU64(u64 *values, u32 count)
+{
+  for (u32 index = 1; index < count; index++) {
+    u64 value = values[index];
+    u32 insertIndex = index;
+    while (insertIndex > 0 && values[insertIndex - 1] > value) {
+      values[insertIndex] = values[insertIndex - 1];
+      insertIndex--;
+    }
+    values[insertIndex] = value;
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  // setup
+  u8 stackBuffer[64 * KILOBYTES];
+  memory_arena stackMemory = {
+      .block = stackBuffer,
+      .total = ARRAY_COUNT(stackBuffer),
+  };
+
+  string_builder *sb = MakeStringBuilder(&stackMemory, 1024, 32);
+
+  memory_arena heapMemory = {
+      .total = 8 * MEGABYTES,
+  };
+  heapMemory.block = PlatformAllocate(heapMemory.total);
+  if (!heapMemory.block) {
+    StringBuilderAppendStringLiteral(sb, "Could not allocate ");
+    StringBuilderAppendU64(sb, heapMemory.total / MEGABYTES);
+    StringBuilderAppendStringLiteral(sb, "MiB memory");
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return 1;
+  }
+
+  struct bench bench = {.sb = sb, .baseline = StringNull()};
+  for (u32 argumentIndex = 1; argumentIndex < argc; argumentIndex++) {
+    struct string argument = StringFromZeroTerminated((u8 *)argv[argumentIndex], 1024);
+    struct string *baselineOption = &StringFromLiteral("--baseline=");
+    if (IsStringStartsWith(&argument, baselineOption)) {
+      struct string path = StringSlice(&argument, baselineOption->length, argument.length);
+      struct string *buffer = MakeString(&heapMemory, 1 * MEGABYTES);
+      if (PlatformReadFile(buffer, &path, &bench.baseline) != IO_ERROR_NONE) {
+        StringBuilderAppendStringLiteral(sb, "Could not read baseline.");
+        StringBuilderAppendStringLiteral(sb, "\n  path: ");
+        StringBuilderAppendString(sb, &path);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string message = StringBuilderFlush(sb);
+        PrintString(&message);
+        return 1;
+      }
+    }
+  }
+
+  struct client client;
+  if (!PlatformAddressResolve(&StringFromLiteral("127.0.0.1"), &StringFromLiteral("0"), &client.address)) {
+    PrintString(&StringFromLiteral("Could not resolve loopback address.\n"));
+    return 1;
+  }
+
+  s32 listener = PlatformSocketListen(&client.address);
+  if (listener == -1) {
+    StringBuilderAppendStringLiteral(sb, "Could not listen.\n  error: ");
+    StringBuilderAppendPlatformError(sb);
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return 1;
+  }
+
+  pid_t serverPid = fork();
+  if (serverPid == -1) {
+    PrintString(&StringFromLiteral("Could not start server.\n"));
+    return 1;
+  }
+  if (serverPid == 0) {
+    Serve(listener);
+    _exit(1);
+  }
+  PlatformSocketClose(listener);
+
+  int exitCode = 0;
+  struct tls_backend_config tlsConfig;
+  struct platform_transport_options options = {
+      .receiveBufferCount = 16,
+      .receiveBufferLength = TRANSPORT_BUFFER_LENGTH,
+      .sendBufferCount = 2,
+      .sendBufferLength = TRANSPORT_BUFFER_LENGTH,
+  };
+  if (!TlsLocalhostSetup(&tlsConfig, 0) || !PlatformTransportOpen(&client.transport, &options) ||
+      !TlsConnectionInit(&client.tls, &tlsConfig, &client.transport, &client)) {
+    PrintString(&StringFromLiteral("Client setup failed.\n"));
+    exitCode = 1;
+    goto stop;
+  }
+
+  struct tls_session_cache sessionCache;
+  TlsSessionCacheInit(&sessionCache, &heapMemory);
+  u64 *latencies = MemoryArenaPush(&heapMemory, sizeof(*latencies) * HANDSHAKE_COUNT);
+
+  struct string *names[] = {
+      &StringFromLiteral("full_handshake"),
+      &StringFromLiteral("resumed_handshake"),
+  };
+  for (u32 runIndex = 0; runIndex < ARRAY_COUNT(names); runIndex++) {
+    b8 isResumed = runIndex == 1;
+    if (isResumed) {
+      // session goes through file format, as it does between runs
+      struct string buffer = {
+          .value = MemoryArenaPush(&heapMemory, TLS_SESSION_CACHE_FILE_MAX),
+          .length = TLS_SESSION_CACHE_FILE_MAX,
+      };
+      struct string content = TlsSessionCacheSerialize(&sessionCache, &buffer, 0);
+      TlsSessionCacheInit(&sessionCache, &heapMemory);
+      if (IsStringNull(&content) || !TlsSessionCacheParse(&sessionCache, &content, 0)) {
+        PrintString(&StringFromLiteral("Session cache round trip failed.\n"));
+        exitCode = 1;
+        break;
+      }
+    }
+
+    u64 receivedBytes = 0;
+    for (u32 handshakeIndex = 0; handshakeIndex < HANDSHAKE_COUNT; handshakeIndex++) {
+      latencies[handshakeIndex] = ClientHandshake(&client, &sessionCache, isResumed);
+      if (latencies[handshakeIndex] == 0) {
+        StringBuilderAppendStringLiteral(sb, "Handshake failed.\n  run: ");
+        StringBuilderAppendString(sb, names[runIndex]);
+        StringBuilderAppendStringLiteral(sb, "\n  error: ");
+        StringBuilderAppendS32(sb, client.tls.error);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string message = StringBuilderFlush(sb);
+        PrintString(&message);
+        exitCode = 1;
+        goto stop;
+      }
+      receivedBytes = client.receivedBytes;
+    }
+
+    SortU64(latencies, HANDSHAKE_COUNT);
+    u64 p50 = latencies[HANDSHAKE_COUNT * 50 / 100] / 1000;
+    u64 p99 = latencies[HANDSHAKE_COUNT * 99 / 100] / 1000;
+
+    StringBuilderAppendString(sb, names[runIndex]);
+    StringBuilderAppendStringLiteral(sb, ": ");
+    StringBuilderAppendU64(sb, HANDSHAKE_COUNT);
+    StringBuilderAppendStringLiteral(sb, " handshakes, p50 ");
+    StringBuilderAppendU64(sb, p50);
+    StringBuilderAppendStringLiteral(sb, " us, p99 ");
+    StringBuilderAppendU64(sb, p99);
+    StringBuilderAppendStringLiteral(sb, " us, ");
+    StringBuilderAppendU64(sb, receivedBytes);
+    StringBuilderAppendStringLiteral(sb, " bytes received\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+
+    BenchReport(&bench, names[runIndex], &StringFromLiteral("p50_microseconds"), p50);
+    BenchReport(&bench, names[runIndex], &StringFromLiteral("p99_microseconds"), p99);
+    BenchReport(&bench, names[runIndex], &StringFromLiteral("received_bytes"), receivedBytes);
+  }
+
+  TlsConnectionRelease(&client.tls);
+  PlatformTransportClose(&client.transport);
+
+stop:
+  kill(serverPid, SIGTERM);
+  waitpid(serverPid, 0, 0);
+  return exitCode;
+}
@@ -0,0 +1,516 @@
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "platform.h"
+#include "platform_transport.h"
+#include "string_builder.h"
+
+/*
+ * Compares system calls and throughput of socket transports against plain
+ * read and write, on small responses like TLS records of api responses.
+ *
+ * Server is forked, it answers every request with same 4 KiB response. Client
+ * opens 1, 16 and 256 plain TCP connections, each sends next request as soon
+ * as previous one is answered, until 65536 requests are answered.
+ *
+ *   read_write  blocking sockets, every connection is written then every one
+ *               is read until its response is complete
+ *   epoll       transport on epoll
+ *   io_uring    transport on io_uring, skipped when it is not available
+ *
+ * Reported metrics:
+ *   requests_per_second
+ *   syscalls_per_1000_requests  made by client
+ *
+ * See bench.h for machine readable output and --baseline.
+ */
+
+enum {
+  KILOBYTES = (1 << 10),
+  MEGABYTES = (1 << 20),
+  REQUEST_COUNT = 65536,
+  RESPONSE_LENGTH = 4 * KILOBYTES,
+  CLIENT_CONNECTION_MAX = 256,
+  // connections of previous run may still be closing
+  SERVER_CONNECTION_MAX = 4 * CLIENT_CONNECTION_MAX,
+};
+
+comptime char REQUEST[] = "GET /api/v1/videos/d_oVysaqG_0 HTTP/1.1\r\n"
+                          "host: localhost\r\n"
+                          "accept: application/json\r\n"
+                          "\r\n";
+comptime u64 REQUEST_LENGTH = sizeof(REQUEST) - 1;
+
+////////////////////////////////////////////////////////////////
+// SERVER
+////////////////////////////////////////////////////////////////
+
+struct server_connection {
+  s32 socket;
+  struct server_connection *nextFree;
+  // bytes of request that is not complete
+  u64 requestLength;
+  // requests that are received but not answered
+  u32 pendingResponseCount;
+  u64 responseBytesWritten;
+  b8 isWriteWatched;
+};
+
+internalfn void
+ServerConnectionFree(struct platform_reactor *reactor, struct server_connection **freeList,
+                     struct server_connection *connection)
+{
+  PlatformReactorRemove(reactor, connection->socket);
+  PlatformSocketClose(connection->socket);
+  connection->nextFree = *freeList;
+  *freeList = connection;
+}
+
+/*
+ * @return false when connection is done
+ */
+internalfn b8
+ServerConnectionAdvance(struct platform_reactor *reactor, struct server_connection *connection, u8 *response)
+{
+  u8 buffer[16 * KILOBYTES];
+  while (1) {
+    s64 bytesRead = PlatformSocketRead(connection->socket, buffer, sizeof(buffer));
+    if (bytesRead == PLATFORM_SOCKET_WOULD_BLOCK)
+      break;
+    if (bytesRead <= 0)
+      return 0;
+
+    // requests are all same
+    connection->requestLength += (u64)bytesRead;
+    connection->pendingResponseCount += (u32)(connection->requestLength / REQUEST_LENGTH);
+    connection->requestLength %= REQUEST_LENGTH;
+  }
+
+  while (connection->pendingResponseCount != 0) {
+    s64 bytesWritten = PlatformSocketWrite(connection->socket, response + connection->responseBytesWritten,
+                                           RESPONSE_LENGTH - connection->responseBytesWritten);
+    if (bytesWritten == PLATFORM_SOCKET_WOULD_BLOCK)
+      break;
+    if (bytesWritten < 0)
+      return 0;
+
+    connection->responseBytesWritten += (u64)bytesWritten;
+    if (connection->responseBytesWritten == RESPONSE_LENGTH) {
+      connection->responseBytesWritten = 0;
+      connection->pendingResponseCount--;
+    }
+  }
+
+  b8 isWriteWatched = connection->pendingResponseCount != 0;
+  if (connection->isWriteWatched != isWriteWatched) {
+    u32 interest = PLATFORM_EVENT_READ | (isWriteWatched ? PLATFORM_EVENT_WRITE : 0);
+    if (!PlatformReactorModify(reactor, connection->socket, interest, connection))
+      return 0;
+    connection->isWriteWatched = isWriteWatched;
+  }
+  return 1;
+}
+
+/*
+ * Serves until it is killed.
+ */
+internalfn void
+Serve(s32 listener)
+{
+  u8 *response = PlatformAllocate(RESPONSE_LENGTH);
+  struct server_connection *connections = PlatformAllocate(sizeof(*connections) * SERVER_CONNECTION_MAX);
+  if (!response || !connections)
+    return;
+
+  for (u64 index = 0; index < RESPONSE_LENGTH; index++)
+    response[index] = 'a';
+
+  struct server_connection *freeList = 0;
+  for (u32 connectionIndex = SERVER_CONNECTION_MAX; connectionIndex-- > 0;) {
+    connections[connectionIndex].nextFree = freeList;
+    freeList = connections + connectionIndex;
+  }
+
+  struct platform_reactor reactor;
+  if (!PlatformReactorOpen(&reactor) || !PlatformReactorAdd(&reactor, listener, PLATFORM_EVENT_READ, 0)) {
+    PrintString(&StringFromLiteral("Server reactor setup failed.\n"));
+    return;
+  }
+
+  struct platform_event events[64];
+  while (1) {
+    u32 eventCount = PlatformReactorWait(&reactor, events, ARRAY_COUNT(events), -1);
+    for (u32 eventIndex = 0; eventIndex < eventCount; eventIndex++) {
+      struct server_connection *connection = events[eventIndex].data;
+
+      // listener
+      if (!connection) {
+        s32 socket;
+        while ((socket = PlatformSocketAccept(listener)) >= 0) {
+          if (!freeList || !PlatformReactorAdd(&reactor, socket, PLATFORM_EVENT_READ, freeList)) {
+            PlatformSocketClose(socket);
+            continue;
+          }
+
+          connection = freeList;
+          freeList = connection->nextFree;
+          connection->socket = socket;
+          connection->requestLength = 0;
+          connection->pendingResponseCount = 0;
+          connection->responseBytesWritten = 0;
+          connection->isWriteWatched = 0;
+        }
+        continue;
+      }
+
+      if (!ServerConnectionAdvance(&reactor, connection, response))
+        ServerConnectionFree(&reactor, &freeList, connection);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////
+// CLIENT
+////////////////////////////////////////////////////////////////
+
+struct run {
+  u64 elapsed;
+  u64 syscallCount;
+};
+
+/*
+ * @return false on error
+ */
+internalfn b8
+RunReadWrite(struct platform_address *address, u32 connectionCount, struct run *run)
+{
+  s32 sockets[CLIENT_CONNECTION_MAX];
+  u8 buffer[16 * KILOBYTES];
+  b8 isOk = 1;
+
+  u64 startedAt = NowInNanoseconds();
+  u32 openCount = 0;
+  for (; openCount < connectionCount; openCount++) {
+    s32 socketFd = socket(address->family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int isEnabled = 1;
+    setsockopt(socketFd, IPPROTO_TCP, TCP_NODELAY, &isEnabled, sizeof(isEnabled));
+    run->syscallCount += 3;
+    if (socketFd == -1 || connect(socketFd, (struct sockaddr *)address->value, address->length) == -1) {
+      if (socketFd != -1)
+        close(socketFd);
+      isOk = 0;
+      break;
+    }
+    sockets[openCount] = socketFd;
+  }
+
+  u32 completedCount = 0;
+  while (isOk && completedCount < REQUEST_COUNT) {
+    u32 batchCount = connectionCount;
+    if (batchCount > REQUEST_COUNT - completedCount)
+      batchCount = REQUEST_COUNT - completedCount;
+
+    for (u32 connectionIndex = 0; isOk && connectionIndex < batchCount; connectionIndex++) {
+      run->syscallCount++;
+      if (write(sockets[connectionIndex], REQUEST, REQUEST_LENGTH) != (ssize_t)REQUEST_LENGTH)
+        isOk = 0;
+    }
+
+    for (u32 connectionIndex = 0; isOk && connectionIndex < batchCount; connectionIndex++) {
+      u64 totalBytesRead = 0;
+      while (totalBytesRead < RESPONSE_LENGTH) {
+        run->syscallCount++;
+        ssize_t bytesRead = read(sockets[connectionIndex], buffer, RESPONSE_LENGTH - totalBytesRead);
+        if (bytesRead <= 0) {
+          isOk = 0;
+          break;
+        }
+        totalBytesRead += (u64)bytesRead;
+      }
+      completedCount++;
+    }
+  }
+  run->elapsed = NowInNanoseconds() - startedAt;
+
+  for (u32 connectionIndex = 0; connectionIndex < openCount; connectionIndex++)
+    close(sockets[connectionIndex]);
+  return isOk;
+}
+
+struct client_connection {
+  struct platform_socket socket;
+  u8 *request;
+  u64 responseLength;
+};
+
+/*
+ * @return false on error
+ */
+internalfn b8
+RunTransport(struct platform_transport *transport, struct client_connection *connections,
+             struct platform_address *address, u32 connectionCount, struct run *run)
+{
+  u64 syscallCountBefore = transport->syscallCount;
+  u64 startedAt = NowInNanoseconds();
+  u32 sentCount = 0;
+  u32 completedCount = 0;
+  b8 isOk = 1;
+
+  for (u32 connectionIndex = 0; connectionIndex < connectionCount; connectionIndex++) {
+    struct client_connection *connection = connections + connectionIndex;
+    connection->responseLength = 0;
+    if (!PlatformTransportConnect(transport, &connection->socket, address))
+      isOk = 0;
+  }
+
+  struct platform_completion completions[256];
+  while (isOk && completedCount < REQUEST_COUNT) {
+    u32 completionCount = PlatformTransportWait(transport, completions, ARRAY_COUNT(completions), -1);
+    for (u32 completionIndex = 0; completionIndex < completionCount; completionIndex++) {
+      struct platform_completion *completion = completions + completionIndex;
+      struct client_connection *connection = completion->data;
+      struct platform_socket *socket = &connection->socket;
+
+      switch (completion->type) {
+      case PLATFORM_COMPLETION_CONNECT: {
+        if (completion->result < 0) {
+          isOk = 0;
+          break;
+        }
+        if (sentCount < REQUEST_COUNT) {
+          sentCount++;
+          // response is waited in same submission
+          PlatformTransportSend(transport, socket, connection->request, REQUEST_LENGTH,
+                                PLATFORM_TRANSPORT_SEND_RECEIVE);
+        }
+      } break;
+
+      case PLATFORM_COMPLETION_SEND: {
+        if (completion->result < 0)
+          isOk = 0;
+      } break;
+
+      case PLATFORM_COMPLETION_RECEIVE: {
+        if (completion->result > 0) {
+          connection->responseLength += (u64)completion->result;
+          PlatformTransportRelease(transport, completion->bufferId);
+        } else if (completion->result != -ENOBUFS) {
+          isOk = 0;
+          break;
+        }
+
+        if (connection->responseLength == RESPONSE_LENGTH) {
+          connection->responseLength = 0;
+          completedCount++;
+          if (sentCount < REQUEST_COUNT) {
+            sentCount++;
+            PlatformTransportSend(transport, socket, connection->request, REQUEST_LENGTH,
+                                  PLATFORM_TRANSPORT_SEND_RECEIVE);
+          }
+        }
+
+        if (!completion->isMore && !(socket->state & PLATFORM_SOCKET_STATE_RECEIVING))
+          PlatformTransportReceive(transport, socket);
+      } break;
+
+      case PLATFORM_COMPLETION_ACCEPT: {
+        isOk = 0;
+      } break;
+      }
+    }
+  }
+  run->elapsed = NowInNanoseconds() - startedAt;
+  run->syscallCount = transport->syscallCount - syscallCountBefore;
+
+  for (u32 connectionIndex = 0; connectionIndex < connectionCount; connectionIndex++)
+    PlatformTransportCloseSocket(transport, &connections[connectionIndex].socket);
+  // submit closes
+  PlatformTransportWait(transport, completions, ARRAY_COUNT(completions), 0);
+  return isOk;
+}
+
+internalfn void
+Report(struct bench *bench, struct string *backend, u32 connectionCount, struct run *run)
+{
+  string_builder *sb = bench->sb;
+  if (run->elapsed == 0)
+    run->elapsed = 1;
+  u64 requestsPerSecond = (u64)REQUEST_COUNT * 1000000000UL / run->elapsed;
+  u64 syscallsPer1000Requests = run->syscallCount * 1000 / REQUEST_COUNT;
+
+  StringBuilderAppendString(sb, backend);
+  StringBuilderAppendStringLiteral(sb, "_connections_");
+  StringBuilderAppendU32(sb, connectionCount);
+  struct string name = StringBuilderFlush(sb);
+  // name is overwritten by next flush, keep copy
+  u8 nameBuffer[64];
+  debug_assert(name.length <= sizeof(nameBuffer));
+  MemoryCopy(nameBuffer, name.value, name.length);
+  name.value = nameBuffer;
+
+  StringBuilderAppendString(sb, &name);
+  StringBuilderAppendStringLiteral(sb, ": ");
+  StringBuilderAppendU64(sb, REQUEST_COUNT);
+  StringBuilderAppendStringLiteral(sb, " requests in ");
+  StringBuilderAppendU64(sb, run->elapsed / 1000000);
+  StringBuilderAppendStringLiteral(sb, " ms, ");
+  StringBuilderAppendU64(sb, requestsPerSecond);
+  StringBuilderAppendStringLiteral(sb, " req/s, ");
+  StringBuilderAppendU64(sb, run->syscallCount);
+  StringBuilderAppendStringLiteral(sb, " syscalls\n");
+  struct string message = StringBuilderFlush(sb);
+  PrintString(&message);
+
+  BenchReport(bench, &name, &StringFromLiteral("requests_per_second"), requestsPerSecond);
+  BenchReport(bench, &name, &StringFromLiteral("syscalls_per_1000_requests"), syscallsPer1000Requests);
+}
+
+int
+main(int argc, char *argv[])
+{
+  // setup
+  u8 stackBuffer[64 * KILOBYTES];
+  memory_arena stackMemory = {
+      .block = stackBuffer,
+      .total = ARRAY_COUNT(stackBuffer),
+  };
+
+  string_builder *sb = MakeStringBuilder(&stackMemory, 1024, 32);
+
+  memory_arena heapMemory = {
+      .total = 2 * MEGABYTES,
+  };
+  heapMemory.block = PlatformAllocate(heapMemory.total);
+  if (!heapMemory.block) {
+    StringBuilderAppendStringLiteral(sb, "Could not allocate ");
+    StringBuilderAppendU64(sb, heapMemory.total / MEGABYTES);
+    StringBuilderAppendStringLiteral(sb, "MiB memory");
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return 1;
+  }
+
+  struct bench bench = {.sb = sb, .baseline = StringNull()};
+  for (u32 argumentIndex = 1; argumentIndex < argc; argumentIndex++) {
+    struct string argument = StringFromZeroTerminated((u8 *)argv[argumentIndex], 1024);
+    struct string *baselineOption = &StringFromLiteral("--baseline=");
+    if (IsStringStartsWith(&argument, baselineOption)) {
+      struct string path = StringSlice(&argument, baselineOption->length, argument.length);
+      struct string *buffer = MakeString(&heapMemory, 1 * MEGABYTES);
+      if (PlatformReadFile(buffer, &path, &bench.baseline) != IO_ERROR_NONE) {
+        StringBuilderAppendStringLiteral(sb, "Could not read baseline.");
+        StringBuilderAppendStringLiteral(sb, "\n  path: ");
+        StringBuilderAppendString(sb, &path);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string message = StringBuilderFlush(sb);
+        PrintString(&message);
+        return 1;
+      }
+    }
+  }
+
+  struct platform_address address;
+  if (!PlatformAddressResolve(&StringFromLiteral("127.0.0.1"), &StringFromLiteral("0"), &address)) {
+    PrintString(&StringFromLiteral("Could not resolve loopback address.\n"));
+    return 1;
+  }
+
+  s32 listener = PlatformSocketListen(&address);
+  if (listener == -1) {
+    StringBuilderAppendStringLiteral(sb, "Could not listen.\n  error: ");
+    StringBuilderAppendPlatformError(sb);
+    StringBuilderAppendStringLiteral(sb, "\n");
+    struct string message = StringBuilderFlush(sb);
+    PrintString(&message);
+    return 1;
+  }
+
+  pid_t serverPid = fork();
+  if (serverPid == -1) {
+    PrintString(&StringFromLiteral("Could not start server.\n"));
+    return 1;
+  }
+  if (serverPid == 0) {
+    Serve(listener);
+    _exit(1);
+  }
+  PlatformSocketClose(listener);
+
+  int exitCode = 0;
+  u32 connectionCounts[] = {1, 16, CLIENT_CONNECTION_MAX};
+  struct string *backends[] = {
+      &StringFromLiteral("read_write"),
+      &StringFromLiteral("epoll"),
+      &StringFromLiteral("io_uring"),
+  };
+  struct client_connection *connections = MemoryArenaPush(&heapMemory, sizeof(*connections) * CLIENT_CONNECTION_MAX);
+
+  for (u32 backendIndex = 0; backendIndex < ARRAY_COUNT(backends); backendIndex++) {
+    struct string *backend = backends[backendIndex];
+    struct platform_transport transport;
+    if (backendIndex != 0) {
+      struct platform_transport_options options = {
+          .receiveBufferCount = 512,
+          .receiveBufferLength = 16 * KILOBYTES,
+          .sendBufferCount = CLIENT_CONNECTION_MAX,
+          .sendBufferLength = 1 * KILOBYTES,
+          .isIoUringDisabled = backendIndex == 1,
+      };
+      if (!PlatformTransportOpen(&transport, &options)) {
+        PrintString(&StringFromLiteral("Transport setup failed.\n"));
+        exitCode = 1;
+        break;
+      }
+
+      if (backendIndex == 2 && transport.backend != PLATFORM_TRANSPORT_BACKEND_IO_URING) {
+        PrintString(&StringFromLiteral("io_uring is not available, skipped.\n"));
+        PlatformTransportClose(&transport);
+        break;
+      }
+
+      for (u32 connectionIndex = 0; connectionIndex < CLIENT_CONNECTION_MAX; connectionIndex++) {
+        struct client_connection *connection = connections + connectionIndex;
+        *connection = (struct client_connection){
+            .socket = {.fd = -1, .data = connection},
+            .request = PlatformTransportSendBuffer(&transport),
+        };
+        MemoryCopy(connection->request, (u8 *)REQUEST, REQUEST_LENGTH);
+      }
+    }
+
+    for (u32 runIndex = 0; runIndex < ARRAY_COUNT(connectionCounts); runIndex++) {
+      u32 connectionCount = connectionCounts[runIndex];
+      struct run run = {};
+      b8 isOk = backendIndex == 0 ? RunReadWrite(&address, connectionCount, &run)
+                                  : RunTransport(&transport, connections, &address, connectionCount, &run);
+      if (!isOk) {
+        StringBuilderAppendStringLiteral(sb, "Request failed.\n  backend: ");
+        StringBuilderAppendString(sb, backend);
+        StringBuilderAppendStringLiteral(sb, "\n  connections: ");
+        StringBuilderAppendU32(sb, connectionCount);
+        StringBuilderAppendStringLiteral(sb, "\n");
+        struct string message = StringBuilderFlush(sb);
+        PrintString(&message);
+        exitCode = 1;
+        break;
+      }
+
+      Report(&bench, backend, connectionCount, &run);
+    }
+
+    if (backendIndex != 0)
+      PlatformTransportClose(&transport);
+    if (exitCode)
+      break;
+  }
+
+  kill(serverPid, SIGTERM);
+  waitpid(serverPid, 0, 0);
+  return exitCode;
+}
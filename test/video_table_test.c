@@ -0,0 +1,264 @@
+#include "print.h"
+#include "string_builder.h"
+#include "video_table.c"
+
+#define TEST_ERROR_LIST(X)                                                                                             \
+  X(FIND, "Video must be found once it is put in table, and only then")                                                \
+  X(FULL, "Table must refuse videos past 3/4 of it, and when room for answers is taken")                               \
+  X(ANSWER, "Answer must be kept as printed, and dropped when it does not fit")                                        \
+  X(WAIT, "Answer that is waited for must be kept, and dropped one must not be waited for")
+
+enum video_table_test_error {
+  VIDEO_TABLE_TEST_ERROR_NONE = 0,
+#define X(tag, message) VIDEO_TABLE_TEST_ERROR_##tag,
+  TEST_ERROR_LIST(X)
+#undef X
+
+  // src: https://mesonbuild.com/Unit-tests.html#skipped-tests-and-hard-errors
+  // For the default exitcode testing protocol, the GNU standard approach in
+  // this case is to exit the program with error code 77. Meson will detect this
+  // and report these tests as skipped rather than failed. This behavior was
+  // added in version 0.37.0.
+  MESON_TEST_SKIP = 77,
+  // In addition, sometimes a test fails set up so that it should fail even if
+  // it is marked as an expected failure. The GNU standard approach in this case
+  // is to exit the program with error code 99. Again, Meson will detect this
+  // and report these tests as ERROR, ignoring the setting of should_fail. This
+  // behavior was added in version 0.50.0.
+  MESON_TEST_FAILED_TO_SET_UP = 99,
+};
+
+internalfn void
+StringBuilderAppendTestError(struct string_builder *sb, enum video_table_test_error errorCode)
+{
+  struct string message = StringFromLiteral("Unknown error");
+  struct error {
+    enum video_table_test_error code;
+    struct string message;
+  } errors[] = {
+#define XX(tag, msg) {.code = VIDEO_TABLE_TEST_ERROR_##tag, .message = StringFromLiteral(msg)},
+      TEST_ERROR_LIST(XX)
+#undef XX
+  };
+
+  for (u32 errorIndex = 0; errorIndex < ARRAY_COUNT(errors); errorIndex++) {
+    struct error *error = errors + errorIndex;
+    if (error->code != errorCode)
+      continue;
+
+    message = error->message;
+    break;
+  }
+
+  StringBuilderAppendString(sb, &message);
+}
+
+internalfn void
+PrintTableError(string_builder *sb, enum video_table_test_error errorCode, struct string *videoId)
+{
+  StringBuilderAppendTestError(sb, errorCode);
+  StringBuilderAppendStringLiteral(sb, "\n  video id: ");
+  StringBuilderAppendString(sb, videoId);
+  StringBuilderAppendStringLiteral(sb, "\n");
+  struct string errorMessage = StringBuilderFlush(sb);
+  PrintString(&errorMessage);
+}
+
+/*
+ * @return video id made of index, like ones of batch
+ */
+internalfn struct string
+MakeVideoId(u8 buffer[11], u32 index)
+{
+  for (u32 position = 0; position < 11; position++) {
+    buffer[position] = (u8)('a' + index % 26);
+    index /= 26;
+  }
+  return StringFromBuffer(buffer, 11);
+}
+
+int
+main(void)
+{
+  enum video_table_test_error errorCode = VIDEO_TABLE_TEST_ERROR_NONE;
+
+  // setup
+  enum {
+    KILOBYTES = (1 << 10),
+  };
+  u8 stackBuffer[64 * KILOBYTES];
+  memory_arena stackMemory = {
+      .block = stackBuffer,
+      .total = ARRAY_COUNT(stackBuffer),
+  };
+
+  string_builder *sb = MakeStringBuilder(&stackMemory, 4 * KILOBYTES, 32);
+
+  comptime u32 ENTRY_MAX = 64;
+  debug_assert(VideoTableMemoryLength(ENTRY_MAX) <= 32 * KILOBYTES);
+
+  // struct video_table_entry *VideoTableInsert(struct video_table *table, struct string *videoId)
+  {
+    memory_temp tempMemory = MemoryTempBegin(&stackMemory);
+    struct video_table table;
+    VideoTableInit(&table, tempMemory.arena, ENTRY_MAX);
+
+    // answers are small, so only entries run out
+    struct string answer = StringFromLiteral("Type: video\nTitle: Recorded video\n");
+    u32 insertedCount = 0;
+    for (u32 index = 0; index < ENTRY_MAX; index++) {
+      u8 buffer[11];
+      struct string videoId = MakeVideoId(buffer, index);
+      if (VideoTableFind(&table, &videoId)) {
+        errorCode = VIDEO_TABLE_TEST_ERROR_FIND;
+        PrintTableError(sb, errorCode, &videoId);
+        break;
+      }
+
+      struct video_table_entry *entry = VideoTableInsert(&table, &videoId);
+      if (!entry)
+        break;
+      if (VideoTableFind(&table, &videoId) != entry || entry->state != VIDEO_TABLE_PENDING) {
+        errorCode = VIDEO_TABLE_TEST_ERROR_FIND;
+        PrintTableError(sb, errorCode, &videoId);
+        break;
+      }
+      VideoTableAnswer(&table, entry, &answer, 0);
+      insertedCount++;
+    }
+
+    if (errorCode == VIDEO_TABLE_TEST_ERROR_NONE && insertedCount != ENTRY_MAX * 3 / 4) {
+      errorCode = VIDEO_TABLE_TEST_ERROR_FULL;
+      struct string videoId = StringFromLiteral("");
+      PrintTableError(sb, errorCode, &videoId);
+    }
+
+    // every video put in is still found with its answer
+    for (u32 index = 0; errorCode == VIDEO_TABLE_TEST_ERROR_NONE && index < insertedCount; index++) {
+      u8 buffer[11];
+      struct string videoId = MakeVideoId(buffer, index);
+      struct video_table_entry *entry = VideoTableFind(&table, &videoId);
+      struct string got = entry ? VideoTableEntryAnswer(&table, entry) : StringNull();
+      if (!entry || entry->state != VIDEO_TABLE_ANSWERED || !IsStringEqual(&got, &answer)) {
+        errorCode = VIDEO_TABLE_TEST_ERROR_ANSWER;
+        PrintTableError(sb, errorCode, &videoId);
+      }
+    }
+    MemoryTempEnd(&tempMemory);
+  }
+
+  // void VideoTableAnswer(struct video_table *table, struct video_table_entry *entry, struct string *answer,
+  //                       b8 isFailed)
+  {
+    memory_temp tempMemory = MemoryTempBegin(&stackMemory);
+    struct video_table table;
+    // room for 4 answers of VIDEO_TABLE_ANSWER_MAX
+    VideoTableInit(&table, tempMemory.arena, 16);
+
+    struct video_table_entry *entries[5];
+    u32 entryCount = 0;
+    for (u32 index = 0; index < ARRAY_COUNT(entries); index++) {
+      u8 buffer[11];
+      struct string videoId = MakeVideoId(buffer, index);
+      entries[index] = VideoTableInsert(&table, &videoId);
+      if (entries[index])
+        entryCount++;
+    }
+    // room of every pending one is set aside
+    if (entryCount != 4) {
+      errorCode = VIDEO_TABLE_TEST_ERROR_FULL;
+      struct string videoId = StringFromLiteral("");
+      PrintTableError(sb, errorCode, &videoId);
+    }
+
+    struct string failed = StringFromLiteral("Answer is not a video.\n  Video id: aaaaaaaaaaa\n");
+    u8 longAnswerBuffer[3 * VIDEO_TABLE_ANSWER_MAX];
+    for (u32 index = 0; index < ARRAY_COUNT(longAnswerBuffer); index++)
+      longAnswerBuffer[index] = 'x';
+    struct string longAnswer = StringFromBuffer(longAnswerBuffer, ARRAY_COUNT(longAnswerBuffer));
+
+    if (errorCode == VIDEO_TABLE_TEST_ERROR_NONE) {
+      VideoTableAnswer(&table, entries[0], &failed, 1);
+      // fits only in room of others that are answered
+      VideoTableAnswer(&table, entries[1], &longAnswer, 0);
+      VideoTableAnswer(&table, entries[2], &failed, 1);
+      VideoTableAnswer(&table, entries[3], &longAnswer, 0);
+
+      struct string got = VideoTableEntryAnswer(&table, entries[0]);
+      if (entries[0]->state != VIDEO_TABLE_FAILED || !IsStringEqual(&got, &failed) ||
+          entries[1]->state != VIDEO_TABLE_DROPPED || entries[3]->state != VIDEO_TABLE_ANSWERED) {
+        errorCode = VIDEO_TABLE_TEST_ERROR_ANSWER;
+        struct string videoId = StringFromLiteral("");
+        PrintTableError(sb, errorCode, &videoId);
+      }
+
+      got = VideoTableEntryAnswer(&table, entries[3]);
+      if (!IsStringEqual(&got, &longAnswer)) {
+        errorCode = VIDEO_TABLE_TEST_ERROR_ANSWER;
+        struct string videoId = StringFromLiteral("");
+        PrintTableError(sb, errorCode, &videoId);
+      }
+    }
+    MemoryTempEnd(&tempMemory);
+  }
+
+  // b8 VideoTableWait(struct video_table *table, struct video_table_entry *entry)
+  {
+    memory_temp tempMemory = MemoryTempBegin(&stackMemory);
+    struct video_table table;
+    // room for 4 answers of VIDEO_TABLE_ANSWER_MAX
+    VideoTableInit(&table, tempMemory.arena, 16);
+
+    struct video_table_entry *entries[4];
+    u8 buffers[ARRAY_COUNT(entries)][11];
+    struct string videoIds[ARRAY_COUNT(entries)];
+    for (u32 index = 0; index < ARRAY_COUNT(entries); index++)
+      videoIds[index] = MakeVideoId(buffers[index], index);
+
+    entries[0] = VideoTableInsert(&table, videoIds + 0);
+    b8 isWaiting = entries[0] && VideoTableWait(&table, entries[0]);
+    entries[1] = VideoTableInsert(&table, videoIds + 1);
+    entries[2] = VideoTableInsert(&table, videoIds + 2);
+    // room of longest answer is set aside for one that is waited for
+    entries[3] = VideoTableInsert(&table, videoIds + 3);
+    if (!isWaiting || !entries[1] || !entries[2] || entries[3]) {
+      errorCode = VIDEO_TABLE_TEST_ERROR_WAIT;
+      struct string videoId = StringFromLiteral("");
+      PrintTableError(sb, errorCode, &videoId);
+    }
+
+    u8 longAnswerBuffer[3 * VIDEO_TABLE_ANSWER_MAX];
+    for (u32 index = 0; index < ARRAY_COUNT(longAnswerBuffer); index++)
+      longAnswerBuffer[index] = 'x';
+    struct string answer = StringFromBuffer(longAnswerBuffer, VIDEO_TABLE_ANSWER_MAX);
+    struct string waitedAnswer = StringFromBuffer(longAnswerBuffer, VIDEO_TABLE_WAITED_ANSWER_MAX);
+    struct string longAnswer = StringFromBuffer(longAnswerBuffer, ARRAY_COUNT(longAnswerBuffer));
+
+    if (errorCode == VIDEO_TABLE_TEST_ERROR_NONE) {
+      VideoTableAnswer(&table, entries[1], &answer, 0);
+      VideoTableAnswer(&table, entries[2], &longAnswer, 0);
+      // without room set aside, it would be dropped too
+      VideoTableAnswer(&table, entries[0], &waitedAnswer, 0);
+
+      struct string got = VideoTableEntryAnswer(&table, entries[0]);
+      if (entries[0]->state != VIDEO_TABLE_ANSWERED || !IsStringEqual(&got, &waitedAnswer)) {
+        errorCode = VIDEO_TABLE_TEST_ERROR_WAIT;
+        PrintTableError(sb, errorCode, videoIds + 0);
+      }
+
+      // video asked for again is requested again
+      if (entries[2]->state != VIDEO_TABLE_DROPPED || VideoTableWait(&table, entries[2])) {
+        errorCode = VIDEO_TABLE_TEST_ERROR_WAIT;
+        PrintTableError(sb, errorCode, videoIds + 2);
+      }
+
+      if (!VideoTableWait(&table, entries[1])) {
+        errorCode = VIDEO_TABLE_TEST_ERROR_WAIT;
+        PrintTableError(sb, errorCode, videoIds + 1);
+      }
+    }
+    MemoryTempEnd(&tempMemory);
+  }
+
+  return (int)errorCode;
+}